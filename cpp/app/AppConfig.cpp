@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2010-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #include "monarch/app/AppConfig.h"
 
@@ -175,7 +175,10 @@ static bool _initKernelConfig(AppRunner* ar)
    c["env"] = true;
    c["printModuleVersions"] = false;
    c["maxThreadCount"] = (uint32_t)100;
+   c["workStealing"] = false;
    c["maxConnectionCount"] = (uint32_t)100;
+   // thread groups partition kernel threads over cpus, none by default
+   c["threadGroups"]->setType(Map);
    rval = cm->addConfig(cfg);
 
    // command line options
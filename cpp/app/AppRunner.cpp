@@ -206,11 +206,14 @@ int AppRunner::start(int argc, const char* argv[])
          mKernel->setEventDaemon(new EventDaemon(), true);
          mKernel->setServer(new Server(), true);
          Config& c = cfg[MONARCH_KERNEL];
+         mKernel->setWorkStealingEnabled(c["workStealing"]->getBoolean());
          mKernel->setMaxAuxiliaryThreads(c["maxThreadCount"]->getUInt32());
          mKernel->setMaxServerConnections(c["maxConnectionCount"]->getUInt32());
 
-         // start kernel
-         success = mKernel->start();
+         // partition threads and start kernel
+         success =
+            mKernel->configureThreadGroups(c["threadGroups"]) &&
+            mKernel->start();
          if(!success)
          {
             MO_CAT_ERROR(MO_APP_CAT, "Kernel start failed: %s",
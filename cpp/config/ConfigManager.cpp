@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2007-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2007-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #include "monarch/config/ConfigManager.h"
 
@@ -44,6 +44,7 @@ const char* ConfigManager::INCLUDE_EXT = ".config";
 const char* ConfigManager::TMP         = "_tmp_";
 
 ConfigManager::ConfigManager() :
+   mLock(true),
    mConfigChangeListener(NULL)
 {
    // initialize internal data structures
@@ -1028,7 +1029,9 @@ void ConfigManager::makeMergedConfig(ConfigId id, Config* out)
 
       if(out == NULL)
       {
-         // caching is on, set merged config
+         // caching is on, set merged config, it is never modified once
+         // cached so freeze it to make clones of it cheap
+         merged.freeze();
          config["merged"] = merged;
       }
       else
@@ -1225,6 +1228,12 @@ bool ConfigManager::diff(
          (*details)["message"] = "Existing config is NULL. New config is not.";
       }
    }
+   else if(details == NULL &&
+      config1->isHashCached() && config2->isHashCached() &&
+      config1.isIdentical(config2))
+   {
+      // identical frozen configs, such as merged configs: no diff
+   }
    else if(config1->getType() != config2->getType())
    {
       // types differ: diff=config2
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2007-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2007-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #ifndef monarch_config_ConfigManager_H
 #define monarch_config_ConfigManager_H
@@ -216,7 +216,8 @@ protected:
    Config mConfigs;
 
    /**
-    * A lock for modifying the internal configuration data.
+    * A lock for modifying the internal configuration data. It is a big
+    * reader lock since configs are read far more often than changed.
     */
    monarch::rt::SharedLock mLock;
 
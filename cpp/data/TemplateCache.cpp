@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2010-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #ifdef HAVE_CONFIG_H
 #include "config.h"
@@ -22,23 +22,35 @@ using namespace monarch::rt;
 // templates together there -- with byte array input streams reading the
 // appropriate sections for each template.
 
-TemplateCache::TemplateCache(int capacity) :
-   mCapacity(capacity),
-   mUsed(0)
+/**
+ * A stream that reads a cached template, keeping a reference to the
+ * template's data so that it remains valid if the template is evicted.
+ */
+class CachedTemplateInputStream : public ByteArrayInputStream
+{
+protected:
+   ByteBufferRef mData;
+
+public:
+   CachedTemplateInputStream(ByteBufferRef& data) :
+      ByteArrayInputStream(data->data(), data->length()),
+      mData(data)
+   {
+   };
+
+   virtual ~CachedTemplateInputStream()
+   {
+   };
+};
+
+TemplateCache::TemplateCache(int capacity, uint32_t ttl) :
+   mCache(0, (capacity == -1) ? 0 : capacity, ttl),
+   mCapacity(capacity)
 {
 }
 
 TemplateCache::~TemplateCache()
 {
-   // clean up cache
-   for(Cache::iterator i = mCache.begin(); i != mCache.end(); ++i)
-   {
-      // clean up filename
-      free((char*)i->first);
-
-      // clean up entry data
-      free(i->second.data);
-   }
 }
 
 InputStream* TemplateCache::createStream(const char* filename, off_t* length)
@@ -53,7 +65,7 @@ InputStream* TemplateCache::createStream(const char* filename, off_t* length)
       {
          // data will NOT fit in cache
          off_t len = file->getLength();
-         if(len > INT32_MAX || (mCapacity != -1 && len > (mCapacity - mUsed)))
+         if(len > INT32_MAX || (mCapacity != -1 && len > mCapacity))
          {
             if(length != NULL)
             {
@@ -84,23 +96,24 @@ InputStream* TemplateCache::createStream(const char* filename, off_t* length)
    return rval;
 }
 
+DynamicObject TemplateCache::getStats()
+{
+   return mCache.getStats();
+}
+
 InputStream* TemplateCache::getCacheStream(const char* filename, off_t* length)
 {
    InputStream* rval = NULL;
 
-   mLock.lockShared();
+   ByteBufferRef data;
+   if(mCache.get(filename, data))
    {
-      Cache::iterator i = mCache.find(filename);
-      if(i != mCache.end())
+      if(length != NULL)
       {
-         if(length != NULL)
-         {
-            *length = i->second.length;
-         }
-         rval = new ByteArrayInputStream(i->second.data, i->second.length);
+         *length = data->length();
       }
+      rval = new CachedTemplateInputStream(data);
    }
-   mLock.unlockShared();
 
    return rval;
 }
@@ -110,32 +123,17 @@ InputStream* TemplateCache::cache(
 {
    InputStream* rval = NULL;
 
-   mLock.lockExclusive();
+   // insert into cache, replacing any template that was cached by another
+   // thread in the meantime, evicting other templates as needed
+   ByteBufferRef b = new ByteBuffer(data, 0, length, length, true);
+   mCache.put(filename, b, length);
 
-   Cache::iterator i = mCache.find(filename);
-   if(i != mCache.end())
+   // get cache stream
+   if(outLength != NULL)
    {
-      // already in cache, clean up data, get cache stream
-      mLock.unlockExclusive();
-      free(data);
-      rval = getCacheStream(filename, outLength);
-   }
-   else
-   {
-      // insert into cache
-      CacheEntry e;
-      e.length = length;
-      e.data = data;
-      mCache[strdup(filename)] = e;
-      mLock.unlockExclusive();
-
-      // get cache stream
-      if(outLength != NULL)
-      {
-         *outLength = length;
-      }
-      rval = new ByteArrayInputStream(data, length);
+      *outLength = length;
    }
+   rval = new CachedTemplateInputStream(b);
 
    return rval;
 }
@@ -1,14 +1,15 @@
 /*
- * Copyright (c) 2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2010-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #ifndef monarch_data_TemplateCache_H
 #define monarch_data_TemplateCache_H
 
+#include "monarch/io/ByteBuffer.h"
 #include "monarch/io/InputStream.h"
-#include "monarch/rt/SharedLock.h"
-#include "monarch/util/StringTools.h"
+#include "monarch/rt/ClockCache.h"
+#include "monarch/rt/StringTable.h"
 
-#include <map>
+#include <string>
 
 namespace monarch
 {
@@ -20,6 +21,12 @@ namespace data
  * file names. The input stream may reads the template from disk or from
  * a cache.
  *
+ * Looking up a cached template does not block. When the cache is full,
+ * templates are evicted using the CLOCK (second-chance) algorithm: a
+ * template that has been looked up since the clock hand last passed it is
+ * skipped once, otherwise it is evicted. Streams that are reading an evicted
+ * template can still be used.
+ *
  * Note: Future implementations could extend a more generalized FileCache
  * class. Consider integration with memcached if not overkill.
  *
@@ -31,44 +38,29 @@ class TemplateCache
 {
 protected:
    /**
-    * A cache entry.
-    */
-   struct CacheEntry
-   {
-      int length;
-      char* data;
-   };
-
-   /**
-    * A map of template filename to cached template.
+    * A cache of template filename to template data.
     */
-   typedef std::map<const char*, CacheEntry, monarch::util::StringComparator>
+   typedef monarch::rt::ClockCache<
+      std::string, monarch::io::ByteBufferRef,
+      monarch::rt::StringHashFunction, monarch::rt::StringEqualsFunction>
       Cache;
    Cache mCache;
 
-   /**
-    * A lock for manipulating the cache.
-    */
-   monarch::rt::SharedLock mLock;
-
    /**
     * The maximum size for the cache.
     */
    int mCapacity;
 
-   /**
-    * The used space in the cache.
-    */
-   int mUsed;
-
 public:
    /**
     * Creates a new TemplateCache.
     *
     * @param capacity the maximum size to use for the cache, in bytes, -1 for
     *                 no max.
+    * @param ttl the number of milliseconds to cache a template for, 0 to
+    *           cache it until it is evicted.
     */
-   TemplateCache(int capacity = -1);
+   TemplateCache(int capacity = -1, uint32_t ttl = 0);
 
    /**
     * Destructs this TemplateCache.
@@ -87,6 +79,13 @@ public:
    virtual monarch::io::InputStream* createStream(
       const char* filename, off_t* length = NULL);
 
+   /**
+    * Gets statistics for this cache, see ClockCache::getStats().
+    *
+    * @return the statistics.
+    */
+   virtual monarch::rt::DynamicObject getStats();
+
 protected:
    /**
     * Creates an input stream to read from the cache.
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#ifndef monarch_data_binary_BinaryFormat_H
+#define monarch_data_binary_BinaryFormat_H
+
+/**
+ * Constants for the monarch binary DynamicObject format.
+ *
+ * All numbers are stored little endian. A document is laid out as follows:
+ *
+ * header:
+ *    magic       4 bytes, "MOBD"
+ *    version     uint32
+ *    length      uint32, the length of the whole document, in bytes
+ *    key count   uint32, the number of entries in the key dictionary
+ *    root offset uint32, the offset to the root value
+ *
+ * key dictionary:
+ *    key count uint32 offsets to the null-terminated member names
+ *    the member names
+ *
+ * values, each one starts with a one byte type tag:
+ *    String       tag, uint32 length, the characters and a null terminator
+ *    Boolean      tag, 1 byte
+ *    (U)Int32     tag, 4 bytes
+ *    (U)Int64     tag, 8 bytes
+ *    Double       tag, 8 bytes (IEEE 754)
+ *    Map          tag, uint32 body length, uint32 member count, then for each
+ *                 member: a uint32 key dictionary index and a value
+ *    Array        tag, uint32 body length, uint32 element count, the values
+ *    Packed Array tag, uint32 body length, uint32 element count, the 1 byte
+ *                 element type, padding up to the packed alignment (relative
+ *                 to the start of the document), the elements
+ *    null         tag
+ *
+ * The tag of every value but a packed Array or null is its DynamicObjectType.
+ * The body length of a container does not include the tag or the body length
+ * itself, so a container can be skipped without parsing its contents.
+ */
+
+/**
+ * The magic bytes that start every document and their length.
+ */
+#define MO_BINARY_MAGIC         "MOBD"
+#define MO_BINARY_MAGIC_LENGTH  4
+
+/**
+ * The current format version.
+ */
+#define MO_BINARY_VERSION       1
+
+/**
+ * The size of the header, in bytes.
+ */
+#define MO_BINARY_HEADER_SIZE   20
+
+/**
+ * The type tag for a packed Array.
+ */
+#define MO_BINARY_PACKED_ARRAY  0x80
+
+/**
+ * The type tag for a null value.
+ */
+#define MO_BINARY_NULL          0x81
+
+/**
+ * The alignment of the elements in a packed Array, so that they can be read
+ * in place from an aligned buffer.
+ */
+#define MO_BINARY_PACKED_ALIGN  8
+
+/**
+ * The deepest a Map or Array may be nested in a document. The root value is
+ * at depth 0. Documents are walked recursively, so this bounds the stack used
+ * to read one.
+ */
+#define MO_BINARY_MAX_DEPTH     256
+
+#endif
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#include "monarch/data/binary/BinaryReader.h"
+
+#include "monarch/data/binary/BinaryView.h"
+#include "monarch/rt/Exception.h"
+
+using namespace monarch::data;
+using namespace monarch::data::binary;
+using namespace monarch::io;
+using namespace monarch::rt;
+
+int BinaryReader::READ_SIZE = 4096;
+
+BinaryReader::BinaryReader() :
+   mStarted(false),
+   mTarget(NULL),
+   mBuffer(READ_SIZE)
+{
+}
+
+BinaryReader::~BinaryReader()
+{
+}
+
+bool BinaryReader::start(DynamicObject& dyno)
+{
+   mTarget = &dyno;
+   mBuffer.clear();
+   mStarted = true;
+   return true;
+}
+
+bool BinaryReader::read(InputStream* is)
+{
+   bool rval = true;
+
+   if(!mStarted)
+   {
+      // reader not started
+      ExceptionRef e = new Exception(
+         "Cannot read yet, BinaryReader not started.",
+         "monarch.data.binary.BinaryReader.NotStarted");
+      Exception::set(e);
+      rval = false;
+   }
+   else
+   {
+      int numBytes;
+      do
+      {
+         // grow geometrically, ByteBuffer only grows by what is needed
+         if(mBuffer.freeSpace() < READ_SIZE)
+         {
+            mBuffer.resize(mBuffer.capacity() * 2);
+         }
+         numBytes = mBuffer.put(is, READ_SIZE);
+      }
+      while(numBytes > 0);
+      rval = (numBytes == 0);
+   }
+
+   return rval;
+}
+
+bool BinaryReader::finish()
+{
+   bool rval = false;
+
+   if(mStarted)
+   {
+      rval = readFromBuffer(*mTarget, mBuffer.data(), mBuffer.length());
+   }
+   else
+   {
+      ExceptionRef e = new Exception(
+         "Cannot finish, BinaryReader not started.",
+         "monarch.data.binary.BinaryReader.NotStarted");
+      Exception::set(e);
+   }
+
+   // no longer started
+   mStarted = false;
+   mBuffer.clear();
+
+   return rval;
+}
+
+bool BinaryReader::readFromStream(DynamicObject& dyno, InputStream& is)
+{
+   BinaryReader br;
+   return br.start(dyno) && br.read(&is) && br.finish();
+}
+
+bool BinaryReader::readFromBuffer(
+   DynamicObject& dyno, const char* b, size_t length)
+{
+   bool rval;
+
+   BinaryView view;
+   if((rval = view.open(b, length)))
+   {
+      view.copyTo(dyno);
+   }
+
+   return rval;
+}
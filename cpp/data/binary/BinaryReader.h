@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#ifndef monarch_data_binary_BinaryReader_H
+#define monarch_data_binary_BinaryReader_H
+
+#include "monarch/data/DynamicObjectReader.h"
+#include "monarch/io/ByteBuffer.h"
+
+#include <cstddef>
+
+namespace monarch
+{
+namespace data
+{
+namespace binary
+{
+
+/**
+ * A BinaryReader deserializes DynamicObjects from the binary format written
+ * by a BinaryWriter (see BinaryFormat.h).
+ *
+ * The document is buffered as it is read and converted when finish() is
+ * called. To access a document that is already in memory without building
+ * DynamicObjects, use a BinaryView instead.
+ */
+class BinaryReader : public DynamicObjectReader
+{
+protected:
+   /**
+    * True if this reader has started, false if not.
+    */
+   bool mStarted;
+
+   /**
+    * The target DynamicObject set from start().
+    */
+   monarch::rt::DynamicObject* mTarget;
+
+   /**
+    * The buffer for the document.
+    */
+   monarch::io::ByteBuffer mBuffer;
+
+   /**
+    * The read size in bytes.
+    */
+   static int READ_SIZE;
+
+public:
+   /**
+    * Creates a new BinaryReader.
+    */
+   BinaryReader();
+
+   /**
+    * Destructs this BinaryReader.
+    */
+   virtual ~BinaryReader();
+
+   /**
+    * Starts deserializing an object. This BinaryReader can be re-used by
+    * calling start() with the same or a new object. Calling start() before
+    * a previous deserialization has finished will abort the previous state.
+    *
+    * @param dyno the DynamicObject for the object to deserialize.
+    *
+    * @return true on success, false on failure.
+    */
+   virtual bool start(monarch::rt::DynamicObject& dyno);
+
+   /**
+    * Reads a document from the passed InputStream until the end of the
+    * stream, blocking if necessary. This method may be called multiple times.
+    *
+    * @param is the InputStream to read from.
+    *
+    * @return true if the read succeeded, false if an Exception occurred.
+    */
+   virtual bool read(monarch::io::InputStream* is);
+
+   /**
+    * Finishes deserializing an object. The document that was read is
+    * validated and copied into the DynamicObject provided in start().
+    *
+    * @return true if the finish succeeded, false if an Exception occurred.
+    */
+   virtual bool finish();
+
+   /**
+    * Reads a DynamicObject in the binary format from an InputStream.
+    *
+    * @param dyno the DynamicObject to fill.
+    * @param is the InputStream to read from.
+    *
+    * @return true on success, false and exception set on failure.
+    */
+   static bool readFromStream(
+      monarch::rt::DynamicObject& dyno, monarch::io::InputStream& is);
+
+   /**
+    * Reads a DynamicObject in the binary format from a buffer, without
+    * copying the buffer first.
+    *
+    * @param dyno the DynamicObject to fill.
+    * @param b the buffer to read from.
+    * @param length the length of b.
+    *
+    * @return true on success, false and exception set on failure.
+    */
+   static bool readFromBuffer(
+      monarch::rt::DynamicObject& dyno, const char* b, size_t length);
+};
+
+} // end namespace binary
+} // end namespace data
+} // end namespace monarch
+#endif
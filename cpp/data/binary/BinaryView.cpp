@@ -0,0 +1,760 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#include "monarch/data/binary/BinaryView.h"
+
+#include "monarch/data/binary/BinaryFormat.h"
+#include "monarch/rt/Exception.h"
+#include "monarch/util/Data.h"
+
+#include <cstdlib>
+#include <cstring>
+
+using namespace monarch::data::binary;
+using namespace monarch::rt;
+
+/**
+ * Reads a little endian number that may not be aligned.
+ *
+ * @param p the position of the number.
+ *
+ * @return the number.
+ */
+static inline uint32_t _readUInt32(const char* p)
+{
+   uint32_t rval;
+   memcpy(&rval, p, 4);
+   return MO_UINT32_FROM_LE(rval);
+}
+
+static inline uint64_t _readUInt64(const char* p)
+{
+   uint64_t rval;
+   memcpy(&rval, p, 8);
+   return MO_UINT64_FROM_LE(rval);
+}
+
+static inline double _readDouble(const char* p)
+{
+   uint64_t bits = _readUInt64(p);
+   double rval;
+   memcpy(&rval, &bits, 8);
+   return rval;
+}
+
+/**
+ * Gets the size of a fixed-size value.
+ *
+ * @param tag the type tag of the value.
+ *
+ * @return the size of the value, in bytes, or -1 if its size is not fixed.
+ */
+static inline int _getFixedSize(int tag)
+{
+   int rval;
+
+   switch(tag)
+   {
+      case MO_BINARY_NULL:
+         rval = 0;
+         break;
+      case Boolean:
+         rval = 1;
+         break;
+      case Int32:
+      case UInt32:
+         rval = 4;
+         break;
+      case Int64:
+      case UInt64:
+      case Double:
+         rval = 8;
+         break;
+      default:
+         rval = -1;
+         break;
+   }
+
+   return rval;
+}
+
+/**
+ * Gets the start of the elements of a packed Array.
+ *
+ * @param doc the start of the document.
+ * @param data the data of the packed Array, after its tag.
+ *
+ * @return the start of the elements.
+ */
+static inline const char* _getPackedStart(const char* doc, const char* data)
+{
+   size_t offset = (data + 9) - doc;
+   offset += (MO_BINARY_PACKED_ALIGN - offset % MO_BINARY_PACKED_ALIGN) %
+      MO_BINARY_PACKED_ALIGN;
+   return doc + offset;
+}
+
+/**
+ * Sets an invalid format exception.
+ *
+ * @param msg the exception message.
+ */
+static void _setInvalidFormat(const char* msg)
+{
+   ExceptionRef e = new Exception(
+      msg, "monarch.data.binary.BinaryView.InvalidFormat");
+   Exception::set(e);
+}
+
+BinaryView::BinaryView() :
+   mDocument(NULL),
+   mTag(MO_BINARY_NULL),
+   mData(NULL),
+   mName(NULL),
+   mEnd(NULL),
+   mPacked(false)
+{
+}
+
+BinaryView::~BinaryView()
+{
+}
+
+bool BinaryView::open(const char* b, size_t length)
+{
+   bool rval = false;
+
+   mDocument = NULL;
+   if(length < MO_BINARY_HEADER_SIZE ||
+      memcmp(b, MO_BINARY_MAGIC, MO_BINARY_MAGIC_LENGTH) != 0)
+   {
+      _setInvalidFormat("Data is not a binary DynamicObject document.");
+   }
+   else if(_readUInt32(b + 4) != MO_BINARY_VERSION)
+   {
+      ExceptionRef e = new Exception(
+         "Unsupported binary DynamicObject document version.",
+         "monarch.data.binary.BinaryView.UnsupportedVersion");
+      e->getDetails()["version"] = _readUInt32(b + 4);
+      Exception::set(e);
+   }
+   else
+   {
+      uint32_t docLength = _readUInt32(b + 8);
+      uint32_t keys = _readUInt32(b + 12);
+      uint32_t root = _readUInt32(b + 16);
+      uint64_t keysEnd = MO_BINARY_HEADER_SIZE + (uint64_t)keys * 4;
+      if(docLength < MO_BINARY_HEADER_SIZE || docLength > length ||
+         keysEnd > root || root >= docLength)
+      {
+         _setInvalidFormat("Invalid binary DynamicObject document header.");
+      }
+      else
+      {
+         // keys must be null-terminated and sorted
+         rval = true;
+         const char* prev = NULL;
+         for(uint32_t i = 0; rval && i < keys; ++i)
+         {
+            uint32_t offset = _readUInt32(b + MO_BINARY_HEADER_SIZE + i * 4);
+            const char* key = b + offset;
+            rval =
+               offset >= keysEnd && offset < root &&
+               memchr(key, 0, root - offset) != NULL &&
+               (prev == NULL || strcmp(prev, key) < 0);
+            prev = key;
+         }
+
+         // validate values
+         const char* end = b + docLength;
+         bool tooDeep = false;
+         rval = rval && (validate(b, b + root, end, keys, 0, tooDeep) == end);
+         if(tooDeep)
+         {
+            ExceptionRef e = new Exception(
+               "Binary DynamicObject document is nested too deeply.",
+               "monarch.data.binary.BinaryView.NestingTooDeep");
+            e->getDetails()["maxDepth"] = MO_BINARY_MAX_DEPTH;
+            Exception::set(e);
+         }
+         else if(!rval)
+         {
+            _setInvalidFormat("Invalid binary DynamicObject document.");
+         }
+         else
+         {
+            mDocument = b;
+            mTag = (unsigned char)b[root];
+            mData = b + root + 1;
+            mName = NULL;
+            mEnd = end;
+            mPacked = false;
+         }
+      }
+   }
+
+   return rval;
+}
+
+bool BinaryView::isValid() const
+{
+   return mDocument != NULL;
+}
+
+bool BinaryView::isNull() const
+{
+   return mTag == MO_BINARY_NULL;
+}
+
+DynamicObjectType BinaryView::getType() const
+{
+   DynamicObjectType rval;
+
+   switch(mTag)
+   {
+      case MO_BINARY_PACKED_ARRAY:
+         rval = Array;
+         break;
+      case MO_BINARY_NULL:
+         rval = String;
+         break;
+      default:
+         rval = (DynamicObjectType)mTag;
+         break;
+   }
+
+   return rval;
+}
+
+const char* BinaryView::getName() const
+{
+   return mName;
+}
+
+int BinaryView::length() const
+{
+   int rval;
+
+   switch(mTag)
+   {
+      case String:
+      case Map:
+      case Array:
+         rval = _readUInt32(mData + (mTag == String ? 0 : 4));
+         break;
+      case MO_BINARY_PACKED_ARRAY:
+         rval = _readUInt32(mData + 4);
+         break;
+      default:
+         rval = _getFixedSize(mTag);
+         break;
+   }
+
+   return rval;
+}
+
+bool BinaryView::hasMember(const char* name) const
+{
+   return (*this)[name].isValid();
+}
+
+BinaryView BinaryView::operator[](const char* name) const
+{
+   BinaryView rval;
+
+   if(isValid() && !mPacked && mTag == Map)
+   {
+      // binary search the sorted key dictionary
+      uint32_t low = 0;
+      uint32_t high = _readUInt32(mDocument + 12);
+      while(low < high)
+      {
+         uint32_t mid = (low + high) / 2;
+         if(strcmp(getKey(mid), name) < 0)
+         {
+            low = mid + 1;
+         }
+         else
+         {
+            high = mid;
+         }
+      }
+
+      if(low < _readUInt32(mDocument + 12) && strcmp(getKey(low), name) == 0)
+      {
+         // members are sorted by key index, skip until the key is reached
+         const char* p = mData + 8;
+         const char* end = mData + 4 + _readUInt32(mData);
+         uint32_t key = 0;
+         while(p < end && (key = _readUInt32(p)) < low)
+         {
+            p = getChild(Map, p, end).getValueEnd();
+         }
+         if(p < end && key == low)
+         {
+            rval = getChild(Map, p, end);
+         }
+      }
+   }
+
+   return rval;
+}
+
+BinaryView BinaryView::operator[](int index) const
+{
+   BinaryView rval;
+
+   if(isValid() && !mPacked && index >= 0 && index < length())
+   {
+      if(mTag == MO_BINARY_PACKED_ARRAY)
+      {
+         int type = (unsigned char)mData[8];
+         const char* p = _getPackedStart(mDocument, mData) +
+            index * _getFixedSize(type);
+         rval = getChild(type, p, mData + 4 + _readUInt32(mData));
+      }
+      else if(mTag == Array)
+      {
+         rval = first();
+         for(int i = 0; i < index; ++i)
+         {
+            rval = rval.next();
+         }
+      }
+   }
+
+   return rval;
+}
+
+BinaryView BinaryView::first() const
+{
+   BinaryView rval;
+
+   if(isValid() && !mPacked)
+   {
+      const char* end = mData + 4;
+      switch(mTag)
+      {
+         case Map:
+         case Array:
+            end += _readUInt32(mData);
+            rval = getChild(mTag, mData + 8, end);
+            break;
+         case MO_BINARY_PACKED_ARRAY:
+            end += _readUInt32(mData);
+            rval = getChild(
+               (unsigned char)mData[8], _getPackedStart(mDocument, mData), end);
+            break;
+      }
+   }
+
+   return rval;
+}
+
+BinaryView BinaryView::next() const
+{
+   BinaryView rval;
+
+   if(isValid() && mEnd != NULL)
+   {
+      int container = mPacked ? mTag : (mName != NULL ? Map : Array);
+      rval = getChild(container, getValueEnd(), mEnd);
+   }
+
+   return rval;
+}
+
+const char* BinaryView::getString() const
+{
+   return (!mPacked && mTag == String) ? mData + 4 : NULL;
+}
+
+bool BinaryView::getBoolean() const
+{
+   bool rval;
+
+   switch(mTag)
+   {
+      case Boolean:
+         rval = (mData[0] != 0);
+         break;
+      case String:
+         rval = (strcmp(mData + 4, "true") == 0);
+         break;
+      case Double:
+         rval = !(_readDouble(mData) == 0.0);
+         break;
+      default:
+         rval = (getUInt64() != 0);
+         break;
+   }
+
+   return rval;
+}
+
+int32_t BinaryView::getInt32() const
+{
+   return (int32_t)getInt64();
+}
+
+uint32_t BinaryView::getUInt32() const
+{
+   return (uint32_t)getUInt64();
+}
+
+int64_t BinaryView::getInt64() const
+{
+   int64_t rval;
+
+   switch(mTag)
+   {
+      case Boolean:
+         rval = mData[0];
+         break;
+      case Int32:
+         rval = (int32_t)_readUInt32(mData);
+         break;
+      case UInt32:
+         rval = _readUInt32(mData);
+         break;
+      case Int64:
+      case UInt64:
+         rval = (int64_t)_readUInt64(mData);
+         break;
+      case Double:
+         rval = (int64_t)_readDouble(mData);
+         break;
+      case String:
+         rval = strtoll(mData + 4, NULL, 10);
+         break;
+      default:
+         rval = 0;
+         break;
+   }
+
+   return rval;
+}
+
+uint64_t BinaryView::getUInt64() const
+{
+   uint64_t rval;
+
+   switch(mTag)
+   {
+      case Boolean:
+         rval = mData[0];
+         break;
+      case Int32:
+         rval = (int32_t)_readUInt32(mData);
+         break;
+      case UInt32:
+         rval = _readUInt32(mData);
+         break;
+      case Int64:
+      case UInt64:
+         rval = _readUInt64(mData);
+         break;
+      case Double:
+         rval = (uint64_t)_readDouble(mData);
+         break;
+      case String:
+         rval = strtoull(mData + 4, NULL, 10);
+         break;
+      default:
+         rval = 0;
+         break;
+   }
+
+   return rval;
+}
+
+double BinaryView::getDouble() const
+{
+   double rval;
+
+   switch(mTag)
+   {
+      case Boolean:
+      case UInt32:
+      case UInt64:
+         rval = getUInt64();
+         break;
+      case Int32:
+      case Int64:
+         rval = getInt64();
+         break;
+      case Double:
+         rval = _readDouble(mData);
+         break;
+      case String:
+         rval = strtod(mData + 4, NULL);
+         break;
+      default:
+         rval = 0.0;
+         break;
+   }
+
+   return rval;
+}
+
+DynamicObjectType BinaryView::getPackedType() const
+{
+   return (!mPacked && mTag == MO_BINARY_PACKED_ARRAY) ?
+      (DynamicObjectType)(unsigned char)mData[8] : String;
+}
+
+const void* BinaryView::getPackedData() const
+{
+   return (!mPacked && mTag == MO_BINARY_PACKED_ARRAY) ?
+      _getPackedStart(mDocument, mData) : NULL;
+}
+
+void BinaryView::copyTo(DynamicObject& dyno) const
+{
+   if(isNull())
+   {
+      dyno.setNull();
+   }
+   else
+   {
+      if(dyno.isNull())
+      {
+         dyno = DynamicObject();
+      }
+
+      switch(mTag)
+      {
+         case String:
+            *dyno = getString();
+            break;
+         case Boolean:
+            *dyno = getBoolean();
+            break;
+         case Int32:
+            *dyno = getInt32();
+            break;
+         case UInt32:
+            *dyno = getUInt32();
+            break;
+         case Int64:
+            *dyno = getInt64();
+            break;
+         case UInt64:
+            *dyno = getUInt64();
+            break;
+         case Double:
+            *dyno = getDouble();
+            break;
+         case Map:
+            dyno->setType(Map);
+            dyno->clear();
+            for(BinaryView v = first(); v.isValid(); v = v.next())
+            {
+               v.copyTo(dyno[v.getName()]);
+            }
+            break;
+         case Array:
+            dyno->setType(Array);
+            dyno->clear();
+            for(BinaryView v = first(); v.isValid(); v = v.next())
+            {
+               v.copyTo(dyno->append());
+            }
+            break;
+         case MO_BINARY_PACKED_ARRAY:
+         {
+            DynamicObjectType type = getPackedType();
+            dyno->setType(Array);
+            dyno->clear();
+            dyno->setPackedType(type);
+            for(BinaryView v = first(); v.isValid(); v = v.next())
+            {
+               switch(type)
+               {
+                  case Int32:
+                     dyno->appendPacked(v.getInt32());
+                     break;
+                  case UInt32:
+                     dyno->appendPacked(v.getUInt32());
+                     break;
+                  case Int64:
+                     dyno->appendPacked(v.getInt64());
+                     break;
+                  case UInt64:
+                     dyno->appendPacked(v.getUInt64());
+                     break;
+                  default:
+                     dyno->appendPacked(v.getDouble());
+                     break;
+               }
+            }
+            break;
+         }
+      }
+   }
+}
+
+const char* BinaryView::getKey(uint32_t index) const
+{
+   return mDocument +
+      _readUInt32(mDocument + MO_BINARY_HEADER_SIZE + index * 4);
+}
+
+const char* BinaryView::getValueEnd() const
+{
+   const char* rval;
+
+   int size = mPacked ? _getFixedSize(mTag) : -1;
+   if(size == -1)
+   {
+      switch(mTag)
+      {
+         case String:
+            rval = mData + 5 + _readUInt32(mData);
+            break;
+         case Map:
+         case Array:
+         case MO_BINARY_PACKED_ARRAY:
+            rval = mData + 4 + _readUInt32(mData);
+            break;
+         default:
+            rval = mData + _getFixedSize(mTag);
+            break;
+      }
+   }
+   else
+   {
+      rval = mData + size;
+   }
+
+   return rval;
+}
+
+BinaryView BinaryView::getChild(
+   int container, const char* p, const char* end) const
+{
+   BinaryView rval;
+
+   if(p < end)
+   {
+      rval.mDocument = mDocument;
+      rval.mEnd = end;
+      switch(container)
+      {
+         case Map:
+            rval.mName = getKey(_readUInt32(p));
+            rval.mTag = (unsigned char)p[4];
+            rval.mData = p + 5;
+            break;
+         case Array:
+            rval.mTag = (unsigned char)p[0];
+            rval.mData = p + 1;
+            break;
+         default:
+            // element of a packed array, the container is the element type
+            rval.mTag = container;
+            rval.mData = p;
+            rval.mPacked = true;
+            break;
+      }
+   }
+
+   return rval;
+}
+
+const char* BinaryView::validate(
+   const char* doc, const char* p, const char* end, uint32_t keys,
+   int depth, bool& tooDeep)
+{
+   const char* rval = NULL;
+
+   if(p < end)
+   {
+      int tag = (unsigned char)*p;
+      const char* data = p + 1;
+      size_t available = end - data;
+      int size = _getFixedSize(tag);
+      if(size != -1)
+      {
+         if((size_t)size <= available)
+         {
+            rval = data + size;
+         }
+      }
+      else if(tag == String)
+      {
+         if(available >= 5)
+         {
+            uint32_t length = _readUInt32(data);
+            if(length <= available - 5 && data[4 + length] == 0)
+            {
+               rval = data + 5 + length;
+            }
+         }
+      }
+      else if(tag == Map || tag == Array)
+      {
+         // limit the nesting so a hostile document cannot exhaust the stack
+         if(depth >= MO_BINARY_MAX_DEPTH)
+         {
+            tooDeep = true;
+         }
+         else if(available >= 8)
+         {
+            uint32_t body = _readUInt32(data);
+            if(body >= 4 && body <= available - 4)
+            {
+               const char* bodyEnd = data + 4 + body;
+               uint32_t count = _readUInt32(data + 4);
+               const char* q = data + 8;
+               int64_t prevKey = -1;
+               for(uint32_t i = 0; q != NULL && i < count; ++i)
+               {
+                  if(tag == Map)
+                  {
+                     // key indexes must be valid and ascending
+                     int64_t key = (q + 4 <= bodyEnd) ? _readUInt32(q) : -1;
+                     if(key > prevKey && key < keys)
+                     {
+                        prevKey = key;
+                        q += 4;
+                     }
+                     else
+                     {
+                        q = NULL;
+                     }
+                  }
+                  if(q != NULL)
+                  {
+                     q = validate(doc, q, bodyEnd, keys, depth + 1, tooDeep);
+                  }
+               }
+               if(q == bodyEnd)
+               {
+                  rval = bodyEnd;
+               }
+            }
+         }
+      }
+      else if(tag == MO_BINARY_PACKED_ARRAY)
+      {
+         if(available >= 9)
+         {
+            uint32_t body = _readUInt32(data);
+            uint32_t count = _readUInt32(data + 4);
+            int type = (unsigned char)data[8];
+            const char* start = _getPackedStart(doc, data);
+            if(body <= available - 4 &&
+               type >= Int32 && type <= Double &&
+               start <= data + 4 + body &&
+               (uint64_t)count * _getFixedSize(type) ==
+                  (uint64_t)(data + 4 + body - start))
+            {
+               rval = data + 4 + body;
+            }
+         }
+      }
+   }
+
+   return rval;
+}
@@ -0,0 +1,282 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#ifndef monarch_data_binary_BinaryView_H
+#define monarch_data_binary_BinaryView_H
+
+#include "monarch/rt/DynamicObject.h"
+
+#include <inttypes.h>
+#include <cstddef>
+
+namespace monarch
+{
+namespace data
+{
+namespace binary
+{
+
+/**
+ * A BinaryView provides read-only access to a value in a document in the
+ * binary DynamicObject format (see BinaryFormat.h) without copying it.
+ *
+ * A document is opened by calling open() with a buffer that contains it,
+ * such as a memory-mapped file. open() validates the whole document once,
+ * after that values are read straight out of the buffer and no tree of
+ * DynamicObjects is built. Member lookups, for instance, use the key
+ * dictionary and skip over the values of other members without parsing them.
+ *
+ * A BinaryView is a small value that can be copied freely. It, and every
+ * view or string that is retrieved from it, is only valid as long as the
+ * buffer it was opened with.
+ *
+ * Example:
+ *
+ * BinaryView root;
+ * if(root.open(data, length))
+ * {
+ *    for(BinaryView v = root["items"].first(); v.isValid(); v = v.next())
+ *    {
+ *       printf("%s\n", v["name"].getString());
+ *    }
+ * }
+ */
+class BinaryView
+{
+protected:
+   /**
+    * The start of the document, NULL if this view is invalid.
+    */
+   const char* mDocument;
+
+   /**
+    * The type tag of the value.
+    */
+   int mTag;
+
+   /**
+    * The data of the value, which follows its tag.
+    */
+   const char* mData;
+
+   /**
+    * The member name of the value if it is in a Map, NULL if not.
+    */
+   const char* mName;
+
+   /**
+    * The end of the body of the container the value is in, used to find the
+    * next value.
+    */
+   const char* mEnd;
+
+   /**
+    * True if the value is an element of a packed Array and therefore has no
+    * tag of its own.
+    */
+   bool mPacked;
+
+public:
+   /**
+    * Creates a new, invalid BinaryView.
+    */
+   BinaryView();
+
+   /**
+    * Destructs this BinaryView.
+    */
+   virtual ~BinaryView();
+
+   /**
+    * Opens a document and sets this view to its root value. The whole
+    * document is validated so that it can be accessed safely afterwards,
+    * documents that nest Maps or Arrays deeper than MO_BINARY_MAX_DEPTH are
+    * rejected. The buffer is not copied and must not change or be freed while this view,
+    * or any view retrieved from it, is in use.
+    *
+    * @param b the buffer that contains the document.
+    * @param length the length of the buffer, which may be larger than the
+    *           document.
+    *
+    * @return true if successful, false if an exception occurred.
+    */
+   virtual bool open(const char* b, size_t length);
+
+   /**
+    * Returns true if this view refers to a value.
+    *
+    * @return true if this view is valid, false if not.
+    */
+   virtual bool isValid() const;
+
+   /**
+    * Returns true if the value is null.
+    *
+    * @return true if the value is null, false if not.
+    */
+   virtual bool isNull() const;
+
+   /**
+    * Gets the type of the value. A packed Array is an Array and null is a
+    * String.
+    *
+    * @return the type of the value.
+    */
+   virtual monarch::rt::DynamicObjectType getType() const;
+
+   /**
+    * Gets the member name of the value if it was retrieved from a Map.
+    *
+    * @return the member name or NULL.
+    */
+   virtual const char* getName() const;
+
+   /**
+    * Gets the length of the value. For a String this is the number of
+    * characters, for a Map or Array it is the number of members or
+    * elements, otherwise it is the size of the number, in bytes.
+    *
+    * @return the length of the value.
+    */
+   virtual int length() const;
+
+   /**
+    * Returns true if the value is a Map with the given member.
+    *
+    * @param name the name of the member.
+    *
+    * @return true if the member exists, false if not.
+    */
+   virtual bool hasMember(const char* name) const;
+
+   /**
+    * Gets a member of a Map.
+    *
+    * @param name the name of the member.
+    *
+    * @return a view of the member, invalid if it does not exist.
+    */
+   virtual BinaryView operator[](const char* name) const;
+
+   /**
+    * Gets an element of an Array. Each call skips over all of the previous
+    * elements, apart from in packed Arrays, so use first() and next() to
+    * visit every element.
+    *
+    * @param index the index of the element.
+    *
+    * @return a view of the element, invalid if it does not exist.
+    */
+   virtual BinaryView operator[](int index) const;
+
+   /**
+    * Gets the first member of a Map or element of an Array.
+    *
+    * @return a view of the first member or element, invalid if there is
+    *         none.
+    */
+   virtual BinaryView first() const;
+
+   /**
+    * Gets the member or element that follows this one in its Map or Array.
+    *
+    * @return a view of the next member or element, invalid if there is none.
+    */
+   virtual BinaryView next() const;
+
+   /**
+    * Gets the value of a String. The string is null-terminated and points
+    * into the document.
+    *
+    * @return the string or NULL if the value is not a String.
+    */
+   virtual const char* getString() const;
+
+   /**
+    * Gets the value as a boolean or a number, converting it if it has a
+    * different type. Strings are parsed and all other types are 0.
+    *
+    * @return the value.
+    */
+   virtual bool getBoolean() const;
+   virtual int32_t getInt32() const;
+   virtual uint32_t getUInt32() const;
+   virtual int64_t getInt64() const;
+   virtual uint64_t getUInt64() const;
+   virtual double getDouble() const;
+
+   /**
+    * Gets the type of the elements if the value is a packed Array.
+    *
+    * @return the element type or String if the value is not a packed Array.
+    */
+   virtual monarch::rt::DynamicObjectType getPackedType() const;
+
+   /**
+    * Gets the elements of a packed Array. They are stored contiguously, as
+    * little endian numbers, and are aligned if the document is aligned to
+    * at least 8 bytes.
+    *
+    * @return the elements or NULL if the value is not a packed Array.
+    */
+   virtual const void* getPackedData() const;
+
+   /**
+    * Copies the value into a DynamicObject, replacing its contents.
+    *
+    * @param dyno the DynamicObject to copy into.
+    */
+   virtual void copyTo(monarch::rt::DynamicObject& dyno) const;
+
+protected:
+   /**
+    * Gets the name of a key in the key dictionary.
+    *
+    * @param index the index of the key.
+    *
+    * @return the name of the key.
+    */
+   virtual const char* getKey(uint32_t index) const;
+
+   /**
+    * Gets the end of the value's data.
+    *
+    * @return the end of the value.
+    */
+   virtual const char* getValueEnd() const;
+
+   /**
+    * Creates a view of the member or element at the given position in the
+    * body of a Map or Array.
+    *
+    * @param container Map, Array or, for a packed Array, its element type.
+    * @param p the position of the member or element.
+    * @param end the end of the body.
+    *
+    * @return the view, invalid if p is at the end of the body.
+    */
+   virtual BinaryView getChild(
+      int container, const char* p, const char* end) const;
+
+   /**
+    * Validates a value.
+    *
+    * @param doc the start of the document.
+    * @param p the position of the value's tag.
+    * @param end the end of the document.
+    * @param keys the number of keys in the key dictionary.
+    * @param depth the nesting depth of the value, 0 for the root.
+    * @param tooDeep set to true if the value is invalid because it nests
+    *           Maps or Arrays deeper than MO_BINARY_MAX_DEPTH.
+    *
+    * @return the end of the value or NULL if it is invalid.
+    */
+   static const char* validate(
+      const char* doc, const char* p, const char* end, uint32_t keys,
+      int depth, bool& tooDeep);
+};
+
+} // end namespace binary
+} // end namespace data
+} // end namespace monarch
+#endif
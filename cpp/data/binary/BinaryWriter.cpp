@@ -0,0 +1,308 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#include "monarch/data/binary/BinaryWriter.h"
+
+#include "monarch/data/binary/BinaryFormat.h"
+#include "monarch/rt/DynamicObjectIterator.h"
+#include "monarch/util/Data.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+using namespace monarch::data;
+using namespace monarch::data::binary;
+using namespace monarch::io;
+using namespace monarch::rt;
+
+/**
+ * Compares two member names so that the key dictionary can be sorted.
+ *
+ * @param s1 the first name.
+ * @param s2 the second name.
+ *
+ * @return true if s1 < s2, false if not.
+ */
+static bool _compareKeys(const char* s1, const char* s2)
+{
+   return strcmp(s1, s2) < 0;
+}
+
+BinaryWriter::BinaryWriter() :
+   mBuffer(1024),
+   mOutput(NULL),
+   mStart(0)
+{
+}
+
+BinaryWriter::~BinaryWriter()
+{
+}
+
+void BinaryWriter::put(const void* b, int length)
+{
+   // grow geometrically, ByteBuffer only grows by what is needed
+   if(mOutput->freeSpace() < length)
+   {
+      int capacity = mOutput->capacity() * 2;
+      if(capacity < mOutput->length() + length)
+      {
+         capacity = mOutput->length() + length;
+      }
+      mOutput->resize(capacity);
+   }
+   mOutput->put(static_cast<const char*>(b), length, true);
+}
+
+void BinaryWriter::putUInt32(uint32_t value)
+{
+   value = MO_UINT32_TO_LE(value);
+   put(&value, 4);
+}
+
+void BinaryWriter::putUInt64(uint64_t value)
+{
+   value = MO_UINT64_TO_LE(value);
+   put(&value, 8);
+}
+
+void BinaryWriter::setUInt32(int offset, uint32_t value)
+{
+   value = MO_UINT32_TO_LE(value);
+   memcpy(mOutput->data() + mStart + offset, &value, 4);
+}
+
+int BinaryWriter::getOffset()
+{
+   return mOutput->length() - mStart;
+}
+
+void BinaryWriter::addKeys(DynamicObject& dyno)
+{
+   if(!dyno.isNull())
+   {
+      DynamicObjectType type = dyno->getType();
+      if(type == Map)
+      {
+         DynamicObjectIterator i = dyno.getIterator();
+         while(i->hasNext())
+         {
+            DynamicObject& next = i->next();
+            const char* name = i->getName();
+            if(mKeyMap.insert(make_pair(name, 0)).second)
+            {
+               mKeys.push_back(name);
+            }
+            addKeys(next);
+         }
+      }
+      else if(type == Array && dyno->getPackedData() == NULL)
+      {
+         DynamicObjectIterator i = dyno.getIterator();
+         while(i->hasNext())
+         {
+            addKeys(i->next());
+         }
+      }
+   }
+}
+
+void BinaryWriter::encodeValue(DynamicObject& dyno)
+{
+   unsigned char tag;
+   if(dyno.isNull())
+   {
+      tag = MO_BINARY_NULL;
+      put(&tag, 1);
+   }
+   else
+   {
+      DynamicObjectType type = dyno->getType();
+      tag = (type == Array && dyno->getPackedData() != NULL) ?
+         MO_BINARY_PACKED_ARRAY : type;
+      put(&tag, 1);
+
+      switch(tag)
+      {
+         case String:
+         {
+            const char* str = dyno->getString();
+            uint32_t length = strlen(str);
+            putUInt32(length);
+            put(str, length + 1);
+            break;
+         }
+         case Boolean:
+         {
+            unsigned char b = dyno->getBoolean() ? 1 : 0;
+            put(&b, 1);
+            break;
+         }
+         case Int32:
+            putUInt32((uint32_t)dyno->getInt32());
+            break;
+         case UInt32:
+            putUInt32(dyno->getUInt32());
+            break;
+         case Int64:
+            putUInt64((uint64_t)dyno->getInt64());
+            break;
+         case UInt64:
+            putUInt64(dyno->getUInt64());
+            break;
+         case Double:
+         {
+            double d = dyno->getDouble();
+            uint64_t bits;
+            memcpy(&bits, &d, 8);
+            putUInt64(bits);
+            break;
+         }
+         case Map:
+         case Array:
+         {
+            // reserve the body length, filled in once the body is written
+            int start = getOffset();
+            putUInt32(0);
+            putUInt32(dyno->length());
+
+            DynamicObjectIterator i = dyno.getIterator();
+            while(i->hasNext())
+            {
+               DynamicObject& next = i->next();
+               if(tag == Map)
+               {
+                  putUInt32(mKeyMap[i->getName()]);
+               }
+               encodeValue(next);
+            }
+            setUInt32(start, getOffset() - start - 4);
+            break;
+         }
+         case MO_BINARY_PACKED_ARRAY:
+         {
+            int start = getOffset();
+            DynamicObjectType packed = dyno->getPackedType();
+            uint32_t length = dyno->length();
+            putUInt32(0);
+            putUInt32(length);
+            unsigned char b = packed;
+            put(&b, 1);
+
+            // pad so the elements can be read in place
+            int pad = (MO_BINARY_PACKED_ALIGN -
+               getOffset() % MO_BINARY_PACKED_ALIGN) % MO_BINARY_PACKED_ALIGN;
+            uint64_t zero = 0;
+            put(&zero, pad);
+
+            const void* data = dyno->getPackedData();
+            if(packed == Int32 || packed == UInt32)
+            {
+#if BYTE_ORDER == LITTLE_ENDIAN
+               put(data, length * 4);
+#else
+               for(uint32_t n = 0; n < length; ++n)
+               {
+                  putUInt32(static_cast<const uint32_t*>(data)[n]);
+               }
+#endif
+            }
+            else
+            {
+#if BYTE_ORDER == LITTLE_ENDIAN
+               put(data, length * 8);
+#else
+               for(uint32_t n = 0; n < length; ++n)
+               {
+                  putUInt64(static_cast<const uint64_t*>(data)[n]);
+               }
+#endif
+            }
+            setUInt32(start, getOffset() - start - 4);
+            break;
+         }
+      }
+   }
+}
+
+bool BinaryWriter::write(DynamicObject& dyno, OutputStream* os)
+{
+   mBuffer.clear();
+   return
+      write(dyno, &mBuffer) &&
+      os->write(mBuffer.data(), mBuffer.length());
+}
+
+bool BinaryWriter::write(DynamicObject& dyno, ByteBuffer* b)
+{
+   mOutput = b;
+   mStart = b->length();
+   mKeyMap.clear();
+   mKeys.clear();
+
+   // build key dictionary, sorted so that readers can search it and so
+   // that the members of every map are in key index order
+   addKeys(dyno);
+   sort(mKeys.begin(), mKeys.end(), _compareKeys);
+   for(uint32_t i = 0; i < mKeys.size(); ++i)
+   {
+      mKeyMap[mKeys[i]] = i;
+   }
+
+   // write header, length and root offset are filled in at the end
+   put(MO_BINARY_MAGIC, MO_BINARY_MAGIC_LENGTH);
+   putUInt32(MO_BINARY_VERSION);
+   putUInt32(0);
+   putUInt32(mKeys.size());
+   putUInt32(0);
+
+   // write key offsets followed by the keys themselves
+   uint32_t offset = getOffset() + mKeys.size() * 4;
+   for(vector<const char*>::iterator i = mKeys.begin(); i != mKeys.end(); ++i)
+   {
+      putUInt32(offset);
+      offset += strlen(*i) + 1;
+   }
+   for(vector<const char*>::iterator i = mKeys.begin(); i != mKeys.end(); ++i)
+   {
+      put(*i, strlen(*i) + 1);
+   }
+
+   // write root value
+   setUInt32(16, getOffset());
+   encodeValue(dyno);
+   setUInt32(8, getOffset());
+
+   mOutput = NULL;
+   return true;
+}
+
+void BinaryWriter::setIndentation(int level, int spaces)
+{
+   // no indentation
+}
+
+void BinaryWriter::setCompact(bool compact)
+{
+   // always compact
+}
+
+bool BinaryWriter::writeToByteBuffer(DynamicObject dyno, ByteBuffer* b)
+{
+   BinaryWriter writer;
+   return writer.write(dyno, b);
+}
+
+string BinaryWriter::writeToString(DynamicObject dyno)
+{
+   string rval;
+
+   BinaryWriter writer;
+   if(writer.write(dyno, &writer.mBuffer))
+   {
+      rval.assign(writer.mBuffer.data(), writer.mBuffer.length());
+   }
+
+   return rval;
+}
@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#ifndef monarch_data_binary_BinaryWriter_H
+#define monarch_data_binary_BinaryWriter_H
+
+#include "monarch/data/DynamicObjectWriter.h"
+#include "monarch/io/ByteBuffer.h"
+
+#include <inttypes.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace monarch
+{
+namespace data
+{
+namespace binary
+{
+
+/**
+ * A BinaryWriter serializes DynamicObjects to a compact, type-tagged binary
+ * format (see BinaryFormat.h).
+ *
+ * Every member name is written only once, to a sorted key dictionary at the
+ * start of the document, and maps refer to their member names by index.
+ * Packed Arrays are written out as raw numbers. The document can be read back in
+ * with a BinaryReader or accessed in place with a BinaryView.
+ *
+ * A BinaryWriter encodes a whole object into memory before writing it out
+ * because the document starts with its length. It can be used again.
+ */
+class BinaryWriter : public DynamicObjectWriter
+{
+protected:
+   /**
+    * The buffer to encode into when writing to an OutputStream.
+    */
+   monarch::io::ByteBuffer mBuffer;
+
+   /**
+    * The buffer being encoded into.
+    */
+   monarch::io::ByteBuffer* mOutput;
+
+   /**
+    * The offset in the output buffer to the start of the document.
+    */
+   int mStart;
+
+   /**
+    * A map of member name to key dictionary index. Member names are interned
+    * so they can be compared by address.
+    */
+   typedef std::map<const char*, uint32_t> KeyMap;
+   KeyMap mKeyMap;
+
+   /**
+    * The member names in the key dictionary, sorted by name.
+    */
+   std::vector<const char*> mKeys;
+
+   /**
+    * Adds the member names of the passed object and all of its children to
+    * the key dictionary.
+    *
+    * @param dyno the DynamicObject to get the member names from.
+    */
+   virtual void addKeys(monarch::rt::DynamicObject& dyno);
+
+   /**
+    * Encodes a value.
+    *
+    * @param dyno the DynamicObject to encode.
+    */
+   virtual void encodeValue(monarch::rt::DynamicObject& dyno);
+
+   /**
+    * Appends bytes to the output buffer.
+    *
+    * @param b the bytes to append.
+    * @param length the number of bytes.
+    */
+   virtual void put(const void* b, int length);
+
+   /**
+    * Appends a number to the output buffer as little endian.
+    *
+    * @param value the number to append.
+    */
+   virtual void putUInt32(uint32_t value);
+   virtual void putUInt64(uint64_t value);
+
+   /**
+    * Overwrites a number that was previously reserved in the output buffer.
+    *
+    * @param offset the offset to the number from the start of the document.
+    * @param value the number to write.
+    */
+   virtual void setUInt32(int offset, uint32_t value);
+
+   /**
+    * Gets the current offset from the start of the document.
+    *
+    * @return the current offset.
+    */
+   virtual int getOffset();
+
+public:
+   /**
+    * Creates a new BinaryWriter.
+    */
+   BinaryWriter();
+
+   /**
+    * Destructs this BinaryWriter.
+    */
+   virtual ~BinaryWriter();
+
+   /**
+    * Serializes an object to the binary format.
+    *
+    * @param dyno the DynamicObject to serialize.
+    * @param os the OutputStream to write to.
+    *
+    * @return true if successful, false if an exception occurred.
+    */
+   virtual bool write(
+      monarch::rt::DynamicObject& dyno, monarch::io::OutputStream* os);
+
+   /**
+    * Serializes an object to the binary format, appending it to a buffer.
+    *
+    * @param dyno the DynamicObject to serialize.
+    * @param b the ByteBuffer to append to, which will be resized as needed.
+    *
+    * @return true if successful, false if an exception occurred.
+    */
+   virtual bool write(
+      monarch::rt::DynamicObject& dyno, monarch::io::ByteBuffer* b);
+
+   /**
+    * Does nothing, the binary format is not indented.
+    *
+    * @param level the starting indentation level.
+    * @param spaces the number of spaces per indentation level.
+    */
+   virtual void setIndentation(int level, int spaces);
+
+   /**
+    * Does nothing, the binary format is always compact.
+    *
+    * @param compact true to minimize whitespace, false not to.
+    */
+   virtual void setCompact(bool compact);
+
+   /**
+    * Writes a DynamicObject in the binary format to a ByteBuffer.
+    *
+    * @param dyno the DynamicObject to write out.
+    * @param b the ByteBuffer to append to.
+    *
+    * @return true on success, false with exception set on failure.
+    */
+   static bool writeToByteBuffer(
+      monarch::rt::DynamicObject dyno, monarch::io::ByteBuffer* b);
+
+   /**
+    * Writes a DynamicObject in the binary format to a string.
+    *
+    * @param dyno the DynamicObject to write out.
+    *
+    * @return the string with the binary data on success, a blank string with
+    *         exception set on failure.
+    */
+   static std::string writeToString(monarch::rt::DynamicObject dyno);
+};
+
+} // end namespace binary
+} // end namespace data
+} // end namespace monarch
+#endif
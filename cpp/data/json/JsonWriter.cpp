@@ -1,6 +1,8 @@
 /*
- * Copyright (c) 2007-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2007-2011 Digital Bazaar, Inc. All rights reserved.
  */
+#define __STDC_FORMAT_MACROS
+
 #include "monarch/data/json/JsonWriter.h"
 
 #include "monarch/rt/DynamicObjectIterator.h"
@@ -11,6 +13,7 @@
 #include <iostream>
 #include <sstream>
 #include <cstdio>
+#include <inttypes.h>
 
 using namespace std;
 using namespace monarch::data;
@@ -18,6 +21,49 @@ using namespace monarch::data::json;
 using namespace monarch::io;
 using namespace monarch::rt;
 
+/**
+ * Formats an element of a packed array the same way that
+ * DynamicObjectImpl::getString() formats a number.
+ *
+ * @param buf the buffer to write to, at least 50 bytes.
+ * @param type the type of the elements.
+ * @param data the elements.
+ * @param index the index of the element.
+ *
+ * @return the length of the formatted element.
+ */
+static int _formatPackedElement(
+   char* buf, DynamicObjectType type, const void* data, int index)
+{
+   int rval;
+
+   switch(type)
+   {
+      case Int32:
+         rval = snprintf(
+            buf, 50, "%" PRIi32, static_cast<const int32_t*>(data)[index]);
+         break;
+      case UInt32:
+         rval = snprintf(
+            buf, 50, "%" PRIu32, static_cast<const uint32_t*>(data)[index]);
+         break;
+      case Int64:
+         rval = snprintf(
+            buf, 50, "%" PRIi64, static_cast<const int64_t*>(data)[index]);
+         break;
+      case UInt64:
+         rval = snprintf(
+            buf, 50, "%" PRIu64, static_cast<const uint64_t*>(data)[index]);
+         break;
+      default:
+         rval = snprintf(
+            buf, 50, "%e", static_cast<const double*>(data)[index]);
+         break;
+   }
+
+   return rval;
+}
+
 JsonWriter::JsonWriter(bool strict)
 {
    mStrict = strict;
@@ -187,25 +233,54 @@ bool JsonWriter::write(DynamicObject& dyno, OutputStream* os, int level)
             rval = (mCompact || dyno->length() == 0) ?
                os->write("[", 1) : os->write("[\n", 2);
 
-            // serialize each array element
-            DynamicObjectIterator i = dyno.getIterator();
-            while(rval && i->hasNext())
+            // serialize packed elements without creating DynamicObjects
+            const void* data = dyno->getPackedData();
+            if(data != NULL)
             {
-               // serialize indentation and array value
-               rval =
-                  writeIndentation(os, level + 1) &&
-                  write(i->next(), os, level + 1);
-
-               // serialize delimiter if appropriate
-               if(rval && i->hasNext())
+               DynamicObjectType type = dyno->getPackedType();
+               int length = dyno->length();
+               char buf[50];
+               for(int n = 0; rval && n < length; ++n)
                {
-                  rval = os->write(",", 1);
-               }
+                  rval =
+                     writeIndentation(os, level + 1) &&
+                     os->write(buf, _formatPackedElement(buf, type, data, n));
+
+                  // serialize delimiter if appropriate
+                  if(rval && n < length - 1)
+                  {
+                     rval = os->write(",", 1);
+                  }
 
-               // add formatting if appropriate
-               if(rval && !mCompact)
+                  // add formatting if appropriate
+                  if(rval && !mCompact)
+                  {
+                     rval = os->write("\n", 1);
+                  }
+               }
+            }
+            else
+            {
+               // serialize each array element
+               DynamicObjectIterator i = dyno.getIterator();
+               while(rval && i->hasNext())
                {
-                  rval = os->write("\n", 1);
+                  // serialize indentation and array value
+                  rval =
+                     writeIndentation(os, level + 1) &&
+                     write(i->next(), os, level + 1);
+
+                  // serialize delimiter if appropriate
+                  if(rval && i->hasNext())
+                  {
+                     rval = os->write(",", 1);
+                  }
+
+                  // add formatting if appropriate
+                  if(rval && !mCompact)
+                  {
+                     rval = os->write("\n", 1);
+                  }
                }
             }
 
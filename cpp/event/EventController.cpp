@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2007-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2007-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #include "monarch/event/EventController.h"
 
@@ -11,7 +11,8 @@ using namespace monarch::rt;
 
 #define TOPLEVEL_ID 1
 
-EventController::EventController()
+EventController::EventController() :
+   mMapLock(true)
 {
    // ensure event type map's type is set
    mTypeMap->setType(Map);
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2007-2009 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2007-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #ifndef monarch_event_EventController_H
 #define monarch_event_EventController_H
@@ -38,7 +38,8 @@ protected:
    EventId mNextEventId;
 
    /**
-    * A lock for manipulating the type map.
+    * A lock for manipulating the type map. It is a big reader lock, new
+    * event types are rare but the map is read for every event.
     */
    monarch::rt::SharedLock mMapLock;
 
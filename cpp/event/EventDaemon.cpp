@@ -1,49 +1,53 @@
 /*
- * Copyright (c) 2008-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2008-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #include "monarch/event/EventDaemon.h"
 
-#include "monarch/util/Timer.h"
+#include "monarch/rt/RunnableDelegate.h"
 
 using namespace std;
 using namespace monarch::event;
-using namespace monarch::modest;
 using namespace monarch::rt;
-using namespace monarch::util;
 
 EventDaemon::EventData::EventData(Event& e, uint32_t i, int c, int r) :
    event(e),
    cloned(e.clone())
 {
-   interval = remaining = i;
+   interval = i;
    count = c;
    refs = r;
+
+   // the cloned event is cloned again each time it is scheduled
+   cloned.freeze();
 }
 
-EventDaemon::EventDaemon()
+EventDaemon::EventDaemon() :
+   mTimers(NULL),
+   mEventController(NULL)
 {
    mRunning = false;
-   mStartWaitTime = 0;
-   mScheduleEvents = true;
 }
 
 EventDaemon::~EventDaemon()
 {
    EventDaemon::stop();
+   EventDaemon::reset();
 }
 
 void EventDaemon::reset()
 {
-   // lock to clear all events and notify
+   // lock to remove all events
    mLock.lock();
    {
-      mEvents.clear();
-      mLock.notifyAll();
+      while(!mEvents.empty())
+      {
+         removeEvent(mEvents.begin());
+      }
    }
    mLock.unlock();
 }
 
-void EventDaemon::start(OperationRunner* opRunner, EventController* ec)
+void EventDaemon::start(EventController* ec)
 {
    // lock to start event daemon
    mLock.lock();
@@ -53,13 +57,13 @@ void EventDaemon::start(OperationRunner* opRunner, EventController* ec)
          // store event controller
          mEventController = ec;
 
-         // daemon should try to schedule events
-         mScheduleEvents = true;
-
-         // run daemon on an operation
-         mOperation = *this;
-         opRunner->runOperation(mOperation);
+         // schedule the timers of all events on the shared wheel
+         mTimers = TimingWheel::acquireShared();
          mRunning = true;
+         for(EventList::iterator i = mEvents.begin(); i != mEvents.end(); ++i)
+         {
+            scheduleTimer(*i);
+         }
       }
    }
    mLock.unlock();
@@ -67,24 +71,34 @@ void EventDaemon::start(OperationRunner* opRunner, EventController* ec)
 
 void EventDaemon::stop()
 {
+   TimingWheel* timers = NULL;
+
    // lock to stop event daemon
    mLock.lock();
    {
       if(mRunning)
       {
-         // interrupt daemon
-         mOperation->interrupt();
-
-         // wait for daemon to finish
-         mLock.unlock();
-         mOperation->waitFor();
-         mLock.lock();
+         // cancel the timers of all events, but keep the events
+         for(EventList::iterator i = mEvents.begin(); i != mEvents.end(); ++i)
+         {
+            mTimers->cancel((*i)->timer);
+            (*i)->timer.setNull();
+         }
+         timers = mTimers;
+         mTimers = NULL;
 
          // no longer running
          mRunning = false;
       }
    }
    mLock.unlock();
+
+   if(timers != NULL)
+   {
+      // wait for an event timer that is already running to finish
+      timers->synchronize();
+      TimingWheel::releaseShared();
+   }
 }
 
 void EventDaemon::add(Event& e, uint32_t interval, int count, int refs)
@@ -103,18 +117,18 @@ void EventDaemon::add(Event& e, uint32_t interval, int count, int refs)
                 !found && i != mEvents.end(); ++i)
             {
                // check interval first, it is a faster comparison
-               if(i->interval == interval && i->event == e)
+               if((*i)->interval == interval && (*i)->event == e)
                {
                   // event found
                   found = true;
 
                   // increment its references
-                  i->refs += refs;
+                  (*i)->refs += refs;
 
                   // update its count if not infinite
-                  if(i->count != -1)
+                  if((*i)->count != -1)
                   {
-                     i->count = (count == -1 ? -1 : i->count + count);
+                     (*i)->count = (count == -1 ? -1 : (*i)->count + count);
                   }
                }
             }
@@ -123,13 +137,16 @@ void EventDaemon::add(Event& e, uint32_t interval, int count, int refs)
          if(!found)
          {
             // create event data and add to the list
-            EventData ed(e, interval, count, (refs == 0 ? 1 : refs));
-            mEvents.push_back(ed);
-         }
+            EventDataRef ed = new EventData(
+               e, interval, count, (refs == 0 ? 1 : refs));
+            ed->position = mEvents.insert(mEvents.end(), ed);
 
-         // notify daemon to try to schedule events
-         mScheduleEvents = true;
-         mLock.notifyAll();
+            // schedule the event every interval
+            if(mRunning)
+            {
+               scheduleTimer(ed);
+            }
+         }
       }
       mLock.unlock();
    }
@@ -144,23 +161,23 @@ void EventDaemon::remove(const char* type, int refs)
       for(EventList::iterator i = mEvents.begin();
           i != mEvents.end() && refs >= 0;)
       {
-         if(strcmp(i->event["type"]->getString(), type) == 0)
+         if(strcmp((*i)->event["type"]->getString(), type) == 0)
          {
             // event found:
 
             // remove it entirely
             if(refs == 0)
             {
-               i = mEvents.erase(i);
+               i = removeEvent(i);
             }
             // decrement its references
             else
             {
-               i->refs -= refs;
-               if(i->refs <= 0)
+               (*i)->refs -= refs;
+               if((*i)->refs <= 0)
                {
                   // remove it
-                  i = mEvents.erase(i);
+                  i = removeEvent(i);
                }
                else
                {
@@ -175,10 +192,6 @@ void EventDaemon::remove(const char* type, int refs)
             ++i;
          }
       }
-
-      // notify daemon to try to schedule events
-      mScheduleEvents = true;
-      mLock.notifyAll();
    }
    mLock.unlock();
 }
@@ -193,7 +206,7 @@ void EventDaemon::remove(Event& e, int refs)
       for(EventList::iterator i = mEvents.begin();
           !found && i != mEvents.end() && refs >= 0; ++i)
       {
-         if(i->event == e)
+         if((*i)->event == e)
          {
             // event found
             found = true;
@@ -201,24 +214,20 @@ void EventDaemon::remove(Event& e, int refs)
             // remove it entirely
             if(refs == 0)
             {
-               mEvents.erase(i);
+               removeEvent(i);
             }
             // decrement its references
             else
             {
-               i->refs -= refs;
-               if(i->refs <= 0)
+               (*i)->refs -= refs;
+               if((*i)->refs <= 0)
                {
                   // remove it
-                  mEvents.erase(i);
+                  removeEvent(i);
                }
             }
          }
       }
-
-      // notify daemon to try to schedule events
-      mScheduleEvents = true;
-      mLock.notifyAll();
    }
    mLock.unlock();
 }
@@ -233,7 +242,7 @@ void EventDaemon::remove(Event& e, uint32_t interval, int refs)
       for(EventList::iterator i = mEvents.begin();
           !found && i != mEvents.end(); ++i)
       {
-         if(i->event == e && i->interval == interval)
+         if((*i)->event == e && (*i)->interval == interval)
          {
             // event found
             found = true;
@@ -241,116 +250,67 @@ void EventDaemon::remove(Event& e, uint32_t interval, int refs)
             // remove it entirely
             if(refs == 0)
             {
-               mEvents.erase(i);
+               removeEvent(i);
             }
             // decrement its references
             else
             {
-               i->refs -= refs;
-               if(i->refs <= 0)
+               (*i)->refs -= refs;
+               if((*i)->refs <= 0)
                {
                   // remove it
-                  mEvents.erase(i);
+                  removeEvent(i);
                }
             }
          }
       }
-
-      // notify daemon to try to schedule events
-      mScheduleEvents = true;
-      mLock.notifyAll();
    }
    mLock.unlock();
 }
 
-void EventDaemon::run()
+void EventDaemon::scheduleTimer(EventDataRef& ed)
 {
-   while(!mOperation->isInterrupted())
-   {
-      // lock to schedule events
-      mLock.lock();
+   // assume lock is engaged
+   RunnableRef r = new RunnableDelegate<EventDaemon, EventDataRef>(
+      this, &EventDaemon::scheduleEvent, ed);
+   ed->timer = mTimers->schedule(
+      r, ed->interval, (ed->interval == 0 ? 1 : ed->interval));
+}
 
-      if(mEvents.empty())
-      {
-         // wait until notified or interrupted
-         mStartWaitTime = 0;
-         mLock.wait();
-      }
-      else
+void EventDaemon::scheduleEvent(EventDataRef ed)
+{
+   // lock to schedule the event
+   mLock.lock();
+   {
+      // the event may have been removed or this daemon stopped since its
+      // timer was found to be due
+      if(!ed->timer.isNull())
       {
-         // FIXME: this algorithm may be optimized such that every
-         // iteration does not require passing over the entire loop --
-         // this can be done by sorting according to time remaining
-         // until the next event is scheduled
-
-         // get the amount of time that has been waited, restart wait time
-         uint32_t waited = (mStartWaitTime == 0 ?
-            0 : Timer::getMilliseconds(mStartWaitTime));
-         mStartWaitTime = Timer::startTiming();
+         // schedule a clone of the event
+         Event clone = ed->cloned.clone();
+         mEventController->schedule(clone);
 
-         // iterate over event heap, scheduling all events that have waited
-         // for their intervals, removing all non-repetitious events, and
-         // keeping track of the new wait time
-         Event clone;
-         uint32_t waitTime = 0;
-         for(EventList::iterator i = mEvents.begin(); i != mEvents.end();)
+         // decrement count as appropriate, remove the event once it has
+         // been scheduled as many times as requested
+         if(ed->count > 0 && --ed->count == 0)
          {
-            // remove the event if count has reached 0
-            if(i->count == 0)
-            {
-               i = mEvents.erase(i);
-            }
-            else
-            {
-               // if remaining time is less than or equal to waiting time
-               if(i->remaining <= waited)
-               {
-                  // schedule event, reset remaining time
-                  clone = i->cloned.clone();
-                  mEventController->schedule(clone);
-                  i->remaining = i->interval;
-
-                  // decrement count as appropriate
-                  if(i->count > 0)
-                  {
-                     i->count--;
-                  }
-               }
-               else
-               {
-                  // update remaining time
-                  i->remaining -= waited;
-               }
-
-               // update wait time
-               if(waitTime == 0 || i->remaining < waitTime)
-               {
-                  waitTime = i->remaining;
-               }
-
-               // increment iterator
-               ++i;
-            }
-         }
-
-         // turn off scheduling events to try to wait for whole wait time
-         mScheduleEvents = false;
-
-         // wait if appropriate
-         if(waitTime > 0)
-         {
-            // shave off time spent in loop
-            waited = Timer::getMilliseconds(mStartWaitTime);
-            waitTime = (waited >= waitTime ? 0 : waitTime - waited);
-            if(waitTime > 0)
-            {
-               mStartWaitTime += waited;
-               mLock.wait(waitTime, &mScheduleEvents, true);
-            }
+            removeEvent(ed->position);
          }
       }
+   }
+   mLock.unlock();
+}
 
-      // unlock to allow daemon modification
-      mLock.unlock();
+EventDaemon::EventList::iterator EventDaemon::removeEvent(
+   EventList::iterator i)
+{
+   // cancel the timer and drop it, which also frees the event data once
+   // the timer is no longer running
+   EventDataRef& ed = *i;
+   if(!ed->timer.isNull())
+   {
+      mTimers->cancel(ed->timer);
+      ed->timer.setNull();
    }
+   return mEvents.erase(i);
 }
@@ -1,10 +1,11 @@
 /*
- * Copyright (c) 2008-2009 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2008-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #ifndef monarch_event_EventDaemon_H
 #define monarch_event_EventDaemon_H
 
 #include "monarch/event/EventController.h"
+#include "monarch/rt/TimingWheel.h"
 
 namespace monarch
 {
@@ -16,34 +17,47 @@ namespace event
  * EventController. Events to be scheduled can be added as one-time events or
  * as repeating events.
  *
+ * While the daemon is running, each added event is a periodic timer on the
+ * shared TimingWheel, so finding due events does not require scanning all
+ * of the added events or a thread for the daemon.
+ *
  * @author Dave Longley
  */
-class EventDaemon : public monarch::rt::Runnable
+class EventDaemon
 {
 protected:
    /**
     * EventData contains the information needed to schedule an event. This
     * includes an event to be scheduled, the scheduling interval in
-    * milliseconds, the number of times to schedule the event, and how much
-    * time remains until the event is scheduled again.
+    * milliseconds, the number of times to schedule the event, and the timer
+    * that schedules it, which is null once the event has been removed.
     */
+   struct EventData;
+   typedef monarch::rt::Collectable<EventData> EventDataRef;
+   typedef std::list<EventDataRef> EventList;
    struct EventData
    {
       Event event;
       Event cloned;
       uint32_t interval;
       int count;
-      uint32_t remaining;
       int refs;
+      monarch::rt::TimingWheel::TimerRef timer;
+      EventList::iterator position;
       EventData(Event& e, uint32_t i, int c, int r);
    };
 
    /**
     * A list of event data.
     */
-   typedef std::list<EventData> EventList;
    EventList mEvents;
 
+   /**
+    * The shared TimingWheel with the timers for the events, NULL while this
+    * daemon is not running.
+    */
+   monarch::rt::TimingWheel* mTimers;
+
    /**
     * A lock for modifying the EventList and waiting.
     */
@@ -55,24 +69,33 @@ protected:
    EventController* mEventController;
 
    /**
-    * The operation running this daemon.
+    * Set to true when this daemon is running.
     */
-   monarch::modest::Operation mOperation;
+   bool mRunning;
 
    /**
-    * Set to true when this daemon is running.
+    * Schedules the timer for an event. The lock must be engaged and this
+    * daemon must be running.
+    *
+    * @param ed the event data for the event.
     */
-   bool mRunning;
+   virtual void scheduleTimer(EventDataRef& ed);
 
    /**
-    * The time at which this daemon started waiting.
+    * Schedules an event when its timer is due.
+    *
+    * @param ed the event data for the event.
     */
-   uint64_t mStartWaitTime;
+   virtual void scheduleEvent(EventDataRef ed);
 
    /**
-    * True if the daemon should try to schedule events, false if not.
+    * Removes an event and cancels its timer. The lock must be engaged.
+    *
+    * @param i the event data for the event.
+    *
+    * @return the next event data.
     */
-   bool mScheduleEvents;
+   virtual EventList::iterator removeEvent(EventList::iterator i);
 
 public:
    /**
@@ -95,12 +118,9 @@ public:
     * EventController according to how they were added. More events may be
     * added or removed while the EventDaemon is running.
     *
-    * @param opRunner the OperationRunner to use to run this daemon.
     * @param ec the EventController to use.
     */
-   virtual void start(
-      monarch::modest::OperationRunner* opRunner,
-      EventController* ec);
+   virtual void start(EventController* ec);
 
    /**
     * Stops this EventDaemon. Events will no longer be scheduled but they will
@@ -154,11 +174,6 @@ public:
     *             remove some references for the given event.
     */
    virtual void remove(Event& e, uint32_t interval, int refs = 0);
-
-   /**
-    * Runs this daemon.
-    */
-   virtual void run();
 };
 
 } // end namespace event
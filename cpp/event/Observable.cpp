@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2007-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2007-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #define __STDC_LIMIT_MACROS
 
@@ -19,7 +19,8 @@ using namespace monarch::rt;
 
 Observable::Observable() :
    mDispatch(false),
-   mSequenceId(0)
+   mSequenceId(0),
+   mQueueLock(true)
 {
 }
 
@@ -323,6 +324,7 @@ void Observable::start(OperationRunner* opRunner)
          mOpRunner = opRunner;
          mDispatch = true;
          mOperation = *this;
+         mOperation->setType("monarch.event.Observable");
          opRunner->runOperation(mOperation);
       }
    }
@@ -455,6 +457,7 @@ void Observable::dispatchEvent(
                         RunnableRef ed = new ObserverDelegate<Observer>(*li, e);
                         Operation op(ed);
                         op->setUserData(*li);
+                        op->setType("monarch.event.Observer");
                         mOpRunner->runOperation(op);
 
                         // add all operations to the current operation list
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2007-2009 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2007-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #ifndef monarch_event_Observable_H
 #define monarch_event_Observable_H
@@ -117,7 +117,8 @@ protected:
 
    /**
     * The queue lock is engaged while the event queue is being updated
-    * or examined.
+    * or examined. It is adaptive because it is only held briefly by every
+    * thread that schedules an event.
     */
    monarch::rt::ExclusiveLock mQueueLock;
 
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2009 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2009-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #include "monarch/fiber/Fiber.h"
 
@@ -12,7 +12,8 @@ using namespace monarch::rt;
 
 Fiber::Fiber(size_t stackSize) :
    mId(0),
-   mState(Fiber::New)
+   mState(Fiber::New),
+   mLastWorker(-1)
 {
    mStackSize = (stackSize == 0 ? DEFAULT_STACK_SIZE : stackSize);
 }
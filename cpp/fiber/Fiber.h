@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2009 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2009-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #ifndef monarch_fiber_Fiber_H
 #define monarch_fiber_Fiber_H
@@ -79,6 +79,19 @@ protected:
     */
    FiberContext mContext;
 
+   /**
+    * The index of the scheduler thread that last ran this Fiber, -1 if it
+    * has not run yet. A Fiber is run on the same thread again unless
+    * another thread is idle.
+    */
+   int mLastWorker;
+
+   /**
+    * FiberScheduler is a friend so that it can keep track of the thread
+    * that last ran this Fiber.
+    */
+   friend class FiberScheduler;
+
 public:
    /**
     * Creates a new Fiber with the specified stack size.
@@ -1,14 +1,48 @@
 /*
- * Copyright (c) 2009 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2009-2011 Digital Bazaar, Inc. All rights reserved.
  */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include "monarch/fiber/FiberContext.h"
 
 #include "monarch/fiber/Fiber.h"
 #include <cstring>
+#include <inttypes.h>
+
+#if !defined(__x86_64__) && !defined(__aarch64__)
+#undef MO_FIBER_ASM_CONTEXT
+#endif
 
 using namespace monarch::fiber;
 
+#ifdef MO_FIBER_ASM_CONTEXT
+extern "C"
+{
+/**
+ * Saves the callee-saved registers on the current stack, stores the stack
+ * pointer in "out" and then restores the registers saved on the "in" stack
+ * and returns there. Implemented in FiberContextAsm.S.
+ *
+ * @param out where to store the current stack pointer.
+ * @param in the stack pointer to swap in.
+ */
+void monarch_fiber_swap_context(void** out, void* in);
+
+/**
+ * The first code run on a new fiber's stack. It calls the function that was
+ * saved in the initial frame with the saved argument. Implemented in
+ * FiberContextAsm.S.
+ */
+void monarch_fiber_start_context();
+}
+#endif
+
 FiberContext::FiberContext() :
+   mStackPointer(NULL),
+   mStack(NULL),
+   mStackSize(0),
    mAllocatedStack(false),
    mBack(NULL)
 {
@@ -20,10 +54,10 @@ FiberContext::~FiberContext()
    {
 #ifdef WIN32
       // clean up stack
-      free(mUserContext.uc_stack.ss_sp);
+      free(mStack);
 #else
       // clean up stack
-      munmap(mUserContext.uc_stack.ss_sp, mUserContext.uc_stack.ss_size);
+      munmap(mStack, mStackSize);
 #endif
    }
 }
@@ -67,12 +101,42 @@ bool FiberContext::init(Fiber* fiber)
 
    if(mAllocatedStack)
    {
+      mStack = stack;
+      mStackSize = fiber->getStackSize();
+
+#ifdef MO_FIBER_ASM_CONTEXT
+      // build the frame that monarch_fiber_swap_context() expects at the
+      // 16-byte aligned top of the stack, it "returns" to the start routine
+      // which calls startFiber(fiber)
+      uintptr_t top = ((uintptr_t)stack + mStackSize) & ~(uintptr_t)15;
+#if defined(__x86_64__)
+      // mxcsr and x87 control word, r15, r14, r13, r12, rbx, rbp, return
+      // address, with the stack 16-byte aligned after the return
+      uint64_t* sp = (uint64_t*)(top - 16) - 8;
+      sp[0] = 0x1F80 | ((uint64_t)0x037F << 32);
+      sp[1] = 0;
+      sp[2] = 0;
+      sp[3] = (uint64_t)startFiber;
+      sp[4] = (uint64_t)fiber;
+      sp[5] = 0;
+      sp[6] = 0;
+      sp[7] = (uint64_t)monarch_fiber_start_context;
+#else
+      // x19-x28, x29 (frame pointer), x30 (return address), d8-d15
+      uint64_t* sp = (uint64_t*)top - 20;
+      memset(sp, 0, 20 * sizeof(uint64_t));
+      sp[0] = (uint64_t)fiber;
+      sp[1] = (uint64_t)startFiber;
+      sp[11] = (uint64_t)monarch_fiber_start_context;
+#endif
+      mStackPointer = sp;
+#else
       // get the current context
       getcontext(&mUserContext);
 
       // set the new stack location and size
-      mUserContext.uc_stack.ss_sp = stack;
-      mUserContext.uc_stack.ss_size = fiber->getStackSize();
+      mUserContext.uc_stack.ss_sp = mStack;
+      mUserContext.uc_stack.ss_size = mStackSize;
 #if !defined(MACOS)
       mUserContext.uc_stack.ss_flags = 0;
       mUserContext.uc_link = NULL;
@@ -80,6 +144,7 @@ bool FiberContext::init(Fiber* fiber)
 
       // write the new stack location, etc. to this context
       makecontext(&mUserContext, (void (*)())startFiber, 1, fiber);
+#endif
    }
 
    return mAllocatedStack;
@@ -88,7 +153,11 @@ bool FiberContext::init(Fiber* fiber)
 inline void FiberContext::swap(FiberContext* in)
 {
    in->mBack = this;
+#ifdef MO_FIBER_ASM_CONTEXT
+   monarch_fiber_swap_context(&mStackPointer, in->mStackPointer);
+#else
    swapcontext(&mUserContext, &in->mUserContext);
+#endif
 }
 
 inline void FiberContext::swapBack()
@@ -98,5 +167,11 @@ inline void FiberContext::swapBack()
 
 inline void FiberContext::loadBack()
 {
+#ifdef MO_FIBER_ASM_CONTEXT
+   // this context is never resumed, so its stack pointer is discarded
+   void* discard;
+   monarch_fiber_swap_context(&discard, mBack->mStackPointer);
+#else
    setcontext(&mBack->mUserContext);
+#endif
 }
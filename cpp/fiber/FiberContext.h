@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2009 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2009-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #ifndef monarch_fiber_FiberContext_H
 #define monarch_fiber_FiberContext_H
@@ -16,6 +16,8 @@
   #include <sys/mman.h>
 #endif
 
+#include <cstddef>
+
 namespace monarch
 {
 namespace fiber
@@ -34,6 +36,13 @@ class Fiber;
  * in so that it may continue executing where it left off. This swapping is
  * done in user-space, thus saving any kernel-level overhead.
  *
+ * When monarch is configured with MO_FIBER_ASM_CONTEXT (the default on
+ * x86_64 and aarch64), contexts are switched by a small assembly routine that
+ * only saves the callee-saved registers on the stack being swapped out.
+ * Unlike swapcontext(), it does not save or restore the signal mask, so it
+ * does not make a system call on every switch. Fibers must therefore not
+ * change the signal mask of the thread they are running on.
+ *
  * @author Dave Longley
  */
 class FiberContext
@@ -44,6 +53,21 @@ protected:
     */
    ucontext_t mUserContext;
 
+   /**
+    * The saved stack pointer when the assembly context switch is used.
+    */
+   void* mStackPointer;
+
+   /**
+    * The allocated stack, NULL if none.
+    */
+   void* mStack;
+
+   /**
+    * The size of the allocated stack.
+    */
+   size_t mStackSize;
+
    /**
     * Set to true if this context has an allocated stack.
     */
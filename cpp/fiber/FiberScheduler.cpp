@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2009-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2009-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #include "monarch/fiber/FiberScheduler.h"
 
@@ -15,9 +15,33 @@ using namespace monarch::rt;
 // max fiber ID is MAX(uint32)
 #define MAX_FIBER_ID 0xFFFFFFFF
 
+// the number of fibers that fit on a worker's queue
+#define WORKER_QUEUE_SIZE 1024
+
+// the most fibers a worker moves to its queue from another queue at once
+#define MAX_TRANSFER 32
+
+// how often (in scheduled fibers) a worker checks the shared queue before
+// its own so that new fibers are not starved by busy workers
+#define SHARED_QUEUE_INTERVAL 61
+
+FiberScheduler::Worker::Worker(unsigned int index) :
+   index(index),
+   queue(WORKER_QUEUE_SIZE),
+   ticks(0),
+   seed(index * 2654435761U + 1)
+{
+}
+
 FiberScheduler::FiberScheduler() :
+   mWorkers(NULL),
+   mWorkerCount(0),
+   mClaimedWorkers(0),
    mNextFiberId(1),
-   mCheckFiberMap(false)
+   mCheckFiberMap(false),
+   mQueuedFibers(0),
+   mSleepingFibers(64),
+   mIdleWorkers(0)
 {
 }
 
@@ -37,11 +61,21 @@ FiberScheduler::~FiberScheduler()
 
 void FiberScheduler::start(OperationRunner* opRunner, int numOps)
 {
+   // create a worker for each Operation
+   mWorkers = new Worker*[numOps];
+   for(int i = 0; i < numOps; ++i)
+   {
+      mWorkers[i] = new Worker(i);
+   }
+   mWorkerCount = numOps;
+   mClaimedWorkers = 0;
+
    // create "numOps" Operations
    for(int i = 0; i < numOps; ++i)
    {
       // create Operation
       Operation op(*this);
+      op->setType("monarch.fiber.FiberScheduler");
       mOpList.add(op);
    }
 
@@ -54,13 +88,37 @@ inline void FiberScheduler::stop()
    // terminate all operations
    mOpList.terminate();
 
-   // delete all thread contexts
-   for(ContextList::iterator i = mContextList.begin();
-       i != mContextList.end(); ++i)
+   // move the fibers left on the workers' queues to the shared queue so
+   // that they run if this scheduler is started again, then delete the
+   // workers
+   mScheduleLock.lock();
    {
-      delete *i;
+      for(unsigned int i = 0; i < mWorkerCount; ++i)
+      {
+         Fiber* fiber;
+         while(mWorkers[i]->queue.pop(fiber))
+         {
+            fiber->mLastWorker = -1;
+            mFiberQueue.push_back(fiber);
+            ++mQueuedFibers;
+         }
+         delete mWorkers[i];
+      }
+      delete [] mWorkers;
+      mWorkers = NULL;
+      mWorkerCount = 0;
    }
-   mContextList.clear();
+   mScheduleLock.unlock();
+}
+
+void FiberScheduler::setThreadGroup(ThreadGroupRef& group)
+{
+   mThreadGroup = group;
+}
+
+ThreadGroupRef FiberScheduler::getThreadGroup()
+{
+   return mThreadGroup;
 }
 
 bool FiberScheduler::waitForLastFiberExit(bool stop)
@@ -119,48 +177,58 @@ FiberId FiberScheduler::addFiber(Fiber* fiber)
       // assign id and scheduler to fiber
       fiber->setScheduler(id, this);
 
-      // add fiber to map and queue
+      // add fiber to map and shared queue
       mFiberMap.insert(make_pair(id, fiber));
       mFiberQueue.push_back(fiber);
-
-      // notify that a fiber is available for scheduling
-      fiberAvailable();
+      ++mQueuedFibers;
    }
    mScheduleLock.unlock();
 
+   // notify that a fiber is available for scheduling
+   fiberAvailable();
+
    return id;
 }
 
 void FiberScheduler::run()
 {
-   // get and store scheduler context for this thread
-   FiberContext* scheduler = new FiberContext();
-   mScheduleLock.lock();
+   // claim a worker, with the scheduler context, for this thread
+   Worker* w = mWorkers[Atomic::incrementAndFetch(&mClaimedWorkers) - 1];
+
+   // place this thread in the fiber thread group while it runs fibers,
+   // keeping its old name and cpus to restore afterwards
+   Thread* t = Thread::currentThread();
+   string oldName;
+   bool named = false;
+   CpuSet oldCpus;
+   bool pinned = false;
+   if(!mThreadGroup.isNull())
    {
-      mContextList.push_back(scheduler);
+      const char* name = t->getName();
+      if(name != NULL)
+      {
+         oldName = name;
+         named = true;
+      }
+      pinned = t->getCpuAffinity(oldCpus);
+      if(!mThreadGroup->placeThread(t))
+      {
+         // run fibers anywhere rather than not at all
+         Exception::clear();
+      }
    }
-   mScheduleLock.unlock();
 
    // continue scheduling fibers while this thread is not interrupted
-   Fiber* fiber = NULL;
    bool tryInit = true;
-   Thread* t = Thread::currentThread();
    while(!t->isInterrupted())
    {
-      // synchronously get the next fiber to schedule
-      mScheduleLock.lock();
+      Fiber* fiber = nextFiber(w);
+      if(fiber == NULL)
       {
-         fiber = nextFiber();
-         if(fiber == NULL)
-         {
-            // no fiber to schedule, so wait for one
-            mScheduleLock.wait();
-         }
+         // no fiber to schedule, so wait for one
+         park();
       }
-      mScheduleLock.unlock();
-
-      // a fiber has been found
-      if(fiber != NULL)
+      else
       {
          // fiber's state can only be set to New if it
          // hasn't ever been run yet, so no need to lock here
@@ -179,114 +247,55 @@ void FiberScheduler::run()
             }
          }
 
-         /*
-         Note: The fiber's state *must* have been New or Running if it was
-         selected via nextFiber. The fiber cannot be running currently.
-         The only state the fiber can be set to outside of its own context
-         is Waking. It could only have had its state set to Waking if its
-         state was Sleeping, which is impossible given the first sentence.
-         Therefore, the fiber's state will definitely be New if it failed
-         to init.
-         */
          if(fiber->getState() == Fiber::New)
          {
-            // failed to init fiber, not enough memory, lock to re-queue it
-            mScheduleLock.lock();
-            {
-               mFiberQueue.push_back(fiber);
-            }
-            mScheduleLock.unlock();
+            // failed to init fiber, not enough memory, re-queue it
+            queueFiber(fiber, w);
          }
          // fiber's state is Running
          else
          {
             // swap in the fiber's context
-            scheduler->swap(fiber->getContext());
-
-            // Note: Here the fiber's state could be changed externally
-            // from Sleeping to Waking, so we must lock first to ensure
-            // ensure we don't cause any evil race conditions.
-
-            // lock scheduling while adding fiber back to queue
-            mScheduleLock.lock();
+            fiber->mLastWorker = w->index;
+            w->context.swap(fiber->getContext());
+
+            /*
+            Note: The fiber is swapped out, so no other thread can change
+            its state until it is put to sleep or queued again.
+            */
+            switch(fiber->getState())
             {
-               if(fiber->getState() == Fiber::Sleeping)
-               {
-                  /*
-                  Note: We must check the canSleep() method here and not
-                  in the above sleep() call. We must do this because there
-                  only two ways for a fiber to keep running after a call
-                  to put it to sleep. The first is to wakeup the fiber.
-                  However, if a fiber was going to sleep but hadn't been
-                  swapped out yet, then a wakeup call will fail to wake
-                  up the fiber (because while the fiber's state will have
-                  been set to sleeping, it will not have entered the map
-                  of sleeping fibers yet). Since a wakeup call may fail, the
-                  only other way to keep a fiber running is for it to fail
-                  its canSleep() call. A fiber-extending class can specify
-                  the conditions underwhich a fiber can sleep in this method
-                  to prevent it from sleeping if it may have missing that
-                  critical wakeup() call. We make that call here, because
-                  if we did it in the sleep() call it would have the same
-                  potential problem as the wakeup() call: it could be missed
-                  and cause the fiber to sleep indefinitely.
-
-                  With this implementation, the user can safely implement
-                  a canSleep() method that checks a condition (within a
-                  mutex) that will be set elsewhere (within the mutex)
-                  *followed by* a mutex-free wake up call. This
-                  implementation prevents a deadlock scenario.
-                  */
-
-                  // only *actually* sleep fiber if it can be sleeped at
-                  // the moment
-                  if(fiber->canSleep())
-                  {
-                     // do not re-queue the fiber, instead add it to a map
-                     // of sleeping fibers
-                     mSleepingFibers.insert(make_pair(fiber->getId(), fiber));
-                  }
-                  else
-                  {
-                     // change fiber state back to running
-                     fiber->setState(Fiber::Running);
-                  }
-               }
-
-               if(fiber->getState() != Fiber::Sleeping)
-               {
-                  // if fiber is running, put it in the back of the queue
-                  if(fiber->getState() == Fiber::Running)
+               case Fiber::Sleeping:
+                  sleepFiber(fiber, w);
+                  break;
+               case Fiber::Exited:
+                  // fiber's stack memory will be reclaimed, so it is safe
+                  // to try init on new fibers again
+                  removeFiber(fiber);
+                  tryInit = true;
+                  break;
+               default:
+                  // fiber is running, put it in the back of this thread's
+                  // queue, wake an idle thread to steal if there is a
+                  // fiber ahead of it (this thread runs the fiber itself
+                  // otherwise, so a missed idle thread only delays
+                  // stealing)
+                  queueFiber(fiber, w);
+                  if(mIdleWorkers > 0 && w->queue.size() > 1)
                   {
-                     mFiberQueue.push_back(fiber);
-                  }
-                  // fiber is dying, so put it in front for quicker cleanup
-                  else if(fiber->getState() == Fiber::Exited)
-                  {
-                     mFiberQueue.push_front(fiber);
-
-                     // because fiber's stack memory will be reclaimed, it
-                     // is safe to try init on new fibers again
-                     tryInit = true;
+                     fiberAvailable();
                   }
-
-                  /*
-                  Note: If the fiber's state is Waking, we don't add it
-                  to the queue as this was done when its state was changed
-                  to Waking. Also, it is worth noting that its state cannot
-                  be changed back to Sleeping until the fiber runs again
-                  in its own context, so there are no race conditions
-                  concerning the fiber queue.
-                  */
-
-                  // notify that a fiber is available
-                  fiberAvailable();
-               }
+                  break;
             }
-            mScheduleLock.unlock();
          }
       }
    }
+
+   if(!mThreadGroup.isNull())
+   {
+      t->setName(named ? oldName.c_str() : NULL);
+      t->setCpuAffinity(pinned ? &oldCpus : NULL);
+   }
 }
 
 void FiberScheduler::yield(Fiber* fiber)
@@ -297,23 +306,17 @@ void FiberScheduler::yield(Fiber* fiber)
 
 void FiberScheduler::sleep(Fiber* fiber)
 {
-   // lock scheduling to insert sleeping fiber entry
-   mScheduleLock.lock();
-   {
-      /*
-      Note: Simply set the fiber's state here. The fiber will be added
-      to a map of sleeping fibers, if it "canSleep()" once it is swapped
-      out. That map insert must occur after swapping the fiber out to
-      prevent a race condition where the fiber can be double-scheduled --
-      which could occur if the fiber was insert into the sleep map here,
-      then wakeup() was called immediately causing the fiber to be queued
-      for scheduling before it was swapped out -- and then another
-      scheduling thread could run the fiber concurrently causing evil
-      havok.
-      */
-      fiber->setState(Fiber::Sleeping);
-   }
-   mScheduleLock.unlock();
+   /*
+   Note: Simply set the fiber's state here. The fiber will be added to the
+   table of sleeping fibers, if it "canSleep()" once it is swapped out.
+   That insert must occur after swapping the fiber out to prevent a race
+   condition where the fiber can be double-scheduled -- which could occur
+   if the fiber was inserted into the table here, then wakeup() was called
+   immediately causing the fiber to be queued for scheduling before it was
+   swapped out -- and then another scheduling thread could run the fiber
+   concurrently causing evil havok.
+   */
+   fiber->setState(Fiber::Sleeping);
 
    // swap scheduler back in
    fiber->getContext()->swapBack();
@@ -321,54 +324,44 @@ void FiberScheduler::sleep(Fiber* fiber)
 
 void FiberScheduler::wakeupSelf(Fiber* fiber)
 {
-   // lock scheduling while waking up sleeping fiber
-   mScheduleLock.lock();
+   // only *actually* wake up self if sleeping
+   if(fiber->getState() == Fiber::Sleeping)
    {
-      // only *actually* wake up self if sleeping
-      if(fiber->getState() == Fiber::Sleeping)
-      {
-         wakeup(fiber->getId());
-      }
+      wakeup(fiber->getId());
    }
-   mScheduleLock.unlock();
 }
 
 void FiberScheduler::wakeup(FiberId id)
 {
-   // lock scheduling while waking up sleeping fiber
-   mScheduleLock.lock();
+   // take the fiber from the sleeping fibers without locking, if it is not
+   // there it may be on its way to sleep, so wait for that to finish
+   Fiber* fiber;
+   bool found = takeSleepingFiber(id, fiber);
+   if(!found)
    {
-      // find the sleeping fiber
-      FiberMap::iterator i = mSleepingFibers.find(id);
-      if(i != mSleepingFibers.end())
-      {
-         /*
-         Note: Here we must set a special Waking state for the fiber. This
-         is because a fiber may have just put itself to sleep and the
-         scheduler's context may have been swapped in in another thread.
-         Since the scheduler will be blocked until we return here, we will
-         have already added the fiber back into the fiber queue -- and if
-         we were to simply set a state of Running, then once the scheduler
-         gets unblocked it would also add the fiber into the fiber queue,
-         causing some serious evil. Instead, we set a Waking state and
-         allow the scheduler to convert Waking state fibers back into
-         Running state fibers once they are found during the scheduling
-         process. Also, it is worth noting that a fiber's state can only
-         be set to Sleeping when we are inside of a fiber's context, so
-         we needn't worry about a similar (but reverse) situation occurring
-         there.
-         */
-
-         // update fiber state, add to queue, remove from sleeping fibers map
-         i->second->setState(Fiber::Waking);
-         mFiberQueue.push_back(i->second);
-         mSleepingFibers.erase(i);
-
-         // notify that a fiber is available
-         fiberAvailable();
-      }
+      ExclusiveLock& lock = mSleepLocks[id % SleepLockCount];
+      lock.lock();
+      found = takeSleepingFiber(id, fiber);
+      lock.unlock();
+   }
+
+   if(found)
+   {
+      /*
+      Note: The fiber was swapped out before it was put to sleep and only
+      this thread took it, so it can be queued safely. It is set to Waking
+      so that the scheduler knows to set it back to Running once it is
+      scheduled.
+      */
+      fiber->setState(Fiber::Waking);
+      int last = fiber->mLastWorker;
+      queueFiber(
+         fiber, (last >= 0 && (unsigned int)last < mWorkerCount) ?
+            mWorkers[last] : NULL);
+
+      // notify that a fiber is available
+      fiberAvailable();
    }
-   mScheduleLock.unlock();
 }
 
 void FiberScheduler::exit(Fiber* fiber)
@@ -385,77 +378,227 @@ void FiberScheduler::exit(Fiber* fiber)
    fiber->getContext()->loadBack();
 }
 
-Fiber* FiberScheduler::nextFiber()
+Fiber* FiberScheduler::nextFiber(Worker* w)
 {
    Fiber* rval = NULL;
 
-   // schedule lock engaged, look for a fiber that can be scheduled:
-
-   // cycle through fibers not more than once
-   FiberId cycleEnd = 0;
-   FiberQueue::iterator end = mFiberQueue.end();
-   for(FiberQueue::iterator i = mFiberQueue.begin();
-       rval == NULL && i != end && (*i)->getId() != cycleEnd;)
+   // check the shared queue first now and then, then this thread's queue,
+   // then the shared queue, then other threads' queues
+   if(++w->ticks % SHARED_QUEUE_INTERVAL == 0 && mQueuedFibers > 0)
+   {
+      rval = takeQueuedFibers(w);
+   }
+   if(rval == NULL && !w->queue.pop(rval))
    {
-      // pop fiber off queue
-      Fiber* fiber = *i;
-      i = mFiberQueue.erase(i);
+      rval = (mQueuedFibers > 0) ? takeQueuedFibers(w) : NULL;
+      if(rval == NULL)
+      {
+         rval = stealFibers(w);
+      }
+   }
 
-      // check state of fiber
-      switch(fiber->getState())
+   if(rval != NULL)
+   {
+      switch(rval->getState())
       {
          // if a fiber is waking, set it to running and schedule it
          case Fiber::Waking:
-            fiber->setState(Fiber::Running);
-         // if fiber is new or running, it can be scheduled
+            rval->setState(Fiber::Running);
+            break;
+         // only new or running fibers are queued
          case Fiber::New:
          case Fiber::Running:
-            rval = fiber;
-            break;
-         // exited or dead fibers must be deleted
-         case Fiber::Exited:
-            fiber->setState(Fiber::Dead);
-         case Fiber::Dead:
-            // remove fiber from scheduler
-            mFiberMap.erase(fiber->getId());
-            delete fiber;
-            fiber = NULL;
             break;
-         // a sleeping fiber should *NEVER* be in the queue
-         case Fiber::Sleeping:
+         default:
             fprintf(stderr,
-               "A sleeping fiber was scheduled to run, which should "
-               "never *ever* happen. The fiber code is broken.\n");
+               "A fiber that is not runnable was scheduled to run, which "
+               "should never *ever* happen. The fiber code is broken.\n");
             ::exit(1);
             break;
       }
+   }
+
+   return rval;
+}
 
-      // if current fiber cannot be scheduled
-      if(rval == NULL && fiber != NULL)
+Fiber* FiberScheduler::takeQueuedFibers(Worker* w)
+{
+   Fiber* rval = NULL;
+
+   mScheduleLock.lock();
+   {
+      // take this worker's share of the queued fibers, keep the rest for
+      // other workers
+      unsigned int count = min(
+         (unsigned int)mQueuedFibers / mWorkerCount + 1,
+         (unsigned int)MAX_TRANSFER);
+      for(unsigned int i = 0; i < count && !mFiberQueue.empty(); ++i)
       {
-         // push fiber onto end of queue
-         mFiberQueue.push_back(fiber);
+         Fiber* fiber = mFiberQueue.front();
+         if(rval == NULL)
+         {
+            rval = fiber;
+         }
+         else if(!w->queue.push(fiber))
+         {
+            break;
+         }
+         mFiberQueue.pop_front();
+         --mQueuedFibers;
+      }
+   }
+   mScheduleLock.unlock();
+
+   return rval;
+}
+
+Fiber* FiberScheduler::stealFibers(Worker* w)
+{
+   Fiber* rval = NULL;
+
+   // pick a random victim to start at to spread out thieves
+   w->seed ^= w->seed << 13;
+   w->seed ^= w->seed >> 17;
+   w->seed ^= w->seed << 5;
+   unsigned int start = w->seed % mWorkerCount;
 
-         // ensure current fiber is not checked again
-         if(cycleEnd == 0)
+   for(unsigned int i = 0; rval == NULL && i < mWorkerCount; ++i)
+   {
+      Worker* victim = mWorkers[(start + i) % mWorkerCount];
+      if(victim != w && victim->queue.pop(rval))
+      {
+         // take up to half of the victim's other fibers too
+         Fiber* fibers[MAX_TRANSFER];
+         unsigned int count = min(
+            victim->queue.size() / 2, (unsigned int)MAX_TRANSFER);
+         count = (count == 0) ? 0 : victim->queue.pop(fibers, count);
+         for(unsigned int n = 0; n < count; ++n)
          {
-            cycleEnd = fiber->getId();
+            queueFiber(fibers[n], w);
          }
       }
    }
 
-   if(mFiberMap.empty())
+   return rval;
+}
+
+void FiberScheduler::queueFiber(Fiber* fiber, Worker* w)
+{
+   if(w == NULL || !w->queue.push(fiber))
+   {
+      // no worker or its queue is full, use the shared queue
+      mScheduleLock.lock();
+      {
+         mFiberQueue.push_back(fiber);
+         ++mQueuedFibers;
+      }
+      mScheduleLock.unlock();
+   }
+}
+
+void FiberScheduler::sleepFiber(Fiber* fiber, Worker* w)
+{
+   /*
+   Note: We must check the canSleep() method here and not in the above
+   sleep() call. We must do this because there only two ways for a fiber to
+   keep running after a call to put it to sleep. The first is to wakeup the
+   fiber. However, if a fiber was going to sleep but hadn't been swapped out
+   yet, then a wakeup call will fail to wake up the fiber (because while the
+   fiber's state will have been set to sleeping, it will not have entered
+   the table of sleeping fibers yet). Since a wakeup call may fail, the only
+   other way to keep a fiber running is for it to fail its canSleep() call.
+   A fiber-extending class can specify the conditions underwhich a fiber can
+   sleep in this method to prevent it from sleeping if it may have missed
+   that critical wakeup() call.
+
+   With this implementation, the user can safely implement a canSleep()
+   method that checks a condition (within a mutex) that will be set
+   elsewhere (within the mutex) *followed by* a mutex-free wake up call.
+   A wakeup call that does not find the fiber asleep takes the fiber's
+   sleep lock, so it cannot be missed between the canSleep() call and the
+   fiber being put in the table of sleeping fibers. The fiber must not be
+   touched once it is in the table because it may be woken up and run on
+   another thread right away.
+   */
+   ExclusiveLock& lock = mSleepLocks[fiber->getId() % SleepLockCount];
+   lock.lock();
+   if(fiber->canSleep())
+   {
+      mSleepingFibers.put(fiber->getId(), fiber);
+      lock.unlock();
+   }
+   else
+   {
+      // change fiber state back to running
+      lock.unlock();
+      fiber->setState(Fiber::Running);
+      queueFiber(fiber, w);
+   }
+}
+
+bool FiberScheduler::takeSleepingFiber(FiberId id, Fiber*& fiber)
+{
+   // only one thread can remove the fiber, and it is the same fiber if it
+   // was woken up and put to sleep again in between
+   return mSleepingFibers.get(id, fiber) && mSleepingFibers.remove(id);
+}
+
+void FiberScheduler::removeFiber(Fiber* fiber)
+{
+   fiber->setState(Fiber::Dead);
+
+   bool empty;
+   mScheduleLock.lock();
+   {
+      mFiberMap.erase(fiber->getId());
+      empty = mFiberMap.empty();
+   }
+   mScheduleLock.unlock();
+   delete fiber;
+
+   if(empty)
    {
       // notify that no fibers are available
       noFibersAvailable();
    }
+}
 
+bool FiberScheduler::hasQueuedFibers()
+{
+   bool rval = (mQueuedFibers > 0);
+   for(unsigned int i = 0; !rval && i < mWorkerCount; ++i)
+   {
+      rval = !mWorkers[i]->queue.isEmpty();
+   }
    return rval;
 }
 
+void FiberScheduler::park()
+{
+   mIdleLock.lock();
+   {
+      // announce being idle before checking for fibers so that a fiber
+      // that is queued after the check will wake this thread
+      Atomic::incrementAndFetch(&mIdleWorkers);
+      if(!hasQueuedFibers())
+      {
+         mIdleLock.wait();
+      }
+      Atomic::decrementAndFetch(&mIdleWorkers);
+   }
+   mIdleLock.unlock();
+}
+
 inline void FiberScheduler::fiberAvailable()
 {
-   mScheduleLock.notifyAll();
+   // make the queued fiber visible before checking for idle threads
+   Atomic::memoryBarrier();
+   if(mIdleWorkers > 0)
+   {
+      mIdleLock.lock();
+      mIdleLock.notify();
+      mIdleLock.unlock();
+   }
 }
 
 inline void FiberScheduler::noFibersAvailable()
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2009 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2009-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #ifndef monarch_fiber_FiberScheduler_H
 #define monarch_fiber_FiberScheduler_H
@@ -7,7 +7,11 @@
 #include "monarch/modest/OperationList.h"
 #include "monarch/modest/OperationRunner.h"
 #include "monarch/fiber/Fiber.h"
+#include "monarch/rt/HashTable.h"
+#include "monarch/rt/LockFreeQueue.h"
+#include "monarch/rt/ThreadGroup.h"
 
+#include <list>
 #include <map>
 
 namespace monarch
@@ -15,12 +19,31 @@ namespace monarch
 namespace fiber
 {
 
+/**
+ * A hash function for FiberIds.
+ */
+struct FiberIdHashFunction : public monarch::rt::HashFunction<FiberId>
+{
+   int operator()(const FiberId& id) const
+   {
+      return (int)id;
+   };
+};
+
 /**
  * A FiberScheduler schedules and runs Fibers. It uses N modest Operations to
  * run however many Fibers are assigned to it. Each Operation shares the same
  * FiberScheduler, calling it to acquire the next scheduled fiber to run each
  * time it finishes running a fiber.
  *
+ * Each Operation's thread has its own lock-free run queue. A fiber that
+ * yields goes back on the queue of the thread that ran it, and a fiber that
+ * is woken up goes on the queue of the thread that last ran it, so fibers
+ * stay on the same thread. A thread that runs out of fibers takes new ones
+ * from a shared queue or steals them from other threads before it goes to
+ * sleep. Sleeping fibers are kept in a lock-free table, so waking one up
+ * does not take any locks.
+ *
  * @author Dave Longley
  */
 class FiberScheduler : public monarch::rt::Runnable
@@ -32,10 +55,51 @@ protected:
    monarch::modest::OperationList mOpList;
 
    /**
-    * A list of scheduler contexts.
+    * A thread that runs fibers.
     */
-   typedef std::list<FiberContext*> ContextList;
-   ContextList mContextList;
+   struct Worker
+   {
+      /**
+       * The index of this worker.
+       */
+      unsigned int index;
+
+      /**
+       * The scheduler context of this worker's thread.
+       */
+      FiberContext context;
+
+      /**
+       * The fibers to run on this worker's thread, other threads may add
+       * fibers to it or steal them from it.
+       */
+      monarch::rt::LockFreeQueue<Fiber*> queue;
+
+      /**
+       * The number of fibers this worker has scheduled.
+       */
+      unsigned int ticks;
+
+      /**
+       * A seed for picking threads to steal fibers from.
+       */
+      unsigned int seed;
+
+      /**
+       * Creates a new Worker.
+       *
+       * @param index the index of the worker.
+       */
+      Worker(unsigned int index);
+   };
+
+   /**
+    * The workers, one per Operation, and the number of workers that have
+    * been claimed by an Operation's thread.
+    */
+   Worker** mWorkers;
+   unsigned int mWorkerCount;
+   volatile unsigned int mClaimedWorkers;
 
    /**
     * The next fiber ID to try to assign.
@@ -55,26 +119,51 @@ protected:
    FiberMap mFiberMap;
 
    /**
-    * A queue of fibers to execute.
+    * A shared queue of fibers to execute, for new fibers and fibers that
+    * did not fit on a thread's queue, and the number of fibers in it.
     */
    typedef std::list<Fiber*> FiberQueue;
    FiberQueue mFiberQueue;
+   volatile unsigned int mQueuedFibers;
+
+   /**
+    * A lock-free table of sleeping fibers.
+    */
+   typedef monarch::rt::HashTable<FiberId, Fiber*, FiberIdHashFunction>
+      SleepingFiberMap;
+   SleepingFiberMap mSleepingFibers;
 
    /**
-    * A map of sleeping fibers.
+    * Locks for putting fibers to sleep, picked by FiberId. A wakeup that
+    * does not find a fiber asleep takes its lock to make sure the fiber is
+    * not on its way to sleep.
     */
-   FiberMap mSleepingFibers;
+   static const int SleepLockCount = 16;
+   monarch::rt::ExclusiveLock mSleepLocks[SleepLockCount];
 
    /**
-    * An exclusive lock for scheduling the next fiber.
+    * An exclusive lock for the map of fibers and the shared queue.
     */
    monarch::rt::ExclusiveLock mScheduleLock;
 
+   /**
+    * An exclusive lock for idle threads to wait on for fibers, and the
+    * number of threads that are waiting.
+    */
+   monarch::rt::ExclusiveLock mIdleLock;
+   volatile unsigned int mIdleWorkers;
+
    /**
     * An exclusive lock for waiting for the fiber list to empty.
     */
    monarch::rt::ExclusiveLock mNoFibersWaitLock;
 
+   /**
+    * The group that names and places the threads running fibers, NULL for
+    * none.
+    */
+   monarch::rt::ThreadGroupRef mThreadGroup;
+
 public:
    /**
     * Creates a new FiberScheduler.
@@ -88,7 +177,8 @@ public:
 
    /**
     * Starts this FiberScheduler. It will create "numOps" Operations using
-    * the passed OperationRunner to run its fibers on.
+    * the passed OperationRunner to run its fibers on. This must be called
+    * while this FiberScheduler is stopped.
     *
     * @param opRunner the OperationRunner to use.
     * @param numOps the number of Operations to run fibers on.
@@ -98,10 +188,27 @@ public:
 
    /**
     * Stops this FiberScheduler. This method will not cause its Fibers to
-    * exit, they will just no longer run.
+    * exit, they will just no longer run until it is started again.
     */
    virtual void stop();
 
+   /**
+    * Sets the ThreadGroup for the threads that run fibers. While a thread
+    * runs fibers it is named and restricted to the cpus of the group, which
+    * allows fibers to be kept apart from other work on the same ThreadPool.
+    * This must be called while this FiberScheduler is stopped.
+    *
+    * @param group the ThreadGroup for threads running fibers, NULL for none.
+    */
+   virtual void setThreadGroup(monarch::rt::ThreadGroupRef& group);
+
+   /**
+    * Gets the ThreadGroup for the threads that run fibers.
+    *
+    * @return the ThreadGroup, NULL if there is none.
+    */
+   virtual monarch::rt::ThreadGroupRef getThreadGroup();
+
    /**
     * Waits until all fibers have exited. This method will block the current
     * thread until all fibers have exited.
@@ -170,14 +277,87 @@ public:
 
 protected:
    /**
-    * Gets the next schedulable fiber, if any.
+    * Gets the next schedulable fiber for a worker, if any. The worker's own
+    * queue is checked first, then the shared queue, then the queues of
+    * other workers.
+    *
+    * @param w the worker.
     *
     * @return the next schedulable fiber, or NULL if none are available.
     */
-   virtual Fiber* nextFiber();
+   virtual Fiber* nextFiber(Worker* w);
+
+   /**
+    * Takes fibers from the shared queue, moving a share of them to a
+    * worker's queue.
+    *
+    * @param w the worker.
+    *
+    * @return a fiber to run, or NULL if the shared queue is empty.
+    */
+   virtual Fiber* takeQueuedFibers(Worker* w);
+
+   /**
+    * Steals fibers from the queue of another worker, moving up to half of
+    * them to a worker's queue.
+    *
+    * @param w the worker.
+    *
+    * @return a fiber to run, or NULL if no other worker has any.
+    */
+   virtual Fiber* stealFibers(Worker* w);
+
+   /**
+    * Queues a fiber to run on a worker's thread, or on the shared queue.
+    *
+    * @param fiber the fiber to queue.
+    * @param w the worker, NULL for the shared queue.
+    */
+   virtual void queueFiber(Fiber* fiber, Worker* w);
+
+   /**
+    * Puts a fiber that has been swapped out in the Sleeping state to sleep,
+    * unless it cannot sleep, in which case it is queued again.
+    *
+    * @param fiber the fiber.
+    * @param w the worker that ran the fiber.
+    */
+   virtual void sleepFiber(Fiber* fiber, Worker* w);
+
+   /**
+    * Takes a fiber from the table of sleeping fibers.
+    *
+    * @param id the ID of the fiber.
+    * @param fiber set to the fiber.
+    *
+    * @return true if the fiber was asleep and is now owned by the caller,
+    *         false if not.
+    */
+   virtual bool takeSleepingFiber(FiberId id, Fiber*& fiber);
+
+   /**
+    * Removes a fiber that has exited from this scheduler and deletes it.
+    *
+    * @param fiber the fiber.
+    */
+   virtual void removeFiber(Fiber* fiber);
+
+   /**
+    * Returns true if any fibers are queued to run.
+    *
+    * @return true if fibers are queued, false if not.
+    */
+   virtual bool hasQueuedFibers();
+
+   /**
+    * Waits for fibers to be queued. This is called by a worker when it has
+    * no fibers to run.
+    */
+   virtual void park();
 
    /**
     * Called to notify operations that a fiber is available to be scheduled.
+    * Wakes up an idle worker, if there are any.
     */
    virtual void fiberAvailable();
 
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2007-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2007-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #include "monarch/http/HttpConnectionServicer.h"
 
@@ -22,7 +22,8 @@ using namespace monarch::util;
 
 HttpConnectionServicer::HttpConnectionServicer(const char* serverName) :
    mServerName(strdup(serverName)),
-   mRequestModifier(NULL)
+   mRequestModifier(NULL),
+   mDomainLock(true)
 {
 }
 
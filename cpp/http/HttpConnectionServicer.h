@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2007-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2007-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #ifndef monarch_http_HttpConnectionServicer_H
 #define monarch_http_HttpConnectionServicer_H
@@ -83,7 +83,8 @@ protected:
    ServiceDomainList mDomains;
 
    /**
-    * A lock for manipulating service domains.
+    * A lock for manipulating service domains. It is a big reader lock
+    * because the domains are read for every request.
     */
    monarch::rt::SharedLock mDomainLock;
 
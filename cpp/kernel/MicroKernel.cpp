@@ -12,6 +12,7 @@
 #include "monarch/io/FileList.h"
 #include "monarch/logging/Logging.h"
 #include "monarch/rt/System.h"
+#include "monarch/rt/WorkStealingThreadPool.h"
 #include "monarch/util/StringTokenizer.h"
 #include "monarch/validation/Validation.h"
 
@@ -59,6 +60,43 @@ MicroKernel::~MicroKernel()
    MicroKernel::setServer(NULL, false);
 }
 
+void MicroKernel::setEngineThreadGroup(ThreadGroupRef& group)
+{
+   mEngineThreadGroup = group;
+   mEngine->getThreadPool()->setThreadGroup(group);
+}
+
+void MicroKernel::setFiberThreadGroup(ThreadGroupRef& group)
+{
+   mFiberThreadGroup = group;
+}
+
+bool MicroKernel::configureThreadGroups(DynamicObject& config)
+{
+   bool rval = true;
+
+   ThreadGroupRef engine;
+   ThreadGroupRef fiber;
+   if(config->hasMember("engine"))
+   {
+      engine = new ThreadGroup("engine");
+      rval = engine->configure(config["engine"]);
+   }
+   if(rval && config->hasMember("fiber"))
+   {
+      fiber = new ThreadGroup("fiber");
+      rval = fiber->configure(config["fiber"]);
+   }
+
+   if(rval)
+   {
+      setEngineThreadGroup(engine);
+      setFiberThreadGroup(fiber);
+   }
+
+   return rval;
+}
+
 bool MicroKernel::start()
 {
    bool rval = true;
@@ -73,6 +111,7 @@ bool MicroKernel::start()
    // start fiber scheduler if one exists
    if(mFiberScheduler != NULL)
    {
+      mFiberScheduler->setThreadGroup(mFiberThreadGroup);
       mFiberScheduler->start(this, mCoresDetected);
       MO_CAT_INFO(MO_KERNEL_CAT,
          "FiberScheduler started using %" PRIu32 " cpu core(s).",
@@ -89,7 +128,7 @@ bool MicroKernel::start()
    // start event daemon if one exists
    if(mEventDaemon != NULL)
    {
-      mEventDaemon->start(this, mEventController);
+      mEventDaemon->start(mEventController);
       MO_CAT_INFO(MO_KERNEL_CAT, "EventDaemon started.");
    }
 
@@ -579,6 +618,28 @@ void MicroKernel::setMaxAuxiliaryThreads(uint32_t count)
    mEngine->getThreadPool()->setPoolSize(mMinRequiredThreads + count);
 }
 
+void MicroKernel::setWorkStealingEnabled(bool enabled)
+{
+   ThreadPool* old = mEngine->getThreadPool();
+   bool current = (dynamic_cast<WorkStealingThreadPool*>(old) != NULL);
+   if(enabled != current)
+   {
+      ThreadPool* pool;
+      if(enabled)
+      {
+         pool = new WorkStealingThreadPool(
+            old->getPoolSize(), old->getThreadStackSize());
+      }
+      else
+      {
+         pool = new ThreadPool(old->getPoolSize(), old->getThreadStackSize());
+      }
+      pool->setThreadExpireTime(old->getThreadExpireTime());
+      pool->setThreadGroup(mEngineThreadGroup);
+      mEngine->setThreadPool(pool, true);
+   }
+}
+
 void MicroKernel::setMaxServerConnections(uint32_t count)
 {
    mMaxConnections = count;
@@ -678,6 +739,11 @@ Server* MicroKernel::getServer()
    return mServer;
 }
 
+DynamicObject MicroKernel::getOperationStats()
+{
+   return mEngine->getOperationStats()->getStats();
+}
+
 bool MicroKernel::checkDependencyInfo(
    ModuleList& dependencies, DynamicObject& di, DynamicObject* unmet)
 {
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2009-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2009-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #ifndef monarch_kernel_MicroKernel_H
 #define monarch_kernel_MicroKernel_H
@@ -126,6 +126,17 @@ protected:
     */
    uint32_t mMaxConnections;
 
+   /**
+    * The thread group for the threads that run the modest Engine's
+    * Operations, including server connections, NULL for none.
+    */
+   monarch::rt::ThreadGroupRef mEngineThreadGroup;
+
+   /**
+    * The thread group for the threads that run fibers, NULL for none.
+    */
+   monarch::rt::ThreadGroupRef mFiberThreadGroup;
+
 public:
    /**
     * Creates a new MicroKernel with no specified ConfigManager, FiberScheduler,
@@ -279,6 +290,15 @@ public:
     */
    virtual void setMaxAuxiliaryThreads(uint32_t count);
 
+   /**
+    * Sets whether the modest Engine should run its Operations on a
+    * WorkStealingThreadPool instead of a classic ThreadPool. The pool size
+    * is kept. This must be called while the kernel is stopped.
+    *
+    * @param enabled true to use work stealing, false not to.
+    */
+   virtual void setWorkStealingEnabled(bool enabled);
+
    /**
     * Sets the maximum number of server connections to permit.
     *
@@ -286,6 +306,41 @@ public:
     */
    virtual void setMaxServerConnections(uint32_t count);
 
+   /**
+    * Sets the ThreadGroup for the threads that run the modest Engine's
+    * Operations. Server connections and modules run on these threads. This
+    * must be called while the kernel is stopped.
+    *
+    * @param group the ThreadGroup, NULL for none.
+    */
+   virtual void setEngineThreadGroup(monarch::rt::ThreadGroupRef& group);
+
+   /**
+    * Sets the ThreadGroup for the threads that run fibers. Fibers run on
+    * Engine threads that are moved to this group while they run fibers. This
+    * must be called while the kernel is stopped.
+    *
+    * @param group the ThreadGroup, NULL for none.
+    */
+   virtual void setFiberThreadGroup(monarch::rt::ThreadGroupRef& group);
+
+   /**
+    * Configures the thread groups for this kernel, which partition its
+    * threads over the cpus of the machine. The configuration is a map with
+    * optional "engine" and "fiber" entries, each a ThreadGroup configuration,
+    * for example:
+    *
+    * {"engine": {"cpus": "0-5"}, "fiber": {"numaNode": 1, "perCpu": true}}
+    *
+    * Groups without an entry are removed. This must be called while the
+    * kernel is stopped.
+    *
+    * @param config the thread group configuration.
+    *
+    * @return true if successful, false if an exception occurred.
+    */
+   virtual bool configureThreadGroups(monarch::rt::DynamicObject& config);
+
    /**
     * Sets this MicroKernel's ConfigManager.
     *
@@ -381,6 +436,15 @@ public:
     */
    virtual monarch::net::Server* getServer();
 
+   /**
+    * Gets a snapshot of the latency statistics of each type of Operation
+    * that this MicroKernel's Engine has run, in microseconds. See
+    * OperationStats::getStats() for the format.
+    *
+    * @return the snapshot.
+    */
+   virtual monarch::rt::DynamicObject getOperationStats();
+
 protected:
    /**
     * Checks the dependency information for a single pending MicroKernelModule.
@@ -26,7 +26,8 @@ Logger::LoggerMap* Logger::sLoggers;
 Logger::Logger() :
    mName(NULL),
    mDateFormat(NULL),
-   mFlags(0)
+   mFlags(0),
+   mLock(true)
 {
    setLevel(Max);
    setDateFormat("%Y-%m-%d %H:%M:%S");
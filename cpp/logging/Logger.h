@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2007-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2007-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #ifndef monarch_logging_Logger_H
 #define monarch_logging_Logger_H
@@ -168,7 +168,8 @@ protected:
    LoggerFlags mFlags;
 
    /**
-    * Internal data structures lock.
+    * Internal data structures lock. It is a big reader lock because it is
+    * read for every log message.
     */
    monarch::rt::SharedLock mLock;
 
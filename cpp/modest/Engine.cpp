@@ -1,9 +1,12 @@
 /*
- * Copyright (c) 2007-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2007-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #include "monarch/modest/Engine.h"
 
 #include "monarch/rt/RunnableDelegate.h"
+#include "monarch/rt/System.h"
+
+#include <algorithm>
 
 using namespace std;
 using namespace monarch::rt;
@@ -13,10 +16,22 @@ typedef RunnableDelegate<Engine, Operation*> Runner;
 
 Engine::Engine() :
    JobDispatcher(new ThreadPool(100), true),
-   mDispatch(false)
+   mDispatch(false),
+   mChangedAll(false),
+   mWaitCount(0),
+   mInterruptCount(OperationImpl::getInterruptCount()),
+   mNextDeadline(0),
+   mWaitingDeadline(0),
+   mOperationStatsEnabled(true)
 {
    // set thread expire time to 2 minutes (120000 milliseconds) by default
    mThreadPool->setThreadExpireTime(120000);
+
+   // dispatch more High priority operations than Low priority ones
+   mPriorityWeights[OperationImpl::High] = 8;
+   mPriorityWeights[OperationImpl::Normal] = 4;
+   mPriorityWeights[OperationImpl::Low] = 1;
+   Engine::resetStats();
 }
 
 Engine::~Engine()
@@ -53,6 +68,8 @@ void Engine::stop()
 
 void Engine::queue(Operation& op)
 {
+   op->mQueuedTime = System::getMonotonicMicroseconds();
+
    // create runnable
    RunnableRef r = new Runner(
       this, &Engine::runOperation, new Operation(op), &Engine::freeOperation);
@@ -68,6 +85,35 @@ void Engine::queue(Operation& op)
 
 void Engine::clearQueuedOperations()
 {
+   // put waiting operations back on the queue so they are cleared too,
+   // operations in the priority queues can only be moved if they are not
+   // being dispatched, otherwise the dispatcher removes them
+   mStateLock.lock();
+   mLock.lock();
+   wakeWaitingJobs();
+   bool dispatchOff = !isDispatching();
+   for(int pc = 0; pc < OperationImpl::PriorityClasses; ++pc)
+   {
+      JobList& queue = mPriorityQueues[pc];
+      if(dispatchOff)
+      {
+         mJobQueue.splice(mJobQueue.end(), queue);
+      }
+      else
+      {
+         for(JobList::iterator i = queue.begin(); i != queue.end(); ++i)
+         {
+            if(!i->deleted)
+            {
+               i->deleted = true;
+               Atomic::decrementAndFetch(&mQueuedJobs);
+            }
+         }
+      }
+   }
+   mLock.unlock();
+   mStateLock.unlock();
+
    clearQueuedJobs();
 }
 
@@ -99,6 +145,13 @@ inline ThreadPool* Engine::getThreadPool()
    return mThreadPool;
 }
 
+void Engine::signalStateChanged(const char* key)
+{
+   mStateLock.lock();
+   stateChanged(key);
+   mStateLock.unlock();
+}
+
 unsigned int Engine::getQueuedOperationCount()
 {
    return JobDispatcher::getQueuedJobCount();
@@ -109,9 +162,107 @@ unsigned int Engine::getTotalOperationCount()
    return JobDispatcher::getTotalJobCount();
 }
 
+void Engine::setPriorityWeight(
+   OperationImpl::Priority priority, uint32_t weight)
+{
+   mPriorityWeights[priority] = (weight == 0) ? 1 : weight;
+}
+
+uint32_t Engine::getPriorityWeight(OperationImpl::Priority priority)
+{
+   return mPriorityWeights[priority];
+}
+
+DynamicObject Engine::getStats()
+{
+   static const char* names[OperationImpl::PriorityClasses] =
+      {"high", "normal", "low"};
+
+   DynamicObject rval = JobDispatcher::getStats();
+   DynamicObject& priorities = rval["priorities"];
+   for(int pc = 0; pc < OperationImpl::PriorityClasses; ++pc)
+   {
+      PriorityStats& ps = mPriorityStats[pc];
+      uint64_t dispatched = ps.dispatched;
+      DynamicObject& stats = priorities[names[pc]];
+      stats["weight"] = mPriorityWeights[pc];
+      stats["dispatched"] = dispatched;
+      stats["expired"] = (uint64_t)ps.expired;
+      stats["averageQueueWait"] =
+         (dispatched == 0) ? 0 : ps.totalWait / dispatched;
+      stats["maxQueueWait"] = ps.maxWait;
+   }
+
+   return rval;
+}
+
+void Engine::resetStats()
+{
+   JobDispatcher::resetStats();
+   for(int pc = 0; pc < OperationImpl::PriorityClasses; ++pc)
+   {
+      PriorityStats& ps = mPriorityStats[pc];
+      ps.dispatched = 0;
+      ps.expired = 0;
+      ps.totalWait = 0;
+      ps.maxWait = 0;
+   }
+   mOperationStats.reset();
+}
+
+void Engine::setOperationStatsEnabled(bool enabled)
+{
+   mOperationStatsEnabled = enabled;
+}
+
+OperationStats* Engine::getOperationStats()
+{
+   return &mOperationStats;
+}
+
 bool Engine::canDispatch()
 {
-   return mDispatch;
+   // dispatch to expire operations once their deadline passes
+   uint64_t deadline = mNextDeadline;
+   return mDispatch ||
+      (deadline != 0 && deadline <= System::getCurrentMilliseconds());
+}
+
+uint32_t Engine::getParkTimeout()
+{
+   uint32_t rval = 0;
+
+   uint64_t deadline = mNextDeadline;
+   if(deadline != 0)
+   {
+      uint64_t now = System::getCurrentMilliseconds();
+      rval = (deadline <= now) ? 1 :
+         (uint32_t)min(deadline - now, (uint64_t)0x7fffffff);
+   }
+
+   return rval;
+}
+
+void Engine::jobDispatched(Job& job)
+{
+   JobDispatcher::jobDispatched(job);
+
+   PriorityStats& ps = mPriorityStats[(*getOperation(job))->getPriority()];
+   // job.queued is stamped with the monotonic clock, which never goes
+   // back, but the stamps may come from different cpus
+   uint64_t now = System::getMonotonicMicroseconds();
+   uint64_t wait = (now > job.queued) ? now - job.queued : 0;
+   ps.totalWait += wait;
+   if(wait > ps.maxWait)
+   {
+      ps.maxWait = wait;
+   }
+   Atomic::incrementAndFetch(&ps.dispatched);
+}
+
+Operation* Engine::getOperation(Job& job)
+{
+   return static_cast<Runner*>(&(*(*job.runnableRef)))->getParam();
 }
 
 void Engine::dispatchJobs()
@@ -120,98 +271,439 @@ void Engine::dispatchJobs()
    // turned back on)
    mDispatch = false;
 
-   // keep track of whether or not dispatch loop should break because an
-   // operation would block due to lack of idle threads
-   bool breakLoop = false;
-
-   // iterate over the queued jobs, jobs may be added (to the end of the
-   // queue) while iterating, but not removed so there is no danger of
-   // iterator invalidation, synchronously get first job
    Thread* thread = Thread::currentThread();
+   uint64_t now = System::getCurrentMilliseconds();
+   mStateLock.lock();
    mLock.lock();
-   JobList::iterator i = mJobQueue.begin();
-   JobList::iterator end = mJobQueue.end();
+   acceptIncomingJobs();
+
+   // check all waiting jobs again if state that is not known changed, or
+   // if an operation was interrupted because it may have to be canceled,
+   // otherwise only the waiting jobs whose deadline passed
+   uint32_t interrupts = OperationImpl::getInterruptCount();
+   if(mChangedAll || interrupts != mInterruptCount)
+   {
+      mInterruptCount = interrupts;
+      wakeWaitingJobs();
+   }
+   else if(mWaitingDeadline != 0 && mWaitingDeadline <= now)
+   {
+      wakeExpiredJobs(now);
+   }
+
+   // move newly queued jobs to the queues of their priority classes, jobs
+   // are only removed from those queues by this thread so there is no
+   // danger of iterator invalidation while dispatching
+   while(!mJobQueue.empty())
+   {
+      JobList& queue =
+         mPriorityQueues[(*getOperation(mJobQueue.front()))->getPriority()];
+      queue.splice(queue.end(), mJobQueue, mJobQueue.begin());
+   }
    mLock.unlock();
-   for(; !thread->isInterrupted() && !breakLoop && i != end;)
+   mStateLock.unlock();
+
+   // take turns dispatching from each priority class, up to its weight in
+   // operations on each turn, until all of the queued jobs are checked
+   JobList::iterator next[OperationImpl::PriorityClasses];
+   for(int pc = 0; pc < OperationImpl::PriorityClasses; ++pc)
    {
-      // get next job
-      JobDispatcher::Job& job = *i;
-      if(i->deleted)
+      next[pc] = mPriorityQueues[pc].begin();
+   }
+   uint64_t deadline = 0;
+   bool more = true;
+   while(more && !thread->isInterrupted())
+   {
+      more = false;
+      for(int pc = 0;
+          !thread->isInterrupted() && pc < OperationImpl::PriorityClasses;
+          ++pc)
       {
-         // job is marked for deletion, remove from queue
+         JobList& queue = mPriorityQueues[pc];
+         JobList::iterator& i = next[pc];
+         for(uint32_t run = 0; !thread->isInterrupted() &&
+             run < mPriorityWeights[pc] && i != queue.end();)
+         {
+            if(dispatchJob(queue, i, deadline))
+            {
+               ++run;
+            }
+         }
+         more = more || (i != queue.end());
+      }
+   }
+
+   if(!thread->isInterrupted())
+   {
+      dispatchWaitingJobs();
+   }
+
+   // wake up for the earliest deadline
+   mLock.lock();
+   if(mWaitingDeadline != 0 &&
+      (deadline == 0 || mWaitingDeadline < deadline))
+   {
+      deadline = mWaitingDeadline;
+   }
+   mNextDeadline = deadline;
+   mLock.unlock();
+}
+
+bool Engine::dispatchJob(
+   JobList& queue, JobList::iterator& i, uint64_t& deadline)
+{
+   bool rval = false;
+
+   Job& job = *i;
+   if(job.deleted)
+   {
+      // job is marked for deletion, remove from queue
+      mLock.lock();
+      delete job.runnableRef;
+      i = queue.erase(i);
+      mLock.unlock();
+   }
+   else
+   {
+      // lock state to check guard/run pre-execution mutation
+      mStateLock.lock();
+      JobCheck check = checkJob(job);
+      if(check == JobWait)
+      {
+         // set the job aside until the state its guard depends on
+         // changes if the guard names it, otherwise move to next job,
+         // the state lock is still held so a change cannot be missed
+         Operation* op = getOperation(job);
+         OperationGuard* og = (*op)->getGuard();
+         vector<const char*> keys;
+         bool wait = og->getStateKeys(keys) && !keys.empty();
          mLock.lock();
-         if(job.type == Job::TypeRunnableRef)
+         if(wait)
          {
-            delete job.runnableRef;
+            WaitingJob wj;
+            wj.job = job;
+            wj.keys.assign(keys.begin(), keys.end());
+            sort(wj.keys.begin(), wj.keys.end());
+            wj.keys.erase(
+               unique(wj.keys.begin(), wj.keys.end()), wj.keys.end());
+            wj.deadline = (*op)->getDeadline();
+            addWaitingJob(mWaitCount++, wj);
+            i = queue.erase(i);
+         }
+         else
+         {
+            // remember the earliest deadline of the queued jobs
+            uint64_t d = (*op)->getDeadline();
+            if(d != 0 && (deadline == 0 || d < deadline))
+            {
+               deadline = d;
+            }
+            ++i;
          }
-         i = mJobQueue.erase(i);
          mLock.unlock();
+         mStateLock.unlock();
       }
       else
       {
-         // lock state to check guard/run pre-execution mutation
-         mStateLock.lock();
+         // remove job from queue
+         mLock.lock();
+         jobDone(job, check);
+         i = queue.erase(i);
+         mLock.unlock();
+         rval = (check == JobRun);
+      }
+   }
 
-         // get operation, guard, and mutator
-         Runner* runner = static_cast<Runner*>(&(*(*job.runnableRef)));
-         Operation* op = runner->getParam();
-         OperationGuard* og = (*op)->getGuard();
-         StateMutator* sm = (*op)->getStateMutator();
+   return rval;
+}
+
+Engine::JobCheck Engine::checkJob(Job& job)
+{
+   JobCheck rval;
+
+   // get operation, guard, and mutator
+   Operation* op = getOperation(job);
+   OperationGuard* og = (*op)->getGuard();
+   StateMutator* sm = (*op)->getStateMutator();
 
-         // check the operation's guard restrictions
-         if(og == NULL || og->canExecuteOperation(*op))
+   // operation's deadline passed, it must be canceled
+   uint64_t deadline = (*op)->getDeadline();
+   if(deadline != 0 && deadline <= System::getCurrentMilliseconds())
+   {
+      mStateLock.unlock();
+      (*op)->mExpired = true;
+      (*op)->stop();
+      rval = JobExpire;
+   }
+   // check the operation's guard restrictions
+   else if(og == NULL || og->canExecuteOperation(*op))
+   {
+      // do pre-execution state mutation, release state lock
+      if(sm != NULL)
+      {
+         sm->mutatePreExecutionState(*op);
+         stateMutated(sm, *op, true);
+      }
+      mStateLock.unlock();
+      (*op)->mDispatchedTime = System::getMonotonicMicroseconds();
+
+      // run the operation, do not allow interruptions, but remember
+      // them if they occur
+      bool interrupted = false;
+      while(!getThreadPool()->runJob(*job.runnableRef))
+      {
+         interrupted = true;
+         Thread::interrupted(true);
+      }
+      if(interrupted)
+      {
+         Thread::currentThread()->interrupt();
+      }
+      rval = JobRun;
+   }
+   // operation can wait
+   else if(!(*op)->isInterrupted() && !og->mustCancelOperation(*op))
+   {
+      rval = JobWait;
+   }
+   // operation must be canceled
+   else
+   {
+      // unlock state, stop operation
+      mStateLock.unlock();
+      (*op)->stop();
+      rval = JobCancel;
+   }
+
+   return rval;
+}
+
+void Engine::jobDone(Job& job, JobCheck check)
+{
+   // turn on dispatching if the job was run because running an op could
+   // change the state and allow other ops that were previously unable to
+   // run to run
+   if(check == JobRun)
+   {
+      jobDispatched(job);
+      mDispatch = true;
+   }
+   else if(check == JobExpire)
+   {
+      Operation* op = getOperation(job);
+      Atomic::incrementAndFetch(
+         &mPriorityStats[(*op)->getPriority()].expired);
+   }
+   delete job.runnableRef;
+   Atomic::decrementAndFetch(&mQueuedJobs);
+}
+
+void Engine::dispatchWaitingJobs()
+{
+   Thread* thread = Thread::currentThread();
+
+   // get the keys of the state that changed since the last dispatch
+   mStateLock.lock();
+   mLock.lock();
+   set<string> changed;
+   changed.swap(mChangedKeys);
+   mLock.unlock();
+
+   for(set<string>::iterator ki = changed.begin();
+       !thread->isInterrupted() && ki != changed.end(); ++ki)
+   {
+      // get the lines that wait on the key
+      vector<StateKeys> lines;
+      KeyLineMap::iterator kli = mKeyLines.find(*ki);
+      if(kli != mKeyLines.end())
+      {
+         for(set<const StateKeys*>::iterator li = kli->second.begin();
+             li != kli->second.end(); ++li)
          {
-            // do pre-execution state mutation, release state lock
-            if(sm != NULL)
-            {
-               sm->mutatePreExecutionState(*op);
-            }
-            mStateLock.unlock();
+            lines.push_back(**li);
+         }
+      }
 
-            // run the operation, do not allow interruptions, but remember
-            // them if they occur
-            bool interrupted = false;
-            while(!getThreadPool()->runJob(*job.runnableRef))
+      for(vector<StateKeys>::iterator li = lines.begin();
+          !thread->isInterrupted() && li != lines.end(); ++li)
+      {
+         // check the jobs in line until one must keep waiting, the job is
+         // taken out of line while it is checked because the state lock is
+         // released if it runs
+         bool wait = false;
+         WaitLineMap::iterator wli;
+         while(!wait && !thread->isInterrupted() &&
+               (wli = mWaitLines.find(*li)) != mWaitLines.end())
+         {
+            uint64_t id = *wli->second.begin();
+            WaitingJob wj = mWaitingJobs[id];
+            mLock.lock();
+            removeWaitingJob(id);
+            mLock.unlock();
+
+            JobCheck check = checkJob(wj.job);
+            mLock.lock();
+            if(check == JobWait)
             {
-               interrupted = true;
-               Thread::interrupted(true);
+               // back in line, in the same place
+               addWaitingJob(id, wj);
+               wait = true;
             }
-            if(interrupted)
+            else
             {
-               thread->interrupt();
+               jobDone(wj.job, check);
             }
-
-            // remove job from queue, turn on dispatching because running
-            // an op could change the state and allow other ops that were
-            // previously unable to run to run
-            mLock.lock();
-            delete job.runnableRef;
-            i = mJobQueue.erase(i);
-            --mQueuedJobs;
-            mDispatch = true;
             mLock.unlock();
+
+            // relock state if it was released
+            if(!wait)
+            {
+               mStateLock.lock();
+            }
          }
-         // operation can wait
-         else if(!(*op)->isInterrupted() && !og->mustCancelOperation(*op))
+      }
+   }
+
+   mStateLock.unlock();
+}
+
+void Engine::addWaitingJob(uint64_t id, WaitingJob& wj)
+{
+   WaitingJob& added = mWaitingJobs[id];
+   added = wj;
+
+   WaitLineMap::iterator li = mWaitLines.find(added.keys);
+   if(li == mWaitLines.end())
+   {
+      // start a new line
+      li = mWaitLines.insert(
+         make_pair(added.keys, set<uint64_t>())).first;
+      for(StateKeys::iterator i = added.keys.begin();
+          i != added.keys.end(); ++i)
+      {
+         mKeyLines[*i].insert(&li->first);
+      }
+   }
+   li->second.insert(id);
+
+   // remember the earliest deadline of the waiting jobs
+   if(added.deadline != 0 &&
+      (mWaitingDeadline == 0 || added.deadline < mWaitingDeadline))
+   {
+      mWaitingDeadline = added.deadline;
+   }
+}
+
+void Engine::removeWaitingJob(uint64_t id)
+{
+   WaitingJobMap::iterator wi = mWaitingJobs.find(id);
+   WaitLineMap::iterator li = mWaitLines.find(wi->second.keys);
+   li->second.erase(id);
+   if(li->second.empty())
+   {
+      // the line is empty, stop waiting on its keys
+      for(StateKeys::iterator i = wi->second.keys.begin();
+          i != wi->second.keys.end(); ++i)
+      {
+         KeyLineMap::iterator kli = mKeyLines.find(*i);
+         kli->second.erase(&li->first);
+         if(kli->second.empty())
          {
-            // unlock state, move to next job
-            mStateLock.unlock();
-            mLock.lock();
-            ++i;
-            mLock.unlock();
+            mKeyLines.erase(kli);
          }
-         // operation must be canceled
-         else
-         {
-            // unlock state, stop operation
-            mStateLock.unlock();
-            (*op)->stop();
+      }
+      mWaitLines.erase(li);
+   }
+   mWaitingJobs.erase(wi);
+}
 
-            // remove from queue
-            mLock.lock();
-            delete job.runnableRef;
-            i = mJobQueue.erase(i);
-            mLock.unlock();
+void Engine::wakeWaitingJobs()
+{
+   // move jobs back in the order they started waiting
+   for(WaitingJobMap::iterator i = mWaitingJobs.begin();
+       i != mWaitingJobs.end(); ++i)
+   {
+      mJobQueue.push_back(i->second.job);
+   }
+   mWaitingJobs.clear();
+   mWaitLines.clear();
+   mKeyLines.clear();
+   mChangedKeys.clear();
+   mChangedAll = false;
+   mWaitingDeadline = 0;
+}
+
+void Engine::wakeExpiredJobs(uint64_t now)
+{
+   // move jobs back in the order they started waiting
+   vector<uint64_t> expired;
+   mWaitingDeadline = 0;
+   for(WaitingJobMap::iterator i = mWaitingJobs.begin();
+       i != mWaitingJobs.end(); ++i)
+   {
+      uint64_t deadline = i->second.deadline;
+      if(deadline != 0 && deadline <= now)
+      {
+         mJobQueue.push_back(i->second.job);
+         expired.push_back(i->first);
+      }
+      else if(deadline != 0 &&
+         (mWaitingDeadline == 0 || deadline < mWaitingDeadline))
+      {
+         mWaitingDeadline = deadline;
+      }
+   }
+   for(vector<uint64_t>::iterator i = expired.begin();
+       i != expired.end(); ++i)
+   {
+      removeWaitingJob(*i);
+   }
+}
+
+void Engine::stateChanged(const char* key)
+{
+   // only dispatch if a job waits on the state, the state lock is held by
+   // any thread that sets jobs aside
+   if(!mWaitingJobs.empty())
+   {
+      mLock.lock();
+      bool dispatch = true;
+      if(key == NULL)
+      {
+         mChangedAll = true;
+      }
+      else if(mKeyLines.find(key) != mKeyLines.end())
+      {
+         mChangedKeys.insert(key);
+      }
+      else
+      {
+         dispatch = false;
+      }
+      if(dispatch)
+      {
+         mDispatch = true;
+         wakeup();
+      }
+      mLock.unlock();
+   }
+}
+
+void Engine::stateMutated(StateMutator* sm, Operation& op, bool preExecution)
+{
+   if(!mWaitingJobs.empty())
+   {
+      vector<const char*> keys;
+      if(!sm->getChangedStateKeys(op, preExecution, keys))
+      {
+         stateChanged(NULL);
+      }
+      else
+      {
+         for(vector<const char*>::iterator i = keys.begin();
+             i != keys.end(); ++i)
+         {
+            stateChanged(*i);
          }
       }
    }
@@ -225,6 +717,10 @@ void Engine::runOperation(Operation* op)
 
    // run operation
    (*op)->run();
+   if(mOperationStatsEnabled)
+   {
+      mOperationStats.record(*op);
+   }
 
    // do post-execution state mutation
    StateMutator* sm = (*op)->getStateMutator();
@@ -232,6 +728,7 @@ void Engine::runOperation(Operation* op)
    {
       mStateLock.lock();
       sm->mutatePostExecutionState(*op);
+      stateMutated(sm, *op, false);
       mStateLock.unlock();
    }
 
@@ -1,13 +1,19 @@
 /*
- * Copyright (c) 2007-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2007-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #ifndef monarch_modest_Engine_H
 #define monarch_modest_Engine_H
 
 #include "monarch/modest/Operation.h"
+#include "monarch/modest/OperationStats.h"
 #include "monarch/rt/JobDispatcher.h"
 #include "monarch/rt/ThreadPool.h"
 
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
 namespace monarch
 {
 namespace modest
@@ -30,6 +36,19 @@ namespace modest
  * any Operation can be dispatched for execution, any associated state
  * must be checked against the Operation's guard for compatibility.
  *
+ * An Operation that must wait is checked again every time the Engine
+ * dispatches, unless its guard names the keys of the state it depends on.
+ * Then it is set aside until the state with one of those keys changes, so
+ * that a large number of waiting Operations does not slow down dispatching.
+ * Operations whose guards name the same keys wait in line: when the state
+ * changes they are checked in the order they started waiting until one of
+ * them must keep waiting.
+ *
+ * Each priority class of Operations has its own queue. The Engine takes
+ * turns dispatching from the queues, dispatching up to the weight of a
+ * class in Operations on each of its turns. An Operation whose deadline
+ * passes before it can be executed is canceled.
+ *
  * @author Dave Longley
  */
 class Engine : protected monarch::rt::JobDispatcher
@@ -52,6 +71,103 @@ protected:
     */
    monarch::rt::ExclusiveLock mStateLock;
 
+   /**
+    * The sorted keys of the state that a guard depends on. The Operations
+    * whose guards depend on the same keys wait in line for that state.
+    */
+   typedef std::vector<std::string> StateKeys;
+
+   /**
+    * An Operation that is waiting for the state its guard depends on to
+    * change, along with the keys of that state.
+    */
+   struct WaitingJob
+   {
+      Job job;
+      StateKeys keys;
+      uint64_t deadline;
+   };
+
+   /**
+    * The Operations that are waiting for state to change, by the order they
+    * started waiting in.
+    */
+   typedef std::map<uint64_t, WaitingJob> WaitingJobMap;
+   WaitingJobMap mWaitingJobs;
+
+   /**
+    * The lines of Operations that wait for the same state, by the order
+    * they started waiting in.
+    */
+   typedef std::map<StateKeys, std::set<uint64_t> > WaitLineMap;
+   WaitLineMap mWaitLines;
+
+   /**
+    * The lines that wait on each state key.
+    */
+   typedef std::map<std::string, std::set<const StateKeys*> > KeyLineMap;
+   KeyLineMap mKeyLines;
+
+   /**
+    * The keys of the state that changed since the last dispatch, and true
+    * if state that is not known changed.
+    */
+   std::set<std::string> mChangedKeys;
+   bool mChangedAll;
+
+   /**
+    * The number of Operations that have started waiting.
+    */
+   uint64_t mWaitCount;
+
+   /**
+    * The number of Operation interruptions last seen when dispatching.
+    */
+   uint32_t mInterruptCount;
+
+   /**
+    * The queued Operations of each priority class, in the order they were
+    * queued in.
+    */
+   JobList mPriorityQueues[OperationImpl::PriorityClasses];
+
+   /**
+    * The weight of each priority class: the number of its Operations that
+    * may be dispatched on each of its turns.
+    */
+   uint32_t mPriorityWeights[OperationImpl::PriorityClasses];
+
+   /**
+    * Statistics for each priority class: the number of Operations that
+    * were dispatched and that expired, and the total and highest time
+    * Operations waited to be dispatched (in microseconds).
+    */
+   struct PriorityStats
+   {
+      volatile uint64_t dispatched;
+      volatile uint64_t expired;
+      uint64_t totalWait;
+      uint64_t maxWait;
+   };
+   PriorityStats mPriorityStats[OperationImpl::PriorityClasses];
+
+   /**
+    * The earliest deadline of the queued Operations and of the Operations
+    * that are waiting for state to change, 0 for none.
+    */
+   uint64_t mNextDeadline;
+   uint64_t mWaitingDeadline;
+
+   /**
+    * Latency statistics for each type of Operation.
+    */
+   OperationStats mOperationStats;
+
+   /**
+    * True to record latency statistics for each type of Operation.
+    */
+   bool mOperationStatsEnabled;
+
 public:
    /**
     * Creates a new Engine.
@@ -109,6 +225,16 @@ public:
     */
    virtual void terminateRunningOperations();
 
+   /**
+    * Signals that the state with the given key has changed so that the
+    * Operations whose guards depend on it are checked again. This only needs
+    * to be called when the state is changed by something other than a
+    * StateMutator that names the keys it changes.
+    *
+    * @param key the key of the state that changed, NULL if it is not known.
+    */
+   virtual void signalStateChanged(const char* key);
+
    /**
     * Gets the current thread's Operation. This method assumes that you
     * know that the current thread has an Operation. Do not call it if
@@ -126,6 +252,13 @@ public:
     */
    virtual monarch::rt::ThreadPool* getThreadPool();
 
+   /**
+    * Replaces this Engine's ThreadPool, for instance with a
+    * WorkStealingThreadPool. This should only be called while this Engine
+    * is stopped.
+    */
+   using JobDispatcher::setThreadPool;
+
    /**
     * Gets the number of Operations that are in the queue to be executed.
     *
@@ -142,6 +275,64 @@ public:
     */
    virtual unsigned int getTotalOperationCount();
 
+   /**
+    * Sets the weight of a priority class: the number of its Operations that
+    * may be dispatched on each of its turns. The defaults are 8 for High, 4
+    * for Normal and 1 for Low.
+    *
+    * @param priority the priority class.
+    * @param weight the weight, at least 1.
+    */
+   virtual void setPriorityWeight(
+      OperationImpl::Priority priority, uint32_t weight);
+
+   /**
+    * Gets the weight of a priority class.
+    *
+    * @param priority the priority class.
+    *
+    * @return the weight.
+    */
+   virtual uint32_t getPriorityWeight(OperationImpl::Priority priority);
+
+   /**
+    * Gets statistics for this Engine. In addition to the statistics of a
+    * JobDispatcher, "priorities" has an entry for each priority class
+    * ("high", "normal" and "low") with:
+    *
+    * "weight": the weight of the class.
+    * "dispatched": the number of Operations that were dispatched.
+    * "expired": the number of Operations that were canceled because their
+    *    deadline passed.
+    * "averageQueueWait": the average time from queueing an Operation to
+    *    dispatching it, in microseconds.
+    * "maxQueueWait": the highest such time, in microseconds.
+    *
+    * @return the statistics.
+    */
+   virtual monarch::rt::DynamicObject getStats();
+
+   /**
+    * Resets the statistics for this Engine, including the latency
+    * statistics for each type of Operation.
+    */
+   virtual void resetStats();
+
+   /**
+    * Sets whether or not latency statistics are recorded for each type of
+    * Operation that is run. They are recorded by default.
+    *
+    * @param enabled true to record latency statistics, false not to.
+    */
+   virtual void setOperationStatsEnabled(bool enabled);
+
+   /**
+    * Gets the latency statistics for each type of Operation that was run.
+    *
+    * @return the latency statistics.
+    */
+   virtual OperationStats* getOperationStats();
+
 protected:
    /**
     * Returns true if this dispatcher has a job it can dispatch.
@@ -150,11 +341,145 @@ protected:
     */
    virtual bool canDispatch();
 
+   /**
+    * Gets how long this dispatcher may sleep for, which is until the
+    * earliest deadline of the queued Operations.
+    *
+    * @return the time in milliseconds, 0 to sleep until woken up.
+    */
+   virtual uint32_t getParkTimeout();
+
+   /**
+    * Records that a job was dispatched, for statistics.
+    *
+    * @param job the job that was dispatched.
+    */
+   virtual void jobDispatched(Job& job);
+
+   /**
+    * Gets the Operation of a job.
+    *
+    * @param job the job.
+    *
+    * @return the Operation.
+    */
+   virtual Operation* getOperation(Job& job);
+
    /**
     * Dispatches the Operations that can be dispatched.
     */
    virtual void dispatchJobs();
 
+   /**
+    * Checks a queued job, running it if it can be executed, setting it aside
+    * if it must wait for state to change and removing it from its queue if
+    * it is run, canceled or deleted.
+    *
+    * @param queue the queue the job is in.
+    * @param i the position of the job, updated to the next job.
+    * @param deadline the earliest deadline of the jobs that stay queued,
+    *           updated with the job's deadline if it stays queued.
+    *
+    * @return true if the job was run, false if not.
+    */
+   virtual bool dispatchJob(
+      JobList& queue, JobList::iterator& i, uint64_t& deadline);
+
+   /**
+    * The result of checking a job's guard.
+    */
+   enum JobCheck
+   {
+      JobRun,
+      JobWait,
+      JobCancel,
+      JobExpire
+   };
+
+   /**
+    * Checks a job's deadline and guard and runs the job if it can be
+    * executed or stops it if it must be canceled. The state lock must be
+    * held when calling this method, it is released unless the job must
+    * wait.
+    *
+    * @param job the job to check.
+    *
+    * @return JobRun if the job was run, JobWait if it must wait, JobCancel
+    *         if it was canceled, JobExpire if its deadline passed.
+    */
+   virtual JobCheck checkJob(Job& job);
+
+   /**
+    * Frees a job that was run, canceled or expired. The lock for this
+    * dispatcher must be held when calling this method.
+    *
+    * @param job the job.
+    * @param check the result of checking the job.
+    */
+   virtual void jobDone(Job& job, JobCheck check);
+
+   /**
+    * Checks the jobs that wait on the state that changed since the last
+    * dispatch. The jobs in each line are checked in order until one must
+    * keep waiting.
+    */
+   virtual void dispatchWaitingJobs();
+
+   /**
+    * Sets a job aside until the state that it waits on changes. The state
+    * lock and the lock for this dispatcher must be held when calling this
+    * method.
+    *
+    * @param id the order the job started waiting in.
+    * @param wj the job and the keys of the state it waits on.
+    */
+   virtual void addWaitingJob(uint64_t id, WaitingJob& wj);
+
+   /**
+    * Removes a job that was set aside. The state lock and the lock for this
+    * dispatcher must be held when calling this method.
+    *
+    * @param id the order the job started waiting in.
+    */
+   virtual void removeWaitingJob(uint64_t id);
+
+   /**
+    * Moves all of the jobs that were set aside back onto the job queue. The
+    * state lock and the lock for this dispatcher must be held when calling
+    * this method.
+    */
+   virtual void wakeWaitingJobs();
+
+   /**
+    * Moves the jobs that were set aside and whose deadline has passed back
+    * onto the job queue. The state lock and the lock for this dispatcher
+    * must be held when calling this method.
+    *
+    * @param now the current time in milliseconds.
+    */
+   virtual void wakeExpiredJobs(uint64_t now);
+
+   /**
+    * Records that the state with the given key changed so that the jobs
+    * waiting on it are checked on the next dispatch. The state lock must be
+    * held when calling this method.
+    *
+    * @param key the key of the state that changed, NULL if it is not known.
+    */
+   virtual void stateChanged(const char* key);
+
+   /**
+    * Records the state that a StateMutator just changed. The state lock must
+    * be held when calling this method.
+    *
+    * @param sm the StateMutator.
+    * @param op the Operation the state was changed for.
+    * @param preExecution true if the state was changed before execution,
+    *           false if after.
+    */
+   virtual void stateMutated(
+      StateMutator* sm, Operation& op, bool preExecution);
+
    /**
     * Runs an operation.
     *
@@ -6,6 +6,8 @@
 
 #include "monarch/rt/Collectable.h"
 
+#include <vector>
+
 namespace monarch
 {
 namespace modest
@@ -88,6 +90,34 @@ public:
     *         with this guard before it executes, false if not.
     */
    virtual bool mustCancelOperation(Operation &op) = 0;
+
+   /**
+    * Gets the keys of the state that this guard depends on. If this guard
+    * names its keys, an Engine will not check an Operation that must wait
+    * again until the state with one of those keys changes. Otherwise, the
+    * Operation is checked again every time the Engine dispatches.
+    *
+    * Operations whose guards name the same keys wait in line for that
+    * state. When it changes, they are checked in the order they started
+    * waiting until one of them must keep waiting, so the keys should name
+    * everything that makes one Operation wait when another would not.
+    *
+    * State is announced as changed by a StateMutator that names the keys it
+    * changes, or with Engine::signalStateChanged(). The keys must cover the
+    * state that both "canExecuteOperation()" and "mustCancelOperation()"
+    * depend on. Any StateMutator that does not name the keys it changes
+    * causes all waiting Operations to be checked again, as does interrupting
+    * any Operation.
+    *
+    * @param keys the list to add the keys to.
+    *
+    * @return true if the keys were added, false if this guard cannot name
+    *         the state it depends on.
+    */
+   virtual bool getStateKeys(std::vector<const char*>& keys)
+   {
+      return false;
+   };
 };
 
 // define a reference counted OperationGuard type
@@ -56,3 +56,10 @@ bool OperationGuardChain::mustCancelOperation(Operation &op)
       mGuard1->mustCancelOperation(op) ||
       (mGuard2 != NULL && mGuard2->canExecuteOperation(op));
 }
+
+bool OperationGuardChain::getStateKeys(std::vector<const char*>& keys)
+{
+   return
+      mGuard1->getStateKeys(keys) &&
+      (mGuard2 == NULL || mGuard2->getStateKeys(keys));
+}
@@ -104,6 +104,16 @@ public:
     *         with this guard before it executes, false if not.
     */
    virtual bool mustCancelOperation(Operation &op);
+
+   /**
+    * Gets the keys of the state that the chained guards depend on. The keys
+    * can only be named if both guards name them.
+    *
+    * @param keys the list to add the keys to.
+    *
+    * @return true if the keys were added, false if not.
+    */
+   virtual bool getStateKeys(std::vector<const char*>& keys);
 };
 
 } // end namespace modest
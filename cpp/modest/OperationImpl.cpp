@@ -4,10 +4,14 @@
 #include "monarch/modest/OperationImpl.h"
 
 #include "monarch/modest/Engine.h"
+#include "monarch/rt/System.h"
 
 using namespace monarch::modest;
 using namespace monarch::rt;
 
+// the number of times any operation has been interrupted
+static volatile uint32_t _interrupt_count = 0;
+
 OperationImpl::OperationImpl(Runnable& r) :
    mRunnable(&r),
    mThread(NULL),
@@ -16,6 +20,14 @@ OperationImpl::OperationImpl(Runnable& r) :
    mStopped(false),
    mFinished(false),
    mCanceled(false),
+   mExpired(false),
+   mPriority(Normal),
+   mDeadline(0),
+   mType("default"),
+   mQueuedTime(0),
+   mDispatchedTime(0),
+   mStartedTime(0),
+   mFinishedTime(0),
    mUserData(NULL)
 {
 }
@@ -29,6 +41,14 @@ OperationImpl::OperationImpl(RunnableRef& r) :
    mStopped(false),
    mFinished(false),
    mCanceled(false),
+   mExpired(false),
+   mPriority(Normal),
+   mDeadline(0),
+   mType("default"),
+   mQueuedTime(0),
+   mDispatchedTime(0),
+   mStartedTime(0),
+   mFinishedTime(0),
    mUserData(NULL)
 {
 }
@@ -42,6 +62,7 @@ void OperationImpl::run()
    mLock.lock();
    {
       // operation started on the current thread
+      mStartedTime = System::getMonotonicMicroseconds();
       mThread = Thread::currentThread();
       mStarted = true;
 
@@ -61,6 +82,8 @@ void OperationImpl::run()
 
    mLock.lock();
    {
+      mFinishedTime = System::getMonotonicMicroseconds();
+
       // determine if the operation was finished or canceled
       if(isInterrupted())
       {
@@ -160,6 +183,7 @@ void OperationImpl::interrupt()
       if(!mInterrupted)
       {
          mInterrupted = true;
+         Atomic::incrementAndFetch(&_interrupt_count);
          if(mThread != NULL)
          {
             mThread->interrupt();
@@ -201,6 +225,61 @@ bool OperationImpl::canceled()
    return mCanceled;
 }
 
+bool OperationImpl::expired()
+{
+   return mExpired;
+}
+
+void OperationImpl::setPriority(Priority priority)
+{
+   mPriority = priority;
+}
+
+OperationImpl::Priority OperationImpl::getPriority()
+{
+   return mPriority;
+}
+
+void OperationImpl::setDeadline(uint64_t deadline)
+{
+   mDeadline = deadline;
+}
+
+uint64_t OperationImpl::getDeadline()
+{
+   return mDeadline;
+}
+
+void OperationImpl::setType(const char* type)
+{
+   mType = type;
+}
+
+const char* OperationImpl::getType()
+{
+   return mType;
+}
+
+uint64_t OperationImpl::getQueuedTime()
+{
+   return mQueuedTime;
+}
+
+uint64_t OperationImpl::getDispatchedTime()
+{
+   return mDispatchedTime;
+}
+
+uint64_t OperationImpl::getStartedTime()
+{
+   return mStartedTime;
+}
+
+uint64_t OperationImpl::getFinishedTime()
+{
+   return mFinishedTime;
+}
+
 Thread* OperationImpl::getThread()
 {
    return mThread;
@@ -303,3 +382,8 @@ bool OperationImpl::interrupted()
 {
    return Thread::interrupted(false);
 }
+
+uint32_t OperationImpl::getInterruptCount()
+{
+   return _interrupt_count;
+}
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2007-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2007-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #ifndef monarch_modest_OperationImpl_H
 #define monarch_modest_OperationImpl_H
@@ -31,6 +31,24 @@ namespace modest
  */
 class OperationImpl : protected monarch::rt::Runnable
 {
+public:
+   /**
+    * The priority classes of Operations. An Engine keeps a queue for each
+    * class and dispatches from them in proportion to their weights, so a
+    * burst of Low priority Operations does not hold up High priority ones.
+    */
+   enum Priority
+   {
+      High,
+      Normal,
+      Low
+   };
+
+   /**
+    * The number of priority classes.
+    */
+   static const int PriorityClasses = 3;
+
 protected:
    /**
     * The Runnable for this Operation. A regular runnable or a
@@ -84,6 +102,36 @@ protected:
     */
    bool mCanceled;
 
+   /**
+    * Set to true if this Operation was canceled because its deadline passed
+    * before it could be executed.
+    */
+   bool mExpired;
+
+   /**
+    * The priority class of this Operation.
+    */
+   Priority mPriority;
+
+   /**
+    * The time by which this Operation must be executed, 0 for none.
+    */
+   uint64_t mDeadline;
+
+   /**
+    * The type of this Operation, for statistics.
+    */
+   const char* mType;
+
+   /**
+    * The times this Operation was queued, dispatched, started and finished
+    * at, in microseconds on the monotonic clock, 0 if they have not passed.
+    */
+   uint64_t mQueuedTime;
+   uint64_t mDispatchedTime;
+   uint64_t mStartedTime;
+   uint64_t mFinishedTime;
+
    /**
     * Some user data.
     */
@@ -190,6 +238,96 @@ public:
     */
    virtual bool canceled();
 
+   /**
+    * Returns true if this Operation was canceled because its deadline passed
+    * before it could be executed.
+    *
+    * @return true if this Operation expired, false otherwise.
+    */
+   virtual bool expired();
+
+   /**
+    * Sets the priority class of this Operation. This method must only be
+    * called prior to queuing this Operation. The default is Normal.
+    *
+    * @param priority the priority class.
+    */
+   virtual void setPriority(Priority priority);
+
+   /**
+    * Gets the priority class of this Operation.
+    *
+    * @return the priority class.
+    */
+   virtual Priority getPriority();
+
+   /**
+    * Sets the time by which this Operation must be executed. If it is still
+    * queued or waiting on its guard then, it is canceled instead. This
+    * method must only be called prior to queuing this Operation.
+    *
+    * @param deadline the deadline, in milliseconds since the epoch (such as
+    *           System::getCurrentMilliseconds() + 500), 0 for none.
+    */
+   virtual void setDeadline(uint64_t deadline);
+
+   /**
+    * Gets the time by which this Operation must be executed.
+    *
+    * @return the deadline in milliseconds since the epoch, 0 for none.
+    */
+   virtual uint64_t getDeadline();
+
+   /**
+    * Sets the type of this Operation. The Engine keeps latency statistics
+    * for each type of Operation. This method must only be called prior to
+    * queuing this Operation. The default is "default".
+    *
+    * @param type the type, such as "monarch.net.ConnectionService", which
+    *           is not copied and must outlive this Operation.
+    */
+   virtual void setType(const char* type);
+
+   /**
+    * Gets the type of this Operation.
+    *
+    * @return the type of this Operation.
+    */
+   virtual const char* getType();
+
+   /**
+    * Gets the time this Operation was queued at.
+    *
+    * @return the time, in microseconds on the monotonic clock (see
+    *         System::getMonotonicMicroseconds()), 0 if it was not queued.
+    */
+   virtual uint64_t getQueuedTime();
+
+   /**
+    * Gets the time the Engine dispatched this Operation to a thread at.
+    *
+    * @return the time, in microseconds on the monotonic clock, 0 if it was
+    *         not dispatched.
+    */
+   virtual uint64_t getDispatchedTime();
+
+   /**
+    * Gets the time this Operation started running at.
+    *
+    * @return the time, in microseconds on the monotonic clock, 0 if it has
+    *         not started.
+    */
+   virtual uint64_t getStartedTime();
+
+   /**
+    * Gets the time this Operation finished running at, whether or not it
+    * was canceled while running.
+    *
+    * @return the time, in microseconds on the monotonic clock, 0 if it has
+    *         not finished running.
+    */
+   virtual uint64_t getFinishedTime();
+
    /**
     * Gets the Thread for this Operation.
     *
@@ -260,6 +398,15 @@ public:
     * @return true if the current Operation has been interrupted, false if not.
     */
    static bool interrupted();
+
+   /**
+    * Gets the number of times any Operation has been interrupted. An Engine
+    * uses this to notice that an Operation that is waiting to be executed
+    * may have to be canceled.
+    *
+    * @return the number of interruptions.
+    */
+   static uint32_t getInterruptCount();
 };
 
 } // end namespace modest
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2007-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2007-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #include "monarch/modest/OperationList.h"
 
@@ -11,6 +11,7 @@ using namespace monarch::modest;
 using namespace monarch::rt;
 
 OperationList::OperationList(bool locking) :
+   mLock(true),
    mLocking(locking)
 {
 }
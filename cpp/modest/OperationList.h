@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2007-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2007-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #ifndef monarch_modest_OperationList_H
 #define monarch_modest_OperationList_H
@@ -39,7 +39,8 @@ protected:
    OpIndex mOpIndex;
 
    /**
-    * A lock for modifying the list.
+    * A lock for modifying the list. It is adaptive because it is only held
+    * briefly but often contended.
     */
    monarch::rt::ExclusiveLock mLock;
 
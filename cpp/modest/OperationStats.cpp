@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#include "monarch/modest/OperationStats.h"
+
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+using namespace monarch::modest;
+using namespace monarch::rt;
+
+OperationStats::OperationStats() :
+   mTypes(31)
+{
+}
+
+OperationStats::~OperationStats()
+{
+   for(vector<TypeStats*>::iterator i = mTypeList.begin();
+       i != mTypeList.end(); ++i)
+   {
+      free((*i)->type);
+      delete *i;
+   }
+}
+
+void OperationStats::record(Operation& op)
+{
+   TypeStats* ts = getTypeStats(op->getType());
+   uint64_t queued = op->getQueuedTime();
+   uint64_t dispatched = op->getDispatchedTime();
+   uint64_t started = op->getStartedTime();
+   uint64_t finished = op->getFinishedTime();
+   ts->queue.record(dispatched - queued);
+   ts->dispatch.record(started - dispatched);
+   ts->run.record(finished - started);
+   ts->total.record(finished - queued);
+}
+
+DynamicObject OperationStats::getStats()
+{
+   DynamicObject rval;
+   rval->setType(Map);
+
+   mLock.lock();
+   vector<TypeStats*> types = mTypeList;
+   mLock.unlock();
+
+   for(vector<TypeStats*>::iterator i = types.begin(); i != types.end(); ++i)
+   {
+      DynamicObject& stats = rval[(*i)->type];
+      stats["queue"] = (*i)->queue.getStats();
+      stats["dispatch"] = (*i)->dispatch.getStats();
+      stats["run"] = (*i)->run.getStats();
+      stats["total"] = (*i)->total.getStats();
+   }
+
+   return rval;
+}
+
+void OperationStats::reset()
+{
+   mLock.lock();
+   for(vector<TypeStats*>::iterator i = mTypeList.begin();
+       i != mTypeList.end(); ++i)
+   {
+      (*i)->queue.reset();
+      (*i)->dispatch.reset();
+      (*i)->run.reset();
+      (*i)->total.reset();
+   }
+   mLock.unlock();
+}
+
+OperationStats::TypeStats* OperationStats::getTypeStats(const char* type)
+{
+   TypeStats* rval;
+
+   if(!mTypes.get(type, rval))
+   {
+      // add the type if no other thread has
+      mLock.lock();
+      if(!mTypes.get(type, rval))
+      {
+         rval = new TypeStats;
+         rval->type = strdup(type);
+         mTypeList.push_back(rval);
+         mTypes.put(rval->type, rval);
+      }
+      mLock.unlock();
+   }
+
+   return rval;
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#ifndef monarch_modest_OperationStats_H
+#define monarch_modest_OperationStats_H
+
+#include "monarch/modest/Operation.h"
+#include "monarch/rt/ExclusiveLock.h"
+#include "monarch/rt/LatencyHistogram.h"
+#include "monarch/rt/StringTable.h"
+
+#include <vector>
+
+namespace monarch
+{
+namespace modest
+{
+
+/**
+ * OperationStats keeps latency histograms for each type of Operation that
+ * an Engine runs. For every Operation that runs, it records how long the
+ * Operation waited to be dispatched after it was queued (including any time
+ * spent waiting on its guard), how long it took to start on a thread once
+ * it was dispatched, how long it ran for and how long it took in total.
+ *
+ * Recording is lock-free once a type has been seen, so it can be left on in
+ * production. Types are never removed, there should be a small, fixed set
+ * of them.
+ */
+class OperationStats
+{
+protected:
+   /**
+    * The histograms for a type of Operation, in microseconds.
+    */
+   struct TypeStats
+   {
+      char* type;
+      monarch::rt::LatencyHistogram queue;
+      monarch::rt::LatencyHistogram dispatch;
+      monarch::rt::LatencyHistogram run;
+      monarch::rt::LatencyHistogram total;
+   };
+
+   /**
+    * The histograms for each type, for lock-free lookups.
+    */
+   typedef monarch::rt::HashTable<
+      const char*, TypeStats*,
+      monarch::rt::StringHashFunction, monarch::rt::StringEqualsFunction>
+      TypeMap;
+   TypeMap mTypes;
+
+   /**
+    * The histograms for each type in the order they were added.
+    */
+   std::vector<TypeStats*> mTypeList;
+
+   /**
+    * A lock for adding types.
+    */
+   monarch::rt::ExclusiveLock mLock;
+
+public:
+   /**
+    * Creates a new, empty OperationStats.
+    */
+   OperationStats();
+
+   /**
+    * Destructs this OperationStats.
+    */
+   virtual ~OperationStats();
+
+   /**
+    * Records the times of an Operation that has finished running.
+    *
+    * @param op the Operation.
+    */
+   virtual void record(Operation& op);
+
+   /**
+    * Gets a snapshot of the histograms of each type of Operation, in
+    * microseconds:
+    *
+    * {
+    *    "<type>": {
+    *       "queue": LatencyHistogram stats,
+    *       "dispatch": LatencyHistogram stats,
+    *       "run": LatencyHistogram stats,
+    *       "total": LatencyHistogram stats
+    *    },
+    *    ...
+    * }
+    *
+    * @return the snapshot.
+    */
+   virtual monarch::rt::DynamicObject getStats();
+
+   /**
+    * Clears the histograms of every type of Operation.
+    */
+   virtual void reset();
+
+protected:
+   /**
+    * Gets the histograms for a type of Operation, adding them if the type
+    * has not been seen before.
+    *
+    * @param type the type of Operation.
+    *
+    * @return the histograms for the type.
+    */
+   virtual TypeStats* getTypeStats(const char* type);
+};
+
+} // end namespace modest
+} // end namespace monarch
+#endif
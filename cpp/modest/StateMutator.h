@@ -6,6 +6,8 @@
 
 #include "monarch/rt/Collectable.h"
 
+#include <vector>
+
 namespace monarch
 {
 namespace modest
@@ -53,6 +55,32 @@ public:
     * @param op the Operation that finished or was canceled.
     */
    virtual void mutatePostExecutionState(Operation& op) {};
+
+   /**
+    * Gets the keys of the state that was just changed by a call to
+    * "mutatePreExecutionState()" or "mutatePostExecutionState()". An Engine
+    * will only check the waiting Operations whose guards depend on one of
+    * these keys again. If the keys are not named, all waiting Operations are
+    * checked again.
+    *
+    * For instance, a mutator that takes a resource before execution and
+    * gives it back after may name no keys for the former, since taking a
+    * resource cannot allow another Operation to execute, and the key of the
+    * resource for the latter.
+    *
+    * @param op the Operation that the state was changed for.
+    * @param preExecution true if the state was changed before execution,
+    *           false if after.
+    * @param keys the list to add the keys to.
+    *
+    * @return true if the keys were added, false if this mutator cannot name
+    *         the state it changed.
+    */
+   virtual bool getChangedStateKeys(
+      Operation& op, bool preExecution, std::vector<const char*>& keys)
+   {
+      return false;
+   };
 };
 
 // define a reference counted StateMutator type
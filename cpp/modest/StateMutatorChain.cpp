@@ -58,3 +58,12 @@ void StateMutatorChain::mutatePostExecutionState(Operation& op)
       mMutator2->mutatePostExecutionState(op);
    }
 }
+
+bool StateMutatorChain::getChangedStateKeys(
+   Operation& op, bool preExecution, std::vector<const char*>& keys)
+{
+   return
+      mMutator1->getChangedStateKeys(op, preExecution, keys) &&
+      (mMutator2 == NULL ||
+       mMutator2->getChangedStateKeys(op, preExecution, keys));
+}
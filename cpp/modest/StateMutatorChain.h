@@ -66,6 +66,20 @@ public:
     * @param op the Operation that finished or was canceled.
     */
    virtual void mutatePostExecutionState(Operation& op);
+
+   /**
+    * Gets the keys of the state that the chained mutators just changed. The
+    * keys can only be named if both mutators name them.
+    *
+    * @param op the Operation that the state was changed for.
+    * @param preExecution true if the state was changed before execution,
+    *           false if after.
+    * @param keys the list to add the keys to.
+    *
+    * @return true if the keys were added, false if not.
+    */
+   virtual bool getChangedStateKeys(
+      Operation& op, bool preExecution, std::vector<const char*>& keys);
 };
 
 } // end namespace modest
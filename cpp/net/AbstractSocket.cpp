@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2007-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2007-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #define __STDC_CONSTANT_MACROS
 
@@ -130,14 +130,16 @@ bool AbstractSocket::waitUntilReady(bool read, int64_t timeout)
          {
             // interrupted exception
             e = new Exception(
-               "Socket read interrupted.", "monarch.io.InterruptedException");
+               "Socket read interrupted.", "monarch.io.InterruptedException",
+               Exception::StaticStrings);
             e->getDetails()["error"] = strerror(errno);
          }
          else
          {
             // interrupted exception
             e = new Exception(
-               "Socket write interrupted.", "monarch.io.InterruptedException");
+               "Socket write interrupted.", "monarch.io.InterruptedException",
+               Exception::StaticStrings);
             e->getDetails()["error"] = strerror(errno);
          }
       }
@@ -147,14 +149,16 @@ bool AbstractSocket::waitUntilReady(bool read, int64_t timeout)
          {
             // error occurred, get string message
             e = new Exception(
-               "Could not read from socket.", SOCKET_EXCEPTION_TYPE);
+               "Could not read from socket.", SOCKET_EXCEPTION_TYPE,
+               Exception::StaticStrings);
             e->getDetails()["error"] = strerror(errno);
          }
          else
          {
             // error occurred, get string message
             e = new Exception(
-               "Could not write to socket.", SOCKET_EXCEPTION_TYPE);
+               "Could not write to socket.", SOCKET_EXCEPTION_TYPE,
+               Exception::StaticStrings);
             e->getDetails()["error"] = strerror(errno);
          }
 
@@ -170,17 +174,19 @@ bool AbstractSocket::waitUntilReady(bool read, int64_t timeout)
    {
       if(read)
       {
-         // read timeout occurred
+         // read timeout occurred, timeouts are common so no details are
+         // created for them
          e = new Exception(
-            "Socket read timed out.", SOCKET_TIMEOUT_EXCEPTION_TYPE);
-         e->getDetails()["error"] = strerror(errno);
+            "Socket read timed out.", SOCKET_TIMEOUT_EXCEPTION_TYPE,
+            Exception::StaticStrings);
       }
       else
       {
-         // write timeout occurred
+         // write timeout occurred, timeouts are common so no details are
+         // created for them
          e = new Exception(
-            "Socket write timed out.", SOCKET_TIMEOUT_EXCEPTION_TYPE);
-         e->getDetails()["error"] = strerror(errno);
+            "Socket write timed out.", SOCKET_TIMEOUT_EXCEPTION_TYPE,
+            Exception::StaticStrings);
       }
    }
    else
@@ -197,14 +203,16 @@ bool AbstractSocket::waitUntilReady(bool read, int64_t timeout)
          {
             // error occurred, get string message
             e = new Exception(
-               "Could not read from socket.", SOCKET_EXCEPTION_TYPE);
+               "Could not read from socket.", SOCKET_EXCEPTION_TYPE,
+               Exception::StaticStrings);
             e->getDetails()["error"] = strerror(lastError);
          }
          else
          {
             // error occurred, get string message
             e = new Exception(
-               "Could not write to socket.", SOCKET_EXCEPTION_TYPE);
+               "Could not write to socket.", SOCKET_EXCEPTION_TYPE,
+               Exception::StaticStrings);
             e->getDetails()["error"] = strerror(lastError);
          }
       }
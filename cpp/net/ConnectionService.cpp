@@ -12,6 +12,8 @@
 #include "monarch/rt/RunnableDelegate.h"
 #include "monarch/util/Timer.h"
 
+#include <cstdio>
+
 using namespace std;
 using namespace monarch::modest;
 using namespace monarch::net;
@@ -32,6 +34,11 @@ ConnectionService::ConnectionService(
    mCurrentConnections(0),
    mBacklog(100)
 {
+   char key[64];
+   snprintf(key, 64, "monarch.net.Server.connections:%p", server);
+   mServerKey = key;
+   snprintf(key, 64, "monarch.net.ConnectionService.connections:%p", this);
+   mServiceKey = key;
 }
 
 ConnectionService::~ConnectionService()
@@ -105,6 +112,24 @@ void ConnectionService::mutatePostExecutionState(Operation& op)
    --mServer->mCurrentConnections;
 }
 
+bool ConnectionService::getStateKeys(vector<const char*>& keys)
+{
+   keys.push_back(mServerKey.c_str());
+   keys.push_back(mServiceKey.c_str());
+   return true;
+}
+
+bool ConnectionService::getChangedStateKeys(
+   Operation& op, bool preExecution, vector<const char*>& keys)
+{
+   if(!preExecution)
+   {
+      keys.push_back(mServerKey.c_str());
+      keys.push_back(mServiceKey.c_str());
+   }
+   return true;
+}
+
 void ConnectionService::run()
 {
    Socket* s;
@@ -121,6 +146,7 @@ void ConnectionService::run()
                this, &ConnectionService::serviceConnection, op);
          *op = Operation(r);
          (*op)->setUserData(s);
+         (*op)->setType("monarch.net.ConnectionService");
          (*op)->addGuard(this);
          (*op)->addStateMutator(this);
          mRunningServicers.add(*op);
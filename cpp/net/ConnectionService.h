@@ -70,6 +70,13 @@ protected:
     */
    monarch::modest::OperationList mRunningServicers;
 
+   /**
+    * The keys of the connection counts that Operations wait on, one for
+    * the Server, shared by all of its services, and one for this service.
+    */
+   std::string mServerKey;
+   std::string mServiceKey;
+
 public:
    /**
     * Creates a new ConnectionService for a Server.
@@ -163,6 +170,32 @@ public:
     */
    virtual void mutatePostExecutionState(monarch::modest::Operation& op);
 
+   /**
+    * Gets the keys of the state that this guard depends on: the connection
+    * counts of the Server and of this service.
+    *
+    * @param keys the list to add the keys to.
+    *
+    * @return true.
+    */
+   virtual bool getStateKeys(std::vector<const char*>& keys);
+
+   /**
+    * Gets the keys of the state that was just changed. Opening a connection
+    * cannot allow another one to be opened, so only closing a connection
+    * changes the connection counts that are waited on.
+    *
+    * @param op the Operation that the state was changed for.
+    * @param preExecution true if the state was changed before execution,
+    *           false if after.
+    * @param keys the list to add the keys to.
+    *
+    * @return true.
+    */
+   virtual bool getChangedStateKeys(
+      monarch::modest::Operation& op, bool preExecution,
+      std::vector<const char*>& keys);
+
    /**
     * Runs this ConnectionService.
     */
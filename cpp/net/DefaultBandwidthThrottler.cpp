@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2007-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2007-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #define __STDC_LIMIT_MACROS
 
@@ -18,7 +18,8 @@ using namespace monarch::util;
 DefaultBandwidthThrottler::DefaultBandwidthThrottler(int rateLimit) :
    mLastRequestTime(0),
    mAvailableBytes(0),
-   mWaiters(0)
+   mWaiters(0),
+   mLock(true)
 {
    // set the rate limit (will also reset the window time if necessary)
    setRateLimit(rateLimit);
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2007-2009 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2007-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #ifndef monarch_net_DefaultBandwidthThrottler_H
 #define monarch_net_DefaultBandwidthThrottler_H
@@ -58,7 +58,8 @@ protected:
    volatile uint32_t mWaiters;
 
    /**
-    * A lock for synchronizing the use of this throttler.
+    * A lock for synchronizing the use of this throttler. It is adaptive
+    * because it is only held briefly by every read and write.
     */
    monarch::rt::ExclusiveLock mLock;
 
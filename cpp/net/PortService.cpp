@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2007-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2007-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #include "monarch/net/PortService.h"
 
@@ -38,6 +38,7 @@ bool PortService::start()
    if(!mOperation.isNull())
    {
       // run service
+      mOperation->setType("monarch.net.PortService");
       mServer->getOperationRunner()->runOperation(mOperation);
    }
    else
@@ -5,20 +5,16 @@
 
 using namespace std;
 using namespace monarch::net;
+using namespace monarch::rt;
 using namespace monarch::util;
 
-SslSessionCache::SslSessionCache(unsigned int capacity) :
-   mCapacity(capacity)
+SslSessionCache::SslSessionCache(unsigned int capacity, uint32_t ttl) :
+   mSessions(capacity, 0, ttl)
 {
 }
 
 SslSessionCache::~SslSessionCache()
 {
-   // clean up cache entries
-   for(SessionMap::iterator i = mSessions.begin(); i != mSessions.end(); ++i)
-   {
-      free((char*)i->first);
-   }
 }
 
 static string _getSessionKey(const char* host, const char* vHost)
@@ -36,31 +32,8 @@ static string _getSessionKey(const char* host, const char* vHost)
 void SslSessionCache::storeSession(
    const char* host, SslSession& session, const char* vHost)
 {
-   // lock to write to cache
-   mLock.lockExclusive();
-   {
-      // find existing session
-      string key = _getSessionKey(host, vHost);
-      SessionMap::iterator i = mSessions.find(key.c_str());
-      if(i != mSessions.end())
-      {
-         // update existing entry
-         i->second = session;
-      }
-      else if(mSessions.size() >= mCapacity)
-      {
-         // free up space in the map
-         i = mSessions.begin();
-         free((char*)i->first);
-         mSessions.erase(i);
-      }
-      else
-      {
-         // insert new entry
-         mSessions.insert(std::make_pair(strdup(key.c_str()), session));
-      }
-   }
-   mLock.unlockExclusive();
+   // add or update entry, evicting old entries as needed
+   mSessions.put(_getSessionKey(host, vHost), session);
 }
 
 inline void SslSessionCache::storeSession(
@@ -72,19 +45,7 @@ inline void SslSessionCache::storeSession(
 SslSession SslSessionCache::getSession(const char* host, const char* vHost)
 {
    SslSession rval(NULL);
-
-   // lock to read from cache
-   mLock.lockShared();
-   {
-      string key = _getSessionKey(host, vHost);
-      SessionMap::iterator i = mSessions.find(key.c_str());
-      if(i != mSessions.end())
-      {
-         rval = i->second;
-      }
-   }
-   mLock.unlockShared();
-
+   mSessions.get(_getSessionKey(host, vHost), rval);
    return rval;
 }
 
@@ -92,3 +53,8 @@ inline SslSession SslSessionCache::getSession(Url* url, const char* vHost)
 {
    return getSession(url->getAuthority().c_str(), vHost);
 }
+
+DynamicObject SslSessionCache::getStats()
+{
+   return mSessions.getStats();
+}
@@ -5,11 +5,11 @@
 #define monarch_net_SslSessionCache_H
 
 #include "monarch/net/SslSession.h"
-#include "monarch/rt/SharedLock.h"
-#include "monarch/util/StringTools.h"
+#include "monarch/rt/ClockCache.h"
+#include "monarch/rt/StringTable.h"
 #include "monarch/util/Url.h"
 
-#include <map>
+#include <string>
 
 namespace monarch
 {
@@ -17,7 +17,11 @@ namespace net
 {
 
 /**
- * An SslSessionCache is a thread-safe cache for SslSessions.
+ * An SslSessionCache is a thread-safe cache for SslSessions. Looking up a
+ * session does not block. When the cache is full, sessions are evicted
+ * using the CLOCK (second-chance) algorithm: a session that has been looked
+ * up since the clock hand last passed it is skipped once, otherwise it is
+ * evicted.
  *
  * @author Dave Longley
  */
@@ -25,30 +29,23 @@ class SslSessionCache
 {
 protected:
    /**
-    * A mapping of session keys to re-usable SSL sessions.
+    * A cache of session keys to re-usable SSL sessions.
     */
-   typedef std::map<
-      const char*, monarch::net::SslSession, monarch::util::StringComparator>
+   typedef monarch::rt::ClockCache<
+      std::string, monarch::net::SslSession,
+      monarch::rt::StringHashFunction, monarch::rt::StringEqualsFunction>
       SessionMap;
    SessionMap mSessions;
 
-   /**
-    * Stores the capacity of this cache.
-    */
-   unsigned int mCapacity;
-
-   /**
-    * A lock for modifying the session map.
-    */
-   monarch::rt::SharedLock mLock;
-
 public:
    /**
     * Creates a new SslSessionCache with the specified capacity.
     *
     * @param capacity the maximum number of sessions to cache.
+    * @param ttl the number of milliseconds to keep a session for, 0 to keep
+    *           it until it is evicted.
     */
-   SslSessionCache(unsigned int capacity = 50);
+   SslSessionCache(unsigned int capacity = 50, uint32_t ttl = 0);
 
    /**
     * Destructs this SslSessionCache.
@@ -95,6 +92,13 @@ public:
     */
    virtual SslSession getSession(
       monarch::util::Url* url, const char* vHost = NULL);
+
+   /**
+    * Gets statistics for this cache, see ClockCache::getStats().
+    *
+    * @return the statistics.
+    */
+   virtual monarch::rt::DynamicObject getStats();
 };
 
 // type definition for a reference counted SslSessionCache
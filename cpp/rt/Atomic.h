@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2009-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2009-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #ifndef monarch_rt_Atomic_H
 #define monarch_rt_Atomic_H
@@ -88,6 +88,30 @@ public:
    template<typename T>
    static inline T decrementAndFetch(volatile T* dst);
 
+   /**
+    * Performs an atomic Add-And-Fetch. Adds to the value at the given
+    * destination.
+    *
+    * @param dst the destination with the value to add to.
+    * @param value the value to add, which may be negative.
+    *
+    * @return the new value.
+    */
+   template<typename T>
+   static inline T addAndFetch(volatile T* dst, T value);
+
+   /**
+    * Performs an atomic exchange. Writes the given value to the destination
+    * and returns the value it replaced.
+    *
+    * @param dst the destination to write the new value to.
+    * @param newVal the new value.
+    *
+    * @return the old value.
+    */
+   template<typename T>
+   static inline T exchange(volatile T* dst, T newVal);
+
    /**
     * Performs an atomic Compare-And-Swap (CAS). The given new value will only
     * be written to the destination if it contains the given old value. If
@@ -105,6 +129,13 @@ public:
    static inline bool compareAndSwap(volatile T* dst, T oldVal, T newVal);
    template<typename T>
    static inline bool compareAndSwap(volatile T** dst, T* oldVal, T* newVal);
+
+   /**
+    * Issues a full memory barrier. No load or store before the barrier may
+    * be reordered with a load or store after it, by either the compiler or
+    * the CPU.
+    */
+   static inline void memoryBarrier();
 };
 
 template<typename T>
@@ -127,6 +158,30 @@ T Atomic::decrementAndFetch(volatile T* dst)
 #endif
 }
 
+template<typename T>
+T Atomic::addAndFetch(volatile T* dst, T value)
+{
+#ifdef WIN32
+   return InterlockedExchangeAdd((LONG*)dst, (LONG)value) + value;
+#else
+   return __sync_add_and_fetch(dst, value);
+#endif
+}
+
+template<typename T>
+T Atomic::exchange(volatile T* dst, T newVal)
+{
+#ifdef WIN32
+   return (T)InterlockedExchange((LONG*)dst, (LONG)newVal);
+#else
+   // __sync_lock_test_and_set() is only an acquire barrier, make it full
+   __sync_synchronize();
+   T rval = __sync_lock_test_and_set(dst, newVal);
+   __sync_synchronize();
+   return rval;
+#endif
+}
+
 template<typename T>
 bool Atomic::compareAndSwap(volatile T* dst, T oldVal, T newVal)
 {
@@ -149,6 +204,15 @@ bool Atomic::compareAndSwap(volatile T** dst, T* oldVal, T* newVal)
 #endif
 }
 
+void Atomic::memoryBarrier()
+{
+#ifdef WIN32
+   MemoryBarrier();
+#else
+   __sync_synchronize();
+#endif
+}
+
 } // end namespace rt
 } // end namespace monarch
 #endif
@@ -0,0 +1,482 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#ifndef monarch_rt_ClockCache_H
+#define monarch_rt_ClockCache_H
+
+#include "monarch/rt/Collectable.h"
+#include "monarch/rt/DynamicObject.h"
+#include "monarch/rt/ExclusiveLock.h"
+#include "monarch/rt/HashTable.h"
+#include "monarch/rt/System.h"
+
+#include <list>
+
+namespace monarch
+{
+namespace rt
+{
+
+/**
+ * A ClockCache is a bounded cache that can be used by many threads at once.
+ *
+ * Lookups are lock-free, they only read from a HashTable that maps every
+ * key to its cached entry. Storing and removing entries is serialized with
+ * a lock.
+ *
+ * When the cache is full, entries are evicted using the CLOCK algorithm, an
+ * approximation of least-recently-used eviction that does not require
+ * lookups to reorder a shared list. Every entry has a referenced flag that
+ * is set when the entry is looked up. A clock hand sweeps over the entries
+ * in the order they were stored, clearing any referenced flag it finds and
+ * evicting the first entry that has not been referenced since the hand last
+ * passed it.
+ *
+ * A cache can be limited by the number of entries it holds, by the total
+ * size of its entries, or both. The size of an entry is given when it is
+ * stored, for instance its length in bytes. Entries can also expire after
+ * a time-to-live. An expired entry is never returned from a lookup and is
+ * evicted as soon as the clock hand reaches it.
+ *
+ * Keys and values are copied into and out of the cache, so large values
+ * should be reference counted and string keys should be std::strings. A
+ * value that has been looked up remains valid after it has been evicted.
+ */
+template<typename _K, typename _V, typename _H,
+typename _E = DefaultEqualsFunction<_K> >
+class ClockCache
+{
+protected:
+   /**
+    * A cached entry and its position on the clock.
+    */
+   struct CacheEntry;
+   typedef Collectable<CacheEntry> CacheEntryRef;
+   typedef std::list<CacheEntryRef> Clock;
+   struct CacheEntry
+   {
+      _K key;
+      _V value;
+      uint64_t size;
+      uint64_t expires;
+      volatile bool referenced;
+      typename Clock::iterator position;
+   };
+
+   /**
+    * The table of cached entries.
+    */
+   HashTable<_K, CacheEntryRef, _H, _E> mTable;
+
+   /**
+    * The cached entries in the order they are visited by the clock hand and
+    * the clock hand.
+    */
+   Clock mClock;
+   typename Clock::iterator mHand;
+
+   /**
+    * A lock for storing and removing entries.
+    */
+   ExclusiveLock mLock;
+
+   /**
+    * The maximum number of entries and their maximum total size, 0 for no
+    * maximum.
+    */
+   uint32_t mMaxCount;
+   uint64_t mMaxSize;
+
+   /**
+    * The default time-to-live for entries in milliseconds, 0 for none.
+    */
+   uint32_t mTtl;
+
+   /**
+    * The number of entries and their total size.
+    */
+   uint32_t mCount;
+   uint64_t mSize;
+
+   /**
+    * Statistics: the number of lookups that found a value, the number that
+    * did not, the number of entries evicted to make room and the number of
+    * expired entries that were evicted.
+    */
+   volatile uint64_t mHits;
+   volatile uint64_t mMisses;
+   volatile uint64_t mEvictions;
+   volatile uint64_t mExpirations;
+
+public:
+   /**
+    * Creates a new ClockCache.
+    *
+    * @param maxCount the maximum number of entries, 0 for no maximum.
+    * @param maxSize the maximum total size of the entries, 0 for no maximum.
+    * @param ttl the default time-to-live for entries in milliseconds, 0 for
+    *           entries not to expire.
+    */
+   ClockCache(uint32_t maxCount = 0, uint64_t maxSize = 0, uint32_t ttl = 0);
+
+   /**
+    * Destructs this ClockCache.
+    */
+   virtual ~ClockCache();
+
+   /**
+    * Gets the value that is cached for the passed key. This does not block.
+    *
+    * @param k the key to get the value for.
+    * @param v to be set to the value.
+    *
+    * @return true if an unexpired value was found, false if not.
+    */
+   virtual bool get(const _K& k, _V& v);
+
+   /**
+    * Caches a value, replacing any existing value for the same key. Other
+    * entries are evicted as needed to stay within the limits of this cache.
+    *
+    * @param k the key.
+    * @param v the value.
+    * @param size the size of the value.
+    * @param ttl the time-to-live for the value in milliseconds, 0 to use the
+    *           default for this cache.
+    *
+    * @return true if the value was cached, false if it is too large to fit.
+    */
+   virtual bool put(
+      const _K& k, const _V& v, uint64_t size = 1, uint32_t ttl = 0);
+
+   /**
+    * Removes the value that is cached for the passed key.
+    *
+    * @param k the key to remove the value for.
+    *
+    * @return true if a value was removed, false if none was cached.
+    */
+   virtual bool remove(const _K& k);
+
+   /**
+    * Removes all expired values from this cache.
+    */
+   virtual void removeExpired();
+
+   /**
+    * Removes all values from this cache.
+    */
+   virtual void clear();
+
+   /**
+    * Gets the number of entries in this cache.
+    *
+    * @return the number of entries.
+    */
+   virtual uint32_t getCount();
+
+   /**
+    * Gets the total size of the entries in this cache.
+    *
+    * @return the total size.
+    */
+   virtual uint64_t getSize();
+
+   /**
+    * Gets statistics for this cache:
+    *
+    * "count": the number of entries.
+    * "size": the total size of the entries.
+    * "hits": the number of lookups that found a value.
+    * "misses": the number of lookups that did not find a value.
+    * "evictions": the number of entries evicted to make room.
+    * "expirations": the number of expired entries evicted.
+    *
+    * @return the statistics.
+    */
+   virtual DynamicObject getStats();
+
+   /**
+    * Resets the statistics for this cache, apart from the count and size.
+    */
+   virtual void resetStats();
+
+protected:
+   /**
+    * Returns true if the given entry has expired.
+    *
+    * @param e the entry to check.
+    * @param now the current time in milliseconds.
+    *
+    * @return true if the entry has expired, false if not.
+    */
+   virtual bool isExpired(CacheEntryRef& e, uint64_t now);
+
+   /**
+    * Unlinks an entry from the clock. The lock must be held.
+    *
+    * @param e the entry to unlink.
+    * @param removeKey true to also remove its key from the table.
+    */
+   virtual void unlinkEntry(CacheEntryRef& e, bool removeKey);
+
+   /**
+    * Evicts entries until this cache is within its limits. The lock must
+    * be held.
+    */
+   virtual void evict();
+};
+
+template<typename _K, typename _V, typename _H, typename _E>
+ClockCache<_K, _V, _H, _E>::ClockCache(
+   uint32_t maxCount, uint64_t maxSize, uint32_t ttl) :
+   mTable((maxCount > 0) ? maxCount * 2 + 1 : 31),
+   mMaxCount(maxCount),
+   mMaxSize(maxSize),
+   mTtl(ttl),
+   mCount(0),
+   mSize(0),
+   mHits(0),
+   mMisses(0),
+   mEvictions(0),
+   mExpirations(0)
+{
+   mHand = mClock.end();
+}
+
+template<typename _K, typename _V, typename _H, typename _E>
+ClockCache<_K, _V, _H, _E>::~ClockCache()
+{
+}
+
+template<typename _K, typename _V, typename _H, typename _E>
+bool ClockCache<_K, _V, _H, _E>::get(const _K& k, _V& v)
+{
+   bool rval = false;
+
+   // a null entry is left behind while a key is being removed
+   CacheEntryRef e;
+   if(mTable.get(k, e) && !e.isNull() &&
+      (e->expires == 0 || !isExpired(e, System::getCurrentMilliseconds())))
+   {
+      // only write the flag if it is not set to keep the entry's cache line
+      // shared between CPUs
+      if(!e->referenced)
+      {
+         e->referenced = true;
+      }
+      v = e->value;
+      rval = true;
+   }
+
+   // update stats
+   Atomic::incrementAndFetch(rval ? &mHits : &mMisses);
+
+   return rval;
+}
+
+template<typename _K, typename _V, typename _H, typename _E>
+bool ClockCache<_K, _V, _H, _E>::put(
+   const _K& k, const _V& v, uint64_t size, uint32_t ttl)
+{
+   bool rval = (mMaxSize == 0 || size <= mMaxSize);
+
+   mLock.lock();
+   {
+      // unlink any existing entry, its key will be replaced or removed
+      CacheEntryRef old;
+      if(mTable.get(k, old) && !old.isNull())
+      {
+         unlinkEntry(old, !rval);
+      }
+
+      if(rval)
+      {
+         // create the entry
+         CacheEntryRef e = new CacheEntry;
+         e->key = k;
+         e->value = v;
+         e->size = size;
+         ttl = (ttl == 0) ? mTtl : ttl;
+         e->expires = (ttl == 0) ? 0 : System::getCurrentMilliseconds() + ttl;
+         e->referenced = false;
+
+         // add the entry behind the clock hand so that it is visited last
+         e->position = mClock.insert(mHand, e);
+         ++mCount;
+         mSize += size;
+         mTable.put(k, e);
+
+         // make room for the entry
+         evict();
+      }
+   }
+   mLock.unlock();
+
+   return rval;
+}
+
+template<typename _K, typename _V, typename _H, typename _E>
+bool ClockCache<_K, _V, _H, _E>::remove(const _K& k)
+{
+   bool rval = false;
+
+   mLock.lock();
+   {
+      CacheEntryRef e;
+      if(mTable.get(k, e) && !e.isNull())
+      {
+         unlinkEntry(e, true);
+         rval = true;
+      }
+   }
+   mLock.unlock();
+
+   return rval;
+}
+
+template<typename _K, typename _V, typename _H, typename _E>
+void ClockCache<_K, _V, _H, _E>::removeExpired()
+{
+   mLock.lock();
+   {
+      uint64_t now = System::getCurrentMilliseconds();
+      typename Clock::iterator i = mClock.begin();
+      while(i != mClock.end())
+      {
+         CacheEntryRef e = *i;
+         ++i;
+         if(isExpired(e, now))
+         {
+            unlinkEntry(e, true);
+            ++mExpirations;
+         }
+      }
+   }
+   mLock.unlock();
+}
+
+template<typename _K, typename _V, typename _H, typename _E>
+void ClockCache<_K, _V, _H, _E>::clear()
+{
+   mLock.lock();
+   {
+      mTable.clear();
+      mClock.clear();
+      mHand = mClock.end();
+      mCount = 0;
+      mSize = 0;
+   }
+   mLock.unlock();
+}
+
+template<typename _K, typename _V, typename _H, typename _E>
+uint32_t ClockCache<_K, _V, _H, _E>::getCount()
+{
+   return mCount;
+}
+
+template<typename _K, typename _V, typename _H, typename _E>
+uint64_t ClockCache<_K, _V, _H, _E>::getSize()
+{
+   return mSize;
+}
+
+template<typename _K, typename _V, typename _H, typename _E>
+DynamicObject ClockCache<_K, _V, _H, _E>::getStats()
+{
+   DynamicObject rval;
+
+   rval["count"] = mCount;
+   rval["size"] = mSize;
+   rval["hits"] = (uint64_t)mHits;
+   rval["misses"] = (uint64_t)mMisses;
+   rval["evictions"] = (uint64_t)mEvictions;
+   rval["expirations"] = (uint64_t)mExpirations;
+
+   return rval;
+}
+
+template<typename _K, typename _V, typename _H, typename _E>
+void ClockCache<_K, _V, _H, _E>::resetStats()
+{
+   // evictions and expirations are counted while holding the lock
+   mLock.lock();
+   mHits = 0;
+   mMisses = 0;
+   mEvictions = 0;
+   mExpirations = 0;
+   mLock.unlock();
+}
+
+template<typename _K, typename _V, typename _H, typename _E>
+bool ClockCache<_K, _V, _H, _E>::isExpired(CacheEntryRef& e, uint64_t now)
+{
+   return e->expires != 0 && e->expires <= now;
+}
+
+template<typename _K, typename _V, typename _H, typename _E>
+void ClockCache<_K, _V, _H, _E>::unlinkEntry(CacheEntryRef& e, bool removeKey)
+{
+   // move the hand past the entry
+   if(mHand == e->position)
+   {
+      ++mHand;
+   }
+   mClock.erase(e->position);
+   --mCount;
+   mSize -= e->size;
+
+   if(removeKey)
+   {
+      /* Note: Replace the entry with a null entry before removing the key,
+         a removed key keeps its last value in the table until the key is
+         stored again, but a replaced value is released once no lookup is
+         using it. */
+      mTable.put(e->key, CacheEntryRef());
+      mTable.remove(e->key);
+   }
+}
+
+template<typename _K, typename _V, typename _H, typename _E>
+void ClockCache<_K, _V, _H, _E>::evict()
+{
+   uint64_t now = 0;
+   while((mMaxCount > 0 && mCount > mMaxCount) ||
+         (mMaxSize > 0 && mSize > mMaxSize))
+   {
+      // wrap the hand around
+      if(mHand == mClock.end())
+      {
+         mHand = mClock.begin();
+      }
+
+      CacheEntryRef e = *mHand;
+      if(e->expires != 0 && now == 0)
+      {
+         now = System::getCurrentMilliseconds();
+      }
+      if(isExpired(e, now))
+      {
+         // always evict expired entries
+         unlinkEntry(e, true);
+         ++mExpirations;
+      }
+      else if(e->referenced)
+      {
+         // give the entry a second chance
+         e->referenced = false;
+         ++mHand;
+      }
+      else
+      {
+         // evict the entry
+         unlinkEntry(e, true);
+         ++mEvictions;
+      }
+   }
+}
+
+} // end namespace rt
+} // end namespace monarch
+#endif
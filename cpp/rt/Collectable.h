@@ -1,16 +1,187 @@
 /*
- * Copyright (c) 2007-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2007-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #ifndef monarch_rt_Collectable_H
 #define monarch_rt_Collectable_H
 
 #include "monarch/rt/Atomic.h"
 
+#include <new>
+
 namespace monarch
 {
 namespace rt
 {
 
+/**
+ * A CollectableAllocator allocates the memory for the References of a
+ * Collectable. By default, References are allocated using the global
+ * operator new. A HeapObject type may specialize this template to use a
+ * different allocation strategy for its References.
+ */
+template<typename HeapObject>
+struct CollectableAllocator
+{
+   /**
+    * Allocates the memory for a Reference.
+    *
+    * @param size the number of bytes to allocate.
+    *
+    * @return the allocated memory.
+    */
+   static void* allocate(size_t size)
+   {
+      return ::operator new(size);
+   }
+
+   /**
+    * Frees the memory for a Reference.
+    *
+    * @param ptr the memory to free.
+    * @param size the number of bytes that were allocated.
+    */
+   static void deallocate(void* ptr, size_t size)
+   {
+      ::operator delete(ptr);
+   }
+};
+
+/**
+ * A CollectableReference is the reference count for a HeapObject that is
+ * shared by all of the Collectables that point at it.
+ */
+template<typename HeapObject>
+struct CollectableReference
+{
+   /**
+    * The ways a CollectableReference may be stored.
+    */
+   enum Storage
+   {
+      /**
+       * Allocated separately from its HeapObject.
+       */
+      Separate,
+
+      /**
+       * Allocated in the same block of memory as its HeapObject, which
+       * immediately follows it.
+       */
+      Embedded,
+
+      /**
+       * A base class of its HeapObject (see CollectableObject).
+       */
+      Intrusive
+   };
+
+   /**
+    * A pointer to a HeapObject.
+    */
+   HeapObject* ptr;
+
+   /**
+    * A reference count for HeapObject.
+    */
+   volatile aligned_int32_t count;
+
+   /**
+    * True if ownership over the HeapObject's memory has been
+    * relinquished and, therefore, it should not be deleted.
+    */
+   volatile bool relinquished;
+
+   /**
+    * How this reference is stored.
+    */
+   unsigned char storage;
+
+   /**
+    * Allocates a CollectableReference using the CollectableAllocator for
+    * HeapObject.
+    */
+   static void* operator new(size_t size)
+   {
+      return CollectableAllocator<HeapObject>::allocate(size);
+   }
+
+   /**
+    * Frees a CollectableReference using the CollectableAllocator for
+    * HeapObject.
+    */
+   static void operator delete(void* ptr, size_t size)
+   {
+      CollectableAllocator<HeapObject>::deallocate(ptr, size);
+   }
+};
+
+/**
+ * A CollectableObject is an optional base class for a HeapObject that stores
+ * its own reference count, so that no separate reference needs to be
+ * allocated when it is wrapped in a Collectable. It also allows a Collectable
+ * to be safely created from a raw pointer to an object that is already
+ * referenced by another Collectable (ie: from "this").
+ *
+ * Example:
+ *
+ * class Foo : public CollectableObject<Foo> { ... };
+ * Collectable<Foo> foo = new Foo();
+ */
+template<typename HeapObject>
+class CollectableObject : public CollectableReference<HeapObject>
+{
+public:
+   /**
+    * Creates a new CollectableObject with no references.
+    */
+   CollectableObject()
+   {
+      init();
+   };
+
+   /**
+    * Creates a new CollectableObject with no references. The reference
+    * count is not copied.
+    *
+    * @param copy the object to copy.
+    */
+   CollectableObject(const CollectableObject& copy) :
+      CollectableReference<HeapObject>()
+   {
+      init();
+   };
+
+   /**
+    * Destructs this CollectableObject.
+    */
+   virtual ~CollectableObject() {};
+
+   /**
+    * Assigns another object to this one. The reference count is not
+    * assigned.
+    *
+    * @param rhs the object to assign.
+    *
+    * @return this object.
+    */
+   CollectableObject& operator=(const CollectableObject& rhs)
+   {
+      return *this;
+   };
+
+protected:
+   /**
+    * Initializes the reference count.
+    */
+   void init()
+   {
+      this->ptr = static_cast<HeapObject*>(this);
+      this->count = 0;
+      this->relinquished = false;
+      this->storage = CollectableReference<HeapObject>::Intrusive;
+   };
+};
+
 /**
  * A Collectable is a reference counter for heap-allocated objects. When the
  * number of references to a particular heap-allocated object reaches zero,
@@ -49,6 +220,11 @@ namespace rt
  * modify it. If the same Collectable is modified concurrently, the results
  * are undefined.
  *
+ * Normally, the reference count for a HeapObject is allocated separately
+ * from it. There are two ways to avoid the extra allocation: make() allocates
+ * the reference count and a new HeapObject in a single block of memory, and
+ * a HeapObject that extends CollectableObject stores its own reference count.
+ *
  * @author Dave Longley
  */
 template<typename HeapObject>
@@ -58,23 +234,16 @@ protected:
    /**
     * The definition for a reference a HeapObject.
     */
-   struct Reference
-   {
-      /**
-       * A pointer to a HeapObject.
-       */
-      HeapObject* ptr;
+   typedef CollectableReference<HeapObject> Reference;
 
-      /**
-       * A reference count for HeapObject.
-       */
-      volatile aligned_int32_t count;
-
-      /**
-       * True if ownership over the HeapObject's memory has been
-       * relinquished and, therefore, it should not be deleted.
-       */
-      volatile bool relinquished;
+   /**
+    * The header of a block of memory that holds both a Reference and its
+    * HeapObject, which follows the header.
+    */
+   union EmbeddedHeader
+   {
+      Reference ref;
+      double align;
    };
 
    /**
@@ -175,7 +344,56 @@ public:
     */
    virtual HeapObject* relinquish();
 
+   /**
+    * Creates a new HeapObject that is allocated in the same block of memory
+    * as its reference count and returns a Collectable that points at it.
+    *
+    * The HeapObject must not be relinquished, as its memory cannot be freed
+    * separately from its reference count.
+    *
+    * @param a1 the first argument for the HeapObject's constructor.
+    * @param a2 the second argument for the HeapObject's constructor.
+    * @param a3 the third argument for the HeapObject's constructor.
+    *
+    * @return a Collectable that points at the new HeapObject.
+    */
+   static Collectable make();
+   template<typename A1>
+   static Collectable make(const A1& a1);
+   template<typename A1, typename A2>
+   static Collectable make(const A1& a1, const A2& a2);
+   template<typename A1, typename A2, typename A3>
+   static Collectable make(const A1& a1, const A2& a2, const A3& a3);
+
 protected:
+   /**
+    * Allocates a Reference with room for a HeapObject immediately after it.
+    * The new HeapObject must be constructed at the Reference's ptr using
+    * the global placement new operator.
+    *
+    * @return the new Reference.
+    */
+   static Reference* allocateEmbedded();
+
+   /**
+    * Creates a Reference for a HeapObject that extends CollectableObject.
+    *
+    * @param ptr the HeapObject.
+    * @param ref the HeapObject's own Reference.
+    *
+    * @return the Reference.
+    */
+   static Reference* createReference(HeapObject* ptr, Reference* ref);
+
+   /**
+    * Creates a Reference for any other HeapObject.
+    *
+    * @param ptr the HeapObject.
+    *
+    * @return the new Reference.
+    */
+   static Reference* createReference(HeapObject* ptr, ...);
+
    /**
     * Acquires the passed Reference.
     *
@@ -201,10 +419,7 @@ Collectable<HeapObject>::Collectable(HeapObject* ptr)
    else
    {
       // create a reference to the HeapObject
-      mReference = new Reference;
-      mReference->ptr = ptr;
-      mReference->count = 1;
-      mReference->relinquished = false;
+      mReference = createReference(ptr, ptr);
    }
 }
 
@@ -297,6 +512,87 @@ HeapObject* Collectable<HeapObject>::relinquish()
    return rval;
 }
 
+template<typename HeapObject>
+Collectable<HeapObject> Collectable<HeapObject>::make()
+{
+   Collectable rval;
+   rval.mReference = allocateEmbedded();
+   ::new (rval.mReference->ptr) HeapObject();
+   return rval;
+}
+
+template<typename HeapObject>
+template<typename A1>
+Collectable<HeapObject> Collectable<HeapObject>::make(const A1& a1)
+{
+   Collectable rval;
+   rval.mReference = allocateEmbedded();
+   ::new (rval.mReference->ptr) HeapObject(a1);
+   return rval;
+}
+
+template<typename HeapObject>
+template<typename A1, typename A2>
+Collectable<HeapObject> Collectable<HeapObject>::make(
+   const A1& a1, const A2& a2)
+{
+   Collectable rval;
+   rval.mReference = allocateEmbedded();
+   ::new (rval.mReference->ptr) HeapObject(a1, a2);
+   return rval;
+}
+
+template<typename HeapObject>
+template<typename A1, typename A2, typename A3>
+Collectable<HeapObject> Collectable<HeapObject>::make(
+   const A1& a1, const A2& a2, const A3& a3)
+{
+   Collectable rval;
+   rval.mReference = allocateEmbedded();
+   ::new (rval.mReference->ptr) HeapObject(a1, a2, a3);
+   return rval;
+}
+
+template<typename HeapObject>
+typename Collectable<HeapObject>::Reference*
+   Collectable<HeapObject>::allocateEmbedded()
+{
+   EmbeddedHeader* header = static_cast<EmbeddedHeader*>(
+      CollectableAllocator<HeapObject>::allocate(
+         sizeof(EmbeddedHeader) + sizeof(HeapObject)));
+   Reference* rval = &header->ref;
+   rval->ptr = reinterpret_cast<HeapObject*>(header + 1);
+   rval->count = 1;
+   rval->relinquished = false;
+   rval->storage = Reference::Embedded;
+   return rval;
+}
+
+template<typename HeapObject>
+typename Collectable<HeapObject>::Reference*
+   Collectable<HeapObject>::createReference(HeapObject* ptr, Reference* ref)
+{
+   // the HeapObject stores its own reference count, it may be wrapped again
+   // after it has been relinquished
+   if(Atomic::incrementAndFetch(&ref->count) == 1)
+   {
+      ref->relinquished = false;
+   }
+   return ref;
+}
+
+template<typename HeapObject>
+typename Collectable<HeapObject>::Reference*
+   Collectable<HeapObject>::createReference(HeapObject* ptr, ...)
+{
+   Reference* rval = new Reference;
+   rval->ptr = ptr;
+   rval->count = 1;
+   rval->relinquished = false;
+   rval->storage = Reference::Separate;
+   return rval;
+}
+
 template<typename HeapObject>
 void Collectable<HeapObject>::acquire(volatile Reference* ref)
 {
@@ -319,15 +615,34 @@ void Collectable<HeapObject>::release(volatile Reference* ref)
       if(Atomic::decrementAndFetch(&ref->count) == 0)
       {
          // this Collectable is responsible for deleting the HeapObject if
-         // it was the last one and memory ownership was not relinquished
-         if(!ref->relinquished)
+         // it was the last one and memory ownership was not relinquished,
+         // and for deleting the reference if it is not part of the
+         // HeapObject's memory
+         switch(ref->storage)
          {
-            delete ref->ptr;
+            case Reference::Separate:
+               if(!ref->relinquished)
+               {
+                  delete ref->ptr;
+               }
+               delete const_cast<Reference*>(ref);
+               break;
+            case Reference::Embedded:
+               if(!ref->relinquished)
+               {
+                  ref->ptr->~HeapObject();
+                  CollectableAllocator<HeapObject>::deallocate(
+                     const_cast<Reference*>(ref),
+                     sizeof(EmbeddedHeader) + sizeof(HeapObject));
+               }
+               break;
+            case Reference::Intrusive:
+               if(!ref->relinquished)
+               {
+                  delete ref->ptr;
+               }
+               break;
          }
-
-         // this Collectable is responsible for deleting the reference
-         // if it was the last one
-         delete ref;
       }
    }
 }
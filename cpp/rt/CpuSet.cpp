@@ -0,0 +1,277 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#include "monarch/rt/CpuSet.h"
+
+#include "monarch/rt/DynamicObject.h"
+#include "monarch/rt/Exception.h"
+#include "monarch/rt/System.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+using namespace std;
+using namespace monarch::rt;
+
+// the sysfs directory with NUMA node information
+#define NODE_DIR "/sys/devices/system/node"
+
+CpuSet::CpuSet()
+{
+   clear();
+}
+
+CpuSet::~CpuSet()
+{
+}
+
+void CpuSet::clear()
+{
+   memset(mBits, 0, sizeof(mBits));
+}
+
+void CpuSet::add(uint32_t cpu)
+{
+   if(cpu < MaxCpus)
+   {
+      mBits[cpu / 64] |= ((uint64_t)1 << (cpu % 64));
+   }
+}
+
+void CpuSet::remove(uint32_t cpu)
+{
+   if(cpu < MaxCpus)
+   {
+      mBits[cpu / 64] &= ~((uint64_t)1 << (cpu % 64));
+   }
+}
+
+bool CpuSet::contains(uint32_t cpu) const
+{
+   return (cpu < MaxCpus) &&
+      (mBits[cpu / 64] & ((uint64_t)1 << (cpu % 64))) != 0;
+}
+
+uint32_t CpuSet::count() const
+{
+   uint32_t rval = 0;
+   for(int i = 0; i < MaxCpus / 64; ++i)
+   {
+      rval += __builtin_popcountll(mBits[i]);
+   }
+   return rval;
+}
+
+bool CpuSet::isEmpty() const
+{
+   bool rval = true;
+   for(int i = 0; rval && i < MaxCpus / 64; ++i)
+   {
+      rval = (mBits[i] == 0);
+   }
+   return rval;
+}
+
+uint32_t CpuSet::getCpu(uint32_t index) const
+{
+   uint32_t rval = 0;
+
+   uint32_t n = count();
+   if(n > 0)
+   {
+      index %= n;
+      bool found = false;
+      for(uint32_t cpu = 0; !found && cpu < MaxCpus; ++cpu)
+      {
+         if(contains(cpu) && index-- == 0)
+         {
+            rval = cpu;
+            found = true;
+         }
+      }
+   }
+
+   return rval;
+}
+
+void CpuSet::intersect(const CpuSet& cpus)
+{
+   for(int i = 0; i < MaxCpus / 64; ++i)
+   {
+      mBits[i] &= cpus.mBits[i];
+   }
+}
+
+bool CpuSet::parse(const char* list)
+{
+   bool rval = true;
+
+   clear();
+   const char* p = list;
+   while(rval && *p != '\0' && *p != '\n')
+   {
+      // parse a cpu or a range of cpus
+      char* end;
+      unsigned long first = strtoul(p, &end, 10);
+      unsigned long last = first;
+      rval = (end != p);
+      if(rval && *end == '-')
+      {
+         p = end + 1;
+         last = strtoul(p, &end, 10);
+         rval = (end != p && last >= first);
+      }
+      rval = rval && last < MaxCpus &&
+         (*end == ',' || *end == '\0' || *end == '\n');
+      if(rval)
+      {
+         for(unsigned long cpu = first; cpu <= last; ++cpu)
+         {
+            add(cpu);
+         }
+         p = (*end == ',') ? end + 1 : end;
+      }
+   }
+
+   if(!rval)
+   {
+      ExceptionRef e = new Exception(
+         "Invalid cpu list.",
+         "monarch.rt.CpuSet.InvalidCpuList");
+      e->getDetails()["list"] = list;
+      Exception::set(e);
+      clear();
+   }
+
+   return rval;
+}
+
+string CpuSet::toString() const
+{
+   string rval;
+
+   char tmp[32];
+   uint32_t cpu = 0;
+   while(cpu < MaxCpus)
+   {
+      if(!contains(cpu))
+      {
+         ++cpu;
+      }
+      else
+      {
+         // find the end of the range
+         uint32_t last = cpu;
+         while(last + 1 < MaxCpus && contains(last + 1))
+         {
+            ++last;
+         }
+         if(last == cpu)
+         {
+            snprintf(tmp, 32, "%s%u", rval.empty() ? "" : ",", cpu);
+         }
+         else
+         {
+            snprintf(tmp, 32, "%s%u-%u", rval.empty() ? "" : ",", cpu, last);
+         }
+         rval.append(tmp);
+         cpu = last + 1;
+      }
+   }
+
+   return rval;
+}
+
+void CpuSet::getAvailableCpus(CpuSet& cpus)
+{
+   cpus.clear();
+
+#ifdef __linux__
+   cpu_set_t set;
+   CPU_ZERO(&set);
+   if(sched_getaffinity(0, sizeof(set), &set) == 0)
+   {
+      for(uint32_t cpu = 0; cpu < CPU_SETSIZE && cpu < MaxCpus; ++cpu)
+      {
+         if(CPU_ISSET(cpu, &set))
+         {
+            cpus.add(cpu);
+         }
+      }
+   }
+#endif
+
+   // fall back to the number of cores
+   if(cpus.isEmpty())
+   {
+      uint32_t cores = System::getCpuCoreCount();
+      for(uint32_t cpu = 0; cpu < cores; ++cpu)
+      {
+         cpus.add(cpu);
+      }
+   }
+}
+
+bool CpuSet::getNodeCpus(uint32_t node, CpuSet& cpus)
+{
+   bool rval = false;
+
+   cpus.clear();
+
+   // read the node's cpu list
+   char path[64];
+   snprintf(path, 64, NODE_DIR "/node%u/cpulist", node);
+   FILE* fp = fopen(path, "r");
+   if(fp != NULL)
+   {
+      char list[4096];
+      if(fgets(list, 4096, fp) != NULL)
+      {
+         rval = cpus.parse(list);
+      }
+      fclose(fp);
+   }
+   else if(node == 0)
+   {
+      // without NUMA information all cpus are on node 0
+      getAvailableCpus(cpus);
+      rval = true;
+   }
+
+   if(!rval)
+   {
+      ExceptionRef e = new Exception(
+         "Could not get the cpus of NUMA node.",
+         "monarch.rt.CpuSet.InvalidNode");
+      e->getDetails()["node"] = node;
+      Exception::push(e);
+   }
+
+   return rval;
+}
+
+uint32_t CpuSet::getNodeCount()
+{
+   uint32_t rval = 1;
+
+   // the online nodes are a list in the same format as cpus
+   FILE* fp = fopen(NODE_DIR "/online", "r");
+   if(fp != NULL)
+   {
+      char list[4096];
+      CpuSet nodes;
+      if(fgets(list, 4096, fp) != NULL && nodes.parse(list) &&
+         !nodes.isEmpty())
+      {
+         rval = nodes.count();
+      }
+      fclose(fp);
+   }
+
+   return rval;
+}
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#ifndef monarch_rt_CpuSet_H
+#define monarch_rt_CpuSet_H
+
+#include <inttypes.h>
+#include <string>
+
+namespace monarch
+{
+namespace rt
+{
+
+/**
+ * A CpuSet is a set of cpu numbers, used to restrict the cpus a Thread may
+ * run on. It can be parsed from and written as a cpu list such as
+ * "0-3,8,10-11", the format Linux uses for cpusets and NUMA nodes.
+ */
+class CpuSet
+{
+public:
+   /**
+    * The highest number of cpus a set can hold.
+    */
+   enum
+   {
+      MaxCpus = 1024
+   };
+
+protected:
+   /**
+    * One bit per cpu.
+    */
+   uint64_t mBits[MaxCpus / 64];
+
+public:
+   /**
+    * Creates a new, empty CpuSet.
+    */
+   CpuSet();
+
+   /**
+    * Destructs this CpuSet.
+    */
+   virtual ~CpuSet();
+
+   /**
+    * Removes all cpus from this set.
+    */
+   virtual void clear();
+
+   /**
+    * Adds a cpu to this set. Cpus at or above MaxCpus are ignored.
+    *
+    * @param cpu the cpu to add.
+    */
+   virtual void add(uint32_t cpu);
+
+   /**
+    * Removes a cpu from this set.
+    *
+    * @param cpu the cpu to remove.
+    */
+   virtual void remove(uint32_t cpu);
+
+   /**
+    * Returns true if this set contains a cpu.
+    *
+    * @param cpu the cpu to check for.
+    *
+    * @return true if the cpu is in this set, false if not.
+    */
+   virtual bool contains(uint32_t cpu) const;
+
+   /**
+    * Gets the number of cpus in this set.
+    *
+    * @return the number of cpus.
+    */
+   virtual uint32_t count() const;
+
+   /**
+    * Returns true if this set has no cpus.
+    *
+    * @return true if this set is empty, false if not.
+    */
+   virtual bool isEmpty() const;
+
+   /**
+    * Gets the cpu at the given position in this set, wrapping around, so
+    * that threads can be spread over the cpus one per cpu.
+    *
+    * @param index the position of the cpu.
+    *
+    * @return the cpu, 0 if this set is empty.
+    */
+   virtual uint32_t getCpu(uint32_t index) const;
+
+   /**
+    * Removes all cpus that are not in another set from this one.
+    *
+    * @param cpus the other set.
+    */
+   virtual void intersect(const CpuSet& cpus);
+
+   /**
+    * Sets the cpus in this set from a cpu list such as "0-3,8".
+    *
+    * @param list the cpu list.
+    *
+    * @return true if successful, false with an exception set if the list
+    *         is invalid.
+    */
+   virtual bool parse(const char* list);
+
+   /**
+    * Writes this set as a cpu list such as "0-3,8".
+    *
+    * @return the cpu list.
+    */
+   virtual std::string toString() const;
+
+   /**
+    * Gets the cpus this process may run on.
+    *
+    * @param cpus the set to populate.
+    */
+   static void getAvailableCpus(CpuSet& cpus);
+
+   /**
+    * Gets the cpus of a NUMA node.
+    *
+    * @param node the NUMA node.
+    * @param cpus the set to populate.
+    *
+    * @return true if successful, false with an exception set if the node
+    *         does not exist or NUMA information is not available.
+    */
+   static bool getNodeCpus(uint32_t node, CpuSet& cpus);
+
+   /**
+    * Gets the number of NUMA nodes, 1 if NUMA information is not available.
+    *
+    * @return the number of NUMA nodes.
+    */
+   static uint32_t getNodeCount();
+};
+
+} // end namespace rt
+} // end namespace monarch
+#endif
@@ -12,8 +12,11 @@
 using namespace monarch::rt;
 
 DynamicObject::DynamicObject() :
-   Collectable<DynamicObjectImpl>(new DynamicObjectImpl())
+   Collectable<DynamicObjectImpl>(NULL)
 {
+   // allocate the object and its reference count together
+   mReference = allocateEmbedded();
+   ::new (mReference->ptr) DynamicObjectImpl();
 }
 
 DynamicObject::DynamicObject(DynamicObjectImpl* impl) :
@@ -294,6 +297,9 @@ DynamicObjectIterator DynamicObject::getIterator() const
 {
    DynamicObjectIteratorImpl* i;
 
+   // iterators give access to members and elements that may be modified
+   (*this)->materialize();
+
    switch((*this)->getType())
    {
       case Map:
@@ -310,6 +316,60 @@ DynamicObjectIterator DynamicObject::getIterator() const
    return i;
 }
 
+DynamicObject::iterator DynamicObject::begin() const
+{
+   iterator rval;
+
+   if(!isNull())
+   {
+      // iterators give access to members and elements that may be modified
+      DynamicObjectImpl& impl = **this;
+      impl.materialize();
+      switch(impl.getType())
+      {
+         case Map:
+            rval = iterator(impl.mMap->begin(), 0);
+            break;
+         case Array:
+            rval = iterator(impl.getArray()->begin(), 0);
+            break;
+         default:
+            rval = iterator(const_cast<DynamicObject*>(this), 0);
+            break;
+      }
+   }
+
+   return rval;
+}
+
+DynamicObject::iterator DynamicObject::end() const
+{
+   iterator rval;
+
+   if(!isNull())
+   {
+      DynamicObjectImpl& impl = **this;
+      impl.materialize();
+      switch(impl.getType())
+      {
+         case Map:
+            rval = iterator(impl.mMap->end(), impl.mMap->size());
+            break;
+         case Array:
+         {
+            DynamicObjectImpl::ObjectArray* array = impl.getArray();
+            rval = iterator(array->end(), array->size());
+            break;
+         }
+         default:
+            rval = iterator(NULL, 1);
+            break;
+      }
+   }
+
+   return rval;
+}
+
 DynamicObject& DynamicObject::push(DynamicObject value)
 {
    // for non-arrays, preserve original value if set
@@ -459,6 +519,7 @@ void DynamicObject::sort(DynamicObject::CompareLessDyno func)
 {
    if((*this)->getType() == Array)
    {
+      (*this)->unpack();
       if(func == NULL)
       {
          // use default operator<()
@@ -476,6 +537,7 @@ void DynamicObject::sort(std::less<DynamicObject>& obj)
 {
    if((*this)->getType() == Array)
    {
+      (*this)->unpack();
       std::sort((*this)->mArray->begin(), (*this)->mArray->end(), obj);
    }
 }
@@ -484,7 +546,28 @@ DynamicObject DynamicObject::clone()
 {
    DynamicObject rval(NULL);
 
-   if(!isNull())
+   if(!isNull() && ((*this)->mFrozen || (*this)->mShared) &&
+      ((*this)->mType == Map || (*this)->mType == Array))
+   {
+      // share the frozen source until the clone is modified
+      rval = DynamicObject();
+      if((*this)->mShared)
+      {
+         rval->share(*(*this)->mSource);
+      }
+      else
+      {
+         rval->share(*this);
+      }
+   }
+   else if(!isNull() && (*this)->getType() == Array &&
+      (*this)->isPackedOnly())
+   {
+      // copy packed elements directly
+      rval = DynamicObject();
+      *rval = *(*this);
+   }
+   else if(!isNull())
    {
       rval = DynamicObject();
       DynamicObjectType type = (*this)->getType();
@@ -530,6 +613,42 @@ DynamicObject DynamicObject::clone()
    return rval;
 }
 
+void DynamicObject::freeze()
+{
+   if(!isNull())
+   {
+      DynamicObjectImpl* impl = &(*(*this));
+      if(impl->mShared)
+      {
+         // an unmodified clone is equal to its frozen source
+         DynamicObject source = *impl->mSource;
+         *this = source;
+      }
+      else if(!impl->mFrozen)
+      {
+         // freeze this object before its contents in case of cycles
+         impl->mFrozen = true;
+         if(impl->mType == Map)
+         {
+            DynamicObjectImpl::ObjectMap::iterator i = impl->mMap->begin();
+            for(; i != impl->mMap->end(); ++i)
+            {
+               i.getValue().freeze();
+            }
+         }
+         else if(impl->mType == Array && !impl->isPackedOnly())
+         {
+            DynamicObjectImpl::ObjectArray* array = impl->getArray();
+            DynamicObjectImpl::ObjectArray::iterator i = array->begin();
+            for(; i != array->end(); ++i)
+            {
+               i->freeze();
+            }
+         }
+      }
+   }
+}
+
 /**
  * The _getMapDiff helper function gets the differences between the source
  * object and the target object and places the result in the result object.
@@ -563,22 +682,27 @@ static bool _getMapDiff(
 {
    bool rval = false;
 
-   // keep track of keys we've checked
-   DynamicObject checked;
-   checked->setType(Map);
+   // members are sorted by name, so both maps are walked together
+   DynamicObject::iterator send = source.end();
+   DynamicObject::iterator tend = target.end();
 
    // Check all the source keys
-   DynamicObjectIterator i = source.getIterator();
-   while(i->hasNext())
+   DynamicObject::iterator si = source.begin();
+   DynamicObject::iterator ti = target.begin();
+   while(si != send)
    {
-      DynamicObject& next = i->next();
-      const char* name = i->getName();
-      checked[name] = true;
-      if(target->hasMember(name))
+      const char* name = si.getName();
+      int cmp = (ti == tend) ? -1 : strcmp(name, ti.getName());
+      if(cmp > 0)
+      {
+         // key added to target, checked below
+         ++ti;
+      }
+      else if(cmp == 0)
       {
          // recusively get sub-diff
          DynamicObject d;
-         if(next.diff(target[name], d, flags))
+         if(si->diff(*ti, d, flags))
          {
             // diff found, add it
             if(!rval)
@@ -587,11 +711,12 @@ static bool _getMapDiff(
                result->setType(Array);
                rval = true;
             }
-            rval = true;
             DynamicObject& change = result->append();
             change["key"] = name;
             change["changed"] = d;
          }
+         ++si;
+         ++ti;
       }
       else
       {
@@ -604,17 +729,28 @@ static bool _getMapDiff(
          }
          DynamicObject& change = result->append();
          change["key"] = name;
-         change["removed"] = next.clone();
+         change["removed"] = si->clone();
+         ++si;
       }
    }
 
    // Check for added target keys
-   DynamicObjectIterator ti = target.getIterator();
-   while(ti->hasNext())
+   si = source.begin();
+   ti = target.begin();
+   while(ti != tend)
    {
-      DynamicObject& next = ti->next();
-      const char* name = ti->getName();
-      if(!checked->hasMember(name))
+      const char* name = ti.getName();
+      int cmp = (si == send) ? 1 : strcmp(si.getName(), name);
+      if(cmp < 0)
+      {
+         ++si;
+      }
+      else if(cmp == 0)
+      {
+         ++si;
+         ++ti;
+      }
+      else
       {
          if(!rval)
          {
@@ -624,7 +760,8 @@ static bool _getMapDiff(
          }
          DynamicObject& change = result->append();
          change["key"] = name;
-         change["added"] = next.clone();
+         change["added"] = ti->clone();
+         ++ti;
       }
    }
 
@@ -741,6 +878,12 @@ bool DynamicObject::diff(
    {
       // same: no diff
    }
+   else if(!snull && !tnull &&
+      source->isHashCached() && target->isHashCached() &&
+      source.isIdentical(target))
+   {
+      // same, found without building sub-diffs: no diff
+   }
    else if((!snull && tnull) || (snull && !tnull))
    {
       // source or target is null but other is not
@@ -855,6 +998,76 @@ bool DynamicObject::diff(
    return rval;
 }
 
+bool DynamicObject::isIdentical(const DynamicObject& rhs) const
+{
+   bool rval;
+
+   const DynamicObject& lhs = *this;
+   if(lhs.isNull() || rhs.isNull())
+   {
+      rval = lhs.isNull() && rhs.isNull();
+   }
+   else
+   {
+      const DynamicObjectImpl* l = lhs->getData();
+      const DynamicObjectImpl* r = rhs->getData();
+      if(l == r)
+      {
+         rval = true;
+      }
+      else if(l->mType != r->mType ||
+         ((l->mType == Map || l->mType == Array) &&
+          l->isHashCached() && r->isHashCached() &&
+          l->getHash() != r->getHash()))
+      {
+         rval = false;
+      }
+      else if(l->mType == Map)
+      {
+         // members are sorted, so identical maps iterate in the same order
+         rval = (l->mMap->size() == r->mMap->size());
+         DynamicObjectImpl::ObjectMap::iterator li = l->mMap->begin();
+         DynamicObjectImpl::ObjectMap::iterator ri = r->mMap->begin();
+         for(; rval && li != l->mMap->end(); ++li, ++ri)
+         {
+            rval =
+               (li.getName() == ri.getName() ||
+                strcmp(li.getName(), ri.getName()) == 0) &&
+               li.getValue().isIdentical(ri.getValue());
+         }
+      }
+      else if(l->mType == Array && !(l->isPackedOnly() && r->isPackedOnly()))
+      {
+         DynamicObjectImpl::ObjectArray* la = l->getArray();
+         DynamicObjectImpl::ObjectArray* ra = r->getArray();
+         rval = (la->size() == ra->size());
+         DynamicObjectImpl::ObjectArray::iterator li = la->begin();
+         DynamicObjectImpl::ObjectArray::iterator ri = ra->begin();
+         for(; rval && li != la->end(); ++li, ++ri)
+         {
+            rval = li->isIdentical(*ri);
+         }
+      }
+      else if(l->mType == Array &&
+         l->mPackedArray->type != r->mPackedArray->type)
+      {
+         rval = false;
+      }
+      else
+      {
+         // values and packed arrays of the same type compare exactly
+         rval = (*l == *r);
+      }
+   }
+
+   return rval;
+}
+
+uint64_t DynamicObject::getHash() const
+{
+   return isNull() ? 0 : (*this)->getHash();
+}
+
 void DynamicObject::merge(DynamicObject& rhs, bool append)
 {
    if(!rhs.isNull())
@@ -451,6 +451,35 @@ public:
     */
    virtual DynamicObjectIterator getIterator() const;
 
+   /**
+    * An iterator is a lightweight iterator over the members of a Map, the
+    * elements of an Array, or, for any other type, the object itself. It is
+    * a value type that lives on the stack and its operations are inlined,
+    * unlike a DynamicObjectIterator which is allocated on the heap and uses
+    * virtual calls. It also allows a DynamicObject to be used in a range-based
+    * for loop.
+    *
+    * Adding members or elements to an object while iterating over it
+    * invalidates its iterators, use getIterator() to remove members or
+    * elements while iterating.
+    */
+   class iterator;
+
+   /**
+    * Gets an iterator at the first member or element of this object. A NULL
+    * object has no members.
+    *
+    * @return an iterator at the first member or element.
+    */
+   iterator begin() const;
+
+   /**
+    * Gets an iterator past the last member or element of this object.
+    *
+    * @return an iterator past the last member or element.
+    */
+   iterator end() const;
+
    /**
     * Appends the passed DynamicObject to this one.
     *
@@ -585,10 +614,27 @@ public:
    /**
     * Clones this DynamicObject and returns it.
     *
+    * Cloning a frozen Map or Array takes constant time. The clone shares the
+    * frozen object's members or elements until it is modified, at which
+    * point it gets its own copies of them, each of which is in turn copied
+    * only when it is modified.
+    *
     * @return a clone of this DynamicObject.
     */
    virtual DynamicObject clone();
 
+   /**
+    * Freezes this DynamicObject and everything it contains. A frozen object
+    * must never be modified again, but it may be safely read by many threads
+    * at once without locking, with the exception that members that do not
+    * exist must not be accessed via operator[]. Use clone() to get a copy of
+    * a frozen object that can be modified.
+    *
+    * If this DynamicObject is an unmodified clone of a frozen object, it is
+    * set to the frozen object.
+    */
+   virtual void freeze();
+
    /**
     * Merges the passed DynamicObject into this one.
     *
@@ -655,6 +701,31 @@ public:
       DynamicObject& target, DynamicObject& result,
       uint32_t flags = DiffDefault);
 
+   /**
+    * Returns true if this object and the given one are identical, that is,
+    * they have the same members or elements with the same types and values.
+    * Identical objects are always equal, but equal objects are not always
+    * identical because operator== compares values of different types as
+    * strings. If both objects have cached hashes, a different hash is
+    * detected without walking either object.
+    *
+    * @param rhs the object to compare against.
+    *
+    * @return true if the objects are identical, false if not.
+    */
+   virtual bool isIdentical(const DynamicObject& rhs) const;
+
+   /**
+    * Gets a 64-bit structural hash of this object, which may be used, for
+    * instance, as a key for caching results computed from this object.
+    * Objects that are equal according to operator== have the same hash. The
+    * hash of a frozen object is cached, otherwise every member and element is
+    * visited to compute it.
+    *
+    * @return the hash of this object, 0 if it is NULL.
+    */
+   virtual uint64_t getHash() const;
+
    /**
     * Determines if this DynamicObject is a subset of another. If this
     * DynamicObject does not reference the exact same DynamicObject as the
@@ -691,6 +762,197 @@ public:
    static DynamicObjectType determineType(const char* str);
 };
 
+class DynamicObject::iterator
+{
+protected:
+   /**
+    * The kinds of objects an iterator iterates over.
+    */
+   enum Kind
+   {
+      IterateOne,
+      IterateArray,
+      IterateMap
+   };
+   Kind mKind;
+
+   /**
+    * The position in an Array.
+    */
+   DynamicObjectImpl::ObjectArray::iterator mArrayIterator;
+
+   /**
+    * The position in a Map.
+    */
+   DynamicObjectImpl::ObjectMap::iterator mMapIterator;
+
+   /**
+    * The object when iterating over an object that is not a Map or Array,
+    * NULL once it has been passed.
+    */
+   DynamicObject* mObject;
+
+   /**
+    * The index of the current member or element.
+    */
+   int mIndex;
+
+public:
+   /**
+    * Creates a new iterator over no objects.
+    */
+   iterator() :
+      mKind(IterateOne),
+      mObject(NULL),
+      mIndex(0)
+   {
+   };
+
+   /**
+    * Creates a new iterator over a single object.
+    *
+    * @param dyno the object, NULL once it has been passed.
+    * @param index the index of the position.
+    */
+   iterator(DynamicObject* dyno, int index) :
+      mKind(IterateOne),
+      mObject(dyno),
+      mIndex(index)
+   {
+   };
+
+   /**
+    * Creates a new iterator over the elements of an Array.
+    *
+    * @param i the position in the Array.
+    * @param index the index of the position.
+    */
+   iterator(DynamicObjectImpl::ObjectArray::iterator i, int index) :
+      mKind(IterateArray),
+      mArrayIterator(i),
+      mObject(NULL),
+      mIndex(index)
+   {
+   };
+
+   /**
+    * Creates a new iterator over the members of a Map.
+    *
+    * @param i the position in the Map.
+    * @param index the index of the position.
+    */
+   iterator(DynamicObjectImpl::ObjectMap::iterator i, int index) :
+      mKind(IterateMap),
+      mMapIterator(i),
+      mObject(NULL),
+      mIndex(index)
+   {
+   };
+
+   /**
+    * Gets the current member or element.
+    *
+    * @return the current member or element.
+    */
+   DynamicObject& operator*() const
+   {
+      return (mKind == IterateArray) ? *mArrayIterator :
+         ((mKind == IterateMap) ? mMapIterator.getValue() : *mObject);
+   };
+
+   /**
+    * Gets the current member or element.
+    *
+    * @return a pointer to the current member or element.
+    */
+   DynamicObject* operator->() const
+   {
+      return &operator*();
+   };
+
+   /**
+    * Advances to the next member or element.
+    *
+    * @return this iterator.
+    */
+   iterator& operator++()
+   {
+      if(mKind == IterateArray)
+      {
+         ++mArrayIterator;
+      }
+      else if(mKind == IterateMap)
+      {
+         ++mMapIterator;
+      }
+      else
+      {
+         mObject = NULL;
+      }
+      ++mIndex;
+      return *this;
+   };
+
+   /**
+    * Advances to the next member or element.
+    *
+    * @return a copy of this iterator before it was advanced.
+    */
+   iterator operator++(int)
+   {
+      iterator rval = *this;
+      ++(*this);
+      return rval;
+   };
+
+   /**
+    * Compares this iterator to another one over the same object.
+    *
+    * @param rhs the iterator to compare against.
+    *
+    * @return true if both iterators are at the same position.
+    */
+   bool operator==(const iterator& rhs) const
+   {
+      return (mKind == IterateArray) ? mArrayIterator == rhs.mArrayIterator :
+         ((mKind == IterateMap) ? mMapIterator == rhs.mMapIterator :
+          mObject == rhs.mObject);
+   };
+
+   /**
+    * Compares this iterator to another one over the same object.
+    *
+    * @param rhs the iterator to compare against.
+    *
+    * @return true if the iterators are at different positions.
+    */
+   bool operator!=(const iterator& rhs) const
+   {
+      return !(*this == rhs);
+   };
+
+   /**
+    * Gets the name of the current member of a Map.
+    *
+    * @return the name of the current member, NULL if this iterator is not
+    *         over a Map.
+    */
+   const char* getName() const
+   {
+      return (mKind == IterateMap) ? mMapIterator.getName() : NULL;
+   };
+
+   /**
+    * Gets the index of the current member or element.
+    *
+    * @return the index of the current member or element.
+    */
+   int getIndex() const
+   {
+      return mIndex;
+   };
+};
+
 } // end namespace rt
 } // end namespace monarch
 
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#include "monarch/rt/DynamicObjectArena.h"
+
+#include <pthread.h>
+
+using namespace monarch::rt;
+
+// all arena allocations are aligned to this many bytes
+#define ARENA_ALIGNMENT   8
+#define ARENA_ALIGN(size) \
+   (((size) + (ARENA_ALIGNMENT - 1)) & ~((size_t)ARENA_ALIGNMENT - 1))
+
+/**
+ * A chunk of arena memory. Allocations are made from the memory that
+ * immediately follows the chunk header.
+ */
+struct ArenaChunk
+{
+   ArenaChunk* next;
+   double align;
+};
+
+struct DynamicObjectArena::Data
+{
+   /**
+    * The number of live allocations plus one for the arena's scope.
+    */
+   volatile aligned_int32_t refs;
+
+   /**
+    * The usable size of each chunk.
+    */
+   size_t chunkSize;
+
+   /**
+    * The list of chunks owned by the arena, most recent first.
+    */
+   ArenaChunk* chunks;
+
+   /**
+    * The next free byte in the current chunk and the end of the chunk.
+    */
+   char* next;
+   char* end;
+};
+
+// the thread-specific data key for the current arena
+static pthread_key_t sCurrentArenaKey;
+static pthread_once_t sCurrentArenaKeyOnce = PTHREAD_ONCE_INIT;
+
+DynamicObjectArena::DynamicObjectArena(size_t chunkSize)
+{
+   pthread_once(&sCurrentArenaKeyOnce, &DynamicObjectArena::initializeKey);
+
+   mData = static_cast<Data*>(malloc(sizeof(Data)));
+   mData->refs = 1;
+   mData->chunkSize = ARENA_ALIGN(chunkSize);
+   mData->chunks = NULL;
+   mData->next = NULL;
+   mData->end = NULL;
+
+   // make this the current arena
+   mPrevious = static_cast<DynamicObjectArena*>(
+      pthread_getspecific(sCurrentArenaKey));
+   pthread_setspecific(sCurrentArenaKey, this);
+}
+
+DynamicObjectArena::~DynamicObjectArena()
+{
+   // restore previous arena, release scope's reference to the data
+   pthread_setspecific(sCurrentArenaKey, mPrevious);
+   deallocate(mData);
+}
+
+void* DynamicObjectArena::allocate(Data* data, size_t size)
+{
+   void* rval = NULL;
+
+   size = ARENA_ALIGN(size);
+   if(size <= data->chunkSize)
+   {
+      if(data->next == NULL || (size_t)(data->end - data->next) < size)
+      {
+         // current chunk is full, start a new one
+         ArenaChunk* chunk = static_cast<ArenaChunk*>(
+            malloc(sizeof(ArenaChunk) + data->chunkSize));
+         if(chunk != NULL)
+         {
+            chunk->next = data->chunks;
+            data->chunks = chunk;
+            data->next = reinterpret_cast<char*>(chunk + 1);
+            data->end = data->next + data->chunkSize;
+         }
+      }
+
+      if(data->next != NULL && (size_t)(data->end - data->next) >= size)
+      {
+         rval = data->next;
+         data->next += size;
+         Atomic::incrementAndFetch(&data->refs);
+      }
+   }
+
+   return rval;
+}
+
+void DynamicObjectArena::deallocate(Data* data)
+{
+   if(Atomic::decrementAndFetch(&data->refs) == 0)
+   {
+      // arena is out of scope and all of its objects have been freed
+      freeData(data);
+   }
+}
+
+DynamicObjectArena::Data* DynamicObjectArena::getCurrentData()
+{
+   Data* rval = NULL;
+
+   pthread_once(&sCurrentArenaKeyOnce, &DynamicObjectArena::initializeKey);
+   DynamicObjectArena* arena = static_cast<DynamicObjectArena*>(
+      pthread_getspecific(sCurrentArenaKey));
+   if(arena != NULL)
+   {
+      rval = arena->mData;
+   }
+
+   return rval;
+}
+
+void DynamicObjectArena::freeData(Data* data)
+{
+   ArenaChunk* chunk = data->chunks;
+   while(chunk != NULL)
+   {
+      ArenaChunk* next = chunk->next;
+      free(chunk);
+      chunk = next;
+   }
+   free(data);
+}
+
+void DynamicObjectArena::initializeKey()
+{
+   pthread_key_create(&sCurrentArenaKey, NULL);
+}
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#ifndef monarch_rt_DynamicObjectArena_H
+#define monarch_rt_DynamicObjectArena_H
+
+#include "monarch/rt/Atomic.h"
+
+#include <cstdlib>
+
+namespace monarch
+{
+namespace rt
+{
+
+/**
+ * A DynamicObjectArena is a scoped allocator for DynamicObjects. While a
+ * DynamicObjectArena is in scope, every DynamicObject created by the thread
+ * that created the arena is bump-allocated out of large chunks of memory
+ * owned by the arena instead of being allocated individually. This makes
+ * building large, short-lived trees (ie: when parsing a JSON document or
+ * answering a single request) much cheaper.
+ *
+ * Only the DynamicObjectImpl nodes and their reference counts are allocated
+ * from the arena. Member names, strings, and the map and array storage of
+ * each node are still allocated on the heap.
+ *
+ * Memory for an individual object is never reused by the arena. Instead, the
+ * arena's chunks are all freed at once when the arena has gone out of scope
+ * and every object that was allocated from it has been collected. This means
+ * that objects created in an arena may safely outlive the arena's scope and
+ * may be released by any thread, but that it is a poor choice for code that
+ * repeatedly creates and discards objects over a long period of time.
+ *
+ * Arenas may be nested, in which case the innermost arena is used. A
+ * DynamicObjectArena must be destroyed by the thread that created it.
+ *
+ * Example:
+ *
+ * {
+ *    DynamicObjectArena arena;
+ *    DynamicObject dyno;
+ *    // ... build and use dyno ...
+ * }
+ */
+class DynamicObjectArena
+{
+public:
+   /**
+    * The shared data for an arena. It is kept alive until the arena has
+    * gone out of scope and all of the objects allocated from it have been
+    * freed.
+    */
+   struct Data;
+
+protected:
+   /**
+    * The shared data for this arena.
+    */
+   Data* mData;
+
+   /**
+    * The arena that was current before this one.
+    */
+   DynamicObjectArena* mPrevious;
+
+public:
+   /**
+    * Creates a new DynamicObjectArena and makes it the current arena for
+    * the calling thread.
+    *
+    * @param chunkSize the size of each chunk of memory to allocate objects
+    *           from.
+    */
+   DynamicObjectArena(size_t chunkSize = 65536);
+
+   /**
+    * Destructs this DynamicObjectArena, restoring the previous arena for
+    * the calling thread. The arena's memory is freed once every object that
+    * was allocated from it has been freed.
+    */
+   virtual ~DynamicObjectArena();
+
+   /**
+    * Allocates memory from an arena. The arena must be the calling thread's
+    * current arena.
+    *
+    * @param data the shared data of the calling thread's current arena.
+    * @param size the number of bytes to allocate.
+    *
+    * @return the allocated memory or NULL if it could not be allocated from
+    *         the arena.
+    */
+   static void* allocate(Data* data, size_t size);
+
+   /**
+    * Frees memory that was allocated from an arena. If the arena has gone out
+    * of scope and this was its last live allocation, then all of its memory
+    * is freed.
+    *
+    * @param data the shared data of the arena the memory was allocated from.
+    */
+   static void deallocate(Data* data);
+
+   /**
+    * Gets the shared data for the calling thread's current arena.
+    *
+    * @return the shared data for the current arena or NULL if there is no
+    *         current arena.
+    */
+   static Data* getCurrentData();
+
+protected:
+   /**
+    * Frees all of the memory in the given arena data.
+    *
+    * @param data the arena data to free.
+    */
+   static void freeData(Data* data);
+
+   /**
+    * Initializes the thread-specific data key for the current arena.
+    */
+   static void initializeKey();
+};
+
+} // end namespace rt
+} // end namespace monarch
+#endif
@@ -11,6 +11,9 @@
 #include "monarch/rt/DynamicObjectImpl.h"
 
 #include "monarch/rt/DynamicObject.h"
+#include "monarch/rt/DynamicObjectArena.h"
+#include "monarch/rt/MemoryPool.h"
+#include "monarch/rt/StringTable.h"
 #include "monarch/util/Macros.h"
 #ifdef MO_DYNO_KEY_COUNTS
 #include "monarch/rt/ExclusiveLock.h"
@@ -20,6 +23,7 @@
 #include <cstdio>
 #include <string>
 #include <algorithm>
+#include <new>
 
 using namespace std;
 using namespace monarch::rt;
@@ -103,6 +107,8 @@ enum {
    Object = LastDynamicObjectType + 1,
    Key,
    StringValue,
+   KeyInternHit,
+   KeyInternMiss,
    LastStatsType
 };
 
@@ -220,87 +226,452 @@ static monarch::rt::ExclusiveLock _stats_key_counts_lock;
 
 #endif // MO_DYNO_KEY_COUNTS
 
-DynamicObjectImpl::DynamicObjectImpl() :
-   mType(String),
-   mString(NULL),
-   mStringValue(NULL)
+/**
+ * Every block of memory handed out for a DynamicObjectImpl or one of its
+ * references is prefixed with a header that identifies the arena it was
+ * allocated from, if any. Blocks that were not allocated from an arena are
+ * kept in per-thread pools, one for each size class.
+ */
+union _node_header_u
 {
-   STATS_COUNTS_INC(Object);
-   STATS_COUNTS_INC(String);
+   DynamicObjectArena::Data* arena;
+   double align;
+};
+
+#define NODE_POOL_GRANULARITY 16
+#define NODE_POOL_CLASSES     8
+
+static MemoryPool* _node_pools[NODE_POOL_CLASSES];
+static pthread_once_t _node_pools_once = PTHREAD_ONCE_INIT;
+static bool _node_pooling_enabled = true;
+
+static void _initNodePools()
+{
+   // pools are never freed, objects may be collected during static
+   // destruction
+   for(int i = 0; i < NODE_POOL_CLASSES; ++i)
+   {
+      _node_pools[i] = new MemoryPool(
+         sizeof(union _node_header_u) + (i + 1) * NODE_POOL_GRANULARITY);
+   }
 }
 
-DynamicObjectImpl::~DynamicObjectImpl()
+static inline MemoryPool* _getNodePool(size_t size)
 {
-   DynamicObjectImpl::freeData();
-   STATS_COUNTS_DEC(mType);
-   STATS_COUNTS_DEC(Object);
+   MemoryPool* rval = NULL;
+
+   size_t c = (size + NODE_POOL_GRANULARITY - 1) / NODE_POOL_GRANULARITY;
+   if(c <= NODE_POOL_CLASSES)
+   {
+      pthread_once(&_node_pools_once, &_initNodePools);
+      rval = _node_pools[(c == 0) ? 0 : c - 1];
+   }
+
+   return rval;
 }
 
-void DynamicObjectImpl::operator=(const DynamicObjectImpl& value)
+/**
+ * Map member names are interned in a process-wide table so that the same
+ * name is only allocated once no matter how many maps use it. The table is
+ * never freed, objects may be collected during static destruction.
+ */
+static StringTable* _key_table;
+static pthread_once_t _key_table_once = PTHREAD_ONCE_INIT;
+
+static void _initKeyTable()
+{
+   _key_table = new StringTable();
+}
+
+/**
+ * Creates a map key for the given member name.
+ *
+ * @param name the member name.
+ *
+ * @return the key, to be released with StringTable::release().
+ */
+static inline const char* _createKey(const char* name)
 {
-   switch(value.mType)
+   pthread_once(&_key_table_once, &_initKeyTable);
+   bool hit;
+   const char* rval = _key_table->intern(name, &hit);
+   if(hit)
    {
-      case String:
-         *this = value.mString;
+      STATS_COUNTS_INC(KeyInternHit);
+   }
+   else
+   {
+      STATS_COUNTS_INC(KeyInternMiss);
+   }
+   return rval;
+}
+
+/**
+ * Copies a map key from another map.
+ *
+ * @param key the key to copy.
+ *
+ * @return the copied key, to be released with StringTable::release().
+ */
+static inline const char* _copyKey(const char* key)
+{
+   return StringTable::isInterned(key) ? key : _createKey(key);
+}
+
+/**
+ * Gets the size of an element in a packed array.
+ *
+ * @param type the type of the elements.
+ *
+ * @return the size of an element, 0 if the type cannot be packed.
+ */
+static inline size_t _getPackedSize(DynamicObjectType type)
+{
+   size_t rval;
+
+   switch(type)
+   {
+      case Int32:
+      case UInt32:
+         rval = sizeof(uint32_t);
          break;
-      case Boolean:
-         *this = value.mBoolean;
+      case Int64:
+      case UInt64:
+         rval = sizeof(uint64_t);
+         break;
+      case Double:
+         rval = sizeof(double);
+         break;
+      default:
+         rval = 0;
          break;
+   }
+
+   return rval;
+}
+
+/**
+ * Sets a DynamicObject to the value of an element in a packed array.
+ *
+ * @param dyno the DynamicObject to set.
+ * @param type the type of the elements.
+ * @param data the elements.
+ * @param index the index of the element.
+ */
+static inline void _getPackedElement(
+   DynamicObject& dyno, DynamicObjectType type, void* data, int index)
+{
+   switch(type)
+   {
       case Int32:
-         *this = value.mInt32;
+         dyno = static_cast<int32_t*>(data)[index];
          break;
       case UInt32:
-         *this = value.mUInt32;
+         dyno = static_cast<uint32_t*>(data)[index];
          break;
       case Int64:
-         *this = value.mInt64;
+         dyno = static_cast<int64_t*>(data)[index];
          break;
       case UInt64:
-         *this = value.mUInt64;
+         dyno = static_cast<uint64_t*>(data)[index];
          break;
       case Double:
-         *this = value.mDouble;
+         dyno = static_cast<double*>(data)[index];
          break;
-      case Map:
+      default:
+         break;
+   }
+}
+
+/**
+ * Sets an element in a packed array to the value of a DynamicObject.
+ *
+ * @param dyno the DynamicObject with the value.
+ * @param type the type of the elements.
+ * @param data the elements.
+ * @param index the index of the element.
+ */
+static inline void _setPackedElement(
+   DynamicObject& dyno, DynamicObjectType type, void* data, int index)
+{
+   switch(type)
+   {
+      case Int32:
+         static_cast<int32_t*>(data)[index] = dyno->getInt32();
+         break;
+      case UInt32:
+         static_cast<uint32_t*>(data)[index] = dyno->getUInt32();
+         break;
+      case Int64:
+         static_cast<int64_t*>(data)[index] = dyno->getInt64();
+         break;
+      case UInt64:
+         static_cast<uint64_t*>(data)[index] = dyno->getUInt64();
+         break;
+      case Double:
+         static_cast<double*>(data)[index] = dyno->getDouble();
+         break;
+      default:
+         break;
+   }
+}
+
+static bool _hash_caching_enabled = true;
+
+/**
+ * Mixes a value into a 64-bit hash.
+ *
+ * @param hash the hash so far.
+ * @param value the value to mix in.
+ *
+ * @return the new hash.
+ */
+static inline uint64_t _combineHash(uint64_t hash, uint64_t value)
+{
+   return hash ^ (value + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2));
+}
+
+/**
+ * Gets the 64-bit FNV-1a hash of a string.
+ *
+ * @param str the string to hash.
+ *
+ * @return the hash of the string.
+ */
+static inline uint64_t _hashString(const char* str)
+{
+   // negative zero is equal to zero, so they must have the same hash
+   if(str[0] == '-' && strcmp(str, "-0.000000e+00") == 0)
+   {
+      ++str;
+   }
+
+   uint64_t hash = 14695981039346656037ULL;
+   for(const unsigned char* p = (const unsigned char*)str; *p != 0; ++p)
+   {
+      hash ^= *p;
+      hash *= 1099511628211ULL;
+   }
+   return hash;
+}
+
+/**
+ * Formats an integer as a decimal string without using snprintf().
+ *
+ * @param str the buffer to write to, at least 22 bytes long.
+ * @param value the magnitude of the integer.
+ * @param negative true if the integer is negative.
+ */
+static inline void _formatInteger(char* str, uint64_t value, bool negative)
+{
+   char digits[21];
+   int n = 0;
+   do
+   {
+      digits[n++] = '0' + (char)(value % 10);
+      value /= 10;
+   }
+   while(value != 0);
+   if(negative)
+   {
+      *str++ = '-';
+   }
+   while(n > 0)
+   {
+      *str++ = digits[--n];
+   }
+   *str = 0;
+}
+
+/**
+ * Gets the hash of a number or boolean. Values of different types are equal
+ * if their string values are equal, so the string value is hashed, formatted
+ * the same way as getString() does but without allocating it.
+ *
+ * @param type the type of the value.
+ * @param value a pointer to the value.
+ *
+ * @return the hash of the value.
+ */
+static uint64_t _hashNumber(DynamicObjectType type, const void* value)
+{
+   char str[50];
+   switch(type)
+   {
+      case Boolean:
+         strcpy(str, *static_cast<const bool*>(value) ? "true" : "false");
+         break;
+      case Int32:
       {
-         setType(Map);
-         clear();
-         ObjectMap::iterator i = value.mMap->begin();
-         for(; i != value.mMap->end(); ++i)
-         {
-            // create new map entry
-            STATS_COUNTS_INC(Key);
-            STATS_COUNTS_BYTES_INC(Key, strlen(i->first));
-            STATS_KEY_COUNTS_INC(i->first);
-            STATS_KEY_COUNTS_BYTES_INC(i->first, strlen(i->first));
-            mMap->insert(std::make_pair(strdup(i->first), i->second));
-         }
+         int64_t v = *static_cast<const int32_t*>(value);
+         _formatInteger(str, (v < 0) ? -v : v, v < 0);
          break;
       }
-      case Array:
+      case UInt32:
+         _formatInteger(str, *static_cast<const uint32_t*>(value), false);
+         break;
+      case Int64:
+      {
+         // negate as unsigned so the minimum value is handled
+         int64_t v = *static_cast<const int64_t*>(value);
+         _formatInteger(str, (v < 0) ? -(uint64_t)v : v, v < 0);
+         break;
+      }
+      case UInt64:
+         _formatInteger(str, *static_cast<const uint64_t*>(value), false);
+         break;
+      case Double:
+         snprintf(str, 50, "%e", *static_cast<const double*>(value));
+         break;
+      default:
+         str[0] = 0;
+         break;
+   }
+   return _hashString(str);
+}
+
+DynamicObjectImpl::DynamicObjectImpl() :
+   mType(String),
+   mPacked(false),
+   mFrozen(false),
+   mShared(false),
+   mHash(0),
+   mString(NULL),
+   mStringValue(NULL)
+{
+   STATS_COUNTS_INC(Object);
+   STATS_COUNTS_INC(String);
+}
+
+DynamicObjectImpl::~DynamicObjectImpl()
+{
+   DynamicObjectImpl::freeData();
+   STATS_COUNTS_DEC(mType);
+   STATS_COUNTS_DEC(Object);
+}
+
+void* DynamicObjectImpl::operator new(size_t size)
+{
+   return allocate(size);
+}
+
+void DynamicObjectImpl::operator delete(void* ptr, size_t size)
+{
+   deallocate(ptr, size);
+}
+
+void DynamicObjectImpl::operator=(const DynamicObjectImpl& value)
+{
+   if(value.mShared)
+   {
+      // share the same frozen source
+      DynamicObject source = *value.mSource;
+      share(source);
+   }
+   else
+   {
+      switch(value.mType)
       {
-         setType(Array);
-         clear();
-         ObjectArray::iterator i = value.mArray->begin();
-         for(; i != value.mArray->end(); ++i)
+         case String:
+            *this = value.mString;
+            break;
+         case Boolean:
+            *this = value.mBoolean;
+            break;
+         case Int32:
+            *this = value.mInt32;
+            break;
+         case UInt32:
+            *this = value.mUInt32;
+            break;
+         case Int64:
+            *this = value.mInt64;
+            break;
+         case UInt64:
+            *this = value.mUInt64;
+            break;
+         case Double:
+            *this = value.mDouble;
+            break;
+         case Map:
          {
-            // create new array
-            mArray->push_back(*i);
+            setType(Map);
+            clear();
+            ObjectMap::iterator i = value.mMap->begin();
+            for(; i != value.mMap->end(); ++i)
+            {
+               // create new map entry
+               STATS_COUNTS_INC(Key);
+               STATS_COUNTS_BYTES_INC(Key, strlen(i.getName()));
+               STATS_KEY_COUNTS_INC(i.getName());
+               STATS_KEY_COUNTS_BYTES_INC(i.getName(), strlen(i.getName()));
+               mMap->insert(_copyKey(i.getName()), i.getValue());
+            }
+            break;
+         }
+         case Array:
+         {
+            if(value.isPackedOnly())
+            {
+               // copy packed elements
+               DynamicObjectType type = value.mPackedArray->type;
+               int length = value.mPackedArray->length;
+               size_t size = _getPackedSize(type);
+               void* data = malloc((length == 0) ? size : length * size);
+               memcpy(data, value.mPackedArray->data, length * size);
+               freeData();
+               _changeType(this, Array);
+               mPacked = true;
+               mPackedArray = new PackedArray;
+               mPackedArray->type = type;
+               mPackedArray->length = length;
+               mPackedArray->capacity = (length == 0) ? 1 : length;
+               mPackedArray->data = data;
+               mPackedArray->elements = NULL;
+            }
+            else
+            {
+               setType(Array);
+               clear();
+               unpack();
+               ObjectArray* array = value.getArray();
+               ObjectArray::iterator i = array->begin();
+               for(; i != array->end(); ++i)
+               {
+                  // create new array
+                  mArray->push_back(*i);
+               }
+            }
+            break;
          }
-         break;
       }
    }
 }
 
 void DynamicObjectImpl::operator=(const char* value)
 {
-   // clone string before freeing data in case value came from this object
-   char* str = strdup(value);
-   freeData();
-   _changeType(this, String);
-   mString = str;
+   size_t length = strlen(value);
+   if(length < ShortStringSize)
+   {
+      // store short strings in place, copy to a temporary buffer first in
+      // case value came from this object
+      char str[ShortStringSize];
+      memcpy(str, value, length + 1);
+      freeData();
+      _changeType(this, String);
+      memcpy(mShortString, str, length + 1);
+      mString = mShortString;
+   }
+   else
+   {
+      // clone string before freeing data in case value came from this object
+      char* str = strdup(value);
+      freeData();
+      _changeType(this, String);
+      mString = str;
+   }
    STATS_COUNTS_INC(String);
-   STATS_COUNTS_BYTES_INC(String, strlen(str));
+   STATS_COUNTS_BYTES_INC(String, length);
 }
 
 void DynamicObjectImpl::operator=(bool value)
@@ -351,6 +722,7 @@ DynamicObject& DynamicObjectImpl::operator[](const char* name)
 
    // ensure object is a Map
    setType(Map);
+   materialize();
 
    ObjectMap::iterator i = mMap->find(name);
    if(i == mMap->end())
@@ -361,13 +733,12 @@ DynamicObject& DynamicObjectImpl::operator[](const char* name)
       STATS_COUNTS_BYTES_INC(Key, strlen(name));
       STATS_KEY_COUNTS_INC(name);
       STATS_KEY_COUNTS_BYTES_INC(name, strlen(name));
-      mMap->insert(std::make_pair(strdup(name), dyno));
-      rval = &(*mMap)[name];
+      rval = &mMap->insert(_createKey(name), dyno).getValue();
    }
    else
    {
       // get existing map entry
-      rval = &i->second;
+      rval = &i.getValue();
    }
 
    return *rval;
@@ -377,8 +748,9 @@ DynamicObject& DynamicObjectImpl::operator[](int index)
 {
    // ensure object is an Array
    setType(Array);
+   materialize();
 
-   int size = mArray->size();
+   int size = length();
    int neededSize;
    int arrayIndex;
 
@@ -395,22 +767,46 @@ DynamicObject& DynamicObjectImpl::operator[](int index)
    }
 
    // fill the object array as necessary
-   while(neededSize > size)
+   ObjectArray* array;
+   if(neededSize > size)
    {
-      DynamicObject dyno;
-      mArray->push_back(dyno);
-      --neededSize;
+      unpack();
+      array = mArray;
+      while(neededSize > size)
+      {
+         DynamicObject dyno;
+         array->push_back(dyno);
+         --neededSize;
+      }
+   }
+   else
+   {
+      array = getArray();
    }
 
    // return the indexed object in the possibly expanded array
-   return (*mArray)[arrayIndex];
+   return (*array)[arrayIndex];
 }
 
 bool DynamicObjectImpl::operator==(const DynamicObjectImpl& rhs) const
 {
    bool rval = false;
 
-   if(mType == rhs.mType)
+   if((mType == Map || mType == Array) && mType == rhs.mType &&
+      isHashCached() && rhs.isHashCached() && getHash() != rhs.getHash())
+   {
+      // maps or arrays with different hashes are not equal, values are
+      // compared directly because that is as cheap as comparing hashes
+      rval = false;
+   }
+   else if(mShared || rhs.mShared)
+   {
+      // compare frozen sources, which are equal if they are the same
+      const DynamicObjectImpl* lhs = getData();
+      const DynamicObjectImpl* rhsData = rhs.getData();
+      rval = (lhs == rhsData) || (*lhs == *rhsData);
+   }
+   else if(mType == rhs.mType)
    {
       switch(mType)
       {
@@ -445,10 +841,11 @@ bool DynamicObjectImpl::operator==(const DynamicObjectImpl& rhs) const
                ObjectMap::iterator ri = rhs.mMap->begin();
                for(; rval && li != mMap->end(); ++li, ++ri)
                {
-                  if(strcmp(li->first, ri->first) == 0)
+                  if(li.getName() == ri.getName() ||
+                     strcmp(li.getName(), ri.getName()) == 0)
                   {
                      // compare key values
-                     rval = (li->second == ri->second);
+                     rval = (li.getValue() == ri.getValue());
                   }
                   else
                   {
@@ -459,7 +856,32 @@ bool DynamicObjectImpl::operator==(const DynamicObjectImpl& rhs) const
             }
             break;
          case Array:
-            rval = (*mArray == *(rhs.mArray));
+            if(isPackedOnly() && rhs.isPackedOnly() &&
+               mPackedArray->type == rhs.mPackedArray->type)
+            {
+               // compare packed elements, doubles are compared by value
+               PackedArray* lp = mPackedArray;
+               PackedArray* rp = rhs.mPackedArray;
+               rval = (lp->length == rp->length);
+               if(rval && lp->type == Double)
+               {
+                  double* ld = static_cast<double*>(lp->data);
+                  double* rd = static_cast<double*>(rp->data);
+                  for(int i = 0; rval && i < lp->length; ++i)
+                  {
+                     rval = (ld[i] == rd[i]);
+                  }
+               }
+               else if(rval)
+               {
+                  rval = (memcmp(lp->data, rp->data,
+                     lp->length * _getPackedSize(lp->type)) == 0);
+               }
+            }
+            else
+            {
+               rval = (*getArray() == *(rhs.getArray()));
+            }
             break;
       }
    }
@@ -509,7 +931,12 @@ bool DynamicObjectImpl::operator<(const DynamicObjectImpl& rhs) const
 {
    bool rval = false;
 
-   if(mType == rhs.mType)
+   if(mShared || rhs.mShared)
+   {
+      // compare frozen sources
+      rval = (*getData() < *rhs.getData());
+   }
+   else if(mType == rhs.mType)
    {
       switch(mType)
       {
@@ -553,15 +980,16 @@ bool DynamicObjectImpl::operator<(const DynamicObjectImpl& rhs) const
                ObjectMap::iterator ri = rhs.mMap->begin();
                for(; !rval && li != mMap->end(); ++li, ++ri)
                {
-                  int ret = strcmp(li->first, ri->first);
+                  int ret = (li.getName() == ri.getName()) ?
+                     0 : strcmp(li.getName(), ri.getName());
                   if(ret == 0)
                   {
                      // compare key values
-                     if(li->second < ri->second)
+                     if(li.getValue() < ri.getValue())
                      {
                         rval = true;
                      }
-                     else if(li->second != ri->second)
+                     else if(li.getValue() != ri.getValue())
                      {
                         rval = false;
                         break;
@@ -577,7 +1005,7 @@ bool DynamicObjectImpl::operator<(const DynamicObjectImpl& rhs) const
             }
             break;
          case Array:
-            rval = (*mArray < *(rhs.mArray));
+            rval = (*getArray() < *(rhs.getArray()));
             break;
       }
    }
@@ -689,6 +1117,7 @@ bool DynamicObjectImpl::operator<(const DynamicObjectImpl& rhs) const
 DynamicObject& DynamicObjectImpl::append()
 {
    setType(Array);
+   unpack();
    DynamicObject d;
    mArray->push_back(d);
    return mArray->back();
@@ -697,6 +1126,7 @@ DynamicObject& DynamicObjectImpl::append()
 DynamicObject& DynamicObjectImpl::append(DynamicObject& value)
 {
    setType(Array);
+   unpack();
    mArray->push_back(value);
    return mArray->back();
 }
@@ -706,6 +1136,7 @@ DynamicObject& DynamicObjectImpl::append(const char* value)
    DynamicObject dyno;
    dyno = value;
    setType(Array);
+   unpack();
    mArray->push_back(dyno);
    return mArray->back();
 }
@@ -715,6 +1146,7 @@ DynamicObject& DynamicObjectImpl::append(bool value)
    DynamicObject dyno;
    dyno = value;
    setType(Array);
+   unpack();
    mArray->push_back(dyno);
    return mArray->back();
 }
@@ -724,6 +1156,7 @@ DynamicObject& DynamicObjectImpl::append(int32_t value)
    DynamicObject dyno;
    dyno = value;
    setType(Array);
+   unpack();
    mArray->push_back(dyno);
    return mArray->back();
 }
@@ -733,6 +1166,7 @@ DynamicObject& DynamicObjectImpl::append(uint32_t value)
    DynamicObject dyno;
    dyno = value;
    setType(Array);
+   unpack();
    mArray->push_back(dyno);
    return mArray->back();
 }
@@ -742,6 +1176,7 @@ DynamicObject& DynamicObjectImpl::append(int64_t value)
    DynamicObject dyno;
    dyno = value;
    setType(Array);
+   unpack();
    mArray->push_back(dyno);
    return mArray->back();
 }
@@ -751,6 +1186,7 @@ DynamicObject& DynamicObjectImpl::append(uint64_t value)
    DynamicObject dyno;
    dyno = value;
    setType(Array);
+   unpack();
    mArray->push_back(dyno);
    return mArray->back();
 }
@@ -760,6 +1196,7 @@ DynamicObject& DynamicObjectImpl::append(double value)
    DynamicObject dyno;
    dyno = value;
    setType(Array);
+   unpack();
    mArray->push_back(dyno);
    return mArray->back();
 }
@@ -768,10 +1205,24 @@ DynamicObject DynamicObjectImpl::pop()
 {
    DynamicObject rval(NULL);
    setType(Array);
-   if(mArray->size() > 0)
+   if(isPackedOnly())
+   {
+      if(mPackedArray->length > 0)
+      {
+         rval = DynamicObject();
+         _getPackedElement(
+            rval, mPackedArray->type, mPackedArray->data,
+            --mPackedArray->length);
+      }
+   }
+   else
    {
-      rval = mArray->back();
-      mArray->pop_back();
+      unpack();
+      if(mArray->size() > 0)
+      {
+         rval = mArray->back();
+         mArray->pop_back();
+      }
    }
    return rval;
 }
@@ -881,14 +1332,14 @@ const char* DynamicObjectImpl::getString() const
    else if(mType == Array)
    {
       // return blank string
-      if(mArray->size() == 0)
+      if(length() == 0)
       {
          rval = "";
       }
       // return first element of array as a string
       else
       {
-         rval = (*mArray)[0]->getString();
+         rval = (*getArray())[0]->getString();
       }
    }
    else
@@ -1180,35 +1631,76 @@ bool DynamicObjectImpl::hasMember(const char* name) const
 
    if(mType == Map)
    {
-      rval = (mMap->count(name) != 0);
+      rval = (getData()->mMap->count(name) != 0);
    }
 
    return rval;
 }
 
-void DynamicObjectImpl::removeMember(const char* name)
+DynamicObject* DynamicObjectImpl::findMember(
+   const char* name, bool interned) const
 {
+   DynamicObject* rval = NULL;
+
    if(mType == Map)
    {
-      ObjectMap::iterator i = mMap->find(name);
-      if(i != mMap->end())
+      ObjectMap* map = getData()->mMap;
+      ObjectMap::iterator i = interned ? map->findInterned(name) :
+         map->find(name);
+      if(i != map->end())
       {
-         removeMember(i);
+         rval = &i.getValue();
       }
    }
+
+   return rval;
 }
 
-int DynamicObjectImpl::indexOf(DynamicObject& obj) const
+DynamicObject* DynamicObjectImpl::findElement(int index) const
 {
-   int rval = -1;
+   DynamicObject* rval = NULL;
 
-   // type must be array to get an index
    if(mType == Array)
    {
-      ObjectArray::iterator i = find(mArray->begin(), mArray->end(), obj);
-      if(i != mArray->end())
+      int size = length();
+      if(index < 0)
+      {
+         index += size;
+      }
+      if(index >= 0 && index < size)
       {
-         rval = (i - mArray->begin());
+         rval = &(*getArray())[index];
+      }
+   }
+
+   return rval;
+}
+
+void DynamicObjectImpl::removeMember(const char* name)
+{
+   if(mType == Map)
+   {
+      materialize();
+      ObjectMap::iterator i = mMap->find(name);
+      if(i != mMap->end())
+      {
+         removeMember(i);
+      }
+   }
+}
+
+int DynamicObjectImpl::indexOf(DynamicObject& obj) const
+{
+   int rval = -1;
+
+   // type must be array to get an index
+   if(mType == Array)
+   {
+      ObjectArray* array = getArray();
+      ObjectArray::iterator i = find(array->begin(), array->end(), obj);
+      if(i != array->end())
+      {
+         rval = (i - array->begin());
       }
    }
 
@@ -1267,8 +1759,25 @@ int DynamicObjectImpl::indexOf(double value) const
 void DynamicObjectImpl::removeIndex(int index)
 {
    // type must be array to erase at an index
-   if(mType == Array)
+   if(mType == Array && isPackedOnly())
+   {
+      int length = mPackedArray->length;
+      if(index < 0)
+      {
+         index = length + index;
+      }
+      if(index >= 0 && index < length)
+      {
+         size_t size = _getPackedSize(mPackedArray->type);
+         char* data = static_cast<char*>(mPackedArray->data);
+         memmove(data + index * size, data + (index + 1) * size,
+            (length - index - 1) * size);
+         --mPackedArray->length;
+      }
+   }
+   else if(mType == Array)
    {
+      unpack();
       if(index >= 0)
       {
          ObjectArray::iterator i = mArray->begin() + index;
@@ -1291,6 +1800,15 @@ void DynamicObjectImpl::removeIndex(int index)
 
 void DynamicObjectImpl::clear()
 {
+   if(mShared)
+   {
+      // stop sharing instead of copying members that will be removed
+      DynamicObjectType type = mType;
+      freeData();
+      _changeType(this, String);
+      setType(type);
+   }
+
    switch(mType)
    {
       case String:
@@ -1319,7 +1837,15 @@ void DynamicObjectImpl::clear()
          mMap->clear();
          break;
       case Array:
-         mArray->clear();
+         if(isPackedOnly())
+         {
+            mPackedArray->length = 0;
+         }
+         else
+         {
+            unpack();
+            mArray->clear();
+         }
          break;
    }
 }
@@ -1348,10 +1874,25 @@ int DynamicObjectImpl::length() const
          rval = sizeof(double);
          break;
       case Map:
-         rval = mMap->size();
+         rval = mShared ? getData()->length() : mMap->size();
          break;
       case Array:
-         rval = mArray->size();
+         if(mShared)
+         {
+            rval = getData()->length();
+         }
+         else if(!mPacked)
+         {
+            rval = mArray->size();
+         }
+         else if(isPackedOnly())
+         {
+            rval = mPackedArray->length;
+         }
+         else
+         {
+            rval = const_cast<ObjectArray*>(mPackedArray->elements)->size();
+         }
          break;
    }
 
@@ -1371,7 +1912,30 @@ void DynamicObjectImpl::reverse()
          }
          break;
       case Array:
-         std::reverse(mArray->begin(), mArray->end());
+         if(isPackedOnly())
+         {
+            int length = mPackedArray->length;
+            switch(_getPackedSize(mPackedArray->type))
+            {
+               case sizeof(uint32_t):
+               {
+                  uint32_t* data = static_cast<uint32_t*>(mPackedArray->data);
+                  std::reverse(data, data + length);
+                  break;
+               }
+               case sizeof(uint64_t):
+               {
+                  uint64_t* data = static_cast<uint64_t*>(mPackedArray->data);
+                  std::reverse(data, data + length);
+                  break;
+               }
+            }
+         }
+         else
+         {
+            unpack();
+            std::reverse(mArray->begin(), mArray->end());
+         }
          break;
       default:
          break;
@@ -1385,51 +1949,406 @@ bool DynamicObjectImpl::isUnset()
    return (mType == String && mString == NULL);
 }
 
+bool DynamicObjectImpl::isFrozen() const
+{
+   return mFrozen;
+}
+
+uint64_t DynamicObjectImpl::getHash() const
+{
+   uint64_t rval = mHash;
+
+   if(mShared)
+   {
+      // use the hash of the frozen source
+      rval = getData()->getHash();
+   }
+   else if(rval == 0)
+   {
+      switch(mType)
+      {
+         case String:
+            rval = _hashString(mString == NULL ? "" : mString);
+            break;
+         case Boolean:
+         case Int32:
+         case UInt32:
+         case Int64:
+         case UInt64:
+         case Double:
+            // every value starts at the same address in the union
+            rval = _hashNumber(mType, &mInt64);
+            break;
+         case Map:
+         {
+            // map members are sorted so equal maps are hashed in the same order
+            rval = Map;
+            ObjectMap::iterator i = mMap->begin();
+            for(; i != mMap->end(); ++i)
+            {
+               rval = _combineHash(rval, _hashString(i.getName()));
+               rval = _combineHash(rval, i.getValue().getHash());
+            }
+            break;
+         }
+         case Array:
+            rval = Array;
+            if(isPackedOnly())
+            {
+               // hash packed elements without creating DynamicObjects
+               const char* data =
+                  static_cast<const char*>(mPackedArray->data);
+               size_t size = _getPackedSize(mPackedArray->type);
+               for(int i = 0; i < mPackedArray->length; ++i, data += size)
+               {
+                  rval = _combineHash(
+                     rval, _hashNumber(mPackedArray->type, data));
+               }
+            }
+            else
+            {
+               ObjectArray* array = getArray();
+               for(ObjectArray::iterator i = array->begin();
+                   i != array->end(); ++i)
+               {
+                  rval = _combineHash(rval, i->getHash());
+               }
+            }
+            break;
+      }
+
+      // 0 means no cached hash
+      if(rval == 0)
+      {
+         rval = 1;
+      }
+
+      // only frozen objects can't change, other threads compute the same hash
+      if(mFrozen && _hash_caching_enabled)
+      {
+         Atomic::compareAndSwap(
+            const_cast<volatile uint64_t*>(&mHash), (uint64_t)0, rval);
+      }
+   }
+
+   return rval;
+}
+
+bool DynamicObjectImpl::isHashCached() const
+{
+   return _hash_caching_enabled && getData()->mFrozen;
+}
+
+void DynamicObjectImpl::setPackedType(DynamicObjectType type)
+{
+   size_t size = _getPackedSize(type);
+   if(size == 0)
+   {
+      // only numbers can be packed
+      if(mType == Array)
+      {
+         unpack();
+      }
+   }
+   else if(mType != Array || !isPackedOnly() || mPackedArray->type != type)
+   {
+      // convert existing elements
+      setType(Array);
+      ObjectArray* array = getArray();
+      int length = array->size();
+      void* data = malloc((length == 0) ? size : length * size);
+      for(int i = 0; i < length; ++i)
+      {
+         _setPackedElement((*array)[i], type, data, i);
+      }
+
+      freeData();
+      _changeType(this, Array);
+      mPacked = true;
+      mPackedArray = new PackedArray;
+      mPackedArray->type = type;
+      mPackedArray->length = length;
+      mPackedArray->capacity = (length == 0) ? 1 : length;
+      mPackedArray->data = data;
+      mPackedArray->elements = NULL;
+   }
+}
+
+DynamicObjectType DynamicObjectImpl::getPackedType() const
+{
+   return (mType == Array && isPackedOnly()) ? mPackedArray->type : Array;
+}
+
+const void* DynamicObjectImpl::getPackedData() const
+{
+   return (mType == Array && isPackedOnly()) ? mPackedArray->data : NULL;
+}
+
+void DynamicObjectImpl::appendPacked(int32_t value)
+{
+   if(!appendToPackedArray(Int32, &value))
+   {
+      append(value);
+   }
+}
+
+void DynamicObjectImpl::appendPacked(uint32_t value)
+{
+   if(!appendToPackedArray(UInt32, &value))
+   {
+      append(value);
+   }
+}
+
+void DynamicObjectImpl::appendPacked(int64_t value)
+{
+   if(!appendToPackedArray(Int64, &value))
+   {
+      append(value);
+   }
+}
+
+void DynamicObjectImpl::appendPacked(uint64_t value)
+{
+   if(!appendToPackedArray(UInt64, &value))
+   {
+      append(value);
+   }
+}
+
+void DynamicObjectImpl::appendPacked(double value)
+{
+   if(!appendToPackedArray(Double, &value))
+   {
+      append(value);
+   }
+}
+
+DynamicObjectImpl::ObjectArray* DynamicObjectImpl::getArray() const
+{
+   ObjectArray* rval;
+
+   if(mShared)
+   {
+      rval = getData()->getArray();
+   }
+   else if(!mPacked)
+   {
+      rval = mArray;
+   }
+   else
+   {
+      /* Note: Like the cached string value in getString(), the elements of a
+       * packed array are created on demand by a "read" function, so they are
+       * atomically stored and our copy is freed if another thread got there
+       * first.
+       */
+      rval = const_cast<ObjectArray*>(mPackedArray->elements);
+      if(rval == NULL)
+      {
+         ObjectArray* array = new ObjectArray();
+         array->reserve(mPackedArray->length);
+         for(int i = 0; i < mPackedArray->length; ++i)
+         {
+            DynamicObject dyno;
+            _getPackedElement(
+               dyno, mPackedArray->type, mPackedArray->data, i);
+            if(mFrozen)
+            {
+               dyno.freeze();
+            }
+            array->push_back(dyno);
+         }
+
+         if(Atomic::compareAndSwap(
+            const_cast<volatile ObjectArray**>(&mPackedArray->elements),
+            (ObjectArray*)NULL, array))
+         {
+            rval = array;
+         }
+         else
+         {
+            delete array;
+            rval = const_cast<ObjectArray*>(mPackedArray->elements);
+         }
+      }
+   }
+
+   return rval;
+}
+
+void DynamicObjectImpl::unpack()
+{
+   materialize();
+   if(mPacked)
+   {
+      // take the elements before freeing the packed array
+      ObjectArray* array = getArray();
+      mPackedArray->elements = NULL;
+      freeData();
+      mArray = array;
+   }
+}
+
+const DynamicObjectImpl* DynamicObjectImpl::getData() const
+{
+   return mShared ? &(**mSource) : this;
+}
+
+void DynamicObjectImpl::share(DynamicObject& source)
+{
+   // keep a reference to the source
+   void* ptr = allocate(sizeof(DynamicObject));
+   DynamicObject* ref = new (ptr) DynamicObject(source);
+   DynamicObjectType type = source->mType;
+   freeData();
+   _changeType(this, type);
+   mShared = true;
+   mSource = ref;
+}
+
+void DynamicObjectImpl::materialize()
+{
+   if(mShared)
+   {
+      DynamicObject source = *mSource;
+      freeData();
+      switch(source->mType)
+      {
+         case Map:
+         {
+            // clone each member, which is frozen, so only a shared copy of
+            // it is made
+            mMap = new ObjectMap();
+            ObjectMap::iterator i = source->mMap->begin();
+            for(; i != source->mMap->end(); ++i)
+            {
+               STATS_COUNTS_INC(Key);
+               STATS_COUNTS_BYTES_INC(Key, strlen(i.getName()));
+               STATS_KEY_COUNTS_INC(i.getName());
+               STATS_KEY_COUNTS_BYTES_INC(i.getName(), strlen(i.getName()));
+               mMap->insert(_copyKey(i.getName()), i.getValue().clone());
+            }
+            break;
+         }
+         case Array:
+         {
+            if(source->isPackedOnly())
+            {
+               // numbers are simply copied
+               _changeType(this, String);
+               mString = NULL;
+               *this = *source;
+            }
+            else
+            {
+               // clone each element, which is frozen, so only a shared copy
+               // of it is made
+               ObjectArray* array = source->getArray();
+               mArray = new ObjectArray();
+               mArray->reserve(array->size());
+               for(ObjectArray::iterator i = array->begin();
+                   i != array->end(); ++i)
+               {
+                  mArray->push_back(i->clone());
+               }
+            }
+            break;
+         }
+         default:
+            break;
+      }
+   }
+}
+
+bool DynamicObjectImpl::appendToPackedArray(
+   DynamicObjectType type, const void* value)
+{
+   bool rval = (mType == Array && isPackedOnly() &&
+      mPackedArray->type == type);
+   if(rval)
+   {
+      size_t size = _getPackedSize(type);
+      if(mPackedArray->length == mPackedArray->capacity)
+      {
+         // grow the array
+         mPackedArray->capacity *= 2;
+         mPackedArray->data = realloc(
+            mPackedArray->data, mPackedArray->capacity * size);
+      }
+      memcpy(static_cast<char*>(mPackedArray->data) +
+         mPackedArray->length * size, value, size);
+      ++mPackedArray->length;
+   }
+   return rval;
+}
+
 void DynamicObjectImpl::freeMapKeys()
 {
    // clean up member names
    for(ObjectMap::iterator i = mMap->begin(); i != mMap->end(); ++i)
    {
-      char* key = (char*)i->first;
+      const char* key = i.getName();
       STATS_COUNTS_DEC(Key);
       STATS_COUNTS_BYTES_DEC(Key, strlen(key));
       STATS_KEY_COUNTS_DEC(key);
       STATS_KEY_COUNTS_BYTES_DEC(key, strlen(key));
-      free(key);
+      StringTable::release(key);
    }
 }
 
 void DynamicObjectImpl::freeData()
 {
-   // clean up data based on type
-   switch(mType)
+   // release shared source or clean up data based on type
+   if(mShared)
    {
-      case String:
-         if(mString != NULL)
-         {
-            STATS_COUNTS_BYTES_DEC(String, strlen(mString));
-            free(mString);
-            mString = NULL;
-         }
-         break;
-      case Map:
-         if(mMap != NULL)
-         {
-            freeMapKeys();
-            delete mMap;
-            mMap = NULL;
-         }
-         break;
-      case Array:
-         if(mArray != NULL)
-         {
-            delete mArray;
-            mArray = NULL;
-         }
-         break;
-      default:
-         // nothing to cleanup
-         break;
+      mSource->~DynamicObject();
+      deallocate(mSource, sizeof(DynamicObject));
+      mSource = NULL;
+      mShared = false;
+   }
+   else
+   {
+      switch(mType)
+      {
+         case String:
+            if(mString != NULL)
+            {
+               STATS_COUNTS_BYTES_DEC(String, strlen(mString));
+               if(mString != mShortString)
+               {
+                  free(mString);
+               }
+               mString = NULL;
+            }
+            break;
+         case Map:
+            if(mMap != NULL)
+            {
+               freeMapKeys();
+               delete mMap;
+               mMap = NULL;
+            }
+            break;
+         case Array:
+            if(mPacked)
+            {
+               delete const_cast<ObjectArray*>(mPackedArray->elements);
+               free(mPackedArray->data);
+               delete mPackedArray;
+               mPackedArray = NULL;
+               mPacked = false;
+            }
+            else if(mArray != NULL)
+            {
+               delete mArray;
+               mArray = NULL;
+            }
+            break;
+         default:
+            // nothing to cleanup
+            break;
+      }
    }
 
    // free cached string value
@@ -1444,16 +2363,17 @@ void DynamicObjectImpl::freeData()
    }
 }
 
-void DynamicObjectImpl::removeMember(ObjectMap::iterator iterator)
+DynamicObjectImpl::ObjectMap::iterator DynamicObjectImpl::removeMember(
+   ObjectMap::iterator iterator)
 {
    // clean up key and remove map entry
-   char* key = (char*)iterator->first;
+   const char* key = iterator.getName();
    STATS_COUNTS_DEC(Key);
    STATS_COUNTS_BYTES_DEC(Key, strlen(key));
    STATS_KEY_COUNTS_DEC(key);
    STATS_KEY_COUNTS_BYTES_DEC(key, strlen(key));
-   free(key);
-   mMap->erase(iterator);
+   StringTable::release(key);
+   return mMap->erase(iterator);
 }
 
 void DynamicObjectImpl::setFormattedString(const char* format, va_list varargs)
@@ -1576,6 +2496,8 @@ DynamicObject DynamicObjectImpl::getStats()
    GETSTAT(rval, Array);
    GETSTAT(rval, Key);
    GETSTAT(rval, StringValue);
+   GETSTAT(rval, KeyInternHit);
+   GETSTAT(rval, KeyInternMiss);
    #undef GETSTAT
 #endif // MO_DYNO_COUNTS
 
@@ -1599,3 +2521,83 @@ DynamicObject DynamicObjectImpl::getStats()
 
    return rval;
 }
+
+bool DynamicObjectImpl::enablePooling(bool enable)
+{
+   bool rval = _node_pooling_enabled;
+   _node_pooling_enabled = enable;
+   return rval;
+}
+
+bool DynamicObjectImpl::enableHashCaching(bool enable)
+{
+   bool rval = _hash_caching_enabled;
+   _hash_caching_enabled = enable;
+   return rval;
+}
+
+const char* DynamicObjectImpl::internKey(const char* name)
+{
+   return _createKey(name);
+}
+
+void* DynamicObjectImpl::allocate(size_t size)
+{
+   union _node_header_u* header = NULL;
+
+   // try to allocate from the current arena
+   DynamicObjectArena::Data* arena = DynamicObjectArena::getCurrentData();
+   if(arena != NULL)
+   {
+      header = static_cast<union _node_header_u*>(DynamicObjectArena::allocate(
+         arena, sizeof(union _node_header_u) + size));
+   }
+
+   if(header != NULL)
+   {
+      header->arena = arena;
+   }
+   else
+   {
+      // allocate from the pool for the size class, always using the pool's
+      // block size so that the block can later be released to the pool
+      MemoryPool* pool = _getNodePool(size);
+      if(pool != NULL && _node_pooling_enabled)
+      {
+         header = static_cast<union _node_header_u*>(pool->allocate());
+      }
+      else
+      {
+         header = static_cast<union _node_header_u*>(malloc((pool != NULL) ?
+            pool->getBlockSize() : sizeof(union _node_header_u) + size));
+      }
+      header->arena = NULL;
+   }
+
+   return header + 1;
+}
+
+void DynamicObjectImpl::deallocate(void* ptr, size_t size)
+{
+   if(ptr != NULL)
+   {
+      union _node_header_u* header =
+         static_cast<union _node_header_u*>(ptr) - 1;
+      if(header->arena != NULL)
+      {
+         DynamicObjectArena::deallocate(header->arena);
+      }
+      else
+      {
+         MemoryPool* pool = _getNodePool(size);
+         if(pool != NULL && _node_pooling_enabled)
+         {
+            pool->release(header);
+         }
+         else
+         {
+            free(header);
+         }
+      }
+   }
+}
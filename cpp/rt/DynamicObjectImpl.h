@@ -4,6 +4,9 @@
 #ifndef monarch_rt_DynamicObjectImpl_H
 #define monarch_rt_DynamicObjectImpl_H
 
+#include "monarch/rt/Collectable.h"
+#include "monarch/rt/DynamicObjectMap.h"
+
 #include <map>
 #include <vector>
 #include <cstring>
@@ -40,35 +43,85 @@ public:
    /**
     * A MemberComparator compares two member names.
     */
-   struct MemberComparator
+   typedef DynamicObjectMap::MemberComparator MemberComparator;
+
+   /**
+    * The definition for a DynamicObject map and array.
+    */
+   typedef DynamicObjectMap ObjectMap;
+   typedef std::vector<DynamicObject> ObjectArray;
+
+protected:
+   /**
+    * A PackedArray stores the elements of an Array contiguously as numbers
+    * of a single type.
+    */
+   struct PackedArray
    {
       /**
-       * Compares two null-terminated strings, returning true if the first is
-       * less than the second, false if not. The compare is case-sensitive.
-       *
-       * @param s1 the first string.
-       * @param s2 the second string.
-       *
-       * @return true if the s1 < s2, false if not.
+       * The type of every element.
+       */
+      DynamicObjectType type;
+
+      /**
+       * The number of elements and the number of elements there is room for.
+       */
+      int length;
+      int capacity;
+
+      /**
+       * The elements.
+       */
+      void* data;
+
+      /**
+       * The elements as DynamicObjects, created the first time a reference to
+       * an element is needed. Once set, these elements are used instead of
+       * the packed data.
        */
-      bool operator()(const char* s1, const char* s2) const
-      {
-         return strcmp(s1, s2) < 0;
-      }
+      volatile ObjectArray* elements;
    };
 
    /**
-    * The definition for a DynamicObject map and array.
+    * The size of the buffer used to store short strings.
     */
-   typedef std::map<const char*, DynamicObject, MemberComparator> ObjectMap;
-   typedef std::vector<DynamicObject> ObjectArray;
+   enum
+   {
+      ShortStringSize = 17
+   };
 
-protected:
    /**
     * The type for this object.
     */
    DynamicObjectType mType;
 
+   /**
+    * True if this object is an Array that is stored in mPackedArray.
+    */
+   bool mPacked;
+
+   /**
+    * True if this object and everything it contains must not be modified.
+    */
+   bool mFrozen;
+
+   /**
+    * True if this object is a copy of a frozen Map or Array that has not
+    * been modified yet. Its value is stored in mSource.
+    */
+   bool mShared;
+
+   /**
+    * Storage for short strings, mString points here when it is used.
+    */
+   char mShortString[ShortStringSize];
+
+   /**
+    * The cached hash of this object, 0 if it has not been computed. Only the
+    * hashes of frozen objects are cached.
+    */
+   volatile uint64_t mHash;
+
    /**
     * The value for this object.
     */
@@ -83,6 +136,8 @@ protected:
       double mDouble;
       ObjectMap* mMap;
       ObjectArray* mArray;
+      PackedArray* mPackedArray;
+      DynamicObject* mSource;
    };
 
    /**
@@ -109,6 +164,24 @@ public:
     */
    virtual ~DynamicObjectImpl();
 
+   /**
+    * Allocates memory for a DynamicObjectImpl from the current thread's
+    * DynamicObjectArena, if there is one, or from a per-thread pool.
+    *
+    * @param size the number of bytes to allocate.
+    *
+    * @return the allocated memory.
+    */
+   static void* operator new(size_t size);
+
+   /**
+    * Frees the memory for a DynamicObjectImpl.
+    *
+    * @param ptr the memory to free.
+    * @param size the number of bytes that were allocated.
+    */
+   static void operator delete(void* ptr, size_t size);
+
    /**
     * Sets this object's value to the value of another DynamicObjectImpl.
     *
@@ -481,6 +554,31 @@ public:
     */
    virtual bool hasMember(const char* name) const;
 
+   /**
+    * Gets a member of this object without creating it if it does not exist.
+    * The members of an unmodified copy of a frozen Map are frozen.
+    *
+    * @param name the name of the member.
+    * @param interned true if the name was returned from internKey(), which
+    *           lets members be found by comparing pointers.
+    *
+    * @return the member, NULL if this object is not a Map or does not have
+    *         a member with the specified name.
+    */
+   virtual DynamicObject* findMember(
+      const char* name, bool interned = false) const;
+
+   /**
+    * Gets an element of this object without creating it if it does not
+    * exist. The elements of an unmodified copy of a frozen Array are frozen.
+    *
+    * @param index the index of the element, negative to count from the end.
+    *
+    * @return the element, NULL if this object is not an Array or the index
+    *         is out of range.
+    */
+   virtual DynamicObject* findElement(int index) const;
+
    /**
     * Removes a member from this object, if it has it.
     *
@@ -630,6 +728,78 @@ public:
     */
    virtual bool isUnset();
 
+   /**
+    * Returns true if this object has been frozen. A frozen object must not be
+    * modified, but may be safely read by many threads at once.
+    *
+    * @return true if this object is frozen, false if not.
+    */
+   virtual bool isFrozen() const;
+
+   /**
+    * Gets a 64-bit structural hash of this object. Objects that are equal
+    * according to operator== have the same hash, so objects with different
+    * hashes are not equal. The hash is computed from every member or element
+    * this object contains, but it is cached if this object is frozen or an
+    * unmodified copy of a frozen object.
+    *
+    * @return the hash of this object.
+    */
+   virtual uint64_t getHash() const;
+
+   /**
+    * Returns true if the hash of this object is cached once it has been
+    * computed, making it cheap to compare against other cached hashes.
+    *
+    * @return true if this object's hash is cached, false if not.
+    */
+   virtual bool isHashCached() const;
+
+   /**
+    * Packs this object as an Array of numbers of the given type that are
+    * stored contiguously instead of as individual DynamicObjects. Packed
+    * arrays use far less memory and can be read in bulk via getPackedData().
+    *
+    * Existing elements are converted to the given type. Using a packed array
+    * like any other array works as expected, however, getting a reference
+    * to an element (ie: via operator[](int) or an iterator) creates
+    * DynamicObjects for all of the elements and appending anything other
+    * than a number of the packed type with appendPacked() unpacks the array.
+    *
+    * @param type the type of the elements (Int32, UInt32, Int64, UInt64 or
+    *           Double), any other type unpacks the array.
+    */
+   virtual void setPackedType(DynamicObjectType type);
+
+   /**
+    * Gets the type of the elements of this object if it is a packed Array.
+    *
+    * @return the type of the elements of a packed Array, Array if this
+    *         object is not a packed Array.
+    */
+   virtual DynamicObjectType getPackedType() const;
+
+   /**
+    * Gets the elements of this object if it is a packed Array. The elements
+    * are stored contiguously as numbers of the type given by getPackedType().
+    *
+    * @return the packed elements or NULL if this object is not a packed
+    *         Array.
+    */
+   virtual const void* getPackedData() const;
+
+   /**
+    * Appends a number to this Array. Unlike append(), no reference to the
+    * new element is returned so a packed Array of the same type stays packed.
+    *
+    * @param value the number to append.
+    */
+   virtual void appendPacked(int32_t value);
+   virtual void appendPacked(uint32_t value);
+   virtual void appendPacked(int64_t value);
+   virtual void appendPacked(uint64_t value);
+   virtual void appendPacked(double value);
+
    /**
     * Enable or disable debugging statistics.
     *
@@ -657,6 +827,59 @@ public:
     */
    static DynamicObject getStats();
 
+   /**
+    * Enables or disables pooling of the memory used by DynamicObjectImpls
+    * and their references. Pooling is enabled by default. When disabled,
+    * memory is allocated directly from the heap unless there is a current
+    * DynamicObjectArena.
+    *
+    * @param enable true to enable, false to disable.
+    *
+    * @return the previous enabled value.
+    */
+   static bool enablePooling(bool enable);
+
+   /**
+    * Enables or disables caching of the hashes of frozen objects. Cached
+    * hashes let comparisons and diffs skip objects that differ or are
+    * identical without walking them. Caching is enabled by default.
+    *
+    * @param enable true to enable, false to disable.
+    *
+    * @return the previous enabled value.
+    */
+   static bool enableHashCaching(bool enable);
+
+   /**
+    * Interns a member name in the table shared by the keys of all Maps, so
+    * that finding a member with it usually only compares pointers.
+    *
+    * @param name the member name.
+    *
+    * @return the interned name, to be passed to StringTable::release().
+    */
+   static const char* internKey(const char* name);
+
+   /**
+    * Allocates a block of memory for a DynamicObjectImpl or one of its
+    * references. Memory is taken from the current thread's
+    * DynamicObjectArena if there is one, otherwise it is taken from a
+    * per-thread pool of blocks of the same size.
+    *
+    * @param size the number of bytes to allocate.
+    *
+    * @return the allocated memory.
+    */
+   static void* allocate(size_t size);
+
+   /**
+    * Frees a block of memory allocated with allocate().
+    *
+    * @param ptr the memory to free, NULL is ignored.
+    * @param size the number of bytes that were allocated.
+    */
+   static void deallocate(void* ptr, size_t size);
+
 protected:
    /**
     * Frees the key data associated with a Map.
@@ -668,12 +891,74 @@ protected:
     */
    virtual void freeData();
 
+   /**
+    * Gets the object that holds the value of this object. This is the frozen
+    * source object for an unmodified copy of a frozen Map or Array and this
+    * object otherwise.
+    *
+    * @return the object that holds the value of this object.
+    */
+   virtual const DynamicObjectImpl* getData() const;
+
+   /**
+    * Makes this object an unmodified copy of a frozen Map or Array.
+    *
+    * @param source the frozen Map or Array.
+    */
+   virtual void share(DynamicObject& source);
+
+   /**
+    * Gives an unmodified copy of a frozen Map or Array its own members or
+    * elements. Each one is a copy of the frozen one, so the copy continues
+    * lazily, one object at a time, as the members or elements are modified.
+    * Must be called before a Map or Array is modified.
+    */
+   virtual void materialize();
+
+   /**
+    * Gets the elements of this Array as DynamicObjects, creating them if
+    * this is a packed Array. This may safely be called from multiple threads.
+    *
+    * @return the elements of this Array.
+    */
+   virtual ObjectArray* getArray() const;
+
+   /**
+    * Converts a packed Array into a regular one. Must be called before an
+    * Array is modified through its ObjectArray.
+    */
+   virtual void unpack();
+
+   /**
+    * Returns true if this object is a packed Array that has not created
+    * DynamicObjects for its elements.
+    *
+    * @return true if this object's elements are only stored packed.
+    */
+   bool isPackedOnly() const
+   {
+      return mPacked && mPackedArray->elements == NULL;
+   };
+
+   /**
+    * Appends a number to this Array if it is a packed Array of the given
+    * type.
+    *
+    * @param type the type of the number.
+    * @param value the number to append.
+    *
+    * @return true if the number was appended, false if not.
+    */
+   virtual bool appendToPackedArray(DynamicObjectType type, const void* value);
+
    /**
     * Removes a member from this map object.
     *
     * @param it iterator to the member to remove from this object.
+    *
+    * @return an iterator to the member that followed the removed member.
     */
-   virtual void removeMember(ObjectMap::iterator iterator);
+   virtual ObjectMap::iterator removeMember(ObjectMap::iterator iterator);
 
    /**
     * Sets this object to the passed formatted string.
@@ -684,6 +969,24 @@ protected:
    virtual void setFormattedString(const char* format, va_list varargs);
 };
 
+/**
+ * References to DynamicObjectImpls are allocated from the same pools and
+ * arenas as the DynamicObjectImpls themselves.
+ */
+template<>
+struct CollectableAllocator<DynamicObjectImpl>
+{
+   static void* allocate(size_t size)
+   {
+      return DynamicObjectImpl::allocate(size);
+   }
+
+   static void deallocate(void* ptr, size_t size)
+   {
+      DynamicObjectImpl::deallocate(ptr, size);
+   }
+};
+
 } // end namespace rt
 } // end namespace monarch
 #endif
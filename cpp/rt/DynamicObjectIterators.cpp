@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2007-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2007-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #include "monarch/rt/DynamicObjectIterators.h"
 
@@ -31,7 +31,7 @@ DynamicObject& DynamicObjectIteratorSingle::next()
 
 DynamicObjectIteratorArray::DynamicObjectIteratorArray(DynamicObject& dyno) :
    DynamicObjectIteratorImpl(dyno),
-   mArray(dyno->mArray),
+   mArray(dyno->getArray()),
    mArrayIterator(mArray->begin())
 {
 }
@@ -64,9 +64,9 @@ void DynamicObjectIteratorArray::remove()
 DynamicObjectIteratorMap::DynamicObjectIteratorMap(DynamicObject& dyno) :
    DynamicObjectIteratorImpl(dyno),
    mName(NULL),
-   mMap(dyno->mMap),
-   mMapIterator(mMap->begin())
+   mMap(dyno->mMap)
 {
+   setMapIterator(mMap->begin());
 }
 
 DynamicObjectIteratorMap::~DynamicObjectIteratorMap()
@@ -75,24 +75,27 @@ DynamicObjectIteratorMap::~DynamicObjectIteratorMap()
 
 bool DynamicObjectIteratorMap::hasNext()
 {
+   syncMapIterator();
    return (mMapIterator != mMap->end());
 }
 
 DynamicObject& DynamicObjectIteratorMap::next()
 {
-   DynamicObject& rval = mMapIterator->second;
+   syncMapIterator();
+   DynamicObject& rval = mMapIterator.getValue();
    ++mIndex;
-   mName = mMapIterator->first;
-   ++mMapIterator;
+   mName = mMapIterator.getName();
+   setMapIterator(++mMapIterator);
    return rval;
 }
 
 void DynamicObjectIteratorMap::remove()
 {
    // copy iterator and reverse to previous position for deletion
+   syncMapIterator();
    DynamicObjectImpl::ObjectMap::iterator last = mMapIterator;
    --last;
-   mObject->removeMember(last);
+   setMapIterator(mObject->removeMember(last));
    --mIndex;
    mName = NULL;
 }
@@ -101,3 +104,21 @@ const char* DynamicObjectIteratorMap::getName()
 {
    return mName;
 }
+
+void DynamicObjectIteratorMap::setMapIterator(
+   DynamicObjectImpl::ObjectMap::iterator i)
+{
+   mMapIterator = i;
+   mMapVersion = mMap->getVersion();
+   mNextName = (i == mMap->end()) ? NULL : i.getName();
+}
+
+void DynamicObjectIteratorMap::syncMapIterator()
+{
+   if(mMapVersion != mMap->getVersion())
+   {
+      // map was modified, reposition at the next member
+      setMapIterator((mNextName == NULL) ?
+         mMap->end() : mMap->lowerBound(mNextName));
+   }
+}
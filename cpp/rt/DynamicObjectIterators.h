@@ -131,6 +131,13 @@ protected:
     */
    DynamicObjectImpl::ObjectMap::iterator mMapIterator;
 
+   /**
+    * The version of the map and the name of the member at mMapIterator
+    * (NULL at the end) when mMapIterator was last set.
+    */
+   unsigned int mMapVersion;
+   const char* mNextName;
+
 public:
    /**
     * Creates a new DynamicObjectIteratorMap for the given DynamicObject.
@@ -177,6 +184,19 @@ public:
     *         otherwise NULL.
     */
    virtual const char* getName();
+
+protected:
+   /**
+    * Sets mMapIterator and records the map's current state.
+    *
+    * @param i the new map iterator.
+    */
+   virtual void setMapIterator(DynamicObjectImpl::ObjectMap::iterator i);
+
+   /**
+    * Repositions mMapIterator if the map has been modified since it was set.
+    */
+   virtual void syncMapIterator();
 };
 
 } // end namespace rt
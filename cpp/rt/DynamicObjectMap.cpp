@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#include "monarch/rt/DynamicObjectMap.h"
+
+#include "monarch/rt/DynamicObject.h"
+
+#include <new>
+
+using namespace std;
+using namespace monarch::rt;
+
+int DynamicObjectMap::sFlatMapMaxSize = 16;
+
+DynamicObjectMap::DynamicObjectMap() :
+   mTree(NULL),
+   mVersion(0)
+{
+}
+
+DynamicObjectMap::~DynamicObjectMap()
+{
+   DynamicObjectMap::clear();
+}
+
+DynamicObjectMap::iterator DynamicObjectMap::find(const char* name)
+{
+   iterator rval;
+
+   if(mTree == NULL)
+   {
+      int size = mFlat.size();
+      int idx = flatLowerBound(name);
+      rval.mEntry = flatBegin() + idx;
+      if(idx < size &&
+         name != rval.mEntry->name && strcmp(name, rval.mEntry->name) != 0)
+      {
+         // not found
+         rval.mEntry = flatBegin() + size;
+      }
+   }
+   else
+   {
+      rval.mTree = true;
+      rval.mTreeIterator = mTree->find(name);
+   }
+
+   return rval;
+}
+
+DynamicObjectMap::iterator DynamicObjectMap::findInterned(const char* name)
+{
+   iterator rval;
+
+   if(mTree == NULL)
+   {
+      // names in the same table are equal only if their pointers are, but
+      // the table may have been full when a name was added
+      Entry* end = flatBegin() + mFlat.size();
+      for(rval.mEntry = flatBegin();
+          rval.mEntry != end && rval.mEntry->name != name; ++rval.mEntry);
+      if(rval.mEntry == end)
+      {
+         rval = find(name);
+      }
+   }
+   else
+   {
+      rval = find(name);
+   }
+
+   return rval;
+}
+
+DynamicObjectMap::iterator DynamicObjectMap::lowerBound(const char* name)
+{
+   iterator rval;
+
+   if(mTree == NULL)
+   {
+      rval.mEntry = flatBegin() + flatLowerBound(name);
+   }
+   else
+   {
+      rval.mTree = true;
+      rval.mTreeIterator = mTree->lower_bound(name);
+   }
+
+   return rval;
+}
+
+int DynamicObjectMap::count(const char* name)
+{
+   return (find(name) == end()) ? 0 : 1;
+}
+
+DynamicObjectMap::iterator DynamicObjectMap::insert(
+   const char* name, const DynamicObject& value)
+{
+   iterator rval;
+
+   ++mVersion;
+   DynamicObject* v = createValue(value);
+
+   if(mTree == NULL && (int)mFlat.size() >= sFlatMapMaxSize)
+   {
+      // flat map is full
+      promote();
+   }
+
+   if(mTree == NULL)
+   {
+      // members are often inserted in order (ie: when copying), so check
+      // the end first
+      Entry e = { name, v };
+      MemberComparator less;
+      int idx = (mFlat.empty() || less(mFlat.back().name, name)) ?
+         mFlat.size() : flatLowerBound(name);
+      if(mFlat.capacity() == 0)
+      {
+         mFlat.reserve(4);
+      }
+      mFlat.insert(mFlat.begin() + idx, e);
+      rval.mEntry = flatBegin() + idx;
+   }
+   else
+   {
+      rval.mTree = true;
+      rval.mTreeIterator = mTree->insert(make_pair(name, v)).first;
+   }
+
+   return rval;
+}
+
+DynamicObjectMap::iterator DynamicObjectMap::erase(iterator i)
+{
+   iterator rval;
+
+   ++mVersion;
+   if(mTree == NULL)
+   {
+      int idx = i.mEntry - flatBegin();
+      freeValue(i.mEntry->value);
+      mFlat.erase(mFlat.begin() + idx);
+      rval.mEntry = flatBegin() + idx;
+   }
+   else
+   {
+      rval = i;
+      ++rval;
+      freeValue(i.mTreeIterator->second);
+      mTree->erase(i.mTreeIterator);
+   }
+
+   return rval;
+}
+
+void DynamicObjectMap::clear()
+{
+   ++mVersion;
+   if(mTree == NULL)
+   {
+      for(FlatMap::iterator i = mFlat.begin(); i != mFlat.end(); ++i)
+      {
+         freeValue(i->value);
+      }
+      mFlat.clear();
+   }
+   else
+   {
+      for(TreeMap::iterator i = mTree->begin(); i != mTree->end(); ++i)
+      {
+         freeValue(i->second);
+      }
+      delete mTree;
+      mTree = NULL;
+   }
+}
+
+int DynamicObjectMap::size()
+{
+   return (mTree == NULL) ? mFlat.size() : mTree->size();
+}
+
+unsigned int DynamicObjectMap::getVersion()
+{
+   return mVersion;
+}
+
+int DynamicObjectMap::setFlatMapMaxSize(int size)
+{
+   int rval = sFlatMapMaxSize;
+   sFlatMapMaxSize = size;
+   return rval;
+}
+
+int DynamicObjectMap::flatLowerBound(const char* name)
+{
+   // binary search for the first entry that is not less than name
+   MemberComparator less;
+   int low = 0;
+   int high = mFlat.size();
+   while(low < high)
+   {
+      int mid = (low + high) / 2;
+      if(less(mFlat[mid].name, name))
+      {
+         low = mid + 1;
+      }
+      else
+      {
+         high = mid;
+      }
+   }
+   return low;
+}
+
+void DynamicObjectMap::promote()
+{
+   // entries are already sorted, so each one can be appended to the tree
+   mTree = new TreeMap();
+   for(FlatMap::iterator i = mFlat.begin(); i != mFlat.end(); ++i)
+   {
+      mTree->insert(mTree->end(), make_pair(i->name, i->value));
+   }
+
+   // release flat map memory
+   FlatMap empty;
+   mFlat.swap(empty);
+}
+
+DynamicObject* DynamicObjectMap::createValue(const DynamicObject& value)
+{
+   // values use the same allocator as DynamicObjectImpls
+   void* ptr = DynamicObjectImpl::allocate(sizeof(DynamicObject));
+   return new (ptr) DynamicObject(value);
+}
+
+void DynamicObjectMap::freeValue(DynamicObject* value)
+{
+   value->~DynamicObject();
+   DynamicObjectImpl::deallocate(value, sizeof(DynamicObject));
+}
@@ -0,0 +1,400 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#ifndef monarch_rt_DynamicObjectMap_H
+#define monarch_rt_DynamicObjectMap_H
+
+#include <map>
+#include <vector>
+#include <cstring>
+
+namespace monarch
+{
+namespace rt
+{
+
+// forward declare DynamicObject
+class DynamicObject;
+
+/**
+ * A DynamicObjectMap stores the members of a Map DynamicObject, sorted by
+ * member name.
+ *
+ * Most maps only have a few members, so a map starts out as a flat, sorted
+ * array of name/value pairs which is compact and cheap to search and
+ * iterate. Once it grows past a threshold, the map is promoted to a tree.
+ *
+ * Every member value is allocated separately and never moves, so references
+ * to values remain valid until their members are removed, just like they do
+ * in a std::map. Iterators, however, are invalidated by any insertion or
+ * removal, except for the iterator returned from erase(). getVersion() can
+ * be used to detect such changes.
+ *
+ * A DynamicObjectMap does not own its member names.
+ */
+class DynamicObjectMap
+{
+public:
+   /**
+    * A MemberComparator compares two member names.
+    */
+   struct MemberComparator
+   {
+      /**
+       * Compares two null-terminated strings, returning true if the first is
+       * less than the second, false if not. The compare is case-sensitive.
+       *
+       * Member names are interned, so identical pointers are checked first.
+       *
+       * @param s1 the first string.
+       * @param s2 the second string.
+       *
+       * @return true if the s1 < s2, false if not.
+       */
+      bool operator()(const char* s1, const char* s2) const
+      {
+         return s1 != s2 && strcmp(s1, s2) < 0;
+      }
+   };
+
+protected:
+   /**
+    * An entry in a flat map.
+    */
+   struct Entry
+   {
+      const char* name;
+      DynamicObject* value;
+   };
+
+   /**
+    * The flat and tree representations.
+    */
+   typedef std::vector<Entry> FlatMap;
+   typedef std::map<const char*, DynamicObject*, MemberComparator> TreeMap;
+
+   /**
+    * The flat map, used while mTree is NULL.
+    */
+   FlatMap mFlat;
+
+   /**
+    * The tree map, NULL until this map has been promoted.
+    */
+   TreeMap* mTree;
+
+   /**
+    * Incremented whenever a member is inserted or removed.
+    */
+   unsigned int mVersion;
+
+   /**
+    * The maximum number of members in a flat map.
+    */
+   static int sFlatMapMaxSize;
+
+public:
+   /**
+    * An iterator over the members of a DynamicObjectMap.
+    */
+   class iterator
+   {
+   friend class DynamicObjectMap;
+   protected:
+      /**
+       * The current entry for a flat map, NULL for a tree map.
+       */
+      Entry* mEntry;
+
+      /**
+       * The current position in a tree map.
+       */
+      TreeMap::iterator mTreeIterator;
+
+      /**
+       * True if iterating over a tree map.
+       */
+      bool mTree;
+
+   public:
+      /**
+       * Creates a new, invalid iterator.
+       */
+      iterator() :
+         mEntry(NULL),
+         mTree(false)
+      {
+      };
+
+      /**
+       * Gets the name of the current member.
+       *
+       * @return the name of the current member.
+       */
+      const char* getName() const
+      {
+         return mTree ? mTreeIterator->first : mEntry->name;
+      };
+
+      /**
+       * Gets the value of the current member.
+       *
+       * @return the value of the current member.
+       */
+      DynamicObject& getValue() const
+      {
+         return mTree ? *mTreeIterator->second : *mEntry->value;
+      };
+
+      /**
+       * Moves to the next member.
+       *
+       * @return this iterator.
+       */
+      iterator& operator++()
+      {
+         if(mTree)
+         {
+            ++mTreeIterator;
+         }
+         else
+         {
+            ++mEntry;
+         }
+         return *this;
+      };
+
+      /**
+       * Moves to the previous member.
+       *
+       * @return this iterator.
+       */
+      iterator& operator--()
+      {
+         if(mTree)
+         {
+            --mTreeIterator;
+         }
+         else
+         {
+            --mEntry;
+         }
+         return *this;
+      };
+
+      /**
+       * Compares this iterator to another one for equality.
+       *
+       * @param rhs the iterator to compare against.
+       *
+       * @return true if both iterators are at the same position.
+       */
+      bool operator==(const iterator& rhs) const
+      {
+         return mTree ?
+            (rhs.mTree && mTreeIterator == rhs.mTreeIterator) :
+            (!rhs.mTree && mEntry == rhs.mEntry);
+      };
+
+      /**
+       * Compares this iterator to another one for inequality.
+       *
+       * @param rhs the iterator to compare against.
+       *
+       * @return true if the iterators are at different positions.
+       */
+      bool operator!=(const iterator& rhs) const
+      {
+         return !(*this == rhs);
+      };
+   };
+
+   /**
+    * Creates a new, empty DynamicObjectMap.
+    */
+   DynamicObjectMap();
+
+   /**
+    * Destructs this DynamicObjectMap, freeing all member values. Member
+    * names are not freed.
+    */
+   virtual ~DynamicObjectMap();
+
+   /**
+    * Gets an iterator at the first member.
+    *
+    * @return an iterator at the first member.
+    */
+   iterator begin()
+   {
+      iterator rval;
+      if(mTree == NULL)
+      {
+         rval.mEntry = flatBegin();
+      }
+      else
+      {
+         rval.mTree = true;
+         rval.mTreeIterator = mTree->begin();
+      }
+      return rval;
+   };
+
+   /**
+    * Gets an iterator past the last member.
+    *
+    * @return an iterator past the last member.
+    */
+   iterator end()
+   {
+      iterator rval;
+      if(mTree == NULL)
+      {
+         rval.mEntry = flatBegin() + mFlat.size();
+      }
+      else
+      {
+         rval.mTree = true;
+         rval.mTreeIterator = mTree->end();
+      }
+      return rval;
+   };
+
+   /**
+    * Finds the member with the given name.
+    *
+    * @param name the name of the member to find.
+    *
+    * @return an iterator at the member or end() if it was not found.
+    */
+   virtual iterator find(const char* name);
+
+   /**
+    * Finds the member with the given interned name. In a flat map, member
+    * names are compared as pointers before falling back to find().
+    *
+    * @param name the name of the member to find, returned from
+    *           StringTable::intern() on the table used for member names.
+    *
+    * @return an iterator at the member or end() if it was not found.
+    */
+   virtual iterator findInterned(const char* name);
+
+   /**
+    * Gets an iterator at the first member with a name that is not less than
+    * the given one.
+    *
+    * @param name the name to look for.
+    *
+    * @return an iterator at the first member not less than name or end().
+    */
+   virtual iterator lowerBound(const char* name);
+
+   /**
+    * Returns the number of members with the given name (0 or 1).
+    *
+    * @param name the name of the member.
+    *
+    * @return 1 if the member exists, 0 if not.
+    */
+   virtual int count(const char* name);
+
+   /**
+    * Inserts a new member. There must not already be a member with the given
+    * name.
+    *
+    * @param name the name of the member, which must remain valid while the
+    *           member exists.
+    * @param value the value of the member.
+    *
+    * @return an iterator at the new member.
+    */
+   virtual iterator insert(const char* name, const DynamicObject& value);
+
+   /**
+    * Removes a member, freeing its value.
+    *
+    * @param i an iterator at the member to remove.
+    *
+    * @return an iterator at the member that followed the removed member.
+    */
+   virtual iterator erase(iterator i);
+
+   /**
+    * Removes all members, freeing their values.
+    */
+   virtual void clear();
+
+   /**
+    * Gets the number of members.
+    *
+    * @return the number of members.
+    */
+   virtual int size();
+
+   /**
+    * Gets the version of this map, which changes whenever a member is
+    * inserted or removed.
+    *
+    * @return the version of this map.
+    */
+   virtual unsigned int getVersion();
+
+   /**
+    * Sets the maximum number of members in a flat map. Maps that grow past
+    * this size are promoted to trees. A size of 0 disables flat maps. Flat
+    * maps that have already reached the new size are promoted when their
+    * next member is inserted.
+    *
+    * @param size the maximum number of members in a flat map (default 16).
+    *
+    * @return the previous maximum size.
+    */
+   static int setFlatMapMaxSize(int size);
+
+protected:
+   /**
+    * Gets the first entry of the flat map.
+    *
+    * @return the first entry of the flat map (NULL if empty).
+    */
+   Entry* flatBegin()
+   {
+      return mFlat.empty() ? NULL : &mFlat[0];
+   };
+
+   /**
+    * Gets the index of the first entry in the flat map with a name that
+    * is not less than the given one.
+    *
+    * @param name the name to look for.
+    *
+    * @return the index of the entry.
+    */
+   virtual int flatLowerBound(const char* name);
+
+   /**
+    * Moves all members from the flat map into a new tree map.
+    */
+   virtual void promote();
+
+   /**
+    * Allocates a new member value.
+    *
+    * @param value the value to copy.
+    *
+    * @return the new value.
+    */
+   static DynamicObject* createValue(const DynamicObject& value);
+
+   /**
+    * Frees a member value.
+    *
+    * @param value the value to free.
+    */
+   static void freeValue(DynamicObject* value);
+};
+
+} // end namespace rt
+} // end namespace monarch
+#endif
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#include "monarch/rt/DynamicObjectPath.h"
+
+#include "monarch/rt/Exception.h"
+#include "monarch/rt/StringTable.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+using namespace std;
+using namespace monarch::rt;
+
+#define EXCEPTION_PATH "monarch.rt.DynamicObjectPath"
+
+/**
+ * Parses an array index from a JSON Pointer segment. Leading zeros are not
+ * allowed, so each index has only one spelling.
+ *
+ * @param str the unescaped segment.
+ *
+ * @return the index, -1 if the segment is not an index.
+ */
+static int _parseIndex(const string& str)
+{
+   int rval = -1;
+
+   if(!str.empty() && str.length() <= 9 &&
+      (str[0] != '0' || str.length() == 1) &&
+      str.find_first_not_of("0123456789") == string::npos)
+   {
+      rval = atoi(str.c_str());
+   }
+
+   return rval;
+}
+
+DynamicObjectPath::DynamicObjectPath(const char* path) :
+   mPath(NULL),
+   mValid(false)
+{
+   setPath(path);
+}
+
+DynamicObjectPath::DynamicObjectPath(const DynamicObjectPath& copy) :
+   mPath(NULL),
+   mValid(false)
+{
+   *this = copy;
+}
+
+DynamicObjectPath::~DynamicObjectPath()
+{
+   clearSegments();
+   free(mPath);
+}
+
+DynamicObjectPath& DynamicObjectPath::operator=(const DynamicObjectPath& rhs)
+{
+   if(this != &rhs)
+   {
+      clearSegments();
+      free(mPath);
+      mPath = strdup(rhs.mPath);
+      mValid = rhs.mValid;
+      for(vector<Segment>::const_iterator i = rhs.mSegments.begin();
+          i != rhs.mSegments.end(); ++i)
+      {
+         Segment s = *i;
+         s.name = DynamicObjectImpl::internKey(i->name);
+         mSegments.push_back(s);
+      }
+   }
+   return *this;
+}
+
+bool DynamicObjectPath::setPath(const char* path)
+{
+   if(path == NULL)
+   {
+      path = "";
+   }
+
+   clearSegments();
+   free(mPath);
+   mPath = strdup(path);
+
+   // the leading slash is optional
+   const char* p = path;
+   if(*p == '/')
+   {
+      ++p;
+   }
+
+   mValid = true;
+   if(*path != 0)
+   {
+      string name;
+      for(; mValid; ++p)
+      {
+         if(*p == '/' || *p == 0)
+         {
+            Segment s;
+            s.name = DynamicObjectImpl::internKey(name.c_str());
+            s.index = _parseIndex(name);
+            mSegments.push_back(s);
+            name.clear();
+            if(*p == 0)
+            {
+               break;
+            }
+         }
+         else if(*p == '~')
+         {
+            // only "~0" and "~1" are valid escapes
+            ++p;
+            if(*p == '0')
+            {
+               name.push_back('~');
+            }
+            else if(*p == '1')
+            {
+               name.push_back('/');
+            }
+            else
+            {
+               mValid = false;
+            }
+         }
+         else
+         {
+            name.push_back(*p);
+         }
+      }
+   }
+
+   if(!mValid)
+   {
+      clearSegments();
+      ExceptionRef e = new Exception(
+         "Invalid DynamicObject path. A '~' must be followed by '0' or '1'.",
+         EXCEPTION_PATH ".InvalidPath");
+      e->getDetails()["path"] = path;
+      Exception::set(e);
+   }
+
+   return mValid;
+}
+
+const char* DynamicObjectPath::getPath() const
+{
+   return mPath;
+}
+
+bool DynamicObjectPath::isValid() const
+{
+   return mValid;
+}
+
+const vector<DynamicObjectPath::Segment>&
+   DynamicObjectPath::getSegments() const
+{
+   return mSegments;
+}
+
+DynamicObject* DynamicObjectPath::find(const DynamicObject& root) const
+{
+   DynamicObject* rval = NULL;
+
+   if(mValid && !root.isNull())
+   {
+      rval = const_cast<DynamicObject*>(&root);
+      for(vector<Segment>::const_iterator i = mSegments.begin();
+          rval != NULL && i != mSegments.end(); ++i)
+      {
+         rval = step(rval, *i);
+      }
+   }
+
+   return rval;
+}
+
+DynamicObject DynamicObjectPath::get(const DynamicObject& root) const
+{
+   DynamicObject* value = find(root);
+   return (value == NULL) ? DynamicObject(NULL) : *value;
+}
+
+bool DynamicObjectPath::has(const DynamicObject& root) const
+{
+   return find(root) != NULL;
+}
+
+void DynamicObjectPath::clearSegments()
+{
+   for(vector<Segment>::iterator i = mSegments.begin();
+       i != mSegments.end(); ++i)
+   {
+      StringTable::release(i->name);
+   }
+   mSegments.clear();
+}
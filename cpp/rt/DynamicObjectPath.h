@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#ifndef monarch_rt_DynamicObjectPath_H
+#define monarch_rt_DynamicObjectPath_H
+
+#include "monarch/rt/DynamicObject.h"
+
+#include <vector>
+
+namespace monarch
+{
+namespace rt
+{
+
+/**
+ * A DynamicObjectPath is a compiled path to a value deep inside a
+ * DynamicObject. It is written as a JSON Pointer (RFC 6901), such as
+ * "/node/modules/x/threads", where "~1" stands for "/" and "~0" for "~" in a
+ * member name. The leading "/" may be left off.
+ *
+ * The path is split once when it is set and its member names are interned
+ * with the keys of all Maps, so resolving it usually only compares pointers
+ * at each level. Unlike a chain of operator[] calls, resolving a path never
+ * creates members or elements that do not exist.
+ *
+ * A DynamicObjectPath may be resolved by many threads at once.
+ */
+class DynamicObjectPath
+{
+public:
+   /**
+    * A step along a path.
+    */
+   struct Segment
+   {
+      /**
+       * The interned member name.
+       */
+      const char* name;
+
+      /**
+       * The array index the name stands for, -1 if it is not an index.
+       */
+      int index;
+   };
+
+protected:
+   /**
+    * The path as it was given.
+    */
+   char* mPath;
+
+   /**
+    * The steps along the path.
+    */
+   std::vector<Segment> mSegments;
+
+   /**
+    * True if the path is a valid JSON Pointer.
+    */
+   bool mValid;
+
+public:
+   /**
+    * Creates a new DynamicObjectPath. An empty path refers to the object it
+    * is resolved against.
+    *
+    * @param path the path, as a JSON Pointer, NULL for an empty path.
+    */
+   DynamicObjectPath(const char* path = "");
+
+   /**
+    * Creates a copy of a DynamicObjectPath.
+    *
+    * @param copy the DynamicObjectPath to copy.
+    */
+   DynamicObjectPath(const DynamicObjectPath& copy);
+
+   /**
+    * Destructs this DynamicObjectPath.
+    */
+   virtual ~DynamicObjectPath();
+
+   /**
+    * Sets this DynamicObjectPath to a copy of another one.
+    *
+    * @param rhs the DynamicObjectPath to copy.
+    *
+    * @return this DynamicObjectPath.
+    */
+   DynamicObjectPath& operator=(const DynamicObjectPath& rhs);
+
+   /**
+    * Sets the path. If the path is invalid, an exception is set and the path
+    * will not resolve against any object.
+    *
+    * @param path the path, as a JSON Pointer, NULL for an empty path.
+    *
+    * @return true if the path is valid, false if not.
+    */
+   virtual bool setPath(const char* path);
+
+   /**
+    * Gets the path as it was given.
+    *
+    * @return the path.
+    */
+   virtual const char* getPath() const;
+
+   /**
+    * Returns true if the path is a valid JSON Pointer.
+    *
+    * @return true if the path is valid, false if not.
+    */
+   virtual bool isValid() const;
+
+   /**
+    * Gets the steps along the path.
+    *
+    * @return the steps along the path.
+    */
+   virtual const std::vector<Segment>& getSegments() const;
+
+   /**
+    * Finds the value this path refers to in the given object. Nothing is
+    * created if the value does not exist.
+    *
+    * @param root the object to resolve this path against.
+    *
+    * @return the value, NULL if it does not exist.
+    */
+   virtual DynamicObject* find(const DynamicObject& root) const;
+
+   /**
+    * Gets the value this path refers to in the given object. Nothing is
+    * created if the value does not exist.
+    *
+    * @param root the object to resolve this path against.
+    *
+    * @return the value, a NULL DynamicObject if it does not exist.
+    */
+   virtual DynamicObject get(const DynamicObject& root) const;
+
+   /**
+    * Returns true if the value this path refers to exists in the given
+    * object.
+    *
+    * @param root the object to resolve this path against.
+    *
+    * @return true if the value exists, false if not.
+    */
+   virtual bool has(const DynamicObject& root) const;
+
+   /**
+    * Finds the value a step along a path refers to in the given object.
+    *
+    * @param dyno the object to look in, may be NULL.
+    * @param segment the step to take.
+    *
+    * @return the value, NULL if it does not exist.
+    */
+   static DynamicObject* step(
+      const DynamicObject* dyno, const Segment& segment)
+   {
+      DynamicObject* rval = NULL;
+      if(dyno != NULL && !dyno->isNull())
+      {
+         const DynamicObjectImpl& impl = **dyno;
+         switch(impl.getType())
+         {
+            case Map:
+               rval = impl.findMember(segment.name, true);
+               break;
+            case Array:
+               if(segment.index >= 0)
+               {
+                  rval = impl.findElement(segment.index);
+               }
+               break;
+            default:
+               break;
+         }
+      }
+      return rval;
+   };
+
+protected:
+   /**
+    * Releases the segments of this path.
+    */
+   virtual void clearSegments();
+};
+
+} // end namespace rt
+} // end namespace monarch
+#endif
@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#include "monarch/rt/DynamicObjectPathSet.h"
+
+#include "monarch/rt/StringTable.h"
+
+#include <cstring>
+
+using namespace std;
+using namespace monarch::rt;
+
+DynamicObjectPathSet::DynamicObjectPathSet()
+{
+   mRoot.segment.name = NULL;
+   mRoot.segment.index = -1;
+   mRoot.path = -1;
+}
+
+DynamicObjectPathSet::~DynamicObjectPathSet()
+{
+   freeChildren(&mRoot);
+   for(vector<DynamicObjectPath*>::iterator i = mPaths.begin();
+       i != mPaths.end(); ++i)
+   {
+      delete *i;
+   }
+}
+
+int DynamicObjectPathSet::add(const char* path)
+{
+   int rval = -1;
+
+   DynamicObjectPath* p = new DynamicObjectPath(path);
+   if(!p->isValid())
+   {
+      delete p;
+   }
+   else
+   {
+      // follow or grow the tree of paths
+      Node* node = &mRoot;
+      const vector<DynamicObjectPath::Segment>& segments = p->getSegments();
+      for(vector<DynamicObjectPath::Segment>::const_iterator si =
+          segments.begin(); si != segments.end(); ++si)
+      {
+         Node* next = NULL;
+         for(vector<Node*>::iterator ci = node->children.begin();
+             next == NULL && ci != node->children.end(); ++ci)
+         {
+            // names are interned, but may be copies if the table was full
+            const char* name = (*ci)->segment.name;
+            if(name == si->name || strcmp(name, si->name) == 0)
+            {
+               next = *ci;
+            }
+         }
+         if(next == NULL)
+         {
+            next = new Node;
+            next->segment = *si;
+            next->segment.name = DynamicObjectImpl::internKey(si->name);
+            next->path = -1;
+            node->children.push_back(next);
+         }
+         node = next;
+      }
+
+      if(node->path != -1)
+      {
+         // path already added
+         rval = node->path;
+         delete p;
+      }
+      else
+      {
+         rval = node->path = mPaths.size();
+         mPaths.push_back(p);
+      }
+   }
+
+   return rval;
+}
+
+int DynamicObjectPathSet::getCount() const
+{
+   return mPaths.size();
+}
+
+const DynamicObjectPath& DynamicObjectPathSet::getPath(int index) const
+{
+   return *mPaths[index];
+}
+
+int DynamicObjectPathSet::find(
+   const DynamicObject& root, DynamicObject** values) const
+{
+   for(int i = 0; i < (int)mPaths.size(); ++i)
+   {
+      values[i] = NULL;
+   }
+   return root.isNull() ?
+      0 : find(&mRoot, const_cast<DynamicObject*>(&root), values);
+}
+
+int DynamicObjectPathSet::get(
+   const DynamicObject& root, DynamicObject& values) const
+{
+   int count = mPaths.size();
+   DynamicObject** found = new DynamicObject*[count];
+   int rval = find(root, found);
+
+   values = DynamicObject();
+   values->setType(Array);
+   for(int i = 0; i < count; ++i)
+   {
+      DynamicObject& value = values->append();
+      value = (found[i] == NULL) ? DynamicObject(NULL) : *found[i];
+   }
+   delete [] found;
+
+   return rval;
+}
+
+int DynamicObjectPathSet::find(
+   const Node* node, DynamicObject* dyno, DynamicObject** values) const
+{
+   int rval = 0;
+
+   if(node->path != -1)
+   {
+      values[node->path] = dyno;
+      ++rval;
+   }
+
+   for(vector<Node*>::const_iterator i = node->children.begin();
+       i != node->children.end(); ++i)
+   {
+      DynamicObject* next = DynamicObjectPath::step(dyno, (*i)->segment);
+      if(next != NULL)
+      {
+         rval += find(*i, next, values);
+      }
+   }
+
+   return rval;
+}
+
+void DynamicObjectPathSet::freeChildren(Node* node)
+{
+   for(vector<Node*>::iterator i = node->children.begin();
+       i != node->children.end(); ++i)
+   {
+      freeChildren(*i);
+      StringTable::release((*i)->segment.name);
+      delete *i;
+   }
+   node->children.clear();
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#ifndef monarch_rt_DynamicObjectPathSet_H
+#define monarch_rt_DynamicObjectPathSet_H
+
+#include "monarch/rt/DynamicObjectPath.h"
+
+namespace monarch
+{
+namespace rt
+{
+
+/**
+ * A DynamicObjectPathSet gets the values of many DynamicObjectPaths from the
+ * same object in a single walk. The paths are merged into a tree so that
+ * steps shared by several paths, such as "/node/modules" in
+ * "/node/modules/x/threads" and "/node/modules/y/threads", are only taken
+ * once.
+ *
+ * Paths may not be added while the set is being resolved, but a set may be
+ * resolved by many threads at once.
+ */
+class DynamicObjectPathSet
+{
+protected:
+   /**
+    * A step in the tree of paths.
+    */
+   struct Node
+   {
+      /**
+       * The step to take from the parent node.
+       */
+      DynamicObjectPath::Segment segment;
+
+      /**
+       * The index of the path that ends at this node, -1 for none.
+       */
+      int path;
+
+      /**
+       * The steps that follow this one.
+       */
+      std::vector<Node*> children;
+   };
+
+   /**
+    * The root of the tree of paths.
+    */
+   Node mRoot;
+
+   /**
+    * The paths in the order they were added.
+    */
+   std::vector<DynamicObjectPath*> mPaths;
+
+public:
+   /**
+    * Creates a new, empty DynamicObjectPathSet.
+    */
+   DynamicObjectPathSet();
+
+   /**
+    * Destructs this DynamicObjectPathSet.
+    */
+   virtual ~DynamicObjectPathSet();
+
+   /**
+    * Adds a path to this set. Adding the same path again returns the index
+    * it was first added at.
+    *
+    * @param path the path, as a JSON Pointer.
+    *
+    * @return the index of the path, -1 if it is invalid (an exception is
+    *         set).
+    */
+   virtual int add(const char* path);
+
+   /**
+    * Gets the number of paths in this set.
+    *
+    * @return the number of paths.
+    */
+   virtual int getCount() const;
+
+   /**
+    * Gets a path in this set.
+    *
+    * @param index the index of the path.
+    *
+    * @return the path.
+    */
+   virtual const DynamicObjectPath& getPath(int index) const;
+
+   /**
+    * Finds the values of all the paths in this set in the given object.
+    * Nothing is created in the object.
+    *
+    * @param root the object to resolve the paths against.
+    * @param values an array of getCount() pointers set to the value of each
+    *           path, NULL if it does not exist.
+    *
+    * @return the number of values that exist.
+    */
+   virtual int find(const DynamicObject& root, DynamicObject** values) const;
+
+   /**
+    * Gets the values of all the paths in this set in the given object.
+    * Nothing is created in the object.
+    *
+    * @param root the object to resolve the paths against.
+    * @param values set to an Array with the value of each path, in the order
+    *           they were added, with NULL DynamicObjects for values that do
+    *           not exist.
+    *
+    * @return the number of values that exist.
+    */
+   virtual int get(const DynamicObject& root, DynamicObject& values) const;
+
+protected:
+   /**
+    * Finds the values of the paths that continue from the given node.
+    *
+    * @param node the node.
+    * @param dyno the value at the node.
+    * @param values the values of the paths.
+    *
+    * @return the number of values that exist.
+    */
+   virtual int find(
+      const Node* node, DynamicObject* dyno, DynamicObject** values) const;
+
+   /**
+    * Frees the nodes that follow the given node.
+    *
+    * @param node the node.
+    */
+   virtual void freeChildren(Node* node);
+};
+
+} // end namespace rt
+} // end namespace monarch
+#endif
@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#include "monarch/rt/EpochList.h"
+
+using namespace monarch::rt;
+
+EpochList::EpochList() :
+   mEpoch(1),
+   mOldest(1),
+   mHead(NULL)
+{
+}
+
+EpochList::~EpochList()
+{
+   // clean up all records
+   EpochRecord* head = mHead;
+   while(head != NULL)
+   {
+      EpochRecord* tmp = head;
+      head = head->next;
+      Atomic::freeAligned(tmp);
+   }
+}
+
+EpochRecord* EpochList::acquire()
+{
+   EpochRecord* rval = NULL;
+
+   // find a record that is inactive and enter the current epoch with it,
+   // the compare-and-swap makes the record visible before anything is read
+   uint64_t epoch = mEpoch;
+   EpochRecord* record = mHead;
+   while(rval == NULL && record != NULL)
+   {
+      if(record->epoch == 0 &&
+         Atomic::compareAndSwap(&record->epoch, (uint64_t)0, epoch))
+      {
+         // successfully acquired
+         rval = record;
+      }
+      else
+      {
+         // try the next record
+         record = record->next;
+      }
+   }
+
+   // no inactive record found, create a new one
+   if(rval == NULL)
+   {
+      rval = static_cast<EpochRecord*>(
+         Atomic::mallocAligned(sizeof(EpochRecord)));
+      rval->epoch = epoch;
+
+      // atomically push the record onto the head of the list
+      EpochRecord* old;
+      do
+      {
+         old = mHead;
+         rval->next = old;
+      }
+      while(!Atomic::compareAndSwap(&mHead, old, rval));
+   }
+
+   // if the epoch changed before the record was visible then memory retired
+   // in the meantime may not be seen as protected by it, so enter the new
+   // epoch, this only happens when the epoch advances
+   while(epoch != mEpoch)
+   {
+      epoch = mEpoch;
+      rval->epoch = epoch;
+      Atomic::memoryBarrier();
+   }
+
+   return rval;
+}
+
+void EpochList::release(EpochRecord* record)
+{
+   // finish all reads before leaving the epoch
+   Atomic::memoryBarrier();
+   record->epoch = 0;
+}
+
+uint64_t EpochList::retire()
+{
+   // scan the records once per retired memory so that checking whether
+   // memory is protected does not have to
+   getOldestEpoch();
+
+   // the memory has already been unlinked, so operations that enter a newer
+   // epoch cannot reach it
+   Atomic::memoryBarrier();
+   return mEpoch;
+}
+
+bool EpochList::isProtected(void* addr, uint64_t stamp)
+{
+   return stamp >= mOldest;
+}
+
+uint64_t EpochList::getOldestEpoch()
+{
+   // records that become active during the scan cannot reach memory that
+   // was retired before it, so they may be skipped
+   uint64_t epoch = mEpoch;
+   Atomic::memoryBarrier();
+   uint64_t rval = epoch + 1;
+   for(EpochRecord* record = mHead; record != NULL; record = record->next)
+   {
+      uint64_t e = record->epoch;
+      if(e != 0 && e < rval)
+      {
+         rval = e;
+      }
+   }
+
+   // if no active record is behind the current epoch, advance the epoch so
+   // that memory retired in it can be freed once its records are released
+   if(rval >= epoch)
+   {
+      Atomic::compareAndSwap(&mEpoch, epoch, epoch + 1);
+   }
+
+   // cache the oldest epoch, it only increases
+   uint64_t oldest;
+   do
+   {
+      oldest = mOldest;
+   }
+   while(rval > oldest && !Atomic::compareAndSwap(&mOldest, oldest, rval));
+
+   return rval;
+}
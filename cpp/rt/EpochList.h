@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#ifndef monarch_rt_EpochList_H
+#define monarch_rt_EpochList_H
+
+#include "monarch/rt/Atomic.h"
+
+#include <inttypes.h>
+
+namespace monarch
+{
+namespace rt
+{
+
+/**
+ * An EpochRecord marks a thread as being inside of a guarded operation
+ * since a given epoch. A record with an epoch of 0 is inactive.
+ */
+struct EpochRecord
+{
+   volatile uint64_t epoch;
+   EpochRecord* next;
+   char padding[64 - sizeof(uint64_t) - sizeof(void*)];
+};
+
+/**
+ * An EpochList protects memory from being freed while it is still in use
+ * using epoch-based reclamation. It can be used by a HashTable in place of
+ * a HazardPtrList.
+ *
+ * The list keeps a global epoch counter. A thread starts an operation by
+ * acquiring an EpochRecord, which marks it as active in the current epoch.
+ * Everything it reads during the operation is protected without any further
+ * work, protect() is only a plain read. When memory is unlinked from a
+ * shared structure it is retired, which stamps it with the current epoch.
+ * The memory may be freed as soon as no active record has an epoch that is
+ * not newer than its stamp.
+ *
+ * Each time memory is retired the records are scanned once to find the
+ * oldest active epoch. If no active record is behind the current epoch, the
+ * epoch advances. Checking whether memory is protected only compares its
+ * stamp with the oldest epoch found by the last scan, so it never has to
+ * walk the records.
+ *
+ * Compared to hazard pointers, guarded operations are cheaper because
+ * pointers do not have to be protected one at a time and validated, and
+ * there is one scan per retired object instead of one per check. The
+ * downside is that a single slow operation delays freeing any memory
+ * retired after it started, and memory is only found to be free once more
+ * memory has been retired.
+ */
+class EpochList
+{
+public:
+   /**
+    * The type used to guard an operation.
+    */
+   typedef EpochRecord Guard;
+
+protected:
+   /**
+    * The global epoch.
+    */
+   volatile uint64_t mEpoch;
+
+   /**
+    * The oldest epoch that an active record had the last time the records
+    * were scanned. It only increases.
+    */
+   volatile uint64_t mOldest;
+
+   /**
+    * The head of the list of records.
+    */
+   EpochRecord* volatile mHead;
+
+public:
+   /**
+    * Creates a new, empty EpochList.
+    */
+   EpochList();
+
+   /**
+    * Destructs this EpochList.
+    */
+   ~EpochList();
+
+   /**
+    * Acquires a record and marks it active in the current epoch, guarding
+    * the memory that is read until it is released.
+    *
+    * @return the record to use.
+    */
+   EpochRecord* acquire();
+
+   /**
+    * Releases a record, ending its guarded operation.
+    *
+    * @param record the record to release.
+    */
+   void release(EpochRecord* record);
+
+   /**
+    * Reads a pointer. The memory it points to is protected until the record
+    * is released.
+    *
+    * @param record the record guarding the operation.
+    * @param src the address of the pointer to read.
+    *
+    * @return the pointer.
+    */
+   inline void* protect(EpochRecord* record, void* volatile* src)
+   {
+      return *src;
+   };
+
+   /**
+    * Does nothing, memory stays protected until the record is released.
+    *
+    * @param record the record guarding the operation.
+    */
+   inline void unprotect(EpochRecord* record)
+   {
+   };
+
+   /**
+    * Stamps memory that has just been unlinked with the current epoch,
+    * advancing the epoch if possible.
+    *
+    * @return the stamp for the memory.
+    */
+   uint64_t retire();
+
+   /**
+    * Checks whether retired memory may still be in use by an operation that
+    * started before it was retired, as of the last call to retire().
+    *
+    * @param addr the address of the memory, unused.
+    * @param stamp the stamp from retire().
+    *
+    * @return true if the memory is protected, false if it may be freed.
+    */
+   bool isProtected(void* addr, uint64_t stamp);
+
+   /**
+    * Gets the oldest epoch of any active record, advancing the current epoch
+    * if no active record is behind it.
+    *
+    * @return the oldest active epoch, the next epoch if no record is active.
+    */
+   uint64_t getOldestEpoch();
+};
+
+} // end namespace rt
+} // end namespace monarch
+#endif
@@ -5,31 +5,67 @@
 
 #include "monarch/rt/Thread.h"
 #include "monarch/rt/DynamicObject.h"
+#include "monarch/rt/MemoryPool.h"
 
 #include <cstdlib>
 
 using namespace monarch::rt;
 
-Exception::Exception(const char* message, const char* type)
+// the number of free Exceptions to keep per thread
+#define EXCEPTION_POOL_SIZE 64
+
+// the pool for Exception memory, never freed, exceptions may be collected
+// during static destruction
+static MemoryPool* _exception_pool;
+static pthread_once_t _exception_pool_once = PTHREAD_ONCE_INIT;
+static bool _exception_pooling_enabled = true;
+
+static void _initExceptionPool()
 {
-   mMessage = (message == NULL) ? NULL : strdup(message);
-   mType = (type == NULL) ? NULL : strdup(type);
-   mCause = new ExceptionRef(NULL);
-   mDetails = new DynamicObject(NULL);
+   _exception_pool = new MemoryPool(sizeof(Exception), EXCEPTION_POOL_SIZE);
+}
+
+Exception::Exception(const char* message, const char* type) :
+   mMessage((message == NULL) ? NULL : strdup(message)),
+   mType((type == NULL) ? NULL : strdup(type)),
+   mOwnMessage(true),
+   mOwnType(true),
+   mCause(NULL),
+   mDetails(NULL)
+{
+}
+
+Exception::Exception(
+   const char* message, const char* type, StringStorage storage) :
+   mOwnMessage(storage == CopyStrings),
+   mOwnType(storage == CopyStrings),
+   mCause(NULL),
+   mDetails(NULL)
+{
+   mMessage = (mOwnMessage && message != NULL) ? strdup(message) : message;
+   mType = (mOwnType && type != NULL) ? strdup(type) : type;
 }
 
 Exception::~Exception()
 {
-   free(mMessage);
-   free(mType);
-   delete mCause;
-   delete mDetails;
+   if(mOwnMessage)
+   {
+      free(const_cast<char*>(mMessage));
+   }
+   if(mOwnType)
+   {
+      free(const_cast<char*>(mType));
+   }
 }
 
 void Exception::setMessage(const char* message)
 {
-   free(mMessage);
+   if(mOwnMessage)
+   {
+      free(const_cast<char*>(mMessage));
+   }
    mMessage = (message == NULL) ? NULL : strdup(message);
+   mOwnMessage = true;
 }
 
 const char* Exception::getMessage()
@@ -39,8 +75,12 @@ const char* Exception::getMessage()
 
 void Exception::setType(const char* type)
 {
-   free(mType);
+   if(mOwnType)
+   {
+      free(const_cast<char*>(mType));
+   }
    mType = (type == NULL) ? NULL : strdup(type);
+   mOwnType = true;
 }
 
 const char* Exception::getType()
@@ -94,12 +134,12 @@ bool Exception::hasType(const char* type, bool startsWith, int n)
 
 void Exception::setCause(ExceptionRef& cause)
 {
-   *mCause = cause;
+   mCause = cause;
 }
 
 ExceptionRef& Exception::getCause()
 {
-   return *mCause;
+   return mCause;
 }
 
 bool Exception::hasCauseOfType(const char* type, bool startsWith, int n)
@@ -144,7 +184,7 @@ ExceptionRef Exception::getCauseOfType(const char* type, bool startsWith)
       if(startsWith)
       {
          // use optimized recursive method that only counts "type" length once
-         rval = _getCauseOfType(*mCause, type, strlen(type));
+         rval = _getCauseOfType(mCause, type, strlen(type));
       }
       else
       {
@@ -166,14 +206,15 @@ ExceptionRef Exception::getCauseOfType(const char* type, bool startsWith)
 
 DynamicObject& Exception::getDetails()
 {
-   if(mDetails->isNull())
+   // create details on first access
+   if(mDetails.isNull())
    {
       DynamicObject details;
       details->setType(Map);
-      *mDetails = details;
+      mDetails = details;
    }
 
-   return *mDetails;
+   return mDetails;
 }
 
 ExceptionRef& Exception::set(ExceptionRef& e)
@@ -247,7 +288,7 @@ DynamicObject Exception::convertToDynamicObject(ExceptionRef& e)
       dyno["cause"] = convertToDynamicObject(e->getCause());
    }
 
-   if(!(*e).mDetails->isNull())
+   if(!e->mDetails.isNull())
    {
       dyno["details"] = e->getDetails();
    }
@@ -269,8 +310,49 @@ ExceptionRef Exception::convertToException(DynamicObject& dyno)
 
    if(dyno->hasMember("details"))
    {
-      *(*rval).mDetails = dyno["details"].clone();
+      rval->mDetails = dyno["details"].clone();
    }
 
    return rval;
 }
+
+void* Exception::allocate(size_t size)
+{
+   void* rval;
+
+   // only blocks the size of an Exception are pooled, not those of
+   // subclasses or of embedded references
+   if(size == sizeof(Exception) && _exception_pooling_enabled)
+   {
+      pthread_once(&_exception_pool_once, &_initExceptionPool);
+      rval = _exception_pool->allocate();
+   }
+   else
+   {
+      rval = malloc(size);
+   }
+
+   return rval;
+}
+
+void Exception::deallocate(void* ptr, size_t size)
+{
+   // a block is released to the pool whenever the pool exists, even if
+   // pooling was disabled since it was allocated, pool blocks and heap
+   // blocks are both plain malloc'd memory
+   if(size == sizeof(Exception) && _exception_pool != NULL)
+   {
+      _exception_pool->release(ptr);
+   }
+   else
+   {
+      free(ptr);
+   }
+}
+
+bool Exception::enablePooling(bool enable)
+{
+   bool rval = _exception_pooling_enabled;
+   _exception_pooling_enabled = enable;
+   return rval;
+}
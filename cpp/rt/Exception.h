@@ -21,30 +21,65 @@ namespace rt
  * Exception (or derivative). The memory cleanup will be handled by the thread
  * when setting new exceptions and when the thread dies.
  *
+ * Exceptions are cheap enough to be used for ordinary failures such as
+ * timeouts: an Exception stores its own reference count, its memory comes
+ * from a per-thread pool, its details are only created when first accessed,
+ * and a message and type that are string literals can be used without
+ * copying them (see StaticStrings).
+ *
  * @author Dave Longley
  */
-class Exception
+class Exception : public CollectableObject<Exception>
 {
+public:
+   /**
+    * The ways an Exception may store its message and type.
+    */
+   enum StringStorage
+   {
+      /**
+       * The message and type are copied.
+       */
+      CopyStrings,
+
+      /**
+       * The message and type are not copied, they must remain valid for the
+       * life of the Exception, ie: string literals.
+       */
+      StaticStrings
+   };
+
 protected:
    /**
     * A message for this Exception.
     */
-   char* mMessage;
+   const char* mMessage;
 
    /**
     * A type for this Exception.
     */
-   char* mType;
+   const char* mType;
+
+   /**
+    * True if the message is owned by this Exception and must be freed.
+    */
+   bool mOwnMessage;
+
+   /**
+    * True if the type is owned by this Exception and must be freed.
+    */
+   bool mOwnType;
 
    /**
     * A cause associated with this Exception.
     */
-   Collectable<Exception>* mCause;
+   Collectable<Exception> mCause;
 
    /**
-    * Some key-value pairs with details about this exception.
+    * Some key-value pairs with details about this exception, NULL until
+    * they are first accessed.
     */
-   DynamicObject* mDetails;
+   DynamicObject mDetails;
 
 public:
    /**
@@ -56,6 +91,17 @@ public:
     */
    Exception(const char* message = "", const char* type = "");
 
+   /**
+    * Creates a new Exception that may use its message and type without
+    * copying them.
+    *
+    * @param message the message for this Exception.
+    * @param type the type for this Exception.
+    * @param storage StaticStrings to use the message and type without
+    *           copying them, CopyStrings to copy them.
+    */
+   Exception(const char* message, const char* type, StringStorage storage);
+
    /**
     * Destructs this Exception.
     */
@@ -303,11 +349,56 @@ public:
     * @return the reference to the Exception.
     */
    static Collectable<Exception> convertToException(DynamicObject& dyno);
+
+   /**
+    * Allocates memory for an Exception. Blocks the size of an Exception are
+    * taken from a per-thread pool, others from the heap.
+    *
+    * @param size the number of bytes to allocate.
+    *
+    * @return the allocated memory.
+    */
+   static void* allocate(size_t size);
+
+   /**
+    * Frees memory allocated with allocate().
+    *
+    * @param ptr the memory to free.
+    * @param size the number of bytes that were allocated.
+    */
+   static void deallocate(void* ptr, size_t size);
+
+   /**
+    * Enables or disables pooling of the memory used by Exceptions. Pooling
+    * is enabled by default.
+    *
+    * @param enable true to enable, false to disable.
+    *
+    * @return the previous enabled value.
+    */
+   static bool enablePooling(bool enable);
 };
 
 // define a reference counted Exception type
 typedef Collectable<Exception> ExceptionRef;
 
+/**
+ * Exceptions are allocated from a per-thread pool.
+ */
+template<>
+struct CollectableAllocator<Exception>
+{
+   static void* allocate(size_t size)
+   {
+      return Exception::allocate(size);
+   }
+
+   static void deallocate(void* ptr, size_t size)
+   {
+      Exception::deallocate(ptr, size);
+   }
+};
+
 } // end namespace rt
 } // end namespace monarch
 #endif
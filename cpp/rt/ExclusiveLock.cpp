@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2007-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2007-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #include "monarch/rt/ExclusiveLock.h"
 
@@ -8,7 +8,8 @@
 
 using namespace monarch::rt;
 
-ExclusiveLock::ExclusiveLock()
+ExclusiveLock::ExclusiveLock(bool adaptive) :
+   mMonitor(adaptive)
 {
 }
 
@@ -71,3 +72,8 @@ bool ExclusiveLock::wait(uint32_t& timeout, bool* condition, bool stop)
 
    return rval;
 }
+
+bool ExclusiveLock::isAdaptive()
+{
+   return mMonitor.isAdaptive();
+}
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2007-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2007-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #ifndef monarch_rt_ExclusiveLock_H
 #define monarch_rt_ExclusiveLock_H
@@ -19,6 +19,10 @@ namespace rt
  * causing deadlock or an indeterminant state. Of course, unlock() must be
  * called an equal number of times to release the lock.
  *
+ * An ExclusiveLock can be adaptive, in which case a thread that finds it
+ * locked spins briefly before it blocks. This is faster for locks that are
+ * contended but only held for short periods of time. See Monitor.
+ *
  * @author Dave Longley
  */
 class ExclusiveLock
@@ -32,8 +36,10 @@ protected:
 public:
    /**
     * Constructs a new ExclusiveLock.
+    *
+    * @param adaptive true to spin before blocking, false to block right away.
     */
-   ExclusiveLock();
+   ExclusiveLock(bool adaptive = false);
 
    /**
     * Destructs this ExclusiveLock.
@@ -138,6 +144,13 @@ public:
     * @return true if the thread was not interrupted, false if it was.
     */
    virtual bool wait(uint32_t& timeout, bool* condition, bool stop);
+
+   /**
+    * Returns true if this lock is adaptive, false if not.
+    *
+    * @return true if this lock is adaptive, false if not.
+    */
+   virtual bool isAdaptive();
 };
 
 } // end namespace rt
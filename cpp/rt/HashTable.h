@@ -1,12 +1,15 @@
 /*
- * Copyright (c) 2009-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2009-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #ifndef monarch_rt_HashTable_H
 #define monarch_rt_HashTable_H
 
 #include "monarch/rt/Atomic.h"
+#include "monarch/rt/EpochList.h"
 #include "monarch/rt/HazardPtrList.h"
 
+#include <new>
+
 namespace monarch
 {
 namespace rt
@@ -107,19 +110,37 @@ struct DefaultEqualsFunction : public EqualsFunction<_K>
  * valid EntryLists have been checked, CAS prepend B onto the shared garbage
  * list.
  *
+ * Keys and values may be of any copyable type. Values must also be default
+ * constructible, the value of an Entry is reset when the Entry is reclaimed.
+ *
  * Note: Reference counts are only kept for EntryLists. Entries are protected
  * by hazard pointers. Also, the code is written such that the reference count
  * for an EntryList that an Entry belongs to is always 1 if the Entry is being
  * accessed. Assumptions that this will continue to hold true are made to
  * simplify the code.
  *
+ * The scenarios above describe the default memory reclamation scheme, a
+ * HazardPtrList. The scheme can be changed with the _R template parameter.
+ * An EpochList uses epoch-based reclamation instead: an operation marks
+ * itself active in the current epoch once, after which reading an Entry or
+ * an EntryList needs no hazard pointer or validation. Memory that is
+ * removed is stamped with the epoch and is only freed once no operation
+ * from that epoch is still active. This makes reads cheaper, but one slow
+ * or preempted operation holds back the freeing of all memory removed while
+ * it runs, so it is best used when there are no more threads than CPUs.
+ *
  * @author Dave Longley
  */
 template<typename _K, typename _V, typename _H,
-typename _E = DefaultEqualsFunction<_K> >
+typename _E = DefaultEqualsFunction<_K>, typename _R = HazardPtrList>
 class HashTable
 {
 protected:
+   /**
+    * The type used by the reclamation scheme to guard an operation.
+    */
+   typedef typename _R::Guard Guard;
+
    /**
     * An entry is a single slot in the hash table. It can hold either:
     *
@@ -152,6 +173,7 @@ protected:
       _V* v;
       EntryList* owner;
       Entry* next;
+      uint64_t retired;
    };
 
    /**
@@ -185,6 +207,7 @@ protected:
       EntryList* next;
       bool old;
       EntryList* garbageNext;
+      uint64_t retired;
    };
 
    /**
@@ -210,9 +233,9 @@ protected:
 #endif
 
    /**
-    * A hazard pointer list for protecting access to entry lists.
+    * The memory reclamation scheme for protecting access to entry lists.
     */
-   HazardPtrList mHazardPtrs;
+   _R mReclaimer;
 
    /**
     * The function for producing hash codes from keys.
@@ -338,12 +361,12 @@ protected:
     * is made that the previous entry list already has a reference count
     * greater than 0.
     *
-    * @param ptr the hazard pointer to use.
+    * @param ptr the guard to use.
     * @param prev the previous entry list, NULL to use the head.
     *
     * @return the next EntryList (can be NULL).
     */
-   virtual EntryList* refNextEntryList(HazardPtr* ptr, EntryList* prev);
+   virtual EntryList* refNextEntryList(Guard* ptr, EntryList* prev);
 
    /**
     * Decreases the reference count on the given entry list.
@@ -353,16 +376,17 @@ protected:
    virtual void unrefEntryList(EntryList* el);
 
    /**
-    * Sets the given hazard pointer at the Entry at the given index. The
-    * hazard pointer must be set to NULL to unprotect the Entry.
+    * Protects the Entry at the given index with the given guard. The Entry
+    * must be unprotected via the reclamation scheme when it is no longer
+    * used.
     *
-    * @param ptr the hazard pointer to use.
+    * @param ptr the guard to use.
     * @param el the EntryList to get the Entry in.
     * @param idx the index of the Entry.
     *
     * @return the Entry (can be NULL).
     */
-   virtual Entry* protectEntry(HazardPtr* ptr, EntryList* el, int idx);
+   virtual Entry* protectEntry(Guard* ptr, EntryList* el, int idx);
 
    /**
     * A helper function that gets the most current EntryList at
@@ -370,11 +394,11 @@ protected:
     * the returned EntryList will be incremented and therefore must be
     * decremented later by the caller.
     *
-    * @param ptr the hazard pointer to use.
+    * @param ptr the guard to use.
     *
     * @return the most current EntryList.
     */
-   virtual EntryList* getCurrentEntryList(HazardPtr* ptr);
+   virtual EntryList* getCurrentEntryList(Guard* ptr);
 
    /**
     * Replaces an old entry with a new one, if the old one hasn't changed.
@@ -397,61 +421,61 @@ protected:
     * @param v the value.
     * @param replace true to replace an existing value, false to abort if
     *        an existing value is found.
-    * @param ptr the HazardPtr to use.
+    * @param ptr the guard to use.
     *
     * @return true if the value was put in the table, false if not.
     */
-   virtual bool put(const _K& k, const _V& v, bool replace, HazardPtr* ptr);
+   virtual bool put(const _K& k, const _V& v, bool replace, Guard* ptr);
 
    /**
     * Gets the Entry that is mapped to the passed key. The owner EntryList
     * must be unref'd.
     *
-    * @param ptr the HazardPtr to use.
+    * @param ptr the guard to use.
     * @param k the key to get the value for.
     *
     * @return the Entry or NULL if none exists.
     */
-   virtual Entry* getEntry(HazardPtr* ptr, const _K& k);
+   virtual Entry* getEntry(Guard* ptr, const _K& k);
 
    /**
     * Resizes the table.
     *
-    * @param ptr the hazard pointer to use.
+    * @param ptr the guard to use.
     * @param el the current EntryList.
     * @param capacity the new capacity to use.
     */
-   virtual void resize(HazardPtr* ptr, EntryList* el, int capacity);
+   virtual void resize(Guard* ptr, EntryList* el, int capacity);
 
    /**
     * Marks and/or collects garbage EntryLists.
     *
-    * @param ptr the hazard pointer to use.
+    * @param ptr the guard to use.
     */
-   virtual void collectGarbage(HazardPtr* ptr);
+   virtual void collectGarbage(Guard* ptr);
 };
 
-template<typename _K, typename _V, typename _H, typename _E>
-HashTable<_K, _V, _H, _E>::HashTable(int capacity) :
+template<typename _K, typename _V, typename _H, typename _E, typename _R>
+HashTable<_K, _V, _H, _E, _R>::HashTable(int capacity) :
    mGarbageHead(NULL)
 {
    // create first EntryList
    mHead = createEntryList(capacity);
 }
 
-template<typename _K, typename _V, typename _H, typename _E>
-HashTable<_K, _V, _H, _E>::HashTable(const HashTable& copy) :
+template<typename _K, typename _V, typename _H, typename _E, typename _R>
+HashTable<_K, _V, _H, _E, _R>::HashTable(const HashTable& copy) :
    mGarbageHead(NULL)
 {
    // create the first EntryList
    mHead = createEntryList(copy.mHead->capacity);
 
-   // acquire a hazard pointer in the copy
+   // acquire a guard in the copy
    HashTable& c = const_cast<HashTable&>(copy);
-   HazardPtr* cPtr = c.mHazardPtrs.acquire();
+   Guard* cPtr = c.mReclaimer.acquire();
 
-   // get a hazard pointer for this table
-   HazardPtr* ptr = mHazardPtrs.acquire();
+   // get a guard for this table
+   Guard* ptr = mReclaimer.acquire();
 
    // iterate over every entry list in copy, putting every value
    EntryList* el = c.refNextEntryList(cPtr, NULL);
@@ -468,13 +492,13 @@ HashTable<_K, _V, _H, _E>::HashTable(const HashTable& copy) :
                // copy key and value and unprotect entry
                _K key = e->k;
                _V value = *(e->v);
-               cPtr->value = NULL;
+               c.mReclaimer.unprotect(cPtr);
                put(key, value, false, ptr);
             }
             else
             {
                // unprotect entry
-               cPtr->value = NULL;
+               c.mReclaimer.unprotect(cPtr);
             }
          }
       }
@@ -485,13 +509,13 @@ HashTable<_K, _V, _H, _E>::HashTable(const HashTable& copy) :
       el = next;
    }
 
-   // release the hazard pointers
-   c.mHazardPtrs.release(cPtr);
-   mHazardPtrs.release(ptr);
+   // release the guards
+   c.mReclaimer.release(cPtr);
+   mReclaimer.release(ptr);
 }
 
-template<typename _K, typename _V, typename _H, typename _E>
-HashTable<_K, _V, _H, _E>::~HashTable()
+template<typename _K, typename _V, typename _H, typename _E, typename _R>
+HashTable<_K, _V, _H, _E, _R>::~HashTable()
 {
    // clean up all valid entry lists
    EntryList* el = const_cast<EntryList*>(mHead);
@@ -512,19 +536,19 @@ HashTable<_K, _V, _H, _E>::~HashTable()
    }
 }
 
-template<typename _K, typename _V, typename _H, typename _E>
-HashTable<_K, _V, _H, _E>& HashTable<_K, _V, _H, _E>::operator=(
+template<typename _K, typename _V, typename _H, typename _E, typename _R>
+HashTable<_K, _V, _H, _E, _R>& HashTable<_K, _V, _H, _E, _R>::operator=(
    const HashTable& rhs)
 {
    // remove all entries from this table
    clear();
 
-   // acquire a hazard pointer in the rhs
+   // acquire a guard in the rhs
    HashTable& r = const_cast<HashTable&>(rhs);
-   HazardPtr* rPtr = r.mHazardPtrs.acquire();
+   Guard* rPtr = r.mReclaimer.acquire();
 
-   // get a hazard pointer for this table
-   HazardPtr* ptr = mHazardPtrs.acquire();
+   // get a guard for this table
+   Guard* ptr = mReclaimer.acquire();
 
    // iterate over every entry list in rhs, putting every value
    EntryList* el = r.refNextEntryList(rPtr, NULL);
@@ -541,13 +565,13 @@ HashTable<_K, _V, _H, _E>& HashTable<_K, _V, _H, _E>::operator=(
                // copy key and value and unprotect entry
                _K key = e->k;
                _V value = *(e->v);
-               rPtr->value = NULL;
+               r.mReclaimer.unprotect(rPtr);
                put(key, value, false, ptr);
             }
             else
             {
                // unprotect entry
-               rPtr->value = NULL;
+               r.mReclaimer.unprotect(rPtr);
             }
          }
       }
@@ -558,33 +582,33 @@ HashTable<_K, _V, _H, _E>& HashTable<_K, _V, _H, _E>::operator=(
       el = next;
    }
 
-   // release the hazard pointers
-   r.mHazardPtrs.release(rPtr);
-   mHazardPtrs.release(ptr);
+   // release the guards
+   r.mReclaimer.release(rPtr);
+   mReclaimer.release(ptr);
 
    return *this;
 }
 
-template<typename _K, typename _V, typename _H, typename _E>
-bool HashTable<_K, _V, _H, _E>::put(const _K& k, const _V& v, bool replace)
+template<typename _K, typename _V, typename _H, typename _E, typename _R>
+bool HashTable<_K, _V, _H, _E, _R>::put(const _K& k, const _V& v, bool replace)
 {
    bool rval = false;
 
-   // do put with an acquired hazard pointer
-   HazardPtr* ptr = mHazardPtrs.acquire();
+   // do put with an acquired guard
+   Guard* ptr = mReclaimer.acquire();
    rval = put(k, v, replace, ptr);
-   mHazardPtrs.release(ptr);
+   mReclaimer.release(ptr);
 
    return rval;
 }
 
-template<typename _K, typename _V, typename _H, typename _E>
-bool HashTable<_K, _V, _H, _E>::get(const _K& k, _V& v)
+template<typename _K, typename _V, typename _H, typename _E, typename _R>
+bool HashTable<_K, _V, _H, _E, _R>::get(const _K& k, _V& v)
 {
    bool rval = false;
 
-   // acquire a hazard pointer
-   HazardPtr* ptr = mHazardPtrs.acquire();
+   // acquire a guard
+   Guard* ptr = mReclaimer.acquire();
 
    Entry* e = getEntry(ptr, k);
    if(e != NULL)
@@ -592,26 +616,26 @@ bool HashTable<_K, _V, _H, _E>::get(const _K& k, _V& v)
       // get value, unprotect entry and unref its list
       v = *(e->v);
       EntryList* owner = e->owner;
-      mHazardPtrs.release(ptr);
+      mReclaimer.release(ptr);
       unrefEntryList(owner);
       rval = true;
    }
    else
    {
-      // release unused hazard pointer
-      mHazardPtrs.release(ptr);
+      // release unused guard
+      mReclaimer.release(ptr);
    }
 
    return rval;
 }
 
-template<typename _K, typename _V, typename _H, typename _E>
-bool HashTable<_K, _V, _H, _E>::remove(const _K& k)
+template<typename _K, typename _V, typename _H, typename _E, typename _R>
+bool HashTable<_K, _V, _H, _E, _R>::remove(const _K& k)
 {
    bool rval = false;
 
-   // acquire a hazard pointer
-   HazardPtr* ptr = mHazardPtrs.acquire();
+   // acquire a guard
+   Guard* ptr = mReclaimer.acquire();
 
    // loop until a value is set to a tombstone or the entry is not found
    bool done = false;
@@ -632,7 +656,7 @@ bool HashTable<_K, _V, _H, _E>::remove(const _K& k)
 
          // unreference entry and its list
          EntryList* owner = e->owner;
-         ptr->value = NULL;
+         mReclaimer.unprotect(ptr);
          unrefEntryList(owner);
       }
       else
@@ -641,17 +665,17 @@ bool HashTable<_K, _V, _H, _E>::remove(const _K& k)
       }
    }
 
-   // release the hazard pointer
-   mHazardPtrs.release(ptr);
+   // release the guard
+   mReclaimer.release(ptr);
 
    return rval;
 }
 
-template<typename _K, typename _V, typename _H, typename _E>
-void HashTable<_K, _V, _H, _E>::clear()
+template<typename _K, typename _V, typename _H, typename _E, typename _R>
+void HashTable<_K, _V, _H, _E, _R>::clear()
 {
-   // acquire a hazard pointer
-   HazardPtr* ptr = mHazardPtrs.acquire();
+   // acquire a guard
+   Guard* ptr = mReclaimer.acquire();
 
    // iterate over every entry list, removing every value
    EntryList* el = refNextEntryList(ptr, NULL);
@@ -685,7 +709,7 @@ void HashTable<_K, _V, _H, _E>::clear()
                }
 
                // unprotect entry
-               ptr->value = NULL;
+               mReclaimer.unprotect(ptr);
             }
             else
             {
@@ -701,17 +725,17 @@ void HashTable<_K, _V, _H, _E>::clear()
       el = next;
    }
 
-   // release the hazard pointer
-   mHazardPtrs.release(ptr);
+   // release the guard
+   mReclaimer.release(ptr);
 }
 
-template<typename _K, typename _V, typename _H, typename _E>
-int HashTable<_K, _V, _H, _E>::length()
+template<typename _K, typename _V, typename _H, typename _E, typename _R>
+int HashTable<_K, _V, _H, _E, _R>::length()
 {
    int rval = 0;
 
-   // acquire a hazard pointer
-   HazardPtr* ptr = mHazardPtrs.acquire();
+   // acquire a guard
+   Guard* ptr = mReclaimer.acquire();
 
    // iterate over every entry list, adding lengths
    EntryList* el = refNextEntryList(ptr, NULL);
@@ -726,15 +750,15 @@ int HashTable<_K, _V, _H, _E>::length()
       el = next;
    }
 
-   // release the hazard pointer
-   mHazardPtrs.release(ptr);
+   // release the guard
+   mReclaimer.release(ptr);
 
    return rval;
 }
 
-template<typename _K, typename _V, typename _H, typename _E>
-struct HashTable<_K, _V, _H, _E>::EntryList*
-HashTable<_K, _V, _H, _E>::createEntryList(int capacity)
+template<typename _K, typename _V, typename _H, typename _E, typename _R>
+struct HashTable<_K, _V, _H, _E, _R>::EntryList*
+HashTable<_K, _V, _H, _E, _R>::createEntryList(int capacity)
 {
    EntryList* el = static_cast<EntryList*>(
       Atomic::mallocAligned(sizeof(EntryList)));
@@ -747,11 +771,12 @@ HashTable<_K, _V, _H, _E>::createEntryList(int capacity)
    el->next = NULL;
    el->old = false;
    el->garbageNext = NULL;
+   el->retired = 0;
    return el;
 };
 
-template<typename _K, typename _V, typename _H, typename _E>
-void HashTable<_K, _V, _H, _E>::freeEntryList(EntryList* el)
+template<typename _K, typename _V, typename _H, typename _E, typename _R>
+void HashTable<_K, _V, _H, _E, _R>::freeEntryList(EntryList* el)
 {
    // free all live entries
    for(int i = 0; i < el->capacity; ++i)
@@ -792,9 +817,9 @@ void HashTable<_K, _V, _H, _E>::freeEntryList(EntryList* el)
    Atomic::freeAligned(el);
 };
 
-template<typename _K, typename _V, typename _H, typename _E>
-struct HashTable<_K, _V, _H, _E>::Entry*
-HashTable<_K, _V, _H, _E>::createEntry(
+template<typename _K, typename _V, typename _H, typename _E, typename _R>
+struct HashTable<_K, _V, _H, _E, _R>::Entry*
+HashTable<_K, _V, _H, _E, _R>::createEntry(
    EntryList* el, const _K& key, const _V& value)
 {
    Entry* e = NULL;
@@ -812,6 +837,24 @@ HashTable<_K, _V, _H, _E>::createEntry(
       if(head != NULL)
       {
          e = head;
+
+         // prepend the rest of the free list back onto the shared free list
+         Entry* rest = e->next;
+         if(rest != NULL)
+         {
+            Entry* tail = rest;
+            while(tail->next != NULL)
+            {
+               tail = tail->next;
+            }
+            Entry* oldHead;
+            do
+            {
+               oldHead = const_cast<Entry*>(el->freeEntries);
+               tail->next = oldHead;
+            }
+            while(!Atomic::compareAndSwap(&el->freeEntries, oldHead, rest));
+         }
       }
    }
 
@@ -819,50 +862,46 @@ HashTable<_K, _V, _H, _E>::createEntry(
    {
       // create a new Entry, none were found on the free list
       e = static_cast<Entry*>(malloc(sizeof(Entry)));
+      new (&e->k) _K(key);
       e->v = new _V(value);
    }
    else
    {
+      e->k = key;
       *(e->v) = value;
    }
 
    e->type = Entry::Value;
-   e->k = key;
    e->h = mHashFunction(key);
    e->owner = el;
    e->next = NULL;
+   e->retired = 0;
 
    return e;
 };
 
-template<typename _K, typename _V, typename _H, typename _E>
-void HashTable<_K, _V, _H, _E>::freeEntry(Entry* e)
+template<typename _K, typename _V, typename _H, typename _E, typename _R>
+void HashTable<_K, _V, _H, _E, _R>::freeEntry(Entry* e)
 {
    if(e->v != NULL)
    {
       delete e->v;
    }
+   e->k.~_K();
    free(e);
 }
 
-template<typename _K, typename _V, typename _H, typename _E>
-struct HashTable<_K, _V, _H, _E>::EntryList*
-HashTable<_K, _V, _H, _E>::refNextEntryList(HazardPtr* ptr, EntryList* prev)
+template<typename _K, typename _V, typename _H, typename _E, typename _R>
+struct HashTable<_K, _V, _H, _E, _R>::EntryList*
+HashTable<_K, _V, _H, _E, _R>::refNextEntryList(Guard* ptr, EntryList* prev)
 {
    EntryList* rval = NULL;
 
    if(prev == NULL)
    {
-      do
-      {
-         // attempt to protect the head EntryList with a hazard pointer
-         ptr->value = const_cast<EntryList*>(mHead);
-      }
-      // ensure the head hasn't changed
-      while(ptr->value != mHead);
-
-      // set return value
-      rval = static_cast<EntryList*>(ptr->value);
+      // protect the head EntryList
+      rval = static_cast<EntryList*>(mReclaimer.protect(ptr,
+         reinterpret_cast<void* volatile*>(const_cast<EntryList**>(&mHead))));
    }
    else
    {
@@ -876,44 +915,37 @@ HashTable<_K, _V, _H, _E>::refNextEntryList(HazardPtr* ptr, EntryList* prev)
 
    if(rval != NULL)
    {
-      // increment reference count, clear hazard pointer
+      // increment reference count, unprotect the list
       Atomic::incrementAndFetch(&rval->refCount);
-      ptr->value = NULL;
+      mReclaimer.unprotect(ptr);
    }
 
    return rval;
 }
 
-template<typename _K, typename _V, typename _H, typename _E>
-void HashTable<_K, _V, _H, _E>::unrefEntryList(EntryList* el)
+template<typename _K, typename _V, typename _H, typename _E, typename _R>
+void HashTable<_K, _V, _H, _E, _R>::unrefEntryList(EntryList* el)
 {
    // decrement reference count
    Atomic::decrementAndFetch(&el->refCount);
 }
 
-template<typename _K, typename _V, typename _H, typename _E>
-struct HashTable<_K, _V, _H, _E>::Entry*
-HashTable<_K, _V, _H, _E>::protectEntry(HazardPtr* ptr, EntryList* el, int idx)
+template<typename _K, typename _V, typename _H, typename _E, typename _R>
+struct HashTable<_K, _V, _H, _E, _R>::Entry*
+HashTable<_K, _V, _H, _E, _R>::protectEntry(Guard* ptr, EntryList* el, int idx)
 {
    Entry* rval = NULL;
 
-   do
-   {
-      // attempt to protect the Entry with a hazard pointer
-      ptr->value = el->entries[idx];
-   }
-   // ensure the Entry hasn't changed
-   while(ptr->value != el->entries[idx]);
-
-   // set return value
-   rval = static_cast<Entry*>(ptr->value);
+   // protect the Entry
+   rval = static_cast<Entry*>(mReclaimer.protect(
+      ptr, reinterpret_cast<void* volatile*>(el->entries + idx)));
 
    return rval;
 }
 
-template<typename _K, typename _V, typename _H, typename _E>
-struct HashTable<_K, _V, _H, _E>::EntryList*
-HashTable<_K, _V, _H, _E>::getCurrentEntryList(HazardPtr* ptr)
+template<typename _K, typename _V, typename _H, typename _E, typename _R>
+struct HashTable<_K, _V, _H, _E, _R>::EntryList*
+HashTable<_K, _V, _H, _E, _R>::getCurrentEntryList(Guard* ptr)
 {
    EntryList* rval = NULL;
 
@@ -933,8 +965,8 @@ HashTable<_K, _V, _H, _E>::getCurrentEntryList(HazardPtr* ptr)
    return rval;
 }
 
-template<typename _K, typename _V, typename _H, typename _E>
-bool HashTable<_K, _V, _H, _E>::replaceEntry(
+template<typename _K, typename _V, typename _H, typename _E, typename _R>
+bool HashTable<_K, _V, _H, _E, _R>::replaceEntry(
    EntryList* el, int idx, Entry* eOld, Entry* eNew)
 {
    bool rval = false;
@@ -980,13 +1012,17 @@ bool HashTable<_K, _V, _H, _E>::replaceEntry(
          next = e->next;
          e->next = NULL;
 
-         /* Note: The next garbage entry is not in use if there's no hazard
-            pointer to it. Since the entry has been removed from any shared
+         /* Note: The next garbage entry is not in use if it is not
+            protected. Since the entry has been removed from any shared
             list, no other threads can start trying to access it. There can
             only be those threads that were already accessing it with the
-            protection of a hazard pointer. */
-         if(!mHazardPtrs.isProtected(e))
+            protection of a hazard pointer or an older epoch. */
+         if(!mReclaimer.isProtected(e, e->retired))
          {
+            // reset the value so that it does not hold on to any resources
+            // until the entry is reused
+            *(e->v) = _V();
+
             if(freeHead == NULL)
             {
                // start the new free list
@@ -1015,9 +1051,10 @@ bool HashTable<_K, _V, _H, _E>::replaceEntry(
          e = next;
       }
 
-      // append old entry to the new garbage list
+      // stamp the old entry and append it to the new garbage list
       if(eOld != NULL)
       {
+         eOld->retired = mReclaimer.retire();
          if(tail == NULL)
          {
             // start the new garbage list
@@ -1059,9 +1096,9 @@ bool HashTable<_K, _V, _H, _E>::replaceEntry(
    return rval;
 }
 
-template<typename _K, typename _V, typename _H, typename _E>
-bool HashTable<_K, _V, _H, _E>::put(
-   const _K& k, const _V& v, bool replace, HazardPtr* ptr)
+template<typename _K, typename _V, typename _H, typename _E, typename _R>
+bool HashTable<_K, _V, _H, _E, _R>::put(
+   const _K& k, const _V& v, bool replace, Guard* ptr)
 {
    bool rval = false;
 
@@ -1080,6 +1117,7 @@ bool HashTable<_K, _V, _H, _E>::put(
    */
 
    Entry* eNew = NULL;
+   bool stored = false;
 
    // enter a spin loop that keep trying to insert while we haven't attempted
    // an insert yet
@@ -1118,7 +1156,7 @@ bool HashTable<_K, _V, _H, _E>::put(
             // replace entry may fail because some other thread just
             // barely beat us here ... but we optimize by saying we
             // actually lost the fight and were overwritten
-            replaceEntry(el, i, eOld, eNew);
+            stored = replaceEntry(el, i, eOld, eNew);
             inserted = insertAttempted = true;
          }
          else if(eOld->type == Entry::Sentinel)
@@ -1142,7 +1180,7 @@ bool HashTable<_K, _V, _H, _E>::put(
                   // replace entry may fail because some other thread just
                   // barely beat us here ... but we optimize by saying we
                   // actually lost the fight and were overwritten
-                  replaceEntry(el, i, eOld, eNew);
+                  stored = replaceEntry(el, i, eOld, eNew);
                   inserted = true;
                }
                insertAttempted = true;
@@ -1163,7 +1201,7 @@ bool HashTable<_K, _V, _H, _E>::put(
          }
 
          // unprotect old entry
-         ptr->value = NULL;
+         mReclaimer.unprotect(ptr);
       }
 
       if(inserted)
@@ -1192,18 +1230,18 @@ bool HashTable<_K, _V, _H, _E>::put(
    // FIXME: run garbage collection how often? also run in get()?
    collectGarbage(ptr);
 
-   if(!rval)
+   if(!stored)
    {
-      // clean up created entry
+      // clean up created entry, it was never stored in the table
       freeEntry(eNew);
    }
 
    return rval;
 }
 
-template<typename _K, typename _V, typename _H, typename _E>
-struct HashTable<_K, _V, _H, _E>::Entry*
-HashTable<_K, _V, _H, _E>::getEntry(HazardPtr* ptr, const _K& k)
+template<typename _K, typename _V, typename _H, typename _E, typename _R>
+struct HashTable<_K, _V, _H, _E, _R>::Entry*
+HashTable<_K, _V, _H, _E, _R>::getEntry(Guard* ptr, const _K& k)
 {
    Entry* rval = NULL;
 
@@ -1256,7 +1294,7 @@ HashTable<_K, _V, _H, _E>::getEntry(HazardPtr* ptr, const _K& k)
                old entry as a Sentinel. */
             if(e->type == Entry::Value && el->old)
             {
-               /* Note: Do not reuse the existing hazard pointer, it is being
+               /* Note: Do not reuse the existing guard, it is being
                   used to protect the current entry. */
                put(e->k, *(e->v), false);
 
@@ -1286,7 +1324,7 @@ HashTable<_K, _V, _H, _E>::getEntry(HazardPtr* ptr, const _K& k)
          // only unprotect the entry if we aren't returning it
          if(rval == NULL && e != NULL)
          {
-            ptr->value = NULL;
+            mReclaimer.unprotect(ptr);
          }
       }
 
@@ -1302,9 +1340,9 @@ HashTable<_K, _V, _H, _E>::getEntry(HazardPtr* ptr, const _K& k)
    return rval;
 }
 
-template<typename _K, typename _V, typename _H, typename _E>
-void HashTable<_K, _V, _H, _E>::resize(
-   HazardPtr* ptr, EntryList* el, int capacity)
+template<typename _K, typename _V, typename _H, typename _E, typename _R>
+void HashTable<_K, _V, _H, _E, _R>::resize(
+   Guard* ptr, EntryList* el, int capacity)
 {
    /* Note: When we call resize(), other threads might also be trying to resize
       at the same time. Therefore, we allocate a new EntryList and then try to
@@ -1346,8 +1384,8 @@ void HashTable<_K, _V, _H, _E>::resize(
    }
 }
 
-template<typename _K, typename _V, typename _H, typename _E>
-void HashTable<_K, _V, _H, _E>::collectGarbage(HazardPtr* ptr)
+template<typename _K, typename _V, typename _H, typename _E, typename _R>
+void HashTable<_K, _V, _H, _E, _R>::collectGarbage(Guard* ptr)
 {
    // temporarily isolate the entire garbage list to this thread
    EntryList* privateHead = NULL;
@@ -1402,72 +1440,73 @@ void HashTable<_K, _V, _H, _E>::collectGarbage(HazardPtr* ptr)
       }
    }
 
-   /* Use a hazard pointer to protect the first EntryList (we optimize out
-      incrementing the reference count here). If it is old, has a length of 0,
-      and a ref count of 0, then we can mark it as garbage. This is safe to do.
-      Suppose another thread is just about to increment the ref count or does
-      so while we're marking this list as garbage. Since the old flag was set
-      before ref count was incremented, the put() call gaurantees that no new
-      entries will be written to the EntryList. It can only be read from. */
-   // attempt to protect the head EntryList with a hazard pointer
-   ptr->value = const_cast<EntryList*>(mHead);
-   // ensure the head hasn't changed, if it has, someone else is handling GC
-   // and we don't bother with it
-   if(ptr->value == mHead)
+   /* Protect the first EntryList (we optimize out incrementing the reference
+      count here). If it is old, has a length of 0, and a ref count of 0, then
+      we can mark it as garbage. This is safe to do. Suppose another thread is
+      just about to increment the ref count or does so while we're marking
+      this list as garbage. Since the old flag was set before ref count was
+      incremented, the put() call gaurantees that no new entries will be
+      written to the EntryList. It can only be read from. */
+   EntryList* el = static_cast<EntryList*>(mReclaimer.protect(ptr,
+      reinterpret_cast<void* volatile*>(const_cast<EntryList**>(&mHead))));
+   if(el->old && el->length == 0 && el->refCount == 0)
    {
-      EntryList* el = static_cast<EntryList*>(ptr->value);
-      if(el->old && el->length == 0 && el->refCount == 0)
+      // if we fail to remove the list from the head, then someone else has
+      // done our work for us
+      if(Atomic::compareAndSwap(&mHead, el, el->next))
       {
-         // if we fail to remove the list from the head, then someone else has
-         // done our work for us
-         if(Atomic::compareAndSwap(&mHead, el, el->next))
+         // we are responsible for marking the list as garbage, so stamp it
+         // and move it to our private garbage list
+         el->retired = mReclaimer.retire();
+         if(privateTail == NULL)
          {
-            // we are responsible for marking the list as garbage, so move it
-            // to our private garbage list
-            if(privateTail == NULL)
-            {
-               // start the private list
-               privateHead = privateTail = el;
-            }
-            else
-            {
-               // append to the private list
-               privateTail->garbageNext = el;
-               privateTail = el;
-            }
+            // start the private list
+            privateHead = privateTail = el;
+         }
+         else
+         {
+            // append to the private list
+            privateTail->garbageNext = el;
+            privateTail = el;
          }
       }
    }
-   // clear hazard pointer
-   ptr->value = NULL;
+   // unprotect the first EntryList
+   mReclaimer.unprotect(ptr);
 
-   // clean up the private garbage list as much as possible
+   // clean up the private garbage list as much as possible, keeping any
+   // lists that are still in use in the private list
    EntryList* next = privateHead;
+   privateHead = privateTail = NULL;
    while(next != NULL)
    {
+      // save next entry list
+      EntryList* tmp = next;
+      next = next->garbageNext;
+
       // we can clean up the list if its reference count is 0, it is not
-      // protected by the hazard pointer list, and then check again to
+      // protected by the reclamation scheme, and then check again to
       // ensure the ref count hasn't increased during the protection check
-      if(next->refCount == 0 &&
-         !mHazardPtrs.isProtected(next) &&
-         next->refCount == 0)
+      if(tmp->refCount == 0 &&
+         !mReclaimer.isProtected(tmp, tmp->retired) &&
+         tmp->refCount == 0)
+      {
+         // free entry list
+         freeEntryList(tmp);
+      }
+      else
       {
-         // update private head and tail
-         if(privateHead == privateTail)
+         // keep the list in the private list
+         tmp->garbageNext = NULL;
+         if(privateTail == NULL)
          {
-            privateHead = privateTail = NULL;
+            privateHead = privateTail = tmp;
          }
          else
          {
-            privateHead = next->garbageNext;
+            privateTail->garbageNext = tmp;
+            privateTail = tmp;
          }
-
-         // save next entry list
-         EntryList* tmp = next;
-         next = next->garbageNext;
-
-         // free entry list
-         freeEntryList(tmp);
       }
    }
 
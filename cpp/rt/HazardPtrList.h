@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2009 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2009-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #ifndef monarch_rt_HazardPtrList_H
 #define monarch_rt_HazardPtrList_H
@@ -58,11 +58,24 @@ struct HazardPtr
  * only needed to protect memory while its reference count is being incremented,
  * then each thread should only ever need to acquire 1 hazard pointer.
  *
+ * A HazardPtrList is also one of the memory reclamation schemes that a
+ * HashTable can use, see EpochList for the other one. The scheme provides a
+ * Guard type, acquire() and release() to guard an operation, protect() and
+ * unprotect() to protect a shared pointer during the operation, retire() to
+ * stamp memory that has been unlinked and isProtected() to check whether
+ * retired memory may be freed. For hazard pointers, retire() stamps are
+ * not needed and every protected pointer has to be validated.
+ *
  * @author Dave Longley
  */
 class HazardPtrList
 {
 public:
+   /**
+    * The type used to guard an operation.
+    */
+   typedef HazardPtr Guard;
+
    /**
     * The head of this list.
     */
@@ -114,6 +127,59 @@ public:
     *         false if not.
     */
    bool isProtected(void* addr);
+
+   /**
+    * Protects the pointer at the given address with a hazard pointer. The
+    * pointer is read until it does not change while being protected.
+    *
+    * @param ptr the hazard pointer to use.
+    * @param src the address of the pointer to protect.
+    *
+    * @return the protected pointer.
+    */
+   inline void* protect(HazardPtr* ptr, void* volatile* src)
+   {
+      do
+      {
+         ptr->value = *src;
+      }
+      while(ptr->value != *src);
+      return ptr->value;
+   };
+
+   /**
+    * Stops protecting the pointer protected by a hazard pointer.
+    *
+    * @param ptr the hazard pointer.
+    */
+   inline void unprotect(HazardPtr* ptr)
+   {
+      ptr->value = NULL;
+   };
+
+   /**
+    * Gets the stamp for memory that has just been unlinked. Hazard pointers
+    * do not use stamps.
+    *
+    * @return 0.
+    */
+   inline uint64_t retire()
+   {
+      return 0;
+   };
+
+   /**
+    * Checks whether retired memory is protected by a hazard pointer.
+    *
+    * @param addr the address of the memory.
+    * @param stamp the stamp from retire(), unused.
+    *
+    * @return true if the memory is protected, false if it may be freed.
+    */
+   inline bool isProtected(void* addr, uint64_t stamp)
+   {
+      return isProtected(addr);
+   };
 };
 
 } // end namespace rt
@@ -3,28 +3,42 @@
  */
 #include "monarch/rt/JobDispatcher.h"
 
+#include "monarch/rt/System.h"
+
 #include <list>
 #include <algorithm>
 
 using namespace std;
 using namespace monarch::rt;
 
+// the number of jobs that can be queued without taking the lock
+#define INCOMING_QUEUE_SIZE 4096
+
+// the number of jobs moved onto the job queue at once
+#define ACCEPT_BATCH_SIZE   64
+
 JobDispatcher::JobDispatcher() :
    mThreadPool(new ThreadPool(10)),
    mCleanupThreadPool(true),
+   mIncomingJobs(INCOMING_QUEUE_SIZE),
    mQueuedJobs(0),
+   mParked(false),
    mDispatcherThread(NULL)
 {
    // set thread expire time to 2 minutes (120000 milliseconds) by default
    mThreadPool->setThreadExpireTime(120000);
+   resetStats();
 }
 
 JobDispatcher::JobDispatcher(ThreadPool* pool, bool cleanupPool) :
    mThreadPool(pool),
    mCleanupThreadPool(cleanupPool),
+   mIncomingJobs(INCOMING_QUEUE_SIZE),
    mQueuedJobs(0),
+   mParked(false),
    mDispatcherThread(NULL)
 {
+   resetStats();
 }
 
 JobDispatcher::~JobDispatcher()
@@ -34,55 +48,116 @@ JobDispatcher::~JobDispatcher()
    {
       delete mThreadPool;
    }
+
+   // free references held by jobs that were never dispatched
+   acceptIncomingJobs();
+   for(JobList::iterator i = mJobQueue.begin(); i != mJobQueue.end(); ++i)
+   {
+      if(i->type == Job::TypeRunnableRef)
+      {
+         delete i->runnableRef;
+      }
+   }
 }
 
 inline void JobDispatcher::wakeup()
 {
    // wake up dispatcher
+   Atomic::incrementAndFetch(&mWakeupCount);
    mLock.notifyAll();
 }
 
 inline bool JobDispatcher::canDispatch()
 {
-   return !mJobQueue.empty();
+   return !mJobQueue.empty() || !mIncomingJobs.isEmpty();
+}
+
+uint32_t JobDispatcher::getParkTimeout()
+{
+   return 0;
 }
 
 void JobDispatcher::queueJob(Runnable& job)
 {
-   mLock.lock();
+   Job j;
+   j.type = Job::TypeRunnable;
+   j.runnable = &job;
+   j.deleted = false;
+   enqueueJob(j);
+}
+
+void JobDispatcher::queueJob(RunnableRef& job)
+{
+   Job j;
+   j.type = Job::TypeRunnableRef;
+   j.runnableRef = new RunnableRef(job);
+   j.deleted = false;
+   enqueueJob(j);
+}
+
+void JobDispatcher::enqueueJob(Job& job)
+{
+   job.queued = System::getMonotonicMicroseconds();
+
+   // count the job before it can be dispatched
+   unsigned int depth = Atomic::incrementAndFetch(&mQueuedJobs);
+   unsigned int max;
+   while(depth > (max = mMaxQueuedJobs) &&
+         !Atomic::compareAndSwap(&mMaxQueuedJobs, max, depth));
+   Atomic::incrementAndFetch(&mEnqueuedCount);
+
+   if(!mIncomingJobs.push(job))
    {
-      // add the job to the queue and wakeup
-      Job j;
-      j.type = Job::TypeRunnable;
-      j.runnable = &job;
-      j.deleted = false;
-      mJobQueue.push_back(j);
-      ++mQueuedJobs;
-      wakeup();
+      // incoming queue is full, queue directly behind the jobs in it
+      mLock.lock();
+      acceptIncomingJobs();
+      mJobQueue.push_back(job);
+      mLock.unlock();
+   }
+
+   // only wake up the dispatcher if it is asleep, the barrier ensures that
+   // it either sees the job or is seen to be parked, and only the first
+   // job queued while it is asleep needs to wake it up
+   Atomic::memoryBarrier();
+   if(mParked)
+   {
+      mLock.lock();
+      if(mParked)
+      {
+         mParked = false;
+         wakeup();
+      }
+      mLock.unlock();
    }
-   mLock.unlock();
 }
 
-void JobDispatcher::queueJob(RunnableRef& job)
+void JobDispatcher::acceptIncomingJobs()
 {
-   mLock.lock();
+   Job jobs[ACCEPT_BATCH_SIZE];
+   unsigned int count;
+   while((count = mIncomingJobs.pop(jobs, ACCEPT_BATCH_SIZE)) > 0)
    {
-      // add the job to the queue and wakeup
-      Job j;
-      j.type = Job::TypeRunnableRef;
-      j.runnableRef = new RunnableRef(job);
-      j.deleted = false;
-      mJobQueue.push_back(j);
-      ++mQueuedJobs;
-      wakeup();
+      mJobQueue.insert(mJobQueue.end(), jobs, jobs + count);
    }
-   mLock.unlock();
+}
+
+void JobDispatcher::jobDispatched(Job& job)
+{
+   uint64_t latency = System::getMonotonicMicroseconds() - job.queued;
+   mTotalLatency += latency;
+   if(latency > mMaxLatency)
+   {
+      mMaxLatency = latency;
+   }
+   Atomic::incrementAndFetch(&mDispatchedCount);
 }
 
 void JobDispatcher::dequeueJob(Runnable& job)
 {
    mLock.lock();
    {
+      acceptIncomingJobs();
+
       // find and mark the job to be removed from the queue, the actual
       // removal happens on the dispatch thread unless not dispatching
       bool dispatchOff = !isDispatching();
@@ -94,7 +169,7 @@ void JobDispatcher::dequeueJob(Runnable& job)
          {
             found = true;
             i->deleted = true;
-            --mQueuedJobs;
+            Atomic::decrementAndFetch(&mQueuedJobs);
 
             if(dispatchOff)
             {
@@ -107,7 +182,7 @@ void JobDispatcher::dequeueJob(Runnable& job)
          {
             found = true;
             i->deleted = true;
-            --mQueuedJobs;
+            Atomic::decrementAndFetch(&mQueuedJobs);
 
             if(dispatchOff)
             {
@@ -131,6 +206,8 @@ void JobDispatcher::dispatchJobs()
 {
    mLock.lock();
    {
+      acceptIncomingJobs();
+
       // try to run all jobs in the queue
       bool run = true;
       Thread* thread = Thread::currentThread();
@@ -153,17 +230,19 @@ void JobDispatcher::dispatchJobs()
             tp->tryRunJob(*i->runnable))
          {
             // remove from queue
+            jobDispatched(*i);
             i = mJobQueue.erase(i);
-            --mQueuedJobs;
+            Atomic::decrementAndFetch(&mQueuedJobs);
          }
          // try to run job
          else if(i->type == Job::TypeRunnableRef &&
                  tp->tryRunJob(*i->runnableRef))
          {
             // delete reference, remove from queue
+            jobDispatched(*i);
             delete i->runnableRef;
             i = mJobQueue.erase(i);
-            --mQueuedJobs;
+            Atomic::decrementAndFetch(&mQueuedJobs);
          }
          else
          {
@@ -181,6 +260,8 @@ bool JobDispatcher::isQueued(Runnable& job)
 
    mLock.lock();
    {
+      acceptIncomingJobs();
+
       // find the job in the queue, return true if it isn't marked as deleted
       JobList::iterator end = mJobQueue.end();
       for(JobList::iterator i = mJobQueue.begin(); !rval && i != end; i++)
@@ -254,11 +335,17 @@ void JobDispatcher::run()
       }
       else
       {
+         // announce parking before checking for jobs again so that a job
+         // queued after the check will wake this thread up
          mLock.lock();
+         mParked = true;
+         Atomic::memoryBarrier();
          if(!canDispatch())
          {
-            mLock.wait();
+            Atomic::incrementAndFetch(&mParkCount);
+            mLock.wait(getParkTimeout());
          }
+         mParked = false;
          mLock.unlock();
       }
    }
@@ -281,14 +368,19 @@ void JobDispatcher::clearQueuedJobs()
 {
    mLock.lock();
    {
+      acceptIncomingJobs();
+
       // mark all jobs as deleted, only remove from queue if dispatch is off,
       // otherwise let the dispatch queue handle removal
       bool dispatchOff = !isDispatching();
       JobList::iterator end = mJobQueue.end();
       for(JobList::iterator i = mJobQueue.begin(); i != end;)
       {
-         i->deleted = true;
-         --mQueuedJobs;
+         if(!i->deleted)
+         {
+            i->deleted = true;
+            Atomic::decrementAndFetch(&mQueuedJobs);
+         }
 
          if(dispatchOff)
          {
@@ -325,6 +417,20 @@ inline ThreadPool* JobDispatcher::getThreadPool()
    return mThreadPool;
 }
 
+void JobDispatcher::setThreadPool(ThreadPool* pool, bool cleanupPool)
+{
+   mLock.lock();
+   {
+      if(mCleanupThreadPool && mThreadPool != pool)
+      {
+         delete mThreadPool;
+      }
+      mThreadPool = pool;
+      mCleanupThreadPool = cleanupPool;
+   }
+   mLock.unlock();
+}
+
 inline unsigned int JobDispatcher::getQueuedJobCount()
 {
    return mQueuedJobs;
@@ -336,9 +442,40 @@ unsigned int JobDispatcher::getTotalJobCount()
 
    mLock.lock();
    {
-      rval = mQueuedJobs + getThreadPool()->getRunningThreadCount();
+      ThreadPool* tp = getThreadPool();
+      rval = mQueuedJobs +
+         tp->getQueuedJobCount() + tp->getRunningThreadCount();
    }
    mLock.unlock();
 
    return rval;
 }
+
+DynamicObject JobDispatcher::getStats()
+{
+   DynamicObject rval;
+
+   uint64_t dispatched = mDispatchedCount;
+   rval["queueDepth"] = (uint32_t)mQueuedJobs;
+   rval["maxQueueDepth"] = (uint32_t)mMaxQueuedJobs;
+   rval["enqueued"] = (uint64_t)mEnqueuedCount;
+   rval["dispatched"] = dispatched;
+   rval["averageEnqueueLatency"] =
+      (dispatched == 0) ? 0 : mTotalLatency / dispatched;
+   rval["maxEnqueueLatency"] = mMaxLatency;
+   rval["parks"] = (uint64_t)mParkCount;
+   rval["wakeups"] = (uint64_t)mWakeupCount;
+
+   return rval;
+}
+
+void JobDispatcher::resetStats()
+{
+   mMaxQueuedJobs = mQueuedJobs;
+   mEnqueuedCount = 0;
+   mDispatchedCount = 0;
+   mTotalLatency = 0;
+   mMaxLatency = 0;
+   mParkCount = 0;
+   mWakeupCount = 0;
+}
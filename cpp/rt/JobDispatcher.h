@@ -1,9 +1,11 @@
 /*
- * Copyright (c) 2007-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2007-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #ifndef monarch_rt_JobDispatcher_H
 #define monarch_rt_JobDispatcher_H
 
+#include "monarch/rt/DynamicObject.h"
+#include "monarch/rt/LockFreeQueue.h"
 #include "monarch/rt/ThreadPool.h"
 
 #include <map>
@@ -17,6 +19,11 @@ namespace rt
  * A JobDispatcher is a class that maintains a queue of Runnable jobs
  * that are dispatched on a separate thread in a ThreadPool.
  *
+ * Jobs are queued onto a LockFreeQueue so that queueing threads do not
+ * contend with each other or with the dispatcher thread. The dispatcher
+ * thread moves them onto its own job queue in batches and only goes to
+ * sleep, and needs to be woken up, when it has run out of jobs.
+ *
  * @author Dave Longley
  */
 class JobDispatcher : public Runnable
@@ -49,8 +56,15 @@ protected:
          RunnableRef* runnableRef;
       };
       bool deleted;
+      uint64_t queued;
    };
 
+   /**
+    * The lock-free queue that holds newly queued jobs until the dispatcher
+    * moves them onto the job queue.
+    */
+   LockFreeQueue<Job> mIncomingJobs;
+
    /**
     * The internal queue that holds the jobs that are waiting to be dispatched.
     */
@@ -60,9 +74,29 @@ protected:
    /**
     * Keeps track of the number of queued jobs. This must be done independently
     * of the size property on the job queue because some jobs are marked as
-    * deleted in the queue and are not considered queued.
+    * deleted in the queue and are not considered queued. It is only changed
+    * atomically.
+    */
+   volatile unsigned int mQueuedJobs;
+
+   /**
+    * True while the dispatcher thread is asleep or about to go to sleep.
+    */
+   volatile bool mParked;
+
+   /**
+    * Statistics: the highest number of queued jobs, the number of jobs that
+    * were queued and dispatched, the total and highest time jobs waited to
+    * be dispatched (in microseconds), the number of times the dispatcher
+    * went to sleep and the number of times it was woken up.
     */
-   unsigned int mQueuedJobs;
+   volatile unsigned int mMaxQueuedJobs;
+   volatile uint64_t mEnqueuedCount;
+   volatile uint64_t mDispatchedCount;
+   uint64_t mTotalLatency;
+   uint64_t mMaxLatency;
+   volatile uint64_t mParkCount;
+   volatile uint64_t mWakeupCount;
 
    /**
     * The thread used to dispatch the Runnable jobs.
@@ -177,6 +211,17 @@ public:
     */
    virtual ThreadPool* getThreadPool();
 
+   /**
+    * Replaces the ThreadPool. The current ThreadPool is freed if this
+    * dispatcher was responsible for cleaning it up, which terminates its
+    * threads. This should only be called while no jobs are running.
+    *
+    * @param pool the new thread pool for running jobs.
+    * @param cleanupPool true if the new pool should be freed when this
+    *           dispatcher no longer uses it, false if not.
+    */
+   virtual void setThreadPool(ThreadPool* pool, bool cleanupPool = true);
+
    /**
     * Gets the number of Runnable jobs that are in the queue.
     *
@@ -185,18 +230,63 @@ public:
    virtual unsigned int getQueuedJobCount();
 
    /**
-    * Gets the number of Runnable jobs that are in the queue and that are
-    * running.
+    * Gets the number of Runnable jobs that are in the queue, that have been
+    * queued by the ThreadPool and that are running.
     *
     * @return the number of Runnable jobs that are queued to be dispatched
-    *         plus the Runnable jobs that are already running.
+    *         plus the Runnable jobs that are queued in or already running on
+    *         the ThreadPool.
     */
    virtual unsigned int getTotalJobCount();
 
+   /**
+    * Gets statistics for this dispatcher:
+    *
+    * "queueDepth": the number of queued jobs.
+    * "maxQueueDepth": the highest number of queued jobs.
+    * "enqueued": the number of jobs that were queued.
+    * "dispatched": the number of jobs that were dispatched.
+    * "averageEnqueueLatency": the average time from queueing a job to
+    *    dispatching it, in microseconds.
+    * "maxEnqueueLatency": the highest such time, in microseconds.
+    * "parks": the number of times the dispatcher went to sleep.
+    * "wakeups": the number of times the dispatcher was woken up.
+    *
+    * @return the statistics.
+    */
+   virtual DynamicObject getStats();
+
+   /**
+    * Resets the statistics for this dispatcher, apart from the queue depth.
+    */
+   virtual void resetStats();
+
 protected:
+   /**
+    * Queues a job, waking up the dispatcher if it is asleep.
+    *
+    * @param job the job to queue.
+    */
+   virtual void enqueueJob(Job& job);
+
+   /**
+    * Moves newly queued jobs onto the job queue. The lock for this
+    * dispatcher must be held when calling this method.
+    */
+   virtual void acceptIncomingJobs();
+
+   /**
+    * Records that a job was dispatched, for statistics. Only called from the
+    * dispatcher thread.
+    *
+    * @param job the job that was dispatched.
+    */
+   virtual void jobDispatched(Job& job);
+
    /**
     * Wakes up this dispatcher if it has gone to sleep waiting for
-    * jobs to become dispatchable.
+    * jobs to become dispatchable. The lock for this dispatcher must be
+    * held when calling this method.
     */
    virtual void wakeup();
 
@@ -206,6 +296,14 @@ protected:
     * @return true if this dispatcher has a job it can dispatch.
     */
    virtual bool canDispatch();
+
+   /**
+    * Gets how long this dispatcher may sleep for when it has no job it can
+    * dispatch.
+    *
+    * @return the time in milliseconds, 0 to sleep until woken up.
+    */
+   virtual uint32_t getParkTimeout();
 };
 
 } // end namespace rt
@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#define __STDC_CONSTANT_MACROS
+
+#include "monarch/rt/LatencyHistogram.h"
+
+#include "monarch/rt/Atomic.h"
+
+using namespace monarch::rt;
+
+// each power of two is split into 2^SUB_BITS buckets
+#define SUB_BITS     3
+#define SUB_BUCKETS  (1 << SUB_BITS)
+
+LatencyHistogram::LatencyHistogram()
+{
+   LatencyHistogram::reset();
+}
+
+LatencyHistogram::~LatencyHistogram()
+{
+}
+
+void LatencyHistogram::record(uint64_t value)
+{
+   Atomic::incrementAndFetch(&mBuckets[getBucket(value)]);
+   Atomic::addAndFetch(&mTotal, value);
+   Atomic::incrementAndFetch(&mCount);
+
+   uint64_t max;
+   while(value > (max = mMax) &&
+         !Atomic::compareAndSwap(&mMax, max, value));
+}
+
+uint64_t LatencyHistogram::getCount()
+{
+   return mCount;
+}
+
+uint64_t LatencyHistogram::getAverage()
+{
+   uint64_t count = mCount;
+   return (count == 0) ? 0 : mTotal / count;
+}
+
+uint64_t LatencyHistogram::getMax()
+{
+   return mMax;
+}
+
+uint64_t LatencyHistogram::getPercentile(double percentile)
+{
+   uint64_t rval = 0;
+
+   // copy the buckets so that the walk sees the values that were counted
+   uint64_t counts[BucketCount];
+   uint64_t count = 0;
+   for(int i = 0; i < BucketCount; ++i)
+   {
+      counts[i] = mBuckets[i];
+      count += counts[i];
+   }
+
+   if(count > 0)
+   {
+      // find the bucket with the value at the given rank
+      uint64_t rank = (uint64_t)(percentile / 100.0 * count + 0.5);
+      if(rank < 1)
+      {
+         rank = 1;
+      }
+      else if(rank > count)
+      {
+         rank = count;
+      }
+      uint64_t seen = 0;
+      int bucket = 0;
+      for(; seen + counts[bucket] < rank; ++bucket)
+      {
+         seen += counts[bucket];
+      }
+      rval = getBucketLimit(bucket);
+
+      uint64_t max = mMax;
+      if(rval > max)
+      {
+         rval = max;
+      }
+   }
+
+   return rval;
+}
+
+DynamicObject LatencyHistogram::getStats()
+{
+   DynamicObject rval;
+   rval["count"] = getCount();
+   rval["average"] = getAverage();
+   rval["p50"] = getPercentile(50);
+   rval["p90"] = getPercentile(90);
+   rval["p99"] = getPercentile(99);
+   rval["max"] = getMax();
+   return rval;
+}
+
+void LatencyHistogram::reset()
+{
+   for(int i = 0; i < BucketCount; ++i)
+   {
+      mBuckets[i] = 0;
+   }
+   mCount = 0;
+   mTotal = 0;
+   mMax = 0;
+}
+
+int LatencyHistogram::getBucket(uint64_t value)
+{
+   int rval;
+
+   if(value < SUB_BUCKETS)
+   {
+      rval = (int)value;
+   }
+   else
+   {
+      // find the highest set bit
+      int bit = 0;
+      for(int shift = 32; shift > 0; shift >>= 1)
+      {
+         if((value >> (bit + shift)) != 0)
+         {
+            bit += shift;
+         }
+      }
+
+      // the bits after the highest pick the bucket within its power of two
+      rval = (bit - SUB_BITS + 1) * SUB_BUCKETS +
+         (int)((value >> (bit - SUB_BITS)) & (SUB_BUCKETS - 1));
+   }
+
+   return rval;
+}
+
+uint64_t LatencyHistogram::getBucketLimit(int bucket)
+{
+   uint64_t rval;
+
+   if(bucket < SUB_BUCKETS)
+   {
+      rval = bucket;
+   }
+   else
+   {
+      int shift = bucket / SUB_BUCKETS - 1;
+      uint64_t sub = bucket % SUB_BUCKETS;
+      rval = ((SUB_BUCKETS + sub + 1) << shift) - 1;
+   }
+
+   return rval;
+}
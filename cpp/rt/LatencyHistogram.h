@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#ifndef monarch_rt_LatencyHistogram_H
+#define monarch_rt_LatencyHistogram_H
+
+#include "monarch/rt/DynamicObject.h"
+
+#include <inttypes.h>
+
+namespace monarch
+{
+namespace rt
+{
+
+/**
+ * A LatencyHistogram counts durations, such as microseconds, so that their
+ * percentiles can be estimated. It is lock-free: recording a value is a few
+ * atomic increments, so many threads may record values at once.
+ *
+ * Values below 8 are counted exactly. Larger values are counted in buckets
+ * that split each power of two into 8, so an estimated percentile is within
+ * 12.5% of the real one.
+ */
+class LatencyHistogram
+{
+public:
+   /**
+    * The number of buckets in a histogram.
+    */
+   static const int BucketCount = 496;
+
+protected:
+   /**
+    * The number of values in each bucket.
+    */
+   volatile uint64_t mBuckets[BucketCount];
+
+   /**
+    * The number of values, their sum and the largest value.
+    */
+   volatile uint64_t mCount;
+   volatile uint64_t mTotal;
+   volatile uint64_t mMax;
+
+public:
+   /**
+    * Creates a new, empty LatencyHistogram.
+    */
+   LatencyHistogram();
+
+   /**
+    * Destructs this LatencyHistogram.
+    */
+   virtual ~LatencyHistogram();
+
+   /**
+    * Records a value.
+    *
+    * @param value the value to record.
+    */
+   virtual void record(uint64_t value);
+
+   /**
+    * Gets the number of recorded values.
+    *
+    * @return the number of recorded values.
+    */
+   virtual uint64_t getCount();
+
+   /**
+    * Gets the average of the recorded values.
+    *
+    * @return the average value, 0 if there are none.
+    */
+   virtual uint64_t getAverage();
+
+   /**
+    * Gets the largest recorded value.
+    *
+    * @return the largest value, 0 if there are none.
+    */
+   virtual uint64_t getMax();
+
+   /**
+    * Estimates a percentile of the recorded values. The estimate is the
+    * largest value that could be in the bucket the percentile falls in, but
+    * never more than the largest recorded value.
+    *
+    * @param percentile the percentile, from 0 to 100.
+    *
+    * @return the estimated percentile, 0 if there are no values.
+    */
+   virtual uint64_t getPercentile(double percentile);
+
+   /**
+    * Gets a snapshot of this histogram:
+    *
+    * {
+    *    "count": number of values,
+    *    "average": average value,
+    *    "p50": median value,
+    *    "p90": 90th percentile,
+    *    "p99": 99th percentile,
+    *    "max": largest value
+    * }
+    *
+    * @return the snapshot.
+    */
+   virtual DynamicObject getStats();
+
+   /**
+    * Clears all recorded values. Values recorded while the histogram is
+    * being cleared may be partly lost.
+    */
+   virtual void reset();
+
+   /**
+    * Gets the bucket a value is counted in.
+    *
+    * @param value the value.
+    *
+    * @return the index of the bucket.
+    */
+   static int getBucket(uint64_t value);
+
+   /**
+    * Gets the largest value that is counted in a bucket.
+    *
+    * @param bucket the index of the bucket.
+    *
+    * @return the largest value in the bucket.
+    */
+   static uint64_t getBucketLimit(int bucket);
+};
+
+} // end namespace rt
+} // end namespace monarch
+#endif
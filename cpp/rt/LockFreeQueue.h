@@ -0,0 +1,308 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#ifndef monarch_rt_LockFreeQueue_H
+#define monarch_rt_LockFreeQueue_H
+
+#include "monarch/rt/Atomic.h"
+
+#include <inttypes.h>
+
+namespace monarch
+{
+namespace rt
+{
+
+/**
+ * A LockFreeQueue is a bounded first-in first-out queue that any number of
+ * threads can push() items onto and pop() items from at the same time
+ * without locking. Its implementation is based on Dmitry Vyukov's bounded
+ * MPMC queue: every slot in a circular buffer has a sequence number that
+ * tells producers and consumers whether the slot is ready for them, so they
+ * only have to agree on a position with a single compare-and-swap. A
+ * position is only claimed once its slot is ready, so a thread that stalls
+ * in the middle of a push or pop never blocks the other threads: until it
+ * finishes, its slot just looks full to producers and empty to consumers.
+ *
+ * Items can also be pushed and popped in batches, which claims a whole
+ * range of slots at once. The items are copied in and out of the queue, so
+ * they should be small, such as pointers or small structs.
+ */
+template<typename _T>
+class LockFreeQueue
+{
+protected:
+   /**
+    * A slot in the buffer.
+    */
+   struct Cell
+   {
+      volatile uint64_t sequence;
+      _T item;
+   };
+
+   /**
+    * The buffer and the mask for its size, which is a power of 2.
+    */
+   Cell* mBuffer;
+   uint64_t mMask;
+
+   /**
+    * The position of the next push and of the next pop, kept on separate
+    * cache lines so producers and consumers do not slow each other down.
+    */
+   char mPad0[64];
+   volatile uint64_t mTail;
+   char mPad1[64];
+   volatile uint64_t mHead;
+   char mPad2[64];
+
+public:
+   /**
+    * Creates a new LockFreeQueue.
+    *
+    * @param capacity the maximum number of items, rounded up to a power of 2.
+    */
+   LockFreeQueue(unsigned int capacity = 1024);
+
+   /**
+    * Destructs this LockFreeQueue.
+    */
+   virtual ~LockFreeQueue();
+
+   /**
+    * Pushes an item onto the back of this queue.
+    *
+    * @param item the item to push.
+    *
+    * @return true if the item was pushed, false if this queue is full.
+    */
+   virtual bool push(const _T& item);
+
+   /**
+    * Pushes as many of the passed items onto the back of this queue as will
+    * fit, in order.
+    *
+    * @param items the items to push.
+    * @param count the number of items.
+    *
+    * @return the number of items that were pushed.
+    */
+   virtual unsigned int push(const _T* items, unsigned int count);
+
+   /**
+    * Pops an item from the front of this queue.
+    *
+    * @param item to store the popped item.
+    *
+    * @return true if an item was popped, false if this queue is empty.
+    */
+   virtual bool pop(_T& item);
+
+   /**
+    * Pops up to the given number of items from the front of this queue.
+    *
+    * @param items to store the popped items.
+    * @param count the maximum number of items to pop.
+    *
+    * @return the number of items that were popped.
+    */
+   virtual unsigned int pop(_T* items, unsigned int count);
+
+   /**
+    * Gets the number of items in this queue. The result is only a snapshot
+    * if other threads are using the queue.
+    *
+    * @return the number of items.
+    */
+   virtual unsigned int size();
+
+   /**
+    * Returns true if this queue is empty. The result is only a snapshot if
+    * other threads are using the queue.
+    *
+    * @return true if this queue is empty, false if not.
+    */
+   virtual bool isEmpty();
+
+   /**
+    * Gets the maximum number of items in this queue.
+    *
+    * @return the capacity of this queue.
+    */
+   virtual unsigned int capacity();
+
+protected:
+   /**
+    * Claims a range of ready slots from a position counter. The slot at
+    * position p is ready when its sequence number is p + offset: producers
+    * use an offset of 0 (the slot is empty) and consumers use an offset of
+    * 1 (the slot has been published). Only the consecutive ready slots
+    * from the current position are claimed, and they are checked before
+    * the position is advanced.
+    *
+    * @param pos the counter to claim from.
+    * @param offset the difference between a ready slot's sequence number
+    *           and its position.
+    * @param count the maximum number of positions to claim.
+    * @param start to store the first position claimed.
+    *
+    * @return the number of positions claimed.
+    */
+   virtual unsigned int claim(
+      volatile uint64_t* pos, uint64_t offset, unsigned int count,
+      uint64_t& start);
+};
+
+template<typename _T>
+LockFreeQueue<_T>::LockFreeQueue(unsigned int capacity) :
+   mTail(0),
+   mHead(0)
+{
+   uint64_t size = 2;
+   while(size < capacity)
+   {
+      size <<= 1;
+   }
+   mMask = size - 1;
+   mBuffer = new Cell[size];
+   for(uint64_t i = 0; i < size; ++i)
+   {
+      mBuffer[i].sequence = i;
+   }
+}
+
+template<typename _T>
+LockFreeQueue<_T>::~LockFreeQueue()
+{
+   delete [] mBuffer;
+}
+
+template<typename _T>
+bool LockFreeQueue<_T>::push(const _T& item)
+{
+   return push(&item, 1) == 1;
+}
+
+template<typename _T>
+unsigned int LockFreeQueue<_T>::push(const _T* items, unsigned int count)
+{
+   // claim slots that consumers from the last lap are done with
+   uint64_t start;
+   unsigned int rval = claim(&mTail, 0, count, start);
+   for(unsigned int i = 0; i < rval; ++i)
+   {
+      // write the item and publish it
+      Cell* cell = &mBuffer[(start + i) & mMask];
+      cell->item = items[i];
+      Atomic::memoryBarrier();
+      cell->sequence = start + i + 1;
+   }
+
+   return rval;
+}
+
+template<typename _T>
+bool LockFreeQueue<_T>::pop(_T& item)
+{
+   return pop(&item, 1) == 1;
+}
+
+template<typename _T>
+unsigned int LockFreeQueue<_T>::pop(_T* items, unsigned int count)
+{
+   // claim slots whose items producers have published
+   uint64_t start;
+   unsigned int rval = claim(&mHead, 1, count, start);
+   for(unsigned int i = 0; i < rval; ++i)
+   {
+      // read the item and free the slot for the next lap
+      Cell* cell = &mBuffer[(start + i) & mMask];
+      items[i] = cell->item;
+      Atomic::memoryBarrier();
+      cell->sequence = start + i + mMask + 1;
+   }
+
+   return rval;
+}
+
+template<typename _T>
+unsigned int LockFreeQueue<_T>::size()
+{
+   uint64_t head = mHead;
+   Atomic::memoryBarrier();
+   uint64_t tail = mTail;
+   return (tail > head) ? (unsigned int)(tail - head) : 0;
+}
+
+template<typename _T>
+bool LockFreeQueue<_T>::isEmpty()
+{
+   return size() == 0;
+}
+
+template<typename _T>
+unsigned int LockFreeQueue<_T>::capacity()
+{
+   return (unsigned int)(mMask + 1);
+}
+
+template<typename _T>
+unsigned int LockFreeQueue<_T>::claim(
+   volatile uint64_t* pos, uint64_t offset, unsigned int count,
+   uint64_t& start)
+{
+   unsigned int rval = 0;
+
+   bool claimed = false;
+   while(!claimed)
+   {
+      // count the ready slots from the current position
+      start = *pos;
+      Atomic::memoryBarrier();
+      rval = 0;
+      bool raced = false;
+      while(!raced && rval < count)
+      {
+         uint64_t p = start + rval;
+         uint64_t sequence = mBuffer[p & mMask].sequence;
+         if(sequence == p + offset)
+         {
+            ++rval;
+         }
+         else
+         {
+            // a sequence past the slot's lap means another thread claimed
+            // it after the position was read, anything else means the slot
+            // is not ready yet
+            raced = (int64_t)(sequence - (p + offset)) > 0;
+            if(!raced)
+            {
+               break;
+            }
+         }
+      }
+
+      if(raced)
+      {
+         rval = 0;
+      }
+      else if(rval == 0)
+      {
+         // nothing ready, retry only if the position moved meanwhile
+         Atomic::memoryBarrier();
+         claimed = (*pos == start);
+      }
+      else
+      {
+         claimed = Atomic::compareAndSwap(pos, start, start + rval);
+      }
+   }
+   Atomic::memoryBarrier();
+
+   return rval;
+}
+
+} // end namespace rt
+} // end namespace monarch
+#endif
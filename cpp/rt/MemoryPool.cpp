@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#include "monarch/rt/MemoryPool.h"
+
+using namespace monarch::rt;
+
+MemoryPool::MemoryPool(size_t blockSize, unsigned int maxFreeBlocks) :
+   mBlockSize(blockSize < sizeof(FreeBlock) ? sizeof(FreeBlock) : blockSize),
+   mMaxFreeBlocks(maxFreeBlocks)
+{
+   pthread_key_create(&mFreeListKey, &MemoryPool::cleanupFreeList);
+}
+
+MemoryPool::~MemoryPool()
+{
+   // clean up the current thread's free-list, other threads clean up their
+   // own lists when they exit
+   FreeList* list = static_cast<FreeList*>(pthread_getspecific(mFreeListKey));
+   if(list != NULL)
+   {
+      pthread_setspecific(mFreeListKey, NULL);
+      cleanupFreeList(list);
+   }
+   pthread_key_delete(mFreeListKey);
+}
+
+void* MemoryPool::allocate()
+{
+   void* rval;
+
+   FreeList* list = getFreeList();
+   if(list != NULL && list->head != NULL)
+   {
+      // reuse the most recently released block
+      FreeBlock* block = list->head;
+      list->head = block->next;
+      --list->count;
+      rval = block;
+   }
+   else
+   {
+      // free-list is empty, get a new block from the system
+      rval = malloc(mBlockSize);
+   }
+
+   return rval;
+}
+
+void MemoryPool::release(void* ptr)
+{
+   if(ptr != NULL)
+   {
+      FreeList* list = getFreeList();
+      if(list != NULL && list->count < mMaxFreeBlocks)
+      {
+         // keep the block for reuse by this thread
+         FreeBlock* block = static_cast<FreeBlock*>(ptr);
+         block->next = list->head;
+         list->head = block;
+         ++list->count;
+      }
+      else
+      {
+         // free-list is full, return the block to the system
+         free(ptr);
+      }
+   }
+}
+
+size_t MemoryPool::getBlockSize()
+{
+   return mBlockSize;
+}
+
+unsigned int MemoryPool::getFreeBlockCount()
+{
+   FreeList* list = static_cast<FreeList*>(pthread_getspecific(mFreeListKey));
+   return (list == NULL) ? 0 : list->count;
+}
+
+MemoryPool::FreeList* MemoryPool::getFreeList()
+{
+   FreeList* rval = static_cast<FreeList*>(pthread_getspecific(mFreeListKey));
+   if(rval == NULL)
+   {
+      // first use of this pool by the current thread
+      rval = static_cast<FreeList*>(malloc(sizeof(FreeList)));
+      if(rval != NULL)
+      {
+         rval->head = NULL;
+         rval->count = 0;
+         pthread_setspecific(mFreeListKey, rval);
+      }
+   }
+
+   return rval;
+}
+
+void MemoryPool::cleanupFreeList(void* list)
+{
+   if(list != NULL)
+   {
+      FreeList* fl = static_cast<FreeList*>(list);
+      FreeBlock* block = fl->head;
+      while(block != NULL)
+      {
+         FreeBlock* next = block->next;
+         free(block);
+         block = next;
+      }
+      free(fl);
+   }
+}
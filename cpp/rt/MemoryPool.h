@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#ifndef monarch_rt_MemoryPool_H
+#define monarch_rt_MemoryPool_H
+
+#include <pthread.h>
+#include <cstdlib>
+
+namespace monarch
+{
+namespace rt
+{
+
+/**
+ * A MemoryPool hands out fixed-size blocks of memory and keeps a free-list
+ * of released blocks for each thread that uses it.
+ *
+ * Allocating from and releasing to a MemoryPool never requires a lock: every
+ * thread has its own free-list, stored as thread-specific data. A block that
+ * is released by a thread other than the one that allocated it is simply put
+ * on the releasing thread's free-list. Once a thread's free-list has reached
+ * its maximum size, released blocks are returned to the system. When a thread
+ * exits, its free-list is returned to the system.
+ *
+ * A MemoryPool is intended to be created once and live for the lifetime of
+ * the process. Blocks may still be released to a MemoryPool while static
+ * objects are being destroyed, so it should not be destroyed while any of its
+ * blocks are still in use.
+ */
+class MemoryPool
+{
+protected:
+   /**
+    * A free block is linked into a thread's free-list.
+    */
+   struct FreeBlock
+   {
+      FreeBlock* next;
+   };
+
+   /**
+    * A thread's free-list.
+    */
+   struct FreeList
+   {
+      FreeBlock* head;
+      unsigned int count;
+   };
+
+   /**
+    * The size of every block in this pool.
+    */
+   size_t mBlockSize;
+
+   /**
+    * The maximum number of free blocks to keep per thread.
+    */
+   unsigned int mMaxFreeBlocks;
+
+   /**
+    * The thread-specific data key for each thread's free-list.
+    */
+   pthread_key_t mFreeListKey;
+
+public:
+   /**
+    * Creates a new MemoryPool.
+    *
+    * @param blockSize the size of every block in the pool.
+    * @param maxFreeBlocks the maximum number of free blocks to keep around
+    *           for each thread.
+    */
+   MemoryPool(size_t blockSize, unsigned int maxFreeBlocks = 1024);
+
+   /**
+    * Destructs this MemoryPool. The calling thread's free-list is returned
+    * to the system.
+    */
+   virtual ~MemoryPool();
+
+   /**
+    * Allocates a block from this pool.
+    *
+    * @return the allocated block or NULL if no memory was available.
+    */
+   virtual void* allocate();
+
+   /**
+    * Releases a block back to this pool. The block must have been
+    * allocated by this pool.
+    *
+    * @param ptr the block to release, NULL is ignored.
+    */
+   virtual void release(void* ptr);
+
+   /**
+    * Gets the size of the blocks in this pool.
+    *
+    * @return the size of the blocks in this pool.
+    */
+   virtual size_t getBlockSize();
+
+   /**
+    * Gets the number of free blocks kept for the current thread.
+    *
+    * @return the number of free blocks kept for the current thread.
+    */
+   virtual unsigned int getFreeBlockCount();
+
+protected:
+   /**
+    * Gets the current thread's free-list, creating it if necessary.
+    *
+    * @return the current thread's free-list or NULL if it could not be
+    *         created.
+    */
+   virtual FreeList* getFreeList();
+
+   /**
+    * Returns all the blocks in a free-list to the system and frees the list.
+    * This is called when a thread that used this pool exits.
+    *
+    * @param list the FreeList to clean up.
+    */
+   static void cleanupFreeList(void* list);
+};
+
+} // end namespace rt
+} // end namespace monarch
+#endif
@@ -1,30 +1,84 @@
 /*
- * Copyright (c) 2007-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2007-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #include "monarch/rt/Monitor.h"
 
+#include "monarch/rt/Atomic.h"
+#include "monarch/rt/System.h"
 #include "monarch/rt/Thread.h"
 #include "monarch/rt/TimeFunctions.h"
 
+#include <climits>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define MO_FUTEX
+#endif
+
 using namespace monarch::rt;
 
-Monitor::Monitor()
+// the most times an adaptive monitor spins before parking
+#define MAX_SPINS   1000
+
+// the most pause instructions between two spins
+#define MAX_BACKOFF 64
+
+#ifdef MO_FUTEX
+static inline int futexWait(
+   volatile int* addr, int value, const struct timespec* timeout)
 {
-   // create mutex attributes
-   pthread_mutexattr_t mutexAttr;
-   pthread_mutexattr_init(&mutexAttr);
+   return syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, value, timeout, NULL, 0);
+}
 
-   // use fastest type of mutex
-   pthread_mutexattr_settype(&mutexAttr, PTHREAD_MUTEX_NORMAL);
+static inline void futexWake(volatile int* addr, int count)
+{
+   syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+#endif
 
-   // initialize mutex
-   pthread_mutex_init(&mMutex, &mutexAttr);
+static inline void cpuRelax()
+{
+#if defined(__i386__) || defined(__x86_64__)
+   __asm__ __volatile__("pause" ::: "memory");
+#elif defined(__aarch64__)
+   __asm__ __volatile__("yield" ::: "memory");
+#else
+   __asm__ __volatile__("" ::: "memory");
+#endif
+}
 
-   // initialize wait conditional
-   pthread_cond_init(&mWaitCondition, NULL);
+Monitor::Monitor(bool adaptive) :
+   mAdaptive(adaptive),
+   mFutex(0),
+   mSequence(0),
+   mWaiters(0),
+   mSpins(0)
+{
+#ifndef MO_FUTEX
+   // adaptive monitors need futexes
+   mAdaptive = false;
+#endif
 
-   // destroy mutex attributes
-   pthread_mutexattr_destroy(&mutexAttr);
+   if(!mAdaptive)
+   {
+      // create mutex attributes
+      pthread_mutexattr_t mutexAttr;
+      pthread_mutexattr_init(&mutexAttr);
+
+      // use fastest type of mutex
+      pthread_mutexattr_settype(&mutexAttr, PTHREAD_MUTEX_NORMAL);
+
+      // initialize mutex
+      pthread_mutex_init(&mMutex, &mutexAttr);
+
+      // initialize wait conditional
+      pthread_cond_init(&mWaitCondition, NULL);
+
+      // destroy mutex attributes
+      pthread_mutexattr_destroy(&mutexAttr);
+   }
 
    // no thread in monitor, no locks yet
    mThreadId = Thread::sInvalidThreadId;
@@ -33,11 +87,14 @@ Monitor::Monitor()
 
 Monitor::~Monitor()
 {
-   // destroy mutex
-   pthread_mutex_destroy(&mMutex);
+   if(!mAdaptive)
+   {
+      // destroy mutex
+      pthread_mutex_destroy(&mMutex);
 
-   // destroy wait conditional
-   pthread_cond_destroy(&mWaitCondition);
+      // destroy wait conditional
+      pthread_cond_destroy(&mWaitCondition);
+   }
 }
 
 void Monitor::enter()
@@ -48,7 +105,14 @@ void Monitor::enter()
    if(rc == 0)
    {
       // lock this monitor's mutex
-      pthread_mutex_lock(&mMutex);
+      if(mAdaptive)
+      {
+         lockFutex();
+      }
+      else
+      {
+         pthread_mutex_lock(&mMutex);
+      }
 
       // set thread that is in this monitor
       mThreadId = self;
@@ -68,7 +132,9 @@ bool Monitor::tryEnter()
    if(rc == 0)
    {
       // try to lock this monitor's mutex
-      if(pthread_mutex_trylock(&mMutex) == 0)
+      if(mAdaptive ?
+         Atomic::compareAndSwap(&mFutex, 0, 1) :
+         pthread_mutex_trylock(&mMutex) == 0)
       {
          // lock acquired, set thread that is in this monitor
          mThreadId = self;
@@ -100,7 +166,14 @@ void Monitor::exit()
       mThreadId = Thread::sInvalidThreadId;
 
       // unlock this monitor's mutex
-      pthread_mutex_unlock(&mMutex);
+      if(mAdaptive)
+      {
+         unlockFutex();
+      }
+      else
+      {
+         pthread_mutex_unlock(&mMutex);
+      }
    }
 }
 
@@ -114,6 +187,33 @@ void Monitor::wait(uint32_t timeout)
    mThreadId = Thread::sInvalidThreadId;
    mLockCount = 0;
 
+#ifdef MO_FUTEX
+   if(mAdaptive)
+   {
+      // get the sequence number before unlocking so that any notify after
+      // unlocking changes it and the futex does not wait
+      int sequence = mSequence;
+      Atomic::incrementAndFetch(&mWaiters);
+      unlockFutex();
+
+      if(timeout == 0)
+      {
+         futexWait(&mSequence, sequence, NULL);
+      }
+      else
+      {
+         // futexes take a relative timeout
+         struct timespec to;
+         to.tv_sec = timeout / 1000UL;
+         to.tv_nsec = timeout % 1000UL * 1000000UL;
+         futexWait(&mSequence, sequence, &to);
+      }
+
+      lockFutex();
+      Atomic::decrementAndFetch(&mWaiters);
+   }
+   else
+#endif
    if(timeout == 0)
    {
       // wait indefinitely on the wait condition
@@ -133,6 +233,13 @@ void Monitor::wait(uint32_t timeout)
       // add timeout to current time (1 microsecond = 1000 nanoseconds)
       to.tv_sec = now.tv_sec + secs;
       to.tv_nsec = now.tv_usec * 1000UL + nsecs;
+      if(to.tv_nsec >= 1000000000L)
+      {
+         // carry into seconds, an out of range value makes the wait fail
+         // immediately without releasing the mutex
+         ++to.tv_sec;
+         to.tv_nsec -= 1000000000L;
+      }
 
       // do timed wait
       pthread_cond_timedwait(&mWaitCondition, &mMutex, &to);
@@ -145,8 +252,15 @@ void Monitor::wait(uint32_t timeout)
 
 void Monitor::notify()
 {
-   // signal a thread locked on the conditional to wake up
-   pthread_cond_signal(&mWaitCondition);
+   if(mAdaptive)
+   {
+      wakeWaiters(1);
+   }
+   else
+   {
+      // signal a thread locked on the conditional to wake up
+      pthread_cond_signal(&mWaitCondition);
+   }
 }
 
 void Monitor::notifyAll()
@@ -157,6 +271,90 @@ void Monitor::notifyAll()
 
 void Monitor::signalAll()
 {
-   // signal all threads locked on the conditional to wake up
-   pthread_cond_broadcast(&mWaitCondition);
+   if(mAdaptive)
+   {
+      wakeWaiters(INT_MAX);
+   }
+   else
+   {
+      // signal all threads locked on the conditional to wake up
+      pthread_cond_broadcast(&mWaitCondition);
+   }
+}
+
+bool Monitor::isAdaptive()
+{
+   return mAdaptive;
+}
+
+void Monitor::lockFutex()
+{
+#ifdef MO_FUTEX
+   // try to take the lock word without contention first
+   if(!Atomic::compareAndSwap(&mFutex, 0, 1))
+   {
+      // spin with exponential backoff for up to about twice as long as it
+      // has recently taken to get the lock, spinning is pointless if no
+      // other cpu can release the lock meanwhile
+      static int cpus = System::getCpuCoreCount();
+      int limit = 0;
+      if(cpus > 1)
+      {
+         limit = mSpins * 2 + 16;
+         limit = (limit > MAX_SPINS) ? MAX_SPINS : limit;
+      }
+      bool locked = false;
+      int spins = 0;
+      for(int backoff = 1; !locked && spins < limit; ++spins)
+      {
+         for(int i = 0; i < backoff; ++i)
+         {
+            cpuRelax();
+         }
+         if(backoff < MAX_BACKOFF)
+         {
+            backoff <<= 1;
+         }
+         locked = (mFutex == 0 && Atomic::compareAndSwap(&mFutex, 0, 1));
+      }
+
+      if(!locked)
+      {
+         // park until the lock word is released, marking it contended so
+         // that the holder wakes up a parked thread
+         while(Atomic::exchange(&mFutex, 2) != 0)
+         {
+            futexWait(&mFutex, 2, NULL);
+         }
+      }
+
+      // adapt: spin about as long as it took to get the lock by spinning,
+      // and less after spinning did not help
+      mSpins += ((locked ? spins : 0) - mSpins) / 8;
+   }
+#endif
+}
+
+void Monitor::unlockFutex()
+{
+#ifdef MO_FUTEX
+   // a single atomic decrement releases an uncontended lock word
+   if(Atomic::decrementAndFetch(&mFutex) != 0)
+   {
+      // a thread may be parked, release the lock word and wake it up
+      mFutex = 0;
+      futexWake(&mFutex, 1);
+   }
+#endif
+}
+
+void Monitor::wakeWaiters(int count)
+{
+#ifdef MO_FUTEX
+   if(mWaiters > 0)
+   {
+      Atomic::incrementAndFetch(&mSequence);
+      futexWake(&mSequence, count);
+   }
+#endif
 }
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2007-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2007-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #ifndef monarch_rt_Monitor_H
 #define monarch_rt_Monitor_H
@@ -30,6 +30,15 @@ namespace rt
  *
  * monarch::rt::Thread disallows threads from being created with an invalid ID.
  *
+ * A Monitor can be adaptive. An adaptive Monitor does not use a pthread
+ * mutex and condition. Instead, a thread that finds it locked spins for a
+ * while, with exponential backoff, before it parks itself in the kernel
+ * using a futex. The number of spins adapts to how long it has recently
+ * taken to acquire the lock. This avoids context switches when other
+ * threads only hold the Monitor briefly. Waiting threads are also parked
+ * using a futex. Adaptive Monitors are only available on Linux; elsewhere
+ * they behave like other Monitors.
+ *
  * @author Dave Longley
  */
 class Monitor
@@ -55,11 +64,58 @@ private:
     */
    uint32_t mLockCount;
 
+   /**
+    * True if this Monitor is adaptive.
+    */
+   bool mAdaptive;
+
+   /**
+    * The futex lock word for an adaptive Monitor: 0 if unlocked, 1 if
+    * locked and 2 if locked with threads that may be parked.
+    */
+   volatile int mFutex;
+
+   /**
+    * The futex sequence number for an adaptive Monitor, changed by every
+    * notify so that waiting threads wake up.
+    */
+   volatile int mSequence;
+
+   /**
+    * The number of threads waiting on an adaptive Monitor.
+    */
+   volatile int mWaiters;
+
+   /**
+    * The recent average number of spins needed to lock an adaptive Monitor.
+    */
+   int mSpins;
+
+   /**
+    * Locks the futex lock word of an adaptive Monitor.
+    */
+   void lockFutex();
+
+   /**
+    * Unlocks the futex lock word of an adaptive Monitor.
+    */
+   void unlockFutex();
+
+   /**
+    * Wakes up threads waiting on an adaptive Monitor.
+    *
+    * @param count the maximum number of threads to wake up.
+    */
+   void wakeWaiters(int count);
+
 public:
    /**
     * Creates a new Monitor.
+    *
+    * @param adaptive true to spin before blocking and use futexes, false to
+    *           use a pthread mutex and condition.
     */
-   Monitor();
+   Monitor(bool adaptive = false);
 
    /**
     * Destructs this Monitor.
@@ -118,6 +174,14 @@ public:
     * re-entering (or deciding not to) a waiting state.
     */
    void signalAll();
+
+   /**
+    * Returns true if this Monitor is adaptive, false if it uses a pthread
+    * mutex and condition.
+    *
+    * @return true if this Monitor is adaptive, false if not.
+    */
+   bool isAdaptive();
 };
 
 } // end namespace rt
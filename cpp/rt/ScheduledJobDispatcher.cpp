@@ -0,0 +1,273 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#include "monarch/rt/ScheduledJobDispatcher.h"
+
+#include "monarch/rt/RunnableDelegate.h"
+
+using namespace std;
+using namespace monarch::rt;
+
+ScheduledJobDispatcher::ScheduledRun::ScheduledRun(
+   ScheduledJobDispatcher* dispatcher, ScheduledJobRef& sj) :
+   mDispatcher(dispatcher),
+   mJob(sj)
+{
+   mDispatcher->mScheduleLock.lock();
+   ++mDispatcher->mRuns;
+   mDispatcher->mScheduleLock.unlock();
+}
+
+ScheduledJobDispatcher::ScheduledRun::~ScheduledRun()
+{
+   // the thread pool drops its reference once this has run and the queue
+   // drops its reference when this is cleared without running
+   mDispatcher->mScheduleLock.lock();
+   if(--mDispatcher->mRuns == 0)
+   {
+      mDispatcher->mScheduleLock.notifyAll();
+   }
+   mDispatcher->mScheduleLock.unlock();
+}
+
+void ScheduledJobDispatcher::ScheduledRun::run()
+{
+   mDispatcher->runScheduledJob(mJob);
+}
+
+ScheduledJobDispatcher::ScheduledJobDispatcher() :
+   JobDispatcher(),
+   mRuns(0),
+   mScheduledRuns(0),
+   mCoalescedCount(0)
+{
+}
+
+ScheduledJobDispatcher::ScheduledJobDispatcher(
+   ThreadPool* pool, bool cleanupPool, uint32_t tickLength) :
+   JobDispatcher(pool, cleanupPool),
+   mTimers(tickLength),
+   mRuns(0),
+   mScheduledRuns(0),
+   mCoalescedCount(0)
+{
+}
+
+ScheduledJobDispatcher::~ScheduledJobDispatcher()
+{
+   // stop the timers and the dispatcher thread so no more runs are queued
+   // or given to the thread pool, then drop the scheduled jobs
+   ScheduledJobDispatcher::stopDispatching();
+   ScheduledJobDispatcher::cancelAll();
+
+   // drop the runs that are still queued and wait for the thread pool to
+   // finish the others, they use this dispatcher
+   clearQueuedJobs();
+   mScheduleLock.lock();
+   while(mRuns > 0)
+   {
+      mScheduleLock.wait();
+   }
+   mScheduleLock.unlock();
+}
+
+ScheduledJobRef ScheduledJobDispatcher::schedule(
+   RunnableRef& job, uint32_t delay)
+{
+   return scheduleJob(job, ScheduledJob::Once, delay, 0);
+}
+
+ScheduledJobRef ScheduledJobDispatcher::scheduleAtFixedRate(
+   RunnableRef& job, uint32_t initialDelay, uint32_t period)
+{
+   return scheduleJob(job, ScheduledJob::FixedRate, initialDelay, period);
+}
+
+ScheduledJobRef ScheduledJobDispatcher::scheduleWithFixedDelay(
+   RunnableRef& job, uint32_t initialDelay, uint32_t delay)
+{
+   return scheduleJob(job, ScheduledJob::FixedDelay, initialDelay, delay);
+}
+
+bool ScheduledJobDispatcher::cancel(ScheduledJobRef& sj)
+{
+   bool rval = false;
+
+   mScheduleLock.lock();
+   {
+      if(!sj->cancelled)
+      {
+         removeScheduledJob(sj);
+         rval = true;
+      }
+   }
+   mScheduleLock.unlock();
+
+   return rval;
+}
+
+void ScheduledJobDispatcher::cancelAll()
+{
+   mScheduleLock.lock();
+   {
+      while(!mScheduledJobs.empty())
+      {
+         // copy the reference, removing the job erases it from the list
+         ScheduledJobRef sj = mScheduledJobs.front();
+         removeScheduledJob(sj);
+      }
+   }
+   mScheduleLock.unlock();
+}
+
+unsigned int ScheduledJobDispatcher::getScheduledJobCount()
+{
+   unsigned int rval;
+
+   mScheduleLock.lock();
+   {
+      rval = mScheduledJobs.size();
+   }
+   mScheduleLock.unlock();
+
+   return rval;
+}
+
+void ScheduledJobDispatcher::startDispatching()
+{
+   JobDispatcher::startDispatching();
+   mTimers.start();
+}
+
+void ScheduledJobDispatcher::stopDispatching()
+{
+   mTimers.stop();
+   JobDispatcher::stopDispatching();
+}
+
+DynamicObject ScheduledJobDispatcher::getStats()
+{
+   DynamicObject rval = JobDispatcher::getStats();
+   rval["scheduled"] = getScheduledJobCount();
+   rval["scheduledRuns"] = (uint64_t)mScheduledRuns;
+   rval["coalesced"] = (uint64_t)mCoalescedCount;
+   return rval;
+}
+
+void ScheduledJobDispatcher::resetStats()
+{
+   JobDispatcher::resetStats();
+   mScheduledRuns = 0;
+   mCoalescedCount = 0;
+}
+
+ScheduledJobRef ScheduledJobDispatcher::scheduleJob(
+   RunnableRef& job, ScheduledJob::Type type,
+   uint32_t delay, uint32_t period)
+{
+   ScheduledJobRef sj = new ScheduledJob;
+   sj->job = job;
+   sj->type = type;
+   sj->period = (type != ScheduledJob::Once && period == 0) ? 1 : period;
+   sj->pending = false;
+   sj->cancelled = false;
+
+   mScheduleLock.lock();
+   {
+      sj->position = mScheduledJobs.insert(mScheduledJobs.end(), sj);
+      startTimer(sj, delay);
+   }
+   mScheduleLock.unlock();
+
+   return sj;
+}
+
+void ScheduledJobDispatcher::startTimer(ScheduledJobRef& sj, uint32_t delay)
+{
+   // the timer references the scheduled job until it is dropped when the
+   // job is removed or the timer is done
+   RunnableRef r = new RunnableDelegate<
+      ScheduledJobDispatcher, ScheduledJobRef>(
+         this, &ScheduledJobDispatcher::jobDue, sj);
+   sj->timer = mTimers.schedule(
+      r, delay, (sj->type == ScheduledJob::FixedRate) ? sj->period : 0);
+}
+
+void ScheduledJobDispatcher::removeScheduledJob(ScheduledJobRef& sj)
+{
+   sj->cancelled = true;
+   if(!sj->timer.isNull())
+   {
+      mTimers.cancel(sj->timer);
+      sj->timer.setNull();
+   }
+   mScheduledJobs.erase(sj->position);
+}
+
+void ScheduledJobDispatcher::jobDue(ScheduledJobRef sj)
+{
+   bool queue = false;
+
+   mScheduleLock.lock();
+   {
+      if(!sj->cancelled)
+      {
+         // coalesce with a run that is still queued or running
+         if(sj->pending)
+         {
+            Atomic::incrementAndFetch(&mCoalescedCount);
+         }
+         else
+         {
+            sj->pending = true;
+            queue = true;
+         }
+
+         // a one-shot timer is done
+         if(sj->type != ScheduledJob::FixedRate)
+         {
+            sj->timer.setNull();
+         }
+      }
+   }
+   mScheduleLock.unlock();
+
+   if(queue)
+   {
+      Atomic::incrementAndFetch(&mScheduledRuns);
+      RunnableRef r = new ScheduledRun(this, sj);
+      queueJob(r);
+   }
+}
+
+void ScheduledJobDispatcher::runScheduledJob(ScheduledJobRef sj)
+{
+   // do not start a run that was cancelled while it was queued
+   mScheduleLock.lock();
+   bool run = !sj->cancelled;
+   mScheduleLock.unlock();
+
+   if(run)
+   {
+      sj->job->run();
+   }
+
+   mScheduleLock.lock();
+   {
+      sj->pending = false;
+      if(!sj->cancelled)
+      {
+         if(sj->type == ScheduledJob::Once)
+         {
+            // finished
+            removeScheduledJob(sj);
+         }
+         else if(sj->type == ScheduledJob::FixedDelay)
+         {
+            // wait for the delay after the end of this run
+            startTimer(sj, sj->period);
+         }
+      }
+   }
+   mScheduleLock.unlock();
+}
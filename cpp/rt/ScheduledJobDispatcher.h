@@ -0,0 +1,271 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#ifndef monarch_rt_ScheduledJobDispatcher_H
+#define monarch_rt_ScheduledJobDispatcher_H
+
+#include "monarch/rt/JobDispatcher.h"
+#include "monarch/rt/TimingWheel.h"
+
+namespace monarch
+{
+namespace rt
+{
+
+/**
+ * A ScheduledJob is a job that a ScheduledJobDispatcher runs after a delay,
+ * once or repeatedly. It is used to cancel the job.
+ */
+struct ScheduledJob;
+typedef Collectable<ScheduledJob> ScheduledJobRef;
+struct ScheduledJob
+{
+   /**
+    * The ways a job can be repeated.
+    */
+   enum Type
+   {
+      Once,
+      FixedRate,
+      FixedDelay
+   };
+
+   RunnableRef job;
+   Type type;
+   uint32_t period;
+   bool pending;
+   bool cancelled;
+   TimingWheel::TimerRef timer;
+   std::list<ScheduledJobRef>::iterator position;
+};
+
+/**
+ * A ScheduledJobDispatcher is a JobDispatcher that can also run jobs after a
+ * delay, either once, at a fixed rate, or with a fixed delay between the end
+ * of one run and the start of the next.
+ *
+ * Scheduled jobs are timers on a TimingWheel that is advanced by a single
+ * thread while the dispatcher is dispatching. When a timer is due its job is
+ * queued like any other job and run on the ThreadPool, so no thread is
+ * used per scheduled job and all timers that are due in the same tick are
+ * queued together.
+ *
+ * A repeated job never runs concurrently with itself. If its timer is due
+ * while it is still queued or running, the timer is coalesced with the
+ * pending run instead of queueing the job again.
+ */
+class ScheduledJobDispatcher : public JobDispatcher
+{
+protected:
+   /**
+    * The timers for scheduled jobs.
+    */
+   TimingWheel mTimers;
+
+   /**
+    * The jobs that are scheduled and have not been cancelled or finished.
+    */
+   typedef std::list<ScheduledJobRef> ScheduledJobList;
+   ScheduledJobList mScheduledJobs;
+
+   /**
+    * A lock for the scheduled jobs.
+    */
+   ExclusiveLock mScheduleLock;
+
+   /**
+    * A ScheduledRun is a run of a scheduled job that has been queued. It
+    * exists until it has run or is dropped from the queue, and the
+    * dispatcher counts the ones that exist so it can wait for the ones its
+    * ThreadPool has yet to finish before it is destroyed.
+    */
+   class ScheduledRun : public Runnable
+   {
+   protected:
+      ScheduledJobDispatcher* mDispatcher;
+      ScheduledJobRef mJob;
+
+   public:
+      ScheduledRun(ScheduledJobDispatcher* dispatcher, ScheduledJobRef& sj);
+      virtual ~ScheduledRun();
+      virtual void run();
+   };
+   friend class ScheduledRun;
+
+   /**
+    * The number of ScheduledRuns that exist, guarded by the schedule lock.
+    */
+   uint32_t mRuns;
+
+   /**
+    * Statistics: the number of scheduled jobs that were queued and the
+    * number of timers that were coalesced with a pending run.
+    */
+   volatile uint64_t mScheduledRuns;
+   volatile uint64_t mCoalescedCount;
+
+public:
+   /**
+    * Creates a new ScheduledJobDispatcher with 10 threads that have an idle
+    * expiration time of 2 minutes.
+    */
+   ScheduledJobDispatcher();
+
+   /**
+    * Creates a new ScheduledJobDispatcher with the given ThreadPool.
+    *
+    * @param pool the ThreadPool to dispatch jobs to.
+    * @param cleanupPool true to free the passed ThreadPool upon destruction,
+    *                    false not to.
+    * @param tickLength the length of a timer tick in milliseconds, timers
+    *                   that are due in the same tick are queued together.
+    */
+   ScheduledJobDispatcher(
+      ThreadPool* pool, bool cleanupPool, uint32_t tickLength = 1);
+
+   /**
+    * Destructs this ScheduledJobDispatcher. It stops dispatching, cancels
+    * all scheduled jobs and drops queued jobs, and then waits for the runs
+    * of scheduled jobs that its ThreadPool has started to finish.
+    */
+   virtual ~ScheduledJobDispatcher();
+
+   /**
+    * Schedules a job to run once after a delay.
+    *
+    * @param job the job to run.
+    * @param delay the delay in milliseconds.
+    *
+    * @return the scheduled job.
+    */
+   virtual ScheduledJobRef schedule(RunnableRef& job, uint32_t delay);
+
+   /**
+    * Schedules a job to run after an initial delay and then every period,
+    * measured from the start of each run. Runs that are missed because the
+    * job is still running are skipped.
+    *
+    * @param job the job to run.
+    * @param initialDelay the delay before the first run in milliseconds.
+    * @param period the period in milliseconds.
+    *
+    * @return the scheduled job.
+    */
+   virtual ScheduledJobRef scheduleAtFixedRate(
+      RunnableRef& job, uint32_t initialDelay, uint32_t period);
+
+   /**
+    * Schedules a job to run after an initial delay and then repeatedly with
+    * a delay between the end of each run and the start of the next.
+    *
+    * @param job the job to run.
+    * @param initialDelay the delay before the first run in milliseconds.
+    * @param delay the delay between runs in milliseconds.
+    *
+    * @return the scheduled job.
+    */
+   virtual ScheduledJobRef scheduleWithFixedDelay(
+      RunnableRef& job, uint32_t initialDelay, uint32_t delay);
+
+   /**
+    * Cancels a scheduled job. A run that has already started will finish,
+    * but one that is queued will not start.
+    *
+    * @param sj the scheduled job.
+    *
+    * @return true if the job was cancelled, false if it was already cancelled
+    *         or had finished.
+    */
+   virtual bool cancel(ScheduledJobRef& sj);
+
+   /**
+    * Cancels all scheduled jobs.
+    */
+   virtual void cancelAll();
+
+   /**
+    * Gets the number of scheduled jobs that have not been cancelled or
+    * finished.
+    *
+    * @return the number of scheduled jobs.
+    */
+   virtual unsigned int getScheduledJobCount();
+
+   /**
+    * Starts dispatching jobs and running scheduled jobs.
+    */
+   virtual void startDispatching();
+
+   /**
+    * Stops dispatching jobs and running scheduled jobs. Scheduled jobs that
+    * are due while stopped run once dispatching starts again.
+    */
+   virtual void stopDispatching();
+
+   /**
+    * Gets statistics for this dispatcher. In addition to the statistics of a
+    * JobDispatcher:
+    *
+    * "scheduled": the number of scheduled jobs.
+    * "scheduledRuns": the number of times a scheduled job was queued.
+    * "coalesced": the number of timers coalesced with a pending run.
+    *
+    * @return the statistics.
+    */
+   virtual DynamicObject getStats();
+
+   /**
+    * Resets the statistics for this dispatcher.
+    */
+   virtual void resetStats();
+
+protected:
+   /**
+    * Schedules a job. The schedule lock must not be engaged.
+    *
+    * @param job the job to run.
+    * @param type the way to repeat the job.
+    * @param delay the delay before the first run in milliseconds.
+    * @param period the period or delay between runs in milliseconds.
+    *
+    * @return the scheduled job.
+    */
+   virtual ScheduledJobRef scheduleJob(
+      RunnableRef& job, ScheduledJob::Type type,
+      uint32_t delay, uint32_t period);
+
+   /**
+    * Starts the timer for the next run of a scheduled job. The schedule lock
+    * must be engaged.
+    *
+    * @param sj the scheduled job.
+    * @param delay the delay in milliseconds.
+    */
+   virtual void startTimer(ScheduledJobRef& sj, uint32_t delay);
+
+   /**
+    * Removes a job that has been cancelled or has finished. The schedule
+    * lock must be engaged.
+    *
+    * @param sj the scheduled job.
+    */
+   virtual void removeScheduledJob(ScheduledJobRef& sj);
+
+   /**
+    * Called when the timer for a scheduled job is due to queue the job.
+    *
+    * @param sj the scheduled job.
+    */
+   virtual void jobDue(ScheduledJobRef sj);
+
+   /**
+    * Runs a scheduled job on the ThreadPool.
+    *
+    * @param sj the scheduled job.
+    */
+   virtual void runScheduledJob(ScheduledJobRef sj);
+};
+
+} // end namespace rt
+} // end namespace monarch
+#endif
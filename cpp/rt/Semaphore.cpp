@@ -3,14 +3,17 @@
  */
 #include "monarch/rt/Semaphore.h"
 
+#include "monarch/rt/Atomic.h"
 #include "monarch/rt/Thread.h"
 
 using namespace std;
 using namespace monarch::rt;
 
-Semaphore::Semaphore(int permits, bool fair) :
+Semaphore::Semaphore(int permits, bool fair, bool adaptive) :
+   ExclusiveLock(adaptive),
    mPermits(permits),
    mPermitsLeft(permits),
+   mWaiting(0),
    mFair(fair)
 {
 }
@@ -21,18 +24,40 @@ Semaphore::~Semaphore()
 
 int Semaphore::increasePermitsLeft(int increase)
 {
+   int rval;
+
    // only increase, at most, by the difference between the
    // max permit count and the permits left
-   int permits = mPermits - mPermitsLeft;
-   increase = (permits < increase) ? permits : increase;
-   mPermitsLeft += increase;
+   int left;
+   do
+   {
+      left = mPermitsLeft;
+      int permits = mPermits - left;
+      rval = (permits < increase) ? permits : increase;
+      rval = (rval < 0) ? 0 : rval;
+   }
+   while(!Atomic::compareAndSwap(&mPermitsLeft, left, left + rval));
 
-   return increase;
+   return rval;
 }
 
 inline void Semaphore::decreasePermitsLeft(int decrease)
 {
-   mPermitsLeft -= decrease;
+   Atomic::addAndFetch(&mPermitsLeft, -decrease);
+}
+
+bool Semaphore::tryDecreasePermitsLeft(int decrease)
+{
+   bool rval = false;
+
+   int left = mPermitsLeft;
+   while(!rval && left - decrease >= 0)
+   {
+      rval = Atomic::compareAndSwap(&mPermitsLeft, left, left - decrease);
+      left = mPermitsLeft;
+   }
+
+   return rval;
 }
 
 bool Semaphore::waitThread(Thread* t)
@@ -108,23 +133,27 @@ bool Semaphore::acquire(int permits)
 {
    bool rval = true;
 
-   lock();
+   // take the permits without locking if no other thread is waiting
+   if(mWaiting > 0 || !tryDecreasePermitsLeft(permits))
    {
-      // see if enough permits are available
-      Thread* t = Thread::currentThread();
-      while(rval && availablePermits() - permits < 0)
+      lock();
       {
-         // must wait for permits
-         rval = waitThread(t);
-      }
-
-      if(rval)
-      {
-         // permits have been granted, decrease permits left
-         decreasePermitsLeft(permits);
+         // count this thread as waiting before checking the permits so
+         // that a releasing thread either sees it or leaves enough permits
+         Atomic::incrementAndFetch(&mWaiting);
+
+         // see if enough permits are available
+         Thread* t = Thread::currentThread();
+         while(rval && !tryDecreasePermitsLeft(permits))
+         {
+            // must wait for permits
+            rval = waitThread(t);
+         }
+
+         Atomic::decrementAndFetch(&mWaiting);
       }
+      unlock();
    }
-   unlock();
 
    return rval;
 }
@@ -136,22 +165,7 @@ bool Semaphore::tryAcquire()
 
 bool Semaphore::tryAcquire(int permits)
 {
-   bool rval = false;
-
-   lock();
-   {
-      if(availablePermits() - permits >= 0)
-      {
-         // decrease permits left
-         decreasePermitsLeft(permits);
-
-         // permits granted
-         rval = true;
-      }
-   }
-   unlock();
-
-   return rval;
+   return tryDecreasePermitsLeft(permits);
 }
 
 void Semaphore::release()
@@ -161,17 +175,18 @@ void Semaphore::release()
 
 int Semaphore::release(int permits)
 {
-   int rval = 0;
+   // increase the number of permits left
+   int rval = increasePermitsLeft(permits);
 
-   lock();
+   // notify threads for number of permits, if any are waiting
+   if(mWaiting > 0)
    {
-      // increase the number of permits left
-      rval = increasePermitsLeft(permits);
-
-      // notify threads for number of permits
-      notifyThreads(permits);
+      lock();
+      {
+         notifyThreads(permits);
+      }
+      unlock();
    }
-   unlock();
 
    return rval;
 }
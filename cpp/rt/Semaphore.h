@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2007-2009 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2007-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #ifndef monarch_rt_Semaphore_H
 #define monarch_rt_Semaphore_H
@@ -20,6 +20,11 @@ class Thread;
  * A Semaphore class that stores the maximum number of permits allowed
  * to be issued -- and allows that number to be dynamically modified.
  *
+ * Permits are acquired and released using atomic operations while no
+ * thread is waiting for one, the lock is only used to block and wake up
+ * threads. An adaptive Semaphore also spins briefly before blocking on its
+ * lock, see Monitor.
+ *
  * @author Dave Longley
  */
 class Semaphore : public virtual ExclusiveLock
@@ -33,7 +38,13 @@ protected:
    /**
     * The number of permits left.
     */
-   int mPermitsLeft;
+   volatile int mPermitsLeft;
+
+   /**
+    * The number of threads that are acquiring permits while holding the
+    * lock. Permits are only acquired without the lock while this is 0.
+    */
+   volatile int mWaiting;
 
    /**
     * True if this semaphore guarantees FIFO, false if not.
@@ -71,6 +82,17 @@ protected:
     */
    void decreasePermitsLeft(int decrease);
 
+   /**
+    * Decreases the number of permits left by the specified number if that
+    * many permits are left.
+    *
+    * @param decrease the number of permits to decrease by.
+    *
+    * @return true if the permits were decreased, false if not enough were
+    *         left.
+    */
+   bool tryDecreasePermitsLeft(int decrease);
+
    /**
     * Tells the current thread to wait.
     *
@@ -106,8 +128,9 @@ public:
     *
     * @param permits the number of permits.
     * @param fair true if this semaphore guarantees FIFO, false if not.
+    * @param adaptive true to spin before blocking, false to block right away.
     */
-   Semaphore(int permits, bool fair);
+   Semaphore(int permits, bool fair, bool adaptive = false);
 
    /**
     * Destructs this Semaphore.
@@ -1,8 +1,13 @@
 /*
- * Copyright (c) 2008-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2008-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #include "monarch/rt/SharedLock.h"
 
+#include "monarch/rt/Atomic.h"
+#include "monarch/rt/System.h"
+
+#include <cstdlib>
+
 using namespace monarch::rt;
 
 /*
@@ -31,11 +36,19 @@ using namespace monarch::rt;
  on Windows or Mac OS, we provide a custom implementation using mutexes
  and wait conditions to provide correctness w/respect to recursive shared
  locks.
+
+ A big reader lock does not use a pthread_rwlock on Linux. Every thread is
+ given a reader slot, round-robin, the first time it takes a shared lock on
+ a big reader lock and counts its shared locks in that slot. A thread
+ that wants the exclusive lock holds a mutex, sets a flag that makes new
+ readers back off and wait for the mutex, and then waits for every slot to
+ drain. A thread that already holds a shared lock does not touch its slot
+ again, so it can recurse even when the flag is set.
  */
 
 #if defined(WIN32) || defined(MACOS)
 // windows & macos:
-SharedLock::SharedLock() :
+SharedLock::SharedLock(bool bigReader) :
    mThreadId(Thread::sInvalidThreadId),
    mSharedCount(0),
    mExclusiveCount(0),
@@ -196,12 +209,62 @@ void SharedLock::unlockExclusive()
    pthread_mutex_unlock(&mMutex);
 }
 
+bool SharedLock::isBigReader()
+{
+   return false;
+}
+
 #else
 // non-windows & non-macos:
-SharedLock::SharedLock()
+
+// the most reader slots in a big reader lock
+#define MAX_READER_SLOTS 64
+
+// the bits of a thread's big reader lock state that count its shared locks
+#define DEPTH_BITS 16
+#define DEPTH_MASK ((1 << DEPTH_BITS) - 1)
+
+SharedLock::SharedLock(bool bigReader) :
+   mBigReader(bigReader),
+   mSlots(NULL),
+   mSlotMask(0),
+   mReaders(0),
+   mWriter(0)
 {
-   // initialize lock
-   pthread_rwlock_init(&mLock, NULL);
+   if(mBigReader && pthread_key_create(&mStateKey, NULL) != 0)
+   {
+      // out of keys, use a regular lock
+      mBigReader = false;
+   }
+
+   if(mBigReader)
+   {
+      // use twice as many slots as there are cpus so that few threads on
+      // different cpus share a slot
+      unsigned int slots = 4;
+      unsigned int cpus = System::getCpuCoreCount();
+      while(slots < cpus * 2 && slots < MAX_READER_SLOTS)
+      {
+         slots <<= 1;
+      }
+      void* mem = NULL;
+      posix_memalign(&mem, sizeof(ReaderSlot), slots * sizeof(ReaderSlot));
+      mSlots = static_cast<ReaderSlot*>(mem);
+      for(unsigned int i = 0; i < slots; ++i)
+      {
+         mSlots[i].count = 0;
+      }
+      mSlotMask = slots - 1;
+
+      pthread_mutex_init(&mWriterMutex, NULL);
+      pthread_mutex_init(&mDrainMutex, NULL);
+      pthread_cond_init(&mDrainCondition, NULL);
+   }
+   else
+   {
+      // initialize lock
+      pthread_rwlock_init(&mLock, NULL);
+   }
 
    // no locks yet
    mThreadId = Thread::sInvalidThreadId;
@@ -210,23 +273,59 @@ SharedLock::SharedLock()
 
 SharedLock::~SharedLock()
 {
-   // destroy lock
-   pthread_rwlock_destroy(&mLock);
+   if(mBigReader)
+   {
+      pthread_key_delete(mStateKey);
+      free(mSlots);
+      pthread_mutex_destroy(&mWriterMutex);
+      pthread_mutex_destroy(&mDrainMutex);
+      pthread_cond_destroy(&mDrainCondition);
+   }
+   else
+   {
+      // destroy lock
+      pthread_rwlock_destroy(&mLock);
+   }
 }
 
 void SharedLock::lockShared()
 {
    // see if this thread holds the exclusive lock
    int rc = pthread_equal(mThreadId, pthread_self());
-   if(rc == 0)
+   if(rc != 0)
+   {
+      // current thread has the exclusive lock, so bump up lock count
+      ++mLockCount;
+   }
+   else if(!mBigReader)
    {
       // obtain a shared lock
       pthread_rwlock_rdlock(&mLock);
    }
    else
    {
-      // current thread has the exclusive lock, so bump up lock count
-      ++mLockCount;
+      // only count the first shared lock of this thread in its slot
+      intptr_t state = (intptr_t)pthread_getspecific(mStateKey);
+      if((state & DEPTH_MASK) == 0)
+      {
+         volatile int* count = getReaderSlot(state);
+         bool locked = false;
+         while(!locked)
+         {
+            // count this thread as a reader, then check for a writer, a
+            // writer sets its flag and then checks for readers
+            Atomic::incrementAndFetch(count);
+            locked = (mWriter == 0);
+            if(!locked)
+            {
+               // back off and wait for the writer to finish
+               releaseReaderSlot(count);
+               pthread_mutex_lock(&mWriterMutex);
+               pthread_mutex_unlock(&mWriterMutex);
+            }
+         }
+      }
+      pthread_setspecific(mStateKey, (void*)(state + 1));
    }
 }
 
@@ -234,15 +333,24 @@ void SharedLock::unlockShared()
 {
    // see if this thread holds the exclusive lock
    int rc = pthread_equal(mThreadId, pthread_self());
-   if(rc == 0)
+   if(rc != 0)
+   {
+      // release exclusive lock
+      unlockExclusive();
+   }
+   else if(!mBigReader)
    {
       // release shared lock
       pthread_rwlock_unlock(&mLock);
    }
    else
    {
-      // release exclusive lock
-      unlockExclusive();
+      intptr_t state = (intptr_t)pthread_getspecific(mStateKey) - 1;
+      pthread_setspecific(mStateKey, (void*)state);
+      if((state & DEPTH_MASK) == 0)
+      {
+         releaseReaderSlot(getReaderSlot(state));
+      }
    }
 }
 
@@ -253,8 +361,29 @@ void SharedLock::lockExclusive()
    int rc = pthread_equal(mThreadId, self);
    if(rc == 0)
    {
-      // obtain the exclusive lock
-      pthread_rwlock_wrlock(&mLock);
+      if(mBigReader)
+      {
+         // keep other writers out and make new readers back off
+         pthread_mutex_lock(&mWriterMutex);
+         Atomic::exchange(&mWriter, 1);
+
+         // wait for the readers to drain
+         pthread_mutex_lock(&mDrainMutex);
+         for(unsigned int i = 0; i <= mSlotMask; ++i)
+         {
+            while(mSlots[i].count != 0)
+            {
+               pthread_cond_wait(&mDrainCondition, &mDrainMutex);
+            }
+         }
+         pthread_mutex_unlock(&mDrainMutex);
+         Atomic::memoryBarrier();
+      }
+      else
+      {
+         // obtain the exclusive lock
+         pthread_rwlock_wrlock(&mLock);
+      }
 
       // set thread that holds the exclusive lock
       mThreadId = self;
@@ -275,7 +404,44 @@ void SharedLock::unlockExclusive()
       mThreadId = Thread::sInvalidThreadId;
 
       // release exclusive lock
-      pthread_rwlock_unlock(&mLock);
+      if(mBigReader)
+      {
+         Atomic::exchange(&mWriter, 0);
+         pthread_mutex_unlock(&mWriterMutex);
+      }
+      else
+      {
+         pthread_rwlock_unlock(&mLock);
+      }
+   }
+}
+
+bool SharedLock::isBigReader()
+{
+   return mBigReader;
+}
+
+volatile int* SharedLock::getReaderSlot(intptr_t& state)
+{
+   // give the thread the next slot, its index is stored plus one so that
+   // 0 means none yet
+   intptr_t index = state >> DEPTH_BITS;
+   if(index == 0)
+   {
+      index = Atomic::incrementAndFetch(&mReaders);
+      state |= index << DEPTH_BITS;
+   }
+   return &mSlots[(index - 1) & mSlotMask].count;
+}
+
+void SharedLock::releaseReaderSlot(volatile int* count)
+{
+   // uncount the reader, then check for a waiting writer
+   if(Atomic::decrementAndFetch(count) == 0 && mWriter != 0)
+   {
+      pthread_mutex_lock(&mDrainMutex);
+      pthread_cond_broadcast(&mDrainCondition);
+      pthread_mutex_unlock(&mDrainMutex);
    }
 }
 
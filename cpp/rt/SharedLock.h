@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2008-2009 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2008-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #ifndef monarch_rt_SharedLock_H
 #define monarch_rt_SharedLock_H
@@ -37,6 +37,15 @@ namespace rt
  *
  * monarch::rt::Thread disallows threads from being created with an ID of 0.
  *
+ * A SharedLock can be a "big reader" lock for data that is read very often
+ * and rarely changed. Instead of having every reader update the same
+ * counter, each thread counts its shared locks in one of several reader
+ * slots that are kept on separate cache lines, so readers on different
+ * CPUs do not slow each other down. A thread that wants the exclusive lock
+ * has to wait for every slot to drain, so exclusive locks are more
+ * expensive. Big reader locks are not available on Windows or Mac OS, where
+ * the flag is ignored.
+ *
  * @author Dave Longley
  */
 class SharedLock
@@ -98,13 +107,84 @@ protected:
     * thread that holds an exclusive lock.
     */
    unsigned int mLockCount;
+
+   /**
+    * True if this is a big reader lock.
+    */
+   bool mBigReader;
+
+   /**
+    * A slot that counts the shared locks held by some threads, padded to
+    * fill a cache line.
+    */
+   struct ReaderSlot
+   {
+      volatile int count;
+      char padding[64 - sizeof(int)];
+   };
+
+   /**
+    * The reader slots for a big reader lock and the mask to pick one with,
+    * the number of slots is a power of 2.
+    */
+   ReaderSlot* mSlots;
+   unsigned int mSlotMask;
+
+   /**
+    * The key for the current thread's state on a big reader lock: the index
+    * of its reader slot, plus one, in the upper bits and the number of shared
+    * locks it holds in the lower 16 bits. Recursive shared locks are only
+    * counted here so that they are granted even when another thread is
+    * waiting for the exclusive lock.
+    */
+   pthread_key_t mStateKey;
+
+   /**
+    * The number of threads that have been given a reader slot.
+    */
+   volatile unsigned int mReaders;
+
+   /**
+    * Set to 1 while a thread is acquiring or holding the exclusive lock on a
+    * big reader lock, new readers must wait while it is set.
+    */
+   volatile int mWriter;
+
+   /**
+    * The mutex held by the thread with the exclusive lock on a big reader
+    * lock, and the mutex and condition used to wait for readers to drain.
+    */
+   pthread_mutex_t mWriterMutex;
+   pthread_mutex_t mDrainMutex;
+   pthread_cond_t mDrainCondition;
+
+   /**
+    * Gets the reader slot for the current thread, giving the thread a slot
+    * if it does not have one yet.
+    *
+    * @param state the current thread's state, updated if a slot is given.
+    *
+    * @return the reader slot's counter.
+    */
+   volatile int* getReaderSlot(intptr_t& state);
+
+   /**
+    * Releases a shared lock counted in a reader slot and wakes up a thread
+    * that is waiting for the exclusive lock, if necessary.
+    *
+    * @param count the reader slot's counter.
+    */
+   void releaseReaderSlot(volatile int* count);
 #endif
 
 public:
    /**
     * Constructs a new SharedLock.
+    *
+    * @param bigReader true to make shared locks cheap and exclusive locks
+    *           expensive, false for a regular read/write lock.
     */
-   SharedLock();
+   SharedLock(bool bigReader = false);
 
    /**
     * Destructs this SharedLock.
@@ -130,6 +210,13 @@ public:
     * Releases an exclusive lock.
     */
    void unlockExclusive();
+
+   /**
+    * Returns true if this is a big reader lock, false if not.
+    *
+    * @return true if this is a big reader lock, false if not.
+    */
+   bool isBigReader();
 };
 
 } // end namespace rt
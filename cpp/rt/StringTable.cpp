@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#include "monarch/rt/StringTable.h"
+
+#include <cstdlib>
+
+using namespace monarch::rt;
+
+/* Every string handed out by a StringTable is preceded by a one byte flag
+   that marks it as interned or as an unshared copy. Interned strings are
+   stored in blocks that are linked together so they can be freed when the
+   table is destroyed. */
+#define STRING_COPY     0
+#define STRING_INTERNED 1
+
+struct StringTable::InternBlock
+{
+   InternBlock* next;
+   char flag;
+};
+
+#define BLOCK_STRING(b) (&(b)->flag + 1)
+
+StringTable::StringTable(int capacity, int maxStrings, size_t maxLength) :
+   mStrings(capacity),
+   mBlocks(NULL),
+   mCount(0),
+   mMaxStrings(maxStrings),
+   mMaxLength(maxLength)
+{
+}
+
+StringTable::~StringTable()
+{
+   InternBlock* b = const_cast<InternBlock*>(mBlocks);
+   while(b != NULL)
+   {
+      InternBlock* next = b->next;
+      free(b);
+      b = next;
+   }
+}
+
+const char* StringTable::intern(const char* str, bool* hit)
+{
+   const char* rval = NULL;
+
+   // look for an existing interned string
+   if(mStrings.get(str, rval))
+   {
+      if(hit != NULL)
+      {
+         *hit = true;
+      }
+   }
+   else
+   {
+      if(hit != NULL)
+      {
+         *hit = false;
+      }
+
+      size_t len = strlen(str);
+      if(len <= mMaxLength && mCount < mMaxStrings)
+      {
+         // create a new interned string
+         InternBlock* b = static_cast<InternBlock*>(
+            malloc(sizeof(InternBlock) + len));
+         b->flag = STRING_INTERNED;
+         char* s = BLOCK_STRING(b);
+         memcpy(s, str, len + 1);
+
+         // another thread may intern the same string at the same time, so
+         // always use whichever string ended up in the table
+         mStrings.put(s, s, false);
+         if(mStrings.get(s, rval) && rval == s)
+         {
+            // string is interned, keep track of its block
+            Atomic::incrementAndFetch(&mCount);
+            InternBlock* head;
+            do
+            {
+               head = const_cast<InternBlock*>(mBlocks);
+               b->next = head;
+            }
+            while(!Atomic::compareAndSwap(&mBlocks, head, b));
+         }
+         else
+         {
+            free(b);
+            rval = NULL;
+         }
+      }
+   }
+
+   if(rval == NULL)
+   {
+      // could not intern the string, use a copy
+      size_t len = strlen(str);
+      char* copy = static_cast<char*>(malloc(len + 2));
+      copy[0] = STRING_COPY;
+      memcpy(copy + 1, str, len + 1);
+      rval = copy + 1;
+   }
+
+   return rval;
+}
+
+int StringTable::getCount()
+{
+   return mCount;
+}
+
+void StringTable::release(const char* str)
+{
+   if(str != NULL && str[-1] == STRING_COPY)
+   {
+      free(const_cast<char*>(str - 1));
+   }
+}
+
+bool StringTable::isInterned(const char* str)
+{
+   return str[-1] == STRING_INTERNED;
+}
@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#ifndef monarch_rt_StringTable_H
+#define monarch_rt_StringTable_H
+
+#include "monarch/rt/HashTable.h"
+
+#include <cstring>
+#include <inttypes.h>
+#include <string>
+
+namespace monarch
+{
+namespace rt
+{
+
+/**
+ * A hash function for null-terminated strings (32-bit FNV-1a). It may also
+ * be used for std::strings.
+ */
+struct StringHashFunction : public HashFunction<const char*>
+{
+   int operator()(const char* const& k) const
+   {
+      uint32_t hash = 2166136261U;
+      for(const unsigned char* p = (const unsigned char*)k; *p != 0; ++p)
+      {
+         hash ^= *p;
+         hash *= 16777619U;
+      }
+      return (int)hash;
+   };
+
+   int operator()(const std::string& k) const
+   {
+      const char* str = k.c_str();
+      return (*this)(str);
+   };
+};
+
+/**
+ * An equals function for null-terminated strings. It may also be used for
+ * std::strings.
+ */
+struct StringEqualsFunction : public EqualsFunction<const char*>
+{
+   bool operator()(const char* const& k1, const char* const& k2) const
+   {
+      return k1 == k2 || strcmp(k1, k2) == 0;
+   };
+
+   bool operator()(const std::string& k1, const std::string& k2) const
+   {
+      return k1 == k2;
+   };
+};
+
+/**
+ * A StringTable interns null-terminated strings. Interning a string returns
+ * a pointer to a shared, immutable copy of it so that equal strings that have
+ * been interned can be compared by address and do not need to be allocated
+ * more than once.
+ *
+ * A StringTable is lock-free. It is built on a HashTable and may be used by
+ * many threads at once.
+ *
+ * Interned strings are never removed from a StringTable, they live until the
+ * table is destroyed. To prevent unbounded growth, strings that are too long
+ * or that are interned once the table is full are copied instead. Every
+ * string returned from intern() must be passed to release() when it is no
+ * longer needed, which frees copies and does nothing for interned strings.
+ */
+class StringTable
+{
+protected:
+   /**
+    * The table of interned strings. Each key maps to itself.
+    */
+   typedef HashTable<
+      const char*, const char*, StringHashFunction, StringEqualsFunction>
+      InternMap;
+   InternMap mStrings;
+
+   /**
+    * The list of memory blocks for interned strings.
+    */
+   struct InternBlock;
+   volatile InternBlock* mBlocks;
+
+   /**
+    * The number of interned strings.
+    */
+   volatile aligned_int32_t mCount;
+
+   /**
+    * The maximum number of strings to intern.
+    */
+   int mMaxStrings;
+
+   /**
+    * The maximum length of a string to intern.
+    */
+   size_t mMaxLength;
+
+public:
+   /**
+    * Creates a new StringTable.
+    *
+    * @param capacity the initial capacity of the table.
+    * @param maxStrings the maximum number of strings to intern.
+    * @param maxLength the maximum length of a string to intern.
+    */
+   StringTable(
+      int capacity = 2047, int maxStrings = 65536, size_t maxLength = 128);
+
+   /**
+    * Destructs this StringTable. All interned strings are freed.
+    */
+   virtual ~StringTable();
+
+   /**
+    * Interns the given string. If an equal string has already been interned,
+    * it is returned. Otherwise, the string is interned if the table is not
+    * full and it is not too long, and an unshared copy of it is returned if
+    * it is not.
+    *
+    * @param str the string to intern.
+    * @param hit set to true if the string had already been interned, false
+    *           if not, may be NULL.
+    *
+    * @return the interned string or a copy of it, to be passed to release().
+    */
+   virtual const char* intern(const char* str, bool* hit = NULL);
+
+   /**
+    * Gets the number of strings that have been interned.
+    *
+    * @return the number of interned strings.
+    */
+   virtual int getCount();
+
+   /**
+    * Releases a string returned from intern(). If the string is a copy, it is
+    * freed, otherwise nothing happens.
+    *
+    * @param str the string to release, NULL is ignored.
+    */
+   static void release(const char* str);
+
+   /**
+    * Returns true if the given string, which must have been returned from
+    * intern(), is an interned string and not an unshared copy.
+    *
+    * @param str the string returned from intern().
+    *
+    * @return true if the string is interned, false if it is a copy.
+    */
+   static bool isInterned(const char* str);
+};
+
+} // end namespace rt
+} // end namespace monarch
+#endif
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2007-2009 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2007-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #define __STDC_CONSTANT_MACROS
 
@@ -11,9 +11,11 @@
 #ifdef WIN32
 #include <windows.h>
 #elif MACOS
+#include <mach/mach_time.h>
 #include <sys/param.h>
 #include <sys/sysctl.h>
 #else
+#include <time.h>
 #include <unistd.h>
 #endif
 
@@ -35,6 +37,40 @@ uint64_t System::getCurrentMilliseconds()
    return rval;
 }
 
+uint64_t System::getCurrentMicroseconds()
+{
+   struct timeval now;
+   gettimeofday(&now, NULL);
+   return now.tv_sec * UINT64_C(1000000) + now.tv_usec;
+}
+
+uint64_t System::getMonotonicMicroseconds()
+{
+#ifdef WIN32
+   static LARGE_INTEGER frequency = {{0, 0}};
+   if(frequency.QuadPart == 0)
+   {
+      QueryPerformanceFrequency(&frequency);
+   }
+   LARGE_INTEGER now;
+   QueryPerformanceCounter(&now);
+   return (uint64_t)(now.QuadPart / frequency.QuadPart * UINT64_C(1000000) +
+      now.QuadPart % frequency.QuadPart * UINT64_C(1000000) /
+      frequency.QuadPart);
+#elif MACOS
+   static mach_timebase_info_data_t timebase = {0, 0};
+   if(timebase.denom == 0)
+   {
+      mach_timebase_info(&timebase);
+   }
+   return mach_absolute_time() * timebase.numer / timebase.denom / 1000;
+#else
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return now.tv_sec * UINT64_C(1000000) + now.tv_nsec / 1000;
+#endif
+}
+
 uint32_t System::getCpuCoreCount()
 {
 #ifdef WIN32
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2007-2009 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2007-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #ifndef monarch_rt_System_H
 #define monarch_rt_System_H
@@ -29,6 +29,22 @@ public:
     */
    static uint64_t getCurrentMilliseconds();
 
+   /**
+    * Gets the current time in microseconds.
+    *
+    * @return the current time in microseconds.
+    */
+   static uint64_t getCurrentMicroseconds();
+
+   /**
+    * Gets the time in microseconds on a monotonic clock. The clock is not
+    * affected by changes to the system time, but it has an arbitrary epoch,
+    * so its values are only useful for measuring intervals.
+    *
+    * @return the current monotonic time in microseconds.
+    */
+   static uint64_t getMonotonicMicroseconds();
+
    /**
     * Gets the number of cores/cpus.
     *
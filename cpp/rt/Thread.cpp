@@ -22,12 +22,38 @@ pthread_key_t Thread::sExceptionKey;
 // create invalid thread ID
 pthread_t Thread::sInvalidThreadId;
 
+#ifdef __linux__
+// converts a CpuSet to a cpu_set_t
+static void _toCpuSetT(const CpuSet& cpus, cpu_set_t& set)
+{
+   CPU_ZERO(&set);
+   for(uint32_t cpu = 0; cpu < CPU_SETSIZE && cpu < CpuSet::MaxCpus; ++cpu)
+   {
+      if(cpus.contains(cpu))
+      {
+         CPU_SET(cpu, &set);
+      }
+   }
+}
+
+// sets the name the OS shows for the calling thread, which is limited to
+// 15 characters
+static void _setOsThreadName(const char* name)
+{
+   char tmp[16];
+   strncpy(tmp, (name == NULL) ? "" : name, 15);
+   tmp[15] = '\0';
+   pthread_setname_np(pthread_self(), tmp);
+}
+#endif
+
 Thread::Thread(Runnable* runnable, const char* name, bool persistent) :
    mPersistent(persistent),
    mRunnable(runnable),
    mRunnableRef(NULL),
    mName(NULL),
    mUserData(NULL),
+   mCpuAffinity(NULL),
    mWaitMonitor(NULL)
 {
    // initialize threads
@@ -56,6 +82,7 @@ Thread::Thread(RunnableRef& runnable, const char* name, bool persistent) :
    mRunnableRef(runnable),
    mName(NULL),
    mUserData(NULL),
+   mCpuAffinity(NULL),
    mWaitMonitor(NULL)
 {
    // initialize threads
@@ -81,6 +108,7 @@ Thread::Thread(RunnableRef& runnable, const char* name, bool persistent) :
 Thread::~Thread()
 {
    free(mName);
+   delete mCpuAffinity;
 }
 
 bool Thread::start(size_t stackSize)
@@ -102,6 +130,17 @@ bool Thread::start(size_t stackSize)
       // make thread joinable
       pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_JOINABLE);
 
+#ifdef __linux__
+      if(mCpuAffinity != NULL)
+      {
+         // create the thread on its cpus so that its stack is first touched,
+         // and therefore allocated, on their NUMA node
+         cpu_set_t set;
+         _toCpuSetT(*mCpuAffinity, set);
+         pthread_attr_setaffinity_np(&attributes, sizeof(set), &set);
+      }
+#endif
+
       // create the POSIX thread
       int rc = pthread_create(
          &mThreadId, &attributes, &Thread::execute, (void*)this);
@@ -195,7 +234,9 @@ Exception* Thread::createInterruptedException()
 {
    Exception* rval = NULL;
 
-   rval = new Exception("Thread interrupted", "monarch.rt.Interrupted");
+   rval = new Exception(
+      "Thread interrupted", "monarch.rt.Interrupted",
+      Exception::StaticStrings);
    const char* name = getName();
    rval->getDetails()["name"] = ((name == NULL) ? "" : name);
 
@@ -299,6 +340,12 @@ void Thread::setName(const char* name)
    lock();
    {
       assignName(name);
+#ifdef __linux__
+      if(hasStarted() && pthread_equal(mThreadId, pthread_self()))
+      {
+         _setOsThreadName(mName);
+      }
+#endif
    }
    unlock();
 }
@@ -316,6 +363,88 @@ const char* Thread::getName()
    return rval;
 }
 
+bool Thread::setCpuAffinity(const CpuSet* cpus)
+{
+   bool rval = true;
+
+   lock();
+   {
+      if(cpus == NULL)
+      {
+         delete mCpuAffinity;
+         mCpuAffinity = NULL;
+      }
+      else if(cpus->isEmpty())
+      {
+         ExceptionRef e = new Exception(
+            "Could not set thread cpu affinity. No cpus given.",
+            "monarch.rt.Thread.InvalidCpuAffinity");
+         Exception::set(e);
+         rval = false;
+      }
+      else if(mCpuAffinity == NULL)
+      {
+         mCpuAffinity = new CpuSet(*cpus);
+      }
+      else
+      {
+         *mCpuAffinity = *cpus;
+      }
+
+#ifdef __linux__
+      // a thread that has not started is created on its cpus, a running
+      // thread can be moved while its ID is valid, which is until it is
+      // joined or, if detached, until it exits
+      if(rval && hasStarted() && !mJoined &&
+         (!mDetached || pthread_equal(mThreadId, pthread_self())))
+      {
+         CpuSet all;
+         if(mCpuAffinity == NULL)
+         {
+            CpuSet::getAvailableCpus(all);
+         }
+         cpu_set_t set;
+         _toCpuSetT((mCpuAffinity == NULL) ? all : *mCpuAffinity, set);
+         int rc = pthread_setaffinity_np(mThreadId, sizeof(set), &set);
+         if(rc != 0)
+         {
+            ExceptionRef e = new Exception(
+               "Could not set thread cpu affinity.",
+               "monarch.rt.Thread.InvalidCpuAffinity");
+            e->getDetails()["cpus"] = cpus->toString().c_str();
+            e->getDetails()["error"] = strerror(rc);
+            Exception::set(e);
+            rval = false;
+         }
+      }
+#endif
+   }
+   unlock();
+
+   return rval;
+}
+
+bool Thread::getCpuAffinity(CpuSet& cpus)
+{
+   bool rval = false;
+
+   lock();
+   {
+      if(mCpuAffinity == NULL)
+      {
+         cpus.clear();
+      }
+      else
+      {
+         cpus = *mCpuAffinity;
+         rval = true;
+      }
+   }
+   unlock();
+
+   return rval;
+}
+
 void Thread::setUserData(void* userData)
 {
    mUserData = userData;
@@ -543,6 +672,9 @@ bool Thread::hasException()
 
 void Thread::clearException()
 {
+   // initialize threads
+   pthread_once(&sThreadsInit, &initializeThreads);
+
    // get the exception reference for the current thread
    ExceptionRef* ref =
       static_cast<ExceptionRef*>(pthread_getspecific(sExceptionKey));
@@ -692,6 +824,16 @@ void* Thread::execute(void* thread)
       // disable thread cancelation
       pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
 
+#ifdef __linux__
+      // show the thread's name in the OS
+      if(t->mName != NULL)
+      {
+         t->lock();
+         _setOsThreadName(t->mName);
+         t->unlock();
+      }
+#endif
+
       // thread is alive
       t->mAlive = true;
 
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2007-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2007-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #ifndef monarch_rt_Thread_H
 #define monarch_rt_Thread_H
@@ -8,6 +8,7 @@
 #include <sched.h>
 #include <signal.h>
 
+#include "monarch/rt/CpuSet.h"
 #include "monarch/rt/ExclusiveLock.h"
 #include "monarch/rt/Exception.h"
 #include "monarch/rt/Runnable.h"
@@ -62,6 +63,11 @@ protected:
     */
    void* mUserData;
 
+   /**
+    * The cpus this thread may run on, NULL for any cpu.
+    */
+   CpuSet* mCpuAffinity;
+
    /**
     * The Monitor this Thread is waiting to enter.
     */
@@ -224,6 +230,28 @@ public:
     */
    virtual const char* getName();
 
+   /**
+    * Restricts this Thread to a set of cpus. If this Thread has not started
+    * yet it will be created on one of the cpus, so its stack is allocated
+    * on the NUMA node of the cpus. CPU affinity is only supported on Linux,
+    * elsewhere the cpus are stored but not applied.
+    *
+    * @param cpus the cpus to run on, NULL to run on any cpu.
+    *
+    * @return true if successful, false if an exception occurred.
+    */
+   virtual bool setCpuAffinity(const CpuSet* cpus);
+
+   /**
+    * Gets the cpus this Thread is restricted to.
+    *
+    * @param cpus the set to populate.
+    *
+    * @return true if this Thread is restricted to cpus, false if it may run
+    *         on any cpu.
+    */
+   virtual bool getCpuAffinity(CpuSet& cpus);
+
    /**
     * Sets the user data for this Thread.
     *
@@ -397,7 +425,6 @@ protected:
     * @param name the name to assign to this thread.
     */
    virtual void assignName(const char* name);
-
    /**
     * Initializes any shared thread information.
     */
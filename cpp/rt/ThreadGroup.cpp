@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#include "monarch/rt/ThreadGroup.h"
+
+#include "monarch/rt/Atomic.h"
+
+#include <cstdio>
+
+using namespace std;
+using namespace monarch::rt;
+
+ThreadGroup::ThreadGroup(const char* name) :
+   mName(name),
+   mPerCpu(false),
+   mThreadCount(0)
+{
+}
+
+ThreadGroup::~ThreadGroup()
+{
+}
+
+bool ThreadGroup::configure(DynamicObject& config)
+{
+   bool rval = true;
+
+   if(config->hasMember("name"))
+   {
+      setName(config["name"]->getString());
+   }
+   if(config->hasMember("perCpu"))
+   {
+      setPerCpu(config["perCpu"]->getBoolean());
+   }
+
+   CpuSet cpus;
+   if(config->hasMember("cpus"))
+   {
+      rval = cpus.parse(config["cpus"]->getString());
+   }
+   if(rval && config->hasMember("numaNode"))
+   {
+      // use the node's cpus, limited to the listed ones if any
+      CpuSet node;
+      rval = CpuSet::getNodeCpus(config["numaNode"]->getUInt32(), node);
+      if(rval)
+      {
+         if(!cpus.isEmpty())
+         {
+            node.intersect(cpus);
+         }
+         cpus = node;
+      }
+   }
+   if(rval && !cpus.isEmpty())
+   {
+      // only use cpus this process may run on
+      CpuSet available;
+      CpuSet::getAvailableCpus(available);
+      cpus.intersect(available);
+      if(cpus.isEmpty())
+      {
+         ExceptionRef e = new Exception(
+            "None of the cpus for the thread group are available.",
+            "monarch.rt.ThreadGroup.NoCpus");
+         Exception::set(e);
+         rval = false;
+      }
+   }
+
+   if(rval)
+   {
+      setCpus(cpus);
+   }
+   else
+   {
+      ExceptionRef e = new Exception(
+         "Invalid thread group configuration.",
+         "monarch.rt.ThreadGroup.InvalidConfig");
+      e->getDetails()["name"] = mName.c_str();
+      Exception::push(e);
+   }
+
+   return rval;
+}
+
+void ThreadGroup::setName(const char* name)
+{
+   mName = name;
+}
+
+const char* ThreadGroup::getName()
+{
+   return mName.c_str();
+}
+
+void ThreadGroup::setCpus(const CpuSet& cpus)
+{
+   mCpus = cpus;
+}
+
+const CpuSet& ThreadGroup::getCpus()
+{
+   return mCpus;
+}
+
+void ThreadGroup::setPerCpu(bool perCpu)
+{
+   mPerCpu = perCpu;
+}
+
+bool ThreadGroup::isPerCpu()
+{
+   return mPerCpu;
+}
+
+bool ThreadGroup::placeThread(Thread* thread)
+{
+   bool rval = true;
+
+   // name the thread after its position in the group
+   uint32_t index = Atomic::incrementAndFetch(&mThreadCount) - 1;
+   char suffix[12];
+   snprintf(suffix, 12, "-%u", index);
+   string name = mName;
+   name.append(suffix);
+   thread->setName(name.c_str());
+
+   if(!mCpus.isEmpty())
+   {
+      if(mPerCpu)
+      {
+         // spread threads over the cpus one per cpu
+         CpuSet cpu;
+         cpu.add(mCpus.getCpu(index));
+         rval = thread->setCpuAffinity(&cpu);
+      }
+      else
+      {
+         rval = thread->setCpuAffinity(&mCpus);
+      }
+   }
+
+   return rval;
+}
+
+uint32_t ThreadGroup::getThreadCount()
+{
+   return mThreadCount;
+}
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#ifndef monarch_rt_ThreadGroup_H
+#define monarch_rt_ThreadGroup_H
+
+#include "monarch/rt/Collectable.h"
+#include "monarch/rt/CpuSet.h"
+#include "monarch/rt/DynamicObject.h"
+#include "monarch/rt/Thread.h"
+
+#include <string>
+
+namespace monarch
+{
+namespace rt
+{
+
+/**
+ * A ThreadGroup names and places the threads of one part of an application,
+ * such as the threads of a ThreadPool, so that different parts can be
+ * partitioned over the cpus of a machine.
+ *
+ * Each thread placed in a group is named "<group name>-<n>", where n counts
+ * the threads placed so far, and is restricted to the group's cpus. The cpus
+ * may be given explicitly or be those of a NUMA node. If the group places one
+ * thread per cpu, each thread is pinned to a single cpu, taken in turn,
+ * instead of being allowed to run on all of the group's cpus.
+ *
+ * A ThreadGroup can be configured with:
+ *
+ * "name": the name for the threads (default: the group's name).
+ * "cpus": a cpu list such as "0-3,8" (default: all cpus).
+ * "numaNode": a NUMA node, its cpus are used instead of or, with "cpus",
+ *    intersected with the cpu list.
+ * "perCpu": true to pin each thread to one cpu (default: false).
+ */
+class ThreadGroup
+{
+protected:
+   /**
+    * The name for threads in this group.
+    */
+   std::string mName;
+
+   /**
+    * The cpus for threads in this group, empty for any cpu.
+    */
+   CpuSet mCpus;
+
+   /**
+    * True to pin each thread to one cpu.
+    */
+   bool mPerCpu;
+
+   /**
+    * The number of threads placed in this group.
+    */
+   volatile uint32_t mThreadCount;
+
+public:
+   /**
+    * Creates a new ThreadGroup whose threads run on any cpu.
+    *
+    * @param name the name for threads in this group.
+    */
+   ThreadGroup(const char* name = "thread");
+
+   /**
+    * Destructs this ThreadGroup.
+    */
+   virtual ~ThreadGroup();
+
+   /**
+    * Configures this ThreadGroup.
+    *
+    * @param config the configuration, see the class description.
+    *
+    * @return true if successful, false if an exception occurred.
+    */
+   virtual bool configure(DynamicObject& config);
+
+   /**
+    * Sets the name for threads in this group.
+    *
+    * @param name the name.
+    */
+   virtual void setName(const char* name);
+
+   /**
+    * Gets the name for threads in this group.
+    *
+    * @return the name.
+    */
+   virtual const char* getName();
+
+   /**
+    * Sets the cpus for threads in this group.
+    *
+    * @param cpus the cpus, an empty set for any cpu.
+    */
+   virtual void setCpus(const CpuSet& cpus);
+
+   /**
+    * Gets the cpus for threads in this group.
+    *
+    * @return the cpus, an empty set for any cpu.
+    */
+   virtual const CpuSet& getCpus();
+
+   /**
+    * Sets whether each thread is pinned to one cpu.
+    *
+    * @param perCpu true to pin each thread to one cpu, false to let threads
+    *               run on all of this group's cpus.
+    */
+   virtual void setPerCpu(bool perCpu);
+
+   /**
+    * Gets whether each thread is pinned to one cpu.
+    *
+    * @return true if each thread is pinned to one cpu.
+    */
+   virtual bool isPerCpu();
+
+   /**
+    * Names a thread and restricts it to this group's cpus. A thread that has
+    * not started yet is created on its cpus.
+    *
+    * @param thread the thread to place.
+    *
+    * @return true if successful, false if an exception occurred.
+    */
+   virtual bool placeThread(Thread* thread);
+
+   /**
+    * Gets the number of threads placed in this group.
+    *
+    * @return the number of threads placed.
+    */
+   virtual uint32_t getThreadCount();
+};
+
+// define a reference counted ThreadGroup type
+typedef Collectable<ThreadGroup> ThreadGroupRef;
+
+} // end namespace rt
+} // end namespace monarch
+#endif
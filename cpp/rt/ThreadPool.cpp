@@ -3,11 +3,14 @@
  */
 #include "monarch/rt/ThreadPool.h"
 
+#include "monarch/rt/RunnableDelegate.h"
+
 using namespace std;
 using namespace monarch::rt;
 
 ThreadPool::ThreadPool(unsigned int poolSize, size_t stackSize) :
    mThreadSemaphore(poolSize, true),
+   mIdleTimers(NULL),
    mThreadStackSize(stackSize),
    // default thread expire time to 0 (no expiration)
    mThreadExpireTime(0)
@@ -29,7 +32,7 @@ PooledThread* ThreadPool::getIdleThread()
    {
       while(rval == NULL && !mIdleThreads.empty())
       {
-         rval = mIdleThreads.front();
+         rval = unidleThread(mIdleThreads.front());
          mIdleThreads.pop_front();
 
          // lock thread's job lock until it is assigned a job or marked expired
@@ -52,9 +55,14 @@ PooledThread* ThreadPool::getIdleThread()
 
       if(rval == NULL)
       {
-         // create new thread and add it to the thread list
-         rval = new PooledThread(this, getThreadExpireTime());
+         // create new thread and add it to the thread list, the thread
+         // does not expire itself, its idle timer expires it
+         rval = new PooledThread(this);
          mThreads.push_back(rval);
+         if(!mThreadGroup.isNull())
+         {
+            mThreadGroup->placeThread(rval);
+         }
 
          // lock thread's job lock to prevent it from going idle before
          // its job is assigned
@@ -83,11 +91,11 @@ PooledThread* ThreadPool::getIdleThread()
 void ThreadPool::removeIdleThreads(unsigned int count)
 {
    // assume list lock is engaged
-   for(ThreadList::iterator i = mIdleThreads.begin();
+   for(IdleThreadList::iterator i = mIdleThreads.begin();
        count > 0 && i != mIdleThreads.end(); --count)
    {
       // interrupt and erase threads
-      PooledThread* t = *i;
+      PooledThread* t = unidleThread(*i);
       t->interrupt();
       i = mIdleThreads.erase(i);
       mThreads.remove(t);
@@ -115,6 +123,71 @@ void ThreadPool::cleanupExpiredThreads()
    }
 }
 
+void ThreadPool::scheduleIdleTimer(IdleThreadRef& idle)
+{
+   // assume list lock is engaged
+   if(!idle->timer.isNull())
+   {
+      mIdleTimers->cancel(idle->timer);
+      idle->timer.setNull();
+   }
+
+   if(mThreadExpireTime != 0)
+   {
+      if(mIdleTimers == NULL)
+      {
+         mIdleTimers = TimingWheel::acquireShared();
+      }
+      RunnableRef r = new RunnableDelegate<ThreadPool, IdleThreadRef>(
+         this, &ThreadPool::expireIdleThread, idle);
+      idle->timer = mIdleTimers->schedule(r, mThreadExpireTime);
+   }
+}
+
+PooledThread* ThreadPool::unidleThread(IdleThreadRef& idle)
+{
+   // assume list lock is engaged
+   PooledThread* rval = idle->thread;
+   idle->thread = NULL;
+
+   // drop the timer, which also frees the idle thread once the timer is no
+   // longer running
+   if(!idle->timer.isNull())
+   {
+      mIdleTimers->cancel(idle->timer);
+      idle->timer.setNull();
+   }
+
+   return rval;
+}
+
+void ThreadPool::expireIdleThread(IdleThreadRef idle)
+{
+   bool expired = false;
+
+   // lock lists for modification
+   mListLock.lock();
+   {
+      // the thread may have been given a job since its timer was due
+      if(idle->thread != NULL)
+      {
+         mIdleThreads.erase(idle->position);
+         PooledThread* t = unidleThread(idle);
+         t->interrupt();
+         mThreads.remove(t);
+         mExpiredThreads.push_back(t);
+         expired = true;
+      }
+   }
+   mListLock.unlock();
+
+   // join the expired thread
+   if(expired)
+   {
+      cleanupExpiredThreads();
+   }
+}
+
 bool ThreadPool::runJobOnIdleThread(Runnable& job, bool block)
 {
    bool tryAgain = true;
@@ -271,7 +344,12 @@ void ThreadPool::jobCompleted(PooledThread* t)
    {
       // add the thread to the front of the idle list, so it is more
       // likely to get assigned a job immediately
-      mIdleThreads.push_front(t);
+      IdleThreadRef idle = new IdleThread;
+      idle->thread = t;
+      idle->position = mIdleThreads.insert(mIdleThreads.begin(), idle);
+
+      // expire the thread if it stays idle
+      scheduleIdleTimer(idle);
    }
    mListLock.unlock();
 
@@ -298,6 +376,8 @@ void ThreadPool::interruptAllThreads()
 
 void ThreadPool::terminateAllThreads()
 {
+   TimingWheel* timers = NULL;
+
    // prevent new jobs from being assigned
    mJobLock.lock();
    {
@@ -315,13 +395,33 @@ void ThreadPool::terminateAllThreads()
       // clean up expired threads
       cleanupExpiredThreads();
 
-      // clear the idle list, no list locking necessary since no jobs
-      // are running and no new ones can be assigned while inside of the
-      // job lock -- this clear is necessary in case the idle threads
-      // list was updating while joining threads in the cleanup code
-      mIdleThreads.clear();
+      // clear the idle list, no jobs are running and no new ones can be
+      // assigned while inside of the job lock -- this clear is necessary
+      // in case the idle threads list was updating while joining threads
+      // in the cleanup code
+      mListLock.lock();
+      {
+         for(IdleThreadList::iterator i = mIdleThreads.begin();
+             i != mIdleThreads.end(); ++i)
+         {
+            unidleThread(*i);
+         }
+         mIdleThreads.clear();
+
+         // all idle timers are cancelled, give up the shared wheel
+         timers = mIdleTimers;
+         mIdleTimers = NULL;
+      }
+      mListLock.unlock();
    }
    mJobLock.unlock();
+
+   if(timers != NULL)
+   {
+      // wait for an idle timer that is already running to finish
+      timers->synchronize();
+      TimingWheel::releaseShared();
+   }
 }
 
 void ThreadPool::setPoolSize(unsigned int size)
@@ -362,17 +462,40 @@ inline size_t ThreadPool::getThreadStackSize()
    return mThreadStackSize;
 }
 
-void ThreadPool::setThreadExpireTime(uint32_t expireTime)
+void ThreadPool::setThreadGroup(ThreadGroupRef& group)
+{
+   mListLock.lock();
+   {
+      mThreadGroup = group;
+   }
+   mListLock.unlock();
+}
+
+ThreadGroupRef ThreadPool::getThreadGroup()
 {
-   mThreadExpireTime = expireTime;
+   ThreadGroupRef rval;
+
+   mListLock.lock();
+   {
+      rval = mThreadGroup;
+   }
+   mListLock.unlock();
+
+   return rval;
+}
 
+void ThreadPool::setThreadExpireTime(uint32_t expireTime)
+{
    // ensure lists are not modified while updating expire time
    mListLock.lock();
    {
-      // update all existing threads
-      for(ThreadList::iterator i = mThreads.begin(); i != mThreads.end(); ++i)
+      mThreadExpireTime = expireTime;
+
+      // reschedule the timers of all idle threads
+      for(IdleThreadList::iterator i = mIdleThreads.begin();
+          i != mIdleThreads.end(); ++i)
       {
-         (*i)->setExpireTime(expireTime);
+         scheduleIdleTimer(*i);
       }
    }
    mListLock.unlock();
@@ -407,3 +530,8 @@ inline unsigned int ThreadPool::getIdleThreadCount()
 {
    return mIdleThreads.size();
 }
+
+unsigned int ThreadPool::getQueuedJobCount()
+{
+   return 0;
+}
@@ -1,11 +1,13 @@
 /*
- * Copyright (c) 2007-2009 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2007-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #ifndef monarch_rt_ThreadPool_H
 #define monarch_rt_ThreadPool_H
 
 #include "monarch/rt/Semaphore.h"
 #include "monarch/rt/PooledThread.h"
+#include "monarch/rt/ThreadGroup.h"
+#include "monarch/rt/TimingWheel.h"
 
 #include <list>
 
@@ -18,6 +20,11 @@ namespace rt
  * A ThreadPool maintains a set of N PooledThreads that can be used to run jobs
  * without having to tear down the threads and create new ones.
  *
+ * If threads have an expire time, each idle thread has a timer on the shared
+ * TimingWheel that expires it, so expiring threads does not require any
+ * polling or a thread per pool and expired threads are joined as soon as
+ * they expire.
+ *
  * @author Dave Longley
  */
 class ThreadPool
@@ -35,16 +42,36 @@ protected:
    typedef std::list<PooledThread*> ThreadList;
    ThreadList mThreads;
 
+   /**
+    * An IdleThread is an idle thread, its position in the idle list, and
+    * the timer that expires it. Its thread is NULL once it is no longer idle.
+    */
+   struct IdleThread;
+   typedef Collectable<IdleThread> IdleThreadRef;
+   typedef std::list<IdleThreadRef> IdleThreadList;
+   struct IdleThread
+   {
+      PooledThread* thread;
+      IdleThreadList::iterator position;
+      TimingWheel::TimerRef timer;
+   };
+
    /**
     * The list of idle threads in this pool.
     */
-   ThreadList mIdleThreads;
+   IdleThreadList mIdleThreads;
 
    /**
     * The list of expired threads in this pool.
     */
    ThreadList mExpiredThreads;
 
+   /**
+    * The shared TimingWheel with the timers that expire idle threads, NULL
+    * until an idle thread needs a timer.
+    */
+   TimingWheel* mIdleTimers;
+
    /**
     * A lock for modifying the unexpired thread lists.
     */
@@ -65,6 +92,11 @@ protected:
     */
    uint32_t mThreadExpireTime;
 
+   /**
+    * The group that names and places new threads, NULL for none.
+    */
+   ThreadGroupRef mThreadGroup;
+
    /**
     * Gets an idle thread. This method will also clean up any extra
     * idle threads that should not exist due to a decrease in the
@@ -90,6 +122,31 @@ protected:
     */
    virtual void cleanupExpiredThreads();
 
+   /**
+    * Schedules the timer that expires an idle thread, replacing any timer it
+    * already has. The list lock must be engaged.
+    *
+    * @param idle the idle thread.
+    */
+   virtual void scheduleIdleTimer(IdleThreadRef& idle);
+
+   /**
+    * Marks an idle thread as no longer idle, cancelling its timer. The list
+    * lock must be engaged.
+    *
+    * @param idle the idle thread.
+    *
+    * @return the thread.
+    */
+   virtual PooledThread* unidleThread(IdleThreadRef& idle);
+
+   /**
+    * Expires an idle thread when its timer is due.
+    *
+    * @param idle the idle thread.
+    */
+   virtual void expireIdleThread(IdleThreadRef idle);
+
    /**
     * Runs the passed Runnable job on an idle thread.
     *
@@ -191,7 +248,23 @@ public:
    virtual size_t getThreadStackSize();
 
    /**
-    * Sets the expire time for all threads.
+    * Sets the ThreadGroup that names new threads and restricts them to its
+    * cpus.
+    *
+    * @param group the ThreadGroup for new threads, NULL for none.
+    */
+   virtual void setThreadGroup(ThreadGroupRef& group);
+
+   /**
+    * Gets the ThreadGroup for new threads.
+    *
+    * @return the ThreadGroup for new threads, NULL if there is none.
+    */
+   virtual ThreadGroupRef getThreadGroup();
+
+   /**
+    * Sets the expire time for all threads. Threads that are already idle
+    * expire once they have been idle for the new expire time.
     *
     * @param expireTime the amount of time that must pass while threads
     *                   are idle in order for them to expire -- if 0 is passed
@@ -228,6 +301,15 @@ public:
     * @return the current number of idle threads.
     */
    virtual unsigned int getIdleThreadCount();
+
+   /**
+    * Gets the number of jobs that have been accepted but have not started
+    * running yet. This is always 0 for a ThreadPool because it only accepts
+    * a job once a thread is available to run it.
+    *
+    * @return the number of queued jobs.
+    */
+   virtual unsigned int getQueuedJobCount();
 };
 
 } // end namespace rt
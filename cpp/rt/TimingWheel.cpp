@@ -0,0 +1,449 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#include "monarch/rt/TimingWheel.h"
+
+#include "monarch/rt/System.h"
+
+#include <vector>
+
+using namespace std;
+using namespace monarch::rt;
+
+// the tick when no timers are scheduled
+#define NO_TICK (~((uint64_t)0))
+
+// the number of ticks all of the wheels together cover
+#define MAX_DELTA ((((uint64_t)1) << (TimingWheel::SlotBits * \
+   TimingWheel::Levels)) - 1)
+
+// the longest single wait, in milliseconds
+#define MAX_WAIT 0x7FFFFFFF
+
+// the shared wheel, its lock and the number of times it is acquired
+static pthread_once_t sSharedOnce = PTHREAD_ONCE_INIT;
+static TimingWheel* sShared = NULL;
+static ExclusiveLock* sSharedLock = NULL;
+static uint32_t sSharedUsers = 0;
+
+static void createShared()
+{
+   // the shared wheel lives as long as the process, its thread does not
+   sShared = new TimingWheel();
+   sSharedLock = new ExclusiveLock();
+}
+
+TimingWheel::TimingWheel(uint32_t tickLength) :
+   mCount(0),
+   mTickLength(tickLength == 0 ? 1 : tickLength),
+   mWakeTick(0),
+   mWakeUp(false),
+   mThread(NULL)
+{
+   for(int i = 0; i < Levels; ++i)
+   {
+      mLevelCounts[i] = 0;
+   }
+   mCurrent = System::getCurrentMilliseconds() / mTickLength;
+}
+
+TimingWheel::~TimingWheel()
+{
+   TimingWheel::stop();
+   TimingWheel::clear();
+}
+
+TimingWheel::TimerRef TimingWheel::schedule(
+   RunnableRef& r, uint32_t delay, uint32_t interval)
+{
+   TimerRef t = new Timer;
+   t->runnable = r;
+   t->interval = (interval + mTickLength - 1) / mTickLength;
+   if(interval > 0 && t->interval == 0)
+   {
+      t->interval = 1;
+   }
+   t->level = -1;
+   t->slot = NULL;
+
+   mLock.lock();
+   {
+      // count the delay from now, or from the next tick to run if this
+      // wheel has been advanced past now
+      uint64_t now = System::getCurrentMilliseconds() / mTickLength;
+      t->expires = (now > mCurrent ? now : mCurrent) +
+         (delay + mTickLength - 1) / mTickLength;
+      insert(t);
+
+      // wake up the service thread if it would sleep past the new timer
+      if(mWakeTick != 0 && t->expires < mWakeTick)
+      {
+         mWakeUp = true;
+         mLock.notifyAll();
+      }
+   }
+   mLock.unlock();
+
+   return t;
+}
+
+bool TimingWheel::cancel(TimerRef& t)
+{
+   bool rval = false;
+
+   mLock.lock();
+   {
+      if(t->level != -1)
+      {
+         // the list node holds a reference, but the passed one keeps the
+         // timer alive while it is unlinked
+         unlink(&(*t));
+         rval = true;
+      }
+   }
+   mLock.unlock();
+
+   return rval;
+}
+
+void TimingWheel::clear()
+{
+   mLock.lock();
+   {
+      for(int level = 0; level < Levels; ++level)
+      {
+         for(int slot = 0; slot < Slots; ++slot)
+         {
+            TimerList& list = mSlots[level][slot];
+            for(TimerList::iterator i = list.begin(); i != list.end(); ++i)
+            {
+               (*i)->level = -1;
+               (*i)->slot = NULL;
+            }
+            list.clear();
+         }
+         mLevelCounts[level] = 0;
+      }
+      mCount = 0;
+   }
+   mLock.unlock();
+}
+
+uint32_t TimingWheel::getTimerCount()
+{
+   return mCount;
+}
+
+uint32_t TimingWheel::advance(uint64_t now)
+{
+   uint64_t nowTick = now / mTickLength;
+   vector<RunnableRef> runnables;
+
+   mRunLock.lock();
+   mLock.lock();
+   {
+      // collect the timers of each tick up to now
+      TimerList due;
+      while(mCurrent <= nowTick)
+      {
+         if(mCount == 0)
+         {
+            // nothing to run, skip to now
+            mCurrent = nowTick + 1;
+         }
+         else
+         {
+            // at the start of each rotation of a wheel, cascade the next
+            // slot of the wheel above it
+            int index = mCurrent & SlotMask;
+            if(index == 0)
+            {
+               for(int level = 1; level < Levels && index == 0; ++level)
+               {
+                  index = (mCurrent >> (SlotBits * level)) & SlotMask;
+                  cascade(level, index);
+               }
+               index = 0;
+            }
+
+            // take all of the timers in this tick's slot
+            TimerList& slot = mSlots[0][index];
+            uint32_t count = 0;
+            for(TimerList::iterator i = slot.begin(); i != slot.end(); ++i)
+            {
+               (*i)->level = -1;
+               (*i)->slot = NULL;
+               ++count;
+            }
+            due.splice(due.end(), slot);
+            mLevelCounts[0] -= count;
+            mCount -= count;
+            ++mCurrent;
+
+            // skip empty ticks up to the next rotation of the first wheel
+            if(mLevelCounts[0] == 0 && (mCurrent & SlotMask) != 0)
+            {
+               uint64_t next = (mCurrent | SlotMask) + 1;
+               mCurrent = (next > nowTick + 1 ? nowTick + 1 : next);
+            }
+         }
+      }
+
+      // reschedule periodic timers, skipping any missed intervals
+      runnables.reserve(32);
+      for(TimerList::iterator i = due.begin(); i != due.end(); ++i)
+      {
+         TimerRef& t = *i;
+         runnables.push_back(t->runnable);
+         if(t->interval > 0)
+         {
+            t->expires += t->interval;
+            if(t->expires <= nowTick)
+            {
+               t->expires = nowTick + t->interval;
+            }
+            insert(t);
+         }
+      }
+   }
+   mLock.unlock();
+
+   // run timers without the lock so they can schedule and cancel timers
+   for(vector<RunnableRef>::iterator i = runnables.begin();
+       i != runnables.end(); ++i)
+   {
+      (*i)->run();
+   }
+   mRunLock.unlock();
+
+   return runnables.size();
+}
+
+uint32_t TimingWheel::getNextTimeout(uint64_t now)
+{
+   uint32_t rval = 0;
+
+   mLock.lock();
+   {
+      uint64_t next = getNextTick();
+      if(next != NO_TICK)
+      {
+         next *= mTickLength;
+         rval = (next <= now ? 1 :
+            (next - now > MAX_WAIT ? MAX_WAIT : next - now));
+      }
+   }
+   mLock.unlock();
+
+   return rval;
+}
+
+void TimingWheel::run()
+{
+   Thread* thread = Thread::currentThread();
+   while(!thread->isInterrupted())
+   {
+      advance(System::getCurrentMilliseconds());
+
+      // sleep until the next timer may be due or one is scheduled earlier
+      mLock.lock();
+      {
+         uint64_t now = System::getCurrentMilliseconds();
+         uint64_t next = getNextTick();
+         if(next == NO_TICK || next > now / mTickLength)
+         {
+            uint32_t timeout = 0;
+            if(next != NO_TICK)
+            {
+               uint64_t ms = next * mTickLength - now;
+               timeout = (ms > MAX_WAIT ? MAX_WAIT : ms);
+            }
+            mWakeTick = next;
+            mWakeUp = false;
+            mLock.wait(timeout, &mWakeUp, true);
+            mWakeTick = 0;
+         }
+      }
+      mLock.unlock();
+   }
+}
+
+bool TimingWheel::start()
+{
+   bool rval = true;
+
+   mLock.lock();
+   {
+      if(mThread == NULL)
+      {
+         mThread = new Thread(this, "TimingWheel");
+         if(!(rval = mThread->start()))
+         {
+            delete mThread;
+            mThread = NULL;
+         }
+      }
+   }
+   mLock.unlock();
+
+   return rval;
+}
+
+void TimingWheel::stop()
+{
+   mLock.lock();
+   Thread* thread = mThread;
+   mThread = NULL;
+   mLock.unlock();
+
+   if(thread != NULL)
+   {
+      thread->interrupt();
+      thread->join();
+      delete thread;
+   }
+}
+
+void TimingWheel::synchronize()
+{
+   // the run lock is recursive, so a running timer does not wait for itself
+   mRunLock.lock();
+   mRunLock.unlock();
+}
+
+TimingWheel* TimingWheel::acquireShared()
+{
+   pthread_once(&sSharedOnce, createShared);
+
+   sSharedLock->lock();
+   {
+      if(sSharedUsers++ == 0)
+      {
+         sShared->start();
+      }
+   }
+   sSharedLock->unlock();
+
+   return sShared;
+}
+
+void TimingWheel::releaseShared()
+{
+   pthread_once(&sSharedOnce, createShared);
+
+   sSharedLock->lock();
+   {
+      if(sSharedUsers > 0 && --sSharedUsers == 0)
+      {
+         sShared->stop();
+      }
+   }
+   sSharedLock->unlock();
+}
+
+void TimingWheel::insert(TimerRef& t)
+{
+   // the delta is never negative, timers are due no earlier than the next
+   // tick to run, and is clamped to what the wheels cover
+   uint64_t expires = t->expires;
+   if(expires < mCurrent)
+   {
+      expires = mCurrent;
+   }
+   else if(expires - mCurrent > MAX_DELTA)
+   {
+      expires = mCurrent + MAX_DELTA;
+   }
+   uint64_t delta = expires - mCurrent;
+
+   // find the lowest wheel that reaches the timer
+   int level = 0;
+   while(level < Levels - 1 &&
+         delta >= (((uint64_t)1) << (SlotBits * (level + 1))))
+   {
+      ++level;
+   }
+
+   TimerList& slot =
+      mSlots[level][(expires >> (SlotBits * level)) & SlotMask];
+   t->level = level;
+   t->slot = &slot;
+   t->position = slot.insert(slot.end(), t);
+   ++mLevelCounts[level];
+   ++mCount;
+}
+
+void TimingWheel::unlink(Timer* t)
+{
+   --mLevelCounts[t->level];
+   --mCount;
+   t->level = -1;
+   TimerList* slot = t->slot;
+   t->slot = NULL;
+   slot->erase(t->position);
+}
+
+void TimingWheel::cascade(int level, int slot)
+{
+   TimerList& list = mSlots[level][slot];
+   if(!list.empty())
+   {
+      // take the whole slot before reinserting, a timer may land in the
+      // same slot again
+      TimerList timers;
+      timers.splice(timers.end(), list);
+      for(TimerList::iterator i = timers.begin(); i != timers.end(); ++i)
+      {
+         --mLevelCounts[level];
+         --mCount;
+         insert(*i);
+      }
+   }
+}
+
+uint64_t TimingWheel::getNextTick()
+{
+   uint64_t rval = NO_TICK;
+
+   if(mCount > 0)
+   {
+      // timers in the first wheel are due exactly at their slot's tick
+      if(mLevelCounts[0] > 0)
+      {
+         for(int i = 0; rval == NO_TICK && i < Slots; ++i)
+         {
+            if(!mSlots[0][(mCurrent + i) & SlotMask].empty())
+            {
+               rval = mCurrent + i;
+            }
+         }
+      }
+
+      // timers in the other wheels may be due once their slot is cascaded,
+      // which happens when the wheel below starts its next rotation
+      for(int level = 1; level < Levels; ++level)
+      {
+         if(mLevelCounts[level] > 0)
+         {
+            int shift = SlotBits * level;
+            uint64_t base = mCurrent >> shift;
+            bool aligned = ((base << shift) == mCurrent);
+            bool found = false;
+            for(int i = (aligned ? 0 : 1); !found && i <= Slots; ++i)
+            {
+               if(!mSlots[level][(base + i) & SlotMask].empty())
+               {
+                  found = true;
+                  uint64_t tick = (base + i) << shift;
+                  if(tick < rval)
+                  {
+                     rval = tick;
+                  }
+               }
+            }
+         }
+      }
+   }
+
+   return rval;
+}
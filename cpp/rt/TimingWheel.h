@@ -0,0 +1,271 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#ifndef monarch_rt_TimingWheel_H
+#define monarch_rt_TimingWheel_H
+
+#include "monarch/rt/ExclusiveLock.h"
+#include "monarch/rt/Runnable.h"
+#include "monarch/rt/Thread.h"
+
+#include <list>
+
+namespace monarch
+{
+namespace rt
+{
+
+/**
+ * A TimingWheel runs Runnables after a delay, once or periodically. It is a
+ * hierarchical timing wheel: timers are kept in buckets by the tick they
+ * expire at instead of in a sorted structure, so scheduling and cancelling a
+ * timer are O(1) no matter how many timers are scheduled.
+ *
+ * There are 4 wheels with 256 slots each. The first wheel has a slot for
+ * each of the next 256 ticks, the second a slot for each of the next 256
+ * rotations of the first wheel, and so on, covering 2^32 ticks. As time
+ * advances the slots of the first wheel are run in turn, and each time it
+ * completes a rotation the next slot of the second wheel is cascaded down
+ * into it. A timer is cascaded at most 3 times over its life.
+ *
+ * A wheel is advanced by calling advance(), which runs all due timers on the
+ * calling thread, or by start(), which runs it on its own thread. It may also
+ * be driven by any other thread by calling run(). Timers are run without the
+ * wheel locked, so they may schedule or cancel timers, including their own.
+ *
+ * There is also a shared wheel for the whole process, see acquireShared(),
+ * so that components like pools and daemons do not each need a thread to
+ * run their timers.
+ */
+class TimingWheel : public Runnable
+{
+public:
+   /**
+    * The number of wheels and slots per wheel.
+    */
+   enum
+   {
+      Levels = 4,
+      SlotBits = 8,
+      Slots = 1 << SlotBits,
+      SlotMask = Slots - 1
+   };
+
+   /**
+    * A Timer is a scheduled Runnable. It is created by schedule() and may be
+    * used to cancel the Runnable.
+    */
+   struct Timer;
+   typedef Collectable<Timer> TimerRef;
+   typedef std::list<TimerRef> TimerList;
+   struct Timer
+   {
+      RunnableRef runnable;
+      uint64_t expires;
+      uint64_t interval;
+      int level;
+      TimerList* slot;
+      TimerList::iterator position;
+   };
+
+protected:
+   /**
+    * The slots of each wheel.
+    */
+   TimerList mSlots[Levels][Slots];
+
+   /**
+    * The number of timers in each wheel.
+    */
+   uint32_t mLevelCounts[Levels];
+
+   /**
+    * The number of scheduled timers.
+    */
+   uint32_t mCount;
+
+   /**
+    * The length of a tick in milliseconds.
+    */
+   uint32_t mTickLength;
+
+   /**
+    * The next tick to run.
+    */
+   uint64_t mCurrent;
+
+   /**
+    * The tick the service thread is sleeping until, 0 if it is not sleeping
+    * and UINT64_MAX if it is sleeping until a timer is scheduled.
+    */
+   uint64_t mWakeTick;
+
+   /**
+    * Set to true to wake up the service thread.
+    */
+   bool mWakeUp;
+
+   /**
+    * A lock for the wheels and waiting.
+    */
+   ExclusiveLock mLock;
+
+   /**
+    * A lock held while advancing, which includes running due timers.
+    */
+   ExclusiveLock mRunLock;
+
+   /**
+    * The thread running this wheel when started with start().
+    */
+   Thread* mThread;
+
+public:
+   /**
+    * Creates a new TimingWheel.
+    *
+    * @param tickLength the length of a tick in milliseconds, timers run at
+    *                   most one tick late.
+    */
+   TimingWheel(uint32_t tickLength = 1);
+
+   /**
+    * Destructs this TimingWheel, stopping its thread if it was started.
+    */
+   virtual ~TimingWheel();
+
+   /**
+    * Schedules a Runnable to run after a delay and then optionally every
+    * interval after that.
+    *
+    * @param r the Runnable to run.
+    * @param delay the delay in milliseconds.
+    * @param interval the interval in milliseconds to run the Runnable again
+    *                 at, 0 to run it only once.
+    *
+    * @return the Timer for the Runnable.
+    */
+   virtual TimerRef schedule(
+      RunnableRef& r, uint32_t delay, uint32_t interval = 0);
+
+   /**
+    * Cancels a Timer. If it is running it will finish, but it will not run
+    * again.
+    *
+    * @param t the Timer to cancel.
+    *
+    * @return true if the Timer was scheduled, false if not.
+    */
+   virtual bool cancel(TimerRef& t);
+
+   /**
+    * Cancels all Timers.
+    */
+   virtual void clear();
+
+   /**
+    * Gets the number of scheduled Timers.
+    *
+    * @return the number of scheduled Timers.
+    */
+   virtual uint32_t getTimerCount();
+
+   /**
+    * Runs all Timers that are due at the given time.
+    *
+    * @param now the current time in milliseconds.
+    *
+    * @return the number of Timers that were run.
+    */
+   virtual uint32_t advance(uint64_t now);
+
+   /**
+    * Gets the time until the next Timer may be due. This may be earlier than
+    * the next Timer expires when it has yet to be cascaded.
+    *
+    * @param now the current time in milliseconds.
+    *
+    * @return the time in milliseconds, at least 1, or 0 if no Timers are
+    *         scheduled.
+    */
+   virtual uint32_t getNextTimeout(uint64_t now);
+
+   /**
+    * Advances this wheel as time passes until the current thread is
+    * interrupted.
+    */
+   virtual void run();
+
+   /**
+    * Starts a thread that runs this wheel.
+    *
+    * @return true if the thread was started, false if not.
+    */
+   virtual bool start();
+
+   /**
+    * Stops the thread running this wheel, if any. Timers are kept.
+    */
+   virtual void stop();
+
+   /**
+    * Waits for any timers that are running to finish. If this is called by a
+    * running timer it returns right away. After a Timer is cancelled and this
+    * returns, its Runnable is not running and will not run again, so whatever
+    * it uses may be freed.
+    */
+   virtual void synchronize();
+
+   /**
+    * Gets the process-wide shared TimingWheel and starts its thread if it is
+    * not running. Each call must be balanced by a call to releaseShared().
+    *
+    * @return the shared TimingWheel.
+    */
+   static TimingWheel* acquireShared();
+
+   /**
+    * Releases the shared TimingWheel. Its thread is stopped once it has been
+    * released as many times as it was acquired, so any timers scheduled on
+    * it should be cancelled first. This must not be called by a timer
+    * running on the shared wheel.
+    */
+   static void releaseShared();
+
+protected:
+   /**
+    * Adds a Timer to the slot for its expiration tick. The lock must be
+    * engaged.
+    *
+    * @param t the Timer to add.
+    */
+   virtual void insert(TimerRef& t);
+
+   /**
+    * Removes a scheduled Timer from its slot. The lock must be engaged.
+    *
+    * @param t the Timer to remove.
+    */
+   virtual void unlink(Timer* t);
+
+   /**
+    * Moves the Timers in a slot down to the wheels below it. The lock must
+    * be engaged.
+    *
+    * @param level the wheel.
+    * @param slot the slot.
+    */
+   virtual void cascade(int level, int slot);
+
+   /**
+    * Gets the first tick at which a Timer may be due. The lock must be
+    * engaged.
+    *
+    * @return the tick, UINT64_MAX if no Timers are scheduled.
+    */
+   virtual uint64_t getNextTick();
+};
+
+} // end namespace rt
+} // end namespace monarch
+#endif
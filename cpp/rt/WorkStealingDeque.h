@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#ifndef monarch_rt_WorkStealingDeque_H
+#define monarch_rt_WorkStealingDeque_H
+
+#include "monarch/rt/Atomic.h"
+
+#include <vector>
+
+namespace monarch
+{
+namespace rt
+{
+
+/**
+ * A WorkStealingDeque is a lock-free double-ended queue of pointers that is
+ * owned by a single thread. Its implementation is based on "Dynamic Circular
+ * Work-Stealing Deque" by David Chase and Yossi Lev (SPAA 2005).
+ *
+ * Only the owner may push() and pop(), which work on the bottom of the deque
+ * in LIFO order, so the most recently pushed (and likely cache-hot) item is
+ * popped first. Any other thread may steal() from the top of the deque in
+ * FIFO order, taking the oldest item. The owner and thieves only contend
+ * when the deque is about to become empty.
+ *
+ * The deque grows as needed. Arrays that have been outgrown may still be
+ * read by thieves so they are only freed when the deque is destructed.
+ */
+template<typename _T>
+class WorkStealingDeque
+{
+protected:
+   /**
+    * A circular array of items.
+    */
+   struct Array
+   {
+      /**
+       * The size of the array, a power of 2.
+       */
+      int64_t size;
+
+      /**
+       * The items.
+       */
+      _T* volatile* items;
+
+      /**
+       * Gets the item at the given index.
+       *
+       * @param i the index, which wraps around.
+       *
+       * @return the item.
+       */
+      _T* get(int64_t i)
+      {
+         return items[i & (size - 1)];
+      };
+
+      /**
+       * Sets the item at the given index.
+       *
+       * @param i the index, which wraps around.
+       * @param item the item.
+       */
+      void put(int64_t i, _T* item)
+      {
+         items[i & (size - 1)] = item;
+      };
+   };
+
+   /**
+    * The index of the top item, incremented by steal() and by pop() when it
+    * takes the last item.
+    */
+   volatile int64_t mTop;
+
+   /**
+    * The index after the bottom item, only written by the owner.
+    */
+   volatile int64_t mBottom;
+
+   /**
+    * The current array.
+    */
+   Array* volatile mArray;
+
+   /**
+    * Outgrown arrays, freed on destruction.
+    */
+   std::vector<Array*> mOldArrays;
+
+public:
+   /**
+    * Creates a new, empty WorkStealingDeque.
+    *
+    * @param size the initial capacity, a power of 2.
+    */
+   WorkStealingDeque(int size = 256);
+
+   /**
+    * Destructs this WorkStealingDeque. Items that are still in the deque are
+    * not freed.
+    */
+   virtual ~WorkStealingDeque();
+
+   /**
+    * Pushes an item onto the bottom of this deque. Must only be called by the
+    * owner.
+    *
+    * @param item the item to push.
+    */
+   virtual void push(_T* item);
+
+   /**
+    * Pops the most recently pushed item from the bottom of this deque. Must
+    * only be called by the owner.
+    *
+    * @return the item or NULL if this deque is empty.
+    */
+   virtual _T* pop();
+
+   /**
+    * Steals the oldest item from the top of this deque. May be called by any
+    * thread. This may fail spuriously if another thread takes the same item
+    * at the same time.
+    *
+    * @return the item or NULL if none was stolen.
+    */
+   virtual _T* steal();
+
+   /**
+    * Gets the number of items in this deque. The result is only a snapshot
+    * if other threads are using the deque.
+    *
+    * @return the number of items.
+    */
+   virtual int size();
+
+protected:
+   /**
+    * Creates a new array.
+    *
+    * @param size the size of the array.
+    *
+    * @return the new array.
+    */
+   static Array* createArray(int64_t size);
+
+   /**
+    * Frees an array.
+    *
+    * @param a the array to free.
+    */
+   static void freeArray(Array* a);
+};
+
+template<typename _T>
+WorkStealingDeque<_T>::WorkStealingDeque(int size) :
+   mTop(0),
+   mBottom(0),
+   mArray(createArray(size))
+{
+}
+
+template<typename _T>
+WorkStealingDeque<_T>::~WorkStealingDeque()
+{
+   freeArray(mArray);
+   for(typename std::vector<Array*>::iterator i = mOldArrays.begin();
+       i != mOldArrays.end(); ++i)
+   {
+      freeArray(*i);
+   }
+}
+
+template<typename _T>
+void WorkStealingDeque<_T>::push(_T* item)
+{
+   int64_t b = mBottom;
+   int64_t t = mTop;
+   Array* a = mArray;
+   if(b - t >= a->size - 1)
+   {
+      // full, copy the items into an array twice the size
+      Array* grown = createArray(a->size * 2);
+      for(int64_t i = t; i < b; ++i)
+      {
+         grown->put(i, a->get(i));
+      }
+      mOldArrays.push_back(a);
+      Atomic::memoryBarrier();
+      mArray = a = grown;
+   }
+   a->put(b, item);
+
+   // publish the item before the new bottom
+   Atomic::memoryBarrier();
+   mBottom = b + 1;
+}
+
+template<typename _T>
+_T* WorkStealingDeque<_T>::pop()
+{
+   _T* rval = NULL;
+
+   // claim the bottom item before checking for thieves
+   int64_t b = mBottom - 1;
+   Array* a = mArray;
+   mBottom = b;
+   Atomic::memoryBarrier();
+   int64_t t = mTop;
+
+   if(t <= b)
+   {
+      rval = a->get(b);
+      if(t == b)
+      {
+         // last item, race thieves for it
+         if(!Atomic::compareAndSwap(&mTop, t, t + 1))
+         {
+            rval = NULL;
+         }
+         mBottom = b + 1;
+      }
+   }
+   else
+   {
+      // empty, restore bottom
+      mBottom = b + 1;
+   }
+
+   return rval;
+}
+
+template<typename _T>
+_T* WorkStealingDeque<_T>::steal()
+{
+   _T* rval = NULL;
+
+   int64_t t = mTop;
+   Atomic::memoryBarrier();
+   int64_t b = mBottom;
+   if(t < b)
+   {
+      // read the item before claiming it, it may be overwritten afterwards
+      Array* a = mArray;
+      rval = a->get(t);
+      if(!Atomic::compareAndSwap(&mTop, t, t + 1))
+      {
+         rval = NULL;
+      }
+   }
+
+   return rval;
+}
+
+template<typename _T>
+int WorkStealingDeque<_T>::size()
+{
+   int64_t rval = mBottom - mTop;
+   return (rval < 0) ? 0 : (int)rval;
+}
+
+template<typename _T>
+typename WorkStealingDeque<_T>::Array*
+   WorkStealingDeque<_T>::createArray(int64_t size)
+{
+   Array* rval = new Array;
+   rval->size = size;
+   rval->items = new _T*[size];
+   return rval;
+}
+
+template<typename _T>
+void WorkStealingDeque<_T>::freeArray(Array* a)
+{
+   delete [] a->items;
+   delete a;
+}
+
+} // end namespace rt
+} // end namespace monarch
+#endif
@@ -0,0 +1,622 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#include "monarch/rt/WorkStealingThreadPool.h"
+
+#include "monarch/rt/Atomic.h"
+#include "monarch/rt/Exception.h"
+#include "monarch/rt/System.h"
+
+using namespace monarch::rt;
+
+unsigned int WorkStealingThreadPool::INJECT_BATCH_SIZE = 32;
+
+WorkStealingThreadPool::Worker::Worker(
+   WorkStealingThreadPool* pool, unsigned int index) :
+   pool(pool),
+   index(index),
+   thread(NULL),
+   active(false),
+   expired(false),
+   seed(index * 2654435761U + 1)
+{
+}
+
+WorkStealingThreadPool::Worker::~Worker()
+{
+   delete thread;
+}
+
+void WorkStealingThreadPool::Worker::run()
+{
+   pthread_setspecific(pool->mWorkerKey, this);
+
+   while(!pool->retireWorker(this))
+   {
+      // an interruption only applies to the job that was running, unless
+      // the pool is terminating, then queued jobs run interrupted
+      if(!pool->mShutdown && Thread::interrupted(true))
+      {
+         Exception::clear();
+      }
+
+      Job* job = pool->findJob(this);
+      if(job != NULL)
+      {
+         Atomic::incrementAndFetch(&pool->mBusyWorkers);
+         pool->runQueuedJob(job);
+         Atomic::decrementAndFetch(&pool->mBusyWorkers);
+
+         // clear any exceptions left behind by the job
+         Exception::clear();
+      }
+      else
+      {
+         pool->park(this);
+      }
+   }
+
+   pthread_setspecific(pool->mWorkerKey, NULL);
+}
+
+WorkStealingThreadPool::WorkStealingThreadPool(
+   unsigned int poolSize, size_t stackSize) :
+   ThreadPool(poolSize, stackSize),
+   mWorkers(NULL),
+   mWorkerCount(0),
+   mWorkerCapacity(0),
+   mActiveWorkers(0),
+   mBusyWorkers(0),
+   mInjectedCount(0),
+   mSleepingWorkers(0),
+   mShutdown(false)
+{
+   pthread_key_create(&mWorkerKey, NULL);
+}
+
+WorkStealingThreadPool::~WorkStealingThreadPool()
+{
+   // stop workers and run queued jobs
+   WorkStealingThreadPool::terminateAllThreads();
+
+   for(unsigned int i = 0; i < mWorkerCount; ++i)
+   {
+      delete mWorkers[i];
+   }
+   delete [] mWorkers;
+   for(std::vector<Worker**>::iterator i = mOldWorkers.begin();
+       i != mOldWorkers.end(); ++i)
+   {
+      delete [] *i;
+   }
+
+   pthread_key_delete(mWorkerKey);
+}
+
+bool WorkStealingThreadPool::tryRunJob(Runnable& job)
+{
+   Job* j = new Job;
+   j->runnable = &job;
+   return submit(j, false);
+}
+
+bool WorkStealingThreadPool::tryRunJob(RunnableRef& job)
+{
+   Job* j = new Job;
+   j->runnable = NULL;
+   j->runnableRef = job;
+   return submit(j, false);
+}
+
+bool WorkStealingThreadPool::runJob(Runnable& job)
+{
+   Job* j = new Job;
+   j->runnable = &job;
+   return submit(j, true);
+}
+
+bool WorkStealingThreadPool::runJob(RunnableRef& job)
+{
+   Job* j = new Job;
+   j->runnable = NULL;
+   j->runnableRef = job;
+   return submit(j, true);
+}
+
+bool WorkStealingThreadPool::runPendingJob()
+{
+   bool rval = false;
+
+   Job* job = findJob(getCurrentWorker());
+   if(job != NULL)
+   {
+      runQueuedJob(job);
+      rval = true;
+   }
+
+   return rval;
+}
+
+void WorkStealingThreadPool::jobCompleted(PooledThread* t)
+{
+   // workers do not use PooledThreads
+}
+
+void WorkStealingThreadPool::interruptAllThreads()
+{
+   mListLock.lock();
+   {
+      for(unsigned int i = 0; i < mWorkerCount; ++i)
+      {
+         if(mWorkers[i]->active)
+         {
+            mWorkers[i]->thread->interrupt();
+         }
+      }
+   }
+   mListLock.unlock();
+}
+
+void WorkStealingThreadPool::terminateAllThreads()
+{
+   mJobLock.lock();
+   {
+      // stop accepting jobs from other threads and interrupt all workers
+      mListLock.lock();
+      {
+         mShutdown = true;
+         for(unsigned int i = 0; i < mWorkerCount; ++i)
+         {
+            if(mWorkers[i]->active)
+            {
+               mWorkers[i]->thread->interrupt();
+            }
+         }
+      }
+      mListLock.unlock();
+
+      // wake up sleeping workers
+      mIdleLock.lock();
+      mIdleLock.notifyAll();
+      mIdleLock.unlock();
+
+      // join workers, they run the queued jobs before they stop
+      for(unsigned int i = 0; i < mWorkerCount; ++i)
+      {
+         Worker* w = mWorkers[i];
+         if(w->thread != NULL)
+         {
+            w->thread->join();
+            delete w->thread;
+            w->thread = NULL;
+         }
+      }
+
+      // run any jobs left behind, ie: if no worker could be started, an
+      // accepted job must never be dropped
+      Job* job;
+      while((job = findJob(NULL)) != NULL)
+      {
+         runQueuedJob(job);
+      }
+
+      mListLock.lock();
+      mShutdown = false;
+      mListLock.unlock();
+   }
+   mJobLock.unlock();
+}
+
+void WorkStealingThreadPool::setPoolSize(unsigned int size)
+{
+   mListLock.lock();
+   {
+      mThreadSemaphore.setMaxPermitCount(size);
+   }
+   mListLock.unlock();
+
+   // wake up sleeping workers so that extra ones stop
+   mIdleLock.lock();
+   mIdleLock.notifyAll();
+   mIdleLock.unlock();
+
+   // start another worker if jobs are waiting
+   if(hasQueuedJobs())
+   {
+      signalWorker();
+   }
+}
+
+unsigned int WorkStealingThreadPool::getThreadCount()
+{
+   return mActiveWorkers;
+}
+
+unsigned int WorkStealingThreadPool::getRunningThreadCount()
+{
+   return mBusyWorkers;
+}
+
+unsigned int WorkStealingThreadPool::getIdleThreadCount()
+{
+   unsigned int active = mActiveWorkers;
+   unsigned int busy = mBusyWorkers;
+   return (busy > active) ? 0 : active - busy;
+}
+
+unsigned int WorkStealingThreadPool::getQueuedJobCount()
+{
+   unsigned int rval = mInjectedCount;
+
+   unsigned int count = mWorkerCount;
+   Atomic::memoryBarrier();
+   Worker** workers = mWorkers;
+   for(unsigned int i = 0; i < count; ++i)
+   {
+      rval += workers[i]->deque.size();
+   }
+
+   return rval;
+}
+
+bool WorkStealingThreadPool::submit(Job* job, bool block)
+{
+   bool rval = true;
+
+   Worker* w = getCurrentWorker();
+   if(w != NULL)
+   {
+      // spawned by a running job, keep it local and do not take a permit
+      // so that a job waiting on its subjobs cannot deadlock the pool
+      job->permit = false;
+      w->deque.push(job);
+   }
+   else
+   {
+      // take a permit for the job, it is returned once the job has run
+      job->permit = true;
+      rval = block ?
+         mThreadSemaphore.acquire() : mThreadSemaphore.tryAcquire();
+      if(rval && mShutdown)
+      {
+         mThreadSemaphore.release();
+         rval = false;
+      }
+
+      if(rval)
+      {
+         mInjectLock.lock();
+         {
+            mInjectedJobs.push_back(job);
+            ++mInjectedCount;
+         }
+         mInjectLock.unlock();
+      }
+      else
+      {
+         delete job;
+      }
+   }
+
+   if(rval)
+   {
+      signalWorker();
+   }
+
+   return rval;
+}
+
+WorkStealingThreadPool::Job* WorkStealingThreadPool::findJob(Worker* w)
+{
+   Job* rval = NULL;
+
+   if(w != NULL)
+   {
+      rval = w->deque.pop();
+   }
+   if(rval == NULL)
+   {
+      rval = takeInjectedJobs(w);
+   }
+   if(rval == NULL)
+   {
+      rval = stealJob(w);
+   }
+
+   return rval;
+}
+
+WorkStealingThreadPool::Job* WorkStealingThreadPool::takeInjectedJobs(
+   Worker* w)
+{
+   Job* rval = NULL;
+
+   if(mInjectedCount > 0)
+   {
+      bool extra = false;
+      mInjectLock.lock();
+      {
+         if(!mInjectedJobs.empty())
+         {
+            rval = mInjectedJobs.front();
+            mInjectedJobs.pop_front();
+            --mInjectedCount;
+
+            if(w != NULL)
+            {
+               // take a fair share of the rest, up to the batch size
+               unsigned int active = mActiveWorkers;
+               unsigned int n = mInjectedCount / (active > 0 ? active : 1);
+               if(n > INJECT_BATCH_SIZE)
+               {
+                  n = INJECT_BATCH_SIZE;
+               }
+               extra = (n > 0);
+               for(; n > 0; --n)
+               {
+                  w->deque.push(mInjectedJobs.front());
+                  mInjectedJobs.pop_front();
+                  --mInjectedCount;
+               }
+            }
+         }
+      }
+      mInjectLock.unlock();
+
+      if(extra)
+      {
+         // let another worker steal some of the batch
+         signalWorker();
+      }
+   }
+
+   return rval;
+}
+
+WorkStealingThreadPool::Job* WorkStealingThreadPool::stealJob(Worker* w)
+{
+   Job* rval = NULL;
+
+   unsigned int count = mWorkerCount;
+   Atomic::memoryBarrier();
+   Worker** workers = mWorkers;
+   if(count > 0)
+   {
+      // pick a random victim to start at to spread out thieves
+      unsigned int start = 0;
+      if(w != NULL)
+      {
+         w->seed ^= w->seed << 13;
+         w->seed ^= w->seed >> 17;
+         w->seed ^= w->seed << 5;
+         start = w->seed % count;
+      }
+
+      for(unsigned int i = 0; rval == NULL && i < count; ++i)
+      {
+         Worker* victim = workers[(start + i) % count];
+         if(victim != w)
+         {
+            rval = victim->deque.steal();
+         }
+      }
+   }
+
+   return rval;
+}
+
+void WorkStealingThreadPool::runQueuedJob(Job* job)
+{
+   if(job->runnable != NULL)
+   {
+      job->runnable->run();
+   }
+   else
+   {
+      job->runnableRef->run();
+   }
+   if(job->permit)
+   {
+      mThreadSemaphore.release();
+   }
+   delete job;
+}
+
+bool WorkStealingThreadPool::hasQueuedJobs()
+{
+   return getQueuedJobCount() > 0;
+}
+
+void WorkStealingThreadPool::park(Worker* w)
+{
+   mIdleLock.lock();
+   {
+      // announce sleeping before checking for jobs so that a job that is
+      // queued after the check will wake this worker
+      Atomic::incrementAndFetch(&mSleepingWorkers);
+      if(!mShutdown && w->index < getPoolSize() && !hasQueuedJobs())
+      {
+         uint32_t expireTime = mThreadExpireTime;
+         uint64_t start = System::getMonotonicMicroseconds();
+         if(!mIdleLock.wait(expireTime))
+         {
+            // interrupted
+            Exception::clear();
+         }
+         else if(expireTime != 0 &&
+            System::getMonotonicMicroseconds() - start >=
+               (uint64_t)expireTime * 1000)
+         {
+            w->expired = true;
+         }
+      }
+      Atomic::decrementAndFetch(&mSleepingWorkers);
+   }
+   mIdleLock.unlock();
+}
+
+void WorkStealingThreadPool::wakeWorker()
+{
+   // make the queued job visible before checking for sleeping workers
+   Atomic::memoryBarrier();
+   if(mSleepingWorkers > 0)
+   {
+      mIdleLock.lock();
+      mIdleLock.notify();
+      mIdleLock.unlock();
+   }
+}
+
+void WorkStealingThreadPool::signalWorker()
+{
+   // make the queued job visible before checking for sleeping workers
+   Atomic::memoryBarrier();
+   if(mSleepingWorkers > 0)
+   {
+      mIdleLock.lock();
+      mIdleLock.notify();
+      mIdleLock.unlock();
+   }
+   else if(mActiveWorkers < getPoolSize())
+   {
+      startWorker();
+   }
+}
+
+void WorkStealingThreadPool::startWorker()
+{
+   // threads from the workers' last runs, joined once unlocked because a
+   // retiring worker may still need the list lock
+   Thread* old = NULL;
+
+   mListLock.lock();
+   {
+      // a worker on its way out may not restart itself
+      Worker* self = static_cast<Worker*>(pthread_getspecific(mWorkerKey));
+      unsigned int size = getPoolSize();
+      bool started = false;
+      for(unsigned int i = 0;
+          !started && !mShutdown && mActiveWorkers < size && i < size; ++i)
+      {
+         if(i == mWorkerCount)
+         {
+            if(mWorkerCount == mWorkerCapacity)
+            {
+               // grow the worker array, thieves may still use the old one
+               unsigned int capacity =
+                  (mWorkerCapacity == 0) ? 16 : mWorkerCapacity * 2;
+               Worker** workers = new Worker*[capacity];
+               for(unsigned int n = 0; n < mWorkerCount; ++n)
+               {
+                  workers[n] = mWorkers[n];
+               }
+               if(mWorkers != NULL)
+               {
+                  mOldWorkers.push_back((Worker**)mWorkers);
+               }
+               Atomic::memoryBarrier();
+               mWorkers = workers;
+               mWorkerCapacity = capacity;
+            }
+
+            // publish the new worker before increasing the count
+            mWorkers[i] = new Worker(this, i);
+            Atomic::memoryBarrier();
+            mWorkerCount = i + 1;
+         }
+
+         Worker* w = mWorkers[i];
+         if(!w->active && w != self)
+         {
+            old = w->thread;
+            w->thread = new Thread(w, "WorkStealingThreadPool worker");
+            if(!mThreadGroup.isNull())
+            {
+               mThreadGroup->placeThread(w->thread);
+            }
+            w->active = true;
+            w->expired = false;
+            Atomic::incrementAndFetch(&mActiveWorkers);
+            if(!w->thread->start(mThreadStackSize))
+            {
+               // try again with the next job
+               Atomic::decrementAndFetch(&mActiveWorkers);
+               w->active = false;
+               delete w->thread;
+               w->thread = NULL;
+               Exception::clear();
+            }
+            started = true;
+         }
+      }
+   }
+   mListLock.unlock();
+
+   // clean up the thread from the worker's last run
+   if(old != NULL)
+   {
+      old->join();
+      delete old;
+   }
+}
+
+bool WorkStealingThreadPool::retireWorker(Worker* w)
+{
+   bool rval = false;
+
+   if(w->index >= getPoolSize() ||
+      ((mShutdown || w->expired) && !hasQueuedJobs()))
+   {
+      // re-check with the list lock held so a concurrent start sees the
+      // worker as either active or retired
+      mListLock.lock();
+      {
+         if(w->index >= getPoolSize() ||
+            ((mShutdown || w->expired) && !hasQueuedJobs()))
+         {
+            Atomic::decrementAndFetch(&mActiveWorkers);
+            w->active = false;
+            rval = true;
+         }
+      }
+      mListLock.unlock();
+   }
+   w->expired = false;
+
+   if(rval && !mShutdown)
+   {
+      // a job queued while retiring may have counted this worker as
+      // active, so pass it on to a sleeping worker or stay to run it
+      // unless this worker's slot has been restarted in the meantime
+      Atomic::memoryBarrier();
+      if(hasQueuedJobs())
+      {
+         if(mSleepingWorkers > 0)
+         {
+            wakeWorker();
+         }
+         else if(w->index < getPoolSize())
+         {
+            mListLock.lock();
+            {
+               if(!mShutdown && !w->active &&
+                  mActiveWorkers < getPoolSize())
+               {
+                  Atomic::incrementAndFetch(&mActiveWorkers);
+                  w->active = true;
+                  rval = false;
+               }
+            }
+            mListLock.unlock();
+         }
+      }
+   }
+
+   return rval;
+}
+
+WorkStealingThreadPool::Worker* WorkStealingThreadPool::getCurrentWorker()
+{
+   Worker* rval = static_cast<Worker*>(pthread_getspecific(mWorkerKey));
+   return (rval != NULL && rval->active) ? rval : NULL;
+}
@@ -0,0 +1,372 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ */
+#ifndef monarch_rt_WorkStealingThreadPool_H
+#define monarch_rt_WorkStealingThreadPool_H
+
+#include "monarch/rt/ThreadPool.h"
+#include "monarch/rt/WorkStealingDeque.h"
+
+#include <pthread.h>
+#include <list>
+#include <vector>
+
+namespace monarch
+{
+namespace rt
+{
+
+/**
+ * A WorkStealingThreadPool is a ThreadPool that queues jobs on a set of
+ * worker threads instead of handing each job to an idle thread under a
+ * single lock.
+ *
+ * Every worker has its own lock-free deque of jobs. A job that is run from
+ * one of the workers (ie: a subjob spawned by a running job) is pushed onto
+ * that worker's deque. Jobs from any other thread are put into a shared
+ * queue that workers take batches from. A worker runs the jobs on its own
+ * deque newest first, which keeps related work on the same, cache-hot, core.
+ * When it has nothing left to do it steals the oldest job from another
+ * worker's deque and only goes to sleep if no work can be found anywhere.
+ *
+ * Like a ThreadPool, the pool size limits both the number of workers and
+ * the number of jobs that are accepted from other threads, whether they are
+ * running or queued. tryRunJob() fails and runJob() blocks while that many
+ * jobs are outstanding, so callers such as a JobDispatcher keep their own
+ * queues and priorities. Subjobs queued by a running job are always accepted
+ * so that a job waiting for its subjobs cannot deadlock the pool. A job that
+ * has to wait for its subjobs can call runPendingJob() to help run queued
+ * jobs in the meantime.
+ *
+ * Workers are started one at a time as jobs are queued and no worker is
+ * idle. Idle workers expire after the thread expire time, if one is set.
+ *
+ * Terminating the pool interrupts the workers and then runs every job that
+ * was accepted but has not started, so each accepted job is run exactly
+ * once.
+ */
+class WorkStealingThreadPool : public ThreadPool
+{
+protected:
+   /**
+    * A queued job, either a Runnable or a RunnableRef.
+    */
+   struct Job
+   {
+      Runnable* runnable;
+      RunnableRef runnableRef;
+      bool permit;
+   };
+
+   /**
+    * A Worker runs jobs on its own thread.
+    */
+   struct Worker : public Runnable
+   {
+      /**
+       * The pool the worker belongs to.
+       */
+      WorkStealingThreadPool* pool;
+
+      /**
+       * The index of the worker in the pool.
+       */
+      unsigned int index;
+
+      /**
+       * The jobs queued on the worker.
+       */
+      WorkStealingDeque<Job> deque;
+
+      /**
+       * The thread the worker runs on, NULL if it has never been started.
+       */
+      Thread* thread;
+
+      /**
+       * True while the worker's thread is running jobs.
+       */
+      volatile bool active;
+
+      /**
+       * Set to true once the worker has been idle for the thread expire
+       * time.
+       */
+      bool expired;
+
+      /**
+       * State for choosing the workers to steal from.
+       */
+      unsigned int seed;
+
+      /**
+       * Creates a new Worker.
+       *
+       * @param pool the pool the worker belongs to.
+       * @param index the index of the worker in the pool.
+       */
+      Worker(WorkStealingThreadPool* pool, unsigned int index);
+
+      /**
+       * Destructs this Worker.
+       */
+      virtual ~Worker();
+
+      /**
+       * Runs jobs until the worker is no longer needed.
+       */
+      virtual void run();
+   };
+
+   /**
+    * The workers, published without locking so that they can be stolen
+    * from. Arrays that have been outgrown are kept until destruction.
+    */
+   Worker** volatile mWorkers;
+   volatile unsigned int mWorkerCount;
+   unsigned int mWorkerCapacity;
+   std::vector<Worker**> mOldWorkers;
+
+   /**
+    * The number of workers that are active and of those that are running
+    * a job.
+    */
+   volatile unsigned int mActiveWorkers;
+   volatile unsigned int mBusyWorkers;
+
+   /**
+    * The shared queue for jobs that are not run from a worker.
+    */
+   typedef std::list<Job*> JobList;
+   JobList mInjectedJobs;
+   volatile unsigned int mInjectedCount;
+   ExclusiveLock mInjectLock;
+
+   /**
+    * A lock for idle workers to wait on and the number of waiting workers.
+    */
+   ExclusiveLock mIdleLock;
+   volatile unsigned int mSleepingWorkers;
+
+   /**
+    * True while the pool is being terminated.
+    */
+   volatile bool mShutdown;
+
+   /**
+    * The key for the worker that is running on the current thread.
+    */
+   pthread_key_t mWorkerKey;
+
+   /**
+    * The maximum number of jobs a worker takes from the shared queue at
+    * once.
+    */
+   static unsigned int INJECT_BATCH_SIZE;
+
+   /**
+    * Queues a job on the current worker or, if this is not a worker
+    * thread, on the shared queue, and gets a worker to run it. A job from
+    * another thread first takes one of the pool's permits.
+    *
+    * @param job the job to queue.
+    * @param block true to wait for a permit, false to fail if none is left.
+    *
+    * @return true if the job was queued, false if not (the job is freed).
+    */
+   virtual bool submit(Job* job, bool block);
+
+   /**
+    * Finds a job for a worker to run: from its own deque, the shared queue
+    * or, failing that, by stealing from another worker.
+    *
+    * @param w the worker, NULL for a thread that is not a worker.
+    *
+    * @return the job or NULL if none was found.
+    */
+   virtual Job* findJob(Worker* w);
+
+   /**
+    * Takes a batch of jobs from the shared queue. The first is returned and
+    * the rest are pushed onto the worker's deque.
+    *
+    * @param w the worker, NULL to take a single job.
+    *
+    * @return the first job or NULL if the queue is empty.
+    */
+   virtual Job* takeInjectedJobs(Worker* w);
+
+   /**
+    * Steals a job from another worker, starting at a random one.
+    *
+    * @param w the stealing worker, NULL for a thread that is not a worker.
+    *
+    * @return the stolen job or NULL if none was found.
+    */
+   virtual Job* stealJob(Worker* w);
+
+   /**
+    * Runs a job, frees it and returns its permit, if any.
+    *
+    * @param job the job to run.
+    */
+   virtual void runQueuedJob(Job* job);
+
+   /**
+    * Returns true if there are any queued jobs.
+    *
+    * @return true if jobs are queued, false if not.
+    */
+   virtual bool hasQueuedJobs();
+
+   /**
+    * Puts a worker to sleep until a job is queued, unless one already is.
+    * The worker is marked expired if it sleeps for the thread expire time.
+    *
+    * @param w the worker.
+    */
+   virtual void park(Worker* w);
+
+   /**
+    * Wakes up a sleeping worker, if any.
+    */
+   virtual void wakeWorker();
+
+   /**
+    * Gets a worker to run a newly queued job: wakes up a sleeping worker or,
+    * if none is sleeping, starts another one if the pool is not full.
+    */
+   virtual void signalWorker();
+
+   /**
+    * Starts one more worker if there are fewer than the pool size.
+    */
+   virtual void startWorker();
+
+   /**
+    * Called by a worker to decide whether it should stop, because the pool
+    * shrank, it expired or the pool is terminating and no jobs are left. If
+    * so, it is marked inactive.
+    *
+    * @param w the worker.
+    *
+    * @return true if the worker should stop, false if not.
+    */
+   virtual bool retireWorker(Worker* w);
+
+   /**
+    * Gets the worker running on the current thread.
+    *
+    * @return the worker or NULL if the current thread is not a worker.
+    */
+   virtual Worker* getCurrentWorker();
+
+public:
+   /**
+    * Creates a new WorkStealingThreadPool with the specified number of
+    * worker threads.
+    *
+    * @param poolSize the size of the pool (number of workers).
+    * @param stackSize the minimum size for each thread's stack, in bytes, 0
+    *                  for the system default.
+    */
+   WorkStealingThreadPool(unsigned int poolSize = 10, size_t stackSize = 0);
+
+   /**
+    * Destructs this WorkStealingThreadPool.
+    */
+   virtual ~WorkStealingThreadPool();
+
+   /**
+    * Queues the passed Runnable job if fewer jobs than the pool size are
+    * running or queued, or if it is queued by a running job.
+    *
+    * @param job the Runnable job to run.
+    *
+    * @return true if the job was queued, false if the pool is full or
+    *         terminating.
+    */
+   virtual bool tryRunJob(Runnable& job);
+   virtual bool tryRunJob(RunnableRef& job);
+
+   /**
+    * Queues the passed Runnable job, waiting until fewer jobs than the pool
+    * size are running or queued unless it is queued by a running job.
+    *
+    * @param job the Runnable job to run.
+    *
+    * @return true if the job was queued, false if the current thread was
+    *         interrupted (with an exception set) or the pool is terminating.
+    */
+   virtual bool runJob(Runnable& job);
+   virtual bool runJob(RunnableRef& job);
+
+   /**
+    * Runs one queued job on the current thread, if there is one. A job can
+    * call this while it waits for its subjobs to complete so that they, or
+    * other jobs, make progress.
+    *
+    * @return true if a job was run, false if none was found.
+    */
+   virtual bool runPendingJob();
+
+   /**
+    * Does nothing, workers do not use PooledThreads.
+    *
+    * @param t the thread that completed its job.
+    */
+   virtual void jobCompleted(PooledThread* t);
+
+   /**
+    * Interrupts all workers. The interruption only lasts until the current
+    * job of a worker completes.
+    */
+   virtual void interruptAllThreads();
+
+   /**
+    * Interrupts all workers, lets them run the jobs that are still queued
+    * and joins them. Jobs that no worker ran are run on the current thread.
+    */
+   virtual void terminateAllThreads();
+
+   /**
+    * Sets the number of workers in this thread pool and the number of jobs
+    * it accepts. Extra workers stop once they have finished their current
+    * job.
+    *
+    * @param size the number of workers in this thread pool.
+    */
+   virtual void setPoolSize(unsigned int size);
+
+   /**
+    * Gets the current number of workers.
+    *
+    * @return the current number of workers.
+    */
+   virtual unsigned int getThreadCount();
+
+   /**
+    * Gets the current number of workers that are running a job.
+    *
+    * @return the current number of running workers.
+    */
+   virtual unsigned int getRunningThreadCount();
+
+   /**
+    * Gets the current number of workers that are not running a job.
+    *
+    * @return the current number of idle workers.
+    */
+   virtual unsigned int getIdleThreadCount();
+
+   /**
+    * Gets the number of jobs that are queued and have not started running.
+    *
+    * @return the number of queued jobs.
+    */
+   virtual unsigned int getQueuedJobCount();
+};
+
+} // end namespace rt
+} // end namespace monarch
+#endif
@@ -1,8 +1,10 @@
 /*
- * Copyright (c) 2007-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2007-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #include "monarch/sql/AbstractConnectionPool.h"
 
+#include "monarch/rt/RunnableDelegate.h"
+
 #include <algorithm>
 
 using namespace std;
@@ -11,7 +13,7 @@ using namespace monarch::sql;
 
 AbstractConnectionPool::AbstractConnectionPool(
    const char* url, unsigned int poolSize) :
-   mConnectionSemaphore(poolSize, true), mUrl(url)
+   mConnectionSemaphore(poolSize, true), mIdleTimers(NULL), mUrl(url)
 {
    // default connection expire time to 0 (no expiration)
    mConnectionExpireTime = 0;
@@ -39,7 +41,13 @@ void AbstractConnectionPool::connectionClosed(PooledConnection* connection)
          connection->setIdleTime(System::getCurrentMilliseconds());
 
          // put at front of idle connections
-         mIdleConnections.push_front(connection);
+         IdleConnectionRef idle = new IdleConnection;
+         idle->connection = connection;
+         idle->position =
+            mIdleConnections.insert(mIdleConnections.begin(), idle);
+
+         // expire the connection if it stays idle
+         scheduleIdleTimer(idle);
 
          // release connection permit
          mConnectionSemaphore.release();
@@ -66,7 +74,7 @@ Connection* AbstractConnectionPool::getIdleConnection()
          while(rval == NULL && !mIdleConnections.empty())
          {
             // get last idle connection
-            rval = mIdleConnections.back();
+            rval = unidleConnection(mIdleConnections.back());
             mIdleConnections.pop_back();
 
             // test for connectivity
@@ -95,53 +103,105 @@ Connection* AbstractConnectionPool::getIdleConnection()
       mListLock.unlock();
    }
 
-   // now try to close any expired connections
-   closeExpiredConnections();
-
    return rval;
 }
 
 void AbstractConnectionPool::closeExpiredConnections()
 {
    // go through idle connections and remove any who have expired
-   if(!mIdleConnections.empty())
+   if(mConnectionExpireTime != 0 && !mIdleConnections.empty())
    {
       mListLock.lock();
       {
-         // FIXME: we might want to use a different algorithm here that
-         // is quicker but doesn't necessarily clean up all expired
-         // connections at once -- so that each time a request is made
-         // to get a connection, not all other connections must be checked
-         // in the worst case
-
          // find the first expired connection, all that follow are expired
-         bool found = false;
-         list<PooledConnection*>::iterator i = mIdleConnections.begin();
-         for(; !found && i != mIdleConnections.end(); ++i)
+         uint64_t now = System::getCurrentMilliseconds();
+         IdleConnectionList::iterator i = mIdleConnections.begin();
+         while(i != mIdleConnections.end() &&
+               (*i)->connection->getIdleTime() > now - mConnectionExpireTime)
          {
-            // check idle time to see if connection has expired
-            found = ((*i)->getIdleTime() <=
-               System::getCurrentMilliseconds() - mConnectionExpireTime);
+            ++i;
          }
 
          // close and clean up all expired connections
-         if(found)
+         while(i != mIdleConnections.end())
          {
-            for(; i != mIdleConnections.end();)
-            {
-               // close the expired connection and delete it
-               (*i)->closeConnection();
-               delete (*i);
+            // close the expired connection and delete it
+            PooledConnection* connection = unidleConnection(*i);
+            connection->closeConnection();
+            delete connection;
 
-               // remove from idle list (erase automatically advances iterator)
-               i = mIdleConnections.erase(i);
-            }
+            // remove from idle list (erase automatically advances iterator)
+            i = mIdleConnections.erase(i);
          }
       }
       mListLock.unlock();
    }
 }
 
+void AbstractConnectionPool::scheduleIdleTimer(IdleConnectionRef& idle)
+{
+   // assume list lock is engaged
+   if(!idle->timer.isNull())
+   {
+      mIdleTimers->cancel(idle->timer);
+      idle->timer.setNull();
+   }
+
+   if(mConnectionExpireTime != 0)
+   {
+      if(mIdleTimers == NULL)
+      {
+         mIdleTimers = TimingWheel::acquireShared();
+      }
+
+      // expire the connection after it has been idle for the expire time
+      uint64_t idleTime =
+         System::getCurrentMilliseconds() - idle->connection->getIdleTime();
+      uint64_t delay = (idleTime >= mConnectionExpireTime ?
+         0 : mConnectionExpireTime - idleTime);
+      RunnableRef r = new RunnableDelegate<
+         AbstractConnectionPool, IdleConnectionRef>(
+            this, &AbstractConnectionPool::expireIdleConnection, idle);
+      idle->timer = mIdleTimers->schedule(
+         r, (delay > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)delay));
+   }
+}
+
+PooledConnection* AbstractConnectionPool::unidleConnection(
+   IdleConnectionRef& idle)
+{
+   // assume list lock is engaged
+   PooledConnection* rval = idle->connection;
+   idle->connection = NULL;
+
+   // drop the timer, which also frees the idle connection once the timer is
+   // no longer running
+   if(!idle->timer.isNull())
+   {
+      mIdleTimers->cancel(idle->timer);
+      idle->timer.setNull();
+   }
+
+   return rval;
+}
+
+void AbstractConnectionPool::expireIdleConnection(IdleConnectionRef idle)
+{
+   mListLock.lock();
+   {
+      // the connection may have been reused since its timer was due
+      if(idle->connection != NULL)
+      {
+         // close the expired connection and delete it
+         mIdleConnections.erase(idle->position);
+         PooledConnection* connection = unidleConnection(idle);
+         connection->closeConnection();
+         delete connection;
+      }
+   }
+   mListLock.unlock();
+}
+
 inline Connection* AbstractConnectionPool::getConnection()
 {
    return getIdleConnection();
@@ -149,6 +209,8 @@ inline Connection* AbstractConnectionPool::getConnection()
 
 void AbstractConnectionPool::closeAllConnections()
 {
+   TimingWheel* timers = NULL;
+
    // lock list to close all connections
    mListLock.lock();
    {
@@ -162,10 +224,10 @@ void AbstractConnectionPool::closeAllConnections()
       }
 
       // remove all idle connections
-      for(list<PooledConnection*>::iterator i = mIdleConnections.begin();
+      for(IdleConnectionList::iterator i = mIdleConnections.begin();
           i != mIdleConnections.end(); ++i)
       {
-         PooledConnection* connection = *i;
+         PooledConnection* connection = unidleConnection(*i);
          connection->closeConnection();
          delete connection;
       }
@@ -173,8 +235,19 @@ void AbstractConnectionPool::closeAllConnections()
       // clear all connection lists
       mActiveConnections.clear();
       mIdleConnections.clear();
+
+      // all idle timers are cancelled, give up the shared wheel
+      timers = mIdleTimers;
+      mIdleTimers = NULL;
    }
    mListLock.unlock();
+
+   if(timers != NULL)
+   {
+      // wait for an idle timer that is already running to finish
+      timers->synchronize();
+      TimingWheel::releaseShared();
+   }
 }
 
 void AbstractConnectionPool::setPoolSize(unsigned int size)
@@ -203,9 +276,18 @@ void AbstractConnectionPool::setConnectionExpireTime(
    uint64_t expireTime)
 {
    lock();
+   mListLock.lock();
    {
       mConnectionExpireTime = expireTime;
+
+      // reschedule the timers of all idle connections
+      for(IdleConnectionList::iterator i = mIdleConnections.begin();
+          i != mIdleConnections.end(); ++i)
+      {
+         scheduleIdleTimer(*i);
+      }
    }
+   mListLock.unlock();
    unlock();
 }
 
@@ -236,11 +318,11 @@ unsigned int AbstractConnectionPool::getExpiredConnectionCount()
    mListLock.lock();
    {
       // check list for active connections
-      for(list<PooledConnection*>::iterator i = mIdleConnections.begin();
-          i != mIdleConnections.end(); ++i)
+      for(IdleConnectionList::iterator i = mIdleConnections.begin();
+          mConnectionExpireTime != 0 && i != mIdleConnections.end(); ++i)
       {
          // get the connection
-         PooledConnection* connection = *i;
+         PooledConnection* connection = (*i)->connection;
 
          // check if expired connection
          if(connection->getIdleTime() <=
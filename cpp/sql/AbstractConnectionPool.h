@@ -7,6 +7,7 @@
 #include "monarch/rt/ExclusiveLock.h"
 #include "monarch/rt/Semaphore.h"
 #include "monarch/rt/System.h"
+#include "monarch/rt/TimingWheel.h"
 #include "monarch/sql/ConnectionPool.h"
 #include "monarch/sql/PooledConnection.h"
 #include "monarch/util/Url.h"
@@ -26,6 +27,11 @@ namespace sql
  * This pool maintains a set of N connections to the database. Any new
  * connections are lazily created.
  *
+ * If connections have an expire time, each idle connection has a timer on
+ * the shared TimingWheel that closes it once it expires, so expired
+ * connections are closed without having to check the idle connections each
+ * time a connection is requested.
+ *
  * @author Mike Johnson
  */
 class AbstractConnectionPool :
@@ -49,10 +55,31 @@ protected:
     */
    std::list<PooledConnection*> mActiveConnections;
 
+   /**
+    * An IdleConnection is an idle connection, its position in the idle list,
+    * and the timer that expires it. Its connection is NULL once it is no
+    * longer idle.
+    */
+   struct IdleConnection;
+   typedef monarch::rt::Collectable<IdleConnection> IdleConnectionRef;
+   typedef std::list<IdleConnectionRef> IdleConnectionList;
+   struct IdleConnection
+   {
+      PooledConnection* connection;
+      IdleConnectionList::iterator position;
+      monarch::rt::TimingWheel::TimerRef timer;
+   };
+
    /**
     * The list of idle connections in this pool.
     */
-   std::list<PooledConnection*> mIdleConnections;
+   IdleConnectionList mIdleConnections;
+
+   /**
+    * The shared TimingWheel with the timers that expire idle connections,
+    * NULL until an idle connection needs a timer.
+    */
+   monarch::rt::TimingWheel* mIdleTimers;
 
    /**
     * A lock for modifying the connection lists.
@@ -103,6 +130,31 @@ protected:
     */
    virtual void closeExpiredConnections();
 
+   /**
+    * Schedules the timer that expires an idle connection, replacing any
+    * timer it already has. The list lock must be engaged.
+    *
+    * @param idle the idle connection.
+    */
+   virtual void scheduleIdleTimer(IdleConnectionRef& idle);
+
+   /**
+    * Marks an idle connection as no longer idle, cancelling its timer. The
+    * list lock must be engaged.
+    *
+    * @param idle the idle connection.
+    *
+    * @return the connection.
+    */
+   virtual PooledConnection* unidleConnection(IdleConnectionRef& idle);
+
+   /**
+    * Closes an idle connection when its timer is due.
+    *
+    * @param idle the idle connection.
+    */
+   virtual void expireIdleConnection(IdleConnectionRef idle);
+
 public:
    /**
     * Creates a new AbstractConnectionPool with the specified number of
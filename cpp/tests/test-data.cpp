@@ -26,6 +26,10 @@
 #include "monarch/data/xml/DomWriter.h"
 #include "monarch/data/DynamicObjectInputStream.h"
 #include "monarch/data/DynamicObjectOutputStream.h"
+#include "monarch/data/binary/BinaryFormat.h"
+#include "monarch/data/binary/BinaryReader.h"
+#include "monarch/data/binary/BinaryView.h"
+#include "monarch/data/binary/BinaryWriter.h"
 #include "monarch/data/json/JsonWriter.h"
 #include "monarch/data/json/JsonReader.h"
 #include "monarch/data/json/JsonLd.h"
@@ -47,6 +51,7 @@ using namespace std;
 using namespace monarch::test;
 using namespace monarch::data;
 //using namespace monarch::data::avi;
+using namespace monarch::data::binary;
 using namespace monarch::data::json;
 //using namespace monarch::data::mpeg;
 using namespace monarch::data::riff;
@@ -4075,6 +4080,240 @@ static DynamicObject makeJsonTestDyno2()
    return d;
 }
 
+static void runBinaryTest(TestRunner& tr)
+{
+   tr.group("Binary");
+
+   tr.test("round trip");
+   {
+      DynamicObject td = makeJSONTests();
+      td->append()["dyno"] = makeJsonTestDyno2();
+      td.last()["dyno"]["big"] = (uint64_t)0xffffffffffffffffULL;
+      td.last()["dyno"]["small"] = (int64_t)-5000000000LL;
+      td.last()["dyno"]["unsigned"] = (uint32_t)4000000000U;
+      td.last()["dyno"]["pi"] = 3.14159;
+      DynamicObjectIterator i = td.getIterator();
+      while(i->hasNext())
+      {
+         DynamicObject& d = i->next()["dyno"];
+         ByteBuffer b;
+         assertNoException(
+            BinaryWriter::writeToByteBuffer(d, &b));
+
+         DynamicObject out;
+         assertNoException(
+            BinaryReader::readFromBuffer(out, b.data(), b.length()));
+         assertDynoCmp(d, out);
+      }
+
+      // types are preserved
+      DynamicObject d = td.last()["dyno"];
+      string s = BinaryWriter::writeToString(d);
+      DynamicObject out;
+      assertNoException(
+         BinaryReader::readFromBuffer(out, s.data(), s.length()));
+      assert(out["big"]->getType() == UInt64);
+      assert(out["big"]->getUInt64() == 0xffffffffffffffffULL);
+      assert(out["small"]->getType() == Int64);
+      assert(out["small"]->getInt64() == -5000000000LL);
+      assert(out["unsigned"]->getType() == UInt32);
+      assert(out["pi"]->getType() == Double);
+      assert(out["pi"]->getDouble() == 3.14159);
+      assert(out["sixth"].isNull());
+   }
+   tr.passIfNoException();
+
+   tr.test("packed array");
+   {
+      DynamicObject d;
+      d["ints"]->setType(Array);
+      d["ints"]->setPackedType(Int32);
+      d["doubles"]->setType(Array);
+      d["doubles"]->setPackedType(Double);
+      for(int i = 0; i < 100; ++i)
+      {
+         d["ints"]->appendPacked((int32_t)(i - 50));
+         d["doubles"]->appendPacked(i * 0.5);
+      }
+
+      ByteBuffer b;
+      BinaryWriter::writeToByteBuffer(d, &b);
+      assertNoExceptionSet();
+
+      DynamicObject out;
+      BinaryReader::readFromBuffer(out, b.data(), b.length());
+      assertNoExceptionSet();
+      assert(out["ints"]->getPackedType() == Int32);
+      assert(out["doubles"]->getPackedType() == Double);
+      assertDynoCmp(d, out);
+   }
+   tr.passIfNoException();
+
+   tr.test("view");
+   {
+      DynamicObject d = makeJsonTestDyno2();
+      d["packed"]->setType(Array);
+      d["packed"]->setPackedType(Int64);
+      d["packed"]->appendPacked((int64_t)-1);
+      d["packed"]->appendPacked((int64_t)2);
+      d["packed"]->appendPacked((int64_t)3);
+
+      ByteBuffer b;
+      BinaryWriter::writeToByteBuffer(d, &b);
+      assertNoExceptionSet();
+
+      BinaryView root;
+      assertNoException(
+         root.open(b.data(), b.length()));
+      assert(root.getType() == Map);
+      assert(root.length() == d->length());
+      assert(root.hasMember("first"));
+      assert(!root.hasMember("tenth"));
+      assert(!root["tenth"].isValid());
+      assert(!root["first"]["tenth"].isValid());
+
+      // strings point into the buffer
+      const char* first = root["first"].getString();
+      assertStrCmp(first, "one");
+      assert(first > b.data() && first < b.data() + b.length());
+      assert(root["first"].length() == 3);
+      assertStrCmp(root["ninth"].getString(), d["ninth"]->getString());
+      assert(root["zeroth"].getBoolean() == false);
+      assert(root["second"].getDouble() == 2.0);
+      assert(root["third"].getInt32() == 3);
+      assert(root["third"].getDouble() == 3.0);
+      assert(root["sixth"].isNull());
+      assert(root["fourth"].length() == 4);
+      assert(root["fourth"][3]["a"].getInt32() == 123);
+      assertStrCmp(root["fourth"][1]["c"].getString(), "sea");
+      assert(!root["fourth"][4].isValid());
+
+      // iterate over members in order
+      DynamicObjectIterator i = d.getIterator();
+      BinaryView v = root.first();
+      while(i->hasNext())
+      {
+         i->next();
+         assert(v.isValid());
+         assertStrCmp(v.getName(), i->getName());
+         v = v.next();
+      }
+      assert(!v.isValid());
+
+      // packed elements
+      BinaryView packed = root["packed"];
+      assert(packed.getType() == Array);
+      assert(packed.getPackedType() == Int64);
+      assert(packed.length() == 3);
+      assert(packed[0].getInt64() == -1);
+      assert(packed[2].getInt64() == 3);
+      assert(packed.first().next().getInt64() == 2);
+      assert(!packed.first().next().next().next().isValid());
+      const int64_t* data =
+         static_cast<const int64_t*>(packed.getPackedData());
+      assert((((size_t)data) - ((size_t)b.data())) % 8 == 0);
+      assert(data[1] == 2);
+
+      // copy a sub-tree
+      DynamicObject out;
+      root["eighth"].copyTo(out);
+      assertDynoCmp(d["eighth"], out);
+   }
+   tr.passIfNoException();
+
+   tr.test("streams");
+   {
+      DynamicObject d = makeJsonTestDyno2();
+      DynamicObjectInputStream dois(d, new BinaryWriter(), true);
+
+      DynamicObject out;
+      DynamicObjectOutputStream doos(out, new BinaryReader(), true);
+
+      // copy in small chunks
+      char buf[16];
+      int numBytes;
+      while((numBytes = dois.read(buf, 16)) > 0)
+      {
+         doos.write(buf, numBytes);
+      }
+      assertNoExceptionSet();
+      doos.close();
+      assertNoExceptionSet();
+      assertDynoCmp(d, out);
+   }
+   tr.passIfNoException();
+
+   tr.test("invalid");
+   {
+      DynamicObject d = makeJsonTestDyno2();
+      string s = BinaryWriter::writeToString(d);
+
+      // every truncation of a valid document must be rejected
+      for(size_t len = 0; len < s.length(); ++len)
+      {
+         DynamicObject out;
+         assert(!BinaryReader::readFromBuffer(out, s.data(), len));
+         assertExceptionSet();
+         Exception::clear();
+      }
+
+      DynamicObject out;
+      assert(!BinaryReader::readFromBuffer(out, "{\"a\":1}", 7));
+      ExceptionRef e = Exception::get();
+      assertStrCmp(e->getType(), "monarch.data.binary.BinaryView.InvalidFormat");
+      Exception::clear();
+
+      // corrupt a string length
+      string corrupt = s;
+      size_t pos = corrupt.find("sea") - 4;
+      corrupt[pos] = (char)0xff;
+      assert(!BinaryReader::readFromBuffer(
+         out, corrupt.data(), corrupt.length()));
+      assertExceptionSet();
+      Exception::clear();
+
+      // unsupported version
+      corrupt = s;
+      corrupt[4] = 2;
+      assert(!BinaryReader::readFromBuffer(
+         out, corrupt.data(), corrupt.length()));
+      e = Exception::get();
+      assertStrCmp(
+         e->getType(), "monarch.data.binary.BinaryView.UnsupportedVersion");
+      Exception::clear();
+
+      // nesting is limited so reading cannot exhaust the stack
+      DynamicObject nested;
+      DynamicObject leaf = nested;
+      for(int i = 0; i < MO_BINARY_MAX_DEPTH; ++i)
+      {
+         leaf = (i % 2 == 0) ? leaf["a"] : leaf->append();
+      }
+      leaf = "bottom";
+      corrupt = BinaryWriter::writeToString(nested);
+      assert(BinaryReader::readFromBuffer(
+         out, corrupt.data(), corrupt.length()));
+      leaf->append() = "too deep";
+      corrupt = BinaryWriter::writeToString(nested);
+      assert(!BinaryReader::readFromBuffer(
+         out, corrupt.data(), corrupt.length()));
+      e = Exception::get();
+      assertStrCmp(
+         e->getType(), "monarch.data.binary.BinaryView.NestingTooDeep");
+      Exception::clear();
+
+      // reader must be started
+      BinaryReader br;
+      ByteArrayInputStream is(s.data(), s.length());
+      assert(!br.read(&is));
+      assertExceptionSet();
+      Exception::clear();
+   }
+   tr.passIfNoException();
+
+   tr.ungroup();
+}
+
 static void runCharacterSetMutatorTest(TestRunner& tr)
 {
    tr.group("CharacterSetMutator");
@@ -4141,6 +4380,107 @@ static void runJsonReaderSpeedTest(TestRunner& tr)
    tr.ungroup();
 }
 
+static void runBinarySpeedTest(TestRunner& tr)
+{
+   tr.group("Binary vs JSON speed");
+
+   DynamicObject in;
+   in->setType(Array);
+   for(int i = 0; i < 100; ++i)
+   {
+      DynamicObject d = makeJsonTestDyno2();
+      d["index"] = i;
+      in->append(d);
+   }
+   string json = JsonWriter::writeToString(in, true);
+   string bin = BinaryWriter::writeToString(in);
+   int loops = 200;
+   printf("\n%d loops, JSON: %d bytes, binary: %d bytes\n",
+      loops, (int)json.length(), (int)bin.length());
+
+   tr.test("JSON write");
+   {
+      Timer t;
+      t.start();
+      for(int i = 0; i < loops; ++i)
+      {
+         JsonWriter::writeToString(in, true);
+      }
+      double secs = t.getElapsedSeconds();
+      printf("%0.3f secs, %0.2f MiB/s... ",
+         secs, json.length() * loops / secs / (1024 * 1024));
+   }
+   tr.passIfNoException();
+
+   tr.test("binary write");
+   {
+      Timer t;
+      t.start();
+      for(int i = 0; i < loops; ++i)
+      {
+         BinaryWriter::writeToString(in);
+      }
+      double secs = t.getElapsedSeconds();
+      printf("%0.3f secs, %0.2f MiB/s... ",
+         secs, bin.length() * loops / secs / (1024 * 1024));
+   }
+   tr.passIfNoException();
+
+   tr.test("JSON read");
+   {
+      Timer t;
+      t.start();
+      for(int i = 0; i < loops; ++i)
+      {
+         DynamicObject out;
+         JsonReader::readFromString(out, json.c_str(), json.length());
+      }
+      double secs = t.getElapsedSeconds();
+      printf("%0.3f secs, %0.2f MiB/s... ",
+         secs, json.length() * loops / secs / (1024 * 1024));
+   }
+   tr.passIfNoException();
+
+   tr.test("binary read");
+   {
+      Timer t;
+      t.start();
+      for(int i = 0; i < loops; ++i)
+      {
+         DynamicObject out;
+         BinaryReader::readFromBuffer(out, bin.data(), bin.length());
+      }
+      double secs = t.getElapsedSeconds();
+      printf("%0.3f secs, %0.2f MiB/s... ",
+         secs, bin.length() * loops / secs / (1024 * 1024));
+   }
+   tr.passIfNoException();
+
+   tr.test("binary view");
+   {
+      // open and read one member of every element without building objects
+      Timer t;
+      t.start();
+      int64_t sum = 0;
+      for(int i = 0; i < loops; ++i)
+      {
+         BinaryView root;
+         root.open(bin.data(), bin.length());
+         for(BinaryView v = root.first(); v.isValid(); v = v.next())
+         {
+            sum += v["index"].getInt32();
+         }
+      }
+      double secs = t.getElapsedSeconds();
+      assert(sum == loops * 4950);
+      printf("%0.3f secs, %0.2f MiB/s... ",
+         secs, bin.length() * loops / secs / (1024 * 1024));
+   }
+   tr.passIfNoException();
+
+   tr.ungroup();
+}
+
 static bool run(TestRunner& tr)
 {
    if(tr.isDefaultEnabled())
@@ -4154,6 +4494,8 @@ static bool run(TestRunner& tr)
       runJsonIOStreamTest(tr);
       runJsonLdTest(tr);
 
+      runBinaryTest(tr);
+
       runXmlReaderTest(tr);
       runXmlWriterTest(tr);
       runXmlReadWriteTest(tr);
@@ -4179,6 +4521,10 @@ static bool run(TestRunner& tr)
    {
       runJsonReaderSpeedTest(tr);
    }
+   if(tr.isTestEnabled("binary-speed"))
+   {
+      runBinarySpeedTest(tr);
+   }
    if(tr.isTestEnabled("json-ld"))
    {
       runJsonLdTest(tr);
@@ -1,12 +1,17 @@
 /*
- * Copyright (c) 2007-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2007-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #include "monarch/test/Test.h"
 #include "monarch/test/TestModule.h"
+#include "monarch/rt/DynamicObjectArena.h"
+#include "monarch/rt/DynamicObjectPathSet.h"
 #include "monarch/rt/Runnable.h"
 #include "monarch/rt/System.h"
+#include "monarch/rt/Thread.h"
 
 #include <cstdio>
+#include <string>
+#include <vector>
 
 using namespace std;
 using namespace monarch::config;
@@ -18,27 +23,62 @@ namespace mo_test_dyno_perf
 
 static bool header = true;
 
+/**
+ * Iteration modes for the DynamicObject iter perf tests.
+ */
+enum IterMode
+{
+   IterHeap, IterValue
+};
+
 static void runDynoIterTest1(
-   TestRunner& tr, const char* name, int dynos, int iter)
+   TestRunner& tr, const char* name, IterMode mode, DynamicObjectType type,
+   int dynos, int iter)
 {
    tr.test(name);
    {
       uint64_t start_init = System::getCurrentMilliseconds();
       DynamicObject d1;
-      d1->setType(Array);
+      d1->setType(type);
+      char key[22];
       for(int i = 0; i < dynos; ++i)
       {
-         d1->append(i);
-         //d1[i] = i;
+         if(type == Map)
+         {
+            snprintf(key, 22, "%d", i);
+            d1[key] = i;
+         }
+         else
+         {
+            d1->append(i);
+            //d1[i] = i;
+         }
       }
       uint64_t start_iter = System::getCurrentMilliseconds();
-      for(int j = 0; j < iter; ++j)
+      if(mode == IterHeap)
       {
-         DynamicObjectIterator i = d1.getIterator();
-         while(i->hasNext())
+         for(int j = 0; j < iter; ++j)
          {
-            i->next();
+            DynamicObjectIterator i = d1.getIterator();
+            while(i->hasNext())
+            {
+               i->next();
+            }
+         }
+      }
+      else
+      {
+         // count elements to keep the compiler from discarding the loop
+         int count = 0;
+         for(int j = 0; j < iter; ++j)
+         {
+            DynamicObject::iterator end = d1.end();
+            for(DynamicObject::iterator i = d1.begin(); i != end; ++i)
+            {
+               count += (&(*i) != NULL);
+            }
          }
+         assert(count == dynos * iter);
       }
       uint64_t iter_dt = System::getCurrentMilliseconds() - start_iter;
       uint64_t init_dt = start_iter - start_init;
@@ -69,6 +109,17 @@ static void runDynoIterTest1(
    tr.passIfNoException();
 }
 
+static void runDynoIterTest2(
+   TestRunner& tr, const char* name, DynamicObjectType type,
+   int dynos, int iter)
+{
+   // compare heap iterators against value iterators
+   string heap = string("heap  ") + name;
+   string value = string("value ") + name;
+   runDynoIterTest1(tr, heap.c_str(), IterHeap, type, dynos, iter);
+   runDynoIterTest1(tr, value.c_str(), IterValue, type, dynos, iter);
+}
+
 static void runDynoIterTest(TestRunner& tr)
 {
    tr.group("DynamicObject iter perf");
@@ -81,27 +132,570 @@ static void runDynoIterTest(TestRunner& tr)
    }
    if(all)
    {
-      //runDynoIterTest1(tr, "array s:10M  i:1    ", 10000000, 1);
-      runDynoIterTest1(tr, "array s:1M   i:1    ", 1000000,  1);
-      runDynoIterTest1(tr, "array s:1M   i:2    ", 1000000,  2);
-      runDynoIterTest1(tr, "array s:1M   i:5    ", 1000000,  5);
-      runDynoIterTest1(tr, "array s:1M   i:10   ", 1000000, 10);
+      //runDynoIterTest2(tr, "array s:10M  i:1    ", Array, 10000000, 1);
+      runDynoIterTest2(tr, "array s:1M   i:1    ", Array, 1000000,  1);
+      runDynoIterTest2(tr, "array s:1M   i:2    ", Array, 1000000,  2);
+      runDynoIterTest2(tr, "array s:1M   i:5    ", Array, 1000000,  5);
+      runDynoIterTest2(tr, "array s:1M   i:10   ", Array, 1000000, 10);
    }
-   runDynoIterTest1(tr, "array s:100K i:100  ", 100000, 100);
-   runDynoIterTest1(tr, "array s:10K  i:1K   ", 10000, 1000);
-   runDynoIterTest1(tr, "array s:1K   i:10K  ", 1000, 10000);
-   runDynoIterTest1(tr, "array s:100  i:100K ", 100, 100000);
-   runDynoIterTest1(tr, "array s:10   i:1M   ", 10, 1000000);
+   runDynoIterTest2(tr, "array s:100K i:100  ", Array, 100000, 100);
+   runDynoIterTest2(tr, "array s:10K  i:1K   ", Array, 10000, 1000);
+   runDynoIterTest2(tr, "array s:1K   i:10K  ", Array, 1000, 10000);
+   runDynoIterTest2(tr, "array s:100  i:100K ", Array, 100, 100000);
+   runDynoIterTest2(tr, "array s:10   i:1M   ", Array, 10, 1000000);
    if(all)
    {
-      runDynoIterTest1(tr, "array s:5    i:1M   ", 5,  1000000);
-      runDynoIterTest1(tr, "array s:2    i:1M   ", 2,  1000000);
-      runDynoIterTest1(tr, "array s:1    i:1M   ", 1,  1000000);
-      runDynoIterTest1(tr, "array s:0    i:1M   ", 0,  1000000);
-      //runDynoIterTest1(tr, "array s:5    i:2M   ", 5,  2000000);
-      //runDynoIterTest1(tr, "array s:2    i:5M   ", 2,  5000000);
-      //runDynoIterTest1(tr, "array s:1    i:10M  ", 1, 10000000);
+      runDynoIterTest2(tr, "array s:5    i:1M   ", Array, 5,  1000000);
+      runDynoIterTest2(tr, "array s:2    i:1M   ", Array, 2,  1000000);
+      runDynoIterTest2(tr, "array s:1    i:1M   ", Array, 1,  1000000);
+      runDynoIterTest2(tr, "array s:0    i:1M   ", Array, 0,  1000000);
+      //runDynoIterTest2(tr, "array s:5    i:2M   ", Array, 5,  2000000);
+      //runDynoIterTest2(tr, "array s:2    i:5M   ", Array, 2,  5000000);
+      //runDynoIterTest2(tr, "array s:1    i:10M  ", Array, 1, 10000000);
    }
+   runDynoIterTest2(tr, "map   s:10K  i:1K   ", Map, 10000, 1000);
+   runDynoIterTest2(tr, "map   s:100  i:100K ", Map, 100, 100000);
+   runDynoIterTest2(tr, "map   s:10   i:1M   ", Map, 10, 1000000);
+
+   tr.ungroup();
+}
+
+/**
+ * Allocation modes for the DynamicObject alloc perf tests.
+ */
+enum AllocMode
+{
+   AllocHeap, AllocPool, AllocArena
+};
+
+static void buildDynoTree(int dynos)
+{
+   DynamicObject d;
+   d->setType(Array);
+   for(int i = 0; i < dynos; i += 4)
+   {
+      DynamicObject& m = d->append();
+      m["id"] = i;
+      m["name"] = "name";
+      m["value"] = i * 0.5;
+   }
+}
+
+static void runDynoAllocTest1(
+   TestRunner& tr, const char* name, AllocMode mode, int dynos, int iter)
+{
+   tr.test(name);
+   {
+      bool pooling = DynamicObjectImpl::enablePooling(mode != AllocHeap);
+      uint64_t start = System::getCurrentMilliseconds();
+      for(int j = 0; j < iter; ++j)
+      {
+         if(mode == AllocArena)
+         {
+            DynamicObjectArena arena;
+            buildDynoTree(dynos);
+         }
+         else
+         {
+            buildDynoTree(dynos);
+         }
+      }
+      uint64_t dt = System::getCurrentMilliseconds() - start;
+      DynamicObjectImpl::enablePooling(pooling);
+
+      if(header)
+      {
+         printf(
+            "%9s %9s %9s "
+            "%9s %9s\n",
+            "mode", "dynos", "iter",
+            "time (s)", "d/ms");
+         header = false;
+      }
+      printf(
+         "%9s %9d %9d "
+         "%9.3f %9.3f\n",
+         (mode == AllocHeap) ? "heap" :
+            ((mode == AllocPool) ? "pool" : "arena"),
+         dynos, iter,
+         dt/1000.0, (dynos*(double)iter)/(dt == 0 ? 1 : dt));
+   }
+   tr.passIfNoException();
+}
+
+static void runDynoAllocTest(TestRunner& tr)
+{
+   tr.group("DynamicObject alloc perf");
+
+   header = true;
+   runDynoAllocTest1(tr, "heap  s:100K i:10   ", AllocHeap, 100000, 10);
+   runDynoAllocTest1(tr, "pool  s:100K i:10   ", AllocPool, 100000, 10);
+   runDynoAllocTest1(tr, "arena s:100K i:10   ", AllocArena, 100000, 10);
+   runDynoAllocTest1(tr, "heap  s:100  i:10K  ", AllocHeap, 100, 10000);
+   runDynoAllocTest1(tr, "pool  s:100  i:10K  ", AllocPool, 100, 10000);
+   runDynoAllocTest1(tr, "arena s:100  i:10K  ", AllocArena, 100, 10000);
+   header = true;
+
+   tr.ungroup();
+}
+
+/**
+ * Creates and copies DynamicObjects for the DynamicObject refcount perf
+ * tests.
+ */
+class DynoRefCountRunnable : public Runnable
+{
+public:
+   bool embedded;
+   int dynos;
+   int copies;
+   virtual void run()
+   {
+      DynamicObject last;
+      for(int i = 0; i < dynos; ++i)
+      {
+         DynamicObject d = embedded ?
+            DynamicObject() : DynamicObject(new DynamicObjectImpl());
+         d = i;
+         for(int c = 0; c < copies; ++c)
+         {
+            DynamicObject copy = d;
+            last = copy;
+         }
+      }
+   }
+};
+
+static void runDynoRefCountTest1(
+   TestRunner& tr, const char* name,
+   bool embedded, int threads, int dynos, int copies)
+{
+   tr.test(name);
+   {
+      DynoRefCountRunnable r;
+      r.embedded = embedded;
+      r.dynos = dynos;
+      r.copies = copies;
+      Thread** t = new Thread*[threads];
+      uint64_t start = System::getCurrentMilliseconds();
+      for(int i = 0; i < threads; ++i)
+      {
+         t[i] = new Thread(&r);
+         t[i]->start(131072);
+      }
+      for(int i = 0; i < threads; ++i)
+      {
+         t[i]->join();
+         delete t[i];
+      }
+      uint64_t dt = System::getCurrentMilliseconds() - start;
+      delete [] t;
+
+      if(header)
+      {
+         printf(
+            "%9s %7s %9s %7s "
+            "%9s %9s\n",
+            "refcount", "threads", "dynos", "copies",
+            "time (s)", "d/ms");
+         header = false;
+      }
+      printf(
+         "%9s %7d %9d %7d "
+         "%9.3f %9.3f\n",
+         embedded ? "embedded" : "separate", threads, dynos, copies,
+         dt/1000.0, (threads*(double)dynos)/(dt == 0 ? 1 : dt));
+   }
+   tr.passIfNoException();
+}
+
+static void runDynoRefCountTest(TestRunner& tr)
+{
+   tr.group("DynamicObject refcount perf");
+
+   header = true;
+   runDynoRefCountTest1(tr, "separate t:1 s:1M c:4 ", false, 1, 1000000, 4);
+   runDynoRefCountTest1(tr, "embedded t:1 s:1M c:4 ", true, 1, 1000000, 4);
+   runDynoRefCountTest1(tr, "separate t:4 s:1M c:4 ", false, 4, 1000000, 4);
+   runDynoRefCountTest1(tr, "embedded t:4 s:1M c:4 ", true, 4, 1000000, 4);
+   runDynoRefCountTest1(tr, "separate t:8 s:1M c:4 ", false, 8, 1000000, 4);
+   runDynoRefCountTest1(tr, "embedded t:8 s:1M c:4 ", true, 8, 1000000, 4);
+   header = true;
+
+   tr.ungroup();
+}
+
+static void runDynoMapTest1(
+   TestRunner& tr, const char* name, bool flat, int members, int maps)
+{
+   tr.test(name);
+   {
+      int flatSize = DynamicObjectMap::setFlatMapMaxSize(flat ? 16 : 0);
+
+      // create member names
+      char** names = new char*[members];
+      for(int i = 0; i < members; ++i)
+      {
+         names[i] = new char[32];
+         snprintf(names[i], 32, "member%d", i);
+      }
+
+      uint64_t start_init = System::getCurrentMilliseconds();
+      DynamicObject d;
+      d->setType(Array);
+      for(int m = 0; m < maps; ++m)
+      {
+         DynamicObject& map = d->append();
+         for(int i = 0; i < members; ++i)
+         {
+            map[names[i]] = i;
+         }
+      }
+
+      uint64_t start_find = System::getCurrentMilliseconds();
+      int found = 0;
+      for(int m = 0; m < maps; ++m)
+      {
+         DynamicObject& map = d[m];
+         for(int i = 0; i < members; ++i)
+         {
+            if(map->hasMember(names[i]))
+            {
+               found += map[names[i]]->getInt32();
+            }
+         }
+      }
+
+      uint64_t start_iter = System::getCurrentMilliseconds();
+      int iterated = 0;
+      for(int m = 0; m < maps; ++m)
+      {
+         DynamicObjectIterator i = d[m].getIterator();
+         while(i->hasNext())
+         {
+            i->next();
+            ++iterated;
+         }
+      }
+      uint64_t end = System::getCurrentMilliseconds();
+      assert(iterated == members * maps);
+
+      uint64_t init_dt = start_find - start_init;
+      uint64_t find_dt = start_iter - start_find;
+      uint64_t iter_dt = end - start_iter;
+
+      if(header)
+      {
+         printf(
+            "%6s %7s %7s "
+            "%8s %8s %8s\n",
+            "layout", "members", "maps",
+            "init (s)", "find (s)", "iter (s)");
+         header = false;
+      }
+      printf(
+         "%6s %7d %7d "
+         "%8.3f %8.3f %8.3f\n",
+         flat ? "flat" : "tree", members, maps,
+         init_dt/1000.0, find_dt/1000.0, iter_dt/1000.0);
+
+      for(int i = 0; i < members; ++i)
+      {
+         delete [] names[i];
+      }
+      delete [] names;
+      DynamicObjectMap::setFlatMapMaxSize(flatSize);
+   }
+   tr.passIfNoException();
+}
+
+static void runDynoMapTest(TestRunner& tr)
+{
+   tr.group("DynamicObject map perf");
+
+   header = true;
+   runDynoMapTest1(tr, "tree m:4  n:100K ", false, 4, 100000);
+   runDynoMapTest1(tr, "flat m:4  n:100K ", true, 4, 100000);
+   runDynoMapTest1(tr, "tree m:8  n:50K  ", false, 8, 50000);
+   runDynoMapTest1(tr, "flat m:8  n:50K  ", true, 8, 50000);
+   runDynoMapTest1(tr, "tree m:16 n:25K  ", false, 16, 25000);
+   runDynoMapTest1(tr, "flat m:16 n:25K  ", true, 16, 25000);
+   runDynoMapTest1(tr, "tree m:64 n:5K   ", false, 64, 5000);
+   runDynoMapTest1(tr, "flat m:64 n:5K   ", true, 64, 5000);
+   header = true;
+
+   tr.ungroup();
+}
+
+static void runDynoPackedTest1(
+   TestRunner& tr, const char* name, bool packed, int size, int iter)
+{
+   tr.test(name);
+   {
+      uint64_t start_init = System::getCurrentMilliseconds();
+      DynamicObject d;
+      d->setType(Array);
+      if(packed)
+      {
+         d->setPackedType(Double);
+      }
+      for(int i = 0; i < size; ++i)
+      {
+         d->appendPacked((double)i);
+      }
+      assert(d->getPackedType() == (packed ? Double : Array));
+
+      uint64_t start_sum = System::getCurrentMilliseconds();
+      double sum = 0.0;
+      for(int n = 0; n < iter; ++n)
+      {
+         const double* data = static_cast<const double*>(d->getPackedData());
+         if(data != NULL)
+         {
+            for(int i = 0; i < size; ++i)
+            {
+               sum += data[i];
+            }
+         }
+         else
+         {
+            DynamicObjectIterator i = d.getIterator();
+            while(i->hasNext())
+            {
+               sum += i->next()->getDouble();
+            }
+         }
+      }
+      uint64_t end = System::getCurrentMilliseconds();
+      assert(sum == iter * ((double)size * (size - 1) / 2));
+
+      uint64_t init_dt = start_sum - start_init;
+      uint64_t sum_dt = end - start_sum;
+
+      if(header)
+      {
+         printf(
+            "%6s %9s %9s "
+            "%8s %8s\n",
+            "layout", "size", "iter",
+            "init (s)", "sum (s)");
+         header = false;
+      }
+      printf(
+         "%6s %9d %9d "
+         "%8.3f %8.3f\n",
+         packed ? "packed" : "array", size, iter,
+         init_dt/1000.0, sum_dt/1000.0);
+   }
+   tr.passIfNoException();
+}
+
+static void runDynoPackedTest(TestRunner& tr)
+{
+   tr.group("DynamicObject packed perf");
+
+   header = true;
+   runDynoPackedTest1(tr, "array  s:1M   i:10 ", false, 1000000, 10);
+   runDynoPackedTest1(tr, "packed s:1M   i:10 ", true, 1000000, 10);
+   runDynoPackedTest1(tr, "array  s:100  i:10K", false, 100, 10000);
+   runDynoPackedTest1(tr, "packed s:100  i:10K", true, 100, 10000);
+   header = true;
+
+   tr.ungroup();
+}
+
+/**
+ * Builds a frozen tree with the given number of leaves for the DynamicObject
+ * hash perf tests. The last leaf is set to the given value.
+ */
+static DynamicObject buildFrozenTree(int dynos, int last)
+{
+   DynamicObject d;
+   d->setType(Map);
+   char key[22];
+   for(int i = 0; i < dynos; i += 4)
+   {
+      snprintf(key, 22, "%d", i);
+      DynamicObject& m = d[key];
+      m["id"] = i;
+      m["name"] = "name";
+      m["value"] = i * 0.5;
+      m["last"] = (i + 4 >= dynos) ? last : i;
+   }
+   d.freeze();
+   return d;
+}
+
+static void runDynoHashTest1(
+   TestRunner& tr, const char* name, bool cache, int dynos, int iter)
+{
+   tr.test(name);
+   {
+      bool caching = DynamicObjectImpl::enableHashCaching(cache);
+      DynamicObject d1 = buildFrozenTree(dynos, 0);
+      DynamicObject d2 = buildFrozenTree(dynos, 0);
+      DynamicObject d3 = buildFrozenTree(dynos, 1);
+
+      // compare equal trees and trees that differ in their last leaf
+      uint64_t start = System::getCurrentMilliseconds();
+      for(int j = 0; j < iter; ++j)
+      {
+         assert(d1 == d2);
+         assert(d1 != d3);
+      }
+      uint64_t eq_dt = System::getCurrentMilliseconds() - start;
+
+      start = System::getCurrentMilliseconds();
+      for(int j = 0; j < iter; ++j)
+      {
+         DynamicObject diff;
+         assert(!d1.diff(d2, diff));
+         assert(d1.diff(d3, diff));
+      }
+      uint64_t diff_dt = System::getCurrentMilliseconds() - start;
+      DynamicObjectImpl::enableHashCaching(caching);
+
+      if(header)
+      {
+         printf(
+            "%9s %9s %9s "
+            "%9s %9s\n",
+            "mode", "dynos", "iter",
+            "== (s)", "diff (s)");
+         header = false;
+      }
+      printf(
+         "%9s %9d %9d "
+         "%9.3f %9.3f\n",
+         cache ? "cached" : "uncached",
+         dynos, iter,
+         eq_dt/1000.0, diff_dt/1000.0);
+   }
+   tr.passIfNoException();
+}
+
+static void runDynoHashTest(TestRunner& tr)
+{
+   tr.group("DynamicObject hash perf");
+
+   header = true;
+   runDynoHashTest1(tr, "uncached s:100K i:10  ", false, 100000, 10);
+   runDynoHashTest1(tr, "cached   s:100K i:10  ", true, 100000, 10);
+   runDynoHashTest1(tr, "uncached s:100  i:10K ", false, 100, 10000);
+   runDynoHashTest1(tr, "cached   s:100  i:10K ", true, 100, 10000);
+   header = true;
+
+   tr.ungroup();
+}
+
+/**
+ * Lookup modes for the DynamicObject path perf tests.
+ */
+enum PathMode
+{
+   PathChain, PathCompiled, PathSet
+};
+
+static void runDynoPathTest1(
+   TestRunner& tr, const char* name, PathMode mode, int modules, int iter)
+{
+   tr.test(name);
+   {
+      // a config with a few settings for each module
+      DynamicObject cfg;
+      char key[22];
+      for(int i = 0; i < modules; ++i)
+      {
+         snprintf(key, 22, "module%d", i);
+         DynamicObject& m = cfg["node"]["modules"][key];
+         m["threads"] = i;
+         m["enabled"] = true;
+         m["name"] = key;
+      }
+
+      // look up the threads setting of every module
+      DynamicObjectPath* paths = new DynamicObjectPath[modules];
+      DynamicObjectPathSet set;
+      char path[64];
+      for(int i = 0; i < modules; ++i)
+      {
+         snprintf(path, 64, "/node/modules/module%d/threads", i);
+         paths[i].setPath(path);
+         set.add(path);
+      }
+      DynamicObject** values = new DynamicObject*[modules];
+      vector<string> keys;
+      for(int i = 0; i < modules; ++i)
+      {
+         snprintf(key, 22, "module%d", i);
+         keys.push_back(key);
+      }
+
+      uint64_t sum = 0;
+      uint64_t start = System::getCurrentMilliseconds();
+      for(int j = 0; j < iter; ++j)
+      {
+         if(mode == PathChain)
+         {
+            for(int i = 0; i < modules; ++i)
+            {
+               const char* k = keys[i].c_str();
+               sum += cfg["node"]["modules"][k]["threads"]->getUInt32();
+            }
+         }
+         else if(mode == PathCompiled)
+         {
+            for(int i = 0; i < modules; ++i)
+            {
+               sum += (*paths[i].find(cfg))->getUInt32();
+            }
+         }
+         else
+         {
+            set.find(cfg, values);
+            for(int i = 0; i < modules; ++i)
+            {
+               sum += (*values[i])->getUInt32();
+            }
+         }
+      }
+      uint64_t dt = System::getCurrentMilliseconds() - start;
+      assert(sum == (uint64_t)iter * modules * (modules - 1) / 2);
+      delete [] values;
+      delete [] paths;
+
+      if(header)
+      {
+         printf(
+            "%9s %9s %9s "
+            "%9s %9s\n",
+            "mode", "modules", "iter",
+            "time (s)", "l/ms");
+         header = false;
+      }
+      printf(
+         "%9s %9d %9d "
+         "%9.3f %9.3f\n",
+         (mode == PathChain) ? "chain" :
+            ((mode == PathCompiled) ? "compiled" : "set"),
+         modules, iter,
+         dt/1000.0, (modules*(double)iter)/(dt == 0 ? 1 : dt));
+   }
+   tr.passIfNoException();
+}
+
+static void runDynoPathTest(TestRunner& tr)
+{
+   tr.group("DynamicObject path perf");
+
+   header = true;
+   runDynoPathTest1(tr, "chain    m:10  i:100K ", PathChain, 10, 100000);
+   runDynoPathTest1(tr, "compiled m:10  i:100K ", PathCompiled, 10, 100000);
+   runDynoPathTest1(tr, "set      m:10  i:100K ", PathSet, 10, 100000);
+   runDynoPathTest1(tr, "chain    m:100 i:10K  ", PathChain, 100, 10000);
+   runDynoPathTest1(tr, "compiled m:100 i:10K  ", PathCompiled, 100, 10000);
+   runDynoPathTest1(tr, "set      m:100 i:10K  ", PathSet, 100, 10000);
+   header = true;
 
    tr.ungroup();
 }
@@ -116,6 +710,12 @@ static bool run(TestRunner& tr)
       for(int i = 0; i < loops; ++i)
       {
          runDynoIterTest(tr);
+         runDynoAllocTest(tr);
+         runDynoRefCountTest(tr);
+         runDynoMapTest(tr);
+         runDynoPackedTest(tr);
+         runDynoHashTest(tr);
+         runDynoPathTest(tr);
       }
    }
    return true;
@@ -536,7 +536,7 @@ static void runEventDaemonTest(TestRunner& tr)
    EventDaemon ed;
 
    // start event daemon
-   ed.start(&k, &ec);
+   ed.start(&ec);
 
    const char* evType = "TESTEVENT";
 
@@ -630,7 +630,7 @@ static void runEventDaemonSharedEventTest(TestRunner& tr)
    EventDaemon ed;
 
    // start event daemon
-   ed.start(&k, &ec);
+   ed.start(&ec);
 
    const char* evType = "TESTEVENT";
 
@@ -711,7 +711,7 @@ static void runInteractiveEventDaemonTest(TestRunner& tr)
    EventDaemon ed;
 
    // start event daemon
-   ed.start(&k, &ec);
+   ed.start(&ec);
 
    const char* evType = "TESTEVENT";
 
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2011 Digital Bazaar, Inc. All rights reserved.
+ *
+ * This test file checks that clearing the current exception works in a
+ * fresh process where other per-thread keys were created before any Thread
+ * method was called. It is run absent the Monarch App Tester framework
+ * because that initializes threads first.
+ */
+#include <cstdio>
+
+#include "monarch/rt/DynamicObject.h"
+#include "monarch/rt/Exception.h"
+#include "monarch/rt/Thread.h"
+
+using namespace std;
+using namespace monarch::rt;
+
+int main()
+{
+   printf("Testing Exception::clear() before threads are initialized...\n");
+
+   int failed = 0;
+
+   // create per-thread memory pools before the thread keys exist
+   DynamicObject d;
+   d["a"] = 1;
+   d["b"]->append("b");
+
+   // must not mistake another per-thread value for the exception
+   Exception::clear();
+   if(Exception::isSet())
+   {
+      failed = 1;
+   }
+
+   // the per-thread pools must still work
+   for(int i = 0; i < 1000; ++i)
+   {
+      DynamicObject e;
+      e["i"] = i;
+      d["b"]->append(e);
+   }
+   if(d["b"]->length() != 1001 || d["b"][1000]["i"]->getInt32() != 999)
+   {
+      failed = 1;
+   }
+
+   printf(failed ? "FAIL.\n" : "PASS.\n");
+   printf("Done. Total:1 Passed:%d Failed:%d Warnings:0 Unknown:0.\n",
+      1 - failed, failed);
+
+   Thread::exit();
+   return failed;
+}
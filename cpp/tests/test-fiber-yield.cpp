@@ -1,6 +1,8 @@
 /*
- * Copyright (c) 2009-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2009-2011 Digital Bazaar, Inc. All rights reserved.
  */
+#define __STDC_FORMAT_MACROS
+
 #include "monarch/test/Test.h"
 #include "monarch/test/TestModule.h"
 #include "monarch/fiber/FiberScheduler.h"
@@ -11,6 +13,11 @@
 #include <cstdlib>
 #include <cstdio>
 #include <cmath>
+#include <inttypes.h>
+
+#if defined(LINUX)
+#include <ucontext.h>
+#endif
 
 using namespace std;
 using namespace monarch::config;
@@ -51,6 +58,47 @@ public:
    }
 };
 
+/**
+ * A fiber that swaps back to the context that swapped it in, without a
+ * scheduler, to time bare context switches.
+ */
+class SwitchFiber : public Fiber
+{
+public:
+   int count;
+
+public:
+   SwitchFiber(int n)
+   {
+      count = n;
+   };
+   virtual ~SwitchFiber() {};
+
+   virtual void run()
+   {
+      for(int i = 0; i < count; ++i)
+      {
+         getContext()->swapBack();
+      }
+
+      // never resumed, there is no scheduler to exit to
+      getContext()->swapBack();
+   }
+};
+
+#if defined(LINUX)
+static ucontext_t gMainContext;
+static ucontext_t gSwitchContext;
+
+static void switchContextLoop()
+{
+   for(;;)
+   {
+      swapcontext(&gSwitchContext, &gMainContext);
+   }
+}
+#endif
+
 static void runFiberYieldTest(TestRunner& tr)
 {
    tr.group("Fiber Yield");
@@ -81,11 +129,140 @@ static void runFiberYieldTest(TestRunner& tr)
    tr.ungroup();
 }
 
+static bool header = true;
+
+static void runFiberYieldScalingTest1(
+   TestRunner& tr, int threads, int fibers, int yields)
+{
+   char name[64];
+   snprintf(name, 64, "%d thread(s)", threads);
+   tr.test(name);
+   {
+      Kernel k;
+      k.getEngine()->getThreadPool()->setPoolSize(threads);
+      k.getEngine()->start();
+
+      FiberScheduler fs;
+      for(int i = 0; i < fibers; ++i)
+      {
+         fs.addFiber(new TestFiber(yields));
+      }
+
+      uint64_t startTime = Timer::startTiming();
+      fs.start(&k, threads);
+      fs.waitForLastFiberExit(true);
+      double secs = Timer::getSeconds(startTime);
+
+      k.getEngine()->stop();
+
+      uint64_t switches = (uint64_t)fibers * (yields + 1);
+      if(header)
+      {
+         printf("%9s %9s %9s %12s %9s %12s\n",
+            "threads", "fibers", "yields", "switches", "time (s)",
+            "switches/s");
+         header = false;
+      }
+      printf("%9d %9d %9d %12" PRIu64 " %9.3f %12.0f\n",
+         threads, fibers, yields, switches, secs,
+         (secs > 0) ? switches / secs : 0.0);
+   }
+   tr.passIfNoException();
+}
+
+static void runFiberYieldScalingTest(TestRunner& tr)
+{
+   tr.group("Fiber Yield scaling");
+
+   Config cfg = tr.getApp()->getConfig();
+   int fibers = cfg->hasMember("fibers") ? cfg["fibers"]->getInt32() : 1000;
+   int yields = cfg->hasMember("yields") ? cfg["yields"]->getInt32() : 1000;
+   int maxThreads =
+      cfg->hasMember("threads") ? cfg["threads"]->getInt32() : 8;
+
+   header = true;
+   for(int threads = 1; threads <= maxThreads; threads *= 2)
+   {
+      runFiberYieldScalingTest1(tr, threads, fibers, yields);
+   }
+   header = true;
+
+   tr.ungroup();
+}
+
+static void printSwitchRate(const char* context, int switches, double secs)
+{
+   if(header)
+   {
+      printf("%12s %12s %9s %12s\n",
+         "context", "switches", "time (s)", "switches/s");
+      header = false;
+   }
+   printf("%12s %12d %9.3f %12.0f\n",
+      context, switches, secs, (secs > 0) ? switches / secs : 0.0);
+}
+
+static void runContextSwitchTest(TestRunner& tr)
+{
+   tr.group("Fiber context switch");
+
+   Config cfg = tr.getApp()->getConfig();
+   int swaps = cfg->hasMember("swaps") ? cfg["swaps"]->getInt32() : 1000000;
+
+   header = true;
+   tr.test("FiberContext");
+   {
+      // swap to the fiber and back "swaps" times, then once more to leave
+      // it parked in its last swap
+      FiberContext main;
+      SwitchFiber fiber(swaps);
+      bool initialized = fiber.getContext()->init(&fiber);
+      assert(initialized);
+
+      uint64_t startTime = Timer::startTiming();
+      for(int i = 0; i <= swaps; ++i)
+      {
+         main.swap(fiber.getContext());
+      }
+      double secs = Timer::getSeconds(startTime);
+      printSwitchRate("FiberContext", 2 * (swaps + 1), secs);
+   }
+   tr.passIfNoException();
+
+#if defined(LINUX)
+   tr.test("swapcontext");
+   {
+      size_t stackSize = 64 * 1024;
+      char* stack = (char*)malloc(stackSize);
+      getcontext(&gSwitchContext);
+      gSwitchContext.uc_stack.ss_sp = stack;
+      gSwitchContext.uc_stack.ss_size = stackSize;
+      gSwitchContext.uc_link = NULL;
+      makecontext(&gSwitchContext, switchContextLoop, 0);
+
+      uint64_t startTime = Timer::startTiming();
+      for(int i = 0; i <= swaps; ++i)
+      {
+         swapcontext(&gMainContext, &gSwitchContext);
+      }
+      double secs = Timer::getSeconds(startTime);
+      printSwitchRate("swapcontext", 2 * (swaps + 1), secs);
+      free(stack);
+   }
+   tr.passIfNoException();
+#endif
+   header = true;
+
+   tr.ungroup();
+}
+
 static bool run(TestRunner& tr)
 {
    if(tr.isTestEnabled("fiber-yield"))
    {
       runFiberYieldTest(tr);
+      runFiberYieldScalingTest(tr);
+      runContextSwitchTest(tr);
    }
    return true;
 }
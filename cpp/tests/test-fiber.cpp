@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2008-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2008-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #include "monarch/test/Test.h"
 #include "monarch/test/TestModule.h"
@@ -175,6 +175,29 @@ public:
    }
 };
 
+class TestPlacedFiber : public Fiber
+{
+public:
+   DynamicObject mResult;
+
+public:
+   TestPlacedFiber(DynamicObject& result)
+   {
+      mResult = result;
+   };
+   virtual ~TestPlacedFiber() {};
+
+   virtual void run()
+   {
+      // record where the fiber runs
+      Thread* t = Thread::currentThread();
+      CpuSet cpus;
+      mResult["name"] = t->getName();
+      mResult["pinned"] = t->getCpuAffinity(cpus);
+      mResult["cpus"] = cpus.toString().c_str();
+   }
+};
+
 static void runFiberTest(TestRunner& tr)
 {
    tr.group("Fibers");
@@ -249,6 +272,57 @@ static void runFiberTest(TestRunner& tr)
    }
    tr.passIfNoException();
 
+   tr.test("thread group");
+   {
+      Kernel k;
+      k.getEngine()->start();
+
+      // pin fiber threads to the first available cpu
+      CpuSet available;
+      CpuSet::getAvailableCpus(available);
+      CpuSet cpus;
+      cpus.add(available.getCpu(0));
+      ThreadGroupRef group = new ThreadGroup("fiber");
+      group->setCpus(cpus);
+
+      FiberScheduler fs;
+      fs.setThreadGroup(group);
+      fs.start(&k, 1);
+
+      DynamicObject result;
+      fs.addFiber(new TestPlacedFiber(result));
+      fs.waitForLastFiberExit(true);
+      k.getEngine()->stop();
+
+      assertStrCmp(result["name"]->getString(), "fiber-0");
+      assert(result["pinned"]->getBoolean());
+      assertStrCmp(result["cpus"]->getString(), cpus.toString().c_str());
+      assert(group->getThreadCount() == 1);
+   }
+   tr.passIfNoException();
+
+   tr.test("restart");
+   {
+      Kernel k;
+      k.getEngine()->start();
+
+      FiberScheduler fs;
+      for(int i = 0; i < 20; ++i)
+      {
+         fs.addFiber(new TestFiber(200));
+      }
+
+      // fibers left on the threads' queues run again once restarted
+      fs.start(&k, 4);
+      Thread::sleep(10);
+      fs.stop();
+      fs.start(&k, 2);
+
+      fs.waitForLastFiberExit(true);
+      k.getEngine()->stop();
+   }
+   tr.passIfNoException();
+
    tr.test("messages");
    {
       Kernel k;
@@ -1,11 +1,12 @@
 /*
- * Copyright (c) 2009-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2009-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #define __STDC_CONSTANT_MACROS
 #define __STDC_FORMAT_MACROS
 
 #include "monarch/test/Test.h"
 #include "monarch/test/TestModule.h"
+#include "monarch/rt/EpochList.h"
 #include "monarch/rt/ExclusiveLock.h"
 #include "monarch/rt/HashTable.h"
 #include "monarch/rt/Runnable.h"
@@ -138,6 +139,40 @@ struct StringEquals
    }
 };
 
+/**
+ * A value that counts how many instances of it exist. A HashTable only
+ * allocates a value when it cannot reuse a reclaimed Entry, so the count
+ * shows how many Entries a table has allocated.
+ */
+struct CountedValue
+{
+   static volatile int32_t sCount;
+   uint32_t value;
+   CountedValue(uint32_t v = 0) :
+      value(v)
+   {
+      Atomic::incrementAndFetch(&sCount);
+   };
+   CountedValue(const CountedValue& copy) :
+      value(copy.value)
+   {
+      Atomic::incrementAndFetch(&sCount);
+   };
+   ~CountedValue()
+   {
+      Atomic::decrementAndFetch(&sCount);
+   };
+};
+volatile int32_t CountedValue::sCount = 0;
+
+typedef HashTable<
+   int, uint32_t, SuperFastHash,
+   DefaultEqualsFunction<int>, EpochList> EpochHashTable;
+typedef HashTable<int, CountedValue, SuperFastHash> CountedHashTable;
+typedef HashTable<
+   int, CountedValue, SuperFastHash,
+   DefaultEqualsFunction<int>, EpochList> CountedEpochHashTable;
+
 static void runHashTableTests(TestRunner& tr)
 {
    tr.group("HashTable");
@@ -182,6 +217,44 @@ static void runHashTableTests(TestRunner& tr)
    }
    tr.passIfNoException();
 
+   tr.test("epoch reclamation");
+   {
+      typedef HashTable<
+         int, int, KeyAsHash, DefaultEqualsFunction<int>, EpochList> Table;
+      Table table(1);
+
+      // force resizes and replaced entries
+      for(int i = 0; i < 100; ++i)
+      {
+         assert(table.put(i, i));
+         assert(table.put(i, i + 1));
+      }
+      assert(table.length() == 100);
+
+      int num;
+      for(int i = 0; i < 100; ++i)
+      {
+         assert(table.get(i, num));
+         assert(num == i + 1);
+      }
+      assert(!table.get(100, num));
+
+      assert(table.remove(50));
+      assert(!table.remove(50));
+      assert(!table.get(50, num));
+      assert(table.length() == 99);
+
+      Table table2 = table;
+      assert(table2.get(99, num));
+      assert(num == 100);
+      assert(!table2.get(50, num));
+
+      table.clear();
+      assert(table.length() == 0);
+      assert(!table.get(1, num));
+   }
+   tr.passIfNoException();
+
    tr.test("static string");
    {
       HashTable<const char*, int, AddressAsHash> table;
@@ -284,19 +357,20 @@ public:
    virtual ~HashMashBase() {};
    virtual void run() {};
 };
-template<typename _K, typename _V>
+template<typename _K, typename _V,
+typename _T = HashTable<_K, _V, SuperFastHash> >
 class HashMash : public HashMashBase
 {
 protected:
    map<_K, _V>* mMap;
-   HashTable<_K, _V, SuperFastHash>* mHT;
+   _T* mHT;
    ExclusiveLock* mExclusiveLock;
    SharedLock* mSharedLock;
 public:
    HashMash(
       uint32_t loops, uint32_t slots, uint32_t writes, uint32_t reads,
       map<_K, _V>* m,
-      HashTable<_K, _V, SuperFastHash>* h,
+      _T* h,
       ExclusiveLock* exclusiveLock,
       SharedLock* sharedLock) :
       HashMashBase(loops, slots, writes, reads),
@@ -337,7 +411,7 @@ public:
             mWriteTime += Timer::getMilliseconds(start);
          }
          {
-            uint32_t v;
+            _V v;
             uint64_t start = Timer::startTiming();
             for(uint32_t i = 0; i < mReads; ++i)
             {
@@ -382,7 +456,7 @@ public:
             mWriteTime += Timer::getMilliseconds(start);
          }
          {
-            uint32_t v;
+            _V v;
             uint64_t start = Timer::startTiming();
             for(uint32_t i = 0; i < mReads; ++i)
             {
@@ -450,19 +524,142 @@ static void _hashMashStats(
       readTime / 1000.0, sep, readOps / (double)readTime);
 };
 
+/**
+ * Runs mashers on their own threads and prints their stats.
+ *
+ * @param mashers the mashers to run, they will be deleted.
+ */
+static void _hashMashRun(
+   uint32_t threads, uint32_t loops, uint32_t slots,
+   uint32_t writes, uint32_t reads,
+   HashMashBase* mashers[],
+   const char* sep)
+{
+   Thread* t[threads];
+   for(uint32_t i = 0; i < threads; ++i)
+   {
+      t[i] = new Thread(mashers[i]);
+   }
+   uint64_t start = Timer::startTiming();
+   for(uint32_t i = 0; i < threads; ++i)
+   {
+      t[i]->start();
+   }
+   for(uint32_t i = 0; i < threads; ++i)
+   {
+      t[i]->join();
+   }
+   uint64_t wallTime = Timer::getMilliseconds(start);
+   _hashMashStats(
+      threads, loops, slots, writes, reads, mashers, wallTime, sep);
+   for(uint32_t i = 0; i < threads; ++i)
+   {
+      delete mashers[i];
+      delete t[i];
+   }
+};
+
+/**
+ * Mashes a HashTable of CountedValues and prints how many Entries it had
+ * to allocate. An Entry is only allocated when no reclaimed Entry can be
+ * reused, so the slower replaced Entries are reclaimed the more Entries are
+ * allocated per key.
+ */
+template<typename _T>
+static void _hashMashReclamation(
+   uint32_t threads, uint32_t loops, uint32_t slots,
+   uint32_t writes, uint32_t reads, uint32_t initialSize,
+   const char* comment, const char* sep)
+{
+   _T h(initialSize);
+   int32_t before = CountedValue::sCount;
+   HashMashBase* mashers[threads];
+   for(uint32_t i = 0; i < threads; ++i)
+   {
+      mashers[i] = new HashMash<int, CountedValue, _T>(
+         loops, slots, writes, reads, NULL, &h, NULL, NULL);
+   }
+   _hashMashRun(threads, loops, slots, writes, reads, mashers, sep);
+   int32_t entries = CountedValue::sCount - before;
+   printf("%s entries allocated:%" PRIi32 " per key:%.2f\n",
+      comment, entries, entries / (double)(slots > 0 ? slots : 1));
+};
+
 static void runHashTableConcurrencyTest(
-   TestRunner& tr, uint32_t threads, uint32_t reads, uint32_t writes)
+   TestRunner& tr,
+   uint32_t threads, uint32_t loops, uint32_t slots,
+   uint32_t reads, uint32_t writes, uint32_t initialSize)
 {
    tr.group("HashTable concurrency");
 
+   bool csv = true;
+   const char* comment = csv ? "#" : "";
+   const char* sep = csv ? "," : " ";
+
+   printf("%s"
+      " threads:%" PRIu32 " loops:%" PRIu32 " slots:%" PRIu32
+      " w:%" PRIu32 " r:%" PRIu32 " initSize:%" PRIu32 "\n",
+      comment, threads, loops, slots, writes, reads, initialSize);
+
+   // compare throughput of both reclamation schemes with 1, 2, 4, ... up to
+   // the requested number of threads
    char name[100];
+   uint32_t n = 1;
+   while(n > 0)
+   {
+      snprintf(name, 100,
+         "RW threads:%" PRIu32
+         " reads:%" PRIu32
+         " writes:%" PRIu32,
+         n, reads, writes);
+      tr.test(name);
+      {
+         _hashMashHeader(comment, sep);
+         {
+            _hashMashInfo(comment, "HashTable<int, uint32_t> HazardPtrList");
+            HashTable<int, uint32_t, SuperFastHash> h(initialSize);
+            HashMashBase* mashers[n];
+            for(uint32_t i = 0; i < n; ++i)
+            {
+               mashers[i] = new HashMash<int, uint32_t>(
+                  loops, slots, writes, reads, NULL, &h, NULL, NULL);
+            }
+            _hashMashRun(n, loops, slots, writes, reads, mashers, sep);
+         }
+         {
+            _hashMashInfo(comment, "HashTable<int, uint32_t> EpochList");
+            EpochHashTable h(initialSize);
+            HashMashBase* mashers[n];
+            for(uint32_t i = 0; i < n; ++i)
+            {
+               mashers[i] = new HashMash<int, uint32_t, EpochHashTable>(
+                  loops, slots, writes, reads, NULL, &h, NULL, NULL);
+            }
+            _hashMashRun(n, loops, slots, writes, reads, mashers, sep);
+         }
+      }
+      tr.passIfNoException();
+
+      // double the threads, ending with the requested number
+      n = (n >= threads) ? 0 : ((n * 2 > threads) ? threads : n * 2);
+   }
+
+   // compare how quickly replaced entries are reclaimed
    snprintf(name, 100,
-      "RW threads:%" PRIu32
+      "reclamation threads:%" PRIu32
       " reads:%" PRIu32
       " writes:%" PRIu32,
       threads, reads, writes);
    tr.test(name);
    {
+      _hashMashHeader(comment, sep);
+      _hashMashInfo(comment, "HashTable<int, CountedValue> HazardPtrList");
+      _hashMashReclamation<CountedHashTable>(
+         threads, loops, slots, writes, reads, initialSize, comment, sep);
+      _hashMashInfo(comment, "HashTable<int, CountedValue> EpochList");
+      _hashMashReclamation<CountedEpochHashTable>(
+         threads, loops, slots, writes, reads, initialSize, comment, sep);
+      assert(CountedValue::sCount == 0);
    }
    tr.passIfNoException();
 
@@ -628,6 +825,22 @@ static void runHashTableVsMapTest(
    }
    tr.passIfNoException();
 
+   snprintf(name, 100, "ht epoch RW reads:%" PRIu32 " writes:%" PRIu32,
+      reads, writes);
+   tr.test(name);
+   {
+      _hashMashInfo(comment, "HashTable<int, uint32_t> w/ EpochList");
+      EpochHashTable h(initialSize);
+      HashMashBase* mashers[threads];
+      for(uint32_t i = 0; i < threads; ++i)
+      {
+         mashers[i] = new HashMash<int, uint32_t, EpochHashTable>(
+            loops, slots, writes, reads, NULL, &h, NULL, NULL);
+      }
+      _hashMashRun(threads, loops, slots, writes, reads, mashers, sep);
+   }
+   tr.passIfNoException();
+
    tr.ungroup();
 }
 
@@ -636,7 +849,8 @@ static void runHashTableVsMapTest(
  *
  * Options:
  * --test all - run all tests
- * --test threads - test thread concurrency
+ * --test threads - test thread concurrency and memory reclamation with
+ *    hazard pointers vs. epochs (1 to <threads> threads)
  * --test map - test speed vs map (one or more threads)
  * --test mapthreads - test speed vs map (multiple threads w/ locked map)
  * --option threads <n> - number of threads
@@ -645,6 +859,7 @@ static void runHashTableVsMapTest(
  * --option reads <n> - override ops option for number of read operations
  * --option loops <n> - number of times to do writes-reads process
  * --option slots <n> - number of map/hashtable keys to use
+ * --option initialSize <n> - initial hashtable capacity
  *
  * Process will be to loop doing writes, then loop doing reads.  Adjust the
  * loops, writes, and reads options to change the ratio of operations and
@@ -696,7 +911,8 @@ static int runInteractiveTests(TestRunner& tr)
 
    if(all || tr.isTestEnabled("threads"))
    {
-      runHashTableConcurrencyTest(tr, threads, reads, writes);
+      runHashTableConcurrencyTest(
+         tr, threads, loops, slots, reads, writes, initialSize);
    }
    if(all || tr.isTestEnabled("map"))
    {
@@ -1,13 +1,19 @@
 /*
- * Copyright (c) 2007-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2007-2011 Digital Bazaar, Inc. All rights reserved.
  */
+#define __STDC_FORMAT_MACROS
+
 #include "monarch/test/Test.h"
 #include "monarch/test/TestModule.h"
 #include "monarch/modest/Kernel.h"
+#include "monarch/rt/System.h"
 
 #include <cstdio>
+#include <string>
+#include <vector>
 
 using namespace std;
+using namespace monarch::config;
 using namespace monarch::test;
 using namespace monarch::modest;
 using namespace monarch::rt;
@@ -151,6 +157,133 @@ public:
    }
 };
 
+// a guard that lets one operation at a time run in a slot
+class SlotGuard : public StateMutator, public OperationGuard
+{
+public:
+   string key;
+   bool keyed;
+   int running;
+   int maxRunning;
+   uint64_t* checks;
+
+   SlotGuard(const char* k, bool named, uint64_t* counter) :
+      key(k),
+      keyed(named),
+      running(0),
+      maxRunning(0),
+      checks(counter)
+   {
+   }
+
+   virtual bool canExecuteOperation(Operation& op)
+   {
+      ++(*checks);
+      return running == 0;
+   }
+
+   virtual bool mustCancelOperation(Operation& op)
+   {
+      return false;
+   }
+
+   virtual void mutatePreExecutionState(Operation& op)
+   {
+      if(++running > maxRunning)
+      {
+         maxRunning = running;
+      }
+   }
+
+   virtual void mutatePostExecutionState(Operation& op)
+   {
+      --running;
+   }
+
+   virtual bool getStateKeys(vector<const char*>& keys)
+   {
+      if(keyed)
+      {
+         keys.push_back(key.c_str());
+      }
+      return keyed;
+   }
+
+   virtual bool getChangedStateKeys(
+      Operation& op, bool preExecution, vector<const char*>& keys)
+   {
+      if(keyed && !preExecution)
+      {
+         keys.push_back(key.c_str());
+      }
+      return keyed;
+   }
+};
+
+class NullOp : public Runnable
+{
+public:
+   virtual void run()
+   {
+   }
+};
+
+// an operation that waits until it is opened
+class GateOp : public Runnable
+{
+protected:
+   bool mOpen;
+   ExclusiveLock mLock;
+
+public:
+   GateOp() :
+      mOpen(false)
+   {
+   }
+
+   virtual void run()
+   {
+      mLock.lock();
+      while(!mOpen)
+      {
+         mLock.wait();
+      }
+      mLock.unlock();
+   }
+
+   virtual void open()
+   {
+      mLock.lock();
+      mOpen = true;
+      mLock.notifyAll();
+      mLock.unlock();
+   }
+};
+
+// an operation that records the order it ran in
+class OrderOp : public Runnable
+{
+protected:
+   char mName;
+   string* mOrder;
+   ExclusiveLock* mLock;
+
+public:
+   OrderOp(char name, string* order, ExclusiveLock* lock) :
+      mName(name),
+      mOrder(order),
+      mLock(lock)
+   {
+   }
+
+   virtual void run()
+   {
+      mLock->lock();
+      mOrder->push_back(mName);
+      mLock->unlock();
+   }
+};
+
 static void runModestTest(TestRunner& tr)
 {
    tr.test("Modest Engine");
@@ -234,11 +367,520 @@ static void runModestTest(TestRunner& tr)
    tr.passIfNoException();
 }
 
+static void runModestKeyedGuardTest(TestRunner& tr)
+{
+   tr.group("Modest Engine keyed guards");
+
+   tr.test("slots");
+   {
+      Kernel k;
+      k.getEngine()->start();
+
+      uint64_t checks = 0;
+      SlotGuard g1("slot1", true, &checks);
+      SlotGuard g2("slot2", true, &checks);
+      RunOp r("slot", 10);
+
+      vector<Operation> ops;
+      for(int i = 0; i < 20; ++i)
+      {
+         Operation op(r);
+         SlotGuard* g = (i % 2 == 0) ? &g1 : &g2;
+         op->addGuard(g);
+         op->addStateMutator(g);
+         ops.push_back(op);
+      }
+      for(int i = 0; i < 20; ++i)
+      {
+         k.getEngine()->queue(ops[i]);
+      }
+      for(int i = 0; i < 20; ++i)
+      {
+         ops[i]->waitFor();
+         assert(ops[i]->finished());
+      }
+
+      k.getEngine()->stop();
+
+      assert(g1.maxRunning == 1);
+      assert(g2.maxRunning == 1);
+      assert(g1.running == 0);
+      assert(g2.running == 0);
+   }
+   tr.passIfNoException();
+
+   tr.test("cancel waiting");
+   {
+      Kernel k;
+      k.getEngine()->start();
+
+      uint64_t checks = 0;
+      SlotGuard g("slot", true, &checks);
+      RunOp r1("long", 2000);
+      NullOp r2;
+      NullOp r3;
+
+      Operation op1(r1);
+      op1->addGuard(&g);
+      op1->addStateMutator(&g);
+      Operation op2(r2);
+      op2->addGuard(&g);
+      op2->addStateMutator(&g);
+      k.getEngine()->queue(op1);
+      k.getEngine()->queue(op2);
+
+      // wait for the second operation to wait on the slot
+      while(!op1->started() || checks < 2)
+      {
+         Thread::sleep(1);
+      }
+
+      // an interrupted operation is canceled on the next dispatch even
+      // though the state it waits on has not changed
+      op2->interrupt();
+      Operation op3(r3);
+      k.getEngine()->queue(op3);
+      op3->waitFor();
+      assert(op2->waitFor(true, 1000));
+      assert(op2->canceled());
+      assert(!op1->stopped());
+
+      k.getEngine()->stop();
+   }
+   tr.passIfNoException();
+
+   tr.ungroup();
+}
+
+static string _runPriorityOrder(
+   const char* queued, uint32_t highWeight, uint32_t lowWeight)
+{
+   Kernel k;
+   Engine* e = k.getEngine();
+   e->getThreadPool()->setPoolSize(1);
+   e->setPriorityWeight(OperationImpl::High, highWeight);
+   e->setPriorityWeight(OperationImpl::Low, lowWeight);
+
+   // queue everything before the engine starts so that it is all
+   // dispatched by weight
+   string order;
+   ExclusiveLock lock;
+   vector<OrderOp*> runnables;
+   vector<Operation> ops;
+   for(const char* c = queued; *c != 0; ++c)
+   {
+      runnables.push_back(new OrderOp(*c, &order, &lock));
+      Operation op(*runnables.back());
+      op->setPriority((*c == 'H') ? OperationImpl::High : OperationImpl::Low);
+      ops.push_back(op);
+      e->queue(op);
+   }
+   e->start();
+   for(unsigned int i = 0; i < ops.size(); ++i)
+   {
+      ops[i]->waitFor();
+      delete runnables[i];
+   }
+   e->stop();
+
+   return order;
+}
+
+static void runModestPriorityTest(TestRunner& tr)
+{
+   tr.group("Modest Engine priorities");
+
+   tr.test("weighted dispatch");
+   {
+      assertStrCmp(_runPriorityOrder("LLLLHHHH", 8, 1).c_str(), "HHHHLLLL");
+      assertStrCmp(_runPriorityOrder("LLLHHH", 1, 1).c_str(), "HLHLHL");
+      assertStrCmp(_runPriorityOrder("LLLLLHH", 1, 2).c_str(), "HLLHLLL");
+   }
+   tr.passIfNoException();
+
+   tr.test("deadline");
+   {
+      Kernel k;
+      Engine* e = k.getEngine();
+      e->start();
+
+      uint64_t checks = 0;
+      SlotGuard keyed("keyed", true, &checks);
+      SlotGuard unkeyed("unkeyed", false, &checks);
+      GateOp gate;
+      NullOp r;
+
+      // hold both slots, then queue operations that expire waiting on them
+      Operation hold1(gate);
+      hold1->addGuard(&keyed);
+      hold1->addStateMutator(&keyed);
+      Operation hold2(gate);
+      hold2->addGuard(&unkeyed);
+      hold2->addStateMutator(&unkeyed);
+      e->queue(hold1);
+      e->queue(hold2);
+      while(!hold1->started() || !hold2->started())
+      {
+         Thread::sleep(1);
+      }
+
+      uint64_t deadline = System::getCurrentMilliseconds() + 50;
+      Operation op1(r);
+      op1->addGuard(&keyed);
+      op1->addStateMutator(&keyed);
+      op1->setDeadline(deadline);
+      Operation op2(r);
+      op2->addGuard(&unkeyed);
+      op2->addStateMutator(&unkeyed);
+      op2->setDeadline(deadline);
+      e->queue(op1);
+      e->queue(op2);
+
+      // nothing else happens, the engine must wake up for the deadline
+      op1->waitFor(true, 2000);
+      op2->waitFor(true, 2000);
+      assert(op1->stopped() && op1->expired() && op1->canceled());
+      assert(op2->stopped() && op2->expired() && op2->canceled());
+      assert(System::getCurrentMilliseconds() >= deadline);
+
+      gate.open();
+      hold1->waitFor();
+      hold2->waitFor();
+      assert(hold1->finished() && !hold1->expired());
+
+      DynamicObject stats = e->getStats();
+      assert(stats["priorities"]["normal"]["expired"]->getUInt64() == 2);
+      assert(stats["priorities"]["normal"]["dispatched"]->getUInt64() == 2);
+      assert(stats["priorities"]["high"]["dispatched"]->getUInt64() == 0);
+
+      e->stop();
+   }
+   tr.passIfNoException();
+
+   tr.ungroup();
+}
+
+static void runModestOperationStatsTest(TestRunner& tr)
+{
+   tr.group("Modest Engine operation stats");
+
+   tr.test("times");
+   {
+      Kernel k;
+      Engine* e = k.getEngine();
+      e->start();
+
+      uint64_t checks = 0;
+      SlotGuard slot("slot", true, &checks);
+      GateOp gate;
+      RunOp r("timed", 20);
+
+      // hold the slot so that the second operation waits for 50 ms
+      Operation hold(gate);
+      hold->setType("hold");
+      hold->addGuard(&slot);
+      hold->addStateMutator(&slot);
+      Operation op(r);
+      op->setType("timed");
+      op->addGuard(&slot);
+      op->addStateMutator(&slot);
+      assertStrCmp(op->getType(), "timed");
+      assert(op->getQueuedTime() == 0);
+
+      k.runOperation(hold);
+      k.runOperation(op);
+      Thread::sleep(50);
+      gate.open();
+      hold->waitFor();
+      op->waitFor();
+
+      assert(op->getQueuedTime() != 0);
+      assert(op->getQueuedTime() <= op->getDispatchedTime());
+      assert(op->getDispatchedTime() <= op->getStartedTime());
+      assert(op->getStartedTime() <= op->getFinishedTime());
+      assert(op->getDispatchedTime() - op->getQueuedTime() >= 40000);
+      assert(op->getFinishedTime() - op->getStartedTime() >= 15000);
+
+      DynamicObject stats = e->getOperationStats()->getStats();
+      assert(stats->length() == 2);
+      assert(stats["hold"]["total"]["count"]->getUInt64() == 1);
+      DynamicObject& timed = stats["timed"];
+      assert(timed["queue"]["count"]->getUInt64() == 1);
+      assert(timed["queue"]["max"]->getUInt64() ==
+         op->getDispatchedTime() - op->getQueuedTime());
+      assert(timed["run"]["max"]->getUInt64() ==
+         op->getFinishedTime() - op->getStartedTime());
+      assert(timed["total"]["max"]->getUInt64() ==
+         op->getFinishedTime() - op->getQueuedTime());
+
+      // operations that are not run or not recorded are not counted
+      NullOp n;
+      Operation expired(n);
+      expired->setType("timed");
+      expired->setDeadline(1);
+      k.runOperation(expired);
+      e->setOperationStatsEnabled(false);
+      Operation off(n);
+      off->setType("timed");
+      k.runOperation(off);
+      expired->waitFor();
+      assert(expired->expired());
+      off->waitFor();
+      stats = e->getOperationStats()->getStats();
+      assert(stats["timed"]["total"]["count"]->getUInt64() == 1);
+      assert(stats->length() == 2);
+
+      e->resetStats();
+      stats = e->getOperationStats()->getStats();
+      assert(stats["timed"]["total"]["count"]->getUInt64() == 0);
+
+      e->stop();
+   }
+   tr.passIfNoException();
+
+   tr.ungroup();
+}
+
+static bool header = true;
+
+static void runModestGuardPerfTest1(
+   TestRunner& tr, const char* name, int count, int slots, bool keyed)
+{
+   tr.test(name);
+   {
+      Kernel k;
+      k.getEngine()->start();
+
+      uint64_t checks = 0;
+      vector<SlotGuard*> guards;
+      for(int i = 0; i < slots; ++i)
+      {
+         char key[32];
+         snprintf(key, 32, "slot%d", i);
+         guards.push_back(new SlotGuard(key, keyed, &checks));
+      }
+
+      // the first operation in each slot holds it until all are queued
+      GateOp gate;
+      RunOp r("guarded", 1);
+      vector<Operation> ops;
+      for(int i = 0; i < count; ++i)
+      {
+         Operation op(NULL);
+         if(i < slots)
+         {
+            op = Operation(gate);
+         }
+         else
+         {
+            op = Operation(r);
+         }
+         op->addGuard(guards[i % slots]);
+         op->addStateMutator(guards[i % slots]);
+         ops.push_back(op);
+      }
+
+      uint64_t start = System::getCurrentMilliseconds();
+      for(int i = 0; i < count; ++i)
+      {
+         k.getEngine()->queue(ops[i]);
+      }
+      gate.open();
+      for(int i = 0; i < count; ++i)
+      {
+         ops[i]->waitFor();
+      }
+      uint64_t dt = System::getCurrentMilliseconds() - start;
+
+      k.getEngine()->stop();
+
+      for(int i = 0; i < slots; ++i)
+      {
+         assert(guards[i]->maxRunning == 1);
+         delete guards[i];
+      }
+
+      if(header)
+      {
+         printf(
+            "%9s %9s %12s %9s %9s\n",
+            "ops", "slots", "checks", "time (s)", "ops/s");
+         header = false;
+      }
+      printf(
+         "%9d %9d %12" PRIu64 " %9.3f %9.0f\n",
+         count, slots, checks,
+         dt / 1000.0, (dt == 0) ? 0.0 : count * 1000.0 / dt);
+   }
+   tr.passIfNoException();
+}
+
+static void runModestGuardPerfTest(TestRunner& tr)
+{
+   tr.group("Modest Engine guard perf");
+
+   Config cfg = tr.getApp()->getConfig();
+   int count = cfg->hasMember("ops") ? cfg["ops"]->getInt32() : 10000;
+
+   header = true;
+   runModestGuardPerfTest1(tr, "unkeyed 10 ", count, 10, false);
+   runModestGuardPerfTest1(tr, "keyed   10 ", count, 10, true);
+   runModestGuardPerfTest1(tr, "unkeyed 100", count, 100, false);
+   runModestGuardPerfTest1(tr, "keyed   100", count, 100, true);
+   header = true;
+
+   tr.ungroup();
+}
+
+static void runModestPriorityPerfTest1(
+   TestRunner& tr, const char* name, int count, bool prioritize)
+{
+   tr.test(name);
+   {
+      // a burst of Low priority operations with a High priority one for
+      // every ten of them, on a few threads
+      Kernel k;
+      Engine* e = k.getEngine();
+      e->getThreadPool()->setPoolSize(4);
+      e->start();
+
+      RunOp r("burst", 1);
+      vector<Operation> ops;
+      for(int i = 0; i < count; ++i)
+      {
+         Operation op(r);
+         if(prioritize)
+         {
+            op->setPriority(
+               (i % 10 == 9) ? OperationImpl::High : OperationImpl::Low);
+         }
+         ops.push_back(op);
+      }
+
+      uint64_t start = System::getCurrentMilliseconds();
+      for(int i = 0; i < count; ++i)
+      {
+         e->queue(ops[i]);
+      }
+      for(int i = 0; i < count; ++i)
+      {
+         ops[i]->waitFor();
+      }
+      uint64_t dt = System::getCurrentMilliseconds() - start;
+
+      DynamicObject stats = e->getStats()["priorities"];
+      e->stop();
+
+      if(header)
+      {
+         printf(
+            "%9s %9s %12s %12s %12s\n",
+            "ops", "time (s)", "high (us)", "normal (us)", "low (us)");
+         header = false;
+      }
+      printf(
+         "%9d %9.3f %12" PRIu64 " %12" PRIu64 " %12" PRIu64 "\n",
+         count, dt / 1000.0,
+         stats["high"]["averageQueueWait"]->getUInt64(),
+         stats["normal"]["averageQueueWait"]->getUInt64(),
+         stats["low"]["averageQueueWait"]->getUInt64());
+   }
+   tr.passIfNoException();
+}
+
+static void runModestPriorityPerfTest(TestRunner& tr)
+{
+   tr.group("Modest Engine priority perf");
+
+   header = true;
+   runModestPriorityPerfTest1(tr, "fifo       ", 2000, false);
+   runModestPriorityPerfTest1(tr, "prioritized", 2000, true);
+   header = true;
+
+   tr.ungroup();
+}
+
+static void runModestOperationStatsPerfTest1(
+   TestRunner& tr, const char* name, int count, bool enabled)
+{
+   tr.test(name);
+   {
+      Kernel k;
+      Engine* e = k.getEngine();
+      e->setOperationStatsEnabled(enabled);
+      e->start();
+
+      NullOp r;
+      vector<Operation> ops;
+      for(int i = 0; i < count; ++i)
+      {
+         Operation op(r);
+         op->setType((i % 2 == 0) ? "even" : "odd");
+         ops.push_back(op);
+      }
+
+      uint64_t start = System::getCurrentMilliseconds();
+      for(int i = 0; i < count; ++i)
+      {
+         e->queue(ops[i]);
+      }
+      for(int i = 0; i < count; ++i)
+      {
+         ops[i]->waitFor();
+      }
+      uint64_t dt = System::getCurrentMilliseconds() - start;
+
+      DynamicObject stats = e->getOperationStats()->getStats();
+      e->stop();
+
+      if(header)
+      {
+         printf(
+            "%9s %9s %9s %9s %9s %9s\n",
+            "ops", "time (s)", "ops/s", "p50 (us)", "p99 (us)", "max (us)");
+         header = false;
+      }
+      DynamicObject total = enabled ?
+         stats["even"]["total"] : DynamicObject();
+      printf(
+         "%9d %9.3f %9.0f %9" PRIu64 " %9" PRIu64 " %9" PRIu64 "\n",
+         count, dt / 1000.0, count * 1000.0 / (dt == 0 ? 1 : dt),
+         enabled ? total["p50"]->getUInt64() : 0,
+         enabled ? total["p99"]->getUInt64() : 0,
+         enabled ? total["max"]->getUInt64() : 0);
+   }
+   tr.passIfNoException();
+}
+
+static void runModestOperationStatsPerfTest(TestRunner& tr)
+{
+   tr.group("Modest Engine operation stats perf");
+
+   Config cfg = tr.getApp()->getConfig();
+   int count = cfg->hasMember("ops") ? cfg["ops"]->getInt32() : 100000;
+
+   header = true;
+   runModestOperationStatsPerfTest1(tr, "stats off", count, false);
+   runModestOperationStatsPerfTest1(tr, "stats on ", count, true);
+   header = true;
+
+   tr.ungroup();
+}
+
 static bool run(TestRunner& tr)
 {
    if(tr.isDefaultEnabled())
    {
       runModestTest(tr);
+      runModestKeyedGuardTest(tr);
+      runModestPriorityTest(tr);
+      runModestOperationStatsTest(tr);
+   }
+   if(tr.isTestEnabled("modest-perf"))
+   {
+      runModestGuardPerfTest(tr);
+      runModestPriorityPerfTest(tr);
+      runModestOperationStatsPerfTest(tr);
    }
    return true;
 }
@@ -6,20 +6,34 @@
 #include "monarch/data/json/JsonWriter.h"
 #include "monarch/test/Test.h"
 #include "monarch/test/TestModule.h"
+#include "monarch/rt/ClockCache.h"
+#include "monarch/rt/CpuSet.h"
+#include "monarch/rt/DynamicObjectPathSet.h"
 #include "monarch/rt/ExclusiveLock.h"
+#include "monarch/rt/LatencyHistogram.h"
 #include "monarch/rt/Runnable.h"
 #include "monarch/rt/RunnableDelegate.h"
 #include "monarch/rt/Thread.h"
+#include "monarch/rt/ThreadGroup.h"
 #include "monarch/rt/Semaphore.h"
 #include "monarch/rt/SharedLock.h"
+#include "monarch/rt/TimingWheel.h"
+#include "monarch/rt/StringTable.h"
 #include "monarch/rt/System.h"
 #include "monarch/rt/JobDispatcher.h"
+#include "monarch/rt/ScheduledJobDispatcher.h"
+#include "monarch/rt/LockFreeQueue.h"
+#include "monarch/rt/WorkStealingThreadPool.h"
 #include "monarch/util/Macros.h"
 
+#include <cerrno>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
 #include <algorithm>
 #include <map>
+#include <string>
+#include <vector>
 
 using namespace std;
 using namespace monarch::test;
@@ -307,2253 +321,4855 @@ static void runJobDispatcherTest(TestRunner& tr)
    tr.passIfNoException();
 }
 
-class ExclusiveLockRunnable : public Runnable
+class PlacementJob : public Runnable
 {
 public:
-   ExclusiveLock* mLock;
-   volatile bool* mCondition;
-   ExclusiveLockRunnable(ExclusiveLock* lock, volatile bool* condition) :
-      mLock(lock), mCondition(condition) {}
-   virtual ~ExclusiveLockRunnable() {}
+   DynamicObject mResult;
+   volatile uint32_t* mDone;
 
-   virtual void run()
+   PlacementJob(DynamicObject& result, volatile uint32_t* done = NULL)
    {
-      // already locked in test so should fail
-      assert(!mLock->tryLock());
-
-      // set condition
-      *mCondition = true;
-
-      // now lock
-      mLock->lock();
-
-      // update condition in test so it will wait for thread to join
-      *mCondition = false;
-
-      // grabbing lock again should work
-      assert(mLock->tryLock());
+      mResult = result;
+      mDone = done;
+   }
 
-      // release lock
-      mLock->unlock();
+   virtual ~PlacementJob()
+   {
+   }
 
-      // grabbing lock again should work
-      assert(mLock->tryLock());
-      mLock->unlock();
+   virtual void run()
+   {
+      // record the name of the current thread and the cpus the OS lets it
+      // run on
+      CpuSet cpus;
+      CpuSet::getAvailableCpus(cpus);
+      mResult["name"] = Thread::currentThread()->getName();
+      mResult["cpus"] = cpus.toString().c_str();
+      if(mDone != NULL)
+      {
+         Atomic::incrementAndFetch(mDone);
+      }
    }
 };
 
-static void runExclusiveLockTest(TestRunner& tr)
+static void runThreadGroupTest(TestRunner& tr)
 {
-   tr.group("ExclusiveLock");
+   tr.group("ThreadGroup");
 
-   tr.test("try lock");
+   tr.test("CpuSet");
    {
-      ExclusiveLock lock;
-      volatile bool condition = false;
+      CpuSet cpus;
+      assert(cpus.isEmpty());
+      assert(cpus.parse("0-3,8,10-11\n"));
+      assert(cpus.count() == 7);
+      assert(cpus.contains(2));
+      assert(!cpus.contains(9));
+      assertStrCmp(cpus.toString().c_str(), "0-3,8,10-11");
+
+      // cpus are taken in turn
+      assert(cpus.getCpu(0) == 0);
+      assert(cpus.getCpu(4) == 8);
+      assert(cpus.getCpu(6) == 11);
+      assert(cpus.getCpu(7) == 0);
+
+      CpuSet other;
+      assert(other.parse("3,9-10"));
+      cpus.intersect(other);
+      assertStrCmp(cpus.toString().c_str(), "3,10");
+      cpus.remove(3);
+      assertStrCmp(cpus.toString().c_str(), "10");
+   }
+   tr.passIfNoException();
 
-      ExclusiveLockRunnable r1(&lock, &condition);
-      Thread t1(&r1);
+   tr.test("invalid cpu lists");
+   {
+      CpuSet cpus;
+      assertException(cpus.parse("3-1"));
+      Exception::clear();
+      assertException(cpus.parse("1,a"));
+      Exception::clear();
+      assertException(cpus.parse("0-5000"));
+      assert(Exception::get()->hasType("monarch.rt.CpuSet.InvalidCpuList"));
+      Exception::clear();
+      assert(cpus.isEmpty());
+   }
+   tr.passIfNoException();
 
-      // grap lock
-      lock.lock();
+   tr.test("available and NUMA node cpus");
+   {
+      CpuSet available;
+      CpuSet::getAvailableCpus(available);
+      assert(!available.isEmpty());
+      assert(CpuSet::getNodeCount() >= 1);
+
+      CpuSet node;
+      assert(CpuSet::getNodeCpus(0, node));
+      assert(!node.isEmpty());
+      assertException(CpuSet::getNodeCpus(CpuSet::MaxCpus, node));
+      Exception::clear();
+   }
+   tr.passIfNoException();
 
-      // start thread, spin until it sets condition
-      t1.start();
-      while(!condition);
-      lock.unlock();
+   tr.test("thread cpu affinity");
+   {
+      CpuSet available;
+      CpuSet::getAvailableCpus(available);
+      CpuSet cpu;
+      cpu.add(available.getCpu(available.count() - 1));
+
+      // set before starting
+      DynamicObject result;
+      RunnableRef job = new PlacementJob(result);
+      Thread t(job, "pinned");
+      assert(t.setCpuAffinity(&cpu));
+      assert(t.start());
+      t.join();
+      assertStrCmp(result["name"]->getString(), "pinned");
+#ifdef __linux__
+      assertStrCmp(result["cpus"]->getString(), cpu.toString().c_str());
+#endif
 
-      // join thread
-      t1.join();
+      // move the current thread and back
+      Thread* current = Thread::currentThread();
+      assert(current->setCpuAffinity(&cpu));
+      CpuSet cpus;
+      assert(current->getCpuAffinity(cpus));
+      assertStrCmp(cpus.toString().c_str(), cpu.toString().c_str());
+      assert(current->setCpuAffinity(NULL));
+      assert(!current->getCpuAffinity(cpus));
+      CpuSet::getAvailableCpus(cpus);
+      assertStrCmp(cpus.toString().c_str(), available.toString().c_str());
+
+      // an empty set is invalid
+      cpus.clear();
+      assertException(current->setCpuAffinity(&cpus));
+      Exception::clear();
+   }
+   tr.passIfNoException();
 
-      assert(!condition);
+   tr.test("configure");
+   {
+      ThreadGroup group;
+      DynamicObject config;
+      config["name"] = "worker";
+      config["cpus"] = "0-4095";
+      assertException(group.configure(config));
+      assert(Exception::get()->hasType("monarch.rt.ThreadGroup.InvalidConfig"));
+      Exception::clear();
+
+      // cpus are limited to the available ones
+      CpuSet available;
+      CpuSet::getAvailableCpus(available);
+      config["cpus"] = "0-1023";
+      config["numaNode"] = 0;
+      config["perCpu"] = true;
+      assert(group.configure(config));
+      assertStrCmp(group.getName(), "worker");
+      assert(group.isPerCpu());
+      CpuSet node;
+      assert(CpuSet::getNodeCpus(0, node));
+      node.intersect(available);
+      assertStrCmp(
+         group.getCpus().toString().c_str(), node.toString().c_str());
+   }
+   tr.passIfNoException();
+
+   tr.test("ThreadPool");
+   {
+      // one thread per cpu, starting with the first available cpu
+      CpuSet available;
+      CpuSet::getAvailableCpus(available);
+      ThreadGroupRef group = new ThreadGroup("worker");
+      group->setCpus(available);
+      group->setPerCpu(true);
+
+      ThreadPool pool(2);
+      pool.setThreadGroup(group);
+      DynamicObject result1;
+      DynamicObject result2;
+      volatile uint32_t done = 0;
+      RunnableRef job1 = new PlacementJob(result1, &done);
+      RunnableRef job2 = new PlacementJob(result2, &done);
+      pool.runJob(job1);
+      pool.runJob(job2);
+      while(done < 2)
+      {
+         Thread::sleep(1);
+      }
+      pool.terminateAllThreads();
+
+      assert(group->getThreadCount() == 2);
+      DynamicObject names;
+      names[result1["name"]->getString()] = true;
+      names[result2["name"]->getString()] = true;
+      assert(names->hasMember("worker-0"));
+      assert(names->hasMember("worker-1"));
+#ifdef __linux__
+      CpuSet cpu;
+      cpu.add(available.getCpu(0));
+      DynamicObject& first =
+         (strcmp(result1["name"]->getString(), "worker-0") == 0) ?
+         result1 : result2;
+      assertStrCmp(first["cpus"]->getString(), cpu.toString().c_str());
+#endif
    }
    tr.passIfNoException();
 
    tr.ungroup();
 }
 
-class SharedLockRunnable : public Runnable
+class CountingJob : public Runnable
 {
 public:
-   SharedLock* mLock;
-   int* mTotal;
-   bool mWrite;
-   int mNumber;
+   volatile uint32_t* mCount;
+   CountingJob(volatile uint32_t* count) : mCount(count) {}
+   virtual ~CountingJob() {}
 
-   SharedLockRunnable(SharedLock* lock, int* total, bool write, int number)
+   virtual void run()
    {
-      mLock = lock;
-      mTotal = total;
-      mWrite = write;
-      mNumber = number;
+      Atomic::incrementAndFetch(mCount);
    }
+};
 
-   virtual ~SharedLockRunnable()
-   {
-   }
+class SplittingJob : public Runnable
+{
+public:
+   WorkStealingThreadPool* mPool;
+   volatile uint32_t* mCount;
+   uint32_t mSize;
+   bool mJoin;
+   SplittingJob(
+      WorkStealingThreadPool* pool, volatile uint32_t* count,
+      uint32_t size, bool join) :
+      mPool(pool), mCount(count), mSize(size), mJoin(join) {}
+   virtual ~SplittingJob() {}
 
    virtual void run()
    {
-      Thread::sleep(rand() % 10 + 1);
-
-      if(mWrite)
+      if(mSize == 1)
       {
-         mLock->lockExclusive();
-         {
-            for(int i = 0; i < 1000; ++i)
-            {
-               *mTotal += mNumber;
-            }
-         }
-         mLock->unlockExclusive();
+         Atomic::incrementAndFetch(mCount);
       }
       else
       {
-         mLock->lockShared();
+         // spawn subjobs for each half, optionally waiting for them
+         volatile uint32_t halves = 0;
+         uint32_t half = mSize / 2;
+         RunnableRef left = new SplittingJob(
+            mPool, mJoin ? &halves : mCount, half, mJoin);
+         RunnableRef right = new SplittingJob(
+            mPool, mJoin ? &halves : mCount, mSize - half, mJoin);
+         mPool->runJob(left);
+         mPool->runJob(right);
+         if(mJoin)
          {
-            int total = *mTotal;
-            assert(
-               total == 0 || total == 2000 ||
-               total == 3000 || total == 5000);
-
-            mLock->lockShared();
+            while(halves < mSize)
             {
-               assert(
-                  total == 0 || total == 2000 ||
-                  total == 3000 || total == 5000);
-
-               mLock->lockShared();
+               if(!mPool->runPendingJob())
                {
-                  assert(
-                     total == 0 || total == 2000 ||
-                     total == 3000 || total == 5000);
+                  Thread::yield();
                }
-               mLock->unlockShared();
             }
-            mLock->unlockShared();
+            for(uint32_t i = 0; i < mSize; ++i)
+            {
+               Atomic::incrementAndFetch(mCount);
+            }
          }
-         mLock->unlockShared();
       }
    }
 };
 
-class DeadlockRunnable : public Runnable
+class SpawningJob : public Runnable
 {
 public:
-   SharedLock* mLock;
-   ExclusiveLock* mSignalLock;
-   bool* mSignal;
-   bool mWrite;
+   WorkStealingThreadPool* mPool;
+   volatile uint32_t* mCount;
+   uint32_t mJobs;
+   SpawningJob(
+      WorkStealingThreadPool* pool, volatile uint32_t* count, uint32_t jobs) :
+      mPool(pool), mCount(count), mJobs(jobs) {}
+   virtual ~SpawningJob() {}
 
-   DeadlockRunnable(
-      SharedLock* lock, ExclusiveLock* signalLock, bool* signal, bool write) :
-      mLock(lock),
-      mSignalLock(signalLock),
-      mSignal(signal),
-      mWrite(write)
+   virtual void run()
    {
+      // queue subjobs on this worker, then keep it busy
+      for(uint32_t i = 0; i < mJobs; ++i)
+      {
+         RunnableRef r = new CountingJob(mCount);
+         mPool->runJob(r);
+      }
+      Thread::sleep(200);
    }
+};
 
-   virtual ~DeadlockRunnable()
+static bool waitForCount(volatile uint32_t* count, uint32_t expected)
+{
+   for(int i = 0; *count < expected && i < 10000; ++i)
    {
+      Thread::sleep(1);
    }
+   return *count == expected;
+}
 
-   virtual void run()
+static void runWorkStealingThreadPoolTest(TestRunner& tr)
+{
+   tr.group("WorkStealingThreadPool");
+
+   tr.test("run jobs");
    {
-      if(mWrite)
+      WorkStealingThreadPool pool(4);
+      volatile uint32_t count = 0;
+      CountingJob job(&count);
+      for(int i = 0; i < 10000; ++i)
       {
-         // wait for signal to get exclusive lock
-         mSignalLock->lock();
-         while(!(*mSignal))
-         {
-            mSignalLock->wait();
-         }
-         mSignalLock->unlock();
-
-         // get exclusive lock
-         mLock->lockExclusive();
-
-         // should block forever if test fails
-
-         mLock->unlockExclusive();
+         RunnableRef r = new CountingJob(&count);
+         assert(pool.runJob(r));
       }
-      else
-      {
-         // get shared lock
-         mLock->lockShared();
-         {
-            // set signal
-            mSignalLock->lock();
-            *mSignal = true;
-            mSignalLock->notifyAll();
-            mSignalLock->unlock();
+      assert(pool.runJob(job));
+      assert(waitForCount(&count, 10001));
+      assert(pool.getThreadCount() <= 4);
+      pool.terminateAllThreads();
+      assert(pool.getThreadCount() == 0);
+   }
+   tr.passIfNoException();
 
-            // wait to allow lock exclusive to occur in write thread
-            Thread::sleep(250);
+   tr.test("spawn subjobs");
+   {
+      WorkStealingThreadPool pool(4);
+      volatile uint32_t count = 0;
+      RunnableRef r = new SplittingJob(&pool, &count, 4096, false);
+      pool.runJob(r);
+      assert(waitForCount(&count, 4096));
+      assert(pool.getQueuedJobCount() == 0);
+   }
+   tr.passIfNoException();
 
-            // try to get shared lock
-            mLock->lockShared();
+   tr.test("join subjobs");
+   {
+      WorkStealingThreadPool pool(4);
+      volatile uint32_t count = 0;
+      RunnableRef r = new SplittingJob(&pool, &count, 4096, true);
+      pool.runJob(r);
+      assert(waitForCount(&count, 4096));
+   }
+   tr.passIfNoException();
 
-            // should block here for ever if test fails
+   tr.test("pool size limits jobs");
+   {
+      WorkStealingThreadPool pool(2);
+      TestJob slow("1");
+      assert(pool.tryRunJob(slow));
+      assert(pool.tryRunJob(slow));
+      assert(!pool.tryRunJob(slow));
+      assert(pool.getQueuedJobCount() + pool.getRunningThreadCount() <= 2);
+
+      // blocks until a job completes
+      assert(pool.runJob(slow));
+      pool.terminateAllThreads();
+   }
+   tr.passIfNoException();
 
-            // recursive unlock shared lock
-            mLock->unlockShared();
-         }
-         mLock->unlockShared();
+   tr.test("terminate");
+   {
+      WorkStealingThreadPool pool(1);
+      volatile uint32_t count = 0;
+      RunnableRef r = new SpawningJob(&pool, &count, 10);
+      assert(pool.runJob(r));
+      Thread::sleep(50);
+      assert(pool.getRunningThreadCount() == 1);
+      assert(pool.getQueuedJobCount() == 10);
+      assert(count == 0);
+
+      // queued jobs are run, not dropped
+      pool.terminateAllThreads();
+      assert(count == 10);
+      assert(pool.getThreadCount() == 0);
+      assert(pool.getQueuedJobCount() == 0);
+
+      // pool can be used again, with a different size
+      pool.setPoolSize(3);
+      count = 0;
+      for(int i = 0; i < 100; ++i)
+      {
+         RunnableRef r = new CountingJob(&count);
+         pool.runJob(r);
       }
+      assert(waitForCount(&count, 100));
+      assert(pool.getThreadCount() <= 3);
    }
-};
-
-static void _runSharedLockDeadlockTest()
-{
-   // this test checks to see if thread 1 can get a read lock,
-   // wait for thread 2 to get a write lock, and then see if
-   // thread 1 can recurse its read lock (it should be able to)
-
-   SharedLock lock;
-   ExclusiveLock signalLock;
-   bool signal = false;
+   tr.passIfNoException();
 
-   DeadlockRunnable r1(&lock, &signalLock, &signal, false);
-   DeadlockRunnable r2(&lock, &signalLock, &signal, true);
+   tr.test("lazy start and expire");
+   {
+      WorkStealingThreadPool pool(8);
+      pool.setThreadExpireTime(50);
+      assert(pool.getThreadCount() == 0);
+
+      volatile uint32_t count = 0;
+      CountingJob job(&count);
+      assert(pool.runJob(job));
+      assert(waitForCount(&count, 1));
+      assert(pool.getThreadCount() == 1);
+
+      // the idle worker expires
+      for(int i = 0; pool.getThreadCount() > 0 && i < 100; ++i)
+      {
+         Thread::sleep(10);
+      }
+      assert(pool.getThreadCount() == 0);
 
-   Thread t1(&r1);
-   Thread t2(&r2);
+      // and another one is started for the next job
+      assert(pool.runJob(job));
+      assert(waitForCount(&count, 2));
+   }
+   tr.passIfNoException();
 
-   t2.start();
-   t1.start();
+   tr.test("JobDispatcher");
+   {
+      WorkStealingThreadPool pool(3);
+      JobDispatcher jd(&pool, false);
+      volatile uint32_t count = 0;
+      for(int i = 0; i < 1000; ++i)
+      {
+         RunnableRef r = new CountingJob(&count);
+         jd.queueJob(r);
+      }
+      jd.startDispatching();
+      assert(waitForCount(&count, 1000));
+      jd.stopDispatching();
+      assert(jd.getTotalJobCount() == 0);
+   }
+   tr.passIfNoException();
 
-   t1.join();
-   t2.join();
+   tr.ungroup();
 }
 
-static void runSharedLockTest(TestRunner& tr)
+class OverlapJob : public Runnable
 {
-   tr.group("SharedLock");
+public:
+   volatile uint32_t mCount;
+   volatile uint32_t mRunning;
+   volatile uint32_t mOverlaps;
+   uint32_t mSleep;
+   OverlapJob(uint32_t sleep) :
+      mCount(0), mRunning(0), mOverlaps(0), mSleep(sleep) {}
+   virtual ~OverlapJob() {}
 
-   tr.test("simple read/write");
+   virtual void run()
    {
-      uint64_t start = System::getCurrentMilliseconds();
-      for(int i = 0; i < 200; ++i)
+      if(Atomic::incrementAndFetch(&mRunning) > 1)
       {
-         SharedLock lock;
-         int total = 0;
-
-         SharedLockRunnable r1(&lock, &total, false, 0);
-         SharedLockRunnable r2(&lock, &total, true, 2);
-         SharedLockRunnable r3(&lock, &total, false, 0);
-         SharedLockRunnable r4(&lock, &total, true, 3);
-         SharedLockRunnable r5(&lock, &total, false, 0);
-
-         Thread t1(&r1);
-         Thread t2(&r2);
-         Thread t3(&r3);
-         Thread t4(&r4);
-         Thread t5(&r5);
+         Atomic::incrementAndFetch(&mOverlaps);
+      }
+      Thread::sleep(mSleep);
+      Atomic::decrementAndFetch(&mRunning);
+      Atomic::incrementAndFetch(&mCount);
+   }
+};
 
-         t1.start();
-         t2.start();
-         t3.start();
-         t4.start();
-         t5.start();
+static void runScheduledJobDispatcherTest(TestRunner& tr)
+{
+   tr.group("ScheduledJobDispatcher");
 
-         lock.lockShared();
-         assert(total == 0 || total == 2000 || total == 3000 || total == 5000);
-         lock.unlockShared();
+   ThreadPool pool(3);
+   ScheduledJobDispatcher sjd(&pool, false);
+   sjd.startDispatching();
 
-         lock.lockExclusive();
-         lock.lockShared();
-         assert(total == 0 || total == 2000 || total == 3000 || total == 5000);
-         lock.unlockShared();
-         lock.unlockExclusive();
+   tr.test("once");
+   {
+      volatile uint32_t count = 0;
+      RunnableRef r = new CountingJob(&count);
+      ScheduledJobRef sj = sjd.schedule(r, 50);
+      assert(sjd.getScheduledJobCount() == 1);
+      Thread::sleep(20);
+      assert(count == 0);
+      assert(waitForCount(&count, 1));
+      Thread::sleep(20);
+      assert(sjd.getScheduledJobCount() == 0);
+      assert(!sjd.cancel(sj));
+   }
+   tr.passIfNoException();
 
-         lock.lockShared();
-         assert(total == 0 || total == 2000 || total == 3000 || total == 5000);
-         lock.unlockShared();
+   tr.test("cancel");
+   {
+      volatile uint32_t count = 0;
+      RunnableRef r = new CountingJob(&count);
+      ScheduledJobRef sj = sjd.schedule(r, 50);
+      ScheduledJobRef sj2 = sjd.scheduleAtFixedRate(r, 50, 10);
+      assert(sjd.cancel(sj));
+      assert(!sjd.cancel(sj));
+      assert(sjd.cancel(sj2));
+      Thread::sleep(100);
+      assert(count == 0);
+      assert(sjd.getScheduledJobCount() == 0);
+   }
+   tr.passIfNoException();
 
-         lock.lockShared();
-         assert(total == 0 || total == 2000 || total == 3000 || total == 5000);
-         lock.unlockShared();
+   tr.test("fixed rate");
+   {
+      volatile uint32_t count = 0;
+      RunnableRef r = new CountingJob(&count);
+      ScheduledJobRef sj = sjd.scheduleAtFixedRate(r, 0, 10);
+      assert(waitForCount(&count, 5));
+      assert(sjd.cancel(sj));
+      Thread::sleep(20);
+      uint32_t c = count;
+      Thread::sleep(50);
+      assert(count == c);
+   }
+   tr.passIfNoException();
 
-         t1.join();
-         t2.join();
-         t3.join();
-         t4.join();
-         t5.join();
+   tr.test("fixed delay");
+   {
+      OverlapJob* job = new OverlapJob(5);
+      RunnableRef r = job;
+      ScheduledJobRef sj = sjd.scheduleWithFixedDelay(r, 0, 5);
+      assert(waitForCount(&job->mCount, 5));
+      assert(sjd.cancel(sj));
+      assert(job->mOverlaps == 0);
+   }
+   tr.passIfNoException();
 
-         lock.lockShared();
-         assert(total == 5000);
-         lock.unlockShared();
-      }
-      uint64_t end = System::getCurrentMilliseconds();
-      double secs = (end - start) / 1000.;
-      printf("time=%.2f secs... ", secs);
+   tr.test("coalesce");
+   {
+      // the job takes longer than its period, so timers are coalesced
+      // instead of running the job concurrently
+      sjd.resetStats();
+      OverlapJob* job = new OverlapJob(30);
+      RunnableRef r = job;
+      ScheduledJobRef sj = sjd.scheduleAtFixedRate(r, 0, 5);
+      assert(waitForCount(&job->mCount, 3));
+      assert(sjd.cancel(sj));
+      Thread::sleep(50);
+      assert(job->mOverlaps == 0);
+      DynamicObject stats = sjd.getStats();
+      assert(stats["coalesced"]->getUInt64() > 0);
+      assert(stats["scheduledRuns"]->getUInt64() >= job->mCount);
    }
    tr.passIfNoException();
 
-   tr.test("recursive read+write+read");
+   tr.test("10k jobs");
    {
-      _runSharedLockDeadlockTest();
+      volatile uint32_t count = 0;
+      RunnableRef r = new CountingJob(&count);
+      for(uint32_t i = 0; i < 10000; ++i)
+      {
+         sjd.schedule(r, (i * 7919) % 200);
+      }
+      assert(waitForCount(&count, 10000));
+      Thread::sleep(20);
+      assert(sjd.getScheduledJobCount() == 0);
+   }
+   tr.passIfNoException();
+
+   sjd.stopDispatching();
+
+   tr.test("destroy while running");
+   {
+      // the destructor waits for a run on the pool to finish
+      ThreadPool pool2(3);
+      ScheduledJobDispatcher* d = new ScheduledJobDispatcher(&pool2, false);
+      d->startDispatching();
+      OverlapJob* job = new OverlapJob(50);
+      RunnableRef r = job;
+      d->scheduleAtFixedRate(r, 0, 5);
+      for(int i = 0; job->mRunning == 0 && i < 1000; ++i)
+      {
+         Thread::sleep(1);
+      }
+      assert(job->mRunning == 1);
+      delete d;
+      assert(job->mRunning == 0);
+      uint32_t c = job->mCount;
+      Thread::sleep(50);
+      assert(job->mCount == c);
+      assert(job->mOverlaps == 0);
+
+      // queued runs are dropped
+      ThreadPool pool3(1);
+      OverlapJob blocker(100);
+      pool3.runJob(blocker);
+      d = new ScheduledJobDispatcher(&pool3, false);
+      d->startDispatching();
+      d->schedule(r, 0);
+      for(int i = 0; d->getQueuedJobCount() == 0 && i < 1000; ++i)
+      {
+         Thread::sleep(1);
+      }
+      assert(d->getQueuedJobCount() == 1);
+      delete d;
+      assert(waitForCount(&blocker.mCount, 1));
+      Thread::sleep(20);
+      assert(job->mCount == c);
    }
    tr.passIfNoException();
 
    tr.ungroup();
 }
 
-struct StarvationData
+static void runWorkStealingSpeedTest(TestRunner& tr)
 {
-   SharedLock lock;
-   ExclusiveLock protect;
-   bool signal;
-   bool write;
-   bool reader;
-   int count;
-   int maxReaders;
-   int maxWriters;
-};
+   tr.group("WorkStealingThreadPool speed");
 
-class StarvationRunnable : public Runnable
-{
-public:
-   StarvationData* mStarvationData;
-   bool mWriter;
+   uint32_t cores = System::getCpuCoreCount();
+   const uint32_t jobs = 100000;
 
-   StarvationRunnable(StarvationData* sd, bool writer) :
-      mStarvationData(sd),
-      mWriter(writer)
+   tr.test("ThreadPool");
+   {
+      ThreadPool pool(cores);
+      volatile uint32_t count = 0;
+      CountingJob job(&count);
+      uint64_t start = System::getCurrentMilliseconds();
+      for(uint32_t i = 0; i < jobs; ++i)
+      {
+         pool.runJob(job);
+      }
+      assert(waitForCount(&count, jobs));
+      uint64_t dt = System::getCurrentMilliseconds() - start;
+      printf("%u jobs on %u threads: %" PRIu64 " ms... ", jobs, cores, dt);
+   }
+   tr.passIfNoException();
+
+   tr.test("WorkStealingThreadPool");
    {
+      WorkStealingThreadPool pool(cores);
+      volatile uint32_t count = 0;
+      CountingJob job(&count);
+      uint64_t start = System::getCurrentMilliseconds();
+      for(uint32_t i = 0; i < jobs; ++i)
+      {
+         pool.runJob(job);
+      }
+      assert(waitForCount(&count, jobs));
+      uint64_t dt = System::getCurrentMilliseconds() - start;
+      printf("%u jobs on %u threads: %" PRIu64 " ms... ", jobs, cores, dt);
    }
+   tr.passIfNoException();
 
-   virtual ~StarvationRunnable()
+   tr.test("WorkStealingThreadPool subjobs");
    {
+      WorkStealingThreadPool pool(cores);
+      volatile uint32_t count = 0;
+      uint64_t start = System::getCurrentMilliseconds();
+      RunnableRef r = new SplittingJob(&pool, &count, jobs, false);
+      pool.runJob(r);
+      assert(waitForCount(&count, jobs));
+      uint64_t dt = System::getCurrentMilliseconds() - start;
+      printf("%u jobs on %u threads: %" PRIu64 " ms... ", jobs, cores, dt);
    }
+   tr.passIfNoException();
+
+   tr.ungroup();
+}
+
+class QueueProducer : public Runnable
+{
+public:
+   LockFreeQueue<uint32_t>* mQueue;
+   uint32_t mStart;
+   uint32_t mCount;
+   QueueProducer(
+      LockFreeQueue<uint32_t>* queue, uint32_t start, uint32_t count) :
+      mQueue(queue), mStart(start), mCount(count) {}
+   virtual ~QueueProducer() {}
 
    virtual void run()
    {
-      // wait for signal to start
-      mStarvationData->protect.lock();
-      while(!mStarvationData->signal)
+      // push singly and in batches of up to 8
+      uint32_t items[8];
+      for(uint32_t i = 0; i < mCount;)
       {
-         mStarvationData->protect.wait();
+         uint32_t n = (i % 3 == 0) ? 1 : min(8U, mCount - i);
+         for(uint32_t j = 0; j < n; ++j)
+         {
+            items[j] = mStart + i + j;
+         }
+         uint32_t pushed = 0;
+         while(pushed < n)
+         {
+            pushed += mQueue->push(items + pushed, n - pushed);
+         }
+         i += n;
       }
-      mStarvationData->protect.unlock();
+   }
+};
 
-      Thread::sleep(rand() % 10 + 1);
+class QueueConsumer : public Runnable
+{
+public:
+   LockFreeQueue<uint32_t>* mQueue;
+   volatile uint32_t* mRemaining;
+   uint64_t mSum;
+   QueueConsumer(
+      LockFreeQueue<uint32_t>* queue, volatile uint32_t* remaining) :
+      mQueue(queue), mRemaining(remaining), mSum(0) {}
+   virtual ~QueueConsumer() {}
 
-      if(mWriter)
+   virtual void run()
+   {
+      uint32_t items[5];
+      while(*mRemaining > 0)
       {
-         mStarvationData->lock.lockExclusive();
+         uint32_t n = mQueue->pop(items, 5);
+         for(uint32_t i = 0; i < n; ++i)
          {
-            if(mStarvationData->reader)
-            {
-               mStarvationData->maxReaders = mStarvationData->count;
-               mStarvationData->count = 1;
-               mStarvationData->reader = false;
-            }
-            else
-            {
-               ++mStarvationData->count;
-            }
+            mSum += items[i];
+            Atomic::decrementAndFetch(mRemaining);
          }
-         mStarvationData->lock.unlockExclusive();
-      }
-      else
-      {
-         mStarvationData->lock.lockShared();
+         if(n == 0)
          {
-            if(!mStarvationData->reader)
-            {
-               mStarvationData->maxWriters = mStarvationData->count;
-               mStarvationData->count = 1;
-               mStarvationData->reader = true;
-            }
-            else
-            {
-               ++mStarvationData->count;
-            }
+            Thread::yield();
          }
-         mStarvationData->lock.unlockShared();
       }
    }
 };
 
-static void runInteractiveSharedLockTest(TestRunner& tr)
+class StallingQueue : public LockFreeQueue<int>
 {
-   tr.group("SharedLock");
+public:
+   StallingQueue() : LockFreeQueue<int>(8) {}
+   virtual ~StallingQueue() {}
 
-   tr.test("recursive read+write+read");
+   // claims a slot like push() but does not publish it yet
+   uint64_t stallPush()
    {
-      _runSharedLockDeadlockTest();
+      uint64_t start;
+      claim(&mTail, 0, 1, start);
+      return start;
+   }
+
+   void finishPush(uint64_t pos, int item)
+   {
+      Cell* cell = &mBuffer[pos & mMask];
+      cell->item = item;
+      Atomic::memoryBarrier();
+      cell->sequence = pos + 1;
+   }
+};
+
+static void runLockFreeQueueTest(TestRunner& tr)
+{
+   tr.group("LockFreeQueue");
+
+   tr.test("push/pop");
+   {
+      LockFreeQueue<int> q(5);
+      assert(q.capacity() == 8);
+      assert(q.isEmpty());
+
+      int items[10] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+      assert(q.push(items[0]));
+      assert(q.push(items + 1, 10) == 7);
+      assert(!q.push(items[9]));
+      assert(q.size() == 8);
+
+      int item;
+      assert(q.pop(item));
+      assert(item == 0);
+      int out[10];
+      assert(q.pop(out, 3) == 3);
+      assert(out[0] == 1 && out[1] == 2 && out[2] == 3);
+      assert(q.push(items + 8, 2) == 2);
+      assert(q.pop(out, 10) == 6);
+      assert(out[0] == 4 && out[3] == 7 && out[4] == 8 && out[5] == 9);
+      assert(!q.pop(item));
+      assert(q.isEmpty());
    }
    tr.passIfNoException();
 
-   tr.test("starvation");
+   tr.test("stalled producer");
    {
-      // this test checks to ensure that neither readers
-      // nor writers starve each other out
-      for(int i = 0; i < 200; ++i)
+      StallingQueue q;
+      int item;
+      assert(q.push(1));
+      uint64_t pos = q.stallPush();
+      assert(q.push(3));
+
+      // only published items are popped, consumers do not wait
+      assert(q.pop(item));
+      assert(item == 1);
+      assert(!q.pop(item));
+      assert(!q.pop(item));
+
+      q.finishPush(pos, 2);
+      assert(q.pop(item));
+      assert(item == 2);
+      assert(q.pop(item));
+      assert(item == 3);
+      assert(q.isEmpty());
+   }
+   tr.passIfNoException();
+
+   tr.test("concurrent");
+   {
+      LockFreeQueue<uint32_t> q(64);
+      const uint32_t perProducer = 25000;
+      volatile uint32_t remaining = perProducer * 4;
+
+      QueueProducer* producers[4];
+      QueueConsumer* consumers[4];
+      Thread* threads[8];
+      for(uint32_t i = 0; i < 4; ++i)
       {
-         StarvationData sd;
-         sd.signal = false;
-         sd.reader = false;
-         sd.count = 0;
-         sd.maxReaders = 0;
-         sd.maxWriters = 0;
+         producers[i] = new QueueProducer(&q, i * perProducer, perProducer);
+         consumers[i] = new QueueConsumer(&q, &remaining);
+         threads[i] = new Thread(producers[i]);
+         threads[i + 4] = new Thread(consumers[i]);
+      }
+      for(int i = 0; i < 8; ++i)
+      {
+         threads[i]->start();
+      }
+      uint64_t sum = 0;
+      for(int i = 0; i < 8; ++i)
+      {
+         threads[i]->join();
+         delete threads[i];
+      }
+      for(int i = 0; i < 4; ++i)
+      {
+         sum += consumers[i]->mSum;
+         delete producers[i];
+         delete consumers[i];
+      }
 
-         int num = 50;
-         Thread* threads[(num * 2)];
+      // every item was popped exactly once
+      uint64_t n = perProducer * 4;
+      assert(sum == n * (n - 1) / 2);
+      assert(q.isEmpty());
+   }
+   tr.passIfNoException();
 
-         // create readers
-         for(int n = 0; n < num; ++n)
-         {
-            RunnableRef r = new StarvationRunnable(&sd, false);
-            threads[n] = new Thread(r);
-         }
+   tr.ungroup();
+}
 
-         // create writers
-         for(int n = 0; n < num; ++n)
-         {
-            RunnableRef r = new StarvationRunnable(&sd, true);
-            threads[n + num] = new Thread(r);
-         }
+static void runJobDispatcherStatsTest(TestRunner& tr)
+{
+   tr.test("JobDispatcher stats");
+   {
+      WorkStealingThreadPool pool(2);
+      JobDispatcher jd(&pool, false);
+      volatile uint32_t count = 0;
+      CountingJob job(&count);
 
-         // start threads
-         for(int n = 0; n < (num * 2); ++n)
-         {
-            threads[n]->start();
-         }
+      // more jobs than fit in the lock-free queue before dispatching
+      for(int i = 0; i < 10000; ++i)
+      {
+         jd.queueJob(job);
+      }
+      assert(jd.getQueuedJobCount() == 10000);
+      assert(jd.isQueued(job));
 
-         // set signal to start
-         sd.protect.lock();
-         sd.signal = true;
-         sd.protect.notifyAll();
-         sd.protect.unlock();
+      jd.startDispatching();
+      assert(waitForCount(&count, 10000));
+      for(int i = 0; i < 1000 && jd.getTotalJobCount() > 0; ++i)
+      {
+         Thread::sleep(1);
+      }
 
-         // join threads
-         for(int n = 0; n < (num * 2); ++n)
-         {
-            threads[n]->join();
-            delete threads[n];
-         }
+      DynamicObject stats = jd.getStats();
+      assert(stats["queueDepth"]->getUInt32() == 0);
+      assert(stats["maxQueueDepth"]->getUInt32() == 10000);
+      assert(stats["enqueued"]->getUInt64() == 10000);
+      assert(stats["dispatched"]->getUInt64() == 10000);
 
-         // report max counts
-         printf(
-            "max consecutive readers: %i, "
-            "max consecutive writers: %i... \n",
-            sd.maxReaders, sd.maxWriters);
+      // queue while the dispatcher is asleep
+      for(int i = 0; i < 10 && stats["parks"]->getUInt64() == 0; ++i)
+      {
+         Thread::sleep(10);
+         stats = jd.getStats();
       }
+      assert(stats["parks"]->getUInt64() > 0);
+      uint64_t wakeups = stats["wakeups"]->getUInt64();
+      jd.queueJob(job);
+      assert(waitForCount(&count, 10001));
+      stats = jd.getStats();
+      assert(stats["wakeups"]->getUInt64() > wakeups);
+
+      jd.stopDispatching();
+      jd.resetStats();
+      stats = jd.getStats();
+      assert(stats["enqueued"]->getUInt64() == 0);
    }
    tr.passIfNoException();
-
-   tr.ungroup();
 }
 
-static void runCollectableTest(TestRunner& tr)
+static void runJobDispatcherLoadTest(TestRunner& tr)
 {
-   tr.group("Collectable");
+   tr.group("JobDispatcher load");
 
-   tr.test("basic");
+   tr.test("100k jobs/s");
    {
-      Collectable<int> c = new int(10);
-   }
-   tr.passIfNoException();
+      WorkStealingThreadPool pool(System::getCpuCoreCount());
+      JobDispatcher jd(&pool, false);
+      jd.startDispatching();
 
-   tr.test("relinquish");
-   {
-      Collectable<int> c = new int(10);
-      int* foo = c.relinquish();
-      delete foo;
+      // queue 1000 jobs every 10 ms for 1 second
+      volatile uint32_t count = 0;
+      CountingJob job(&count);
+      uint64_t start = System::getCurrentMilliseconds();
+      for(int tick = 1; tick <= 100; ++tick)
+      {
+         for(int i = 0; i < 1000; ++i)
+         {
+            jd.queueJob(job);
+         }
+         uint64_t now = System::getCurrentMilliseconds();
+         if(now < start + tick * 10)
+         {
+            Thread::sleep(start + tick * 10 - now);
+         }
+      }
+      assert(waitForCount(&count, 100000));
+      uint64_t dt = System::getCurrentMilliseconds() - start;
+      jd.stopDispatching();
+
+      DynamicObject stats = jd.getStats();
+      assert(stats["dispatched"]->getUInt64() == 100000);
+      printf("%" PRIu64 " ms... ", dt);
+      monarch::data::json::JsonWriter::writeToStdOut(stats);
    }
    tr.passIfNoException();
 
    tr.ungroup();
 }
 
-static void runDynamicObjectTest(TestRunner& tr)
+class ExclusiveLockRunnable : public Runnable
 {
-   tr.test("DynamicObject");
+public:
+   ExclusiveLock* mLock;
+   volatile bool* mCondition;
+   ExclusiveLockRunnable(ExclusiveLock* lock, volatile bool* condition) :
+      mLock(lock), mCondition(condition) {}
+   virtual ~ExclusiveLockRunnable() {}
 
-   DynamicObject dyno1;
-   dyno1["id"] = 2;
-   dyno1["username"] = "testuser1000";
-   dyno1["somearray"][0] = "item1";
-   dyno1["somearray"][1] = "item2";
-   dyno1["somearray"][2] = "item3";
+   virtual void run()
+   {
+      // already locked in test so should fail
+      assert(!mLock->tryLock());
 
-   DynamicObject dyno2;
-   dyno2["street"] = "1700 Kraft Dr.";
-   dyno2["zip"] = "24060";
+      // set condition
+      *mCondition = true;
 
-   dyno1["address"] = dyno2;
+      // now lock
+      mLock->lock();
 
-   assert(dyno1["id"]->getInt32() == 2);
-   assertStrCmp(dyno1["username"]->getString(), "testuser1000");
-   assert(dyno1["username"] == "testuser1000");
-   assert("testuser1000" == dyno1["username"]);
+      // update condition in test so it will wait for thread to join
+      *mCondition = false;
 
-   assertStrCmp(dyno1["somearray"][0]->getString(), "item1");
-   assertStrCmp(dyno1["somearray"][1]->getString(), "item2");
-   assertStrCmp(dyno1["somearray"][2]->getString(), "item3");
-   assert(dyno1["somearray"][0] == "item1");
-   assert(dyno1["somearray"][1] == "item2");
-   assert(dyno1["somearray"][2] == "item3");
-   assert("item1" == dyno1["somearray"][0]);
-   assert("item2" == dyno1["somearray"][1]);
-   assert("item3" == dyno1["somearray"][2]);
+      // grabbing lock again should work
+      assert(mLock->tryLock());
 
-   DynamicObject dyno3 = dyno1["address"];
-   assertStrCmp(dyno3["street"]->getString(), "1700 Kraft Dr.");
-   assertStrCmp(dyno3["zip"]->getString(), "24060");
+      // release lock
+      mLock->unlock();
 
-   DynamicObject dyno4;
-   dyno4["whatever"] = "test";
-   dyno4["someboolean"] = true;
-   assert(dyno4["someboolean"]->getBoolean());
-   dyno1["somearray"][3] = dyno4;
+      // grabbing lock again should work
+      assert(mLock->tryLock());
+      mLock->unlock();
+   }
+};
 
-   dyno1["something"]["strange"] = "tinypayload";
-   assertStrCmp(dyno1["something"]["strange"]->getString(), "tinypayload");
+class LockContentionRunnable : public Runnable
+{
+public:
+   ExclusiveLock* mLock;
+   Semaphore* mSemaphore;
+   uint32_t mIterations;
+   volatile uint32_t* mCounter;
+   LockContentionRunnable(
+      ExclusiveLock* lock, Semaphore* semaphore,
+      uint32_t iterations, volatile uint32_t* counter) :
+      mLock(lock), mSemaphore(semaphore),
+      mIterations(iterations), mCounter(counter) {}
+   virtual ~LockContentionRunnable() {}
 
-   DynamicObject dyno5;
-   dyno5[0] = "mustard";
-   dyno5[1] = "ketchup";
-   dyno5[2] = "pickles";
-
-   int count = 0;
-   DynamicObjectIterator i = dyno5.getIterator();
-   while(i->hasNext())
+   virtual void run()
    {
-      DynamicObject next = i->next();
-
-      if(count == 0)
-      {
-         assertStrCmp(next->getString(), "mustard");
-      }
-      else if(count == 1)
+      for(uint32_t i = 0; i < mIterations; ++i)
       {
-         assertStrCmp(next->getString(), "ketchup");
+         if(mSemaphore != NULL)
+         {
+            mSemaphore->acquire();
+            ++(*mCounter);
+            mSemaphore->release();
+         }
+         else
+         {
+            mLock->lock();
+            ++(*mCounter);
+            mLock->unlock();
+         }
       }
-      else if(count == 2)
+   }
+};
+
+class LockWaitRunnable : public Runnable
+{
+public:
+   ExclusiveLock* mLock;
+   volatile bool* mCondition;
+   volatile uint32_t* mWoken;
+   LockWaitRunnable(
+      ExclusiveLock* lock, volatile bool* condition, volatile uint32_t* woken) :
+      mLock(lock), mCondition(condition), mWoken(woken) {}
+   virtual ~LockWaitRunnable() {}
+
+   virtual void run()
+   {
+      mLock->lock();
+      while(!(*mCondition) && mLock->wait())
       {
-         assertStrCmp(next->getString(), "pickles");
       }
+      ++(*mWoken);
+      mLock->unlock();
+   }
+};
 
-      ++count;
+/**
+ * Runs threads that increment a counter while holding a lock or a semaphore
+ * permit.
+ *
+ * @param lock the lock to use.
+ * @param semaphore the semaphore to use instead of the lock, NULL for none.
+ * @param threads the number of threads.
+ * @param iterations the number of increments per thread.
+ *
+ * @return the number of milliseconds it took.
+ */
+static uint64_t _runLockContention(
+   ExclusiveLock* lock, Semaphore* semaphore,
+   uint32_t threads, uint32_t iterations)
+{
+   volatile uint32_t counter = 0;
+   LockContentionRunnable r(lock, semaphore, iterations, &counter);
+   Thread** t = new Thread*[threads];
+   uint64_t start = System::getCurrentMilliseconds();
+   for(uint32_t i = 0; i < threads; ++i)
+   {
+      t[i] = new Thread(&r);
+      t[i]->start();
+   }
+   for(uint32_t i = 0; i < threads; ++i)
+   {
+      t[i]->join();
+      delete t[i];
    }
+   delete [] t;
+   uint64_t dt = System::getCurrentMilliseconds() - start;
+   assert(counter == threads * iterations);
+   return dt;
+}
 
-   DynamicObject dyno6;
-   dyno6["eggs"] = "bacon";
-   dyno6["milk"] = "yum";
-   assertStrCmp(dyno6["milk"]->getString(), "yum");
-   dyno6->removeMember("milk");
-   assert(!dyno6->hasMember("milk"));
-   assert(dyno6->length() == 1);
-   count = 0;
-   i = dyno6.getIterator();
-   while(i->hasNext())
+static void runExclusiveLockTest(TestRunner& tr)
+{
+   tr.group("ExclusiveLock");
+
+   tr.test("try lock");
    {
-      DynamicObject& next = i->next();
-      assertStrCmp(i->getName(), "eggs");
-      assertStrCmp(next->getString(), "bacon");
-      ++count;
+      ExclusiveLock lock;
+      volatile bool condition = false;
+
+      ExclusiveLockRunnable r1(&lock, &condition);
+      Thread t1(&r1);
+
+      // grap lock
+      lock.lock();
+
+      // start thread, spin until it sets condition
+      t1.start();
+      while(!condition);
+      lock.unlock();
+
+      // join thread
+      t1.join();
+
+      assert(!condition);
    }
+   tr.passIfNoException();
 
-   assert(count == 1);
+   tr.test("adaptive try lock");
+   {
+      ExclusiveLock lock(true);
+#ifdef __linux__
+      assert(lock.isAdaptive());
+#endif
+      volatile bool condition = false;
 
-   // test clone
-   dyno1["dyno5"] = dyno5;
-   dyno1["dyno6"] = dyno6;
-   dyno1["clone"] = dyno1.clone();
+      ExclusiveLockRunnable r1(&lock, &condition);
+      Thread t1(&r1);
 
-   DynamicObject clone = dyno1.clone();
-   assert(dyno1 == clone);
+      // grap lock, recursively
+      lock.lock();
+      lock.lock();
+      lock.unlock();
 
-   // test subset
-   clone["mrmessy"] = "weirdguy";
-   assert(dyno1.isSubset(clone));
+      // start thread, spin until it sets condition
+      t1.start();
+      while(!condition);
+      lock.unlock();
 
-   // test print out code
-   //printf("\n");
-   //dumpDynamicObject(dyno1);
+      // join thread
+      t1.join();
+
+      assert(!condition);
+   }
+   tr.passIfNoException();
 
+   tr.test("adaptive contention");
    {
-      DynamicObject d;
-      d = "abc";
-      assert(d == "abc");
-      assert(d != "abd");
-      assert(d != "aba");
-      assert(d < "abd");
-      assert(d <= "abc");
-      assert(d <= "abd");
-      assert(d > "aba");
-      assert(d >= "abc");
-      assert(d >= "aba");
-      assert("abc" == d);
-      assert("abd" != d);
-      assert("aba" != d);
-      assert("abd" > d);
-      assert("abc" >= d);
-      assert("abd" >= d);
-      assert("aba" < d);
-      assert("abc" <= d);
-      assert("aba" <= d);
+      ExclusiveLock lock(true);
+      _runLockContention(&lock, NULL, 4, 10000);
    }
+   tr.passIfNoException();
 
+   tr.test("adaptive wait/notify");
    {
-      // test int iterator
-      DynamicObject d;
-      d = 123;
-      int count = 0;
-      DynamicObjectIterator i = d.getIterator();
-      while(i->hasNext())
-      {
-         DynamicObject& next = i->next();
-         assert(next->getUInt32() == 123);
-         ++count;
-      }
-      assert(count == 1);
+      ExclusiveLock lock(true);
+      volatile bool condition = false;
+      volatile uint32_t woken = 0;
+      LockWaitRunnable r(&lock, &condition, &woken);
+      Thread t1(&r);
+      Thread t2(&r);
+      t1.start();
+      t2.start();
+
+      // timed wait without a notify
+      lock.lock();
+      uint64_t start = System::getCurrentMilliseconds();
+      assert(lock.wait(50));
+      assert(System::getCurrentMilliseconds() - start >= 40);
+      lock.unlock();
+
+      // wake up both threads
+      lock.lock();
+      condition = true;
+      lock.notifyAll();
+      lock.unlock();
+      t1.join();
+      t2.join();
+      assert(woken == 2);
    }
+   tr.passIfNoException();
 
+   tr.test("adaptive wait interrupt");
    {
-      // test string iterator
-      DynamicObject d;
-      d = "123";
-      int count = 0;
-      DynamicObjectIterator i = d.getIterator();
-      while(i->hasNext())
-      {
-         DynamicObject& next = i->next();
-         assertStrCmp(next->getString(), "123");
-         ++count;
-      }
-      assert(count == 1);
+      ExclusiveLock lock(true);
+      volatile bool condition = false;
+      volatile uint32_t woken = 0;
+      LockWaitRunnable r(&lock, &condition, &woken);
+      Thread t(&r);
+      t.start();
+      Thread::sleep(50);
+      t.interrupt();
+      t.join();
+      assert(woken == 1);
+      assert(!condition);
    }
+   tr.passIfNoException();
 
+   tr.test("semaphore");
    {
-      // test auto-created string iterator
-      DynamicObject d;
-      int count = 0;
-      DynamicObjectIterator i = d["moo!"].getIterator();
-      while(i->hasNext())
-      {
-         DynamicObject& next = i->next();
-         assertStrCmp(next->getString(), "");
-         ++count;
-      }
-      assert(count == 1);
+      Semaphore s(2, true);
+      assert(s.tryAcquire());
+      assert(s.acquire());
+      assert(!s.tryAcquire());
+      assert(s.usedPermits() == 2);
+      assert(s.release(3) == 2);
+      assert(s.usedPermits() == 0);
+      s.setMaxPermitCount(1);
+      assert(s.usedPermits() == 0);
+      assert(!s.tryAcquire(2));
+      s.setMaxPermitCount(3);
+      assert(s.tryAcquire(3));
+      s.release(3);
    }
+   tr.passIfNoException();
 
+   tr.test("adaptive semaphore contention");
    {
-      // test name for null value
-      DynamicObject d;
-      d["a"].setNull();
-      int count = 0;
-      DynamicObjectIterator i = d.getIterator();
-      while(i->hasNext())
+      ExclusiveLock unused;
+      Semaphore s(1, true, true);
+      _runLockContention(&unused, &s, 4, 10000);
+      assert(s.usedPermits() == 0);
+   }
+   tr.passIfNoException();
+
+   tr.ungroup();
+}
+
+static void runLockContentionTest(TestRunner& tr)
+{
+   tr.group("ExclusiveLock contention");
+
+   const uint32_t iterations = 200000;
+   uint32_t threadCounts[] = { 1, 2, 4, 8, 16 };
+   for(int i = 0; i < 5; ++i)
+   {
+      uint32_t threads = threadCounts[i];
+      char name[32];
+      snprintf(name, 32, "%u threads", threads);
+      tr.test(name);
       {
-         DynamicObject& next = i->next();
-         const char* name = i->getName();
-         assertStrCmp(name, "a");
-         assert(next.isNull());
-         ++count;
+         ExclusiveLock blocking;
+         ExclusiveLock adaptive(true);
+         Semaphore blockingSemaphore(1, false);
+         Semaphore adaptiveSemaphore(1, false, true);
+         uint64_t dt1 = _runLockContention(
+            &blocking, NULL, threads, iterations / threads);
+         uint64_t dt2 = _runLockContention(
+            &adaptive, NULL, threads, iterations / threads);
+         uint64_t dt3 = _runLockContention(
+            &blocking, &blockingSemaphore, threads, iterations / threads);
+         uint64_t dt4 = _runLockContention(
+            &blocking, &adaptiveSemaphore, threads, iterations / threads);
+         printf("lock: %" PRIu64 " ms, adaptive: %" PRIu64 " ms, "
+            "semaphore: %" PRIu64 " ms, adaptive: %" PRIu64 " ms... ",
+            dt1, dt2, dt3, dt4);
       }
-      assert(count == 1);
+      tr.passIfNoException();
    }
 
+   tr.ungroup();
+}
+
+class SharedLockRunnable : public Runnable
+{
+public:
+   SharedLock* mLock;
+   int* mTotal;
+   bool mWrite;
+   int mNumber;
+
+   SharedLockRunnable(SharedLock* lock, int* total, bool write, int number)
    {
-      // test formatted string
-      DynamicObject d;
-      d->format("String %s, Integer %i", "mystring", 1);
-      assertStrCmp(d->getString(), "String mystring, Integer 1");
+      mLock = lock;
+      mTotal = total;
+      mWrite = write;
+      mNumber = number;
    }
 
+   virtual ~SharedLockRunnable()
    {
-      // test formatted string using current string
-      DynamicObject d;
-      d = "b";
-      d->format("a%sc", d->getString());
-      assertStrCmp(d->getString(), "abc");
    }
 
+   virtual void run()
    {
-      // test length types
-      {
-         DynamicObject d;
-         assert(d->length() == 0);
-      }
+      Thread::sleep(rand() % 10 + 1);
+
+      if(mWrite)
       {
-         DynamicObject d;
-         d->setType(String);
-         assert(d->length() == 0);
-         d = "123";
-         assert(d->length() == 3);
+         mLock->lockExclusive();
+         {
+            for(int i = 0; i < 1000; ++i)
+            {
+               *mTotal += mNumber;
+            }
+         }
+         mLock->unlockExclusive();
       }
+      else
       {
-         DynamicObject d;
-         d->setType(Map);
-         assert(d->length() == 0);
-         d["1"] = 1;
-         d["2"] = 2;
-         d["3"] = 3;
-         assert(d->length() == 3);
-      }
-      {
-         DynamicObject d;
-         d->setType(Array);
-         assert(d->length() == 0);
-         d[0] = 1;
-         d[1] = 2;
-         d[2] = 3;
-         assert(d->length() == 3);
+         mLock->lockShared();
+         {
+            int total = *mTotal;
+            assert(
+               total == 0 || total == 2000 ||
+               total == 3000 || total == 5000);
+
+            mLock->lockShared();
+            {
+               assert(
+                  total == 0 || total == 2000 ||
+                  total == 3000 || total == 5000);
+
+               mLock->lockShared();
+               {
+                  assert(
+                     total == 0 || total == 2000 ||
+                     total == 3000 || total == 5000);
+               }
+               mLock->unlockShared();
+            }
+            mLock->unlockShared();
+         }
+         mLock->unlockShared();
       }
+   }
+};
+
+class DeadlockRunnable : public Runnable
+{
+public:
+   SharedLock* mLock;
+   ExclusiveLock* mSignalLock;
+   bool* mSignal;
+   bool mWrite;
+
+   DeadlockRunnable(
+      SharedLock* lock, ExclusiveLock* signalLock, bool* signal, bool write) :
+      mLock(lock),
+      mSignalLock(signalLock),
+      mSignal(signal),
+      mWrite(write)
+   {
+   }
+
+   virtual ~DeadlockRunnable()
+   {
+   }
+
+   virtual void run()
+   {
+      if(mWrite)
       {
-         DynamicObject d;
-         d->setType(Array);
-         assert(d->length() == 0);
-         d->append(1);
-         d->append(2);
-         d->append(3);
-         assert(d->length() == 3);
+         // wait for signal to get exclusive lock
+         mSignalLock->lock();
+         while(!(*mSignal))
+         {
+            mSignalLock->wait();
+         }
+         mSignalLock->unlock();
+
+         // get exclusive lock
+         mLock->lockExclusive();
+
+         // should block forever if test fails
+
+         mLock->unlockExclusive();
       }
+      else
       {
-         DynamicObject d;
-         d->setType(Boolean);
-         assert(d->length() == 1);
+         // get shared lock
+         mLock->lockShared();
+         {
+            // set signal
+            mSignalLock->lock();
+            *mSignal = true;
+            mSignalLock->notifyAll();
+            mSignalLock->unlock();
+
+            // wait to allow lock exclusive to occur in write thread
+            Thread::sleep(250);
+
+            // try to get shared lock
+            mLock->lockShared();
+
+            // should block here for ever if test fails
+
+            // recursive unlock shared lock
+            mLock->unlockShared();
+         }
+         mLock->unlockShared();
       }
+   }
+};
+
+static void _runSharedLockDeadlockTest(bool bigReader)
+{
+   // this test checks to see if thread 1 can get a read lock,
+   // wait for thread 2 to get a write lock, and then see if
+   // thread 1 can recurse its read lock (it should be able to)
+
+   SharedLock lock(bigReader);
+   ExclusiveLock signalLock;
+   bool signal = false;
+
+   DeadlockRunnable r1(&lock, &signalLock, &signal, false);
+   DeadlockRunnable r2(&lock, &signalLock, &signal, true);
+
+   Thread t1(&r1);
+   Thread t2(&r2);
+
+   t2.start();
+   t1.start();
+
+   t1.join();
+   t2.join();
+}
+
+static void _runSharedLockReadWriteTest(bool bigReader)
+{
+   uint64_t start = System::getCurrentMilliseconds();
+   for(int i = 0; i < 200; ++i)
+   {
+      SharedLock lock(bigReader);
+      int total = 0;
+
+      SharedLockRunnable r1(&lock, &total, false, 0);
+      SharedLockRunnable r2(&lock, &total, true, 2);
+      SharedLockRunnable r3(&lock, &total, false, 0);
+      SharedLockRunnable r4(&lock, &total, true, 3);
+      SharedLockRunnable r5(&lock, &total, false, 0);
+
+      Thread t1(&r1);
+      Thread t2(&r2);
+      Thread t3(&r3);
+      Thread t4(&r4);
+      Thread t5(&r5);
+
+      t1.start();
+      t2.start();
+      t3.start();
+      t4.start();
+      t5.start();
+
+      lock.lockShared();
+      assert(total == 0 || total == 2000 || total == 3000 || total == 5000);
+      lock.unlockShared();
+
+      lock.lockExclusive();
+      lock.lockShared();
+      assert(total == 0 || total == 2000 || total == 3000 || total == 5000);
+      lock.unlockShared();
+      lock.unlockExclusive();
+
+      lock.lockShared();
+      assert(total == 0 || total == 2000 || total == 3000 || total == 5000);
+      lock.unlockShared();
+
+      lock.lockShared();
+      assert(total == 0 || total == 2000 || total == 3000 || total == 5000);
+      lock.unlockShared();
+
+      t1.join();
+      t2.join();
+      t3.join();
+      t4.join();
+      t5.join();
+
+      lock.lockShared();
+      assert(total == 5000);
+      lock.unlockShared();
+   }
+   uint64_t end = System::getCurrentMilliseconds();
+   double secs = (end - start) / 1000.;
+   printf("time=%.2f secs... ", secs);
+}
+
+static void runSharedLockTest(TestRunner& tr)
+{
+   tr.group("SharedLock");
+
+   tr.test("simple read/write");
+   {
+      _runSharedLockReadWriteTest(false);
+   }
+   tr.passIfNoException();
+
+   tr.test("recursive read+write+read");
+   {
+      _runSharedLockDeadlockTest(false);
+   }
+   tr.passIfNoException();
+
+   tr.test("big reader simple read/write");
+   {
+      _runSharedLockReadWriteTest(true);
+   }
+   tr.passIfNoException();
+
+   tr.test("big reader recursive read+write+read");
+   {
+      _runSharedLockDeadlockTest(true);
+   }
+   tr.passIfNoException();
+
+   tr.test("big reader exclusive recursion");
+   {
+      SharedLock lock(true);
+#ifndef WIN32
+#ifndef MACOS
+      assert(lock.isBigReader());
+#endif
+#endif
+      lock.lockExclusive();
+      lock.lockExclusive();
+      lock.lockShared();
+      lock.unlockShared();
+      lock.unlockExclusive();
+      lock.unlockExclusive();
+
+      // the lock must be free for both readers and writers again
+      lock.lockShared();
+      lock.lockShared();
+      lock.unlockShared();
+      lock.unlockShared();
+      lock.lockExclusive();
+      lock.unlockExclusive();
+   }
+   tr.passIfNoException();
+
+   tr.ungroup();
+}
+
+class SharedLockReader : public Runnable
+{
+public:
+   SharedLock* mLock;
+   volatile bool* mStop;
+   bool mWriter;
+   uint64_t mCount;
+   SharedLockReader(SharedLock* lock, volatile bool* stop, bool writer) :
+      mLock(lock), mStop(stop), mWriter(writer), mCount(0) {}
+   virtual ~SharedLockReader() {}
+
+   virtual void run()
+   {
+      while(!(*mStop))
       {
-         DynamicObject d;
-         d->setType(Int32);
-         assert(d->length() == sizeof(int32_t));
+         if(mWriter)
+         {
+            // the rare writer
+            Thread::sleep(1);
+            mLock->lockExclusive();
+            ++mCount;
+            mLock->unlockExclusive();
+         }
+         else
+         {
+            for(int i = 0; i < 100; ++i)
+            {
+               mLock->lockShared();
+               ++mCount;
+               mLock->unlockShared();
+            }
+         }
       }
+   }
+};
+
+/**
+ * Runs reader threads on a SharedLock for a while, along with a writer
+ * thread that tries to take an exclusive lock every millisecond.
+ *
+ * @param lock the lock to use.
+ * @param threads the number of reader threads.
+ * @param ms the number of milliseconds to run for.
+ * @param writes to store the number of exclusive locks taken.
+ *
+ * @return the number of shared locks per millisecond.
+ */
+static uint64_t _runSharedLockThroughput(
+   SharedLock* lock, uint32_t threads, uint32_t ms, uint64_t& writes)
+{
+   volatile bool stop = false;
+   SharedLockReader** readers = new SharedLockReader*[threads + 1];
+   Thread** t = new Thread*[threads + 1];
+   uint64_t start = System::getCurrentMilliseconds();
+   for(uint32_t i = 0; i <= threads; ++i)
+   {
+      readers[i] = new SharedLockReader(lock, &stop, i == threads);
+      t[i] = new Thread(readers[i]);
+      t[i]->start();
+   }
+   Thread::sleep(ms);
+   stop = true;
+   uint64_t dt = System::getCurrentMilliseconds() - start;
+
+   uint64_t reads = 0;
+   for(uint32_t i = 0; i <= threads; ++i)
+   {
+      t[i]->join();
+      if(i < threads)
       {
-         DynamicObject d;
-         d->setType(UInt32);
-         assert(d->length() == sizeof(uint32_t));
+         reads += readers[i]->mCount;
       }
+      else
       {
-         DynamicObject d;
-         d->setType(Int64);
-         assert(d->length() == sizeof(int64_t));
+         writes = readers[i]->mCount;
       }
+      delete t[i];
+      delete readers[i];
+   }
+   delete [] t;
+   delete [] readers;
+
+   return reads / dt;
+}
+
+static void runSharedLockThroughputTest(TestRunner& tr)
+{
+   tr.group("SharedLock read throughput");
+
+   for(uint32_t threads = 1; threads <= 64; threads *= 2)
+   {
+      char name[32];
+      snprintf(name, 32, "%u threads", threads);
+      tr.test(name);
       {
-         DynamicObject d;
-         d->setType(UInt64);
-         assert(d->length() == sizeof(uint64_t));
+         SharedLock lock;
+         SharedLock bigReader(true);
+         uint64_t writes1;
+         uint64_t writes2;
+         uint64_t reads1 = _runSharedLockThroughput(
+            &lock, threads, 500, writes1);
+         uint64_t reads2 = _runSharedLockThroughput(
+            &bigReader, threads, 500, writes2);
+         printf("rwlock: %" PRIu64 " reads/ms (%" PRIu64 " writes), "
+            "big reader: %" PRIu64 " reads/ms (%" PRIu64 " writes)... ",
+            reads1, writes1, reads2, writes2);
       }
+      tr.passIfNoException();
+   }
+
+   tr.ungroup();
+}
+
+struct StarvationData
+{
+   SharedLock lock;
+   ExclusiveLock protect;
+   bool signal;
+   bool write;
+   bool reader;
+   int count;
+   int maxReaders;
+   int maxWriters;
+};
+
+class StarvationRunnable : public Runnable
+{
+public:
+   StarvationData* mStarvationData;
+   bool mWriter;
+
+   StarvationRunnable(StarvationData* sd, bool writer) :
+      mStarvationData(sd),
+      mWriter(writer)
+   {
+   }
+
+   virtual ~StarvationRunnable()
+   {
+   }
+
+   virtual void run()
+   {
+      // wait for signal to start
+      mStarvationData->protect.lock();
+      while(!mStarvationData->signal)
+      {
+         mStarvationData->protect.wait();
+      }
+      mStarvationData->protect.unlock();
+
+      Thread::sleep(rand() % 10 + 1);
+
+      if(mWriter)
+      {
+         mStarvationData->lock.lockExclusive();
+         {
+            if(mStarvationData->reader)
+            {
+               mStarvationData->maxReaders = mStarvationData->count;
+               mStarvationData->count = 1;
+               mStarvationData->reader = false;
+            }
+            else
+            {
+               ++mStarvationData->count;
+            }
+         }
+         mStarvationData->lock.unlockExclusive();
+      }
+      else
+      {
+         mStarvationData->lock.lockShared();
+         {
+            if(!mStarvationData->reader)
+            {
+               mStarvationData->maxWriters = mStarvationData->count;
+               mStarvationData->count = 1;
+               mStarvationData->reader = true;
+            }
+            else
+            {
+               ++mStarvationData->count;
+            }
+         }
+         mStarvationData->lock.unlockShared();
+      }
+   }
+};
+
+static void runInteractiveSharedLockTest(TestRunner& tr)
+{
+   tr.group("SharedLock");
+
+   tr.test("recursive read+write+read");
+   {
+      _runSharedLockDeadlockTest(false);
+   }
+   tr.passIfNoException();
+
+   tr.test("starvation");
+   {
+      // this test checks to ensure that neither readers
+      // nor writers starve each other out
+      for(int i = 0; i < 200; ++i)
+      {
+         StarvationData sd;
+         sd.signal = false;
+         sd.reader = false;
+         sd.count = 0;
+         sd.maxReaders = 0;
+         sd.maxWriters = 0;
+
+         int num = 50;
+         Thread* threads[(num * 2)];
+
+         // create readers
+         for(int n = 0; n < num; ++n)
+         {
+            RunnableRef r = new StarvationRunnable(&sd, false);
+            threads[n] = new Thread(r);
+         }
+
+         // create writers
+         for(int n = 0; n < num; ++n)
+         {
+            RunnableRef r = new StarvationRunnable(&sd, true);
+            threads[n + num] = new Thread(r);
+         }
+
+         // start threads
+         for(int n = 0; n < (num * 2); ++n)
+         {
+            threads[n]->start();
+         }
+
+         // set signal to start
+         sd.protect.lock();
+         sd.signal = true;
+         sd.protect.notifyAll();
+         sd.protect.unlock();
+
+         // join threads
+         for(int n = 0; n < (num * 2); ++n)
+         {
+            threads[n]->join();
+            delete threads[n];
+         }
+
+         // report max counts
+         printf(
+            "max consecutive readers: %i, "
+            "max consecutive writers: %i... \n",
+            sd.maxReaders, sd.maxWriters);
+      }
+   }
+   tr.passIfNoException();
+
+   tr.ungroup();
+}
+
+/**
+ * An object that stores its own reference count.
+ */
+class IntrusiveCounted : public CollectableObject<IntrusiveCounted>
+{
+public:
+   static int sDeleted;
+   virtual ~IntrusiveCounted()
+   {
+      ++sDeleted;
+   }
+};
+int IntrusiveCounted::sDeleted = 0;
+
+static void runCollectableTest(TestRunner& tr)
+{
+   tr.group("Collectable");
+
+   tr.test("basic");
+   {
+      Collectable<int> c = new int(10);
+   }
+   tr.passIfNoException();
+
+   tr.test("relinquish");
+   {
+      Collectable<int> c = new int(10);
+      int* foo = c.relinquish();
+      delete foo;
+   }
+   tr.passIfNoException();
+
+   tr.test("make");
+   {
+      Collectable<string> c = Collectable<string>::make(5, 'x');
+      Collectable<string> copy = c;
+      assertStrCmp(c->c_str(), "xxxxx");
+      assert(copy == c);
+      copy.setNull();
+      assert(c->length() == 5);
+
+      DynamicObject d;
+      DynamicObject d2 = d;
+      d = 1;
+      assert(d2->getInt32() == 1);
+   }
+   tr.passIfNoException();
+
+   tr.test("intrusive");
+   {
+      IntrusiveCounted* obj = new IntrusiveCounted();
+      {
+         Collectable<IntrusiveCounted> c1 = obj;
+         assert(obj->count == 1);
+
+         // wrapping the raw pointer again shares the same count
+         Collectable<IntrusiveCounted> c2 = obj;
+         assert(obj->count == 2);
+         assert(c1 == c2);
+
+         // copies do not copy the count
+         IntrusiveCounted copy(*obj);
+         assert(copy.count == 0);
+      }
+      // the copy and the original have been deleted
+      assert(IntrusiveCounted::sDeleted == 2);
+   }
+   tr.passIfNoException();
+
+   tr.ungroup();
+}
+
+static void runDynamicObjectTest(TestRunner& tr)
+{
+   tr.test("DynamicObject");
+
+   DynamicObject dyno1;
+   dyno1["id"] = 2;
+   dyno1["username"] = "testuser1000";
+   dyno1["somearray"][0] = "item1";
+   dyno1["somearray"][1] = "item2";
+   dyno1["somearray"][2] = "item3";
+
+   DynamicObject dyno2;
+   dyno2["street"] = "1700 Kraft Dr.";
+   dyno2["zip"] = "24060";
+
+   dyno1["address"] = dyno2;
+
+   assert(dyno1["id"]->getInt32() == 2);
+   assertStrCmp(dyno1["username"]->getString(), "testuser1000");
+   assert(dyno1["username"] == "testuser1000");
+   assert("testuser1000" == dyno1["username"]);
+
+   assertStrCmp(dyno1["somearray"][0]->getString(), "item1");
+   assertStrCmp(dyno1["somearray"][1]->getString(), "item2");
+   assertStrCmp(dyno1["somearray"][2]->getString(), "item3");
+   assert(dyno1["somearray"][0] == "item1");
+   assert(dyno1["somearray"][1] == "item2");
+   assert(dyno1["somearray"][2] == "item3");
+   assert("item1" == dyno1["somearray"][0]);
+   assert("item2" == dyno1["somearray"][1]);
+   assert("item3" == dyno1["somearray"][2]);
+
+   DynamicObject dyno3 = dyno1["address"];
+   assertStrCmp(dyno3["street"]->getString(), "1700 Kraft Dr.");
+   assertStrCmp(dyno3["zip"]->getString(), "24060");
+
+   DynamicObject dyno4;
+   dyno4["whatever"] = "test";
+   dyno4["someboolean"] = true;
+   assert(dyno4["someboolean"]->getBoolean());
+   dyno1["somearray"][3] = dyno4;
+
+   dyno1["something"]["strange"] = "tinypayload";
+   assertStrCmp(dyno1["something"]["strange"]->getString(), "tinypayload");
+
+   DynamicObject dyno5;
+   dyno5[0] = "mustard";
+   dyno5[1] = "ketchup";
+   dyno5[2] = "pickles";
+
+   int count = 0;
+   DynamicObjectIterator i = dyno5.getIterator();
+   while(i->hasNext())
+   {
+      DynamicObject next = i->next();
+
+      if(count == 0)
+      {
+         assertStrCmp(next->getString(), "mustard");
+      }
+      else if(count == 1)
+      {
+         assertStrCmp(next->getString(), "ketchup");
+      }
+      else if(count == 2)
+      {
+         assertStrCmp(next->getString(), "pickles");
+      }
+
+      ++count;
+   }
+
+   DynamicObject dyno6;
+   dyno6["eggs"] = "bacon";
+   dyno6["milk"] = "yum";
+   assertStrCmp(dyno6["milk"]->getString(), "yum");
+   dyno6->removeMember("milk");
+   assert(!dyno6->hasMember("milk"));
+   assert(dyno6->length() == 1);
+   count = 0;
+   i = dyno6.getIterator();
+   while(i->hasNext())
+   {
+      DynamicObject& next = i->next();
+      assertStrCmp(i->getName(), "eggs");
+      assertStrCmp(next->getString(), "bacon");
+      ++count;
+   }
+
+   assert(count == 1);
+
+   // test clone
+   dyno1["dyno5"] = dyno5;
+   dyno1["dyno6"] = dyno6;
+   dyno1["clone"] = dyno1.clone();
+
+   DynamicObject clone = dyno1.clone();
+   assert(dyno1 == clone);
+
+   // test subset
+   clone["mrmessy"] = "weirdguy";
+   assert(dyno1.isSubset(clone));
+
+   // test print out code
+   //printf("\n");
+   //dumpDynamicObject(dyno1);
+
+   {
+      DynamicObject d;
+      d = "abc";
+      assert(d == "abc");
+      assert(d != "abd");
+      assert(d != "aba");
+      assert(d < "abd");
+      assert(d <= "abc");
+      assert(d <= "abd");
+      assert(d > "aba");
+      assert(d >= "abc");
+      assert(d >= "aba");
+      assert("abc" == d);
+      assert("abd" != d);
+      assert("aba" != d);
+      assert("abd" > d);
+      assert("abc" >= d);
+      assert("abd" >= d);
+      assert("aba" < d);
+      assert("abc" <= d);
+      assert("aba" <= d);
+   }
+
+   {
+      // test int iterator
+      DynamicObject d;
+      d = 123;
+      int count = 0;
+      DynamicObjectIterator i = d.getIterator();
+      while(i->hasNext())
+      {
+         DynamicObject& next = i->next();
+         assert(next->getUInt32() == 123);
+         ++count;
+      }
+      assert(count == 1);
+   }
+
+   {
+      // test string iterator
+      DynamicObject d;
+      d = "123";
+      int count = 0;
+      DynamicObjectIterator i = d.getIterator();
+      while(i->hasNext())
+      {
+         DynamicObject& next = i->next();
+         assertStrCmp(next->getString(), "123");
+         ++count;
+      }
+      assert(count == 1);
+   }
+
+   {
+      // test auto-created string iterator
+      DynamicObject d;
+      int count = 0;
+      DynamicObjectIterator i = d["moo!"].getIterator();
+      while(i->hasNext())
+      {
+         DynamicObject& next = i->next();
+         assertStrCmp(next->getString(), "");
+         ++count;
+      }
+      assert(count == 1);
+   }
+
+   {
+      // test name for null value
+      DynamicObject d;
+      d["a"].setNull();
+      int count = 0;
+      DynamicObjectIterator i = d.getIterator();
+      while(i->hasNext())
+      {
+         DynamicObject& next = i->next();
+         const char* name = i->getName();
+         assertStrCmp(name, "a");
+         assert(next.isNull());
+         ++count;
+      }
+      assert(count == 1);
+   }
+
+   {
+      // test formatted string
+      DynamicObject d;
+      d->format("String %s, Integer %i", "mystring", 1);
+      assertStrCmp(d->getString(), "String mystring, Integer 1");
+   }
+
+   {
+      // test formatted string using current string
+      DynamicObject d;
+      d = "b";
+      d->format("a%sc", d->getString());
+      assertStrCmp(d->getString(), "abc");
+   }
+
+   {
+      // test length types
+      {
+         DynamicObject d;
+         assert(d->length() == 0);
+      }
+      {
+         DynamicObject d;
+         d->setType(String);
+         assert(d->length() == 0);
+         d = "123";
+         assert(d->length() == 3);
+      }
+      {
+         DynamicObject d;
+         d->setType(Map);
+         assert(d->length() == 0);
+         d["1"] = 1;
+         d["2"] = 2;
+         d["3"] = 3;
+         assert(d->length() == 3);
+      }
+      {
+         DynamicObject d;
+         d->setType(Array);
+         assert(d->length() == 0);
+         d[0] = 1;
+         d[1] = 2;
+         d[2] = 3;
+         assert(d->length() == 3);
+      }
+      {
+         DynamicObject d;
+         d->setType(Array);
+         assert(d->length() == 0);
+         d->append(1);
+         d->append(2);
+         d->append(3);
+         assert(d->length() == 3);
+      }
+      {
+         DynamicObject d;
+         d->setType(Boolean);
+         assert(d->length() == 1);
+      }
+      {
+         DynamicObject d;
+         d->setType(Int32);
+         assert(d->length() == sizeof(int32_t));
+      }
+      {
+         DynamicObject d;
+         d->setType(UInt32);
+         assert(d->length() == sizeof(uint32_t));
+      }
+      {
+         DynamicObject d;
+         d->setType(Int64);
+         assert(d->length() == sizeof(int64_t));
+      }
+      {
+         DynamicObject d;
+         d->setType(UInt64);
+         assert(d->length() == sizeof(uint64_t));
+      }
+      {
+         DynamicObject d;
+         d->setType(Double);
+         assert(d->length() == sizeof(double));
+      }
+   }
+
+   {
+      // test '==' and '<' compare of null strings
+      DynamicObject d1;
+      d1->setType(String);
+      DynamicObject d2;
+      d2->setType(String);
+      assert(d1 == d2);
+      d2 = "x";
+      assert(d1 < d2);
+   }
+
+   {
+      DynamicObject dArray;
+      DynamicObject d1;
+      d1 = "first";
+      DynamicObject d2;
+      d2 = "second";
+      DynamicObject d3;
+      d3 = "third";
+      dArray[0] = d1;
+      dArray[1] = d2;
+      dArray[2] = d3;
+
+      DynamicObject d4;
+      d4 = "second";
+      //printf("index=%i\n", dArray->getIndex(d4));
+      assert(dArray->indexOf(d4) == 1);
+
+      DynamicObject d5;
+      d5 = "fourth";
+      assert(dArray->indexOf(d5) == -1);
+   }
+
+   {
+      DynamicObject d;
+      d->append("bar");
+      d->append("baz");
+      d->append(1);
+      d->append(true);
+
+      int i;
+      i = d->indexOf("bar");
+      assert(i == 0);
+      i = d->indexOf("baz");
+      assert(i == 1);
+      i = d->indexOf(1);
+      assert(i == 2);
+      i = d->indexOf(true);
+      assert(i == 3);
+      i = d->indexOf(false);
+      assert(i == -1);
+      i = d->indexOf("bank");
+      assert(i == -1);
+   }
+
+   {
+      DynamicObject d;
+      d->append(1);
+      d->append(2);
+      d->append(3);
+      d->removeIndex(0);
+
+      DynamicObject expect;
+      expect->append(2);
+      expect->append(3);
+      assertDynoCmp(expect, d);
+   }
+
+   {
+      DynamicObject d;
+      d->append(1);
+      d->append(2);
+      d->append(3);
+      d->removeIndex(0);
+      d->removeIndex(1);
+
+      DynamicObject expect;
+      expect->append(2);
+      assertDynoCmp(expect, d);
+   }
+
+   {
+      DynamicObject d;
+      d->append(1);
+      d->append(2);
+      d->append(3);
+      d->removeIndex(-1);
+
+      DynamicObject expect;
+      expect->append(1);
+      expect->append(2);
+      assertDynoCmp(expect, d);
+   }
+
+   {
+      DynamicObject d;
+      d->append(1);
+      d->append(2);
+      d->append(3);
+      d->removeIndex(-2);
+
+      DynamicObject expect;
+      expect->append(1);
+      expect->append(3);
+      assertDynoCmp(expect, d);
+   }
+
+   {
+      DynamicObject d;
+      d->append(1);
+      d->append(2);
+      d->append(3);
+      d->removeIndex(-3);
+
+      DynamicObject expect;
+      expect->append(2);
+      expect->append(3);
+      assertDynoCmp(expect, d);
+   }
+
+   {
+      DynamicObject d;
+      d->append(1);
+      d->append(2);
+      d->append(3);
+      d->removeIndex(-4);
+
+      DynamicObject expect;
+      expect->append(1);
+      expect->append(2);
+      expect->append(3);
+      assertDynoCmp(expect, d);
+   }
+
+   {
+      DynamicObject d;
+      d->append(1);
+      d->append(2);
+      d->append(3);
+      d->removeIndex(3);
+
+      DynamicObject expect;
+      expect->append(1);
+      expect->append(2);
+      expect->append(3);
+      assertDynoCmp(expect, d);
+   }
+
+   {
+      DynamicObject d;
+      d = 1;
+      d.push(2);
+
+      DynamicObject expect;
+      expect->append(1);
+      expect->append(2);
+      assertDynoCmp(expect, d);
+   }
+
+   {
+      DynamicObject d;
+      d.push(1);
+      d.push(2);
+
+      DynamicObject expect;
+      expect->append(1);
+      expect->append(2);
+      assertDynoCmp(expect, d);
+   }
+
+   {
+      // test compare cloned object
+      DynamicObject d1;
+      d1["map"]["key"] = "value";
+      DynamicObject d2 = d1.clone();
+      assert(d1 == d2);
+      assert(!(d1 < d2));
+   }
+
+   {
+      // test same object as map key
+      DynamicObject d1;
+      d1["map"]["key"] = "value";
+      DynamicObject d2;
+      d2["map"]["key"] = "value";
+      assert(d1 == d2);
+      assert(!(d1 < d2));
+
+      std::map<DynamicObject, int> maptest;
+      maptest.insert(make_pair(d1, 1));
+      maptest.insert(make_pair(d2, 1));
+      assert(maptest.size() == 1);
+   }
+
+   {
+      // test '<' for arrays
+      DynamicObject d1;
+      d1->setType(Array);
+      DynamicObject d2;
+      d2->setType(Array);
+
+      d1[0] = 0;
+      d1[1] = 1;
+
+      d2[0] = 0;
+      d2[1] = 2;
+
+      assert(!(d1 == d2));
+      assert(d1 < d2);
+   }
+
+   {
+      // test for string equality
+      DynamicObject d1;
+      d1 = "foo";
+      assert(d1 == "foo");
+      assert(d1 != "bar");
+
+      DynamicObject d2;
+      d2 = 1;
+      assert(!(d1 == "1"));
+      assert(d1 != "1");
+   }
+
+   {
+      // test positive index array expansion
+      DynamicObject d;
+      d->setType(Array);
+      assert(d->length() == 0);
+      d[1] = 1;
+      assert(d->length() == 2);
+      d[1];
+      assert(d->length() == 2);
+   }
+
+   {
+      // test negative index array expansion
+      DynamicObject d;
+      d->setType(Array);
+      assert(d->length() == 0);
+      d[-1] = 1;
+      assert(d->length() == 1);
+   }
+
+   {
+      // test pop
+      DynamicObject d;
+      d->setType(Array);
+      assert(d->length() == 0);
+      d->append();
+      assert(d->length() == 1);
+      d->pop();
+      assert(d->length() == 0);
+      // pop on empty array a no-op
+      d->pop();
+      assert(d->length() == 0);
+   }
+
+   tr.pass();
+}
+
+static void runDynoClearTest(TestRunner& tr)
+{
+   tr.test("DynamicObject clear");
+
+   DynamicObject d;
+
+   d = "x";
+   assert(d->getType() == String);
+   d->clear();
+   assert(d->getType() == String);
+   assertStrCmp(d->getString(), "");
+
+   d = (int)1;
+   assert(d->getType() == Int32);
+   d->clear();
+   assert(d->getType() == Int32);
+   assert(d->getInt32() == 0);
+
+   d = (unsigned int)1;
+   assert(d->getType() == UInt32);
+   d->clear();
+   assert(d->getType() == UInt32);
+   assert(d->getBoolean() == false);
+
+   d = (int64_t)1;
+   assert(d->getType() == Int64);
+   d->clear();
+   assert(d->getType() == Int64);
+   assert(d->getInt64() == 0);
+
+   d = (uint64_t)1;
+   d->clear();
+   assert(d->getType() == UInt64);
+   assert(d->getUInt64() == 0);
+
+   d = (double)1.0;
+   d->clear();
+   assert(d->getType() == Double);
+   assert(d->getDouble() == 0.0);
+
+   d["x"] = 0;
+   d->clear();
+   assert(d->getType() == Map);
+   assert(d->length() == 0);
+
+   d[0] = 0;
+   d->clear();
+   assert(d->getType() == Array);
+   assert(d->length() == 0);
+
+   tr.passIfNoException();
+}
+
+static void runDynoConversionTest(TestRunner& tr)
+{
+   tr.test("DynamicObject conversion");
+
+   DynamicObject d;
+   d["int"] = 2;
+   d["-int"] = -2;
+   d["str"] = "hello";
+   d["true"] = "true";
+   d["false"] = "false";
+
+   const char* s;
+   s = d["int"]->getString();
+   assertStrCmp(s, "2");
+
+   s = d["-int"]->getString();
+   assertStrCmp(s, "-2");
+
+   s = d["str"]->getString();
+   assertStrCmp(s, "hello");
+
+   s = d["true"]->getString();
+   assertStrCmp(s, "true");
+
+   s = d["false"]->getString();
+   assertStrCmp(s, "false");
+
+   tr.pass();
+}
+
+static void runDynoCastTest(TestRunner& tr)
+{
+   tr.test("DynamicObject casting");
+
+   {
+      DynamicObject d;
+      bool v;
+
+      d = true;
+      v = d;
+      assert(v == d->getBoolean());
+
+      d = false;
+      v = d;
+      assert(v == d->getBoolean());
+   }
+
+   {
+      DynamicObject d;
+      const char* t = "test";
+      const char* v;
+
+      d = t;
+      v = d;
+      // check pointers are different
+      assert(v != t);
+      assertStrCmp(v, d->getString());
+      assertStrCmp(v, t);
+   }
+
+   {
+      DynamicObject d;
+      char* t = (char*)malloc(10);
+      strcpy(t, "value");
+
+      d["x"] = t;
+      assertStrCmp(d["x"]->getString(), t);
+      free(t);
+   }
+
+   {
+      DynamicObject d;
+      // const vals
+      const char* cn = "cn";
+      const char* cv = "cv";
+      // array vals
+      char an[10];
+      strcpy(an, "an");
+      char av[10];
+      strcpy(av, "av");
+
+      d[cn] = cv;
+      assertStrCmp(d[cn]->getString(), cv);
+      d[cn] = av;
+      assertStrCmp(d[cn]->getString(), av);
+      d[an] = cv;
+      assertStrCmp(d[an]->getString(), cv);
+      d[an] = av;
+      assertStrCmp(d[an]->getString(), av);
+   }
+
+   {
+      DynamicObject d;
+      uint32_t t = 123;
+      uint32_t v;
+
+      d = t;
+      v = d;
+      assert(d->getUInt32() == t);
+      assert(v == t);
+   }
+
+   {
+      // lval and rval
+
+      DynamicObject d;
+      uint32_t t = 123;
+
+      d = t;
+      assert(d->getUInt32() == t);
+      assert(t == d->getUInt32());
+      // do need to cast here to avoid ambiguous comparison errors
+      assert((uint32_t)d == t);
+      assert(t == (uint32_t)d);
+   }
+
+   tr.pass();
+}
+
+static void runDynoRemoveTest(TestRunner& tr)
+{
+   tr.group("DynamicObject remove");
+
+   tr.test("array of 1");
+   {
+      DynamicObject d1;
+      d1[0] = 0;
+
+      DynamicObject d2;
+      d2->setType(Array);
+
+      DynamicObjectIterator i = d1.getIterator();
+      assert(i->hasNext());
+      i->next();
+      i->remove();
+      assert(!i->hasNext());
+      assertDynoCmp(d1, d2);
+   }
+   tr.passIfNoException();
+
+   tr.test("array");
+   {
+      DynamicObject d1;
+      d1[0] = 0;
+      d1[1] = 1;
+      d1[2] = 2;
+
+      DynamicObject d2;
+      d2[0] = 0;
+      d2[1] = 2;
+
+      int count = 0;
+      DynamicObjectIterator i = d1.getIterator();
+      while(i->hasNext())
+      {
+         DynamicObject& next = i->next();
+
+         if(count == 1)
+         {
+            assert(next->getUInt32() == 1);
+            i->remove();
+         }
+
+         ++count;
+      }
+
+      assertDynoCmp(d1, d2);
+   }
+   tr.passIfNoException();
+
+   tr.test("map of 1");
+   {
+      DynamicObject d1;
+      d1["0"] = 0;
+
+      DynamicObject d2;
+      d2->setType(Map);
+
+      DynamicObjectIterator i = d1.getIterator();
+      assert(i->hasNext());
+      i->next();
+      i->remove();
+      assert(!i->hasNext());
+      assertDynoCmp(d1, d2);
+   }
+   tr.passIfNoException();
+
+   tr.test("map of 2");
+   {
+      DynamicObject d1;
+      d1["0"] = 0;
+      d1["1"] = 0;
+
+      DynamicObject d2;
+      d2["0"] = 0;
+
+      DynamicObjectIterator i = d1.getIterator();
+      assert(i->hasNext());
+      i->next();
+      assert(i->hasNext());
+      i->next();
+      assert(!i->hasNext());
+      i->remove();
+      assert(!i->hasNext());
+      assertDynoCmp(d1, d2);
+   }
+   tr.passIfNoException();
+
+   tr.test("map");
+   {
+      DynamicObject d1;
+      d1["0"] = 0;
+      d1["1"] = 1;
+      d1["2"] = 2;
+
+      DynamicObject d2;
+      d2["0"] = 0;
+      d2["2"] = 2;
+
+      int count = 0;
+      DynamicObjectIterator i = d1.getIterator();
+      while(i->hasNext())
+      {
+         DynamicObject& next = i->next();
+
+         if(count == 1)
+         {
+            assert(next->getUInt32() == 1);
+            i->remove();
+         }
+
+         ++count;
+      }
+
+      assertDynoCmp(d1, d2);
+   }
+   tr.passIfNoException();
+
+   tr.ungroup();
+}
+
+static void runDynoIndexTest(TestRunner& tr)
+{
+   tr.group("DynamicObject index");
+
+   tr.test("array (iter)");
+   {
+      DynamicObject d;
+      d[0] = 0;
+      d[1] = 1;
+      d[2] = 2;
+
+      int count = 0;
+      DynamicObjectIterator i = d.getIterator();
+      while(i->hasNext())
+      {
+         i->next();
+         assert(count == i->getIndex());
+         ++count;
+      }
+   }
+   tr.passIfNoException();
+
+   tr.test("array (rem)");
+   {
+      DynamicObject d;
+      d[0] = 0;
+      d[1] = 1;
+      d[2] = 2;
+
+      int count = -1;
+      bool done = false;
+      DynamicObjectIterator i = d.getIterator();
+      while(i->hasNext())
       {
-         DynamicObject d;
-         d->setType(Double);
-         assert(d->length() == sizeof(double));
+         DynamicObject& next = i->next();
+         ++count;
+         assert(count == i->getIndex());
+
+         if(!done && count == 1)
+         {
+            uint32_t val = next->getUInt32();
+            assert(val == 1);
+            i->remove();
+            --count;
+            assert(i->getIndex() == count);
+            done = true;
+         }
       }
    }
+   tr.passIfNoException();
 
+   tr.test("map (iter)");
    {
-      // test '==' and '<' compare of null strings
-      DynamicObject d1;
-      d1->setType(String);
-      DynamicObject d2;
-      d2->setType(String);
-      assert(d1 == d2);
-      d2 = "x";
-      assert(d1 < d2);
+      DynamicObject d;
+      d["0"] = 0;
+      d["1"] = 1;
+      d["2"] = 2;
+
+      int count = 0;
+      DynamicObjectIterator i = d.getIterator();
+      while(i->hasNext())
+      {
+         i->next();
+         assert(count == i->getIndex());
+         ++count;
+      }
    }
+   tr.passIfNoException();
 
+   tr.test("map (rem)");
    {
-      DynamicObject dArray;
-      DynamicObject d1;
-      d1 = "first";
-      DynamicObject d2;
-      d2 = "second";
-      DynamicObject d3;
-      d3 = "third";
-      dArray[0] = d1;
-      dArray[1] = d2;
-      dArray[2] = d3;
+      DynamicObject d;
+      d["0"] = 0;
+      d["1"] = 1;
+      d["2"] = 2;
 
-      DynamicObject d4;
-      d4 = "second";
-      //printf("index=%i\n", dArray->getIndex(d4));
-      assert(dArray->indexOf(d4) == 1);
+      int count = -1;
+      DynamicObjectIterator i = d.getIterator();
+      while(i->hasNext())
+      {
+         DynamicObject& next = i->next();
+         ++count;
 
-      DynamicObject d5;
-      d5 = "fourth";
-      assert(dArray->indexOf(d5) == -1);
+         if(count == 1)
+         {
+            assert(next->getUInt32() == 1);
+            i->remove();
+            assert(i->getIndex() == (count - 1));
+         }
+      }
    }
+   tr.passIfNoException();
+
+   tr.ungroup();
+}
+
+static void runDynoValueIteratorTest(TestRunner& tr)
+{
+   tr.group("DynamicObject value iterator");
 
+   tr.test("array");
    {
       DynamicObject d;
-      d->append("bar");
-      d->append("baz");
-      d->append(1);
-      d->append(true);
+      d[0] = 0;
+      d[1] = 1;
+      d[2] = 2;
 
-      int i;
-      i = d->indexOf("bar");
-      assert(i == 0);
-      i = d->indexOf("baz");
-      assert(i == 1);
-      i = d->indexOf(1);
-      assert(i == 2);
-      i = d->indexOf(true);
-      assert(i == 3);
-      i = d->indexOf(false);
-      assert(i == -1);
-      i = d->indexOf("bank");
-      assert(i == -1);
+      int count = 0;
+      for(DynamicObject::iterator i = d.begin(); i != d.end(); ++i)
+      {
+         assert(count == i.getIndex());
+         assert(i.getName() == NULL);
+         assert((*i)->getInt32() == count);
+         assert(i->isNull() == false);
+         ++count;
+      }
+      assert(count == 3);
    }
+   tr.passIfNoException();
 
+   tr.test("map");
    {
       DynamicObject d;
-      d->append(1);
-      d->append(2);
-      d->append(3);
-      d->removeIndex(0);
+      d["0"] = 0;
+      d["1"] = 1;
+      d["2"] = 2;
 
-      DynamicObject expect;
-      expect->append(2);
-      expect->append(3);
-      assertDynoCmp(expect, d);
+      int count = 0;
+      DynamicObject::iterator end = d.end();
+      for(DynamicObject::iterator i = d.begin(); i != end; i++)
+      {
+         assert(count == i.getIndex());
+         assert(d->hasMember(i.getName()));
+         assert(d[i.getName()] == *i);
+         ++count;
+      }
+      assert(count == 3);
    }
+   tr.passIfNoException();
 
+   tr.test("modify");
    {
       DynamicObject d;
-      d->append(1);
-      d->append(2);
-      d->append(3);
-      d->removeIndex(0);
-      d->removeIndex(1);
+      d["a"] = 1;
+      d["b"] = 2;
 
-      DynamicObject expect;
-      expect->append(2);
-      assertDynoCmp(expect, d);
+      for(DynamicObject::iterator i = d.begin(); i != d.end(); ++i)
+      {
+         *i = (*i)->getInt32() * 10;
+      }
+      assert(d["a"]->getInt32() == 10);
+      assert(d["b"]->getInt32() == 20);
    }
+   tr.passIfNoException();
 
+   tr.test("packed array");
    {
       DynamicObject d;
-      d->append(1);
-      d->append(2);
-      d->append(3);
-      d->removeIndex(-1);
+      d->setPackedType(Int32);
+      for(int32_t i = 0; i < 10; ++i)
+      {
+         d->appendPacked(i);
+      }
 
-      DynamicObject expect;
-      expect->append(1);
-      expect->append(2);
-      assertDynoCmp(expect, d);
+      int count = 0;
+      for(DynamicObject::iterator i = d.begin(); i != d.end(); ++i)
+      {
+         assert((*i)->getInt32() == count);
+         ++count;
+      }
+      assert(count == 10);
    }
+   tr.passIfNoException();
 
+   tr.test("single and empty");
    {
       DynamicObject d;
-      d->append(1);
-      d->append(2);
-      d->append(3);
-      d->removeIndex(-2);
+      d = "single";
 
-      DynamicObject expect;
-      expect->append(1);
-      expect->append(3);
-      assertDynoCmp(expect, d);
+      int count = 0;
+      for(DynamicObject::iterator i = d.begin(); i != d.end(); ++i)
+      {
+         assert(&(*i) == &d);
+         ++count;
+      }
+      assert(count == 1);
+
+      DynamicObject empty;
+      empty->setType(Array);
+      assert(empty.begin() == empty.end());
+
+      DynamicObject null(NULL);
+      assert(null.begin() == null.end());
    }
+   tr.passIfNoException();
 
+   tr.test("copy on write");
    {
       DynamicObject d;
-      d->append(1);
-      d->append(2);
-      d->append(3);
-      d->removeIndex(-3);
+      d["a"] = 1;
+      d["b"] = 2;
+      d.freeze();
 
-      DynamicObject expect;
-      expect->append(2);
-      expect->append(3);
-      assertDynoCmp(expect, d);
+      // iterating a clone must not modify the source
+      DynamicObject c = d.clone();
+      for(DynamicObject::iterator i = c.begin(); i != c.end(); ++i)
+      {
+         *i = 0;
+      }
+      assert(c["a"]->getInt32() == 0);
+      assert(d["a"]->getInt32() == 1);
+      assert(d["b"]->getInt32() == 2);
    }
+   tr.passIfNoException();
 
+#if __cplusplus >= 201103L
+   tr.test("range for");
    {
       DynamicObject d;
       d->append(1);
       d->append(2);
-      d->append(3);
-      d->removeIndex(-4);
 
-      DynamicObject expect;
-      expect->append(1);
-      expect->append(2);
-      expect->append(3);
-      assertDynoCmp(expect, d);
+      int sum = 0;
+      for(DynamicObject& next : d)
+      {
+         sum += next->getInt32();
+      }
+      assert(sum == 3);
+   }
+   tr.passIfNoException();
+#endif
+
+   tr.ungroup();
+}
+
+static void runDynoTypeTest(TestRunner& tr)
+{
+   tr.group("DynamicObject types");
+
+   tr.test("determineType");
+   {
+      DynamicObject d;
+
+      d = 0;
+      assert(DynamicObject::determineType(d->getString()) == UInt64);
+
+      d = "0";
+      assert(DynamicObject::determineType(d->getString()) == UInt64);
+
+      d = 1;
+      assert(DynamicObject::determineType(d->getString()) == UInt64);
+
+      d = "1";
+      assert(DynamicObject::determineType(d->getString()) == UInt64);
+
+      d = -1;
+      assert(DynamicObject::determineType(d->getString()) == Int64);
+
+      d = "-1";
+      assert(DynamicObject::determineType(d->getString()) == Int64);
+
+      d = " -1";
+      assert(DynamicObject::determineType(d->getString()) == String);
+
+      d = " ";
+      assert(DynamicObject::determineType(d->getString()) == String);
+
+      d = "x";
+      assert(DynamicObject::determineType(d->getString()) == String);
+
+      // FIXME: check for Double
    }
+   tr.passIfNoException();
 
+   tr.ungroup();
+}
+
+static void runDynoAppendTest(TestRunner& tr)
+{
+   tr.group("DynamicObject append");
+
+   tr.test("append basic");
    {
       DynamicObject d;
-      d->append(1);
-      d->append(2);
-      d->append(3);
-      d->removeIndex(3);
 
-      DynamicObject expect;
-      expect->append(1);
-      expect->append(2);
-      expect->append(3);
-      assertDynoCmp(expect, d);
+      DynamicObject& next = d->append();
+      next = "test";
+
+      assert(d->length() == 1);
+      assertStrCmp(d[0]->getString(), "test");
    }
+   tr.passIfNoException();
 
+   tr.test("append ref");
    {
       DynamicObject d;
-      d = 1;
-      d.push(2);
 
-      DynamicObject expect;
-      expect->append(1);
-      expect->append(2);
-      assertDynoCmp(expect, d);
+      DynamicObject& next = d->append();
+      next = "test";
+
+      assert(d->length() == 1);
+      assertStrCmp(d[0]->getString(), "test");
    }
+   tr.passIfNoException();
 
+   tr.test("append inline");
    {
       DynamicObject d;
-      d.push(1);
-      d.push(2);
 
-      DynamicObject expect;
-      expect->append(1);
-      expect->append(2);
-      assertDynoCmp(expect, d);
-   }
+      d->append("test");
 
-   {
-      // test compare cloned object
-      DynamicObject d1;
-      d1["map"]["key"] = "value";
-      DynamicObject d2 = d1.clone();
-      assert(d1 == d2);
-      assert(!(d1 < d2));
+      assert(d->length() == 1);
+      assertStrCmp(d[0]->getString(), "test");
    }
+   tr.passIfNoException();
 
-   {
-      // test same object as map key
-      DynamicObject d1;
-      d1["map"]["key"] = "value";
-      DynamicObject d2;
-      d2["map"]["key"] = "value";
-      assert(d1 == d2);
-      assert(!(d1 < d2));
+   tr.ungroup();
+}
 
-      std::map<DynamicObject, int> maptest;
-      maptest.insert(make_pair(d1, 1));
-      maptest.insert(make_pair(d2, 1));
-      assert(maptest.size() == 1);
-   }
+static void runDynoMergeTest(TestRunner& tr)
+{
+   tr.group("DynamicObject merge");
 
+   tr.test("merge basic");
    {
-      // test '<' for arrays
-      DynamicObject d1;
-      d1->setType(Array);
-      DynamicObject d2;
-      d2->setType(Array);
+      DynamicObject d;
+      d->setType(Map);
 
-      d1[0] = 0;
-      d1[1] = 1;
+      DynamicObject d2;
+      d2["a"] = true;
 
-      d2[0] = 0;
-      d2[1] = 2;
+      d.merge(d2, true);
 
-      assert(!(d1 == d2));
-      assert(d1 < d2);
+      DynamicObject expect;
+      expect["a"] = true;
+      assert(d == expect);
    }
+   tr.passIfNoException();
 
+   tr.test("merge no append");
    {
-      // test for string equality
-      DynamicObject d1;
-      d1 = "foo";
-      assert(d1 == "foo");
-      assert(d1 != "bar");
+      DynamicObject d;
+      d[0] = "d-0";
 
       DynamicObject d2;
-      d2 = 1;
-      assert(!(d1 == "1"));
-      assert(d1 != "1");
-   }
+      d2[0] = "d2-0";
+      d2[1] = "d2-1";
 
-   {
-      // test positive index array expansion
-      DynamicObject d;
-      d->setType(Array);
-      assert(d->length() == 0);
-      d[1] = 1;
-      assert(d->length() == 2);
-      d[1];
-      assert(d->length() == 2);
+      d.merge(d2, false);
+
+      DynamicObject expect;
+      expect[0] = "d2-0";
+      expect[1] = "d2-1";
+      assert(d == expect);
    }
+   tr.passIfNoException();
 
+   tr.test("merge append");
    {
-      // test negative index array expansion
       DynamicObject d;
-      d->setType(Array);
-      assert(d->length() == 0);
-      d[-1] = 1;
-      assert(d->length() == 1);
+      d[0] = "d-0";
+
+      DynamicObject d2;
+      d2[0] = "d2-0";
+      d2[1] = "d2-1";
+
+      d.merge(d2, true);
+
+      DynamicObject expect;
+      expect[0] = "d-0";
+      expect[1] = "d2-0";
+      expect[2] = "d2-1";
+      assert(d == expect);
    }
+   tr.passIfNoException();
 
+   tr.test("merge shallow");
    {
-      // test pop
       DynamicObject d;
-      d->setType(Array);
-      assert(d->length() == 0);
-      d->append();
-      assert(d->length() == 1);
-      d->pop();
-      assert(d->length() == 0);
-      // pop on empty array a no-op
-      d->pop();
-      assert(d->length() == 0);
-   }
-
-   tr.pass();
-}
+      d["0"] = "d-0";
 
-static void runDynoClearTest(TestRunner& tr)
-{
-   tr.test("DynamicObject clear");
+      DynamicObject d2;
+      d2["1"] = "d2-1";
+      d2["2"] = "d2-2";
 
-   DynamicObject d;
+      d.merge(d2, true);
 
-   d = "x";
-   assert(d->getType() == String);
-   d->clear();
-   assert(d->getType() == String);
-   assertStrCmp(d->getString(), "");
+      DynamicObject expect;
+      expect["0"] = "d-0";
+      expect["1"] = "d2-1";
+      expect["2"] = "d2-2";
+      assert(d == expect);
+   }
+   tr.passIfNoException();
 
-   d = (int)1;
-   assert(d->getType() == Int32);
-   d->clear();
-   assert(d->getType() == Int32);
-   assert(d->getInt32() == 0);
+   tr.test("merge deep");
+   {
+      DynamicObject d;
+      d["0"]["0"] = "d-0-0";
 
-   d = (unsigned int)1;
-   assert(d->getType() == UInt32);
-   d->clear();
-   assert(d->getType() == UInt32);
-   assert(d->getBoolean() == false);
+      DynamicObject d2;
+      d2["0"]["1"] = "d2-0-1";
 
-   d = (int64_t)1;
-   assert(d->getType() == Int64);
-   d->clear();
-   assert(d->getType() == Int64);
-   assert(d->getInt64() == 0);
+      d.merge(d2, true);
 
-   d = (uint64_t)1;
-   d->clear();
-   assert(d->getType() == UInt64);
-   assert(d->getUInt64() == 0);
+      DynamicObject expect;
+      expect["0"]["0"] = "d-0-0";
+      expect["0"]["1"] = "d2-0-1";
+      assert(d == expect);
+   }
+   tr.passIfNoException();
 
-   d = (double)1.0;
-   d->clear();
-   assert(d->getType() == Double);
-   assert(d->getDouble() == 0.0);
+   tr.test("merge deep overwrite");
+   {
+      DynamicObject d;
+      d["0"]["0"] = "d-0-0";
 
-   d["x"] = 0;
-   d->clear();
-   assert(d->getType() == Map);
-   assert(d->length() == 0);
+      DynamicObject d2;
+      d2["0"]["0"] = "d2-0-0";
 
-   d[0] = 0;
-   d->clear();
-   assert(d->getType() == Array);
-   assert(d->length() == 0);
+      d.merge(d2, true);
 
+      DynamicObject expect;
+      expect["0"]["0"] = "d2-0-0";
+      assert(d == expect);
+   }
    tr.passIfNoException();
+
+   tr.ungroup();
 }
 
-static void runDynoConversionTest(TestRunner& tr)
+static void runDynoDiffTest(TestRunner& tr)
 {
-   tr.test("DynamicObject conversion");
-
-   DynamicObject d;
-   d["int"] = 2;
-   d["-int"] = -2;
-   d["str"] = "hello";
-   d["true"] = "true";
-   d["false"] = "false";
-
-   const char* s;
-   s = d["int"]->getString();
-   assertStrCmp(s, "2");
-
-   s = d["-int"]->getString();
-   assertStrCmp(s, "-2");
-
-   s = d["str"]->getString();
-   assertStrCmp(s, "hello");
+   tr.group("DynamicObject diff");
 
-   s = d["true"]->getString();
-   assertStrCmp(s, "true");
+   tr.test("no diff");
+   {
+      DynamicObject d1;
+      d1["a"] = true;
 
-   s = d["false"]->getString();
-   assertStrCmp(s, "false");
+      DynamicObject d2;
+      d2["a"] = true;
 
-   tr.pass();
-}
+      DynamicObject diff;
+      assert(!d1.diff(d2, diff));
+   }
+   tr.passIfNoException();
 
-static void runDynoCastTest(TestRunner& tr)
-{
-   tr.test("DynamicObject casting");
+   tr.test("basic types");
+   {
+      DynamicObject d1;
+      d1 = true;
 
-   {
-      DynamicObject d;
-      bool v;
+      DynamicObject d2;
+      d2 = true;
 
-      d = true;
-      v = d;
-      assert(v == d->getBoolean());
+      DynamicObject diff;
+      assert(!d1.diff(d2, diff));
 
-      d = false;
-      v = d;
-      assert(v == d->getBoolean());
+      d2 = false;
+      DynamicObject expect;
+      expect["type"] = "valueChanged";
+      expect["source"] = true;
+      expect["target"] = false;
+      assert(d1.diff(d2, diff));
    }
+   tr.passIfNoException();
 
+   tr.test("basic map");
    {
-      DynamicObject d;
-      const char* t = "test";
-      const char* v;
+      DynamicObject d1;
+      d1->setType(Map);
 
-      d = t;
-      v = d;
-      // check pointers are different
-      assert(v != t);
-      assertStrCmp(v, d->getString());
-      assertStrCmp(v, t);
-   }
+      DynamicObject d2;
+      d2["a"] = true;
 
-   {
-      DynamicObject d;
-      char* t = (char*)malloc(10);
-      strcpy(t, "value");
+      DynamicObject expect;
+      DynamicObject diff;
 
-      d["x"] = t;
-      assertStrCmp(d["x"]->getString(), t);
-      free(t);
-   }
+      // d1 diff d2
+      expect->clear();
+      expect[0]["key"] = "a";
+      expect[0]["added"] = true;
+      assert(d1.diff(d2, diff));
+      assertDynoCmp(diff, expect);
 
-   {
-      DynamicObject d;
-      // const vals
-      const char* cn = "cn";
-      const char* cv = "cv";
-      // array vals
-      char an[10];
-      strcpy(an, "an");
-      char av[10];
-      strcpy(av, "av");
+      // d2 diff d1 (reverse above)
+      expect->clear();
+      expect[0]["key"] = "a";
+      expect[0]["removed"] = true;
+      assert(d2.diff(d1, diff));
+      assertDynoCmp(diff, expect);
 
-      d[cn] = cv;
-      assertStrCmp(d[cn]->getString(), cv);
-      d[cn] = av;
-      assertStrCmp(d[cn]->getString(), av);
-      d[an] = cv;
-      assertStrCmp(d[an]->getString(), cv);
-      d[an] = av;
-      assertStrCmp(d[an]->getString(), av);
+      // d1 diff d2 (changed value)
+      d1["a"] = false;
+      expect->clear();
+      expect[0]["key"] = "a";
+      expect[0]["changed"]["type"] = "valueChanged";
+      expect[0]["changed"]["source"] = false;
+      expect[0]["changed"]["target"] = true;
+      assert(d1.diff(d2, diff));
+      assertDynoCmp(diff, expect);
    }
+   tr.passIfNoException();
 
+   tr.test("basic array");
    {
-      DynamicObject d;
-      uint32_t t = 123;
-      uint32_t v;
+      DynamicObject d1;
+      d1->setType(Array);
 
-      d = t;
-      v = d;
-      assert(d->getUInt32() == t);
-      assert(v == t);
-   }
+      DynamicObject d2;
+      d2[0] = true;
 
-   {
-      // lval and rval
+      DynamicObject expect;
 
-      DynamicObject d;
-      uint32_t t = 123;
+      // d1 diff d2
+      DynamicObject diff;
+      expect[0]["index"] = 0;
+      expect[0]["added"] = true;
+      assert(d1.diff(d2, diff));
+      assertDynoCmp(diff, expect);
 
-      d = t;
-      assert(d->getUInt32() == t);
-      assert(t == d->getUInt32());
-      // do need to cast here to avoid ambiguous comparison errors
-      assert((uint32_t)d == t);
-      assert(t == (uint32_t)d);
+      // d2 diff d1 (reverse above)
+      expect->clear();
+      expect[0]["index"] = 0;
+      expect[0]["removed"] = true;
+      assert(d2.diff(d1, diff));
+      assertDynoCmp(diff, expect);
    }
+   tr.passIfNoException();
 
-   tr.pass();
-}
+   tr.test("deep 1");
+   {
+      DynamicObject d1;
+      d1->setType(Map);
 
-static void runDynoRemoveTest(TestRunner& tr)
-{
-   tr.group("DynamicObject remove");
+      DynamicObject d2;
+      d2["a"]["a1"] = true;
+      d2["a"]["a2"] = 123;
+      d2["b"]["b1"] = "Hello, World!";
 
-   tr.test("array of 1");
+      DynamicObject expect;
+      expect[0]["key"] = "a";
+      expect[0]["added"] = d2["a"].clone();
+      expect[1]["key"] = "b";
+      expect[1]["added"] = d2["b"].clone();
+
+      DynamicObject diff;
+      assert(d1.diff(d2, diff));
+      assertDynoCmp(diff, expect);
+   }
+   tr.passIfNoException();
+
+   tr.test("deep 2");
    {
       DynamicObject d1;
-      d1[0] = 0;
+      d1["a"]["same"] = true;
+      d1["a"]["ch"] = 234;
+      d1["a"]["rem"] = 1;
+      d1["b"]["b1"] = "Hello, World!";
 
       DynamicObject d2;
-      d2->setType(Array);
+      d2["a"]["same"] = true;
+      d2["a"]["ch"] = 123;
+      d2["a"]["add"] = 2;
+      d2["c"]["c1"] = "Hello, World!";
 
-      DynamicObjectIterator i = d1.getIterator();
-      assert(i->hasNext());
-      i->next();
-      i->remove();
-      assert(!i->hasNext());
-      assertDynoCmp(d1, d2);
+      DynamicObject expect;
+      expect[0]["key"] = "a";
+      expect[0]["changed"][0]["key"] = "ch";
+      expect[0]["changed"][0]["changed"]["type"] = "valueChanged";
+      expect[0]["changed"][0]["changed"]["source"] = 234;
+      expect[0]["changed"][0]["changed"]["target"] = 123;
+      expect[0]["changed"][1]["key"] = "rem";
+      expect[0]["changed"][1]["removed"] = 1;
+      expect[0]["changed"][2]["key"] = "add";
+      expect[0]["changed"][2]["added"] = 2;
+      expect[1]["key"] = "b";
+      expect[1]["removed"]["b1"] = "Hello, World!";
+      expect[2]["key"] = "c";
+      expect[2]["added"]["c1"] = "Hello, World!";
+
+      DynamicObject diff;
+      assert(d1.diff(d2, diff));
+      assertDynoCmp(diff, expect);
    }
    tr.passIfNoException();
 
-   tr.test("array");
+   tr.test("ints");
    {
+      // common value
+      #define V 123
+
       DynamicObject d1;
-      d1[0] = 0;
-      d1[1] = 1;
-      d1[2] = 2;
+      d1["u32-u32"] = (uint32_t)V;
+      d1["u32-u64"] = (uint32_t)V;
+      d1["u32-s32"] = (uint32_t)V;
+      d1["u32-s64"] = (uint32_t)V;
+
+      d1["s32-u32"] = (int32_t)V;
+      d1["s32-u64"] = (int32_t)V;
+      d1["s32-s32"] = (int32_t)V;
+      d1["s32-s64"] = (int32_t)V;
+
+      d1["u64-u32"] = (uint64_t)V;
+      d1["u64-u64"] = (uint64_t)V;
+      d1["u64-s32"] = (uint64_t)V;
+      d1["u64-s64"] = (uint64_t)V;
+
+      d1["s64-u32"] = (uint64_t)V;
+      d1["s64-u64"] = (int64_t)V;
+      d1["s64-s32"] = (int64_t)V;
+      d1["s64-s64"] = (int64_t)V;
 
       DynamicObject d2;
-      d2[0] = 0;
-      d2[1] = 2;
+      d2["u32-u32"] = (uint32_t)V;
+      d2["u32-u64"] = (uint64_t)V;
+      d2["u32-s32"] = (int32_t)V;
+      d2["u32-s64"] = (int64_t)V;
 
-      int count = 0;
-      DynamicObjectIterator i = d1.getIterator();
-      while(i->hasNext())
-      {
-         DynamicObject& next = i->next();
+      d2["s32-u32"] = (uint32_t)V;
+      d2["s32-u64"] = (uint64_t)V;
+      d2["s32-s32"] = (int32_t)V;
+      d2["s32-s64"] = (int64_t)V;
 
-         if(count == 1)
-         {
-            assert(next->getUInt32() == 1);
-            i->remove();
-         }
+      d2["u64-u32"] = (uint32_t)V;
+      d2["u64-u64"] = (uint64_t)V;
+      d2["u64-s32"] = (int32_t)V;
+      d2["u64-s64"] = (int64_t)V;
 
-         ++count;
-      }
+      d2["s64-u32"] = (uint32_t)V;
+      d2["s64-u64"] = (uint64_t)V;
+      d2["s64-s32"] = (int32_t)V;
+      d2["s64-s64"] = (int64_t)V;
 
-      assertDynoCmp(d1, d2);
+      #undef V
+
+      DynamicObject diff;
+      // types cause difference
+      assert(d1.diff(d2, diff, DynamicObject::DiffEqual));
+      assert(diff->length() == 12);
+      // no diff with comparisons using int64s
+      assert(!(d1.diff(d2, diff, DynamicObject::DiffIntegersAsInt64s)));
+      assert(diff->length() == 0);
    }
    tr.passIfNoException();
 
-   tr.test("map of 1");
+   tr.test("doubles");
    {
+      #define V 1.23456789
+
       DynamicObject d1;
-      d1["0"] = 0;
+      d1["d1"] = (double)V;
 
       DynamicObject d2;
-      d2->setType(Map);
+      // set and convert through a string back to a double
+      d2["d1"] = (double)V;
+      d2["d1"]->setType(String);
+      d2["d1"]->setType(Double);
 
-      DynamicObjectIterator i = d1.getIterator();
-      assert(i->hasNext());
-      i->next();
-      i->remove();
-      assert(!i->hasNext());
-      assertDynoCmp(d1, d2);
+      #undef V
+
+      DynamicObject diff;
+      // not exact due to double->string->double conversion
+      assert(d1.diff(d2, diff, DynamicObject::DiffEqual));
+      assert(diff->length() == 1);
+      // no diff when compared as strings
+      assert(!(d1.diff(d2, diff, DynamicObject::DiffDoublesAsStrings)));
+      assert(diff->length() == 0);
    }
    tr.passIfNoException();
 
-   tr.test("map of 2");
+   tr.test("array no diff");
    {
       DynamicObject d1;
-      d1["0"] = 0;
-      d1["1"] = 0;
+      d1["a"][0] = "data";
 
       DynamicObject d2;
-      d2["0"] = 0;
+      d2["a"][0] = "data";
 
-      DynamicObjectIterator i = d1.getIterator();
-      assert(i->hasNext());
-      i->next();
-      assert(i->hasNext());
-      i->next();
-      assert(!i->hasNext());
-      i->remove();
-      assert(!i->hasNext());
-      assertDynoCmp(d1, d2);
+      DynamicObject diff;
+      DynamicObject expect;
+      expect->setType(Map);
+      assert(!d1.diff(d2, diff));
+      assert(diff->length() == 0);
+      assert(!d2.diff(d1, diff));
+      assert(diff->length() == 0);
    }
    tr.passIfNoException();
 
-   tr.test("map");
+   tr.test("array added/removed diffs");
    {
       DynamicObject d1;
-      d1["0"] = 0;
-      d1["1"] = 1;
-      d1["2"] = 2;
+      d1["a"]->setType(Array);
 
       DynamicObject d2;
-      d2["0"] = 0;
-      d2["2"] = 2;
-
-      int count = 0;
-      DynamicObjectIterator i = d1.getIterator();
-      while(i->hasNext())
-      {
-         DynamicObject& next = i->next();
+      d2["a"]->setType(Array);
+      DynamicObject d3;
+      d3 = "data";
+      d2["a"]->append(d3);
 
-         if(count == 1)
-         {
-            assert(next->getUInt32() == 1);
-            i->remove();
-         }
+      DynamicObject diff;
 
-         ++count;
+      {
+         DynamicObject expect;
+         expect[0]["key"] = "a";
+         expect[0]["changed"][0]["index"] = 0;
+         expect[0]["changed"][0]["added"] = "data";
+         assert(d1.diff(d2, diff));
+         assertDynoCmp(diff, expect);
       }
 
-      assertDynoCmp(d1, d2);
+      {
+         DynamicObject expect;
+         expect[0]["key"] = "a";
+         expect[0]["changed"][0]["index"] = 0;
+         expect[0]["changed"][0]["removed"] = "data";
+         assert(d2.diff(d1, diff));
+         assertDynoCmp(diff, expect);
+      }
    }
    tr.passIfNoException();
 
-   tr.ungroup();
-}
+   tr.test("array changed diffs");
+   {
+      DynamicObject d1;
+      d1["a"][0] = "1";
 
-static void runDynoIndexTest(TestRunner& tr)
-{
-   tr.group("DynamicObject index");
+      DynamicObject d2;
+      d2["a"][0] = "2";
 
-   tr.test("array (iter)");
-   {
-      DynamicObject d;
-      d[0] = 0;
-      d[1] = 1;
-      d[2] = 2;
+      DynamicObject expect;
+      expect[0]["key"] = "a";
+      expect[0]["changed"][0]["index"] = 0;
+      expect[0]["changed"][0]["changed"]["type"] = "valueChanged";
+      expect[0]["changed"][0]["changed"]["source"] = "1";
+      expect[0]["changed"][0]["changed"]["target"] = "2";
 
-      int count = 0;
-      DynamicObjectIterator i = d.getIterator();
-      while(i->hasNext())
-      {
-         i->next();
-         assert(count == i->getIndex());
-         ++count;
-      }
+      DynamicObject diff;
+      assert(d1.diff(d2, diff));
+      assertDynoCmp(diff, expect);
    }
    tr.passIfNoException();
 
-   tr.test("array (rem)");
+   tr.test("map no diff");
    {
-      DynamicObject d;
-      d[0] = 0;
-      d[1] = 1;
-      d[2] = 2;
+      DynamicObject d1;
+      d1["a"]["b"] = "data";
 
-      int count = -1;
-      bool done = false;
-      DynamicObjectIterator i = d.getIterator();
-      while(i->hasNext())
-      {
-         DynamicObject& next = i->next();
-         ++count;
-         assert(count == i->getIndex());
+      DynamicObject d2;
+      d2["a"]["b"] = "data";
 
-         if(!done && count == 1)
-         {
-            uint32_t val = next->getUInt32();
-            assert(val == 1);
-            i->remove();
-            --count;
-            assert(i->getIndex() == count);
-            done = true;
-         }
-      }
+      DynamicObject diff;
+      DynamicObject expect;
+      expect->setType(Map);
+      assert(!d1.diff(d2, diff));
+      assert(diff->length() == 0);
+      assert(!d2.diff(d1, diff));
+      assert(diff->length() == 0);
    }
    tr.passIfNoException();
 
-   tr.test("map (iter)");
+   tr.test("map added/removed diffs");
    {
-      DynamicObject d;
-      d["0"] = 0;
-      d["1"] = 1;
-      d["2"] = 2;
+      DynamicObject d1;
+      d1["a"]->setType(Map);
 
-      int count = 0;
-      DynamicObjectIterator i = d.getIterator();
-      while(i->hasNext())
-      {
-         i->next();
-         assert(count == i->getIndex());
-         ++count;
-      }
-   }
-   tr.passIfNoException();
+      DynamicObject d2;
+      d2["a"]["b"] = "data";
 
-   tr.test("map (rem)");
-   {
-      DynamicObject d;
-      d["0"] = 0;
-      d["1"] = 1;
-      d["2"] = 2;
+      DynamicObject diff;
 
-      int count = -1;
-      DynamicObjectIterator i = d.getIterator();
-      while(i->hasNext())
       {
-         DynamicObject& next = i->next();
-         ++count;
+         DynamicObject expect;
+         expect[0]["key"] = "a";
+         expect[0]["changed"][0]["key"] = "b";
+         expect[0]["changed"][0]["added"] = "data";
+         assert(d1.diff(d2, diff));
+         assertDynoCmp(diff, expect);
+      }
 
-         if(count == 1)
-         {
-            assert(next->getUInt32() == 1);
-            i->remove();
-            assert(i->getIndex() == (count - 1));
-         }
+      {
+         DynamicObject expect;
+         expect[0]["key"] = "a";
+         expect[0]["changed"][0]["key"] = "b";
+         expect[0]["changed"][0]["removed"] = "data";
+         assert(d2.diff(d1, diff));
+         assertDynoCmp(diff, expect);
       }
    }
    tr.passIfNoException();
 
-   tr.ungroup();
-}
-
-static void runDynoTypeTest(TestRunner& tr)
-{
-   tr.group("DynamicObject types");
-
-   tr.test("determineType");
+   tr.test("map changed diffs");
    {
-      DynamicObject d;
-
-      d = 0;
-      assert(DynamicObject::determineType(d->getString()) == UInt64);
-
-      d = "0";
-      assert(DynamicObject::determineType(d->getString()) == UInt64);
-
-      d = 1;
-      assert(DynamicObject::determineType(d->getString()) == UInt64);
-
-      d = "1";
-      assert(DynamicObject::determineType(d->getString()) == UInt64);
-
-      d = -1;
-      assert(DynamicObject::determineType(d->getString()) == Int64);
-
-      d = "-1";
-      assert(DynamicObject::determineType(d->getString()) == Int64);
-
-      d = " -1";
-      assert(DynamicObject::determineType(d->getString()) == String);
+      DynamicObject d1;
+      d1["a"][0] = "1";
 
-      d = " ";
-      assert(DynamicObject::determineType(d->getString()) == String);
+      DynamicObject d2;
+      d2["a"][0] = "2";
 
-      d = "x";
-      assert(DynamicObject::determineType(d->getString()) == String);
+      DynamicObject expect;
+      expect[0]["key"] = "a";
+      expect[0]["changed"][0]["index"] = 0;
+      expect[0]["changed"][0]["changed"]["type"] = "valueChanged";
+      expect[0]["changed"][0]["changed"]["source"] = "1";
+      expect[0]["changed"][0]["changed"]["target"] = "2";
 
-      // FIXME: check for Double
+      DynamicObject diff;
+      assert(d1.diff(d2, diff));
+      assertDynoCmp(diff, expect);
    }
    tr.passIfNoException();
 
    tr.ungroup();
 }
 
-static void runDynoAppendTest(TestRunner& tr)
+static void runDynoHashTest(TestRunner& tr)
 {
-   tr.group("DynamicObject append");
+   tr.group("DynamicObject hash");
 
-   tr.test("append basic");
+   tr.test("equal objects");
    {
-      DynamicObject d;
+      DynamicObject d1;
+      d1["a"] = 1;
+      d1["b"]["c"] = "c";
+      d1["d"]->append(true);
+      d1["d"]->append(1.5);
 
-      DynamicObject& next = d->append();
-      next = "test";
+      DynamicObject d2;
+      d2["d"]->append(true);
+      d2["d"]->append(1.5);
+      d2["b"]["c"] = "c";
+      d2["a"] = 1;
 
-      assert(d->length() == 1);
-      assertStrCmp(d[0]->getString(), "test");
+      assert(d1 == d2);
+      assert(d1.getHash() == d2.getHash());
+      assert(d1.isIdentical(d2));
+
+      d2["b"]["c"] = "changed";
+      assert(d1.getHash() != d2.getHash());
+      assert(!d1.isIdentical(d2));
+
+      DynamicObject null(NULL);
+      assert(null.getHash() == 0);
+      assert(null.isIdentical(DynamicObject(NULL)));
+      assert(!null.isIdentical(d1));
    }
    tr.passIfNoException();
 
-   tr.test("append ref");
+   tr.test("equal values of different types");
    {
-      DynamicObject d;
-
-      DynamicObject& next = d->append();
-      next = "test";
+      DynamicObject d1;
+      d1 = 5;
+      DynamicObject d2;
+      d2 = "5";
+      DynamicObject d3;
+      d3 = (uint64_t)5;
+      assert(d1 == d2);
+      assert(d1.getHash() == d2.getHash());
+      assert(d1.getHash() == d3.getHash());
+      assert(!d1.isIdentical(d2));
+
+      DynamicObject z1;
+      z1 = 0.0;
+      DynamicObject z2;
+      z2 = -0.0;
+      assert(z1 == z2);
+      assert(z1.getHash() == z2.getHash());
+   }
+   tr.passIfNoException();
 
-      assert(d->length() == 1);
-      assertStrCmp(d[0]->getString(), "test");
+   tr.test("packed arrays");
+   {
+      DynamicObject packed;
+      packed->setPackedType(Int32);
+      DynamicObject unpacked;
+      unpacked->setType(Array);
+      for(int32_t i = 0; i < 10; ++i)
+      {
+         packed->appendPacked(i);
+         unpacked->append(i);
+      }
+      assert(packed == unpacked);
+      assert(packed.getHash() == unpacked.getHash());
+      assert(packed.isIdentical(unpacked));
    }
    tr.passIfNoException();
 
-   tr.test("append inline");
+   tr.test("frozen");
    {
-      DynamicObject d;
+      DynamicObject d1;
+      d1["a"] = 1;
+      d1["b"]["c"] = "c";
+      d1.freeze();
+      DynamicObject d2 = d1.clone();
+      assert(d2->isHashCached());
+      assert(d1.getHash() == d2.getHash());
+      assert(d1 == d2);
+      assert(d1.isIdentical(d2));
 
-      d->append("test");
+      // modified copies are no longer cached
+      d2["b"]["c"] = "changed";
+      assert(!d2->isHashCached());
+      assert(d1.getHash() != d2.getHash());
+      assert(d1 != d2);
 
-      assert(d->length() == 1);
-      assertStrCmp(d[0]->getString(), "test");
+      DynamicObject d3 = d2.clone();
+      d3.freeze();
+      assert(d1 != d3);
+      DynamicObject diff;
+      assert(d1.diff(d3, diff));
+      assert(diff->length() == 1);
+      assertStrCmp(diff[0]["key"]->getString(), "b");
+
+      DynamicObject d4 = d1.clone();
+      d4["a"] = 1;
+      d4.freeze();
+      assert(!d1.diff(d4, diff));
+
+      // caching can be disabled
+      bool enabled = DynamicObjectImpl::enableHashCaching(false);
+      assert(!d1->isHashCached());
+      assert(d1 != d3);
+      DynamicObjectImpl::enableHashCaching(enabled);
    }
    tr.passIfNoException();
 
    tr.ungroup();
 }
 
-static void runDynoMergeTest(TestRunner& tr)
+static void runDynoPathTest(TestRunner& tr)
 {
-   tr.group("DynamicObject merge");
+   tr.group("DynamicObject path");
 
-   tr.test("merge basic");
+   DynamicObject d;
+   d["node"]["modules"]["x"]["threads"] = 4;
+   d["node"]["modules"]["y"]["threads"] = 8;
+   d["node"]["list"]->append("a");
+   d["node"]["list"]->append("b");
+   d["a/b"]["m~n"] = true;
+   d[""] = "empty";
+
+   tr.test("get");
    {
-      DynamicObject d;
-      d->setType(Map);
+      DynamicObjectPath p("/node/modules/x/threads");
+      assert(p.isValid());
+      assert(p.getSegments().size() == 4);
+      assert(p.get(d)->getUInt32() == 4);
+      assert(p.has(d));
 
-      DynamicObject d2;
-      d2["a"] = true;
-
-      d.merge(d2, true);
+      // leading slash is optional
+      DynamicObjectPath rel("node/modules/y/threads");
+      assert(rel.get(d)->getUInt32() == 8);
 
-      DynamicObject expect;
-      expect["a"] = true;
-      assert(d == expect);
-   }
-   tr.passIfNoException();
+      DynamicObjectPath index("/node/list/1");
+      assertStrCmp(index.get(d)->getString(), "b");
 
-   tr.test("merge no append");
-   {
-      DynamicObject d;
-      d[0] = "d-0";
+      DynamicObjectPath escaped("/a~1b/m~0n");
+      assert(escaped.get(d)->getBoolean());
 
-      DynamicObject d2;
-      d2[0] = "d2-0";
-      d2[1] = "d2-1";
+      DynamicObjectPath empty("/");
+      assertStrCmp(empty.get(d)->getString(), "empty");
 
-      d.merge(d2, false);
+      DynamicObjectPath root("");
+      assert(root.find(d) == &d);
 
-      DynamicObject expect;
-      expect[0] = "d2-0";
-      expect[1] = "d2-1";
-      assert(d == expect);
+      DynamicObjectPath copy = p;
+      assert(copy.get(d)->getUInt32() == 4);
    }
    tr.passIfNoException();
 
-   tr.test("merge append");
+   tr.test("misses do not modify");
    {
-      DynamicObject d;
-      d[0] = "d-0";
-
-      DynamicObject d2;
-      d2[0] = "d2-0";
-      d2[1] = "d2-1";
-
-      d.merge(d2, true);
-
-      DynamicObject expect;
-      expect[0] = "d-0";
-      expect[1] = "d2-0";
-      expect[2] = "d2-1";
+      DynamicObject expect = d.clone();
+      const char* misses[] =
+      {
+         "/node/modules/z/threads",
+         "/node/list/2",
+         "/node/list/01",
+         "/node/list/-",
+         "/node/modules/x/threads/more",
+         "/missing",
+         NULL
+      };
+      for(int i = 0; misses[i] != NULL; ++i)
+      {
+         DynamicObjectPath p(misses[i]);
+         assert(p.isValid());
+         assert(!p.has(d));
+         assert(p.get(d).isNull());
+      }
       assert(d == expect);
+      assert(!d["node"]["modules"]->hasMember("z"));
+
+      DynamicObject null(NULL);
+      assert(!DynamicObjectPath("/node").has(null));
    }
    tr.passIfNoException();
 
-   tr.test("merge shallow");
+   tr.test("frozen");
    {
-      DynamicObject d;
-      d["0"] = "d-0";
-
-      DynamicObject d2;
-      d2["1"] = "d2-1";
-      d2["2"] = "d2-2";
-
-      d.merge(d2, true);
-
-      DynamicObject expect;
-      expect["0"] = "d-0";
-      expect["1"] = "d2-1";
-      expect["2"] = "d2-2";
-      assert(d == expect);
+      DynamicObject frozen = d.clone();
+      frozen.freeze();
+      DynamicObject c = frozen.clone();
+      DynamicObjectPath p("/node/modules/x/threads");
+      assert(p.get(c)->getUInt32() == 4);
+      assert(p.find(c) == p.find(frozen));
    }
    tr.passIfNoException();
 
-   tr.test("merge deep");
+   tr.test("invalid");
    {
-      DynamicObject d;
-      d["0"]["0"] = "d-0-0";
-
-      DynamicObject d2;
-      d2["0"]["1"] = "d2-0-1";
-
-      d.merge(d2, true);
-
-      DynamicObject expect;
-      expect["0"]["0"] = "d-0-0";
-      expect["0"]["1"] = "d2-0-1";
-      assert(d == expect);
+      DynamicObjectPath p;
+      assertException(p.setPath("/a~2b"));
+      assert(Exception::get()->isType(
+         "monarch.rt.DynamicObjectPath.InvalidPath"));
+      Exception::clear();
+      assert(!p.isValid());
+      assert(!p.has(d));
    }
    tr.passIfNoException();
 
-   tr.test("merge deep overwrite");
+   tr.test("set");
    {
-      DynamicObject d;
-      d["0"]["0"] = "d-0-0";
-
-      DynamicObject d2;
-      d2["0"]["0"] = "d2-0-0";
-
-      d.merge(d2, true);
-
-      DynamicObject expect;
-      expect["0"]["0"] = "d2-0-0";
-      assert(d == expect);
+      DynamicObjectPathSet set;
+      assert(set.add("/node/modules/x/threads") == 0);
+      assert(set.add("/node/modules/y/threads") == 1);
+      assert(set.add("/node/modules/z/threads") == 2);
+      assert(set.add("/node/list/0") == 3);
+      assert(set.add("/node") == 4);
+      assert(set.add("/node/modules/x/threads") == 0);
+      assert(set.add("/a~2") == -1);
+      Exception::clear();
+      assert(set.getCount() == 5);
+      assertStrCmp(set.getPath(1).getPath(), "/node/modules/y/threads");
+
+      DynamicObject values;
+      assert(set.get(d, values) == 4);
+      assert(values->length() == 5);
+      assert(values[0]->getUInt32() == 4);
+      assert(values[1]->getUInt32() == 8);
+      assert(values[2].isNull());
+      assertStrCmp(values[3]->getString(), "a");
+      assert(values[4] == d["node"]);
+
+      DynamicObject* found[5];
+      assert(set.find(d, found) == 4);
+      assert(found[2] == NULL);
+      assert(found[4] == &d["node"]);
    }
    tr.passIfNoException();
 
    tr.ungroup();
 }
 
-static void runDynoDiffTest(TestRunner& tr)
+static void runDynoCopyTest(TestRunner& tr)
 {
-   tr.group("DynamicObject diff");
+   tr.group("DynamicObject copy");
 
-   tr.test("no diff");
+   tr.test("impl");
    {
-      DynamicObject d1;
-      d1["a"] = true;
+      DynamicObject d;
+      d = "foo";
+      DynamicObjectImpl* diaddr = &(*d);
 
-      DynamicObject d2;
-      d2["a"] = true;
+      {
+         DynamicObject d2;
+         d2 = "bar";
+         *d = *d2;
+         assertStrCmp(d->getString(), d2->getString());
+         // string address compare
+         assert(d->getString() != d2->getString());
+         // clear to something else
+         d2->clear();
+      }
 
-      DynamicObject diff;
-      assert(!d1.diff(d2, diff));
+      assertStrCmp(d->getString(), "bar");
+
+      DynamicObject d3;
+      d3 = (int32_t)1;
+      *d = *d3;
+      assert(d->getType() == d3->getType());
+      assert(d->getType() == Int32);
+      assert(d->getInt32() == 1);
+
+      {
+         DynamicObject d4;
+         d4["cow"] = "moo";
+         d4["dog"] = "woof";
+         d4["deep"]["cat"] = "meow";
+         *d = *d4;
+         d4["deep"]["cat"] = "screech";
+      }
+
+      {
+         DynamicObject expect;
+         expect["cow"] = "moo";
+         expect["dog"] = "woof";
+         expect["deep"]["cat"] = "screech";
+         assert(d == expect);
+      }
+
+      {
+         DynamicObject d5;
+         d5[0] = "zero";
+         d5[1] = "one";
+         d5[2]["two"] = "deep";
+         *d = *d5;
+         d5[2]["two"] = "wide";
+      }
+
+      {
+         DynamicObject expect;
+         expect[0] = "zero";
+         expect[1] = "one";
+         expect[2]["two"] = "wide";
+         assert(d == expect);
+      }
+
+      assert(diaddr == &(*d));
    }
    tr.passIfNoException();
 
-   tr.test("basic types");
+   tr.ungroup();
+}
+
+static void runDynoReverseTest(TestRunner& tr)
+{
+   tr.group("DynamicObject reverse");
+
+   tr.test("str");
    {
-      DynamicObject d1;
-      d1 = true;
+      DynamicObject d;
+      d->setType(String);
 
-      DynamicObject d2;
-      d2 = true;
+      d->clear();
+      d->reverse();
+      assertStrCmp(d->getString(), "");
 
-      DynamicObject diff;
-      assert(!d1.diff(d2, diff));
+      d = "012";
+      d->reverse();
+      assertStrCmp(d->getString(), "210");
 
-      d2 = false;
-      DynamicObject expect;
-      expect["type"] = "valueChanged";
-      expect["source"] = true;
-      expect["target"] = false;
-      assert(d1.diff(d2, diff));
    }
    tr.passIfNoException();
 
-   tr.test("basic map");
+   tr.test("array");
    {
-      DynamicObject d1;
-      d1->setType(Map);
-
-      DynamicObject d2;
-      d2["a"] = true;
-
+      DynamicObject d;
+      d->setType(Array);
       DynamicObject expect;
-      DynamicObject diff;
+      expect->setType(Array);
 
-      // d1 diff d2
+      d->clear();
       expect->clear();
-      expect[0]["key"] = "a";
-      expect[0]["added"] = true;
-      assert(d1.diff(d2, diff));
-      assertDynoCmp(diff, expect);
+      d->reverse();
+      assert(d == expect);
 
-      // d2 diff d1 (reverse above)
+      d->clear();
       expect->clear();
-      expect[0]["key"] = "a";
-      expect[0]["removed"] = true;
-      assert(d2.diff(d1, diff));
-      assertDynoCmp(diff, expect);
+      d[0] = "zero";
+      d[1] = "one";
+      d[2] = "two";
+      d->reverse();
+      expect[0] = "two";
+      expect[1] = "one";
+      expect[2] = "zero";
+      assert(d == expect);
 
-      // d1 diff d2 (changed value)
-      d1["a"] = false;
+      d->clear();
       expect->clear();
-      expect[0]["key"] = "a";
-      expect[0]["changed"]["type"] = "valueChanged";
-      expect[0]["changed"]["source"] = false;
-      expect[0]["changed"]["target"] = true;
-      assert(d1.diff(d2, diff));
-      assertDynoCmp(diff, expect);
+      d[0]["zero"] = 0;
+      d[1]["one"] = 1;
+      d->reverse();
+      expect[0]["one"] = 1;
+      expect[1]["zero"] = 0;
+      assert(d == expect);
    }
    tr.passIfNoException();
 
-   tr.test("basic array");
-   {
-      DynamicObject d1;
-      d1->setType(Array);
-
-      DynamicObject d2;
-      d2[0] = true;
-
-      DynamicObject expect;
+   tr.ungroup();
+}
 
-      // d1 diff d2
-      DynamicObject diff;
-      expect[0]["index"] = 0;
-      expect[0]["added"] = true;
-      assert(d1.diff(d2, diff));
-      assertDynoCmp(diff, expect);
+static bool customSortTuples(DynamicObject a, DynamicObject b)
+{
+   return a[0] < b[0];
+}
 
-      // d2 diff d1 (reverse above)
-      expect->clear();
-      expect[0]["index"] = 0;
-      expect[0]["removed"] = true;
-      assert(d2.diff(d1, diff));
-      assertDynoCmp(diff, expect);
+struct StructCustomSortTuples : std::less<DynamicObject>
+{
+   bool operator()(DynamicObject a, DynamicObject b)
+   {
+      return a[0] < b[0];
    }
-   tr.passIfNoException();
+};
 
-   tr.test("deep 1");
+class ClassCustomSortTuples : public std::less<DynamicObject>
+{
+public:
+   virtual bool operator()(DynamicObject a, DynamicObject b)
    {
-      DynamicObject d1;
-      d1->setType(Map);
+      return a[0] < b[0];
+   }
+};
 
-      DynamicObject d2;
-      d2["a"]["a1"] = true;
-      d2["a"]["a2"] = 123;
-      d2["b"]["b1"] = "Hello, World!";
+static void runDynoSortTest(TestRunner& tr)
+{
+   tr.group("DynamicObject sort");
 
-      DynamicObject expect;
-      expect[0]["key"] = "a";
-      expect[0]["added"] = d2["a"].clone();
-      expect[1]["key"] = "b";
-      expect[1]["added"] = d2["b"].clone();
+   tr.test("default strings");
+   {
+      DynamicObject d;
+      d[0] = "b";
+      d[1] = "c";
+      d[2] = "a";
+      d[3] = "d";
+      d.sort();
 
-      DynamicObject diff;
-      assert(d1.diff(d2, diff));
-      assertDynoCmp(diff, expect);
+      DynamicObject expect;
+      expect[0] = "a";
+      expect[1] = "b";
+      expect[2] = "c";
+      expect[3] = "d";
+      assertDynoCmp(expect, d);
    }
    tr.passIfNoException();
 
-   tr.test("deep 2");
+   tr.test("default integers");
    {
-      DynamicObject d1;
-      d1["a"]["same"] = true;
-      d1["a"]["ch"] = 234;
-      d1["a"]["rem"] = 1;
-      d1["b"]["b1"] = "Hello, World!";
-
-      DynamicObject d2;
-      d2["a"]["same"] = true;
-      d2["a"]["ch"] = 123;
-      d2["a"]["add"] = 2;
-      d2["c"]["c1"] = "Hello, World!";
+      DynamicObject d;
+      d[0] = 2;
+      d[1] = 3;
+      d[2] = 1;
+      d[3] = 4;
+      d.sort();
 
       DynamicObject expect;
-      expect[0]["key"] = "a";
-      expect[0]["changed"][0]["key"] = "ch";
-      expect[0]["changed"][0]["changed"]["type"] = "valueChanged";
-      expect[0]["changed"][0]["changed"]["source"] = 234;
-      expect[0]["changed"][0]["changed"]["target"] = 123;
-      expect[0]["changed"][1]["key"] = "rem";
-      expect[0]["changed"][1]["removed"] = 1;
-      expect[0]["changed"][2]["key"] = "add";
-      expect[0]["changed"][2]["added"] = 2;
-      expect[1]["key"] = "b";
-      expect[1]["removed"]["b1"] = "Hello, World!";
-      expect[2]["key"] = "c";
-      expect[2]["added"]["c1"] = "Hello, World!";
-
-      DynamicObject diff;
-      assert(d1.diff(d2, diff));
-      assertDynoCmp(diff, expect);
+      expect[0] = 1;
+      expect[1] = 2;
+      expect[2] = 3;
+      expect[3] = 4;
+      assertDynoCmp(expect, d);
    }
    tr.passIfNoException();
 
-   tr.test("ints");
+   tr.test("sort with function");
    {
-      // common value
-      #define V 123
-
-      DynamicObject d1;
-      d1["u32-u32"] = (uint32_t)V;
-      d1["u32-u64"] = (uint32_t)V;
-      d1["u32-s32"] = (uint32_t)V;
-      d1["u32-s64"] = (uint32_t)V;
-
-      d1["s32-u32"] = (int32_t)V;
-      d1["s32-u64"] = (int32_t)V;
-      d1["s32-s32"] = (int32_t)V;
-      d1["s32-s64"] = (int32_t)V;
-
-      d1["u64-u32"] = (uint64_t)V;
-      d1["u64-u64"] = (uint64_t)V;
-      d1["u64-s32"] = (uint64_t)V;
-      d1["u64-s64"] = (uint64_t)V;
-
-      d1["s64-u32"] = (uint64_t)V;
-      d1["s64-u64"] = (int64_t)V;
-      d1["s64-s32"] = (int64_t)V;
-      d1["s64-s64"] = (int64_t)V;
-
-      DynamicObject d2;
-      d2["u32-u32"] = (uint32_t)V;
-      d2["u32-u64"] = (uint64_t)V;
-      d2["u32-s32"] = (int32_t)V;
-      d2["u32-s64"] = (int64_t)V;
+      DynamicObject d;
 
-      d2["s32-u32"] = (uint32_t)V;
-      d2["s32-u64"] = (uint64_t)V;
-      d2["s32-s32"] = (int32_t)V;
-      d2["s32-s64"] = (int64_t)V;
+      DynamicObject t1;
+      t1[0] = "b";
+      t1[1] = "foo1";
+      d[0] = t1;
 
-      d2["u64-u32"] = (uint32_t)V;
-      d2["u64-u64"] = (uint64_t)V;
-      d2["u64-s32"] = (int32_t)V;
-      d2["u64-s64"] = (int64_t)V;
+      DynamicObject t2;
+      t2[0] = "c";
+      t2[1] = "foo2";
+      d[1] = t2;
 
-      d2["s64-u32"] = (uint32_t)V;
-      d2["s64-u64"] = (uint64_t)V;
-      d2["s64-s32"] = (int32_t)V;
-      d2["s64-s64"] = (int64_t)V;
+      DynamicObject t3;
+      t3[0] = "a";
+      t3[1] = "foo3";
+      d[2] = t3;
 
-      #undef V
+      d.sort(&customSortTuples);
 
-      DynamicObject diff;
-      // types cause difference
-      assert(d1.diff(d2, diff, DynamicObject::DiffEqual));
-      assert(diff->length() == 12);
-      // no diff with comparisons using int64s
-      assert(!(d1.diff(d2, diff, DynamicObject::DiffIntegersAsInt64s)));
-      assert(diff->length() == 0);
+      DynamicObject expect;
+      expect[0] = t3;
+      expect[1] = t1;
+      expect[2] = t2;
+      assertDynoCmp(expect, d);
    }
    tr.passIfNoException();
 
-   tr.test("doubles");
+   tr.test("sort with object (struct)");
    {
-      #define V 1.23456789
+      DynamicObject d;
 
-      DynamicObject d1;
-      d1["d1"] = (double)V;
+      DynamicObject t1;
+      t1[0] = "b";
+      t1[1] = "foo1";
+      d[0] = t1;
 
-      DynamicObject d2;
-      // set and convert through a string back to a double
-      d2["d1"] = (double)V;
-      d2["d1"]->setType(String);
-      d2["d1"]->setType(Double);
+      DynamicObject t2;
+      t2[0] = "c";
+      t2[1] = "foo2";
+      d[1] = t2;
 
-      #undef V
+      DynamicObject t3;
+      t3[0] = "a";
+      t3[1] = "foo3";
+      d[2] = t3;
 
-      DynamicObject diff;
-      // not exact due to double->string->double conversion
-      assert(d1.diff(d2, diff, DynamicObject::DiffEqual));
-      assert(diff->length() == 1);
-      // no diff when compared as strings
-      assert(!(d1.diff(d2, diff, DynamicObject::DiffDoublesAsStrings)));
-      assert(diff->length() == 0);
+      StructCustomSortTuples compare;
+      d.sort(compare);
+
+      DynamicObject expect;
+      expect[0] = t3;
+      expect[1] = t1;
+      expect[2] = t2;
+      assertDynoCmp(expect, d);
    }
    tr.passIfNoException();
 
-   tr.test("array no diff");
+   tr.test("sort with object (class)");
    {
-      DynamicObject d1;
-      d1["a"][0] = "data";
+      DynamicObject d;
+
+      DynamicObject t1;
+      t1[0] = "b";
+      t1[1] = "foo1";
+      d[0] = t1;
+
+      DynamicObject t2;
+      t2[0] = "c";
+      t2[1] = "foo2";
+      d[1] = t2;
+
+      DynamicObject t3;
+      t3[0] = "a";
+      t3[1] = "foo3";
+      d[2] = t3;
 
-      DynamicObject d2;
-      d2["a"][0] = "data";
+      ClassCustomSortTuples compare;
+      d.sort(compare);
 
-      DynamicObject diff;
       DynamicObject expect;
-      expect->setType(Map);
-      assert(!d1.diff(d2, diff));
-      assert(diff->length() == 0);
-      assert(!d2.diff(d1, diff));
-      assert(diff->length() == 0);
+      expect[0] = t3;
+      expect[1] = t1;
+      expect[2] = t2;
    }
    tr.passIfNoException();
 
-   tr.test("array added/removed diffs");
-   {
-      DynamicObject d1;
-      d1["a"]->setType(Array);
-
-      DynamicObject d2;
-      d2["a"]->setType(Array);
-      DynamicObject d3;
-      d3 = "data";
-      d2["a"]->append(d3);
+   tr.ungroup();
+}
 
-      DynamicObject diff;
+static void runDynoMapTest(TestRunner& tr)
+{
+   tr.group("DynamicObject map");
 
+   tr.test("promote");
+   {
+      DynamicObject d;
+      DynamicObject& first = d["m00"];
+      first = 0;
+      char name[16];
+      for(int i = 40; i > 0; --i)
       {
-         DynamicObject expect;
-         expect[0]["key"] = "a";
-         expect[0]["changed"][0]["index"] = 0;
-         expect[0]["changed"][0]["added"] = "data";
-         assert(d1.diff(d2, diff));
-         assertDynoCmp(diff, expect);
+         snprintf(name, 16, "m%02d", i);
+         d[name] = i;
       }
+      assert(d->length() == 41);
+      assert(first->getInt32() == 0);
+      assert(&first == &d["m00"]);
 
+      // iteration must be in sorted order
+      int count = 0;
+      DynamicObjectIterator i = d.getIterator();
+      while(i->hasNext())
       {
-         DynamicObject expect;
-         expect[0]["key"] = "a";
-         expect[0]["changed"][0]["index"] = 0;
-         expect[0]["changed"][0]["removed"] = "data";
-         assert(d2.diff(d1, diff));
-         assertDynoCmp(diff, expect);
+         DynamicObject& next = i->next();
+         snprintf(name, 16, "m%02d", count);
+         assertStrCmp(i->getName(), name);
+         assert(next->getInt32() == count);
+         ++count;
       }
+      assert(count == 41);
    }
    tr.passIfNoException();
 
-   tr.test("array changed diffs");
+   tr.test("modify while iterating");
    {
-      DynamicObject d1;
-      d1["a"][0] = "1";
-
-      DynamicObject d2;
-      d2["a"][0] = "2";
-
-      DynamicObject expect;
-      expect[0]["key"] = "a";
-      expect[0]["changed"][0]["index"] = 0;
-      expect[0]["changed"][0]["changed"]["type"] = "valueChanged";
-      expect[0]["changed"][0]["changed"]["source"] = "1";
-      expect[0]["changed"][0]["changed"]["target"] = "2";
-
-      DynamicObject diff;
-      assert(d1.diff(d2, diff));
-      assertDynoCmp(diff, expect);
+      DynamicObject d;
+      d["a"] = 1;
+      d["c"] = 3;
+      d["e"] = 5;
+      DynamicObjectIterator i = d.getIterator();
+      i->next();
+      assertStrCmp(i->getName(), "a");
+      d["d"] = 4;
+      d->removeMember("a");
+      i->next();
+      assertStrCmp(i->getName(), "c");
+      i->remove();
+      i->next();
+      assertStrCmp(i->getName(), "d");
+      i->next();
+      assertStrCmp(i->getName(), "e");
+      assert(!i->hasNext());
+      assert(d->length() == 2);
+      assert(!d->hasMember("c"));
    }
    tr.passIfNoException();
 
-   tr.test("map no diff");
-   {
-      DynamicObject d1;
-      d1["a"]["b"] = "data";
+   tr.ungroup();
+}
 
-      DynamicObject d2;
-      d2["a"]["b"] = "data";
+static void runDynoPackedTest(TestRunner& tr)
+{
+   tr.group("DynamicObject packed");
 
-      DynamicObject diff;
-      DynamicObject expect;
-      expect->setType(Map);
-      assert(!d1.diff(d2, diff));
-      assert(diff->length() == 0);
-      assert(!d2.diff(d1, diff));
-      assert(diff->length() == 0);
+   tr.test("short strings");
+   {
+      DynamicObject d;
+      d = "short";
+      assertStrCmp(d->getString(), "short");
+      d = d->getString() + 1;
+      assertStrCmp(d->getString(), "hort");
+      d = "a string that is too long to be stored in place";
+      assertStrCmp(
+         d->getString(), "a string that is too long to be stored in place");
+      d = d->getString() + 39;
+      assertStrCmp(d->getString(), "in place");
+      d->reverse();
+      assertStrCmp(d->getString(), "ecalp ni");
+      DynamicObject copy;
+      *copy = *d;
+      d = "";
+      assertStrCmp(copy->getString(), "ecalp ni");
+      assert(d->length() == 0);
    }
    tr.passIfNoException();
 
-   tr.test("map added/removed diffs");
+   tr.test("packed array");
    {
-      DynamicObject d1;
-      d1["a"]->setType(Map);
-
-      DynamicObject d2;
-      d2["a"]["b"] = "data";
-
-      DynamicObject diff;
-
+      DynamicObject d;
+      d->setPackedType(Int64);
+      assert(d->getType() == Array);
+      assert(d->getPackedType() == Int64);
+      for(int64_t i = 0; i < 100; ++i)
       {
-         DynamicObject expect;
-         expect[0]["key"] = "a";
-         expect[0]["changed"][0]["key"] = "b";
-         expect[0]["changed"][0]["added"] = "data";
-         assert(d1.diff(d2, diff));
-         assertDynoCmp(diff, expect);
+         d->appendPacked(i);
       }
-
+      assert(d->length() == 100);
+      const int64_t* data = static_cast<const int64_t*>(d->getPackedData());
+      assert(data != NULL);
+      assert(data[99] == 99);
+
+      // packed operations
+      DynamicObject pop = d->pop();
+      assert(pop->getType() == Int64);
+      assert(pop->getInt64() == 99);
+      d->removeIndex(0);
+      d->removeIndex(-1);
+      assert(d->length() == 97);
+      d->reverse();
+      DynamicObject copy = d.clone();
+      assert(copy->getPackedType() == Int64);
+      assert(d == copy);
+      assert(d->getPackedType() == Int64);
+
+      // writing packed arrays
+      DynamicObject small;
+      small->setPackedType(UInt32);
+      small->appendPacked((uint32_t)1);
+      small->appendPacked((uint32_t)2);
+      assertStrCmp(
+         monarch::data::json::JsonWriter::writeToString(
+            small, true).c_str(), "[1,2]");
+      assert(small->getPackedType() == UInt32);
+
+      // reading elements
+      assert(d[0]->getInt64() == 97);
+      assert(d[96]->getInt64() == 1);
+      assert(d->getPackedType() == Array);
+      assert(d->getPackedData() == NULL);
+      d[0] = "changed";
+      assertStrCmp(d[0]->getString(), "changed");
+      assert(d->length() == 97);
+
+      // iterating
+      int count = 0;
+      DynamicObjectIterator i = copy.getIterator();
+      while(i->hasNext())
       {
-         DynamicObject expect;
-         expect[0]["key"] = "a";
-         expect[0]["changed"][0]["key"] = "b";
-         expect[0]["changed"][0]["removed"] = "data";
-         assert(d2.diff(d1, diff));
-         assertDynoCmp(diff, expect);
+         DynamicObject& next = i->next();
+         assert(next->getInt64() == 97 - count);
+         ++count;
       }
+      assert(count == 97);
    }
    tr.passIfNoException();
 
-   tr.test("map changed diffs");
+   tr.test("pack and unpack");
    {
-      DynamicObject d1;
-      d1["a"][0] = "1";
-
-      DynamicObject d2;
-      d2["a"][0] = "2";
-
+      DynamicObject d;
+      d->append(1);
+      d->append("2.5");
+      d->setPackedType(Double);
+      assert(d->getPackedType() == Double);
+      const double* data = static_cast<const double*>(d->getPackedData());
+      assert(data[0] == 1.0);
+      assert(data[1] == 2.5);
+
+      // appending another type unpacks
+      d->appendPacked((int32_t)3);
+      assert(d->getPackedType() == Array);
+      assert(d->length() == 3);
+      assert(d[1]->getType() == Double);
+      assert(d[2]->getType() == Int32);
+
+      // growing unpacks
+      d->setPackedType(Int32);
+      assert(d[1]->getInt32() == 2);
+      d[4] = 5;
+      assert(d->length() == 5);
+      assert(d[3]->getType() == String);
+
+      // unset elements convert to 0
+      d->setPackedType(UInt64);
+      d->appendPacked((uint64_t)6);
+      assert(d->length() == 6);
       DynamicObject expect;
-      expect[0]["key"] = "a";
-      expect[0]["changed"][0]["index"] = 0;
-      expect[0]["changed"][0]["changed"]["type"] = "valueChanged";
-      expect[0]["changed"][0]["changed"]["source"] = "1";
-      expect[0]["changed"][0]["changed"]["target"] = "2";
+      expect->setPackedType(UInt64);
+      uint64_t values[] = {1, 2, 3, 0, 5, 6};
+      for(int n = 0; n < 6; ++n)
+      {
+         expect->appendPacked(values[n]);
+      }
+      assert(d == expect);
+      d->setPackedType(String);
+      assert(d->getPackedType() == Array);
+      assert(d[5]->getType() == UInt64);
+      assert(d == expect);
 
-      DynamicObject diff;
-      assert(d1.diff(d2, diff));
-      assertDynoCmp(diff, expect);
+      // appending an empty element unpacks
+      DynamicObject d2;
+      d2->setPackedType(Int32);
+      d2->appendPacked((int32_t)1);
+      d2->append() = "2";
+      assert(d2->getPackedType() == Array);
+      assert(d2->length() == 2);
+      assert(d2[0]->getInt32() == 1);
+      assertStrCmp(d2[1]->getString(), "2");
    }
    tr.passIfNoException();
 
    tr.ungroup();
 }
 
-static void runDynoCopyTest(TestRunner& tr)
+static void runDynoFreezeTest(TestRunner& tr)
 {
-   tr.group("DynamicObject copy");
+   tr.group("DynamicObject freeze");
 
-   tr.test("impl");
+   tr.test("freeze");
    {
       DynamicObject d;
-      d = "foo";
-      DynamicObjectImpl* diaddr = &(*d);
-
-      {
-         DynamicObject d2;
-         d2 = "bar";
-         *d = *d2;
-         assertStrCmp(d->getString(), d2->getString());
-         // string address compare
-         assert(d->getString() != d2->getString());
-         // clear to something else
-         d2->clear();
-      }
-
-      assertStrCmp(d->getString(), "bar");
+      d["a"] = 1;
+      d["b"]["c"] = "c";
+      d["d"]->append(true);
+      d["e"]->setPackedType(Int32);
+      d["e"]->appendPacked((int32_t)5);
+      assert(!d->isFrozen());
+      d.freeze();
+      assert(d->isFrozen());
+      assert(d["b"]->isFrozen());
+      assert(d["b"]["c"]->isFrozen());
+      assert(d["d"][0]->isFrozen());
+      assert(d["e"][0]->isFrozen());
+      assert(d["e"][0]->getInt32() == 5);
+   }
+   tr.passIfNoException();
 
-      DynamicObject d3;
-      d3 = (int32_t)1;
-      *d = *d3;
-      assert(d->getType() == d3->getType());
-      assert(d->getType() == Int32);
-      assert(d->getInt32() == 1);
+   tr.test("copy on write");
+   {
+      DynamicObject d;
+      d["a"] = 1;
+      d["b"]["c"] = "c";
+      d["b"]["d"] = "d";
+      d["e"]->append(1);
+      d["e"]->append(2);
+      d.freeze();
+      DynamicObject expect = d.clone();
+      assert(!expect->isFrozen());
+      assert(expect == d);
+
+      // read without copying
+      DynamicObject c = d.clone();
+      assert(!c->isFrozen());
+      assert(c->length() == 3);
+      assert(c->hasMember("b"));
+      assert(c == d);
+
+      // modify
+      c["b"]["c"] = "changed";
+      assert(c["b"] != d["b"]);
+      assertStrCmp(c["b"]["c"]->getString(), "changed");
+      assertStrCmp(d["b"]["c"]->getString(), "c");
+      c["e"]->append(3);
+      assert(c["e"]->length() == 3);
+      assert(d["e"]->length() == 2);
+      DynamicObject a;
+      a->append(1);
+      a.freeze();
+      DynamicObject ac = a.clone();
+      ac->append() = 2;
+      assert(ac->length() == 2);
+      assert(a->length() == 1);
+      assert(a[0]->getInt32() == 1);
+      c->removeMember("a");
+      assert(d->hasMember("a"));
+      assert(d == expect);
 
-      {
-         DynamicObject d4;
-         d4["cow"] = "moo";
-         d4["dog"] = "woof";
-         d4["deep"]["cat"] = "meow";
-         *d = *d4;
-         d4["deep"]["cat"] = "screech";
-      }
+      // clone of an unmodified clone
+      DynamicObject c2 = c["e"].clone();
+      c2->clear();
+      assert(c2->length() == 0);
+      assert(c["e"]->length() == 3);
 
-      {
-         DynamicObject expect;
-         expect["cow"] = "moo";
-         expect["dog"] = "woof";
-         expect["deep"]["cat"] = "screech";
-         assert(d == expect);
-      }
+      // freezing an unmodified clone uses the source
+      DynamicObject c3 = d["b"].clone();
+      c3.freeze();
+      assert(&(*c3) == &(*d["b"]));
 
-      {
-         DynamicObject d5;
-         d5[0] = "zero";
-         d5[1] = "one";
-         d5[2]["two"] = "deep";
-         *d = *d5;
-         d5[2]["two"] = "wide";
-      }
+      // freezing a tree with unmodified clones
+      DynamicObject c4;
+      c4["x"] = d["b"].clone();
+      c4.freeze();
+      assert(&(*c4["x"]) == &(*d["b"]));
 
+      // iterating
+      int count = 0;
+      DynamicObject c5 = d.clone();
+      DynamicObjectIterator i = c5.getIterator();
+      while(i->hasNext())
       {
-         DynamicObject expect;
-         expect[0] = "zero";
-         expect[1] = "one";
-         expect[2]["two"] = "wide";
-         assert(d == expect);
+         DynamicObject& next = i->next();
+         next = count++;
       }
-
-      assert(diaddr == &(*d));
+      assert(count == 3);
+      assert(d == expect);
    }
    tr.passIfNoException();
 
    tr.ungroup();
 }
 
-static void runDynoReverseTest(TestRunner& tr)
+static void runStringTableTest(TestRunner& tr)
 {
-   tr.group("DynamicObject reverse");
+   tr.group("StringTable");
 
-   tr.test("str");
+   tr.test("intern");
    {
-      DynamicObject d;
-      d->setType(String);
-
-      d->clear();
-      d->reverse();
-      assertStrCmp(d->getString(), "");
-
-      d = "012";
-      d->reverse();
-      assertStrCmp(d->getString(), "210");
-
+      StringTable table;
+      bool hit;
+      char buf[] = "member";
+      const char* s1 = table.intern(buf, &hit);
+      assert(!hit);
+      assert(StringTable::isInterned(s1));
+      assert(s1 != buf);
+      assertStrCmp(s1, "member");
+      const char* s2 = table.intern("member", &hit);
+      assert(hit);
+      assert(s1 == s2);
+      const char* s3 = table.intern("other", &hit);
+      assert(!hit);
+      assert(s1 != s3);
+      assert(table.getCount() == 2);
+      StringTable::release(s1);
+      StringTable::release(s2);
+      StringTable::release(s3);
    }
    tr.passIfNoException();
 
-   tr.test("array");
+   tr.test("limits");
    {
-      DynamicObject d;
-      d->setType(Array);
-      DynamicObject expect;
-      expect->setType(Array);
-
-      d->clear();
-      expect->clear();
-      d->reverse();
-      assert(d == expect);
-
-      d->clear();
-      expect->clear();
-      d[0] = "zero";
-      d[1] = "one";
-      d[2] = "two";
-      d->reverse();
-      expect[0] = "two";
-      expect[1] = "one";
-      expect[2] = "zero";
-      assert(d == expect);
+      StringTable table(31, 1, 4);
+      const char* s1 = table.intern("toolong");
+      assert(!StringTable::isInterned(s1));
+      assertStrCmp(s1, "toolong");
+      const char* s2 = table.intern("abc");
+      assert(StringTable::isInterned(s2));
+      const char* s3 = table.intern("def");
+      assert(!StringTable::isInterned(s3));
+      assertStrCmp(s3, "def");
+      assert(table.intern("abc") == s2);
+      assert(table.getCount() == 1);
+      StringTable::release(s1);
+      StringTable::release(s2);
+      StringTable::release(s3);
+   }
+   tr.passIfNoException();
 
-      d->clear();
-      expect->clear();
-      d[0]["zero"] = 0;
-      d[1]["one"] = 1;
-      d->reverse();
-      expect[0]["one"] = 1;
-      expect[1]["zero"] = 0;
-      assert(d == expect);
+   tr.test("dyno keys");
+   {
+      DynamicObject d1;
+      d1["key"] = 1;
+      DynamicObject d2;
+      d2["key"] = 2;
+      DynamicObjectIterator i1 = d1.getIterator();
+      i1->next();
+      DynamicObjectIterator i2 = d2.getIterator();
+      i2->next();
+      assert(i1->getName() == i2->getName());
+      DynamicObject d3 = d1.clone();
+      assert(d1 == d3);
+      d3->removeMember("key");
+      assert(!d3->hasMember("key"));
+      assert(d1->hasMember("key"));
    }
    tr.passIfNoException();
 
    tr.ungroup();
 }
 
-static bool customSortTuples(DynamicObject a, DynamicObject b)
+class HistogramRecorder : public Runnable
 {
-   return a[0] < b[0];
-}
+public:
+   LatencyHistogram* mHistogram;
+   uint64_t mCount;
+   HistogramRecorder(LatencyHistogram* h, uint64_t count) :
+      mHistogram(h), mCount(count) {}
+   virtual ~HistogramRecorder() {}
 
-struct StructCustomSortTuples : std::less<DynamicObject>
+   virtual void run()
+   {
+      for(uint64_t i = 1; i <= mCount; ++i)
+      {
+         mHistogram->record(i);
+      }
+   }
+};
+
+static void runLatencyHistogramTest(TestRunner& tr)
 {
-   bool operator()(DynamicObject a, DynamicObject b)
+   tr.group("LatencyHistogram");
+
+   tr.test("buckets");
    {
-      return a[0] < b[0];
+      // every value is at most its bucket's limit and more than the limit
+      // of the bucket before it, and limits are within 12.5% of each other
+      for(uint64_t v = 0; v < 100000; ++v)
+      {
+         int b = LatencyHistogram::getBucket(v);
+         assert(v <= LatencyHistogram::getBucketLimit(b));
+         assert(b == 0 || v > LatencyHistogram::getBucketLimit(b - 1));
+      }
+      assert(LatencyHistogram::getBucket(7) == 7);
+      assert(LatencyHistogram::getBucketLimit(7) == 7);
+      assert(LatencyHistogram::getBucketLimit(
+         LatencyHistogram::getBucket(1000)) <= 1125);
+      assert(LatencyHistogram::getBucket(~(uint64_t)0) ==
+         LatencyHistogram::BucketCount - 1);
+      assert(LatencyHistogram::getBucketLimit(
+         LatencyHistogram::BucketCount - 1) == ~(uint64_t)0);
+   }
+   tr.passIfNoException();
+
+   tr.test("percentiles");
+   {
+      LatencyHistogram h;
+      assert(h.getPercentile(50) == 0);
+      for(uint64_t v = 1; v <= 1000; ++v)
+      {
+         h.record(v);
+      }
+      assert(h.getCount() == 1000);
+      assert(h.getAverage() == 500);
+      assert(h.getMax() == 1000);
+
+      // estimates are within a bucket of the real percentile
+      uint64_t p50 = h.getPercentile(50);
+      assert(p50 >= 500 && p50 <= 500 * 9 / 8);
+      uint64_t p99 = h.getPercentile(99);
+      assert(p99 >= 990 && p99 <= 1000);
+      assert(h.getPercentile(100) == 1000);
+
+      DynamicObject stats = h.getStats();
+      assert(stats["count"]->getUInt64() == 1000);
+      assert(stats["p50"]->getUInt64() == p50);
+      assert(stats["p99"]->getUInt64() == p99);
+      assert(stats["max"]->getUInt64() == 1000);
+
+      h.reset();
+      assert(h.getCount() == 0);
+      assert(h.getMax() == 0);
+      assert(h.getPercentile(99) == 0);
+   }
+   tr.passIfNoException();
+
+   tr.test("concurrent");
+   {
+      LatencyHistogram h;
+      const int count = 4;
+      HistogramRecorder* r[count];
+      Thread* t[count];
+      for(int i = 0; i < count; ++i)
+      {
+         r[i] = new HistogramRecorder(&h, 100000);
+         t[i] = new Thread(r[i]);
+         t[i]->start();
+      }
+      for(int i = 0; i < count; ++i)
+      {
+         t[i]->join();
+         delete t[i];
+         delete r[i];
+      }
+      assert(h.getCount() == 400000);
+      assert(h.getAverage() == 50000);
+      assert(h.getMax() == 100000);
    }
+   tr.passIfNoException();
+
+   tr.ungroup();
+}
+
+struct IntAsHash
+{
+   int operator()(int key) const
+   {
+      return key;
+   };
 };
 
-class ClassCustomSortTuples : public std::less<DynamicObject>
+class CacheMashRunnable : public Runnable
 {
 public:
-   virtual bool operator()(DynamicObject a, DynamicObject b)
+   ClockCache<int, int, IntAsHash>* mCache;
+   uint32_t mOps;
+   uint32_t mKeys;
+   uint32_t mGets;
+   uint32_t mBadValues;
+   CacheMashRunnable(
+      ClockCache<int, int, IntAsHash>* cache, uint32_t ops, uint32_t keys) :
+      mCache(cache), mOps(ops), mKeys(keys), mGets(0), mBadValues(0) {}
+   virtual ~CacheMashRunnable() {}
+
+   virtual void run()
    {
-      return a[0] < b[0];
+      // store a value after every few lookups, values are always key * 2
+      int v;
+      for(uint32_t i = 0; i < mOps; ++i)
+      {
+         int key = (i * 7) % mKeys;
+         if(i % 4 == 0)
+         {
+            mCache->put(key, key * 2);
+         }
+         else
+         {
+            ++mGets;
+            if(mCache->get(key, v) && v != key * 2)
+            {
+               ++mBadValues;
+            }
+         }
+      }
    }
 };
 
-static void runDynoSortTest(TestRunner& tr)
+static void runClockCacheTest(TestRunner& tr)
 {
-   tr.group("DynamicObject sort");
+   tr.group("ClockCache");
 
-   tr.test("default strings");
+   tr.test("count limit");
    {
-      DynamicObject d;
-      d[0] = "b";
-      d[1] = "c";
-      d[2] = "a";
-      d[3] = "d";
-      d.sort();
+      ClockCache<int, int, IntAsHash> cache(3);
+      int v;
+      cache.put(1, 10);
+      cache.put(2, 20);
+      cache.put(3, 30);
+      assert(cache.get(1, v));
+      assert(v == 10);
+
+      // 1 was referenced, so 2 is evicted first
+      cache.put(4, 40);
+      assert(cache.getCount() == 3);
+      assert(!cache.get(2, v));
+      assert(cache.get(1, v));
+      assert(cache.get(3, v));
+      assert(cache.get(4, v));
+      assert(v == 40);
+
+      // replacing a value does not evict anything
+      cache.put(4, 41);
+      assert(cache.getCount() == 3);
+      assert(cache.get(4, v));
+      assert(v == 41);
+
+      DynamicObject stats = cache.getStats();
+      assert(stats["count"]->getUInt32() == 3);
+      assert(stats["hits"]->getUInt64() == 5);
+      assert(stats["misses"]->getUInt64() == 1);
+      assert(stats["evictions"]->getUInt64() == 1);
+      assert(stats["expirations"]->getUInt64() == 0);
+
+      cache.resetStats();
+      stats = cache.getStats();
+      assert(stats["hits"]->getUInt64() == 0);
+      assert(stats["count"]->getUInt32() == 3);
+   }
+   tr.passIfNoException();
 
-      DynamicObject expect;
-      expect[0] = "a";
-      expect[1] = "b";
-      expect[2] = "c";
-      expect[3] = "d";
-      assertDynoCmp(expect, d);
+   tr.test("size limit");
+   {
+      ClockCache<int, int, IntAsHash> cache(0, 10);
+      int v;
+      assert(cache.put(1, 10, 6));
+      assert(cache.put(2, 20, 4));
+      assert(cache.getSize() == 10);
+      assert(cache.put(3, 30, 5));
+      assert(cache.getSize() == 9);
+      assert(!cache.get(1, v));
+      assert(cache.get(2, v));
+      assert(cache.get(3, v));
+
+      // too large to cache, but replaces the old value
+      assert(!cache.put(2, 21, 11));
+      assert(!cache.get(2, v));
+      assert(cache.getCount() == 1);
+      assert(cache.getSize() == 5);
    }
    tr.passIfNoException();
 
-   tr.test("default integers");
+   tr.test("ttl");
    {
-      DynamicObject d;
-      d[0] = 2;
-      d[1] = 3;
-      d[2] = 1;
-      d[3] = 4;
-      d.sort();
+      ClockCache<int, int, IntAsHash> cache(0, 0, 60000);
+      int v;
+      cache.put(1, 10, 1, 1);
+      cache.put(2, 20);
+      Thread::sleep(10);
+      assert(!cache.get(1, v));
+      assert(cache.get(2, v));
+      assert(cache.getCount() == 2);
+      cache.removeExpired();
+      assert(cache.getCount() == 1);
+      assert(cache.getStats()["expirations"]->getUInt64() == 1);
+   }
+   tr.passIfNoException();
 
-      DynamicObject expect;
-      expect[0] = 1;
-      expect[1] = 2;
-      expect[2] = 3;
-      expect[3] = 4;
-      assertDynoCmp(expect, d);
+   tr.test("remove/clear");
+   {
+      ClockCache<int, int, IntAsHash> cache(10);
+      int v;
+      cache.put(1, 10);
+      cache.put(2, 20);
+      assert(cache.remove(1));
+      assert(!cache.remove(1));
+      assert(!cache.get(1, v));
+      cache.put(1, 11);
+      assert(cache.get(1, v));
+      assert(v == 11);
+      cache.clear();
+      assert(cache.getCount() == 0);
+      assert(cache.getSize() == 0);
+      assert(!cache.get(2, v));
+      cache.put(2, 22);
+      assert(cache.get(2, v));
+      assert(v == 22);
    }
    tr.passIfNoException();
 
-   tr.test("sort with function");
+   tr.test("string keys");
    {
+      ClockCache<string, DynamicObject, StringHashFunction, StringEqualsFunction>
+         cache(2);
       DynamicObject d;
+      d["foo"] = "bar";
+      cache.put("a", d);
+      cache.put(string("b"), d);
+      DynamicObject out;
+      assert(cache.get("a", out));
+      assert(out == d);
+      cache.put("c", d);
+      assert(!cache.get("b", out));
+      assert(cache.get("c", out));
+   }
+   tr.passIfNoException();
 
-      DynamicObject t1;
-      t1[0] = "b";
-      t1[1] = "foo1";
-      d[0] = t1;
-
-      DynamicObject t2;
-      t2[0] = "c";
-      t2[1] = "foo2";
-      d[1] = t2;
+   tr.test("threads");
+   {
+      ClockCache<int, int, IntAsHash> cache(50);
+      const uint32_t count = 8;
+      CacheMashRunnable* r[count];
+      Thread* t[count];
+      for(uint32_t i = 0; i < count; ++i)
+      {
+         r[i] = new CacheMashRunnable(&cache, 20000, 201);
+         t[i] = new Thread(r[i]);
+         t[i]->start();
+      }
+      uint64_t gets = 0;
+      for(uint32_t i = 0; i < count; ++i)
+      {
+         t[i]->join();
+         gets += r[i]->mGets;
+         assert(r[i]->mBadValues == 0);
+         delete t[i];
+         delete r[i];
+      }
+      assert(cache.getCount() <= 50);
+      DynamicObject stats = cache.getStats();
+      assert(stats["hits"]->getUInt64() + stats["misses"]->getUInt64() == gets);
+      assert(stats["evictions"]->getUInt64() > 0);
+   }
+   tr.passIfNoException();
 
-      DynamicObject t3;
-      t3[0] = "a";
-      t3[1] = "foo3";
-      d[2] = t3;
+   tr.ungroup();
+}
 
-      d.sort(&customSortTuples);
+static void runTimingWheelTest(TestRunner& tr)
+{
+   tr.group("TimingWheel");
 
-      DynamicObject expect;
-      expect[0] = t3;
-      expect[1] = t1;
-      expect[2] = t2;
-      assertDynoCmp(expect, d);
+   tr.test("once");
+   {
+      TimingWheel wheel;
+      volatile uint32_t count = 0;
+      RunnableRef r = new CountingJob(&count);
+      uint64_t now = System::getCurrentMilliseconds();
+      wheel.schedule(r, 100);
+      wheel.schedule(r, 200);
+      assert(wheel.getTimerCount() == 2);
+      assert(wheel.getNextTimeout(now) > 0);
+      assert(wheel.advance(now + 50) == 0);
+      assert(count == 0);
+      assert(wheel.advance(now + 150) == 1);
+      assert(count == 1);
+      assert(wheel.advance(now + 250) == 1);
+      assert(count == 2);
+      assert(wheel.getTimerCount() == 0);
+      assert(wheel.getNextTimeout(now + 250) == 0);
    }
    tr.passIfNoException();
 
-   tr.test("sort with object (struct)");
+   tr.test("cascade");
    {
-      DynamicObject d;
-
-      DynamicObject t1;
-      t1[0] = "b";
-      t1[1] = "foo1";
-      d[0] = t1;
-
-      DynamicObject t2;
-      t2[0] = "c";
-      t2[1] = "foo2";
-      d[1] = t2;
+      // each delay is only reached by a higher wheel
+      TimingWheel wheel;
+      volatile uint32_t count = 0;
+      RunnableRef r = new CountingJob(&count);
+      uint64_t now = System::getCurrentMilliseconds();
+      uint32_t delays[] = { 300, 70000, 20000000, 4000000000U };
+      for(int i = 0; i < 4; ++i)
+      {
+         wheel.schedule(r, delays[i]);
+      }
+      for(int i = 0; i < 4; ++i)
+      {
+         assert(wheel.advance(now + delays[i] - 100) == 0);
+         assert(wheel.getNextTimeout(now + delays[i] - 100) <= 110);
+         assert(wheel.advance(now + delays[i] + 100) == 1);
+         assert(count == (uint32_t)i + 1);
+      }
+      assert(wheel.getTimerCount() == 0);
+   }
+   tr.passIfNoException();
 
-      DynamicObject t3;
-      t3[0] = "a";
-      t3[1] = "foo3";
-      d[2] = t3;
+   tr.test("cancel");
+   {
+      TimingWheel wheel;
+      volatile uint32_t count = 0;
+      RunnableRef r = new CountingJob(&count);
+      uint64_t now = System::getCurrentMilliseconds();
+      TimingWheel::TimerRef t1 = wheel.schedule(r, 100);
+      TimingWheel::TimerRef t2 = wheel.schedule(r, 100000);
+      wheel.schedule(r, 100);
+      assert(wheel.cancel(t1));
+      assert(!wheel.cancel(t1));
+      assert(wheel.cancel(t2));
+      assert(wheel.getTimerCount() == 1);
+      assert(wheel.advance(now + 200000) == 1);
+      assert(count == 1);
+      wheel.schedule(r, 100);
+      wheel.clear();
+      assert(wheel.getTimerCount() == 0);
+      assert(wheel.advance(now + 400000) == 0);
+   }
+   tr.passIfNoException();
 
-      StructCustomSortTuples compare;
-      d.sort(compare);
+   tr.test("periodic");
+   {
+      TimingWheel wheel;
+      volatile uint32_t count = 0;
+      RunnableRef r = new CountingJob(&count);
+      uint64_t now = System::getCurrentMilliseconds();
+      TimingWheel::TimerRef t = wheel.schedule(r, 50, 20);
+      assert(wheel.advance(now + 40) == 0);
+      for(uint32_t i = 0; i < 10; ++i)
+      {
+         wheel.advance(now + 60 + i * 20);
+         assert(count == i + 1);
+      }
 
-      DynamicObject expect;
-      expect[0] = t3;
-      expect[1] = t1;
-      expect[2] = t2;
-      assertDynoCmp(expect, d);
+      // missed intervals are skipped
+      wheel.advance(now + 1000);
+      assert(count == 11);
+      assert(wheel.getTimerCount() == 1);
+      assert(wheel.cancel(t));
+      wheel.advance(now + 2000);
+      assert(count == 11);
    }
    tr.passIfNoException();
 
-   tr.test("sort with object (class)");
+   tr.test("100k timers");
    {
-      DynamicObject d;
+      TimingWheel wheel;
+      volatile uint32_t count = 0;
+      RunnableRef r = new CountingJob(&count);
+      const uint32_t timers = 100000;
+      std::vector<TimingWheel::TimerRef> refs;
+      refs.reserve(timers);
+      uint64_t start = System::getCurrentMicroseconds();
+      for(uint32_t i = 0; i < timers; ++i)
+      {
+         refs.push_back(wheel.schedule(r, (i * 7919) % 600000));
+      }
+      for(uint32_t i = 0; i < timers; i += 2)
+      {
+         assert(wheel.cancel(refs[i]));
+      }
+      uint64_t now = System::getCurrentMilliseconds();
+      uint32_t ran = 0;
+      for(uint64_t t = now; t <= now + 600000; t += 1000)
+      {
+         ran += wheel.advance(t);
+      }
+      uint64_t time = System::getCurrentMicroseconds() - start;
+      assert(ran == timers / 2);
+      assert(count == timers / 2);
+      assert(wheel.getTimerCount() == 0);
+      printf("time=%" PRIu64 " us...", time);
+   }
+   tr.passIfNoException();
 
-      DynamicObject t1;
-      t1[0] = "b";
-      t1[1] = "foo1";
-      d[0] = t1;
+   tr.test("thread");
+   {
+      TimingWheel wheel;
+      volatile uint32_t count = 0;
+      RunnableRef r = new CountingJob(&count);
+      assert(wheel.start());
+      wheel.schedule(r, 20);
+      wheel.schedule(r, 10, 10);
+      assert(waitForCount(&count, 6));
+      wheel.stop();
+      wheel.clear();
+   }
+   tr.passIfNoException();
 
-      DynamicObject t2;
-      t2[0] = "c";
-      t2[1] = "foo2";
-      d[1] = t2;
+   tr.test("ThreadPool expire");
+   {
+      ThreadPool pool(3);
+      pool.setThreadExpireTime(50);
+      volatile uint32_t count = 0;
+      CountingJob job(&count);
+      pool.runJob(job);
+      pool.runJob(job);
+      assert(waitForCount(&count, 2));
+      for(int i = 0; pool.getThreadCount() > 0 && i < 1000; ++i)
+      {
+         Thread::sleep(1);
+      }
+      assert(pool.getThreadCount() == 0);
+      pool.runJob(job);
+      assert(waitForCount(&count, 3));
+      pool.terminateAllThreads();
+   }
+   tr.passIfNoException();
 
-      DynamicObject t3;
-      t3[0] = "a";
-      t3[1] = "foo3";
-      d[2] = t3;
+   tr.test("shared");
+   {
+      TimingWheel* wheel = TimingWheel::acquireShared();
+      assert(TimingWheel::acquireShared() == wheel);
+      TimingWheel::releaseShared();
+
+      // pools schedule their idle timers on the shared wheel
+      uint32_t timers = wheel->getTimerCount();
+      ThreadPool pool1(2);
+      ThreadPool pool2(2);
+      pool1.setThreadExpireTime(10000);
+      pool2.setThreadExpireTime(10000);
+      volatile uint32_t count = 0;
+      CountingJob job(&count);
+      pool1.runJob(job);
+      pool2.runJob(job);
+      assert(waitForCount(&count, 2));
+      for(int i = 0; wheel->getTimerCount() < timers + 2 && i < 1000; ++i)
+      {
+         Thread::sleep(1);
+      }
+      assert(wheel->getTimerCount() == timers + 2);
 
-      ClassCustomSortTuples compare;
-      d.sort(compare);
+      // terminating a pool cancels its timers
+      pool1.terminateAllThreads();
+      pool2.terminateAllThreads();
+      assert(wheel->getTimerCount() == timers);
 
-      DynamicObject expect;
-      expect[0] = t3;
-      expect[1] = t1;
-      expect[2] = t2;
+      // a cancelled timer is not running once synchronized
+      RunnableRef r = new CountingJob(&count);
+      TimingWheel::TimerRef t = wheel->schedule(r, 1, 1);
+      for(int i = 0; count < 5 && i < 1000; ++i)
+      {
+         Thread::sleep(1);
+      }
+      assert(count >= 5);
+      wheel->cancel(t);
+      wheel->synchronize();
+      uint32_t n = count;
+      Thread::sleep(20);
+      assert(count == n);
+      TimingWheel::releaseShared();
    }
    tr.passIfNoException();
 
@@ -2593,6 +5209,8 @@ static void runDynoStatsTest(TestRunner& tr)
    SETTYPESTAT(zero, Array, 0, 0, 0, 0, 0, 0);
    SETTYPESTAT(zero, Key, 0, 0, 0, 0, 0, 0);
    SETTYPESTAT(zero, StringValue, 0, 0, 0, 0, 0, 0);
+   SETTYPESTAT(zero, KeyInternHit, 0, 0, 0, 0, 0, 0);
+   SETTYPESTAT(zero, KeyInternMiss, 0, 0, 0, 0, 0, 0);
    zero["KeyCounts"]["count"] = 0;
    zero["KeyCounts"]["keys"]->setType(Map);
 
@@ -2662,6 +5280,11 @@ static void runDynoStatsTest(TestRunner& tr)
 
    tr.test("key counts");
    {
+      // ensure key is already interned
+      {
+         DynamicObject d;
+         d["key1"] = true;
+      }
       DynamicObjectImpl::enableStats(true);
       DynamicObjectImpl::clearStats();
       {
@@ -2676,6 +5299,7 @@ static void runDynoStatsTest(TestRunner& tr)
       SETTYPESTAT(expect, Boolean, 0, 1, 1, 0, 0, 0);
       SETTYPESTAT(expect, Key, 0, 1, 1, 0, 4, 4);
       SETTYPESTAT(expect, String, 0, 2, 1, 0, 0, 0);
+      SETTYPESTAT(expect, KeyInternHit, 1, 0, 1, 0, 0, 0);
       expect["KeyCounts"]["count"] = 1;
       SETSTAT(expect["KeyCounts"]["keys"]["key1"], 0, 1, 1, 0, 4, 4);
       assertDynoCmp(stats, expect);
@@ -2881,6 +5505,119 @@ static void runExceptionTest(TestRunner& tr)
    }
    tr.pass();
 
+   tr.test("static strings");
+   {
+      const char* message = "Static message.";
+      const char* type = "monarch.test.Static";
+      ExceptionRef e = new Exception(message, type, Exception::StaticStrings);
+      assert(e->getMessage() == message);
+      assert(e->getType() == type);
+      assert(e->isType("monarch.test.Static"));
+
+      // setting a message copies it
+      e->setMessage("Changed.");
+      assertStrCmp(e->getMessage(), "Changed.");
+      assert(e->getType() == type);
+
+      ExceptionRef copied = new Exception(message, type);
+      assert(copied->getMessage() != message);
+      assertStrCmp(copied->getMessage(), message);
+   }
+   tr.passIfNoException();
+
+   tr.test("lazy details");
+   {
+      ExceptionRef e = new Exception(
+         "No details.", "monarch.test.Lazy", Exception::StaticStrings);
+      DynamicObject d = Exception::convertToDynamicObject(e);
+      assert(!d->hasMember("details"));
+
+      e->getDetails()["foo"] = "bar";
+      d = Exception::convertToDynamicObject(e);
+      assertStrCmp(d["details"]["foo"]->getString(), "bar");
+   }
+   tr.passIfNoException();
+
+   tr.test("pooled memory");
+   {
+      // a released Exception's memory is reused by the same thread
+      ExceptionRef e = new Exception(
+         "Pooled.", "monarch.test.Pooled", Exception::StaticStrings);
+      void* ptr = &(*e);
+      e.setNull();
+      e = new Exception(
+         "Pooled.", "monarch.test.Pooled", Exception::StaticStrings);
+      assert(&(*e) == ptr);
+
+      // an Exception can be referenced again from a raw pointer
+      Exception::set(e);
+      ExceptionRef raw = &(*e);
+      e.setNull();
+      Exception::clear();
+      assertStrCmp(raw->getType(), "monarch.test.Pooled");
+   }
+   tr.passIfNoException();
+
+   tr.ungroup();
+}
+
+/**
+ * Sets the exception a socket read timeout set before Exceptions were pooled
+ * and could use static strings.
+ */
+static void _setCopiedTimeoutException()
+{
+   ExceptionRef e = new Exception(
+      "Socket read timed out.", "monarch.net.SocketTimeout");
+   e->getDetails()["error"] = strerror(EAGAIN);
+   Exception::set(e);
+}
+
+/**
+ * Sets the exception a socket read timeout sets now.
+ */
+static void _setStaticTimeoutException()
+{
+   ExceptionRef e = new Exception(
+      "Socket read timed out.", "monarch.net.SocketTimeout",
+      Exception::StaticStrings);
+   Exception::set(e);
+}
+
+static void runExceptionSpeedTest(TestRunner& tr)
+{
+   tr.group("Exception speed");
+
+   const uint32_t loops = 1000000;
+
+   tr.test("timeouts, copied strings and details, unpooled");
+   {
+      bool pooling = Exception::enablePooling(false);
+      uint64_t start = System::getCurrentMilliseconds();
+      for(uint32_t i = 0; i < loops; ++i)
+      {
+         _setCopiedTimeoutException();
+      }
+      uint64_t dt = System::getCurrentMilliseconds() - start;
+      printf("%u exceptions: %" PRIu64 " ms... ", loops, dt);
+      Exception::clear();
+      Exception::enablePooling(pooling);
+   }
+   tr.passIfNoException();
+
+   tr.test("timeouts, static strings, pooled");
+   {
+      uint64_t start = System::getCurrentMilliseconds();
+      for(uint32_t i = 0; i < loops; ++i)
+      {
+         _setStaticTimeoutException();
+      }
+      uint64_t dt = System::getCurrentMilliseconds() - start;
+      printf("%u exceptions: %" PRIu64 " ms... ", loops, dt);
+      Exception::clear();
+   }
+   tr.passIfNoException();
+
    tr.ungroup();
 }
 
@@ -2891,6 +5628,11 @@ static bool run(TestRunner& tr)
       runThreadTest(tr);
       runThreadPoolTest(tr);
       runJobDispatcherTest(tr);
+      runThreadGroupTest(tr);
+      runWorkStealingThreadPoolTest(tr);
+      runLockFreeQueueTest(tr);
+      runJobDispatcherStatsTest(tr);
+      runScheduledJobDispatcherTest(tr);
       runExclusiveLockTest(tr);
       runSharedLockTest(tr);
       runCollectableTest(tr);
@@ -2900,17 +5642,31 @@ static bool run(TestRunner& tr)
       runDynoCastTest(tr);
       runDynoRemoveTest(tr);
       runDynoIndexTest(tr);
+      runDynoValueIteratorTest(tr);
       runDynoTypeTest(tr);
       runDynoAppendTest(tr);
       runDynoMergeTest(tr);
       runDynoDiffTest(tr);
+      runDynoHashTest(tr);
+      runDynoPathTest(tr);
       runDynoCopyTest(tr);
       runDynoReverseTest(tr);
       runDynoSortTest(tr);
+      runDynoMapTest(tr);
+      runDynoPackedTest(tr);
+      runDynoFreezeTest(tr);
+      runStringTableTest(tr);
+      runLatencyHistogramTest(tr);
+      runClockCacheTest(tr);
+      runTimingWheelTest(tr);
       runDynoStatsTest(tr);
       runRunnableDelegateTest(tr);
       runExceptionTest(tr);
    }
+   if(tr.isTestEnabled("exception-speed"))
+   {
+      runExceptionSpeedTest(tr);
+   }
    if(tr.isTestEnabled("cpu-info"))
    {
       runCpuInfoTest(tr);
@@ -2919,6 +5675,22 @@ static bool run(TestRunner& tr)
    {
       runTimeTest(tr);
    }
+   if(tr.isTestEnabled("job-dispatcher-load"))
+   {
+      runJobDispatcherLoadTest(tr);
+   }
+   if(tr.isTestEnabled("work-stealing"))
+   {
+      runWorkStealingSpeedTest(tr);
+   }
+   if(tr.isTestEnabled("lock-contention"))
+   {
+      runLockContentionTest(tr);
+   }
+   if(tr.isTestEnabled("shared-lock-throughput"))
+   {
+      runSharedLockThroughputTest(tr);
+   }
    if(tr.isTestEnabled("slow-shared-lock"))
    {
       runInteractiveSharedLockTest(tr);
@@ -2931,10 +5703,13 @@ static bool run(TestRunner& tr)
       runDynoCastTest(tr);
       runDynoRemoveTest(tr);
       runDynoIndexTest(tr);
+      runDynoValueIteratorTest(tr);
       runDynoTypeTest(tr);
       runDynoAppendTest(tr);
       runDynoMergeTest(tr);
       runDynoDiffTest(tr);
+      runDynoHashTest(tr);
+      runDynoPathTest(tr);
       runDynoCopyTest(tr);
       runDynoReverseTest(tr);
       runDynoSortTest(tr);
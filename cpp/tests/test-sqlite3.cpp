@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2007-2010 Digital Bazaar, Inc. All rights reserved.
+ * Copyright (c) 2007-2011 Digital Bazaar, Inc. All rights reserved.
  */
 #include "monarch/data/json/JsonWriter.h"
 #include "monarch/rt/Thread.h"
@@ -963,6 +963,33 @@ static void runSqlite3ReuseTest(TestRunner& tr)
    }
    tr.passIfNoException();
 
+   tr.test("expire idle connection");
+   {
+      // an idle connection is closed once it expires
+      Sqlite3ConnectionPool pool("sqlite3::memory:", 1);
+      pool.setConnectionExpireTime(50);
+      monarch::sql::Connection* c = pool.getConnection();
+      assert(c != NULL);
+      c->close();
+      assert(pool.getIdleConnectionCount() == 1);
+      for(int i = 0; pool.getConnectionCount() > 0 && i < 1000; ++i)
+      {
+         Thread::sleep(1);
+      }
+      assert(pool.getConnectionCount() == 0);
+
+      // a connection that is reused before it expires is kept
+      c = pool.getConnection();
+      assert(c != NULL);
+      c->close();
+      c = pool.getConnection();
+      assert(c != NULL);
+      Thread::sleep(100);
+      assert(pool.getConnectionCount() == 1);
+      c->close();
+   }
+   tr.passIfNoException();
+
    tr.ungroup();
 }
 
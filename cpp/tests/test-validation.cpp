@@ -5,6 +5,7 @@
 #include "monarch/test/Test.h"
 #include "monarch/test/TestModule.h"
 #include "monarch/rt/DynamicObject.h"
+#include "monarch/rt/System.h"
 #include "monarch/validation/Validation.h"
 
 #include <cstdio>
@@ -1813,6 +1814,44 @@ static void runAnyExceptionsTest(TestRunner& tr)
 
 #undef _dump
 
+static void _runValidationFailures(uint32_t loops)
+{
+   v::Int v(v::Int::Positive);
+   DynamicObject d;
+   d = -1;
+   uint64_t start = System::getCurrentMilliseconds();
+   for(uint32_t i = 0; i < loops; ++i)
+   {
+      v.isValid(d);
+      Exception::clear();
+   }
+   uint64_t dt = System::getCurrentMilliseconds() - start;
+   printf("%u failures: %" PRIu64 " ms... ", loops, dt);
+}
+
+static void runExceptionSpeedTest(TestRunner& tr)
+{
+   tr.group("Validation exception speed");
+
+   const uint32_t loops = 200000;
+
+   tr.test("unpooled exceptions");
+   {
+      bool pooling = Exception::enablePooling(false);
+      _runValidationFailures(loops);
+      Exception::enablePooling(pooling);
+   }
+   tr.passIfNoException();
+
+   tr.test("pooled exceptions");
+   {
+      _runValidationFailures(loops);
+   }
+   tr.passIfNoException();
+
+   tr.ungroup();
+}
+
 static bool run(TestRunner& tr)
 {
    if(tr.isDefaultEnabled())
@@ -1828,6 +1867,10 @@ static bool run(TestRunner& tr)
    {
       runValidatorFactoryTest(tr);
    }
+   if(tr.isTestEnabled("exception-speed"))
+   {
+      runExceptionSpeedTest(tr);
+   }
    return true;
 }
 
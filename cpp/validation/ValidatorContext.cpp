@@ -140,7 +140,8 @@ DynamicObject ValidatorContext::addError(
             "The given object does not meet all of the data validation "
             "requirements. Please examine the error details for more "
             "information about the specific requirements.",
-            "monarch.validation.ValidationError");
+            "monarch.validation.ValidationError",
+            Exception::StaticStrings);
          Exception::set(e);
       }
       else
@@ -156,7 +157,8 @@ DynamicObject ValidatorContext::addError(
                "The given object does not meet all of the data validation "
                "requirements. Please examine the error details for more "
                "information about the specific requirements.",
-               "monarch.validation.ValidationError");
+               "monarch.validation.ValidationError",
+               Exception::StaticStrings);
             Exception::push(e);
          }
       }
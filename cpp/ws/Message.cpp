@@ -7,6 +7,8 @@
 
 #include "monarch/data/DynamicObjectInputStream.h"
 #include "monarch/data/DynamicObjectOutputStream.h"
+#include "monarch/data/binary/BinaryReader.h"
+#include "monarch/data/binary/BinaryWriter.h"
 #include "monarch/data/json/JsonReader.h"
 #include "monarch/data/json/JsonWriter.h"
 #include "monarch/data/xml/XmlReader.h"
@@ -23,6 +25,7 @@ using namespace std;
 using namespace monarch::compress::deflate;
 using namespace monarch::compress::gzip;
 using namespace monarch::data;
+using namespace monarch::data::binary;
 using namespace monarch::data::json;
 using namespace monarch::data::xml;
 using namespace monarch::http;
@@ -35,6 +38,7 @@ using namespace monarch::ws;
 #define CONTENT_TYPE_JSON   "application/json"
 #define CONTENT_TYPE_XML    "text/xml"
 #define CONTENT_TYPE_FORM   "application/x-www-form-urlencoded"
+#define CONTENT_TYPE_BINARY "application/x-monarch-binary"
 
 Message::Message() :
    mContentSource(NULL),
@@ -328,6 +332,10 @@ Message::ContentType Message::getContentType(HttpHeader* header)
       {
          rval = Form;
       }
+      else if(strstr(contentType.c_str(), CONTENT_TYPE_BINARY) != NULL)
+      {
+         rval = Binary;
+      }
    }
 
    return rval;
@@ -642,6 +650,10 @@ bool Message::sendHeaderAndObject(
             {
                writer = new JsonWriter();
             }
+            else if(type == Binary)
+            {
+               writer = new BinaryWriter();
+            }
             else
             {
                writer = new XmlWriter();
@@ -777,6 +789,10 @@ bool Message::receiveContentObject(
          {
             reader = new JsonReader();
          }
+         else if(type == Binary)
+         {
+            reader = new BinaryReader();
+         }
          else
          {
             reader = new XmlReader();
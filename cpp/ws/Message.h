@@ -48,7 +48,7 @@ public:
     */
    enum ContentType
    {
-      Unknown, Json, Xml, Form
+      Unknown, Json, Xml, Form, Binary
    };
 
 protected:
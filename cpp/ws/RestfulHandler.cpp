@@ -296,7 +296,8 @@ RestfulHandler::HandlerInfo* RestfulHandler::findHandler(ServiceChannel* ch)
          ch->getResponse()->getHeader()->setStatus(404, "Not Found");
          ExceptionRef e = new Exception(
             "Resource not found.",
-            "monarch.ws.ResourceNotFound");
+            "monarch.ws.ResourceNotFound",
+            Exception::StaticStrings);
          e->getDetails()["code"] = 404;
          e->getDetails()["resource"] = ch->getPath();
          Exception::set(e);
@@ -308,7 +309,8 @@ RestfulHandler::HandlerInfo* RestfulHandler::findHandler(ServiceChannel* ch)
          ch->getResponse()->getHeader()->setStatus(405, "Method Not Allowed");
          ExceptionRef e = new Exception(
             "Method not allowed.",
-            "monarch.ws.MethodNotAllowed");
+            "monarch.ws.MethodNotAllowed",
+            Exception::StaticStrings);
          e->getDetails()["code"] = 405;
          e->getDetails()["invalidMethod"] = method.c_str();
          e->getDetails()["validMethods"] = validMethods;
@@ -22,6 +22,7 @@ using namespace monarch::ws;
 #define CONTENT_TYPE_JSON   "application/json"
 #define CONTENT_TYPE_XML    "text/xml"
 #define CONTENT_TYPE_FORM   "application/x-www-form-urlencoded"
+#define CONTENT_TYPE_BINARY "application/x-monarch-binary"
 
 ServiceChannel::ServiceChannel(const char* path) :
    mPath(strdup(path)),
@@ -363,8 +364,12 @@ static void _setDynoContentType(HttpRequest* request, HttpResponse* response)
    {
       ct = request->getHeader()->getFieldValue("Accept");
 
-      // prefer JSON
-      if(ct.length() == 0 ||
+      // use binary if explicitly accepted, otherwise prefer JSON
+      if(strstr(ct.c_str(), CONTENT_TYPE_BINARY) != NULL)
+      {
+         ct = CONTENT_TYPE_BINARY;
+      }
+      else if(ct.length() == 0 ||
          strstr(ct.c_str(), CONTENT_TYPE_ANY) != NULL ||
          strstr(ct.c_str(), CONTENT_TYPE_JSON) != NULL)
       {
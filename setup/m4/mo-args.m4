@@ -1,8 +1,9 @@
 dnl Monarch misc options
-dnl Copyright 2010 Digital Bazaar, Inc.
+dnl Copyright 2010-2011 Digital Bazaar, Inc.
 
 dnl MO_ARG_DEBUG
 dnl MO_ARG_LOG_LINE_NUMBERS
+dnl MO_ARG_FIBER_CONTEXT
 dnl MO_ARG_OPT
 dnl MO_ARG_TESTS
 dnl MO_ARG_DOCS
@@ -65,6 +66,43 @@ AC_DEFUN([MO_ARG_LOG_LINE_NUMBERS],
       [enabled], [disabled (use --enable-log-line-numbers to enable)])
 ])
 
+dnl ----------------- control fiber context switching -----------------
+
+AC_DEFUN([MO_ARG_FIBER_CONTEXT],
+[
+   AC_REQUIRE([AC_CANONICAL_HOST])
+
+   dnl the assembly context switch is only available on some cpus
+   case "${host_cpu}" in
+      x86_64|aarch64) _MO_FIBER_ASM_CONTEXT_OK=yes ;;
+      *)              _MO_FIBER_ASM_CONTEXT_OK=no ;;
+   esac
+   if test "x$BUILD_FOR_WINDOWS" = "xyes"; then
+      _MO_FIBER_ASM_CONTEXT_OK=no
+   fi
+
+   AC_ARG_ENABLE([fiber-asm-context],
+      AC_HELP_STRING(
+         [--disable-fiber-asm-context],
+         [switch fibers with ucontext instead of assembly [no]]),
+      [
+      case "${enableval}" in
+         yes) MO_FIBER_ASM_CONTEXT=$_MO_FIBER_ASM_CONTEXT_OK ;;
+         no)  MO_FIBER_ASM_CONTEXT=no ;;
+         *)   AC_MSG_ERROR(bad value ${enableval} for --enable-fiber-asm-context) ;;
+      esac
+      ],
+      [MO_FIBER_ASM_CONTEXT=$_MO_FIBER_ASM_CONTEXT_OK]) dnl Default value
+   if test "x$MO_FIBER_ASM_CONTEXT" = xyes; then
+      AC_DEFINE([MO_FIBER_ASM_CONTEXT], [1],
+         [Switch fiber contexts with hand-written assembly.])
+   fi
+
+   MO_MSG_CONFIG_OPTION_IF([Fiber context],
+      [test "x$MO_FIBER_ASM_CONTEXT" = xyes],
+      [assembly], [ucontext])
+])
+
 dnl ----------------- control optimizations -----------------
 
 AC_DEFUN([MO_ARG_OPT],